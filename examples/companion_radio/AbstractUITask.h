@@ -3,6 +3,7 @@
 #include <MeshCore.h>
 #include <helpers/ui/DisplayDriver.h>
 #include <helpers/ui/UIScreen.h>
+#include <helpers/ui/RenderScheduler.h>
 #include <helpers/SensorManager.h>
 #include <helpers/BaseSerialInterface.h>
 #include <Arduino.h>
@@ -27,6 +28,7 @@ protected:
   mesh::MainBoard* _board;
   BaseSerialInterface* _serial;
   bool _connected;
+  RenderScheduler _render;
 
   AbstractUITask(mesh::MainBoard* board, BaseSerialInterface* serial) : _board(board), _serial(serial) {
     _connected = false;
@@ -35,6 +37,7 @@ protected:
 public:
   void setHasConnection(bool connected) { _connected = connected; }
   bool hasConnection() const { return _connected; }
+  virtual const RenderStats& getRenderStats() const { return _render.getStats(); }
   uint16_t getBattMilliVolts() const { return _board->getBattMilliVolts(); }
   bool isSerialEnabled() const { return _serial->isEnabled(); }
   void enableSerial() { _serial->enable(); }
@@ -43,4 +46,7 @@ public:
   virtual void newMsg(uint8_t path_len, const char* from_name, const char* text, int msgcount) = 0;
   virtual void notify(UIEventType t = UIEventType::none) = 0;
   virtual void loop() = 0;
+
+  /** \returns  millis until loop() next has something to do, or zero if it needs calling continually (the default) */
+  virtual uint32_t getMillisToNextWakeup(uint32_t max_millis) { return 0; }
 };
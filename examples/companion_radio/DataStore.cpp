@@ -1,13 +1,41 @@
 #include <Arduino.h>
 #include "DataStore.h"
+#include <helpers/FlashWriter.h>
+#include <LoopMonitor.h>
+
+#ifndef MAX_BLOBRECS
+  #if defined(EXTRAFS) || defined(QSPIFLASH) || defined(ESP32) || defined(RP2040_PLATFORM)
+    #define MAX_BLOBRECS 100
+  #else
+    #define MAX_BLOBRECS 20
+  #endif
+#endif
 
-#if defined(EXTRAFS) || defined(QSPIFLASH)
-  #define MAX_BLOBRECS 100
-#else
-  #define MAX_BLOBRECS 20
+#ifndef MAX_JOURNAL_RECS
+  #define MAX_JOURNAL_RECS  64     // then rewrite whole /contacts3
 #endif
 
-DataStore::DataStore(FILESYSTEM& fs, mesh::RTCClock& clock) : _fs(&fs), _fsExtra(nullptr), _clock(&clock),
+#define CONTACT_REC_SIZE     152
+
+#ifndef CONTACT_IO_RECS
+  #define CONTACT_IO_RECS   8      // contact records read/written per file op
+#endif
+#define JOURNAL_OP_PUT       'P'
+#define JOURNAL_OP_REMOVE    'R'
+
+#ifndef CONTACT_SECRETS_CACHE
+  #define CONTACT_SECRETS_CACHE   1    // persist contacts' shared secrets, see setSecretsIdentity()
+#endif
+#define SECRETS_HDR_SIZE     12     // magic(2), version(1), reserved(1), identity tag(8)
+#define SECRETS_VERSION      1
+#define SECRET_REC_SIZE      (CIPHER_BLOCK_SIZE + PUB_KEY_SIZE)   // pub_key prefix (also the IV), then encrypted secret
+
+#define LOAD_STAGE_CONTACTS  0
+#define LOAD_STAGE_JOURNAL   1
+#define LOAD_STAGE_CHANNELS  2
+#define LOAD_STAGE_DONE      3
+
+DataStore::DataStore(FILESYSTEM& fs, mesh::RTCClock& clock) : _fs(&fs), _fsExtra(nullptr), _clock(&clock), _journal_recs(0), _num_msgs(0), _prefs_file("/app_prefs"),
 #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
     identity_store(fs, "")
 #elif defined(RP2040_PLATFORM)
@@ -16,10 +44,12 @@ DataStore::DataStore(FILESYSTEM& fs, mesh::RTCClock& clock) : _fs(&fs), _fsExtra
     identity_store(fs, "/identity")
 #endif
 {
+  _load_stage = LOAD_STAGE_DONE;
+  _secrets_enabled = _secrets_missing = false;
 }
 
 #if defined(EXTRAFS) || defined(QSPIFLASH)
-DataStore::DataStore(FILESYSTEM& fs, FILESYSTEM& fsExtra, mesh::RTCClock& clock) : _fs(&fs), _fsExtra(&fsExtra), _clock(&clock),
+DataStore::DataStore(FILESYSTEM& fs, FILESYSTEM& fsExtra, mesh::RTCClock& clock) : _fs(&fs), _fsExtra(&fsExtra), _clock(&clock), _journal_recs(0), _num_msgs(0), _prefs_file("/app_prefs"),
 #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
     identity_store(fs, "")
 #elif defined(RP2040_PLATFORM)
@@ -28,6 +58,8 @@ DataStore::DataStore(FILESYSTEM& fs, FILESYSTEM& fsExtra, mesh::RTCClock& clock)
     identity_store(fs, "/identity")
 #endif
 {
+  _load_stage = LOAD_STAGE_DONE;
+  _secrets_enabled = _secrets_missing = false;
 }
 #endif
 
@@ -42,6 +74,24 @@ static File openWrite(FILESYSTEM* fs, const char* filename) {
 #endif
 }
 
+static File openAppend(FILESYSTEM* fs, const char* filename) {
+#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+  return fs->open(filename, FILE_O_WRITE);
+#elif defined(RP2040_PLATFORM)
+  return fs->open(filename, "a");
+#else
+  return fs->open(filename, "a", true);
+#endif
+}
+
+static File openReadWrite(FILESYSTEM* fs, const char* filename) {   // for updating in place
+#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+  return fs->open(filename, FILE_O_WRITE);
+#else
+  return fs->open(filename, "r+");
+#endif
+}
+
 #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
   static uint32_t _ContactsChannelsTotalBlocks = 0;
 #endif
@@ -58,9 +108,10 @@ void DataStore::begin() {
   migrateToSecondaryFS();
   #endif
 #else
-  // init 'blob store' support
-  _fs->mkdir("/bl");
+  checkAdvBlobFile();
 #endif
+  loadMessageLog();
+  loadHistory();
 }
 
 #if defined(ESP32)
@@ -162,7 +213,11 @@ bool DataStore::removeFile(FILESYSTEM* fs, const char* filename) {
   return fs->remove(filename);
 }
 
+static bool _blob_index_loaded = false;
+
 bool DataStore::formatFileSystem() {
+  flash_writer.flush();
+  _blob_index_loaded = false;   // /adv_blobs is about to go
 #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
   if (_fsExtra == nullptr) {
     return _fs->format();
@@ -186,186 +241,361 @@ bool DataStore::saveMainIdentity(const mesh::LocalIdentity &identity) {
   return identity_store.save("_main", identity);
 }
 
+#define APP_PREFS_VERSION   1
+#define APP_PREFS_LEN       85
+
 void DataStore::loadPrefs(NodePrefs& prefs, double& node_lat, double& node_lon) {
-  if (_fs->exists("/new_prefs")) {
-    loadPrefsInt("/new_prefs", prefs, node_lat, node_lon); // new filename
+  uint8_t blob[APP_PREFS_LEN];
+  uint8_t version;
+  int len = _prefs_file.load(_fs, blob, sizeof(blob), version);
+  if (len >= 0 && version == APP_PREFS_VERSION) {
+    unpackPrefs(blob, len, prefs, node_lat, node_lon);
+  } else if (_fs->exists("/new_prefs")) {
+    loadPrefsInt("/new_prefs", prefs, node_lat, node_lon); // field by field format
+    if (savePrefs(prefs, node_lat, node_lon)) {  // convert
+      flash_writer.flush();
+      _fs->remove("/new_prefs");
+    }
   } else if (_fs->exists("/node_prefs")) {
     loadPrefsInt("/node_prefs", prefs, node_lat, node_lon);
-    savePrefs(prefs, node_lat, node_lon);                // save to new filename
-    _fs->remove("/node_prefs"); // remove old
+    if (savePrefs(prefs, node_lat, node_lon)) { // remove old
+      flash_writer.flush();
+      _fs->remove("/node_prefs");
+    }
   }
 }
 
 void DataStore::loadPrefsInt(const char *filename, NodePrefs& _prefs, double& node_lat, double& node_lon) {
   File file = openRead(_fs, filename);
   if (file) {
-    uint8_t pad[8];
-
-    file.read((uint8_t *)&_prefs.airtime_factor, sizeof(float));                           // 0
-    file.read((uint8_t *)_prefs.node_name, sizeof(_prefs.node_name));                      // 4
-    file.read(pad, 4);                                                                     // 36
-    file.read((uint8_t *)&node_lat, sizeof(node_lat));                                     // 40
-    file.read((uint8_t *)&node_lon, sizeof(node_lon));                                     // 48
-    file.read((uint8_t *)&_prefs.freq, sizeof(_prefs.freq));                               // 56
-    file.read((uint8_t *)&_prefs.sf, sizeof(_prefs.sf));                                   // 60
-    file.read((uint8_t *)&_prefs.cr, sizeof(_prefs.cr));                                   // 61
-    file.read(pad, 1);                                                                     // 62
-    file.read((uint8_t *)&_prefs.manual_add_contacts, sizeof(_prefs.manual_add_contacts)); // 63
-    file.read((uint8_t *)&_prefs.bw, sizeof(_prefs.bw));                                   // 64
-    file.read((uint8_t *)&_prefs.tx_power_dbm, sizeof(_prefs.tx_power_dbm));               // 68
-    file.read((uint8_t *)&_prefs.telemetry_mode_base, sizeof(_prefs.telemetry_mode_base)); // 69
-    file.read((uint8_t *)&_prefs.telemetry_mode_loc, sizeof(_prefs.telemetry_mode_loc));   // 70
-    file.read((uint8_t *)&_prefs.telemetry_mode_env, sizeof(_prefs.telemetry_mode_env));   // 71
-    file.read((uint8_t *)&_prefs.rx_delay_base, sizeof(_prefs.rx_delay_base));             // 72
-    file.read((uint8_t *)&_prefs.advert_loc_policy, sizeof(_prefs.advert_loc_policy));     // 76
-    file.read((uint8_t *)&_prefs.multi_acks, sizeof(_prefs.multi_acks));                   // 77
-    file.read(pad, 2);                                                                     // 78
-    file.read((uint8_t *)&_prefs.ble_pin, sizeof(_prefs.ble_pin));                         // 80
-    file.read((uint8_t *)&_prefs.buzzer_quiet, sizeof(_prefs.buzzer_quiet));               // 84
-
+    uint8_t blob[APP_PREFS_LEN];
+    int len = file.read(blob, sizeof(blob));   // same layout as the blob
     file.close();
+    if (len > 0) unpackPrefs(blob, len, _prefs, node_lat, node_lon);
   }
 }
 
-void DataStore::savePrefs(const NodePrefs& _prefs, double node_lat, double node_lon) {
-  File file = openWrite(_fs, "/new_prefs");
-  if (file) {
-    uint8_t pad[8];
-    memset(pad, 0, sizeof(pad));
-
-    file.write((uint8_t *)&_prefs.airtime_factor, sizeof(float));                           // 0
-    file.write((uint8_t *)_prefs.node_name, sizeof(_prefs.node_name));                      // 4
-    file.write(pad, 4);                                                                     // 36
-    file.write((uint8_t *)&node_lat, sizeof(node_lat));                                     // 40
-    file.write((uint8_t *)&node_lon, sizeof(node_lon));                                     // 48
-    file.write((uint8_t *)&_prefs.freq, sizeof(_prefs.freq));                               // 56
-    file.write((uint8_t *)&_prefs.sf, sizeof(_prefs.sf));                                   // 60
-    file.write((uint8_t *)&_prefs.cr, sizeof(_prefs.cr));                                   // 61
-    file.write(pad, 1);                                                                     // 62
-    file.write((uint8_t *)&_prefs.manual_add_contacts, sizeof(_prefs.manual_add_contacts)); // 63
-    file.write((uint8_t *)&_prefs.bw, sizeof(_prefs.bw));                                   // 64
-    file.write((uint8_t *)&_prefs.tx_power_dbm, sizeof(_prefs.tx_power_dbm));               // 68
-    file.write((uint8_t *)&_prefs.telemetry_mode_base, sizeof(_prefs.telemetry_mode_base)); // 69
-    file.write((uint8_t *)&_prefs.telemetry_mode_loc, sizeof(_prefs.telemetry_mode_loc));   // 70
-    file.write((uint8_t *)&_prefs.telemetry_mode_env, sizeof(_prefs.telemetry_mode_env));   // 71
-    file.write((uint8_t *)&_prefs.rx_delay_base, sizeof(_prefs.rx_delay_base));             // 72
-    file.write((uint8_t *)&_prefs.advert_loc_policy, sizeof(_prefs.advert_loc_policy));     // 76
-    file.write((uint8_t *)&_prefs.multi_acks, sizeof(_prefs.multi_acks));                   // 77
-    file.write(pad, 2);                                                                     // 78
-    file.write((uint8_t *)&_prefs.ble_pin, sizeof(_prefs.ble_pin));                         // 80
-    file.write((uint8_t *)&_prefs.buzzer_quiet, sizeof(_prefs.buzzer_quiet));               // 84
+void DataStore::unpackPrefs(const uint8_t* blob, int len, NodePrefs& _prefs, double& node_lat, double& node_lon) {
+  int i = 0;
+  PrefsFile::getField(blob, len, i, &_prefs.airtime_factor, sizeof(float));                           // 0
+  PrefsFile::getField(blob, len, i, _prefs.node_name, sizeof(_prefs.node_name));                      // 4
+  i += 4;                                                                                             // 36
+  PrefsFile::getField(blob, len, i, &node_lat, sizeof(node_lat));                                     // 40
+  PrefsFile::getField(blob, len, i, &node_lon, sizeof(node_lon));                                     // 48
+  PrefsFile::getField(blob, len, i, &_prefs.freq, sizeof(_prefs.freq));                               // 56
+  PrefsFile::getField(blob, len, i, &_prefs.sf, sizeof(_prefs.sf));                                   // 60
+  PrefsFile::getField(blob, len, i, &_prefs.cr, sizeof(_prefs.cr));                                   // 61
+  i += 1;                                                                                             // 62
+  PrefsFile::getField(blob, len, i, &_prefs.manual_add_contacts, sizeof(_prefs.manual_add_contacts)); // 63
+  PrefsFile::getField(blob, len, i, &_prefs.bw, sizeof(_prefs.bw));                                   // 64
+  PrefsFile::getField(blob, len, i, &_prefs.tx_power_dbm, sizeof(_prefs.tx_power_dbm));               // 68
+  PrefsFile::getField(blob, len, i, &_prefs.telemetry_mode_base, sizeof(_prefs.telemetry_mode_base)); // 69
+  PrefsFile::getField(blob, len, i, &_prefs.telemetry_mode_loc, sizeof(_prefs.telemetry_mode_loc));   // 70
+  PrefsFile::getField(blob, len, i, &_prefs.telemetry_mode_env, sizeof(_prefs.telemetry_mode_env));   // 71
+  PrefsFile::getField(blob, len, i, &_prefs.rx_delay_base, sizeof(_prefs.rx_delay_base));             // 72
+  PrefsFile::getField(blob, len, i, &_prefs.advert_loc_policy, sizeof(_prefs.advert_loc_policy));     // 76
+  PrefsFile::getField(blob, len, i, &_prefs.multi_acks, sizeof(_prefs.multi_acks));                   // 77
+  i += 2;                                                                                             // 78
+  PrefsFile::getField(blob, len, i, &_prefs.ble_pin, sizeof(_prefs.ble_pin));                         // 80
+  PrefsFile::getField(blob, len, i, &_prefs.buzzer_quiet, sizeof(_prefs.buzzer_quiet));               // 84
+  // 85
+}
 
-    file.close();
+bool DataStore::savePrefs(const NodePrefs& _prefs, double node_lat, double node_lon) {
+  uint8_t blob[APP_PREFS_LEN];
+  memset(blob, 0, sizeof(blob));   // for the pads
+
+  int i = 0;
+  PrefsFile::putField(blob, i, &_prefs.airtime_factor, sizeof(float));                           // 0
+  PrefsFile::putField(blob, i, _prefs.node_name, sizeof(_prefs.node_name));                      // 4
+  i += 4;                                                                                        // 36
+  PrefsFile::putField(blob, i, &node_lat, sizeof(node_lat));                                     // 40
+  PrefsFile::putField(blob, i, &node_lon, sizeof(node_lon));                                     // 48
+  PrefsFile::putField(blob, i, &_prefs.freq, sizeof(_prefs.freq));                               // 56
+  PrefsFile::putField(blob, i, &_prefs.sf, sizeof(_prefs.sf));                                   // 60
+  PrefsFile::putField(blob, i, &_prefs.cr, sizeof(_prefs.cr));                                   // 61
+  i += 1;                                                                                        // 62
+  PrefsFile::putField(blob, i, &_prefs.manual_add_contacts, sizeof(_prefs.manual_add_contacts)); // 63
+  PrefsFile::putField(blob, i, &_prefs.bw, sizeof(_prefs.bw));                                   // 64
+  PrefsFile::putField(blob, i, &_prefs.tx_power_dbm, sizeof(_prefs.tx_power_dbm));               // 68
+  PrefsFile::putField(blob, i, &_prefs.telemetry_mode_base, sizeof(_prefs.telemetry_mode_base)); // 69
+  PrefsFile::putField(blob, i, &_prefs.telemetry_mode_loc, sizeof(_prefs.telemetry_mode_loc));   // 70
+  PrefsFile::putField(blob, i, &_prefs.telemetry_mode_env, sizeof(_prefs.telemetry_mode_env));   // 71
+  PrefsFile::putField(blob, i, &_prefs.rx_delay_base, sizeof(_prefs.rx_delay_base));             // 72
+  PrefsFile::putField(blob, i, &_prefs.advert_loc_policy, sizeof(_prefs.advert_loc_policy));     // 76
+  PrefsFile::putField(blob, i, &_prefs.multi_acks, sizeof(_prefs.multi_acks));                   // 77
+  i += 2;                                                                                        // 78
+  PrefsFile::putField(blob, i, &_prefs.ble_pin, sizeof(_prefs.ble_pin));                         // 80
+  PrefsFile::putField(blob, i, &_prefs.buzzer_quiet, sizeof(_prefs.buzzer_quiet));               // 84
+
+  return _prefs_file.save(_fs, blob, sizeof(blob), APP_PREFS_VERSION);
+}
+
+static void packContact(uint8_t* rec, const ContactInfo& c) {
+  int i = 0;
+  memcpy(&rec[i], c.id.pub_key, 32); i += 32;
+  memcpy(&rec[i], c.name, 32); i += 32;
+  rec[i++] = c.type;
+  rec[i++] = c.flags;
+  rec[i++] = 0;   // unused
+  memcpy(&rec[i], &c.sync_since, 4); i += 4;
+  rec[i++] = (uint8_t) c.out_path_len;
+  memcpy(&rec[i], &c.last_advert_timestamp, 4); i += 4;
+  memcpy(&rec[i], c.out_path, 64); i += 64;
+  memcpy(&rec[i], &c.lastmod, 4); i += 4;
+  memcpy(&rec[i], &c.gps_lat, 4); i += 4;
+  memcpy(&rec[i], &c.gps_lon, 4); i += 4;
+}
+
+static void unpackContact(ContactInfo& c, const uint8_t* rec) {
+  int i = 0;
+  c.id = mesh::Identity(&rec[i]); i += 32;
+  memcpy(c.name, &rec[i], 32); i += 32;
+  c.type = rec[i++];
+  c.flags = rec[i++];
+  i++;   // unused
+  memcpy(&c.sync_since, &rec[i], 4); i += 4;    // was 'reserved'
+  c.out_path_len = (int8_t) rec[i++];
+  memcpy(&c.last_advert_timestamp, &rec[i], 4); i += 4;
+  memcpy(c.out_path, &rec[i], 64); i += 64;
+  memcpy(&c.lastmod, &rec[i], 4); i += 4;
+  memcpy(&c.gps_lat, &rec[i], 4); i += 4;
+  memcpy(&c.gps_lon, &rec[i], 4); i += 4;
+}
+
+static uint8_t io_buf[CONTACT_IO_RECS*CONTACT_REC_SIZE];   // (too big for stack)
+static uint8_t secrets_buf[CONTACT_IO_RECS*SECRET_REC_SIZE];
+
+void DataStore::setSecretsIdentity(mesh::LocalIdentity& self) {
+#if CONTACT_SECRETS_CACHE
+  uint8_t keys[PRV_KEY_SIZE + PUB_KEY_SIZE];
+  uint8_t key[PUB_KEY_SIZE];
+  self.writeTo(keys, sizeof(keys));
+  mesh::Utils::sha256(key, sizeof(key), keys, sizeof(keys), (const uint8_t *) "contact-secrets", 15);
+  _secrets_key.init(key);
+  mesh::Utils::sha256(_secrets_tag, sizeof(_secrets_tag), key, sizeof(key));   // identifies the key, without revealing it
+  memset(keys, 0, sizeof(keys));
+  memset(key, 0, sizeof(key));
+  _secrets_enabled = true;
+#endif
+}
+
+bool DataStore::readSecret(ContactInfo& c) {
+  uint8_t rec[SECRET_REC_SIZE];
+  if (!_secrets_file) return false;
+  if (_secrets_file.read(rec, sizeof(rec)) != sizeof(rec) || memcmp(rec, c.id.pub_key, CIPHER_BLOCK_SIZE) != 0) {
+    _secrets_file.close();   // EOF, or out of step with /contacts3, so the rest are calculated
+    return false;
   }
+  _secrets_key.cryptCTR(c.shared_secret, &rec[CIPHER_BLOCK_SIZE], PUB_KEY_SIZE, rec);
+  return true;
 }
 
-void DataStore::loadContacts(DataStoreHost* host) {
-File file = openRead(_getContactsChannelsFS(), "/contacts3");
-    if (file) {
+void DataStore::beginLoad(bool with_channels) {
+  flash_writer.flush();   // (journal appends)
+  if (_load_file) _load_file.close();   // (a previous load not finished)
+  _load_stage = LOAD_STAGE_CONTACTS;
+  _load_channels = with_channels;
+  _load_have = 0;
+  _load_channel_idx = 0;
+  _journal_recs = 0;
+  _load_file = openRead(_getContactsChannelsFS(), "/contacts3");
+
+  _secrets_missing = false;
+  if (_secrets_file) _secrets_file.close();
+  if (_secrets_enabled) {
+    _secrets_file = openRead(_getContactsChannelsFS(), "/contacts3.sec");
+    uint8_t hdr[SECRETS_HDR_SIZE];
+    if (_secrets_file && (_secrets_file.read(hdr, sizeof(hdr)) != sizeof(hdr) || hdr[0] != 'S' || hdr[1] != 'C'
+                            || hdr[2] != SECRETS_VERSION || memcmp(&hdr[4], _secrets_tag, sizeof(_secrets_tag)) != 0)) {
+      MESH_DEBUG_PRINTLN("DataStore: secrets cache invalid, or for another identity");
+      _secrets_file.close();
+    }
+  }
+}
+
+void DataStore::nextLoadStage() {
+  if (_load_file) _load_file.close();
+  if (_secrets_file) _secrets_file.close();
+  _load_have = 0;
+  _load_stage++;
+  if (_load_stage == LOAD_STAGE_JOURNAL) {
+    _load_file = openRead(_getContactsChannelsFS(), "/contacts3.jnl");   // then replay changes since /contacts3 was written
+  } else if (_load_stage == LOAD_STAGE_CHANNELS && _load_channels) {
+    _load_file = openRead(_getContactsChannelsFS(), "/channels2");
+  } else {
+    _load_stage = LOAD_STAGE_DONE;
+  }
+}
+
+bool DataStore::loadStep(DataStoreHost* host, int max_recs) {
+  while (max_recs > 0 && _load_stage != LOAD_STAGE_DONE) {
+    if (!_load_file) {   // file not there
+      nextLoadStage();
+    } else if (_load_stage == LOAD_STAGE_CONTACTS) {
+      int want = max_recs < CONTACT_IO_RECS ? max_recs : CONTACT_IO_RECS;
+      int n = _load_file.read(&io_buf[_load_have], want*CONTACT_REC_SIZE - _load_have);
+      if (n <= 0) {   // EOF (any partial record is ignored)
+        nextLoadStage();
+        continue;
+      }
+      _load_have += n;
+      int i = 0;
       bool full = false;
-      while (!full) {
+      for ( ; !full && i + CONTACT_REC_SIZE <= _load_have; i += CONTACT_REC_SIZE) {
         ContactInfo c;
-        uint8_t pub_key[32];
-        uint8_t unused;
-
-        bool success = (file.read(pub_key, 32) == 32);
-        success = success && (file.read((uint8_t *)&c.name, 32) == 32);
-        success = success && (file.read(&c.type, 1) == 1);
-        success = success && (file.read(&c.flags, 1) == 1);
-        success = success && (file.read(&unused, 1) == 1);
-        success = success && (file.read((uint8_t *)&c.sync_since, 4) == 4); // was 'reserved'
-        success = success && (file.read((uint8_t *)&c.out_path_len, 1) == 1);
-        success = success && (file.read((uint8_t *)&c.last_advert_timestamp, 4) == 4);
-        success = success && (file.read(c.out_path, 64) == 64);
-        success = success && (file.read((uint8_t *)&c.lastmod, 4) == 4);
-        success = success && (file.read((uint8_t *)&c.gps_lat, 4) == 4);
-        success = success && (file.read((uint8_t *)&c.gps_lon, 4) == 4);
-
-        if (!success) break; // EOF
-
-        c.id = mesh::Identity(pub_key);
-        if (!host->onContactLoaded(c)) full = true;
+        unpackContact(c, &io_buf[i]);
+        bool has_secret = readSecret(c);
+        if (!has_secret && _secrets_enabled) _secrets_missing = true;
+        if (!host->onContactLoaded(c, has_secret)) full = true;
+        max_recs--;
       }
-      file.close();
+      if (full) {
+        nextLoadStage();
+      } else {
+        _load_have -= i;
+        memmove(io_buf, &io_buf[i], _load_have);   // keep any partial record, for next read
+      }
+    } else if (_load_stage == LOAD_STAGE_JOURNAL) {
+      uint8_t rec[1 + CONTACT_REC_SIZE];
+      if (_load_file.read(rec, sizeof(rec)) != sizeof(rec)) {   // a torn record (at end) is just ignored
+        nextLoadStage();
+        continue;
+      }
+      ContactInfo c;
+      unpackContact(c, &rec[1]);
+      if (rec[0] == JOURNAL_OP_PUT) {
+        host->onContactLoaded(c, false);
+      } else if (rec[0] == JOURNAL_OP_REMOVE) {
+        host->onContactRemoved(c.id.pub_key);
+      } else {
+        nextLoadStage();   // corrupt
+        continue;
+      }
+      _journal_recs++;
+      max_recs--;
+    } else {   // LOAD_STAGE_CHANNELS
+      ChannelDetails ch;
+      uint8_t unused[4];
+
+      bool success = (_load_file.read(unused, 4) == 4);
+      success = success && (_load_file.read((uint8_t *)ch.name, 32) == 32);
+      success = success && (_load_file.read((uint8_t *)ch.channel.secret, 32) == 32);
+
+      if (!success || !host->onChannelLoaded(_load_channel_idx, ch)) {   // EOF, or full
+        nextLoadStage();
+        continue;
+      }
+      _load_channel_idx++;
+      max_recs--;
     }
+  }
+  return _load_stage == LOAD_STAGE_DONE;
+}
+
+void DataStore::loadContacts(DataStoreHost* host) {
+  beginLoad(false);
+  while (!loadStep(host, CONTACT_IO_RECS)) { }
 }
 
 void DataStore::saveContacts(DataStoreHost* host) {
+  LOOP_SCOPE(LOOP_SECT_STORE);
+  flash_writer.flush();   // journal appends must land before the journal is removed (below)
   File file = openWrite(_getContactsChannelsFS(), "/contacts3");
   if (file) {
+    File secrets;
+    if (_secrets_enabled) {   // written in step with /contacts3
+      secrets = openWrite(_getContactsChannelsFS(), "/contacts3.sec");
+      uint8_t hdr[SECRETS_HDR_SIZE];
+      hdr[0] = 'S'; hdr[1] = 'C';
+      hdr[2] = SECRETS_VERSION;
+      hdr[3] = 0;
+      memcpy(&hdr[4], _secrets_tag, sizeof(_secrets_tag));
+      if (secrets && secrets.write(hdr, sizeof(hdr)) != sizeof(hdr)) secrets.close();
+    }
+
     uint32_t idx = 0;
     ContactInfo c;
-    uint8_t unused = 0;
+    int n = 0, s = 0;
 
     while (host->getContactForSave(idx, c)) {
-      bool success = (file.write(c.id.pub_key, 32) == 32);
-      success = success && (file.write((uint8_t *)&c.name, 32) == 32);
-      success = success && (file.write(&c.type, 1) == 1);
-      success = success && (file.write(&c.flags, 1) == 1);
-      success = success && (file.write(&unused, 1) == 1);
-      success = success && (file.write((uint8_t *)&c.sync_since, 4) == 4);
-      success = success && (file.write((uint8_t *)&c.out_path_len, 1) == 1);
-      success = success && (file.write((uint8_t *)&c.last_advert_timestamp, 4) == 4);
-      success = success && (file.write(c.out_path, 64) == 64);
-      success = success && (file.write((uint8_t *)&c.lastmod, 4) == 4);
-      success = success && (file.write((uint8_t *)&c.gps_lat, 4) == 4);
-      success = success && (file.write((uint8_t *)&c.gps_lon, 4) == 4);
-
-      if (!success) break; // write failed
-
+      packContact(&io_buf[n], c);
+      n += CONTACT_REC_SIZE;
+      if (secrets) {
+        memcpy(&secrets_buf[s], c.id.pub_key, CIPHER_BLOCK_SIZE);
+        _secrets_key.cryptCTR(&secrets_buf[s + CIPHER_BLOCK_SIZE], c.shared_secret, PUB_KEY_SIZE, c.id.pub_key);
+        s += SECRET_REC_SIZE;
+      }
+      if (n == sizeof(io_buf)) {
+        if (file.write(io_buf, n) != n) { n = 0; break; } // write failed
+        n = 0;
+        if (secrets && secrets.write(secrets_buf, s) != s) secrets.close();   // (a short file just means fewer cached)
+        s = 0;
+      }
       idx++;  // advance to next contact
     }
+    if (n > 0) file.write(io_buf, n);
     file.close();
+    if (secrets) {
+      if (s > 0) secrets.write(secrets_buf, s);
+      secrets.close();
+    }
+
+    _getContactsChannelsFS()->remove("/contacts3.jnl");   // all now in /contacts3
+    _journal_recs = 0;
   }
 }
 
-void DataStore::loadChannels(DataStoreHost* host) {
-    File file = openRead(_getContactsChannelsFS(), "/channels2");
-    if (file) {
-      bool full = false;
-      uint8_t channel_idx = 0;
-      while (!full) {
-        ChannelDetails ch;
-        uint8_t unused[4];
+bool DataStore::appendJournal(uint8_t op, const ContactInfo& contact) {
+  if (_journal_recs >= MAX_JOURNAL_RECS) return false;   // time to compact
 
-        bool success = (file.read(unused, 4) == 4);
-        success = success && (file.read((uint8_t *)ch.name, 32) == 32);
-        success = success && (file.read((uint8_t *)ch.channel.secret, 32) == 32);
+  uint8_t rec[1 + CONTACT_REC_SIZE];
+  rec[0] = op;
+  packContact(&rec[1], contact);
+  bool success = flash_writer.write(_getContactsChannelsFS(), "/contacts3.jnl", rec, sizeof(rec), FLASH_WRITE_APPEND);
 
-        if (!success) break; // EOF
+  if (success) {
+    _journal_recs++;
+  } else {
+    _journal_recs = MAX_JOURNAL_RECS;   // may have left a partial record, so force a full rewrite
+  }
+  return success;
+}
 
-        if (host->onChannelLoaded(channel_idx, ch)) {
-          channel_idx++;
-        } else {
-          full = true;
-        }
-      }
-      file.close();
-    }
+bool DataStore::journalContact(const ContactInfo& contact) {
+  return appendJournal(JOURNAL_OP_PUT, contact);
 }
 
+bool DataStore::journalContactRemoved(const ContactInfo& contact) {
+  return appendJournal(JOURNAL_OP_REMOVE, contact);
+}
+
+#define CHANNEL_REC_SIZE     68
+#define CHANNEL_WRITE_RECS   8      // channel records per queued write
+
 void DataStore::saveChannels(DataStoreHost* host) {
-  File file = openWrite(_getContactsChannelsFS(), "/channels2");
-  if (file) {
-    uint8_t channel_idx = 0;
-    ChannelDetails ch;
-    uint8_t unused[4];
-    memset(unused, 0, 4);
-
-    while (host->getChannelForSave(channel_idx, ch)) {
-      bool success = (file.write(unused, 4) == 4);
-      success = success && (file.write((uint8_t *)ch.name, 32) == 32);
-      success = success && (file.write((uint8_t *)ch.channel.secret, 32) == 32);
-
-      if (!success) break; // write failed
-      channel_idx++;
+  LOOP_SCOPE(LOOP_SECT_STORE);
+  uint8_t buf[CHANNEL_WRITE_RECS*CHANNEL_REC_SIZE];
+  uint8_t channel_idx = 0;
+  ChannelDetails ch;
+  int n = 0;
+  uint8_t mode = FLASH_WRITE_REPLACE;
+
+  while (host->getChannelForSave(channel_idx, ch)) {
+    memset(&buf[n], 0, 4);   // unused
+    memcpy(&buf[n + 4], ch.name, 32);
+    memcpy(&buf[n + 36], ch.channel.secret, 32);
+    n += CHANNEL_REC_SIZE;
+    if (n == sizeof(buf)) {
+      if (!flash_writer.write(_getContactsChannelsFS(), "/channels2", buf, n, mode)) return; // write failed
+      mode = FLASH_WRITE_APPEND;
+      n = 0;
     }
-    file.close();
+    channel_idx++;
   }
+  if (n > 0 || mode == FLASH_WRITE_REPLACE) flash_writer.write(_getContactsChannelsFS(), "/channels2", buf, n, mode);
 }
 
-#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
-
 #define MAX_ADVERT_PKT_LEN   (2 + 32 + PUB_KEY_SIZE + 4 + SIGNATURE_SIZE + MAX_ADVERT_DATA_SIZE)
 
 struct BlobRec {
@@ -389,6 +619,7 @@ void DataStore::checkAdvBlobFile() {
   }
 }
 
+#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
 void DataStore::migrateToSecondaryFS() {
   // migrate old adv_blobs, contacts3 and channels2 files to secondary FS if they don't already exist
   if (!_fsExtra->exists("/adv_blobs")) {
@@ -497,17 +728,80 @@ void DataStore::migrateToSecondaryFS() {
   }
 }
 
+#endif
+
+struct BlobIndexEntry {    // in-RAM copy of each BlobRec's header, by slot
+  uint32_t timestamp;
+  uint8_t  key[7];
+};
+static BlobIndexEntry _blob_index[MAX_BLOBRECS];
+
+void DataStore::loadBlobIndex() {
+  flash_writer.flush();
+  memset(_blob_index, 0, sizeof(_blob_index));
+  File file = openRead(_getContactsChannelsFS(), "/adv_blobs");
+  if (file) {
+    for (int i = 0; i < MAX_BLOBRECS; i++) {
+      BlobRec tmp;
+      file.seek(i * sizeof(BlobRec));
+      if (file.read((uint8_t *) &tmp, sizeof(tmp.timestamp) + sizeof(tmp.key)) != sizeof(tmp.timestamp) + sizeof(tmp.key)) break;
+
+      _blob_index[i].timestamp = tmp.timestamp;
+      memcpy(_blob_index[i].key, tmp.key, sizeof(tmp.key));
+    }
+    file.close();
+  }
+  _blob_index_loaded = true;
+}
+
+int DataStore::findBlobSlot(const uint8_t key[], bool for_put) {
+  if (!_blob_index_loaded) loadBlobIndex();
+
+  int oldest = 0;
+  for (int i = 0; i < MAX_BLOBRECS; i++) {
+    if (memcmp(key, _blob_index[i].key, sizeof(_blob_index[i].key)) == 0) return i;  // only match by 7 byte prefix
+    if (_blob_index[i].timestamp < _blob_index[oldest].timestamp) oldest = i;
+  }
+  return for_put ? oldest : -1;
+}
+
 uint8_t DataStore::getBlobByKey(const uint8_t key[], int key_len, uint8_t dest_buf[]) {
+  int slot = findBlobSlot(key, false);
+#if !defined(NRF52_PLATFORM) && !defined(STM32_PLATFORM)
+  if (slot < 0) {   // check for blob from older firmware (one file per key), and move it to /adv_blobs
+    char path[64];
+    char fname[18];
+
+    if (key_len > 8) key_len = 8; // just use first 8 bytes (prefix)
+    mesh::Utils::toHex(fname, key, key_len);
+    sprintf(path, "/bl/%s", fname);
+
+    uint8_t len = 0;
+    if (_fs->exists(path)) {
+      File f = openRead(_fs, path);
+      if (f) {
+        len = f.read(dest_buf, MAX_ADVERT_PKT_LEN);
+        f.close();
+        putBlobByKey(key, key_len, dest_buf, len);
+      }
+      _fs->remove(path);
+    }
+    return len;
+  }
+#else
+  if (slot < 0) return 0;  // not found
+#endif
+
+  if (flash_writer.isPending("/adv_blobs")) flash_writer.flush();
   File file = openRead(_getContactsChannelsFS(), "/adv_blobs");
-  uint8_t len = 0;  // 0 = not found
+  uint8_t len = 0;
   if (file) {
     BlobRec tmp;
-    while (file.read((uint8_t *) &tmp, sizeof(tmp)) == sizeof(tmp)) {
-      if (memcmp(key, tmp.key, sizeof(tmp.key)) == 0) {  // only match by 7 byte prefix
-        len = tmp.len;
-        memcpy(dest_buf, tmp.data, len);
-        break;
-      }
+    file.seek(slot * sizeof(BlobRec));
+    if (file.read((uint8_t *) &tmp, sizeof(tmp)) == sizeof(tmp) && memcmp(key, tmp.key, sizeof(tmp.key)) == 0) {
+      len = tmp.len;
+      memcpy(dest_buf, tmp.data, len);
+      _blob_index[slot].timestamp = _clock->getCurrentTime();   // so is least recently USED which gets evicted (file keeps last put time)
     }
     file.close();
   }
@@ -517,76 +811,234 @@ uint8_t DataStore::getBlobByKey(const uint8_t key[], int key_len, uint8_t dest_b
 bool DataStore::putBlobByKey(const uint8_t key[], int key_len, const uint8_t src_buf[], uint8_t len) {
   if (len < PUB_KEY_SIZE+4+SIGNATURE_SIZE || len > MAX_ADVERT_PKT_LEN) return false;
   checkAdvBlobFile();
-  File file = _getContactsChannelsFS()->open("/adv_blobs", FILE_O_WRITE);
-  if (file) {
-    uint32_t pos = 0, found_pos = 0;
-    uint32_t min_timestamp = 0xFFFFFFFF;
+  int slot = findBlobSlot(key, true);   // matching key OR evict least recently used
+
+  BlobRec tmp;
+  memcpy(tmp.key, key, sizeof(tmp.key));  // just record 7 byte prefix of key
+  memcpy(tmp.data, src_buf, len);
+  tmp.len = len;
+  tmp.timestamp = _clock->getCurrentTime();
+
+  bool success = flash_writer.write(_getContactsChannelsFS(), "/adv_blobs", (uint8_t *) &tmp, sizeof(tmp), FLASH_WRITE_AT, slot * sizeof(BlobRec));
+  if (success) {
+    _blob_index[slot].timestamp = tmp.timestamp;
+    memcpy(_blob_index[slot].key, tmp.key, sizeof(tmp.key));
+  } else {
+    _blob_index_loaded = false;   // not sure what is in file now
+  }
+  return success;
+}
 
-    // search for matching key OR evict by oldest timestmap
-    BlobRec tmp;
-    file.seek(0);
-    while (file.read((uint8_t *) &tmp, sizeof(tmp)) == sizeof(tmp)) {
-      if (memcmp(key, tmp.key, sizeof(tmp.key)) == 0) {  // only match by 7 byte prefix
-        found_pos = pos;
-        break;
-      }
-      if (tmp.timestamp < min_timestamp) {
-        min_timestamp = tmp.timestamp;
-        found_pos = pos;
-      }
+#define MSG_LOG_CURSOR   "/msglog.cur"
+
+static void getMessageLogName(char* dest, uint16_t seg) {
+  sprintf(dest, "/msglog.%u", (uint32_t) seg);
+}
 
-      pos += sizeof(tmp);
+int DataStore::countMessages(uint16_t seg, uint32_t from_pos) {
+  char fname[24];
+  getMessageLogName(fname, seg);
+  File file = openRead(_getContactsChannelsFS(), fname);
+  int n = 0;
+  if (file) {
+    uint32_t size = file.size();
+    uint32_t pos = from_pos;
+    uint8_t len;
+    while (pos < size && file.seek(pos) && file.read(&len, 1) == 1 && pos + 1 + len <= size) {   // (ignore any partial record at end)
+      pos += 1 + len;
+      n++;
     }
+    file.close();
+  }
+  return n;
+}
 
-    memcpy(tmp.key, key, sizeof(tmp.key));  // just record 7 byte prefix of key
-    memcpy(tmp.data, src_buf, len);
-    tmp.len = len;
-    tmp.timestamp = _clock->getCurrentTime();
+void DataStore::loadMessageLog() {
+  _msg_read_seg = _msg_write_seg = 0;
+  _msg_read_pos = _msg_write_pos = 0;
+  _num_msgs = 0;
+#if MSG_LOG_SEGMENTS > 0
+  File file = openRead(_getContactsChannelsFS(), MSG_LOG_CURSOR);
+  if (file) {
+    file.read((uint8_t *) &_msg_read_seg, sizeof(_msg_read_seg));
+    file.read((uint8_t *) &_msg_read_pos, sizeof(_msg_read_pos));
+    file.close();
+  }
 
-    file.seek(found_pos);
-    file.write((uint8_t *) &tmp, sizeof(tmp));
+  // find the segments written since, and count what is left in them
+  char fname[24];
+  _msg_write_seg = _msg_read_seg;
+  bool found = false;
+  for (int i = 0; i < MSG_LOG_SEGMENTS; i++) {
+    uint16_t seg = _msg_read_seg + i;
+    getMessageLogName(fname, seg);
+    if (!_getContactsChannelsFS()->exists(fname)) break;
+    File f = openRead(_getContactsChannelsFS(), fname);
+    if (!f) break;
+
+    found = true;
+    _msg_write_seg = seg;
+    _msg_write_pos = f.size();
+    f.close();
+    _num_msgs += countMessages(seg, i == 0 ? _msg_read_pos : 0);
+  }
+  if (found && _num_msgs == 0) clearMessageLog();   // all were read before restart
+  if (!found) _msg_read_pos = 0;
+#endif
+}
 
+void DataStore::clearMessageLog() {
+  char fname[24];
+  for (uint16_t seg = _msg_read_seg; seg != (uint16_t)(_msg_write_seg + 1); seg++) {
+    getMessageLogName(fname, seg);
+    _getContactsChannelsFS()->remove(fname);
+  }
+  _msg_read_seg = _msg_write_seg = _msg_write_seg + 1;   // start afresh, in a new segment
+  _msg_read_pos = _msg_write_pos = 0;
+  _num_msgs = 0;
+  saveMessageCursor();
+}
+
+void DataStore::saveMessageCursor() {
+#if MSG_LOG_SEGMENTS > 0
+  File file = openWrite(_getContactsChannelsFS(), MSG_LOG_CURSOR);
+  if (file) {
+    file.write((uint8_t *) &_msg_read_seg, sizeof(_msg_read_seg));
+    file.write((uint8_t *) &_msg_read_pos, sizeof(_msg_read_pos));
     file.close();
-    return true;
   }
-  return false; // error
+#endif
 }
+
+bool DataStore::appendMessage(const uint8_t frame[], int len) {
+#if MSG_LOG_SEGMENTS > 0
+  if (len <= 0 || len > 255) return false;
+
+  char fname[24];
+  if (_msg_write_pos + 1 + len > MSG_LOG_SEGMENT_SIZE) {   // start next segment
+    if ((uint16_t)(_msg_write_seg - _msg_read_seg) + 1 >= MSG_LOG_SEGMENTS) {   // log is full, discard oldest segment
+      MESH_DEBUG_PRINTLN("WARN: message log is full, dropping oldest segment");
+      _num_msgs -= countMessages(_msg_read_seg, _msg_read_pos);
+      getMessageLogName(fname, _msg_read_seg);
+      _getContactsChannelsFS()->remove(fname);
+      _msg_read_seg++;
+      _msg_read_pos = 0;
+      saveMessageCursor();
+    }
+    _msg_write_seg++;
+    _msg_write_pos = 0;
+  }
+
+  getMessageLogName(fname, _msg_write_seg);
+  File file = openAppend(_getContactsChannelsFS(), fname);
+  if (!file) return false;
+
+  uint8_t l = len;
+  bool success = file.write(&l, 1) == 1 && file.write(frame, len) == len;
+  file.close();
+  if (!success) {
+    _msg_write_pos = MSG_LOG_SEGMENT_SIZE;   // may have left a partial record, so start a new segment next time
+    return false;
+  }
+  _msg_write_pos += 1 + len;
+  _num_msgs++;
+  return true;
 #else
-uint8_t DataStore::getBlobByKey(const uint8_t key[], int key_len, uint8_t dest_buf[]) {
-  char path[64];
-  char fname[18];
-
-  if (key_len > 8) key_len = 8; // just use first 8 bytes (prefix)
-  mesh::Utils::toHex(fname, key, key_len);
-  sprintf(path, "/bl/%s", fname);
-
-  if (_fs->exists(path)) {
-    File f = openRead(_fs, path);
-    if (f) {
-      int len = f.read(dest_buf, 255); // currently MAX 255 byte blob len supported!!
-      f.close();
+  return false;  // not enabled
+#endif
+}
+
+int DataStore::readMessage(uint8_t frame[], int max_len) {
+#if MSG_LOG_SEGMENTS > 0
+  char fname[24];
+  while (_num_msgs > 0) {
+    getMessageLogName(fname, _msg_read_seg);
+    File file = openRead(_getContactsChannelsFS(), fname);
+    uint8_t len = 0;
+    bool success = false;
+    if (file) {
+      file.seek(_msg_read_pos);
+      success = file.read(&len, 1) == 1 && len <= max_len && file.read(frame, len) == len;
+      file.close();
+    }
+    if (success) {
+      _msg_read_pos += 1 + len;
+      if (--_num_msgs == 0) clearMessageLog();   // all read
       return len;
     }
+    if (_msg_read_seg == _msg_write_seg) {   // shouldn't happen
+      clearMessageLog();
+      break;
+    }
+    _getContactsChannelsFS()->remove(fname);   // finished with this segment
+    _msg_read_seg++;
+    _msg_read_pos = 0;
+    saveMessageCursor();
   }
-  return 0; // not found
+#endif
+  return 0;  // log is empty
 }
 
-bool DataStore::putBlobByKey(const uint8_t key[], int key_len, const uint8_t src_buf[], uint8_t len) {
-  char path[64];
-  char fname[18];
-
-  if (key_len > 8) key_len = 8; // just use first 8 bytes (prefix)
-  mesh::Utils::toHex(fname, key, key_len);
-  sprintf(path, "/bl/%s", fname);
+#define MSG_HISTORY_FILE  "/msg_history"
 
-  File f = openWrite(_fs, path);
-  if (f) {
-    int n = f.write(src_buf, len);
-    f.close();
-    if (n == len) return true; // success!
+void DataStore::loadHistory() {
+  _history_next = 1;
+#if MSG_HISTORY_SIZE > 0
+  if (!_getContactsChannelsFS()->exists(MSG_HISTORY_FILE)) {
+    File file = openWrite(_getContactsChannelsFS(), MSG_HISTORY_FILE);
+    if (file) {
+      MsgHistoryEntry zeroes;
+      memset(&zeroes, 0, sizeof(zeroes));
+      for (int i = 0; i < MSG_HISTORY_SIZE; i++) {     // pre-allocate to fixed size
+        file.write((uint8_t *) &zeroes, sizeof(zeroes));
+      }
+      file.close();
+    }
+    return;
+  }
 
-    _fs->remove(path); // blob was only partially written!
+  File file = openRead(_getContactsChannelsFS(), MSG_HISTORY_FILE);
+  if (file) {
+    for (int slot = 0; slot < MSG_HISTORY_SIZE; slot++) {   // newest is the highest seq
+      uint32_t seq;
+      file.seek(slot * sizeof(MsgHistoryEntry));
+      if (file.read((uint8_t *) &seq, sizeof(seq)) != sizeof(seq)) break;
+      if (seq != 0 && seq % MSG_HISTORY_SIZE == slot && seq >= _history_next) _history_next = seq + 1;
+    }
+    file.close();
   }
-  return false; // error
+#endif
 }
+
+bool DataStore::appendHistory(MsgHistoryEntry& entry) {
+#if MSG_HISTORY_SIZE > 0
+  File file = openReadWrite(_getContactsChannelsFS(), MSG_HISTORY_FILE);
+  if (!file) return false;
+
+  entry.seq = _history_next;
+  file.seek((entry.seq % MSG_HISTORY_SIZE) * sizeof(MsgHistoryEntry));
+  bool success = file.write((uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+  file.close();
+
+  if (success) _history_next++;
+  return success;
+#else
+  return false;  // not enabled
+#endif
+}
+
+bool DataStore::readHistory(uint32_t seq, MsgHistoryEntry& entry) {
+#if MSG_HISTORY_SIZE > 0
+  if (seq < getHistoryFirst() || seq >= _history_next) return false;
+
+  File file = openRead(_getContactsChannelsFS(), MSG_HISTORY_FILE);
+  if (!file) return false;
+
+  file.seek((seq % MSG_HISTORY_SIZE) * sizeof(MsgHistoryEntry));
+  bool success = file.read((uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+  file.close();
+  return success && entry.seq == seq;
+#else
+  return false;
 #endif
+}
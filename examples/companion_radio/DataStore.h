@@ -3,12 +3,44 @@
 #include <helpers/IdentityStore.h>
 #include <helpers/ContactInfo.h>
 #include <helpers/ChannelDetails.h>
+#include <helpers/PrefsFile.h>
 #include "NodePrefs.h"
 
+#ifndef MSG_LOG_SEGMENTS
+  #if defined(ESP32) || defined(RP2040_PLATFORM) || defined(EXTRAFS) || defined(QSPIFLASH)
+    #define MSG_LOG_SEGMENTS  8    // max segment files of queued messages (zero to disable)
+  #else
+    #define MSG_LOG_SEGMENTS  0    // not enough flash
+  #endif
+#endif
+
+#ifndef MSG_LOG_SEGMENT_SIZE
+  #define MSG_LOG_SEGMENT_SIZE  4096
+#endif
+
+#ifndef MSG_HISTORY_SIZE
+  #if !defined(DISPLAY_CLASS)
+    #define MSG_HISTORY_SIZE  0      // only kept for the UI
+  #elif defined(ESP32) || defined(RP2040_PLATFORM) || defined(EXTRAFS) || defined(QSPIFLASH)
+    #define MSG_HISTORY_SIZE  256    // received messages kept for the UI to page through (zero to disable)
+  #else
+    #define MSG_HISTORY_SIZE  32
+  #endif
+#endif
+
+struct MsgHistoryEntry {    // 128 bytes, fixed slot in /msg_history
+  uint32_t seq;             // 1..  (zero is an empty slot)
+  uint32_t timestamp;
+  uint8_t path_len;         // 0xFF if direct
+  char origin[32];          // contact or channel name
+  char text[87];
+};
+
 class DataStoreHost {
 public:
-  virtual bool onContactLoaded(const ContactInfo& contact) =0;
+  virtual bool onContactLoaded(const ContactInfo& contact, bool has_secret) =0;   // has_secret: contact.shared_secret is valid
   virtual bool getContactForSave(uint32_t idx, ContactInfo& contact) =0;
+  virtual void onContactRemoved(const uint8_t* pub_key) =0;   // (when replaying the contacts journal)
   virtual bool onChannelLoaded(uint8_t channel_idx, const ChannelDetails& ch) =0;
   virtual bool getChannelForSave(uint8_t channel_idx, ChannelDetails& ch) =0;
 };
@@ -17,12 +49,36 @@ class DataStore {
   FILESYSTEM* _fs;
   FILESYSTEM* _fsExtra;
   mesh::RTCClock* _clock;
+  PrefsFile _prefs_file;
   IdentityStore identity_store;
+  uint16_t _journal_recs;
+  uint16_t _msg_read_seg, _msg_write_seg;
+  uint32_t _msg_read_pos, _msg_write_pos;
+  int _num_msgs;
+  uint32_t _history_next;
+  File _load_file;   // for the incremental load (see beginLoad())
+  uint8_t _load_stage;
+  bool _load_channels;
+  uint16_t _load_have;
+  uint8_t _load_channel_idx;
+  File _secrets_file;   // read in step with /contacts3, during a load
+  mesh::CipherKey _secrets_key;
+  uint8_t _secrets_tag[8];
+  bool _secrets_enabled, _secrets_missing;
+
+  bool appendJournal(uint8_t op, const ContactInfo& contact);
+  void loadMessageLog();
+  int countMessages(uint16_t seg, uint32_t from_pos);
+  void clearMessageLog();
+  void loadHistory();
+  void nextLoadStage();
+  bool readSecret(ContactInfo& c);
 
   void loadPrefsInt(const char *filename, NodePrefs& prefs, double& node_lat, double& node_lon);
-#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+  void unpackPrefs(const uint8_t* blob, int len, NodePrefs& prefs, double& node_lat, double& node_lon);
   void checkAdvBlobFile();
-#endif
+  void loadBlobIndex();
+  int findBlobSlot(const uint8_t key[], bool for_put);
 
 public:
   DataStore(FILESYSTEM& fs, mesh::RTCClock& clock);
@@ -34,10 +90,38 @@ public:
   bool loadMainIdentity(mesh::LocalIdentity &identity);
   bool saveMainIdentity(const mesh::LocalIdentity &identity);
   void loadPrefs(NodePrefs& prefs, double& node_lat, double& node_lon);
-  void savePrefs(const NodePrefs& prefs, double node_lat, double node_lon);
-  void loadContacts(DataStoreHost* host);
-  void saveContacts(DataStoreHost* host);
-  void loadChannels(DataStoreHost* host);
+  bool savePrefs(const NodePrefs& prefs, double node_lat, double node_lon);
+  void loadContacts(DataStoreHost* host);   // all at once (see beginLoad())
+  void saveContacts(DataStoreHost* host);   // rewrites all contacts, and clears the journal
+  bool journalContact(const ContactInfo& contact);   // returns false if journal is full (ie. needs a saveContacts())
+  bool journalContactRemoved(const ContactInfo& contact);
+
+  /**
+   * \brief  starts an incremental load of the contacts (and journal), then the channels, which loadStep() then does a
+   *     few records at a time, eg. from loop(), so a big contacts file doesn't hold up the rest of startup.
+  */
+  void beginLoad(bool with_channels=true);
+  /** \returns  true when all loaded */
+  bool loadStep(DataStoreHost* host, int max_recs);
+
+  /**
+   * \brief  enables the cache of contacts' shared secrets, saved alongside /contacts3 (encrypted with a key derived from
+   *     'self'), so loading contacts doesn't need an ECDH key exchange per contact. Must be called again if the identity changes.
+  */
+  void setSecretsIdentity(mesh::LocalIdentity& self);
+  bool needsSecretsSave() const { return _secrets_missing; }   // some contacts in /contacts3 were loaded without a cached secret
+
+  // persistent log of message frames, for when the offline queue (in RAM) is full
+  bool appendMessage(const uint8_t frame[], int len);   // false if not enabled (or error)
+  int readMessage(uint8_t frame[], int max_len);   // oldest message, or returns zero if log empty
+  int getNumMessages() const { return _num_msgs; }
+  void saveMessageCursor();
+
+  // ring of recently received messages (by seq), so the UI can page through them without holding them in RAM
+  bool appendHistory(MsgHistoryEntry& entry);   // assigns entry.seq
+  bool readHistory(uint32_t seq, MsgHistoryEntry& entry);   // false if not (or no longer) held
+  uint32_t getHistoryNext() const { return _history_next; }   // seq the next entry will get
+  uint32_t getHistoryFirst() const { return _history_next > MSG_HISTORY_SIZE ? _history_next - MSG_HISTORY_SIZE : 1; }
   void saveChannels(DataStoreHost* host);
   void migrateToSecondaryFS();
   uint8_t getBlobByKey(const uint8_t key[], int key_len, uint8_t dest_buf[]);
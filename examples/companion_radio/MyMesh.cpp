@@ -4,9 +4,9 @@
 #include <Mesh.h>
 
 #define CMD_APP_START                 1
-#define CMD_SEND_TXT_MSG              2
+#define CMD_SEND_TXT_MSG              2   // 'attempt' byte may have TXT_SEND_FLAG_AUTO_RETRY
 #define CMD_SEND_CHANNEL_TXT_MSG      3
-#define CMD_GET_CONTACTS              4 // with optional 'since' (for efficient sync)
+#define CMD_GET_CONTACTS              4 // with optional 'since' (for efficient sync), then optional flags
 #define CMD_GET_DEVICE_TIME           5
 #define CMD_SET_DEVICE_TIME           6
 #define CMD_SEND_SELF_ADVERT          7
@@ -49,15 +49,32 @@
 // NOTE: CMD range 44..49 parked, potentially for WiFi operations
 #define CMD_SEND_BINARY_REQ           50
 #define CMD_FACTORY_RESET             51
-#define CMD_SEND_PATH_DISCOVERY_REQ   52
+#define CMD_SEND_PATH_DISCOVERY_REQ   52   // second byte is flags, see below
 #define CMD_SET_FLOOD_SCOPE           54   // v8+
 #define CMD_SEND_CONTROL_DATA         55   // v8+
 #define CMD_GET_STATS                 56   // v8+, second byte is stats type
+#define CMD_SYNC_MESSAGES_BATCH       57   // second byte is max messages (zero for all)
+#define CMD_SET_RAW_MODE              58   // second byte: 1 = raw mode on, 0 = off
+#define CMD_SEND_RAW_PACKET           59   // priority(1), delay_millis(2), then packet (over-the-air format)
+#define CMD_IMPORT_CONTACTS           60   // flags(1), then one or more of: advert_len(1), advert (as per CMD_IMPORT_CONTACT)
+#define CMD_EXPORT_CONTACTS           61   // with optional 'since'
+#define CMD_SET_PUSH_COALESCE         62   // second byte: 1 = PUSH_CODE_ADVERTS/_PATHS_UPDATED instead of one push per contact
+
+// Flag in 'attempt' of CMD_SEND_TXT_MSG: firmware does the retries, then PUSH_CODE_SEND_CONFIRMED or PUSH_CODE_SEND_FAILED
+#define TXT_SEND_FLAG_AUTO_RETRY      0x80
+
+// Flags for CMD_SEND_PATH_DISCOVERY_REQ
+#define PATH_DISCOVERY_FLAG_SELECT    0x01   // collect all replies, probe each path, and keep best two (see BaseChatMesh)
 
 // Stats sub-types for CMD_GET_STATS
 #define STATS_TYPE_CORE               0
 #define STATS_TYPE_RADIO              1
 #define STATS_TYPE_PACKETS             2
+#define STATS_TYPE_LATENCY             3
+#define STATS_TYPE_UI                  4
+#define STATS_TYPE_MEMORY              5
+#define STATS_TYPE_PROFILE             6   // optional third byte: payload type (default: all)
+#define STATS_TYPE_LOOP                7
 
 #define RESP_CODE_OK                  0
 #define RESP_CODE_ERR                 1
@@ -84,12 +101,28 @@
 #define RESP_CODE_ADVERT_PATH         22
 #define RESP_CODE_TUNING_PARAMS       23
 #define RESP_CODE_STATS               24   // v8+, second byte is stats type
+#define RESP_CODE_CONTACTS_COMPACT    25   // multiple contacts per frame (after CMD_GET_CONTACTS, with CONTACTS_FLAG_COMPACT)
+#define RESP_CODE_CONTACTS_REMOVED    26   // pub_keys of contacts removed since 'since' (ditto)
+#define RESP_CODE_CONTACTS_IMPORTED   27   // reply to last CMD_IMPORT_CONTACTS: num imported(2), num rejected(2)
+#define RESP_CODE_EXPORT_CONTACTS     28   // multiple of: advert_len(1), advert (after CMD_EXPORT_CONTACTS)
 
 #define SEND_TIMEOUT_BASE_MILLIS        500
 #define FLOOD_SEND_TIMEOUT_FACTOR       16.0f
 #define DIRECT_SEND_PERHOP_FACTOR       6.0f
 #define DIRECT_SEND_PERHOP_EXTRA_MILLIS 250
 #define LAZY_CONTACTS_WRITE_DELAY       5000
+#define BULK_IMPORT_IDLE_MILLIS         30000   // CMD_IMPORT_CONTACTS without the IMPORT_FLAG_END, so end it after this
+#define ADVERT_UI_NOTIFY_MILLIS         5000    // at most one UI notify for adverts per this (eg. during an advert wave)
+
+#ifndef BOOT_LOAD_RECS_PER_LOOP
+  #define BOOT_LOAD_RECS_PER_LOOP       8      // contacts/channels loaded per loop(), at startup
+#endif
+#define BOOT_RX_HOLD_MILLIS             20     // re-check interval, for packets held until contacts loaded
+
+#ifndef TABLES_SAVE_INTERVAL_SECS
+  #define TABLES_SAVE_INTERVAL_SECS     600    // how often to snapshot the packet dedup tables (if changed)
+#endif
+#define TABLES_SNAPSHOT_FILE            "/mesh_tables"
 
 #define PUBLIC_GROUP_PSK                "izOH6cXN6mrJ5e26oRXNcg=="
 
@@ -109,6 +142,15 @@
 #define PUSH_CODE_BINARY_RESPONSE       0x8C
 #define PUSH_CODE_PATH_DISCOVERY_RESPONSE 0x8D
 #define PUSH_CODE_CONTROL_DATA          0x8E   // v8+
+#define PUSH_CODE_STATS_PUSH            0x8F   // periodic stats from a repeater we subscribed to
+#define PUSH_CODE_SEND_FAILED           0x90   // message sent with TXT_SEND_FLAG_AUTO_RETRY was never ACKed
+#define PUSH_CODE_RAW_TX_DONE           0x91   // (raw mode) a packet has been transmitted, with its packet hash
+#define PUSH_CODE_CHAN_QUEUE_DEPTH      0x92   // channel messages still waiting to be sent (paced), and queue capacity
+#define PUSH_CODE_ADVERTS               0x93   // count, then pub_key prefixes (6 bytes each), see PushCoalescer
+#define PUSH_CODE_PATHS_UPDATED         0x94   // ditto
+#define PUSH_CODE_BINARY_RESPONSE_PART  0x95   // part of a RESPONSE too big for one frame (sent in MULTIPART fragments)
+
+#define STATS_PUSH_MARKER               0xF5   // first byte after tag, in a (repeater) stats push
 
 #define ERR_CODE_UNSUPPORTED_CMD        1
 #define ERR_CODE_NOT_FOUND              2
@@ -118,6 +160,11 @@
 #define ERR_CODE_ILLEGAL_ARG            6
 
 #define MAX_SIGN_DATA_LEN               (8 * 1024) // 8K
+#define MAX_SIGN_PREHASH_LEN            0xFFFFFFFF // not buffered
+
+#define SIGN_MODE_NONE                  0
+#define SIGN_MODE_PURE                  1   // Ed25519 over the buffered message
+#define SIGN_MODE_PREHASH               2   // Ed25519ph, hashed as it streams in
 
 void MyMesh::writeOKFrame() {
   uint8_t buf[1];
@@ -137,6 +184,39 @@ void MyMesh::writeDisabledFrame() {
   _serial->writeFrame(buf, 1);
 }
 
+#define CONTACTS_FLAG_COMPACT   0x01   // for CMD_GET_CONTACTS
+#define IMPORT_FLAG_END         0x01   // for CMD_IMPORT_CONTACTS, last frame of the batch
+
+int MyMesh::writeCompactContact(uint8_t* dest, int max_len, const ContactInfo &contact) {
+  int path_len = contact.out_path_len > 0 ? mesh::Packet::decodePathBytes(contact.out_path_len) : 0;
+  int name_len = strnlen(contact.name, sizeof(contact.name) - 1);
+  int len = PUB_KEY_SIZE + 3 + path_len + 1 + name_len + 16;
+  if (len > max_len) return 0;   // won't fit
+
+  int i = 0;
+  memcpy(&dest[i], contact.id.pub_key, PUB_KEY_SIZE); i += PUB_KEY_SIZE;
+  dest[i++] = contact.type;
+  dest[i++] = contact.flags;
+  dest[i++] = contact.out_path_len;
+  memcpy(&dest[i], contact.out_path, path_len); i += path_len;
+  dest[i++] = name_len;
+  memcpy(&dest[i], contact.name, name_len); i += name_len;
+  memcpy(&dest[i], &contact.last_advert_timestamp, 4); i += 4;
+  memcpy(&dest[i], &contact.gps_lat, 4); i += 4;
+  memcpy(&dest[i], &contact.gps_lon, 4); i += 4;
+  memcpy(&dest[i], &contact.lastmod, 4); i += 4;
+  return i;
+}
+
+void MyMesh::recordRemovedContact(const uint8_t* pub_key) {
+  RemovedContact* r = &removed_contacts[next_removed];
+  next_removed = (next_removed + 1) % REMOVED_CONTACTS_SIZE;
+  if (r->removed > removed_unknown_until) removed_unknown_until = r->removed;   // evicting, so removals before this are now unknown
+
+  memcpy(r->pub_key, pub_key, PUB_KEY_SIZE);
+  r->removed = getRTCClock()->getCurrentTime();
+}
+
 void MyMesh::writeContactRespFrame(uint8_t code, const ContactInfo &contact) {
   int i = 0;
   out_frame[i++] = code;
@@ -190,41 +270,62 @@ bool MyMesh::Frame::isChannelMsg() const {
 }
 
 void MyMesh::addToOfflineQueue(const uint8_t frame[], int len) {
+  if (offline_queue_len >= OFFLINE_QUEUE_SIZE || _store->getNumMessages() > 0) {
+    if (_store->appendMessage(frame, len)) return;   // spilled over to flash (after any already there, to keep order)
+  }
+
+  Frame* dest;
   if (offline_queue_len >= OFFLINE_QUEUE_SIZE) {
     MESH_DEBUG_PRINTLN("WARN: offline_queue is full!");
     int pos = 0;
-    while (pos < offline_queue_len) {
-      if (offline_queue[pos].isChannelMsg()) {
-        for (int i = pos; i < offline_queue_len - 1; i++) { // delete oldest channel msg from queue
-          offline_queue[i] = offline_queue[i + 1];
-        }
-        MESH_DEBUG_PRINTLN("INFO: removed oldest channel message from queue.");
-        offline_queue[offline_queue_len - 1].len = len;
-        memcpy(offline_queue[offline_queue_len - 1].buf, frame, len);
-        return;
-      }
+    while (pos < offline_queue_len && !offline_frames[offline_queue[(offline_queue_head + pos) % OFFLINE_QUEUE_SIZE]].isChannelMsg()) {
       pos++;
     }
-    MESH_DEBUG_PRINTLN("INFO: no channel messages to remove from queue.");
+    if (pos >= offline_queue_len) {
+      MESH_DEBUG_PRINTLN("INFO: no channel messages to remove from queue.");
+      return;
+    }
+    // delete oldest channel msg from queue, then re-use its frame for the new one (at end of queue)
+    uint16_t idx = offline_queue[(offline_queue_head + pos) % OFFLINE_QUEUE_SIZE];
+    for ( ; pos < offline_queue_len - 1; pos++) {
+      offline_queue[(offline_queue_head + pos) % OFFLINE_QUEUE_SIZE] = offline_queue[(offline_queue_head + pos + 1) % OFFLINE_QUEUE_SIZE];
+    }
+    offline_queue[(offline_queue_head + pos) % OFFLINE_QUEUE_SIZE] = idx;
+    MESH_DEBUG_PRINTLN("INFO: removed oldest channel message from queue.");
+    dest = &offline_frames[idx];
   } else {
-    offline_queue[offline_queue_len].len = len;
-    memcpy(offline_queue[offline_queue_len].buf, frame, len);
+    dest = &offline_frames[offline_queue[(offline_queue_head + offline_queue_len) % OFFLINE_QUEUE_SIZE]];   // next free frame
     offline_queue_len++;
   }
+  dest->len = len;
+  memcpy(dest->buf, frame, len);
 }
 
 int MyMesh::getFromOfflineQueue(uint8_t frame[]) {
   if (offline_queue_len > 0) {         // check offline queue
-    size_t len = offline_queue[0].len; // take from top of queue
-    memcpy(frame, offline_queue[0].buf, len);
+    const Frame* src = &offline_frames[offline_queue[offline_queue_head]]; // take from top of queue
+    size_t len = src->len;
+    memcpy(frame, src->buf, len);
 
+    offline_queue_head = (offline_queue_head + 1) % OFFLINE_QUEUE_SIZE;   // (its frame is now last of the free ones)
     offline_queue_len--;
-    for (int i = 0; i < offline_queue_len; i++) { // delete top item from queue
-      offline_queue[i] = offline_queue[i + 1];
-    }
     return len;
   }
-  return 0; // queue is empty
+  return _store->readMessage(frame, MAX_FRAME_SIZE);   // then any which spilled over to flash
+}
+
+void MyMesh::addToHistory(uint8_t path_len, const char* origin, const char* text) {
+  MsgHistoryEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.timestamp = getRTCClock()->getCurrentTime();
+  entry.path_len = path_len;
+  StrHelper::strncpy(entry.origin, origin, sizeof(entry.origin));
+  StrHelper::strncpy(entry.text, text, sizeof(entry.text));
+  _store->appendHistory(entry);   // (just not kept if history disabled)
+}
+
+int MyMesh::getNumQueuedMessages() const {
+  return offline_queue_len + _store->getNumMessages();
 }
 
 float MyMesh::getAirtimeBudgetFactor() const {
@@ -235,9 +336,9 @@ int MyMesh::getInterferenceThreshold() const {
   return 0; // disabled for now, until currentRSSI() problem is resolved
 }
 
-int MyMesh::calcRxDelay(float score, uint32_t air_time) const {
-  if (_prefs.rx_delay_base <= 0.0f) return 0;
-  return (int)((pow(_prefs.rx_delay_base, 0.85f - score) - 1.0) * air_time);
+float MyMesh::getRxDelayBase() const {
+  if (_raw_mode) return 0;   // host does its own scheduling of any retransmits
+  return _prefs.rx_delay_base;
 }
 
 uint8_t MyMesh::getExtraAckTransmitCount() const {
@@ -257,6 +358,38 @@ void MyMesh::logRxRaw(float snr, float rssi, const uint8_t raw[], int len) {
   }
 }
 
+void MyMesh::logTx(mesh::Packet* pkt, int len) {
+  if (_raw_mode && _serial->isConnected()) {
+    out_frame[0] = PUSH_CODE_RAW_TX_DONE;
+    pkt->calculatePacketHash(&out_frame[1]);
+    _serial->writeFrame(out_frame, 1 + MAX_HASH_SIZE);
+  }
+  if (chan_tx_pending && pkt->getPayloadType() == PAYLOAD_TYPE_GRP_TXT) {
+    uint8_t hash[MAX_HASH_SIZE];
+    pkt->calculatePacketHash(hash);
+    if (memcmp(hash, chan_sent_hash, MAX_HASH_SIZE) == 0) {   // our last channel send has now gone out
+      chan_tx_pending = false;
+      chan_sent_at = _ms->getMillis();
+      chan_sent_airtime = _radio->getEstAirtimeFor(len);
+    }
+  }
+}
+
+void MyMesh::logRx(mesh::Packet* pkt, int len, float score) {
+  if (chan_sent_at && !chan_tx_pending && pkt->isRouteFlood() && pkt->getPayloadType() == PAYLOAD_TYPE_GRP_TXT) {
+    unsigned long now = _ms->getMillis();
+    uint32_t delay = now - chan_sent_at;
+    if (delay < CHAN_ECHO_MAX_MILLIS) {
+      uint8_t hash[MAX_HASH_SIZE];
+      pkt->calculatePacketHash(hash);
+      if (memcmp(hash, chan_sent_hash, MAX_HASH_SIZE) == 0) {   // a rebroadcast of our last channel send
+        chan_echo_at = now;
+        chan_echo_delay = delay;
+      }
+    }
+  }
+}
+
 bool MyMesh::isAutoAddEnabled() const {
   return (_prefs.manual_add_contacts & 1) == 0;
 }
@@ -265,6 +398,10 @@ void MyMesh::onDiscoveredContact(ContactInfo &contact, bool is_new, uint8_t path
   if (_serial->isConnected()) {
     if (!isAutoAddEnabled() && is_new) {
       writeContactRespFrame(PUSH_CODE_NEW_ADVERT, contact);
+    } else if (_bulk_import) {
+      // (app needn't be told about contacts it is importing)
+    } else if (_push_coalesce) {
+      pushes.addKey(PUSH_KIND_ADVERT, contact.id.pub_key, _ms->getMillis());   // batched, in checkPushes()
     } else {
       out_frame[0] = PUSH_CODE_ADVERT;
       memcpy(&out_frame[1], contact.id.pub_key, PUB_KEY_SIZE);
@@ -272,12 +409,12 @@ void MyMesh::onDiscoveredContact(ContactInfo &contact, bool is_new, uint8_t path
     }
   } else {
 #ifdef DISPLAY_CLASS
-    if (_ui) _ui->notify(UIEventType::newContactMessage);
+    advert_notify_pending = true;   // batched, in loop()
 #endif
   }
 
   // add inbound-path to mem cache
-  if (path && path_len <= sizeof(AdvertPath::path)) {  // check path is valid
+  if (path && mesh::Packet::decodePathBytes(path_len) <= sizeof(AdvertPath::path)) {  // check path is valid
     AdvertPath* p = advert_paths;
     uint32_t oldest = 0xFFFFFFFF;
     for (int i = 0; i < ADVERT_PATH_TABLE_SIZE; i++) {   // check if already in table, otherwise evict oldest
@@ -294,11 +431,13 @@ void MyMesh::onDiscoveredContact(ContactInfo &contact, bool is_new, uint8_t path
     memcpy(p->pubkey_prefix, contact.id.pub_key, sizeof(p->pubkey_prefix));
     strcpy(p->name, contact.name);
     p->recv_timestamp = getRTCClock()->getCurrentTime();
-    p->path_len = path_len;
-    memcpy(p->path, path, p->path_len);
+    p->path_len = path_len;   // (encoded)
+    memcpy(p->path, path, mesh::Packet::decodePathBytes(p->path_len));
   }
 
-  dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);
+  if (lookupContactByPubKey(contact.id.pub_key, PUB_KEY_SIZE)) {   // only if was added (ie. auto-add is on)
+    markContactDirty(contact.id.pub_key);
+  }
 }
 
 static int sort_by_recent(const void *a, const void *b) {
@@ -315,12 +454,86 @@ int MyMesh::getRecentlyHeard(AdvertPath dest[], int max_num) {
   return max_num;
 }
 
-void MyMesh::onContactPathUpdated(const ContactInfo &contact) {
-  out_frame[0] = PUSH_CODE_PATH_UPDATED;
-  memcpy(&out_frame[1], contact.id.pub_key, PUB_KEY_SIZE);
-  _serial->writeFrame(out_frame, 1 + PUB_KEY_SIZE); // NOTE: app may not be connected
+bool MyMesh::onContactLoaded(const ContactInfo& contact, bool has_secret) {
+  ContactInfo* existing = lookupContactByPubKey(contact.id.pub_key, PUB_KEY_SIZE);
+  if (existing) {   // a later version, from the journal
+    uint8_t secret[PUB_KEY_SIZE];
+    memcpy(secret, existing->shared_secret, sizeof(secret));   // (not in journal)
+    *existing = contact;
+    memcpy(existing->shared_secret, secret, sizeof(secret));
+    return true;
+  }
+  return addContact(contact, !has_secret);
+}
+
+void MyMesh::onContactsLoaded() {
+  if (_store->needsSecretsSave()) {   // eg. first boot with the secrets cache, so rewrite /contacts3 (lazily) to create it
+    num_dirty_contacts = -1;
+    dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);
+  }
+}
+
+void MyMesh::onContactRemoved(const uint8_t* pub_key) {
+  ContactInfo* existing = lookupContactByPubKey(pub_key, PUB_KEY_SIZE);
+  if (existing) removeContact(*existing);
+}
 
+void MyMesh::markContactDirty(const uint8_t* pub_key) {
+  if (_bulk_import) {   // whole list is written once, at end of import
+    num_dirty_contacts = -1;
+    return;
+  }
   dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);
+  if (num_dirty_contacts < 0) return;   // already need to rewrite all
+
+  for (int i = 0; i < num_dirty_contacts; i++) {
+    if (memcmp(dirty_contacts[i], pub_key, PUB_KEY_SIZE) == 0) return;   // already marked
+  }
+  if (num_dirty_contacts < MAX_DIRTY_CONTACTS) {
+    memcpy(dirty_contacts[num_dirty_contacts++], pub_key, PUB_KEY_SIZE);
+  } else {
+    num_dirty_contacts = -1;
+  }
+}
+
+void MyMesh::finishBulkImport() {
+  _bulk_import = false;
+  if (num_dirty_contacts != 0) {
+    saveContacts();   // one write for the whole batch
+    dirty_contacts_expiry = 0;
+  }
+}
+
+void MyMesh::saveDirtyContacts() {
+  bool success = num_dirty_contacts >= 0;
+  for (int i = 0; success && i < num_dirty_contacts; i++) {
+    ContactInfo* c = lookupContactByPubKey(dirty_contacts[i], PUB_KEY_SIZE);
+    if (c) {
+      success = _store->journalContact(*c);
+    } else {   // has been removed
+      ContactInfo removed;
+      memset(&removed, 0, sizeof(removed));
+      removed.id = mesh::Identity(dirty_contacts[i]);
+      success = _store->journalContactRemoved(removed);
+    }
+  }
+  if (success) {
+    num_dirty_contacts = 0;
+  } else {
+    saveContacts();   // too many changes, or journal is full, so compact everything into /contacts3
+  }
+}
+
+void MyMesh::onContactPathUpdated(const ContactInfo &contact) {
+  if (_push_coalesce) {
+    pushes.addKey(PUSH_KIND_PATH_UPDATED, contact.id.pub_key, _ms->getMillis());   // batched, in checkPushes()
+  } else {
+    out_frame[0] = PUSH_CODE_PATH_UPDATED;
+    memcpy(&out_frame[1], contact.id.pub_key, PUB_KEY_SIZE);
+    _serial->writeFrame(out_frame, 1 + PUB_KEY_SIZE); // NOTE: app may not be connected
+  }
+
+  markContactDirty(contact.id.pub_key);
 }
 
 ContactInfo*  MyMesh::processAck(const uint8_t *data) {
@@ -354,7 +567,7 @@ void MyMesh::queueMessage(const ContactInfo &from, uint8_t txt_type, mesh::Packe
   }
   memcpy(&out_frame[i], from.id.pub_key, 6);
   i += 6; // just 6-byte prefix
-  uint8_t path_len = out_frame[i++] = pkt->isRouteFlood() ? pkt->path_len : 0xFF;
+  uint8_t path_len = out_frame[i++] = pkt->isRouteFlood() ? mesh::Packet::decodePathHops(pkt->getEncodedPathLen()) : 0xFF;
   out_frame[i++] = txt_type;
   memcpy(&out_frame[i], &sender_timestamp, 4);
   i += 4;
@@ -371,16 +584,15 @@ void MyMesh::queueMessage(const ContactInfo &from, uint8_t txt_type, mesh::Packe
   addToOfflineQueue(out_frame, i);
 
   if (_serial->isConnected()) {
-    uint8_t frame[1];
-    frame[0] = PUSH_CODE_MSG_WAITING; // send push 'tickle'
-    _serial->writeFrame(frame, 1);
+    pushes.addTickle();   // send push 'tickle' (one per burst of messages, see checkPushes())
   }
 
 #ifdef DISPLAY_CLASS
   // we only want to show text messages on display, not cli data
   bool should_display = txt_type == TXT_TYPE_PLAIN || txt_type == TXT_TYPE_SIGNED_PLAIN;
   if (should_display && _ui) {
-    _ui->newMsg(path_len, from.name, text, offline_queue_len);
+    addToHistory(path_len, from.name, text);
+    _ui->newMsg(path_len, from.name, text, getNumQueuedMessages());
     if (!_serial->isConnected()) {
       _ui->notify(UIEventType::contactMessage);
     }
@@ -388,6 +600,17 @@ void MyMesh::queueMessage(const ContactInfo &from, uint8_t txt_type, mesh::Packe
 #endif
 }
 
+mesh::DispatcherAction MyMesh::onRecvPacket(mesh::Packet* pkt) {
+  if (_raw_mode) {   // host has already been sent the raw frame (see logRxRaw()), and does all the processing
+    return ACTION_RELEASE;
+  }
+  if (_boot_loading) {   // contacts not all loaded yet, so hold (in the inbound queue) until they are
+    _mgr->queueInbound(pkt, futureMillis(BOOT_RX_HOLD_MILLIS));
+    return ACTION_MANUAL_HOLD;
+  }
+  return BaseChatMesh::onRecvPacket(pkt);
+}
+
 bool MyMesh::filterRecvFloodPacket(mesh::Packet* packet) {
   // REVISIT: try to determine which Region (from transport_codes[1]) that Sender is indicating for replies/responses
   //    if unknown, fallback to finding Region from transport_codes[0], the 'scope' used by Sender
@@ -406,6 +629,13 @@ void MyMesh::sendFloodScoped(const ContactInfo& recipient, mesh::Packet* pkt, ui
   }
 }
 void MyMesh::sendFloodScoped(const mesh::GroupChannel& channel, mesh::Packet* pkt, uint32_t delay_millis) {
+  if (chan_track_next) {   // from sendChannelMessage()
+    chan_track_next = false;
+    pkt->calculatePacketHash(chan_sent_hash);
+    chan_tx_pending = true;
+    chan_sent_at = _ms->getMillis();
+    chan_echo_at = 0;
+  }
   // TODO: have per-channel send_scope
   if (send_scope.isNull()) {
     sendFlood(pkt, delay_millis);
@@ -417,6 +647,60 @@ void MyMesh::sendFloodScoped(const mesh::GroupChannel& channel, mesh::Packet* pk
   }
 }
 
+bool MyMesh::isChannelSendReady(unsigned long now) const {
+  if (chan_sent_at == 0) return true;   // none sent yet
+  if (chan_tx_pending) return now - chan_sent_at >= CHAN_SEND_TX_TIMEOUT;
+
+  uint32_t gap = chan_sent_airtime * CHAN_SEND_AIRTIME_FACTOR;
+  if (chan_settle_millis > gap) gap = chan_settle_millis;   // floods have been taking longer than that to settle
+  if (now - chan_sent_at < gap) return false;
+
+  // and wait until rebroadcasts of the last one have died down
+  return chan_echo_at == 0 || now - chan_echo_at >= 2*chan_sent_airtime || now - chan_sent_at >= CHAN_ECHO_MAX_MILLIS;
+}
+
+bool MyMesh::sendChannelMessage(uint8_t channel_idx, uint32_t timestamp, const char* text, int len) {
+  ChannelDetails channel;
+  if (!getChannel(channel_idx, channel)) return false;
+
+  if (chan_echo_at && !chan_tx_pending) {   // fold how long the last one took to settle into the average
+    chan_settle_millis = chan_settle_millis == 0 ? chan_echo_delay : (chan_settle_millis*3 + chan_echo_delay) / 4;
+  }
+  chan_track_next = true;
+  bool success = sendGroupMessage(timestamp, channel.channel, _prefs.node_name, text, len);
+  chan_track_next = false;
+  return success;
+}
+
+void MyMesh::checkChannelSends() {
+  if (chan_send_len == 0 || !isChannelSendReady(_ms->getMillis())) return;
+
+  ChannelSend& q = chan_sends[chan_send_head];
+  if (!sendChannelMessage(q.channel_idx, q.timestamp, q.text, q.len)) {
+    MESH_DEBUG_PRINTLN("checkChannelSends: unable to send, channel_idx=%d", (uint32_t)q.channel_idx);
+  }
+  chan_send_head = (chan_send_head + 1) % CHAN_SEND_QUEUE_SIZE;
+  chan_send_len--;
+  pushChannelQueueDepth();
+}
+
+void MyMesh::checkPushes() {
+  if (!_serial->isConnected() || _serial->isWriteBusy()) return;   // (back-pressure, events keep merging meanwhile)
+
+  static const uint8_t codes[PUSH_KIND_NUM] = { PUSH_CODE_ADVERTS, PUSH_CODE_PATHS_UPDATED };
+  int len = pushes.nextFrame(out_frame, codes, PUSH_CODE_MSG_WAITING, _ms->getMillis());
+  if (len > 0) _serial->writeFrame(out_frame, len);
+}
+
+void MyMesh::pushChannelQueueDepth() {
+  if (_serial->isConnected()) {
+    out_frame[0] = PUSH_CODE_CHAN_QUEUE_DEPTH;
+    out_frame[1] = chan_send_len;
+    out_frame[2] = CHAN_SEND_QUEUE_SIZE;
+    _serial->writeFrame(out_frame, 3);
+  }
+}
+
 void MyMesh::onMessageRecv(const ContactInfo &from, mesh::Packet *pkt, uint32_t sender_timestamp,
                            const char *text) {
   markConnectionActive(from); // in case this is from a server, and we have a connection
@@ -433,7 +717,7 @@ void MyMesh::onSignedMessageRecv(const ContactInfo &from, mesh::Packet *pkt, uin
                                  const uint8_t *sender_prefix, const char *text) {
   markConnectionActive(from);
   // from.sync_since change needs to be persisted
-  dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);
+  markContactDirty(from.id.pub_key);
   queueMessage(from, TXT_TYPE_SIGNED_PLAIN, pkt, sender_timestamp, sender_prefix, 4, text);
 }
 
@@ -451,7 +735,7 @@ void MyMesh::onChannelMessageRecv(const mesh::GroupChannel &channel, mesh::Packe
 
   uint8_t channel_idx = findChannelIdx(channel);
   out_frame[i++] = channel_idx;
-  uint8_t path_len = out_frame[i++] = pkt->isRouteFlood() ? pkt->path_len : 0xFF;
+  uint8_t path_len = out_frame[i++] = pkt->isRouteFlood() ? mesh::Packet::decodePathHops(pkt->getEncodedPathLen()) : 0xFF;
 
   out_frame[i++] = TXT_TYPE_PLAIN;
   memcpy(&out_frame[i], &timestamp, 4);
@@ -465,9 +749,7 @@ void MyMesh::onChannelMessageRecv(const mesh::GroupChannel &channel, mesh::Packe
   addToOfflineQueue(out_frame, i);
 
   if (_serial->isConnected()) {
-    uint8_t frame[1];
-    frame[0] = PUSH_CODE_MSG_WAITING; // send push 'tickle'
-    _serial->writeFrame(frame, 1);
+    pushes.addTickle();   // send push 'tickle' (one per burst of messages, see checkPushes())
   } else {
 #ifdef DISPLAY_CLASS
     if (_ui) _ui->notify(UIEventType::channelMessage);
@@ -480,7 +762,10 @@ void MyMesh::onChannelMessageRecv(const mesh::GroupChannel &channel, mesh::Packe
   if (getChannel(channel_idx, channel_details)) {
     channel_name = channel_details.name;
   }
-  if (_ui) _ui->newMsg(path_len, channel_name, text, offline_queue_len);
+  if (_ui) {
+    addToHistory(path_len, channel_name, text);
+    _ui->newMsg(path_len, channel_name, text, getNumQueuedMessages());
+  }
 #endif
 }
 
@@ -512,16 +797,19 @@ uint8_t MyMesh::onContactRequest(const ContactInfo &contact, uint32_t sender_tim
     permissions &= perm_mask;
 
     if (permissions & TELEM_PERM_BASE) { // only respond if base permission bit is set
-      telemetry.reset();
-      telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
-      // query other sensors -- target specific
-      sensors.querySensors(permissions, telemetry);
-
       memcpy(reply, &sender_timestamp,
              4); // reflect sender_timestamp back in response packet (kind of like a 'tag')
 
-      uint8_t tlen = telemetry.getSize();
-      memcpy(&reply[4], telemetry.getBuffer(), tlen);
+      int tlen = telem_cache.get(permissions, &reply[4], _ms->getMillis());
+      if (tlen == 0) {   // no recent snapshot for these permissions
+        telemetry.resetInto(&reply[4], MAX_PACKET_PAYLOAD - 4);   // encode in place
+        telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
+        // query other sensors -- target specific
+        sensors.querySensors(permissions, telemetry);
+
+        tlen = telemetry.getSize();
+        telem_cache.put(permissions, &reply[4], tlen, _ms->getMillis());
+      }
       return 4 + tlen;
     }
   }
@@ -599,6 +887,42 @@ void MyMesh::onContactResponse(const ContactInfo &contact, const uint8_t *data,
     memcpy(&out_frame[i], &data[4], len - 4);
     i += (len - 4);
     _serial->writeFrame(out_frame, i);
+  } else if (len > 5 && data[4] == STATS_PUSH_MARKER) {   // unsolicited, see REQ_TYPE_STATS_PUSH
+    int i = 0;
+    out_frame[i++] = PUSH_CODE_STATS_PUSH;
+    out_frame[i++] = 0; // reserved
+    memcpy(&out_frame[i], contact.id.pub_key, 6);
+    i += 6; // pub_key_prefix
+    memcpy(&out_frame[i], &tag, 4);   // repeater's clock
+    i += 4;
+    if (len - 4 > MAX_FRAME_SIZE - i) len = MAX_FRAME_SIZE - i + 4;
+    memcpy(&out_frame[i], &data[4], len - 4);
+    i += (len - 4);
+    _serial->writeFrame(out_frame, i);
+  }
+}
+
+void MyMesh::onContactLargeResponse(const ContactInfo &contact, const uint8_t *data, size_t len) {
+  uint32_t tag;
+  memcpy(&tag, data, 4);
+  if (tag != pending_req) return;   // not the response to CMD_SEND_BINARY_REQ we're waiting on
+  pending_req = 0;
+
+  // split into frames:  code, part (bit 7 set if more follow, then 7 bit index), tag(4), then data
+  size_t ofs = 4;
+  for (uint8_t part = 0; ofs < len; part++) {
+    size_t n = len - ofs;
+    if (n > MAX_FRAME_SIZE - 6) n = MAX_FRAME_SIZE - 6;
+
+    int i = 0;
+    out_frame[i++] = PUSH_CODE_BINARY_RESPONSE_PART;
+    out_frame[i++] = (ofs + n < len ? 0x80 : 0) | part;
+    memcpy(&out_frame[i], &tag, 4);   // app needs to match this to RESP_CODE_SENT.tag
+    i += 4;
+    memcpy(&out_frame[i], &data[ofs], n);
+    i += n;
+    _serial->writeFrame(out_frame, i);
+    ofs += n;
   }
 }
 
@@ -609,8 +933,10 @@ bool MyMesh::onContactPathRecv(ContactInfo& contact, uint8_t* in_path, uint8_t i
 
     if (tag == pending_discovery) {  // check for matching response tag)
       pending_discovery = 0;
+      collectDiscoveredPaths(contact, in_path, in_path_len, out_path, out_path_len);   // if PATH_DISCOVERY_FLAG_SELECT
 
-      if (in_path_len > MAX_PATH_SIZE || out_path_len > MAX_PATH_SIZE) {
+      uint8_t in_bytes = mesh::Packet::decodePathBytes(in_path_len), out_bytes = mesh::Packet::decodePathBytes(out_path_len);
+      if (in_bytes > MAX_PATH_SIZE || out_bytes > MAX_PATH_SIZE) {
         MESH_DEBUG_PRINTLN("onContactPathRecv, invalid path sizes: %d, %d", in_path_len, out_path_len);
       } else {
         int i = 0;
@@ -619,11 +945,11 @@ bool MyMesh::onContactPathRecv(ContactInfo& contact, uint8_t* in_path, uint8_t i
         memcpy(&out_frame[i], contact.id.pub_key, 6);
         i += 6; // pub_key_prefix
         out_frame[i++] = out_path_len;
-        memcpy(&out_frame[i], out_path, out_path_len);
-        i += out_path_len;
+        memcpy(&out_frame[i], out_path, out_bytes);
+        i += out_bytes;
         out_frame[i++] = in_path_len;
-        memcpy(&out_frame[i], in_path, in_path_len);
-        i += in_path_len;
+        memcpy(&out_frame[i], in_path, in_bytes);
+        i += in_bytes;
         // NOTE: telemetry data in 'extra' is discarded at present
 
         _serial->writeFrame(out_frame, i);
@@ -644,7 +970,7 @@ void MyMesh::onControlDataRecv(mesh::Packet *packet) {
   out_frame[i++] = PUSH_CODE_CONTROL_DATA;
   out_frame[i++] = (int8_t)(_radio->getLastSNR() * 4);
   out_frame[i++] = (int8_t)(_radio->getLastRSSI());
-  out_frame[i++] = packet->path_len;
+  out_frame[i++] = mesh::Packet::decodePathHops(packet->getEncodedPathLen());
   memcpy(&out_frame[i], packet->payload, packet->payload_len);
   i += packet->payload_len;
 
@@ -677,6 +1003,8 @@ void MyMesh::onRawDataRecv(mesh::Packet *packet) {
 
 void MyMesh::onTraceRecv(mesh::Packet *packet, uint32_t tag, uint32_t auth_code, uint8_t flags,
                          const uint8_t *path_snrs, const uint8_t *path_hashes, uint8_t path_len) {
+  if (checkRouteProbe(packet, tag, flags, path_snrs, path_len)) return;   // one of ours, not for the app
+
   uint8_t path_sz = flags & 0x03;  // NEW v1.11+
   if (12 + path_len + (path_len >> path_sz) + 1 > sizeof(out_frame)) {
     MESH_DEBUG_PRINTLN("onTraceRecv(), path_len is too long: %d", (uint32_t)path_len);
@@ -705,28 +1033,90 @@ void MyMesh::onTraceRecv(mesh::Packet *packet, uint32_t tag, uint32_t auth_code,
   }
 }
 
+const MemTable* MyMesh::getMemTables(int& num) const {
+  static constexpr MemTable tables[] = {
+    { "contacts", sizeof(ContactInfo) * MAX_CONTACTS },
+  #ifdef MAX_GROUP_CHANNELS
+    { "channels", sizeof(ChannelDetails) * MAX_GROUP_CHANNELS },
+  #endif
+    { "offline_queue", sizeof(Frame) * OFFLINE_QUEUE_SIZE + sizeof(offline_queue) },
+    { "removed_contacts", sizeof(removed_contacts) },
+    { "mesh_tables", sizeof(SimpleMeshTables) },
+    { "packet_pool", sizeof(mesh::Packet) * PACKET_POOL_SIZE },
+    { "flash_writer", FLASH_WRITER_BUF_SIZE },
+#if COMPANION_FRAGMENTS
+    { "fragments", sizeof(FragmentStore) },
+#endif
+  };
+  static_assert(RAM_TABLES_BUDGET == 0 || memTablesTotal(tables, sizeof(tables) / sizeof(tables[0])) <= RAM_TABLES_BUDGET,
+                "tables exceed RAM_TABLES_BUDGET, reduce MAX_CONTACTS, MAX_GROUP_CHANNELS, OFFLINE_QUEUE_SIZE, etc.");
+  num = sizeof(tables) / sizeof(tables[0]);
+  return tables;
+}
+
 uint32_t MyMesh::calcFloodTimeoutMillisFor(uint32_t pkt_airtime_millis) const {
   return SEND_TIMEOUT_BASE_MILLIS + (FLOOD_SEND_TIMEOUT_FACTOR * pkt_airtime_millis);
 }
 uint32_t MyMesh::calcDirectTimeoutMillisFor(uint32_t pkt_airtime_millis, uint8_t path_len) const {
   return SEND_TIMEOUT_BASE_MILLIS +
          ((pkt_airtime_millis * DIRECT_SEND_PERHOP_FACTOR + DIRECT_SEND_PERHOP_EXTRA_MILLIS) *
-          (path_len + 1));
+          (mesh::Packet::decodePathHops(path_len) + 1));
 }
 
 void MyMesh::onSendTimeout() {}
 
+void MyMesh::onMessageSendResult(const ContactInfo* recipient, uint32_t expected_ack, bool delivered, uint32_t trip_millis, uint8_t attempts) {
+  if (delivered) {
+    out_frame[0] = PUSH_CODE_SEND_CONFIRMED;   // same as for app-driven sends
+    memcpy(&out_frame[1], &expected_ack, 4);
+    memcpy(&out_frame[5], &trip_millis, 4);
+    _serial->writeFrame(out_frame, 9);
+  } else {
+    out_frame[0] = PUSH_CODE_SEND_FAILED;
+    memcpy(&out_frame[1], &expected_ack, 4);
+    out_frame[5] = attempts;
+    _serial->writeFrame(out_frame, 6);
+  }
+}
+
 MyMesh::MyMesh(mesh::Radio &radio, mesh::RNG &rng, mesh::RTCClock &rtc, SimpleMeshTables &tables, DataStore& store, AbstractUITask* ui)
-    : BaseChatMesh(radio, *new ArduinoMillis(), rng, rtc, *new StaticPoolPacketManager(16), tables),
-      _serial(NULL), telemetry(MAX_PACKET_PAYLOAD - 4), _store(&store), _ui(ui) {
+    : BaseChatMesh(radio, *new ArduinoMillis(), rng, rtc, *new StaticPoolPacketManager(PACKET_POOL_SIZE), tables),
+      _serial(NULL), telemetry(), _store(&store), _ui(ui) {
   _iter_started = false;
+  _sync_batch_left = 0;
+#if COMPANION_FRAGMENTS
+  setFragmentStore(&frag_store);
+#endif
+  _raw_mode = false;
+  _iter_compact = false;
+  _iter_adverts = false;
+  _bulk_import = false;
+  _bulk_imported = _bulk_rejected = 0;
+  bulk_import_expiry = 0;
+  _push_coalesce = false;
+  chan_send_head = chan_send_len = 0;
+  chan_track_next = chan_tx_pending = false;
+  chan_sent_at = chan_echo_at = 0;
+  chan_sent_airtime = chan_echo_delay = chan_settle_millis = 0;
+  memset(removed_contacts, 0, sizeof(removed_contacts));
+  next_removed = 0;
+  removed_unknown_until = 0;
   _cli_rescue = false;
-  offline_queue_len = 0;
+  offline_queue_len = offline_queue_head = 0;
+  for (int i = 0; i < OFFLINE_QUEUE_SIZE; i++) {
+    offline_queue[i] = i;   // all free
+  }
   app_target_ver = 0;
   clearPendingReqs();
   next_ack_idx = 0;
   sign_data = NULL;
+  sign_mode = SIGN_MODE_NONE;
   dirty_contacts_expiry = 0;
+  num_dirty_contacts = 0;
+  next_tables_save = 0;
+  advert_notify_pending = false;
+  next_advert_notify = 0;
+  _boot_loading = false;
   memset(advert_paths, 0, sizeof(advert_paths));
   memset(send_scope.key, 0, sizeof(send_scope.key));
 
@@ -744,6 +1134,12 @@ MyMesh::MyMesh(mesh::Radio &radio, mesh::RNG &rng, mesh::RTCClock &rtc, SimpleMe
 
 void MyMesh::begin(bool has_display) {
   BaseChatMesh::begin();
+  flash_writer.begin();   // saves are written behind, from here on
+  {
+    int num;
+    const MemTable* tables = getMemTables(num);
+    MemoryStats::debugPrint(tables, num);
+  }
 
   if (!_store->loadMainIdentity(self_id)) {
     self_id = radio_new_identity(); // create new random identity
@@ -796,13 +1192,21 @@ void MyMesh::begin(bool has_display) {
   _active_ble_pin = 0;
 #endif
 
-  resetContacts();
-  _store->loadContacts(this);
-  addChannel("Public", PUBLIC_GROUP_PSK); // pre-configure Andy's public channel
-  _store->loadChannels(this);
+  removed_unknown_until = getRTCClock()->getCurrentTime();   // removals from before this boot weren't recorded
+
+  // restore dedup state before receiving anything, so packets still in flight aren't treated as new after a restart
+  ((SimpleMeshTables *)getTables())->load(_store->getPrimaryFS(), TABLES_SNAPSHOT_FILE);
+  next_tables_save = futureMillis(TABLES_SAVE_INTERVAL_SECS * 1000);
 
   radio_set_params(_prefs.freq, _prefs.bw, _prefs.sf, _prefs.cr);
   radio_set_tx_power(_prefs.tx_power_dbm);
+
+  // contacts and channels are loaded a few at a time, from loop(). Until then, received packets are held (see onRecvPacket())
+  resetContacts();
+  addChannel("Public", PUBLIC_GROUP_PSK); // pre-configure Andy's public channel
+  _store->setSecretsIdentity(self_id);
+  _store->beginLoad();
+  _boot_loading = true;
 }
 
 const char *MyMesh::getNodeName() {
@@ -847,6 +1251,11 @@ void MyMesh::handleCmdFrame(size_t len) {
     MESH_DEBUG_PRINTLN("App %s connected", app_name);
 
     _iter_started = false; // stop any left-over ContactsIterator
+    _sync_batch_left = 0;
+    if (_bulk_import) finishBulkImport();   // left-over CMD_IMPORT_CONTACTS
+    _push_coalesce = false;   // (app opts in again, if it understands the batched pushes)
+    pushes.reset();
+    _raw_mode = false;
     int i = 0;
     out_frame[i++] = RESP_CODE_SELF_INFO;
     out_frame[i++] = ADV_TYPE_CHAT; // what this node Advert identifies as (maybe node's pronouns too?? :-)
@@ -898,9 +1307,13 @@ void MyMesh::handleCmdFrame(size_t len) {
       text[tlen] = 0; // ensure null
       int result;
       uint32_t expected_ack;
+      bool auto_retry = (attempt & TXT_SEND_FLAG_AUTO_RETRY) != 0;
+      attempt &= ~TXT_SEND_FLAG_AUTO_RETRY;
       if (txt_type == TXT_TYPE_CLI_DATA) {
         result = sendCommandData(*recipient, msg_timestamp, attempt, text, est_timeout);
         expected_ack = 0; // no Ack expected
+      } else if (auto_retry) {
+        result = sendMessageWithRetry(*recipient, msg_timestamp, text, expected_ack, est_timeout);
       } else {
         result = sendMessage(*recipient, msg_timestamp, attempt, text, expected_ack, est_timeout);
       }
@@ -908,7 +1321,7 @@ void MyMesh::handleCmdFrame(size_t len) {
       if (result == MSG_SEND_FAILED) {
         writeErrFrame(ERR_CODE_TABLE_FULL);
       } else {
-        if (expected_ack) {
+        if (expected_ack && !auto_retry) {   // (else is tracked by BaseChatMesh)
           expected_ack_table[next_ack_idx].msg_sent = _ms->getMillis(); // add to circular table
           expected_ack_table[next_ack_idx].ack = expected_ack;
           expected_ack_table[next_ack_idx].contact = recipient;
@@ -935,16 +1348,28 @@ void MyMesh::handleCmdFrame(size_t len) {
     i += 4;
     const char *text = (char *)&cmd_frame[i];
 
+    ChannelDetails channel;
     if (txt_type != TXT_TYPE_PLAIN) {
       writeErrFrame(ERR_CODE_UNSUPPORTED_CMD);
-    } else {
-      ChannelDetails channel;
-      bool success = getChannel(channel_idx, channel);
-      if (success && sendGroupMessage(msg_timestamp, channel.channel, _prefs.node_name, text, len - i)) {
+    } else if (!getChannel(channel_idx, channel)) {
+      writeErrFrame(ERR_CODE_NOT_FOUND); // bad channel_idx
+    } else if (chan_send_len == 0 && isChannelSendReady(_ms->getMillis())) {   // can go straight away
+      if (sendChannelMessage(channel_idx, msg_timestamp, text, len - i)) {
         writeOKFrame();
       } else {
-        writeErrFrame(ERR_CODE_NOT_FOUND); // bad channel_idx
+        writeErrFrame(ERR_CODE_NOT_FOUND);
       }
+    } else if (chan_send_len >= CHAN_SEND_QUEUE_SIZE) {
+      writeErrFrame(ERR_CODE_TABLE_FULL);
+    } else {   // too soon after the last one, so queue it (see checkChannelSends())
+      ChannelSend& q = chan_sends[(chan_send_head + chan_send_len) % CHAN_SEND_QUEUE_SIZE];
+      q.channel_idx = channel_idx;
+      q.timestamp = msg_timestamp;
+      q.len = len - i > MAX_TEXT_LEN ? MAX_TEXT_LEN : len - i;
+      memcpy(q.text, text, q.len);
+      chan_send_len++;
+      writeOKFrame();
+      pushChannelQueueDepth();
     }
   } else if (cmd_frame[0] == CMD_GET_CONTACTS) { // get Contact list
     if (_iter_started) {
@@ -955,16 +1380,26 @@ void MyMesh::handleCmdFrame(size_t len) {
       } else {
         _iter_filter_since = 0;
       }
+      _iter_compact = len >= 6 && (cmd_frame[5] & CONTACTS_FLAG_COMPACT) != 0;
+      _iter_adverts = false;
 
-      uint8_t reply[5];
+      uint8_t reply[6];
+      int rlen = 5;
       reply[0] = RESP_CODE_CONTACTS_START;
       uint32_t count = getNumContacts(); // total, NOT filtered count
       memcpy(&reply[1], &count, 4);
-      _serial->writeFrame(reply, 5);
+      if (_iter_compact) {
+        if (_iter_filter_since > 0 && _iter_filter_since <= removed_unknown_until) {
+          _iter_filter_since = 0;   // can't report all removals since then, so send the full list instead
+        }
+        reply[rlen++] = _iter_filter_since == 0 ? 1 : 0;   // 1 = full list (app should drop any others)
+      }
+      _serial->writeFrame(reply, rlen);
 
       // start iterator
       _iter = startContactsIterator();
       _iter_started = true;
+      _iter_removed_idx = -1;
       _most_recent_lastmod = 0;
     }
   } else if (cmd_frame[0] == CMD_SET_ADVERT_NAME && len >= 2) {
@@ -1028,7 +1463,7 @@ void MyMesh::handleCmdFrame(size_t len) {
     if (recipient) {
       recipient->out_path_len = -1;
       // recipient->lastmod = ??   shouldn't be needed, app already has this version of contact
-      dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);
+      markContactDirty(recipient->id.pub_key);
       writeOKFrame();
     } else {
       writeErrFrame(ERR_CODE_NOT_FOUND); // unknown contact
@@ -1040,7 +1475,7 @@ void MyMesh::handleCmdFrame(size_t len) {
     if (recipient) {
       updateContactFromFrame(*recipient, last_mod, cmd_frame, len);
       recipient->lastmod = last_mod;
-      dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);
+      markContactDirty(recipient->id.pub_key);
       writeOKFrame();
     } else {
       ContactInfo contact;
@@ -1048,7 +1483,7 @@ void MyMesh::handleCmdFrame(size_t len) {
       contact.lastmod = last_mod;
       contact.sync_since = 0;
       if (addContact(contact)) {
-        dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);
+        markContactDirty(contact.id.pub_key);
         writeOKFrame();
       } else {
         writeErrFrame(ERR_CODE_TABLE_FULL);
@@ -1058,7 +1493,8 @@ void MyMesh::handleCmdFrame(size_t len) {
     uint8_t *pub_key = &cmd_frame[1];
     ContactInfo *recipient = lookupContactByPubKey(pub_key, PUB_KEY_SIZE);
     if (recipient && removeContact(*recipient)) {
-      dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);
+      markContactDirty(pub_key);
+      recordRemovedContact(pub_key);
       writeOKFrame();
     } else {
       writeErrFrame(ERR_CODE_NOT_FOUND); // not found, or unable to remove
@@ -1119,17 +1555,74 @@ void MyMesh::handleCmdFrame(size_t len) {
     } else {
       writeErrFrame(ERR_CODE_ILLEGAL_ARG);
     }
+  } else if (cmd_frame[0] == CMD_IMPORT_CONTACTS && len >= 2) {
+    if (!_bulk_import) {   // start of a batch
+      _bulk_import = true;
+      _bulk_imported = _bulk_rejected = 0;
+    }
+    bulk_import_expiry = futureMillis(BULK_IMPORT_IDLE_MILLIS);
+
+    int i = 2;
+    while (i < len) {
+      int alen = cmd_frame[i++];
+      if (alen == 0 || i + alen > len) {   // malformed, ignore rest of frame
+        _bulk_rejected++;
+        break;
+      }
+      mesh::Packet pkt;
+      if (importContactNow(&cmd_frame[i], alen) && pkt.readFrom(&cmd_frame[i], alen)
+          && lookupContactByPubKey(pkt.payload, PUB_KEY_SIZE)) {   // verified, and added/updated
+        _bulk_imported++;
+      } else {
+        _bulk_rejected++;
+      }
+      i += alen;
+    }
+
+    if (cmd_frame[1] & IMPORT_FLAG_END) {
+      finishBulkImport();
+      out_frame[0] = RESP_CODE_CONTACTS_IMPORTED;
+      memcpy(&out_frame[1], &_bulk_imported, 2);
+      memcpy(&out_frame[3], &_bulk_rejected, 2);
+      _serial->writeFrame(out_frame, 5);
+    } else {
+      writeOKFrame();
+    }
+  } else if (cmd_frame[0] == CMD_EXPORT_CONTACTS) {
+    if (_iter_started) {
+      writeErrFrame(ERR_CODE_BAD_STATE); // iterator is currently busy
+    } else {
+      if (len >= 5) { // has optional 'since' param
+        memcpy(&_iter_filter_since, &cmd_frame[1], 4);
+      } else {
+        _iter_filter_since = 0;
+      }
+      out_frame[0] = RESP_CODE_CONTACTS_START;
+      uint32_t count = getNumContacts(); // total, NOT filtered count
+      memcpy(&out_frame[1], &count, 4);
+      _serial->writeFrame(out_frame, 5);
+
+      // start iterator, adverts are streamed from checkSerialInterface()
+      _iter = startContactsIterator();
+      _iter_started = true;
+      _iter_compact = false;
+      _iter_adverts = true;
+      _most_recent_lastmod = 0;
+    }
   } else if (cmd_frame[0] == CMD_SYNC_NEXT_MESSAGE) {
     int out_len;
     if ((out_len = getFromOfflineQueue(out_frame)) > 0) {
       _serial->writeFrame(out_frame, out_len);
 #ifdef DISPLAY_CLASS
-      if (_ui) _ui->msgRead(offline_queue_len);
+      if (_ui) _ui->msgRead(getNumQueuedMessages());
 #endif
     } else {
       out_frame[0] = RESP_CODE_NO_MORE_MESSAGES;
       _serial->writeFrame(out_frame, 1);
     }
+  } else if (cmd_frame[0] == CMD_SYNC_MESSAGES_BATCH) {
+    // stream queued messages, as fast as the interface will take them (see checkSerialInterface())
+    _sync_batch_left = (len >= 2 && cmd_frame[1] > 0) ? cmd_frame[1] : 0xFFFF;
   } else if (cmd_frame[0] == CMD_SET_RADIO_PARAMS) {
     int i = 1;
     uint32_t freq;
@@ -1204,8 +1697,10 @@ void MyMesh::handleCmdFrame(size_t len) {
     writeOKFrame();
   } else if (cmd_frame[0] == CMD_REBOOT && memcmp(&cmd_frame[1], "reboot", 6) == 0) {
     if (dirty_contacts_expiry) { // is there are pending dirty contacts write needed?
-      saveContacts();
+      saveDirtyContacts();
     }
+    _store->saveMessageCursor();   // so already synced messages aren't sent again
+    flash_writer.flush();
     board.reboot();
   } else if (cmd_frame[0] == CMD_GET_BATT_AND_STORAGE) {
     uint8_t reply[11];
@@ -1236,7 +1731,9 @@ void MyMesh::handleCmdFrame(size_t len) {
       writeOKFrame();
       // re-load contacts, to recalc shared secrets
       resetContacts();
+      _store->setSecretsIdentity(self_id);   // (so cached secrets, for the old identity, are ignored)
       _store->loadContacts(this);
+      onContactsLoaded();
     } else {
       writeErrFrame(ERR_CODE_FILE_IO_ERROR);
     }
@@ -1302,7 +1799,7 @@ void MyMesh::handleCmdFrame(size_t len) {
     } else {
       writeErrFrame(ERR_CODE_NOT_FOUND); // contact not found
     }
-  } else if (cmd_frame[0] == CMD_SEND_PATH_DISCOVERY_REQ && cmd_frame[1] == 0 && len >= 2 + PUB_KEY_SIZE) {
+  } else if (cmd_frame[0] == CMD_SEND_PATH_DISCOVERY_REQ && (cmd_frame[1] & ~PATH_DISCOVERY_FLAG_SELECT) == 0 && len >= 2 + PUB_KEY_SIZE) {
     uint8_t *pub_key = &cmd_frame[2];
     ContactInfo *recipient = lookupContactByPubKey(pub_key, PUB_KEY_SIZE);
     if (recipient) {
@@ -1322,6 +1819,9 @@ void MyMesh::handleCmdFrame(size_t len) {
       } else {
         clearPendingReqs();
         pending_discovery = tag; // match this in onContactResponse()
+        if (cmd_frame[1] & PATH_DISCOVERY_FLAG_SELECT) {
+          startPathDiscovery(*recipient, est_timeout);   // PUSH_CODE_PATH_UPDATED follows, once the best path is chosen
+        }
         out_frame[0] = RESP_CODE_SENT;
         out_frame[1] = (result == MSG_SEND_SENT_FLOOD) ? 1 : 0;
         memcpy(&out_frame[2], &tag, 4);
@@ -1352,19 +1852,17 @@ void MyMesh::handleCmdFrame(size_t len) {
       writeErrFrame(ERR_CODE_NOT_FOUND); // contact not found
     }
   } else if (cmd_frame[0] == CMD_SEND_TELEMETRY_REQ && len == 4) {  // 'self' telemetry request
-    telemetry.reset();
-    telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
-    // query other sensors -- target specific
-    sensors.querySensors(0xFF, telemetry);
-
     int i = 0;
     out_frame[i++] = PUSH_CODE_TELEMETRY_RESPONSE;
     out_frame[i++] = 0; // reserved
     memcpy(&out_frame[i], self_id.pub_key, 6);
     i += 6; // pub_key_prefix
-    uint8_t tlen = telemetry.getSize();
-    memcpy(&out_frame[i], telemetry.getBuffer(), tlen);
-    i += tlen;
+
+    telemetry.resetInto(&out_frame[i], MAX_FRAME_SIZE - i);   // encode in place
+    telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
+    // query other sensors -- target specific
+    sensors.querySensors(0xFF, telemetry);
+    i += telemetry.getSize();
     _serial->writeFrame(out_frame, i);
   } else if (cmd_frame[0] == CMD_SEND_BINARY_REQ && len >= 2 + PUB_KEY_SIZE) {
     uint8_t *pub_key = &cmd_frame[1];
@@ -1428,31 +1926,57 @@ void MyMesh::handleCmdFrame(size_t len) {
       writeErrFrame(ERR_CODE_NOT_FOUND); // bad channel_idx
     }
   } else if (cmd_frame[0] == CMD_SIGN_START) {
-    out_frame[0] = RESP_CODE_SIGN_START;
-    out_frame[1] = 0; // reserved
-    uint32_t len = MAX_SIGN_DATA_LEN;
-    memcpy(&out_frame[2], &len, 4);
-    _serial->writeFrame(out_frame, 6);
-
     if (sign_data) {
       free(sign_data);
+      sign_data = NULL;
+    }
+    // optional byte: 1 = Ed25519ph (app must verify as such), so the message needn't be buffered
+    bool prehash = len > 1 && cmd_frame[1] == 1;
+    uint32_t max_len;
+    if (prehash) {
+      self_id.signStart(sign_state);
+      sign_mode = SIGN_MODE_PREHASH;
+      max_len = MAX_SIGN_PREHASH_LEN;
+    } else {
+      sign_data = (uint8_t *)malloc(MAX_SIGN_DATA_LEN);
+      sign_mode = sign_data ? SIGN_MODE_PURE : SIGN_MODE_NONE;
+      max_len = MAX_SIGN_DATA_LEN;
     }
-    sign_data = (uint8_t *)malloc(MAX_SIGN_DATA_LEN);
     sign_data_len = 0;
+
+    if (sign_mode == SIGN_MODE_NONE) {
+      writeErrFrame(ERR_CODE_BAD_STATE);   // out of memory
+    } else {
+      out_frame[0] = RESP_CODE_SIGN_START;
+      out_frame[1] = prehash ? 1 : 0;   // signature scheme in use
+      memcpy(&out_frame[2], &max_len, 4);
+      _serial->writeFrame(out_frame, 6);
+    }
   } else if (cmd_frame[0] == CMD_SIGN_DATA && len > 1) {
-    if (sign_data == NULL || sign_data_len + (len - 1) > MAX_SIGN_DATA_LEN) {
-      writeErrFrame(sign_data == NULL ? ERR_CODE_BAD_STATE : ERR_CODE_TABLE_FULL); // error: too long
+    if (sign_mode == SIGN_MODE_NONE) {
+      writeErrFrame(ERR_CODE_BAD_STATE);
+    } else if (sign_mode == SIGN_MODE_PREHASH) {
+      self_id.signUpdate(sign_state, &cmd_frame[1], len - 1);
+      sign_data_len += (len - 1);
+      writeOKFrame();
+    } else if (sign_data_len + (len - 1) > MAX_SIGN_DATA_LEN) {
+      writeErrFrame(ERR_CODE_TABLE_FULL); // error: too long
     } else {
       memcpy(&sign_data[sign_data_len], &cmd_frame[1], len - 1);
       sign_data_len += (len - 1);
       writeOKFrame();
     }
   } else if (cmd_frame[0] == CMD_SIGN_FINISH) {
-    if (sign_data) {
-      self_id.sign(&out_frame[1], sign_data, sign_data_len);
+    if (sign_mode != SIGN_MODE_NONE) {
+      if (sign_mode == SIGN_MODE_PREHASH) {
+        self_id.signFinish(sign_state, &out_frame[1]);
+      } else {
+        self_id.sign(&out_frame[1], sign_data, sign_data_len);
 
-      free(sign_data); // don't need sign_data now
-      sign_data = NULL;
+        free(sign_data); // don't need sign_data now
+        sign_data = NULL;
+      }
+      sign_mode = SIGN_MODE_NONE;
 
       out_frame[0] = RESP_CODE_SIGNATURE;
       _serial->writeFrame(out_frame, 1 + SIGNATURE_SIZE);
@@ -1543,8 +2067,9 @@ void MyMesh::handleCmdFrame(size_t len) {
       out_frame[0] = RESP_CODE_ADVERT_PATH;
       memcpy(&out_frame[1], &found->recv_timestamp, 4);
       out_frame[5] = found->path_len;
-      memcpy(&out_frame[6], found->path, found->path_len);
-      _serial->writeFrame(out_frame, 6 + found->path_len);
+      uint8_t path_bytes = mesh::Packet::decodePathBytes(found->path_len);
+      memcpy(&out_frame[6], found->path, path_bytes);
+      _serial->writeFrame(out_frame, 6 + path_bytes);
     } else {
       writeErrFrame(ERR_CODE_NOT_FOUND);
     }
@@ -1594,6 +2119,94 @@ void MyMesh::handleCmdFrame(size_t len) {
       memcpy(&out_frame[i], &n_recv_flood, 4); i += 4;
       memcpy(&out_frame[i], &n_recv_direct, 4); i += 4;
       _serial->writeFrame(out_frame, i);
+    } else if (stats_type == STATS_TYPE_LATENCY) {
+      int i = 0;
+      out_frame[i++] = RESP_CODE_STATS;
+      out_frame[i++] = STATS_TYPE_LATENCY;
+      out_frame[i++] = LATENCY_HIST_NUM;
+      out_frame[i++] = LATENCY_HIST_BUCKETS;
+      for (int h = 0; h < LATENCY_HIST_NUM; h++) {
+        const mesh::LatencyHistogram& hist = getLatencyHistogram(h);
+        for (int b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+          uint32_t count = hist.getCount(b);
+          memcpy(&out_frame[i], &count, 4); i += 4;
+        }
+      }
+      _serial->writeFrame(out_frame, i);
+    } else if (stats_type == STATS_TYPE_UI) {
+      RenderStats rs;
+      if (_ui) {
+        rs = _ui->getRenderStats();
+      } else {
+        memset(&rs, 0, sizeof(rs));   // no UI
+      }
+      int i = 0;
+      out_frame[i++] = RESP_CODE_STATS;
+      out_frame[i++] = STATS_TYPE_UI;
+      memcpy(&out_frame[i], &rs.n_frames, 4); i += 4;
+      memcpy(&out_frame[i], &rs.n_coalesced, 4); i += 4;
+      memcpy(&out_frame[i], &rs.total_millis, 4); i += 4;
+      memcpy(&out_frame[i], &rs.max_millis, 2); i += 2;
+      _serial->writeFrame(out_frame, i);
+    } else if (stats_type == STATS_TYPE_MEMORY) {
+      MemoryStats mem;
+      mem.read();
+      int num;
+      const MemTable* tables = getMemTables(num);
+      int i = 0;
+      out_frame[i++] = RESP_CODE_STATS;
+      out_frame[i++] = STATS_TYPE_MEMORY;
+      memcpy(&out_frame[i], &mem.free_heap, 4); i += 4;
+      memcpy(&out_frame[i], &mem.min_free_heap, 4); i += 4;
+      memcpy(&out_frame[i], &mem.max_alloc, 4); i += 4;
+      out_frame[i++] = MEM_STACK_NUM;
+      for (int s = 0; s < MEM_STACK_NUM; s++) {
+        memcpy(&out_frame[i], &mem.stack_free[s], 4); i += 4;
+      }
+      out_frame[i++] = num;
+      for (int t = 0; t < num; t++) {
+        memcpy(&out_frame[i], &tables[t].bytes, 4); i += 4;
+      }
+      _serial->writeFrame(out_frame, i);
+    } else if (stats_type == STATS_TYPE_PROFILE) {
+    #if MESH_PROFILING
+      const mesh::RecvProfiler& prof = getRecvProfiler();
+      uint8_t type = len >= 3 ? (cmd_frame[2] & 0x0F) : 0xFF;
+      uint32_t count = 0;
+      for (int t = 0; t < 16; t++) {
+        if (type == 0xFF || t == type) count += prof.getCount(t);
+      }
+      int i = 0;
+      out_frame[i++] = RESP_CODE_STATS;
+      out_frame[i++] = STATS_TYPE_PROFILE;
+      out_frame[i++] = type;
+      out_frame[i++] = prof.isCycles() ? 0 : 1;   // units: 0 = CPU cycles, 1 = micros
+      memcpy(&out_frame[i], &count, 4); i += 4;
+      out_frame[i++] = PROF_STAGE_NUM;
+      for (int s = 0; s < PROF_STAGE_NUM; s++) {
+        uint32_t avg = prof.getAvgCycles(type, s);
+        memcpy(&out_frame[i], &avg, 4); i += 4;
+      }
+      _serial->writeFrame(out_frame, i);
+    #else
+      writeErrFrame(ERR_CODE_UNSUPPORTED_CMD);   // not a MESH_PROFILING build
+    #endif
+    } else if (stats_type == STATS_TYPE_LOOP) {
+      const mesh::LoopMonitor& mon = mesh::LoopMonitor::get();
+      uint32_t n = mon.getCount(), max_ms = mon.getMaxMillis(), p99 = mon.getPercentile(99);
+      int i = 0;
+      out_frame[i++] = RESP_CODE_STATS;
+      out_frame[i++] = STATS_TYPE_LOOP;
+      memcpy(&out_frame[i], &n, 4); i += 4;
+      memcpy(&out_frame[i], &max_ms, 4); i += 4;
+      out_frame[i++] = mon.getMaxSection();
+      memcpy(&out_frame[i], &p99, 4); i += 4;
+      out_frame[i++] = LOOP_SECT_NUM;
+      for (int s = 0; s < LOOP_SECT_NUM; s++) {
+        uint32_t stalls = mon.getNumStalls(s);
+        memcpy(&out_frame[i], &stalls, 4); i += 4;
+      }
+      _serial->writeFrame(out_frame, i);
     } else {
       writeErrFrame(ERR_CODE_ILLEGAL_ARG); // invalid stats sub-type
     }
@@ -1621,6 +2234,32 @@ void MyMesh::handleCmdFrame(size_t len) {
     } else {
       writeErrFrame(ERR_CODE_TABLE_FULL);
     }
+  } else if (cmd_frame[0] == CMD_SET_PUSH_COALESCE && len >= 2) {
+    _push_coalesce = cmd_frame[1] != 0;
+    writeOKFrame();
+  } else if (cmd_frame[0] == CMD_SET_RAW_MODE && len >= 2) {
+    _raw_mode = cmd_frame[1] != 0;
+    writeOKFrame();
+  } else if (cmd_frame[0] == CMD_SEND_RAW_PACKET && len >= 4 + 2) {
+    if (!_raw_mode) {
+      writeErrFrame(ERR_CODE_BAD_STATE);
+    } else {
+      uint8_t priority = cmd_frame[1];
+      if (priority > QOS_BULK) priority = QOS_BULK;
+      uint16_t delay_millis;
+      memcpy(&delay_millis, &cmd_frame[2], 2);
+
+      mesh::Packet* pkt = obtainNewPacket();
+      if (pkt == NULL) {
+        writeErrFrame(ERR_CODE_TABLE_FULL);
+      } else if (!decodeRawPacket(pkt, &cmd_frame[4], len - 4)) {
+        releasePacket(pkt);
+        writeErrFrame(ERR_CODE_ILLEGAL_ARG);
+      } else {
+        sendPacket(pkt, priority, delay_millis);   // airtime budget, and LBT, still apply
+        writeOKFrame();
+      }
+    }
   } else {
     writeErrFrame(ERR_CODE_UNSUPPORTED_CMD);
     MESH_DEBUG_PRINTLN("ERROR: unknown command: %02X", cmd_frame[0]);
@@ -1796,6 +2435,7 @@ void MyMesh::checkCLIRescueCmd() {
       }
 
     } else if (strcmp(cli_command, "reboot") == 0) {
+      flash_writer.flush();
       board.reboot();  // doesn't return
     } else {
       Serial.println("  Error: unknown command");
@@ -1812,12 +2452,77 @@ void MyMesh::checkSerialInterface() {
   } else if (_iter_started              // check if our ContactsIterator is 'running'
              && !_serial->isWriteBusy() // don't spam the Serial Interface too quickly!
   ) {
-    ContactInfo contact;
-    if (_iter.hasNext(this, contact)) {
-      if (contact.lastmod > _iter_filter_since) { // apply the 'since' filter
-        writeContactRespFrame(RESP_CODE_CONTACT, contact);
-        if (contact.lastmod > _most_recent_lastmod) {
-          _most_recent_lastmod = contact.lastmod; // save for the RESP_CODE_END_OF_CONTACTS frame
+    const ContactInfo* contact = NULL;
+    if (_iter_compact && _iter_removed_idx < 0) {
+      int i = 0;
+      out_frame[i++] = RESP_CODE_CONTACTS_COMPACT;
+      out_frame[i++] = 0;   // num contacts in frame
+      ContactsIterator prev = _iter;
+      while ((contact = _iter.next(this)) != NULL) {
+        if (contact->lastmod <= _iter_filter_since) { prev = _iter; continue; }  // apply the 'since' filter
+
+        int n = writeCompactContact(&out_frame[i], MAX_FRAME_SIZE - i, *contact);
+        if (n == 0) {
+          _iter = prev;   // frame is full, send this one in next frame
+          break;
+        }
+        i += n;
+        out_frame[1]++;
+        if (contact->lastmod > _most_recent_lastmod) {
+          _most_recent_lastmod = contact->lastmod;
+        }
+        prev = _iter;
+      }
+      if (out_frame[1] > 0) _serial->writeFrame(out_frame, i);
+      if (contact == NULL) _iter_removed_idx = 0;   // then report any removals
+    } else if (_iter_compact && _iter_removed_idx < REMOVED_CONTACTS_SIZE) {
+      int i = 0;
+      out_frame[i++] = RESP_CODE_CONTACTS_REMOVED;
+      out_frame[i++] = 0;   // num pub_keys in frame
+      for ( ; _iter_removed_idx < REMOVED_CONTACTS_SIZE && i + PUB_KEY_SIZE <= MAX_FRAME_SIZE; _iter_removed_idx++) {
+        auto r = &removed_contacts[_iter_removed_idx];
+        if (r->removed == 0 || r->removed < _iter_filter_since || _iter_filter_since == 0) continue;
+        if (lookupContactByPubKey(r->pub_key, PUB_KEY_SIZE)) continue;   // has been added back since
+
+        memcpy(&out_frame[i], r->pub_key, PUB_KEY_SIZE); i += PUB_KEY_SIZE;
+        out_frame[1]++;
+      }
+      if (out_frame[1] > 0) _serial->writeFrame(out_frame, i);
+    } else if (_iter_adverts) {
+      int i = 0;
+      out_frame[i++] = RESP_CODE_EXPORT_CONTACTS;
+      uint8_t advert[MAX_TRANS_UNIT];
+      ContactsIterator prev = _iter;
+      while ((contact = _iter.next(this)) != NULL) {
+        uint8_t n;
+        if (contact->lastmod > _iter_filter_since && (n = exportContact(*contact, advert)) > 0) {
+          if (i + 1 + n > MAX_FRAME_SIZE && i > 1) {
+            _iter = prev;   // frame is full, send this one in next frame
+            break;
+          }
+          if (i + 1 + n <= MAX_FRAME_SIZE) {
+            out_frame[i++] = n;
+            memcpy(&out_frame[i], advert, n); i += n;
+            if (contact->lastmod > _most_recent_lastmod) {
+              _most_recent_lastmod = contact->lastmod;
+            }
+          }
+        }
+        prev = _iter;
+      }
+      if (i > 1) {
+        _serial->writeFrame(out_frame, i);
+      } else {   // EOF
+        out_frame[0] = RESP_CODE_END_OF_CONTACTS;
+        memcpy(&out_frame[1], &_most_recent_lastmod, 4);
+        _serial->writeFrame(out_frame, 5);
+        _iter_started = _iter_adverts = false;
+      }
+    } else if (!_iter_compact && (contact = _iter.next(this)) != NULL) {
+      if (contact->lastmod > _iter_filter_since) { // apply the 'since' filter
+        writeContactRespFrame(RESP_CODE_CONTACT, *contact);
+        if (contact->lastmod > _most_recent_lastmod) {
+          _most_recent_lastmod = contact->lastmod; // save for the RESP_CODE_END_OF_CONTACTS frame
         }
       }
     } else { // EOF
@@ -1827,6 +2532,22 @@ void MyMesh::checkSerialInterface() {
       _serial->writeFrame(out_frame, 5);
       _iter_started = false;
     }
+  } else if (_sync_batch_left > 0 && !_serial->isWriteBusy()) {   // a CMD_SYNC_MESSAGES_BATCH is in progress
+    int out_len = getFromOfflineQueue(out_frame);
+    if (out_len > 0) {
+      _serial->writeFrame(out_frame, out_len);
+      if (--_sync_batch_left == 0 && getNumQueuedMessages() > 0) {
+        out_frame[0] = PUSH_CODE_MSG_WAITING;   // batch limit reached, but there are still more
+        _serial->writeFrame(out_frame, 1);
+      }
+#ifdef DISPLAY_CLASS
+      if (_ui) _ui->msgRead(getNumQueuedMessages());
+#endif
+    } else {
+      out_frame[0] = RESP_CODE_NO_MORE_MESSAGES;
+      _serial->writeFrame(out_frame, 1);
+      _sync_batch_left = 0;
+    }
   //} else if (!_serial->isWriteBusy()) {
   //  checkConnections();    // TODO - deprecate the 'Connections' stuff
   }
@@ -1834,20 +2555,47 @@ void MyMesh::checkSerialInterface() {
 
 void MyMesh::loop() {
   BaseChatMesh::loop();
+  flash_writer.loop();
+
+  if (_boot_loading) {
+    if (_store->loadStep(this, BOOT_LOAD_RECS_PER_LOOP)) {
+      _boot_loading = false;
+      onContactsLoaded();
+    } else {
+      return;   // app commands wait until the contacts are all loaded
+    }
+  }
 
   if (_cli_rescue) {
     checkCLIRescueCmd();
   } else {
     checkSerialInterface();
   }
+  checkChannelSends();
+  checkPushes();
+
+  if (_bulk_import && millisHasNowPassed(bulk_import_expiry)) {   // app never sent the last frame of the batch
+    finishBulkImport();
+  }
 
   // is there are pending dirty contacts write needed?
   if (dirty_contacts_expiry && millisHasNowPassed(dirty_contacts_expiry)) {
-    saveContacts();
+    saveDirtyContacts();
     dirty_contacts_expiry = 0;
   }
 
+  if (next_tables_save && millisHasNowPassed(next_tables_save)) {   // lazy snapshot of dedup tables
+    SimpleMeshTables* tables = (SimpleMeshTables *)getTables();
+    if (tables->isDirty()) tables->save(_store->getPrimaryFS(), TABLES_SNAPSHOT_FILE);
+    next_tables_save = futureMillis(TABLES_SAVE_INTERVAL_SECS * 1000);
+  }
+
 #ifdef DISPLAY_CLASS
+  if (advert_notify_pending && millisHasNowPassed(next_advert_notify)) {
+    if (_ui) _ui->notify(UIEventType::newContactMessage);
+    advert_notify_pending = false;
+    next_advert_notify = futureMillis(ADVERT_UI_NOTIFY_MILLIS);
+  }
   if (_ui) _ui->setHasConnection(_serial->isConnected());
 #endif
 }
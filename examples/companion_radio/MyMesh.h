@@ -28,10 +28,15 @@
 
 #include <RTClib.h>
 #include <helpers/ArduinoHelpers.h>
+#include <helpers/ChaChaRNG.h>
 #include <helpers/BaseSerialInterface.h>
 #include <helpers/IdentityStore.h>
+#include <helpers/FlashWriter.h>
+#include <helpers/MemoryStats.h>
+#include <LoopMonitor.h>
 #include <helpers/SimpleMeshTables.h>
 #include <helpers/StaticPoolPacketManager.h>
+#include <helpers/TelemetryCache.h>
 #include <target.h>
 
 /* ---------------------------------- CONFIGURATION ------------------------------------- */
@@ -63,12 +68,34 @@
 #define OFFLINE_QUEUE_SIZE 16
 #endif
 
+#ifndef PACKET_POOL_SIZE
+#define PACKET_POOL_SIZE 16
+#endif
+
 #ifndef BLE_NAME_PREFIX
 #define BLE_NAME_PREFIX "MeshCore-"
 #endif
 
+#ifndef CHAN_SEND_QUEUE_SIZE
+  #define CHAN_SEND_QUEUE_SIZE    4     // channel messages waiting to be paced out (CMD_SEND_CHANNEL_TXT_MSG)
+#endif
+#ifndef CHAN_SEND_AIRTIME_FACTOR
+  #define CHAN_SEND_AIRTIME_FACTOR  3   // min gap between channel sends, as multiple of the last one's air time
+#endif
+#define CHAN_ECHO_MAX_MILLIS      20000   // rebroadcasts of our last channel send are listened for up to this
+#define CHAN_SEND_TX_TIMEOUT      10000   // last channel send still not transmitted after this, so stop waiting
+
+#ifndef COMPANION_FRAGMENTS
+  #define COMPANION_FRAGMENTS  1   // 1 = reassemble RESPONSEs sent in MULTIPART fragments (eg. sensor history), ~4KB RAM
+#endif
+
+#ifndef MAX_DIRTY_CONTACTS
+#define MAX_DIRTY_CONTACTS 8    // changed contacts which are journalled, rather than rewriting all
+#endif
+
 #include <helpers/BaseChatMesh.h>
 #include <helpers/TransportKeyStore.h>
+#include "PushCoalescer.h"
 
 /* -------------------------------------------------------------------------------------- */
 
@@ -84,6 +111,15 @@ struct AdvertPath {
   uint8_t path[MAX_PATH_SIZE];
 };
 
+#ifndef REMOVED_CONTACTS_SIZE
+  #define REMOVED_CONTACTS_SIZE   8
+#endif
+
+struct RemovedContact {
+  uint8_t pub_key[PUB_KEY_SIZE];
+  uint32_t removed;   // by OUR clock, zero if slot unused
+};
+
 class MyMesh : public BaseChatMesh, public DataStoreHost {
 public:
   MyMesh(mesh::Radio &radio, mesh::RNG &rng, mesh::RTCClock &rtc, SimpleMeshTables &tables, DataStore& store, AbstractUITask* ui=NULL);
@@ -105,14 +141,17 @@ public:
 protected:
   float getAirtimeBudgetFactor() const override;
   int getInterferenceThreshold() const override;
-  int calcRxDelay(float score, uint32_t air_time) const override;
+  float getRxDelayBase() const override;
   uint8_t getExtraAckTransmitCount() const override;
+  mesh::DispatcherAction onRecvPacket(mesh::Packet* pkt) override;
   bool filterRecvFloodPacket(mesh::Packet* packet) override;
 
   void sendFloodScoped(const ContactInfo& recipient, mesh::Packet* pkt, uint32_t delay_millis=0) override;
   void sendFloodScoped(const mesh::GroupChannel& channel, mesh::Packet* pkt, uint32_t delay_millis=0) override;
 
   void logRxRaw(float snr, float rssi, const uint8_t raw[], int len) override;
+  void logTx(mesh::Packet* pkt, int len) override;
+  void logRx(mesh::Packet* pkt, int len, float score) override;
   bool isAutoAddEnabled() const override;
   bool onContactPathRecv(ContactInfo& from, uint8_t* in_path, uint8_t in_path_len, uint8_t* out_path, uint8_t out_path_len, uint8_t extra_type, uint8_t* extra, uint8_t extra_len) override;
   void onDiscoveredContact(ContactInfo &contact, bool is_new, uint8_t path_len, const uint8_t* path) override;
@@ -133,6 +172,7 @@ protected:
   uint8_t onContactRequest(const ContactInfo &contact, uint32_t sender_timestamp, const uint8_t *data,
                            uint8_t len, uint8_t *reply) override;
   void onContactResponse(const ContactInfo &contact, const uint8_t *data, uint8_t len) override;
+  void onContactLargeResponse(const ContactInfo &contact, const uint8_t *data, size_t len) override;
   void onControlDataRecv(mesh::Packet *packet) override;
   void onRawDataRecv(mesh::Packet *packet) override;
   void onTraceRecv(mesh::Packet *packet, uint32_t tag, uint32_t auth_code, uint8_t flags,
@@ -141,10 +181,12 @@ protected:
   uint32_t calcFloodTimeoutMillisFor(uint32_t pkt_airtime_millis) const override;
   uint32_t calcDirectTimeoutMillisFor(uint32_t pkt_airtime_millis, uint8_t path_len) const override;
   void onSendTimeout() override;
+  void onMessageSendResult(const ContactInfo* recipient, uint32_t expected_ack, bool delivered, uint32_t trip_millis, uint8_t attempts) override;
 
   // DataStoreHost methods
-  bool onContactLoaded(const ContactInfo& contact) override { return addContact(contact); }
+  bool onContactLoaded(const ContactInfo& contact, bool has_secret) override;
   bool getContactForSave(uint32_t idx, ContactInfo& contact) override { return getContactByIdx(idx, contact); }
+  void onContactRemoved(const uint8_t* pub_key) override;
   bool onChannelLoaded(uint8_t channel_idx, const ChannelDetails& ch) override { return setChannel(channel_idx, ch); }
   bool getChannelForSave(uint8_t channel_idx, ChannelDetails& ch) override { return getChannel(channel_idx, ch); }
 
@@ -155,14 +197,23 @@ protected:
 public:
   void savePrefs() { _store->savePrefs(_prefs, sensors.node_lat, sensors.node_lon); }
 
+  // received text messages, for the UI to page through
+  bool getHistoryEntry(uint32_t seq, MsgHistoryEntry& entry) { return _store->readHistory(seq, entry); }
+  uint32_t getHistoryFirst() const { return _store->getHistoryFirst(); }
+  uint32_t getHistoryNext() const { return _store->getHistoryNext(); }
+
 private:
   void writeOKFrame();
   void writeErrFrame(uint8_t err_code);
   void writeDisabledFrame();
   void writeContactRespFrame(uint8_t code, const ContactInfo &contact);
+  int writeCompactContact(uint8_t* dest, int max_len, const ContactInfo &contact);
+  void recordRemovedContact(const uint8_t* pub_key);
   void updateContactFromFrame(ContactInfo &contact, uint32_t& last_mod, const uint8_t *frame, int len);
   void addToOfflineQueue(const uint8_t frame[], int len);
   int getFromOfflineQueue(uint8_t frame[]);
+  int getNumQueuedMessages() const;
+  void addToHistory(uint8_t path_len, const char* origin, const char* text);
   int getBlobByKey(const uint8_t key[], int key_len, uint8_t dest_buf[]) override { 
     return _store->getBlobByKey(key, key_len, dest_buf);
   }
@@ -173,9 +224,21 @@ private:
   void checkCLIRescueCmd();
   void checkSerialInterface();
 
+  // paced channel sends
+  bool isChannelSendReady(unsigned long now) const;
+  bool sendChannelMessage(uint8_t channel_idx, uint32_t timestamp, const char* text, int len);
+  void checkChannelSends();
+  void pushChannelQueueDepth();
+  void checkPushes();
+
   // helpers, short-cuts
   void saveChannels() { _store->saveChannels(this); }
-  void saveContacts() { _store->saveContacts(this); }
+  void saveContacts() { _store->saveContacts(this); num_dirty_contacts = 0; }
+  void markContactDirty(const uint8_t* pub_key);
+  void saveDirtyContacts();
+  void finishBulkImport();
+  void onContactsLoaded();
+  const MemTable* getMemTables(int& num) const;
 
   DataStore* _store;
   NodePrefs _prefs;
@@ -191,18 +254,43 @@ private:
   uint32_t _most_recent_lastmod;
   uint32_t _active_ble_pin;
   bool _iter_started;
+  bool _iter_compact;        // CONTACTS_FLAG_COMPACT was given
+  bool _iter_adverts;        // for CMD_EXPORT_CONTACTS
+  int _iter_removed_idx;     // -1 while still sending contacts, then index into removed_contacts[]
+  RemovedContact removed_contacts[REMOVED_CONTACTS_SIZE];   // for delta syncs of contacts list
+  int next_removed;
+  uint32_t removed_unknown_until;   // removals at or before this time can't be reported (not recorded, or evicted)
+  uint16_t _sync_batch_left;   // messages still to send for CMD_SYNC_MESSAGES_BATCH
+  bool _bulk_import;   // CMD_IMPORT_CONTACTS batch in progress (contacts are saved at the end)
+  uint16_t _bulk_imported, _bulk_rejected;
+  unsigned long bulk_import_expiry;
+  bool _push_coalesce;   // CMD_SET_PUSH_COALESCE
+  PushCoalescer pushes;
+  bool _raw_mode;   // host is doing all packet processing (CMD_SET_RAW_MODE), received frames are just passed up
   bool _cli_rescue;
   char cli_command[80];
   uint8_t app_target_ver;
-  uint8_t *sign_data;
+  uint8_t *sign_data;     // buffered message, for SIGN_MODE_PURE
+  uint8_t sign_mode;
+  mesh::SignState sign_state;   // SIGN_MODE_PREHASH, message is hashed as it arrives
   uint32_t sign_data_len;
   unsigned long dirty_contacts_expiry;
+  uint8_t dirty_contacts[MAX_DIRTY_CONTACTS][PUB_KEY_SIZE];   // contacts to be written to journal
+  int num_dirty_contacts;   // or -1 if too many, so need to rewrite all
+  unsigned long next_tables_save;
+  bool advert_notify_pending;
+  unsigned long next_advert_notify;
+  bool _boot_loading;   // contacts/channels still being loaded (see loop())
 
   TransportKey send_scope;
 
   uint8_t cmd_frame[MAX_FRAME_SIZE + 1];
   uint8_t out_frame[MAX_FRAME_SIZE + 1];
-  CayenneLPP telemetry;
+  LPPSlice telemetry;
+  TelemetryCache telem_cache;
+#if COMPANION_FRAGMENTS
+  FragmentStore frag_store;
+#endif
 
   struct Frame {
     uint8_t len;
@@ -210,8 +298,9 @@ private:
 
     bool isChannelMsg() const;
   };
-  int offline_queue_len;
-  Frame offline_queue[OFFLINE_QUEUE_SIZE];
+  ExtRamArray<Frame, OFFLINE_QUEUE_SIZE> offline_frames;
+  uint16_t offline_queue[OFFLINE_QUEUE_SIZE];   // ring of indexes into offline_frames[], queued ones (oldest first), then free ones
+  int offline_queue_head, offline_queue_len;
 
   struct AckTableEntry {
     unsigned long msg_sent;
@@ -222,8 +311,52 @@ private:
   AckTableEntry expected_ack_table[EXPECTED_ACK_TABLE_SIZE]; // circular table
   int next_ack_idx;
 
+  struct ChannelSend {
+    uint32_t timestamp;
+    uint8_t channel_idx;
+    uint8_t len;
+    char text[MAX_TEXT_LEN];
+  };
+  ChannelSend chan_sends[CHAN_SEND_QUEUE_SIZE];   // ring, oldest first
+  int chan_send_head, chan_send_len;
+
+  // the last channel send, and its rebroadcasts heard (the measured 'settle' time of a flood in this neighbourhood)
+  bool chan_track_next;      // next sendFloodScoped() of a channel packet is ours to track
+  bool chan_tx_pending;      // queued in Dispatcher, not transmitted yet
+  uint8_t chan_sent_hash[MAX_HASH_SIZE];
+  unsigned long chan_sent_at;   // when queued, then when transmitted
+  uint32_t chan_sent_airtime;
+  unsigned long chan_echo_at;   // when last rebroadcast of it was heard (zero if none)
+  uint32_t chan_echo_delay;     // ...and how long after our transmit
+  uint32_t chan_settle_millis;  // average of chan_echo_delay over recent sends (zero if none yet)
+
   #define ADVERT_PATH_TABLE_SIZE   16
   AdvertPath advert_paths[ADVERT_PATH_TABLE_SIZE]; // circular table
 };
 
 extern MyMesh the_mesh;
+
+#if defined(MESH_TASK_CORE) && defined(RP2040_PLATFORM)
+  #if MESH_TASK_CORE != 1
+    #error "MESH_TASK_CORE must be 1 on RP2040"
+  #endif
+#elif defined(MESH_TASK_CORE) && (!defined(ESP32) || defined(CONFIG_FREERTOS_UNICORE))
+  #error "MESH_TASK_CORE needs a dual-core ESP32, or an RP2040"
+#endif
+
+#if defined(MESH_TASK_CORE)   // mesh runs on its own task, pinned to this core (see main.cpp)
+  #ifdef RP2040_PLATFORM
+    #include <helpers/rp2040/MeshTask.h>
+  #else
+    #include <helpers/esp32/MeshTask.h>
+  #endif
+  extern MeshTask mesh_task;
+  /** \brief  held (for its scope) by the UI/app around calls into the_mesh */
+  struct MeshLock : public MeshTask::Guard {
+    MeshLock() : MeshTask::Guard(mesh_task) { }
+  };
+#else
+  struct MeshLock {   // all in the one loop(), so nothing to lock
+    MeshLock() { }
+  };
+#endif
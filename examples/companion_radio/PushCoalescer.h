@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef PUSH_COALESCE_MILLIS
+  #define PUSH_COALESCE_MILLIS    1000    // events of the same kind within this go in the one frame
+#endif
+#ifndef PUSH_COALESCE_MAX_KEYS
+  #define PUSH_COALESCE_MAX_KEYS  16      // per frame (frame is sent early once full)
+#endif
+#define PUSH_KEY_PREFIX_SIZE      6
+
+#define PUSH_KIND_ADVERT          0
+#define PUSH_KIND_PATH_UPDATED    1
+#define PUSH_KIND_NUM             2
+
+/**
+ * \brief  Merges the companion's push notifications, so a burst of them (eg. an advert wave) costs one frame over
+ *     BLE instead of one per event. Contact events are batched per kind, as a list of pub_key prefixes, and sent once
+ *     the first in the batch is PUSH_COALESCE_MILLIS old (or the batch is full). Repeats of a 'messages waiting' tickle
+ *     within the window are dropped, except for one at the end of it.
+ *     The caller sends whatever nextFrame() gives, whenever the interface isn't busy.
+*/
+class PushCoalescer {
+  struct Batch {
+    uint8_t n;
+    bool overflow;   // more events than would fit
+    unsigned long due;
+    uint8_t keys[PUSH_COALESCE_MAX_KEYS][PUSH_KEY_PREFIX_SIZE];
+  };
+  Batch _batches[PUSH_KIND_NUM];
+  bool _tickle_pending;
+  unsigned long _tickle_window;   // end of window of last tickle sent
+
+public:
+  PushCoalescer() { reset(); }
+
+  void reset() {
+    memset(_batches, 0, sizeof(_batches));
+    _tickle_pending = false;
+    _tickle_window = 0;
+  }
+
+  void addKey(int kind, const uint8_t* pub_key, unsigned long now) {
+    Batch& b = _batches[kind];
+    for (int i = 0; i < b.n; i++) {
+      if (memcmp(b.keys[i], pub_key, PUSH_KEY_PREFIX_SIZE) == 0) return;   // already in this batch
+    }
+    if (b.n >= PUSH_COALESCE_MAX_KEYS) {   // interface has been too busy to send the full batch
+      b.overflow = true;
+      return;
+    }
+    if (b.n == 0) b.due = now + PUSH_COALESCE_MILLIS;
+    memcpy(b.keys[b.n++], pub_key, PUSH_KEY_PREFIX_SIZE);
+  }
+
+  void addTickle() { _tickle_pending = true; }
+
+  /**
+   * \param  codes  the push code to use per PUSH_KIND_*
+   * \returns  length of frame put in 'dest' (space for at least 2 + PUSH_COALESCE_MAX_KEYS*PUSH_KEY_PREFIX_SIZE), or
+   *     zero if nothing is due. Frame is: code, count (0x80 bit set if some were left out), then the key prefixes
+  */
+  int nextFrame(uint8_t* dest, const uint8_t codes[], uint8_t tickle_code, unsigned long now) {
+    if (_tickle_pending && (long)(now - _tickle_window) >= 0) {
+      _tickle_pending = false;
+      _tickle_window = now + PUSH_COALESCE_MILLIS;   // further tickles before this are held back
+      dest[0] = tickle_code;
+      return 1;
+    }
+    for (int k = 0; k < PUSH_KIND_NUM; k++) {
+      Batch& b = _batches[k];
+      if (b.n == 0 || (b.n < PUSH_COALESCE_MAX_KEYS && (long)(now - b.due) < 0)) continue;
+
+      int len = 0;
+      dest[len++] = codes[k];
+      dest[len++] = b.n | (b.overflow ? 0x80 : 0);
+      memcpy(&dest[len], b.keys, b.n * PUSH_KEY_PREFIX_SIZE); len += b.n * PUSH_KEY_PREFIX_SIZE;
+      b.n = 0;
+      b.overflow = false;
+      return len;
+    }
+    return 0;
+  }
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "AbstractUITask.h"
+#include <helpers/SPSCQueue.h>
+#include <helpers/TxtDataHelpers.h>
+
+#ifndef UI_EVENT_QUEUE_SIZE
+  #define UI_EVENT_QUEUE_SIZE   8     // must be a power of 2
+#endif
+
+/**
+ * \brief  Stands in for the UITask, as seen by the mesh, when the mesh runs on its own task (see MESH_TASK_CORE).
+ *     The mesh's calls are queued, and handed to the real UITask by loop(), on the UI's own task, so the UI state is
+ *     only ever touched by one task, and the mesh never waits on the UI.
+*/
+class UIEventQueue : public AbstractUITask {
+  enum Kind : uint8_t { MSG_READ, NEW_MSG, NOTIFY };
+  struct Event {
+    Kind kind;
+    UIEventType type;
+    uint8_t path_len;
+    int msgcount;
+    char from_name[32];
+    char text[80];
+  };
+  AbstractUITask* _target;
+  SPSCQueue<Event, UI_EVENT_QUEUE_SIZE> _events;
+
+public:
+  UIEventQueue(AbstractUITask& target, mesh::MainBoard* board, BaseSerialInterface* serial)
+    : AbstractUITask(board, serial), _target(&target) { }
+
+  const RenderStats& getRenderStats() const override { return _target->getRenderStats(); }
+
+  void msgRead(int msgcount) override {
+    Event e;
+    e.kind = MSG_READ;
+    e.msgcount = msgcount;
+    _events.push(e);
+  }
+  void newMsg(uint8_t path_len, const char* from_name, const char* text, int msgcount) override {
+    Event e;
+    e.kind = NEW_MSG;
+    e.path_len = path_len;
+    e.msgcount = msgcount;
+    StrHelper::strncpy(e.from_name, from_name, sizeof(e.from_name));
+    StrHelper::strncpy(e.text, text, sizeof(e.text));
+    _events.push(e);
+  }
+  void notify(UIEventType t = UIEventType::none) override {
+    Event e;
+    e.kind = NOTIFY;
+    e.type = t;
+    _events.push(e);
+  }
+
+  /** \brief  delivers the queued events to the UITask. Call from the UI's task (before the UITask's loop()) */
+  void loop() override {
+    Event e;
+    while (_events.pop(e)) {
+      if (e.kind == MSG_READ) {
+        _target->msgRead(e.msgcount);
+      } else if (e.kind == NEW_MSG) {
+        _target->newMsg(e.path_len, e.from_name, e.text, e.msgcount);
+      } else {
+        _target->notify(e.type);
+      }
+    }
+    _target->setHasConnection(hasConnection());
+  }
+};
@@ -1,6 +1,7 @@
 #include <Arduino.h>   // needed for PlatformIO
 #include <Mesh.h>
 #include "MyMesh.h"
+#include <LoopMonitor.h>
 
 // Believe it or not, this std C function is busted on some platforms!
 static uint32_t _atoi(const char* sp) {
@@ -89,16 +90,37 @@ static uint32_t _atoi(const char* sp) {
 #ifdef DISPLAY_CLASS
   #include "UITask.h"
   UITask ui_task(&board, &serial_interface);
+  #ifdef MESH_TASK_CORE
+    #include "UIEventQueue.h"
+    UIEventQueue ui_events(ui_task, &board, &serial_interface);   // mesh -> UI, across the tasks
+  #endif
 #endif
 
-StdRNG fast_rng;
+ChaChaRNG fast_rng;
 SimpleMeshTables tables;
 MyMesh the_mesh(radio_driver, fast_rng, rtc_clock, tables, store
-   #ifdef DISPLAY_CLASS
+   #if defined(DISPLAY_CLASS) && defined(MESH_TASK_CORE)
+      , &ui_events
+   #elif defined(DISPLAY_CLASS)
       , &ui_task
    #endif
 );
 
+#ifdef DISPLAY_CLASS
+  static void serviceMesh() {   // while display waits on the panel (see DisplayDriver::setBusyHook())
+    the_mesh.loop();
+  }
+#endif
+
+#ifdef MESH_TASK_CORE
+  MeshTask mesh_task;
+
+  static void meshLoop(void*) {
+    the_mesh.loop();
+    rtc_clock.tick();
+  }
+#endif
+
 /* END GLOBAL OBJECTS */
 
 void halt() {
@@ -125,7 +147,10 @@ void setup() {
 
   if (!radio_init()) { halt(); }
 
-  fast_rng.begin(radio_get_rng_seed());
+  {
+    HardwareRNG seed_src(radio_get_rng_seed);   // 32 bytes of TRNG + radio noise
+    fast_rng.begin(seed_src);
+  }
 
 #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
   InternalFS.begin();
@@ -219,13 +244,51 @@ void setup() {
 #ifdef DISPLAY_CLASS
   ui_task.begin(disp, &sensors, the_mesh.getNodePrefs());  // still want to pass this in as dependency, as prefs might be moved
 #endif
+
+#ifdef MESH_TASK_CORE
+  if (!mesh_task.begin(meshLoop, NULL, MESH_TASK_CORE)) {
+    MESH_DEBUG_PRINTLN("setup(): can't start mesh task, running mesh from loop()");
+  #ifdef DISPLAY_CLASS
+    if (disp) disp->setBusyHook(serviceMesh);
+  #endif
+  }
+#elif defined(DISPLAY_CLASS)
+  if (disp) disp->setBusyHook(serviceMesh);
+#endif
 }
 
 void loop() {
+#ifdef MESH_TASK_CORE
+  if (mesh_task.isRunning()) {   // mesh is on its own task, so this loop is just the app side
+    {
+      MeshLock lock;   // (shared with the mesh, eg. location, telemetry)
+      sensors.loop();
+    }
+  #ifdef DISPLAY_CLASS
+    ui_events.loop();
+    ui_task.loop();
+  #endif
+    return;
+  }
+  #ifdef DISPLAY_CLASS
+  ui_events.loop();   // (mesh still sends to the queue)
+  #endif
+#endif
+  LOOP_START();   // (only when the mesh is on this task)
   the_mesh.loop();
   sensors.loop();
 #ifdef DISPLAY_CLASS
   ui_task.loop();
 #endif
   rtc_clock.tick();
+  LOOP_END();   // (not counting idle sleep)
+
+#ifdef IDLE_SLEEP_MAX_MILLIS
+  // nothing for the Dispatcher (or UI) to do until next deadline, so let board idle (this also caps app/serial latency)
+  uint32_t wait = the_mesh.getMillisToNextWakeup(IDLE_SLEEP_MAX_MILLIS);
+  #ifdef DISPLAY_CLASS
+  if (wait > 0) wait = ui_task.getMillisToNextWakeup(wait);
+  #endif
+  board.idle(wait);
+#endif
 }
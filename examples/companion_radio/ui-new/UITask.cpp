@@ -1,5 +1,6 @@
 #include "UITask.h"
 #include <helpers/TxtDataHelpers.h>
+#include <LoopMonitor.h>
 #include "../MyMesh.h"
 #include "target.h"
 
@@ -135,7 +136,10 @@ class HomeScreen : public UIScreen {
       sensors_lpp.reset();
       sensors_nb = 0;
       sensors_lpp.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
-      sensors.querySensors(0xFF, sensors_lpp);
+      {
+        MeshLock lock;   // (sensors are shared with the mesh)
+        sensors.querySensors(0xFF, sensors_lpp);
+      }
       LPPReader reader (sensors_lpp.getBuffer(), sensors_lpp.getSize());
       uint8_t channel, type;
       while(reader.readHeader(channel, type)) {
@@ -203,7 +207,10 @@ public:
         display.drawTextCentered(display.width() / 2, 43, tmp);
       }
     } else if (_page == HomePage::RECENT) {
-      the_mesh.getRecentlyHeard(recent, UI_RECENT_LIST_SIZE);
+      {
+        MeshLock lock;
+        the_mesh.getRecentlyHeard(recent, UI_RECENT_LIST_SIZE);
+      }
       display.setColor(DisplayDriver::GREEN);
       int y = 20;
       for (int i = 0; i < UI_RECENT_LIST_SIZE; i++, y += 11) {
@@ -393,7 +400,12 @@ public:
       }
       return true;
     }
+    if (c == KEY_ENTER && _page == HomePage::FIRST) {
+      _task->gotoMessageHistory();
+      return true;
+    }
     if (c == KEY_ENTER && _page == HomePage::BLUETOOTH) {
+      MeshLock lock;   // (serial interface is polled by the mesh)
       if (_task->isSerialEnabled()) {  // toggle Bluetooth on/off
         _task->disableSerial();
       } else {
@@ -403,7 +415,12 @@ public:
     }
     if (c == KEY_ENTER && _page == HomePage::ADVERT) {
       _task->notify(UIEventType::ack);
-      if (the_mesh.advert()) {
+      bool sent;
+      {
+        MeshLock lock;
+        sent = the_mesh.advert();
+      }
+      if (sent) {
         _task->showAlert("Advert sent!", 1000);
       } else {
         _task->showAlert("Advert failed..", 1000);
@@ -435,29 +452,51 @@ class MsgPreviewScreen : public UIScreen {
   UITask* _task;
   mesh::RTCClock* _rtc;
 
-  struct MsgEntry {
-    uint32_t timestamp;
-    char origin[62];
-    char msg[78];
-  };
-  #define MAX_UNREAD_MSGS   32
-  int num_unread;
-  MsgEntry unread[MAX_UNREAD_MSGS];
+  // messages are read from the history in flash as they're viewed (see MyMesh::getHistoryEntry()), with just a few cached
+  #define MSG_ROW_CACHE   4
+  MsgHistoryEntry _rows[MSG_ROW_CACHE];
+  int _next_row;
+  uint32_t _view_seq;     // message being shown
+  uint32_t _unread_seq;   // oldest unread, these are _unread_seq .. (getHistoryNext() - 1)
+
+  const MsgHistoryEntry* getRow(uint32_t seq) {
+    for (int i = 0; i < MSG_ROW_CACHE; i++) {
+      if (_rows[i].seq == seq) return &_rows[i];
+    }
+    auto r = &_rows[_next_row];
+    MeshLock lock;   // (history file is appended to by the mesh)
+    if (!the_mesh.getHistoryEntry(seq, *r)) {
+      r->seq = 0;   // don't leave a partial read in the cache
+      return NULL;
+    }
+    _next_row = (_next_row + 1) % MSG_ROW_CACHE;
+    return r;
+  }
+
+  void clampToHistory() {   // oldest may have been overwritten, by newer ones
+    uint32_t first = the_mesh.getHistoryFirst();
+    if (_unread_seq < first) _unread_seq = first;
+    if (_view_seq < first) _view_seq = first;
+  }
 
 public:
-  MsgPreviewScreen(UITask* task, mesh::RTCClock* rtc) : _task(task), _rtc(rtc) { num_unread = 0; }
+  MsgPreviewScreen(UITask* task, mesh::RTCClock* rtc) : _task(task), _rtc(rtc) {
+    memset(_rows, 0, sizeof(_rows));
+    _next_row = 0;
+    _view_seq = _unread_seq = the_mesh.getHistoryNext();
+  }
 
-  void addPreview(uint8_t path_len, const char* from_name, const char* msg) {
-    if (num_unread >= MAX_UNREAD_MSGS) return;  // full
+  int getNumUnread() const { return the_mesh.getHistoryNext() - _unread_seq; }
+  bool hasHistory() const { return the_mesh.getHistoryNext() > the_mesh.getHistoryFirst(); }
 
-    auto p = &unread[num_unread++];
-    p->timestamp = _rtc->getCurrentTime();
-    if (path_len == 0xFF) {
-      sprintf(p->origin, "(D) %s:", from_name);
-    } else {
-      sprintf(p->origin, "(%d) %s:", (uint32_t) path_len, from_name);
-    }
-    StrHelper::strncpy(p->msg, msg, sizeof(p->msg));
+  void onNewMessage() {   // (already added to history)
+    if (getNumUnread() == 1) _view_seq = _unread_seq;   // otherwise, stay on the oldest unread
+    clampToHistory();
+  }
+
+  void openHistory() {
+    _view_seq = getNumUnread() > 0 ? _unread_seq : the_mesh.getHistoryNext() - 1;
+    clampToHistory();
   }
 
   int render(DisplayDriver& display) override {
@@ -465,10 +504,21 @@ public:
     display.setCursor(0, 0);
     display.setTextSize(1);
     display.setColor(DisplayDriver::GREEN);
-    sprintf(tmp, "Unread: %d", num_unread);
+    int num_unread = getNumUnread();
+    if (num_unread > 0) {
+      sprintf(tmp, "Unread: %d", num_unread);
+    } else {
+      sprintf(tmp, "%d/%d", (int)(the_mesh.getHistoryNext() - _view_seq), (int)(the_mesh.getHistoryNext() - the_mesh.getHistoryFirst()));
+    }
     display.print(tmp);
 
-    auto p = &unread[0];
+    auto p = getRow(_view_seq);
+    if (p == NULL) {
+      display.setCursor(0, 14);
+      display.setColor(DisplayDriver::LIGHT);
+      display.print("(not available)");
+      return 1000;
+    }
 
     int secs = _rtc->getCurrentTime() - p->timestamp;
     if (secs < 60) {
@@ -485,14 +535,20 @@ public:
 
     display.setCursor(0, 14);
     display.setColor(DisplayDriver::YELLOW);
-    char filtered_origin[sizeof(p->origin)];
-    display.translateUTF8ToBlocks(filtered_origin, p->origin, sizeof(filtered_origin));
+    char origin[sizeof(p->origin) + 8];
+    if (p->path_len == 0xFF) {
+      sprintf(origin, "(D) %s:", p->origin);
+    } else {
+      sprintf(origin, "(%d) %s:", (uint32_t) p->path_len, p->origin);
+    }
+    char filtered_origin[sizeof(origin)];
+    display.translateUTF8ToBlocks(filtered_origin, origin, sizeof(filtered_origin));
     display.print(filtered_origin);
 
     display.setCursor(0, 25);
     display.setColor(DisplayDriver::LIGHT);
-    char filtered_msg[sizeof(p->msg)];
-    display.translateUTF8ToBlocks(filtered_msg, p->msg, sizeof(filtered_msg));
+    char filtered_msg[sizeof(p->text)];
+    display.translateUTF8ToBlocks(filtered_msg, p->text, sizeof(filtered_msg));
     display.printWordWrap(filtered_msg, display.width());
 
 #if AUTO_OFF_MILLIS==0 // probably e-ink
@@ -503,20 +559,22 @@ public:
   }
 
   bool handleInput(char c) override {
-    if (c == KEY_NEXT || c == KEY_RIGHT) {
-      num_unread--;
-      if (num_unread == 0) {
+    if (c == KEY_NEXT || c == KEY_RIGHT) {   // on to newer (this one now read)
+      if (_view_seq + 1 >= the_mesh.getHistoryNext()) {
+        _unread_seq = the_mesh.getHistoryNext();   // all read
         _task->gotoHomeScreen();
       } else {
-        // delete first/curr item from unread queue
-        for (int i = 0; i < num_unread; i++) {
-          unread[i] = unread[i + 1];
-        }
+        _view_seq++;
+        if (_unread_seq < _view_seq) _unread_seq = _view_seq;
       }
       return true;
     }
+    if (c == KEY_PREV || c == KEY_LEFT) {   // back through older ones
+      if (_view_seq > the_mesh.getHistoryFirst()) _view_seq--;
+      return true;
+    }
     if (c == KEY_ENTER) {
-      num_unread = 0;  // clear unread queue
+      _unread_seq = the_mesh.getHistoryNext();  // clear unread
       _task->gotoHomeScreen();
       return true;
     }
@@ -530,7 +588,11 @@ void UITask::begin(DisplayDriver* display, SensorManager* sensors, NodePrefs* no
   _auto_off = millis() + AUTO_OFF_MILLIS;
 
 #if defined(PIN_USER_BTN)
+  #if UI_BUTTON_IRQ
+  user_btn.beginInterrupt();   // so loop() can idle, until button is touched
+  #else
   user_btn.begin();
+  #endif
 #endif
 #if defined(PIN_USER_BTN_ANA)
   analog_btn.begin();
@@ -604,13 +666,13 @@ void UITask::msgRead(int msgcount) {
 void UITask::newMsg(uint8_t path_len, const char* from_name, const char* text, int msgcount) {
   _msgcount = msgcount;
 
-  ((MsgPreviewScreen *) msg_preview)->addPreview(path_len, from_name, text);
+  ((MsgPreviewScreen *) msg_preview)->onNewMessage();
   setCurrScreen(msg_preview);
 
   if (_display != NULL) {
     if (!_display->isOn()) _display->turnOn();
     _auto_off = millis() + AUTO_OFF_MILLIS;  // extend the auto-off timer
-    _next_refresh = 100;  // trigger refresh
+    _render.request();
   }
 }
 
@@ -635,9 +697,19 @@ void UITask::userLedHandler() {
 #endif
 }
 
+void UITask::gotoMessageHistory() {
+  auto p = (MsgPreviewScreen *) msg_preview;
+  if (p->hasHistory()) {
+    p->openHistory();
+    setCurrScreen(msg_preview);
+  } else {
+    showAlert("No messages", 800);
+  }
+}
+
 void UITask::setCurrScreen(UIScreen* c) {
   curr = c;
-  _next_refresh = 100;
+  _render.request();
 }
 
 /*
@@ -658,6 +730,7 @@ void UITask::shutdown(bool restart){
 
   #endif // PIN_BUZZER
 
+  flash_writer.flush();   // (any saves still queued)
   if (restart) {
     _board->reboot();
   } else {
@@ -676,6 +749,7 @@ bool UITask::isButtonPressed() const {
 }
 
 void UITask::loop() {
+  LOOP_SCOPE(LOOP_SECT_UI);
   char c = 0;
 #if UI_HAS_JOYSTICK
   int ev = user_btn.check();
@@ -742,7 +816,7 @@ void UITask::loop() {
   if (c != 0 && curr) {
     curr->handleInput(c);
     _auto_off = millis() + AUTO_OFF_MILLIS;   // extend auto-off timer
-    _next_refresh = 100;  // trigger refresh
+    _render.request();
   }
 
   userLedHandler();
@@ -754,7 +828,8 @@ void UITask::loop() {
   if (curr) curr->poll();
 
   if (_display != NULL && _display->isOn()) {
-    if (millis() >= _next_refresh && curr) {
+    if (curr && _render.isDue(millis())) {   // capped rate, so bursts of events are coalesced
+      _render.beginFrame(millis());
       _display->startFrame();
       int delay_millis = curr->render(*_display);
       if (millis() < _alert_expiry) {  // render alert popup
@@ -766,11 +841,12 @@ void UITask::loop() {
         _display->setColor(DisplayDriver::LIGHT);  // draw box border
         _display->drawRect(p, y, _display->width() - p*2, y);
         _display->drawTextCentered(_display->width() / 2, y + p*3, _alert);
-        _next_refresh = _alert_expiry;   // will need refresh when alert is dismissed
+        _render.scheduleAt(_alert_expiry);   // will need refresh when alert is dismissed
       } else {
-        _next_refresh = millis() + delay_millis;
+        _render.scheduleAt(millis() + delay_millis);
       }
       _display->endFrame();
+      _render.endFrame(millis());
     }
 #if AUTO_OFF_MILLIS > 0
     if (millis() > _auto_off) {
@@ -809,6 +885,45 @@ void UITask::loop() {
 #endif
 }
 
+static void limitWait(uint32_t& wait, unsigned long now, unsigned long when) {
+  long diff = (long)(when - now);
+  if (diff <= 0) {
+    wait = 0;
+  } else if ((unsigned long)diff < wait) {
+    wait = diff;
+  }
+}
+
+uint32_t UITask::getMillisToNextWakeup(uint32_t max_millis) {
+  if (_display != NULL && _display->isOn()) return 0;   // screens animate and poll, so only idle once display is off
+#if UI_HAS_JOYSTICK || defined(PIN_USER_BTN_ANA)
+  return 0;   // buttons which are polled
+#else
+  #ifdef PIN_BUZZER
+  if (buzzer.isPlaying()) return 0;
+  #endif
+  #ifdef PIN_VIBRATION
+  if (vibration.isVibrating()) return 0;
+  #endif
+
+  uint32_t wait = max_millis;
+  unsigned long now = millis();
+  #ifdef PIN_USER_BTN
+  wait = user_btn.getMillisToNextWakeup(wait);
+  #endif
+  #ifdef PIN_STATUS_LED
+  limitWait(wait, now, next_led_change);
+  #endif
+  #if defined(BACKLIGHT_BTN)
+  limitWait(wait, now, next_backlight_btn_check);
+  #endif
+  #ifdef AUTO_SHUTDOWN_MILLIVOLTS
+  limitWait(wait, now, next_batt_chck);
+  #endif
+  return wait;
+#endif
+}
+
 char UITask::checkDisplayOn(char c) {
   if (_display != NULL) {
     if (!_display->isOn()) {
@@ -816,13 +931,14 @@ char UITask::checkDisplayOn(char c) {
       c = 0;
     }
     _auto_off = millis() + AUTO_OFF_MILLIS;   // extend auto-off timer
-    _next_refresh = 0;  // trigger refresh
+    _render.request();
   }
   return c;
 }
 
 char UITask::handleLongPress(char c) {
   if (millis() - ui_started_at < 8000) {   // long press in first 8 seconds since startup -> CLI/rescue
+    MeshLock lock;
     the_mesh.enterCLIRescue();
     c = 0;   // consume event
   }
@@ -870,7 +986,7 @@ void UITask::toggleGPS() {
           notify(UIEventType::ack);
           showAlert("GPS: Enabled", 800);
         }
-        _next_refresh = 0;
+        _render.request();
         break;
       }
     }
@@ -889,7 +1005,10 @@ void UITask::toggleBuzzer() {
       showAlert("Buzzer: OFF", 800);
     }
     _node_prefs->buzzer_quiet = buzzer.isQuiet();
-    the_mesh.savePrefs();
-    _next_refresh = 0;  // trigger refresh
+    {
+      MeshLock lock;
+      the_mesh.savePrefs();
+    }
+    _render.request();
   #endif
 }
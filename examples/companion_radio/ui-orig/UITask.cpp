@@ -1,6 +1,7 @@
 #include "UITask.h"
 #include <Arduino.h>
 #include <helpers/TxtDataHelpers.h>
+#include <LoopMonitor.h>
 #include "../MyMesh.h"
 
 #define AUTO_OFF_MILLIS     15000   // 15 seconds
@@ -123,7 +124,7 @@ void UITask::msgRead(int msgcount) {
 void UITask::clearMsgPreview() {
   _origin[0] = 0;
   _msg[0] = 0;
-  _need_refresh = true;
+  _render.request();
 }
 
 void UITask::newMsg(uint8_t path_len, const char* from_name, const char* text, int msgcount) {
@@ -139,7 +140,7 @@ void UITask::newMsg(uint8_t path_len, const char* from_name, const char* text, i
   if (_display != NULL) {
     if (!_display->isOn()) _display->turnOn();
     _auto_off = millis() + AUTO_OFF_MILLIS;  // extend the auto-off timer
-    _need_refresh = true;
+    _render.request();
   }
 }
 
@@ -180,7 +181,7 @@ void UITask::renderCurrScreen() {
     _display->setColor(DisplayDriver::GREEN);
     _display->print(_alert);
     _alert[0] = 0;
-    _need_refresh = true;
+    _render.request();
     return;
   } else if (_origin[0] && _msg[0]) { // message preview
     // render message preview
@@ -247,7 +248,6 @@ void UITask::renderCurrScreen() {
       _display->setColor(DisplayDriver::LIGHT); 
     }
   }
-  _need_refresh = false;
 }
 
 void UITask::userLedHandler() {
@@ -293,6 +293,7 @@ void UITask::shutdown(bool restart){
 
   #endif // PIN_BUZZER
 
+  flash_writer.flush();   // (any saves still queued)
   if (restart) {
     _board->reboot();
   } else {
@@ -302,6 +303,7 @@ void UITask::shutdown(bool restart){
 }
 
 void UITask::loop() {
+  LOOP_SCOPE(LOOP_SECT_UI);
   #ifdef PIN_USER_BTN
     if (_userButton) {
       _userButton->update();
@@ -321,15 +323,15 @@ void UITask::loop() {
   if (_display != NULL && _display->isOn()) {
     static bool _firstBoot = true;
     if(_firstBoot && (millis() - ui_started_at) >= BOOT_SCREEN_MILLIS) {
-      _need_refresh = true;
+      _render.request();
       _firstBoot = false;
     }
-    if (millis() >= _next_refresh && _need_refresh) {
+    if (_render.isDue(millis())) {   // at most once a second, so bursts of events are coalesced
+      _render.beginFrame(millis());
       _display->startFrame();
       renderCurrScreen();
       _display->endFrame();
-
-      _next_refresh = millis() + 1000;   // refresh every second
+      _render.endFrame(millis());
     }
     if (millis() > _auto_off) {
       _display->turnOff();
@@ -360,10 +362,10 @@ void UITask::handleButtonShortPress() {
         clearMsgPreview();
       } else {
         // Otherwise, refresh the display
-        _need_refresh = true;
+        _render.request();
       }
     } else {
-      _need_refresh = true; // display just turned on, so we need to refresh
+      _render.request(); // display just turned on, so we need to refresh
     }
     // Note: Display turn-on and auto-off timer extension are handled by handleButtonAnyPress
   }
@@ -375,14 +377,19 @@ void UITask::handleButtonDoublePress() {
   #ifdef PIN_BUZZER
       notify(UIEventType::ack);
   #endif
-  if (the_mesh.advert()) {
+  bool sent;
+  {
+    MeshLock lock;
+    sent = the_mesh.advert();
+  }
+  if (sent) {
     MESH_DEBUG_PRINTLN("Advert sent!");
     sprintf(_alert, "Advert sent!");
   } else {
     MESH_DEBUG_PRINTLN("Advert failed!");
     sprintf(_alert, "Advert failed..");
   }
-  _need_refresh = true;
+  _render.request();
 }
 
 void UITask::handleButtonTriplePress() {
@@ -398,8 +405,11 @@ void UITask::handleButtonTriplePress() {
       sprintf(_alert, "Buzzer: OFF");
     }
     _node_prefs->buzzer_quiet = buzzer.isQuiet();
-    the_mesh.savePrefs();
-    _need_refresh = true;
+    {
+      MeshLock lock;
+      the_mesh.savePrefs();
+    }
+    _render.request();
   #endif
 }
 
@@ -423,12 +433,13 @@ void UITask::handleButtonQuadruplePress() {
       }
     }
   }
-  _need_refresh = true;
+  _render.request();
 }
 
 void UITask::handleButtonLongPress() {
   MESH_DEBUG_PRINTLN("UITask: long press triggered");
   if (millis() - ui_started_at < 8000) {   // long press in first 8 seconds since startup -> CLI/rescue
+    MeshLock lock;
     the_mesh.enterCLIRescue();
   } else {
     shutdown();
@@ -20,14 +20,13 @@ class UITask : public AbstractUITask {
 #ifdef PIN_BUZZER
   genericBuzzer buzzer;
 #endif
-  unsigned long _next_refresh, _auto_off;
+  unsigned long _auto_off;
   NodePrefs* _node_prefs;
   char _version_info[32];
   char _origin[62];
   char _msg[80];
   char _alert[80];
   int _msgcount;
-  bool _need_refresh = true;
   bool _displayWasOn = false;  // Track display state before button press
   unsigned long ui_started_at;
 
@@ -55,7 +54,7 @@ class UITask : public AbstractUITask {
 public:
 
   UITask(mesh::MainBoard* board, BaseSerialInterface* serial) : AbstractUITask(board, serial), _display(NULL), _sensors(NULL) {
-      _next_refresh = 0;
+      _render.setMinInterval(1000);
       ui_started_at = 0;
   }
   void begin(DisplayDriver* display, SensorManager* sensors, NodePrefs* node_prefs);
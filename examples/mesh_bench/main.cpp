@@ -0,0 +1,195 @@
+#include <Arduino.h>   // needed for PlatformIO
+#include <Mesh.h>
+#include <helpers/ArduinoHelpers.h>
+#include <helpers/SimpleMeshTables.h>
+#include <helpers/StaticPoolPacketManager.h>
+#include <helpers/RegionMap.h>
+
+/*
+ * Micro-benchmarks of the per-packet hot paths. Prints one CSV line per benchmark:
+ *
+ *   name,param,iterations,ns_per_call,cycles_per_call
+ *
+ * 'param' is the payload size, or table fill, used. cycles_per_call is from the nominal CPU clock, so is
+ * zero on the host (native_bench). Save the output under bench/results/<release>/<env>.csv to compare releases.
+*/
+
+#ifndef BENCH_MIN_MILLIS
+  #define BENCH_MIN_MILLIS   250    // run each benchmark for at least this long
+#endif
+#define BENCH_MSG_LEN       100     // typical text message payload
+#define BENCH_QUEUE_FILL     16
+#define BENCH_NUM_REGIONS    16
+
+#if defined(NATIVE_PLATFORM)
+  #include <time.h>
+
+  static uint64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+  static uint32_t getCpuMHz() { return 0; }   // (not fixed)
+#else
+  static uint64_t nowNanos() { return (uint64_t)micros() * 1000; }
+  #if defined(ESP32)
+    static uint32_t getCpuMHz() { return getCpuFrequencyMhz(); }
+  #else
+    static uint32_t getCpuMHz() { return F_CPU / 1000000; }
+  #endif
+#endif
+
+static volatile uint32_t sink;   // so results aren't optimised away
+
+static StdRNG rng;
+static mesh::LocalIdentity self_id, other_id;
+static uint8_t secret[PUB_KEY_SIZE];
+static uint8_t plain[BENCH_MSG_LEN], cipher[BENCH_MSG_LEN + CIPHER_BLOCK_SIZE + CIPHER_MAC_SIZE];
+static int cipher_len;
+static uint8_t signature[SIGNATURE_SIZE];
+static mesh::Packet pkt, seen_pkt;
+static SimpleMeshTables* tables;
+static PacketQueue* queue;
+static mesh::Packet queue_pkts[BENCH_QUEUE_FILL];
+static TransportKeyStore key_store;
+static RegionMap* regions;
+static mesh::Packet region_pkt;
+
+static void initPacket(mesh::Packet& p, uint8_t type, uint32_t seq) {
+  p.header = ROUTE_TYPE_FLOOD | (type << PH_TYPE_SHIFT);
+  p.path_len = 0;
+  p.payload_len = BENCH_MSG_LEN;
+  memcpy(p.payload, plain, BENCH_MSG_LEN);
+  memcpy(p.payload, &seq, 4);   // make each one unique
+}
+
+typedef void (*BenchFn)(uint32_t i);
+
+static void runBench(const char* name, int param, BenchFn fn) {
+  uint32_t iters = 1;
+  uint64_t elapsed;
+  for (;;) {
+    uint64_t start = nowNanos();
+    for (uint32_t i = 0; i < iters; i++) fn(i);
+    elapsed = nowNanos() - start;
+    if (elapsed >= (uint64_t)BENCH_MIN_MILLIS * 1000000 || iters >= (1UL << 24)) break;
+    iters *= 2;
+  }
+  uint32_t ns = (uint32_t) (elapsed / iters);
+  Serial.printf("%s,%d,%lu,%lu,%lu\n", name, param, (unsigned long) iters, (unsigned long) ns,
+                (unsigned long) ((uint64_t)ns * getCpuMHz() / 1000));
+}
+
+static void benchPacketHash(uint32_t i) {
+  uint8_t hash[MAX_HASH_SIZE];
+  pkt.calculatePacketHash(hash);
+  sink += hash[0];
+}
+
+static void benchHasSeenHit(uint32_t i) {   // a repeat, of a packet in a full table
+  sink += tables->hasSeen(&seen_pkt);
+}
+
+static void benchHasSeenMiss(uint32_t i) {   // a new packet (evicts the oldest)
+  memcpy(&pkt.payload[4], &i, 4);
+  sink += tables->hasSeen(&pkt);
+}
+
+static void benchEncryptThenMAC(uint32_t i) {
+  sink += mesh::Utils::encryptThenMAC(secret, cipher, plain, BENCH_MSG_LEN);
+}
+
+static void benchMACThenDecrypt(uint32_t i) {
+  uint8_t dest[sizeof(cipher)];
+  sink += mesh::Utils::MACThenDecrypt(secret, dest, cipher, cipher_len);
+}
+
+static void benchVerify(uint32_t i) {
+  sink += other_id.verify(signature, plain, BENCH_MSG_LEN);
+}
+
+static void benchSharedSecret(uint32_t i) {
+  uint8_t dest[PUB_KEY_SIZE];
+  self_id.calcSharedSecret(dest, other_id);
+  sink += dest[0];
+}
+
+static void benchQueueGet(uint32_t i) {
+  uint8_t pri;
+  uint32_t scheduled_for;
+  mesh::Packet* p = queue->get(1000, &scheduled_for, &pri);   // (all are due)
+  queue->add(p, pri, scheduled_for);   // put back, keeping the fill constant
+}
+
+static void benchRegionMatch(uint32_t i) {   // no match cache hit (new packet each time), so is the worst case
+  memcpy(&region_pkt.payload[4], &i, 4);
+  sink += regions->findMatch(&region_pkt, REGION_DENY_FLOOD) != NULL;
+}
+
+static void benchRegionMatchCached(uint32_t i) {   // more copies of same flood packet
+  sink += regions->findMatch(&region_pkt, REGION_DENY_FLOOD) != NULL;
+}
+
+void setup() {
+  Serial.begin(115200);
+#if !defined(NATIVE_PLATFORM)
+  delay(2000);   // give USB serial a chance
+#endif
+
+  rng.begin(12345);
+  self_id = mesh::LocalIdentity(&rng);
+  other_id = mesh::LocalIdentity(&rng);
+  self_id.calcSharedSecret(secret, other_id);
+  rng.random(plain, sizeof(plain));
+  cipher_len = mesh::Utils::encryptThenMAC(secret, cipher, plain, BENCH_MSG_LEN);
+  other_id.sign(signature, plain, BENCH_MSG_LEN);
+
+  initPacket(pkt, PAYLOAD_TYPE_TXT_MSG, 0);
+
+  tables = new SimpleMeshTables();
+  for (uint32_t i = 0; i < MAX_PACKET_HASHES; i++) {   // fill
+    initPacket(seen_pkt, PAYLOAD_TYPE_TXT_MSG, 0x80000000 | i);
+    tables->hasSeen(&seen_pkt);
+  }
+
+  queue = new PacketQueue(BENCH_QUEUE_FILL);
+  for (int i = 0; i < BENCH_QUEUE_FILL; i++) {
+    queue->add(&queue_pkts[i], i % 4, i * 10);
+  }
+
+  regions = new RegionMap(key_store);
+  char name[16];
+  for (int i = 0; i < BENCH_NUM_REGIONS; i++) {
+    sprintf(name, "#region%d", i);
+    regions->putRegion(name, 0);
+  }
+  initPacket(region_pkt, PAYLOAD_TYPE_TXT_MSG, 0);
+  region_pkt.header = ROUTE_TYPE_TRANSPORT_FLOOD | (PAYLOAD_TYPE_TXT_MSG << PH_TYPE_SHIFT);
+  region_pkt.transport_codes[0] = 1;   // (matches none, so all regions are tried)
+  region_pkt.transport_codes[1] = 0;
+
+  Serial.printf("# cpu_mhz=%lu\n", (unsigned long) getCpuMHz());
+  Serial.println("name,param,iterations,ns_per_call,cycles_per_call");
+  runBench("packet_hash", BENCH_MSG_LEN, benchPacketHash);
+  runBench("tables_has_seen_hit", MAX_PACKET_HASHES, benchHasSeenHit);
+  runBench("tables_has_seen_miss", MAX_PACKET_HASHES, benchHasSeenMiss);
+  runBench("encrypt_then_mac", BENCH_MSG_LEN, benchEncryptThenMAC);
+  runBench("mac_then_decrypt", BENCH_MSG_LEN, benchMACThenDecrypt);
+  runBench("identity_verify", BENCH_MSG_LEN, benchVerify);
+  runBench("calc_shared_secret", 0, benchSharedSecret);
+  runBench("packet_queue_get", BENCH_QUEUE_FILL, benchQueueGet);
+  runBench("region_find_match", BENCH_NUM_REGIONS, benchRegionMatch);
+  runBench("region_find_match_cached", BENCH_NUM_REGIONS, benchRegionMatchCached);
+  Serial.println("# done");
+}
+
+void loop() {
+  delay(1000);
+}
+
+#if defined(NATIVE_PLATFORM)
+int main() {
+  setup();
+  return 0;
+}
+#endif
@@ -0,0 +1,141 @@
+#include <Arduino.h>
+#include <Mesh.h>
+#include <time.h>
+#include <unistd.h>
+#include <helpers/StaticPoolPacketManager.h>
+#include <helpers/SimpleMeshTables.h>
+#include <helpers/native/ReplayRadio.h>
+
+/*
+ * Replays a capture of real RF traffic into a repeater, for regression benchmarking against what a mesh actually
+ * carries (rather than a synthetic scenario, as native_sim).
+ *
+ *   usage:  native_replay -f capture.pcap [-x speed] [-w tx.pcap] [-r seed] [-o report.json] [-v]
+ *
+ * The capture is a pcap file with the LoRaTap link-type, eg. from 'capture stream' on a repeater's serial console
+ * (see docs/faq.md). Frames are received at their original times, relative to the first, with their SNR/RSSI.
+ * Frames which were on air while the repeater was transmitting are dropped.
+ *
+ *   -x speed   0 (default) runs as fast as possible, otherwise 1 = real time, 10 = ten times faster, etc.
+ *   -w file    writes what the repeater sent, as another pcap file (eg. to diff the forwarding of two builds)
+*/
+
+#define MAX_STALLED_ROUNDS   8    // loop()s at the same time, before forcing the clock on a millisecond
+
+class ReplayNode : public mesh::Mesh {
+  uint32_t _n_adverts;
+
+protected:
+  bool allowPacketForward(const mesh::Packet* packet) override { return true; }
+  void onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp, const uint8_t* app_data, size_t app_data_len) override {
+    _n_adverts++;
+  }
+
+public:
+  ReplayNode(ReplayRadio& radio, SimClock& ms, mesh::RNG& rng, mesh::RTCClock& rtc, SimpleMeshTables& tables)
+      : mesh::Mesh(radio, ms, rng, rtc, *new StaticPoolPacketManager(32), tables) {
+    _n_adverts = 0;
+    self_id = mesh::LocalIdentity(&rng);
+  }
+
+  uint32_t getNumAdverts() const { return _n_adverts; }
+  const DedupStats& getDedupStats() const { return ((SimpleMeshTables *) getTables())->getDedupStats(); }
+};
+
+int main(int argc, char* argv[]) {
+  const char* capture = NULL;
+  const char* tx_capture = NULL;
+  const char* report = NULL;
+  float speed = 0;
+  uint64_t seed = 1;
+  bool verbose = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:x:w:r:o:v")) != -1) {
+    switch (opt) {
+      case 'f': capture = optarg; break;
+      case 'x': speed = atof(optarg); break;
+      case 'w': tx_capture = optarg; break;
+      case 'r': seed = strtoull(optarg, NULL, 10); break;
+      case 'o': report = optarg; break;
+      case 'v': verbose = true; break;
+      default:
+        capture = NULL;
+        break;
+    }
+  }
+  if (capture == NULL) {
+    printf("usage: %s -f capture.pcap [-x speed] [-w tx.pcap] [-r seed] [-o report.json] [-v]\n", argv[0]);
+    return 1;
+  }
+
+  static SimClock ms;
+  static ReplayRadio radio(ms);
+  if (!radio.open(capture)) {
+    printf("can't read (or not a LoRaTap pcap file): %s\n", capture);
+    return 1;
+  }
+  if (tx_capture && !radio.openTxCapture(tx_capture)) {
+    printf("can't write: %s\n", tx_capture);
+    return 1;
+  }
+  static SimRNG rng(seed);
+  static SimRTCClock rtc(ms, radio.getStartTime());
+  static ReplayNode node(radio, ms, rng, rtc, *new SimpleMeshTables());
+  node.begin();
+
+  clock_t started = clock();
+  uint32_t num_events = 0;
+  int stalled = 0;
+  while (!radio.isDone() || !node.isIdle()) {
+    unsigned long now = ms.getMillis();
+    node.loop();
+    num_events++;
+
+    uint32_t wait = node.getMillisToNextWakeup(60000);
+    unsigned long t;
+    if (radio.getNextEventTime(&t)) mesh::Dispatcher::limitWakeup(wait, now, t);
+    if (wait == 0 && ++stalled >= MAX_STALLED_ROUNDS) {
+      wait = 1;
+    }
+    if (wait > 0) {
+      stalled = 0;
+      if (speed > 0) usleep((useconds_t) (wait * 1000 / speed));
+      ms.set(now + wait);
+    }
+    if (verbose && num_events % 10000 == 0) {
+      printf("%lu ms: %u frames replayed\n", ms.getMillis(), radio.getNumReplayed());
+    }
+  }
+  float cpu_secs = (float)(clock() - started) / CLOCKS_PER_SEC;
+
+  uint32_t num_dups = 0;
+  const DedupStats& dedup = node.getDedupStats();
+  for (int t = 0; t < 16; t++) num_dups += dedup.dups_by_type[t];
+
+  printf("capture: %s (SF%d, BW%.1f), duration: %.1fs, events: %u, cpu: %.3fs\n", capture, radio.getSF(),
+    radio.getBW(), ms.getMillis() / 1000.0f, num_events, cpu_secs);
+  printf("frames: replayed=%u, dropped=%u (transmitting), skipped=%u\n", radio.getNumReplayed(), radio.getNumDropped(),
+    radio.getNumSkipped());
+  printf("recv flood/direct: %u/%u, sent flood/direct: %u/%u, adverts: %u, dups: %u, air time: %lu ms\n",
+    node.getNumRecvFlood(), node.getNumRecvDirect(), node.getNumSentFlood(), node.getNumSentDirect(),
+    node.getNumAdverts(), num_dups, node.getTotalAirTime());
+
+  if (report) {
+    FILE* f = fopen(report, "w");
+    if (f == NULL) {
+      printf("can't write: %s\n", report);
+      return 1;
+    }
+    fprintf(f, "{\n  \"capture\": \"%s\",\n  \"seed\": %llu,\n  \"duration_ms\": %lu,\n", capture,
+      (unsigned long long) seed, ms.getMillis());
+    fprintf(f, "  \"replayed\": %u,\n  \"dropped\": %u,\n  \"skipped\": %u,\n", radio.getNumReplayed(),
+      radio.getNumDropped(), radio.getNumSkipped());
+    fprintf(f, "  \"recv_flood\": %u,\n  \"recv_direct\": %u,\n  \"sent_flood\": %u,\n  \"sent_direct\": %u,\n",
+      node.getNumRecvFlood(), node.getNumRecvDirect(), node.getNumSentFlood(), node.getNumSentDirect());
+    fprintf(f, "  \"dups\": %u,\n  \"air_ms_total\": %lu,\n  \"cpu_secs\": %.3f\n}\n", num_dups, node.getTotalAirTime(),
+      cpu_secs);
+    fclose(f);
+  }
+  return 0;
+}
@@ -0,0 +1,264 @@
+#include "SimNode.h"
+#include <stdlib.h>
+
+static const uint8_t channel_psk[16] = {   // (same for every node, like the 'Public' channel)
+  0x8b, 0x33, 0x87, 0xe9, 0xc5, 0xcd, 0xea, 0x6a, 0xc9, 0xe5, 0xed, 0xba, 0xa1, 0x15, 0xcd, 0x72
+};
+
+// tracked messages are: timestamp(4), msg_id(4), text
+#define MSG_ID_OFFSET   4
+#define MSG_HDR_LEN     8
+
+int SimStats::newMsg(unsigned long now, int expected) {
+  if (num_msgs >= SIM_MAX_MSGS) return -1;
+
+  if (num_msgs == 0) first_sent = now;
+  Msg& m = msgs[num_msgs];
+  m.sent_at = now;
+  m.expected = expected;
+  m.num_recv = 0;
+  num_expected += expected;
+  return num_msgs++;
+}
+
+void SimStats::recordDelivery(uint32_t id, unsigned long now) {
+  if (id >= num_msgs) return;
+
+  msgs[id].num_recv++;
+  if (num_deliveries < SIM_MAX_DELIVERIES) latencies[num_deliveries] = now - msgs[id].sent_at;
+  num_deliveries++;
+  last_delivered = now;
+}
+
+static int cmpLatency(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+uint32_t SimStats::getLatencyPercentile(int pct) {
+  uint32_t n = num_deliveries < SIM_MAX_DELIVERIES ? num_deliveries : SIM_MAX_DELIVERIES;
+  if (n == 0) return 0;
+
+  qsort(latencies, n, sizeof(latencies[0]), cmpLatency);
+  return latencies[(n - 1) * pct / 100];
+}
+
+SimNode::SimNode(const char* node_name, uint8_t node_role, SimRadio& radio, SimClock& ms, mesh::RNG& rng, mesh::RTCClock& rtc,
+                 SimpleMeshTables& tables, SimStats& stats)
+    : mesh::Mesh(radio, ms, rng, rtc, *new StaticPoolPacketManager(32), tables), _radio(&radio), _stats(&stats)
+{
+  snprintf(name, sizeof(name), "%s", node_name);
+  role = node_role;
+  num_adverts = 0;
+  _peers = NULL;
+  _num_peers = 0;
+  _out_paths = NULL;
+  _out_path_lens = NULL;
+  _msg_interval = 0;
+  _chatter_expected = 0;
+  _next_msg = 0;
+  _dm_dest = NULL;
+  _dm_left = 0;
+  _dm_interval = 0;
+  _next_dm = 0;
+  _n_delivered = _n_originated = 0;
+  _retransmit_pct = 100;
+  _push_head = _num_pushes = 0;
+  _next_push = 0;
+  self_id = mesh::LocalIdentity(&rng);
+
+  memset(_channel.secret, 0, sizeof(_channel.secret));
+  memcpy(_channel.secret, channel_psk, sizeof(channel_psk));
+  mesh::Utils::sha256(_channel.hash, sizeof(_channel.hash), channel_psk, sizeof(channel_psk));
+}
+
+void SimNode::setPeers(SimNode** peers, int num) {
+  _peers = peers;
+  _num_peers = num;
+  _out_paths = new uint8_t[num * MAX_PATH_SIZE];
+  _out_path_lens = new int16_t[num];
+  for (int i = 0; i < num; i++) _out_path_lens[i] = -1;
+}
+
+void SimNode::sendTrackedAdvert(uint32_t delay_millis, int expected) {
+  int id = _stats->newMsg(_ms->getMillis() + delay_millis, expected);
+  uint32_t msg_id = id;
+  mesh::Packet* adv = id >= 0 ? createAdvert(self_id, (const uint8_t *) &msg_id, sizeof(msg_id)) : createAdvert(self_id);
+  if (adv) {
+    sendFlood(adv, delay_millis);
+    _n_originated++;
+  }
+}
+
+void SimNode::startChatter(uint32_t interval_millis, int expected) {
+  if (interval_millis == 0) return;
+
+  _msg_interval = interval_millis;
+  _chatter_expected = expected;
+  _next_msg = futureMillis(getRNG()->nextInt(0, interval_millis));
+}
+
+void SimNode::startDMs(SimNode* dest, int count, uint32_t interval_millis, uint32_t delay_millis) {
+  _dm_dest = dest;
+  _dm_left = count;
+  _dm_interval = interval_millis;
+  _next_dm = futureMillis(delay_millis);
+}
+
+bool SimNode::sendTrackedDM(SimNode* dest, uint32_t msg_id) {
+  uint8_t data[40];
+  uint32_t timestamp = getRTCClock()->getCurrentTimeUnique();
+  memcpy(data, &timestamp, 4);
+  memcpy(&data[MSG_ID_OFFSET], &msg_id, 4);
+  int len = MSG_HDR_LEN + sprintf((char *) &data[MSG_HDR_LEN], "%s: dm %u", name, msg_id);
+
+  uint8_t secret[PUB_KEY_SIZE];
+  calcSharedSecret(secret, dest->self_id.pub_key);
+  mesh::Packet* pkt = createDatagram(PAYLOAD_TYPE_TXT_MSG, dest->self_id, secret, data, len);
+  if (pkt == NULL) return false;
+
+  _n_originated++;
+  int i = 0;
+  while (i < _num_peers && _peers[i] != dest) i++;
+  if (i < _num_peers && _out_path_lens[i] >= 0) {
+    sendDirect(pkt, &_out_paths[i * MAX_PATH_SIZE], _out_path_lens[i]);
+    return true;
+  }
+  sendFlood(pkt);
+  return false;
+}
+
+bool SimNode::allowPacketForward(const mesh::Packet* packet) {
+  return role == SIM_ROLE_REPEATER;
+}
+
+uint32_t SimNode::getRetransmitDelay(const mesh::Packet* packet) {
+  return mesh::Mesh::getRetransmitDelay(packet) * _retransmit_pct / 100;
+}
+
+int SimNode::searchChannelsByHash(const uint8_t* hash, mesh::GroupChannel channels[], int max_matches) {
+  if (max_matches < 1 || memcmp(hash, _channel.hash, PATH_HASH_SIZE) != 0) return 0;
+  channels[0] = _channel;
+  return 1;
+}
+
+int SimNode::searchPeersByHash(const uint8_t* hash) {
+  int n = 0;
+  for (int i = 0; i < _num_peers && n < 4; i++) {
+    if (_peers[i] != this && _peers[i]->self_id.isHashMatch(hash)) _matches[n++] = i;
+  }
+  return n;
+}
+
+void SimNode::getPeerSharedSecret(uint8_t* dest_secret, int peer_idx) {
+  calcSharedSecret(dest_secret, _peers[_matches[peer_idx]]->self_id.pub_key);
+}
+
+void SimNode::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender_idx, const uint8_t* secret, uint8_t* data, size_t len) {
+  uint32_t id;
+  if (role == SIM_ROLE_REPEATER || type != PAYLOAD_TYPE_TXT_MSG || len < MSG_HDR_LEN) return;
+
+  if (packet->isRouteFlood()) {   // let sender know the path to here (no ACK, though)
+    mesh::Packet* path = createPathReturn(_peers[_matches[sender_idx]]->self_id, secret, packet->path, packet->getEncodedPathLen(), 0, NULL, 0);
+    if (path) sendFlood(path);
+  }
+
+  memcpy(&id, &data[MSG_ID_OFFSET], 4);
+  if (role == SIM_ROLE_ROOM) {   // a new post, queue to push on to all the others
+    if (_num_pushes < SIM_MAX_ROOM_PUSHES) {
+      RoomPush& p = _pushes[(_push_head + _num_pushes++) % SIM_MAX_ROOM_PUSHES];
+      p.msg_id = id;
+      p.author = _peers[_matches[sender_idx]];
+      p.next_peer = 0;
+    }
+  } else {
+    _stats->recordDelivery(id, _ms->getMillis());
+    _n_delivered++;
+  }
+}
+
+bool SimNode::onPeerPathRecv(mesh::Packet* packet, int sender_idx, const uint8_t* secret, uint8_t* path, uint8_t path_len, uint8_t extra_type, uint8_t* extra, uint8_t extra_len) {
+  int i = _matches[sender_idx];
+  memcpy(&_out_paths[i * MAX_PATH_SIZE], path, mesh::Packet::decodePathBytes(path_len));
+  _out_path_lens[i] = path_len;
+  return false;
+}
+
+void SimNode::onGroupDataRecv(mesh::Packet* packet, uint8_t type, const mesh::GroupChannel& channel, uint8_t* data, size_t len) {
+  uint32_t id;
+  if (role == SIM_ROLE_REPEATER || type != PAYLOAD_TYPE_GRP_TXT || len < MSG_HDR_LEN) return;   // (only endpoints count)
+
+  memcpy(&id, &data[MSG_ID_OFFSET], 4);
+  _stats->recordDelivery(id, _ms->getMillis());
+  _n_delivered++;
+}
+
+void SimNode::onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp, const uint8_t* app_data, size_t app_data_len) {
+  num_adverts++;
+  if (app_data_len == 4) {   // a tracked advert
+    uint32_t msg_id;
+    memcpy(&msg_id, app_data, 4);
+    _stats->recordDelivery(msg_id, _ms->getMillis());
+    _n_delivered++;
+  }
+}
+
+void SimNode::checkRoomPushes() {
+  if (_num_pushes == 0 || !millisHasNowPassed(_next_push)) return;
+
+  RoomPush& p = _pushes[_push_head];
+  while (p.next_peer < _num_peers) {
+    SimNode* dest = _peers[p.next_peer++];
+    if (dest != this && dest != p.author && dest->role == SIM_ROLE_COMPANION) {
+      _stats->addExpected(p.msg_id);
+      bool direct = sendTrackedDM(dest, p.msg_id);
+      _next_push = futureMillis(direct ? SIM_ROOM_PUSH_MILLIS : SIM_ROOM_PUSH_FLOOD_MILLIS);
+      break;
+    }
+  }
+  if (p.next_peer >= _num_peers) {   // post now sent to all
+    _push_head = (_push_head + 1) % SIM_MAX_ROOM_PUSHES;
+    _num_pushes--;
+  }
+}
+
+void SimNode::loop() {
+  mesh::Mesh::loop();
+
+  if (_msg_interval > 0 && millisHasNowPassed(_next_msg)) {
+    _next_msg = futureMillis(getRNG()->nextInt(_msg_interval / 2, _msg_interval * 3 / 2));
+
+    int id = _stats->newMsg(_ms->getMillis(), _chatter_expected);
+    if (id >= 0) {
+      uint8_t data[40];
+      uint32_t timestamp = getRTCClock()->getCurrentTimeUnique();
+      uint32_t msg_id = id;
+      memcpy(data, &timestamp, 4);
+      memcpy(&data[MSG_ID_OFFSET], &msg_id, 4);
+      int len = MSG_HDR_LEN + sprintf((char *) &data[MSG_HDR_LEN], "%s: msg %u", name, msg_id);
+      mesh::Packet* pkt = createGroupDatagram(PAYLOAD_TYPE_GRP_TXT, _channel, data, len);
+      if (pkt) {
+        sendFlood(pkt);
+        _n_originated++;
+      }
+    }
+  }
+  if (_dm_left > 0 && millisHasNowPassed(_next_dm)) {
+    _dm_left--;
+    _next_dm = futureMillis(_dm_interval);
+
+    // a post to a room is only counted when the room pushes it on to each client
+    int id = _stats->newMsg(_ms->getMillis(), _dm_dest->role == SIM_ROLE_ROOM ? 0 : 1);
+    if (id >= 0) sendTrackedDM(_dm_dest, id);
+  }
+  if (role == SIM_ROLE_ROOM) checkRoomPushes();
+}
+
+uint32_t SimNode::getMillisToNextWakeup(uint32_t max_millis) {
+  uint32_t wait = mesh::Mesh::getMillisToNextWakeup(max_millis);
+  unsigned long now = _ms->getMillis();
+  if (_msg_interval > 0) limitWakeup(wait, now, _next_msg);
+  if (_dm_left > 0) limitWakeup(wait, now, _next_dm);
+  if (_num_pushes > 0) limitWakeup(wait, now, _next_push);
+  return wait;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <Mesh.h>
+#include <helpers/StaticPoolPacketManager.h>
+#include <helpers/SimpleMeshTables.h>
+#include <helpers/native/SimRadio.h>
+
+#define SIM_ROLE_REPEATER    0    // forwards floods
+#define SIM_ROLE_COMPANION   1    // endpoint
+#define SIM_ROLE_ROOM        2    // endpoint, pushes each post it receives on to all the other companions
+
+#ifndef SIM_MAX_MSGS
+  #define SIM_MAX_MSGS        8192
+#endif
+#ifndef SIM_MAX_DELIVERIES
+  #define SIM_MAX_DELIVERIES  (1 << 20)   // (for the latency percentiles)
+#endif
+#define SIM_MAX_ROOM_PUSHES    1024
+#define SIM_ROOM_PUSH_MILLIS        1200    // room server sends one post to one client, per this (as SYNC_PUSH_INTERVAL)
+#define SIM_ROOM_PUSH_FLOOD_MILLIS 12000    //  .. or this, if it had to be flooded (as PUSH_ACK_TIMEOUT_FLOOD)
+
+/**
+ * \brief  delivery tracking, across all nodes, of the tracked messages (adverts, channel messages, DMs) sent
+*/
+struct SimStats {
+  struct Msg {
+    unsigned long sent_at;
+    uint16_t expected;   // number of nodes it should reach
+    uint16_t num_recv;
+  };
+  Msg msgs[SIM_MAX_MSGS];
+  uint32_t num_msgs;
+  uint32_t num_expected;
+  uint32_t* latencies;   // millis, for each delivery
+  uint32_t num_deliveries;
+  unsigned long first_sent, last_delivered;
+
+  SimStats() {
+    memset(this, 0, sizeof(*this));
+    latencies = new uint32_t[SIM_MAX_DELIVERIES];
+  }
+
+  /** \returns  id of new message, or -1 if SIM_MAX_MSGS reached */
+  int newMsg(unsigned long now, int expected);
+  void addExpected(uint32_t id) { if (id < num_msgs) { msgs[id].expected++; num_expected++; } }
+  void recordDelivery(uint32_t id, unsigned long now);
+  uint32_t getLatencyPercentile(int pct);   // NOTE: sorts latencies[]
+};
+
+class SimNode : public mesh::Mesh {
+  SimRadio* _radio;
+  SimStats* _stats;
+  SimNode** _peers;
+  int _num_peers;
+  int _matches[4];   // from searchPeersByHash(), indexes into _peers
+  uint8_t* _out_paths;     // per peer, learnt from path returns, for sendDirect()
+  int16_t* _out_path_lens;   // -1 = unknown, so flood
+  mesh::GroupChannel _channel;
+  uint32_t _msg_interval;
+  int _chatter_expected;
+  unsigned long _next_msg;
+  SimNode* _dm_dest;
+  int _dm_left;
+  uint32_t _dm_interval;
+  unsigned long _next_dm;
+  uint32_t _n_delivered;
+  uint32_t _n_originated;
+  uint32_t _retransmit_pct;
+
+  struct RoomPush {
+    uint32_t msg_id;
+    SimNode* author;
+    int next_peer;
+  };
+  RoomPush _pushes[SIM_MAX_ROOM_PUSHES];
+  int _push_head, _num_pushes;
+  unsigned long _next_push;
+
+  bool sendTrackedDM(SimNode* dest, uint32_t msg_id);   // returns true if sent direct
+  void checkRoomPushes();
+
+protected:
+  bool allowPacketForward(const mesh::Packet* packet) override;
+  uint32_t getRetransmitDelay(const mesh::Packet* packet) override;
+  int searchChannelsByHash(const uint8_t* hash, mesh::GroupChannel channels[], int max_matches) override;
+  int searchPeersByHash(const uint8_t* hash) override;
+  void getPeerSharedSecret(uint8_t* dest_secret, int peer_idx) override;
+  void onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender_idx, const uint8_t* secret, uint8_t* data, size_t len) override;
+  bool onPeerPathRecv(mesh::Packet* packet, int sender_idx, const uint8_t* secret, uint8_t* path, uint8_t path_len, uint8_t extra_type, uint8_t* extra, uint8_t extra_len) override;
+  void onGroupDataRecv(mesh::Packet* packet, uint8_t type, const mesh::GroupChannel& channel, uint8_t* data, size_t len) override;
+  void onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp, const uint8_t* app_data, size_t app_data_len) override;
+
+public:
+  char name[16];
+  uint8_t role;
+  int num_adverts;
+
+  SimNode(const char* node_name, uint8_t node_role, SimRadio& radio, SimClock& ms, mesh::RNG& rng, mesh::RTCClock& rtc,
+          SimpleMeshTables& tables, SimStats& stats);
+
+  SimRadio* getRadio() const { return _radio; }
+  uint32_t getNumDelivered() const { return _n_delivered; }
+  uint32_t getNumOriginated() const { return _n_originated; }   // packets sent by this node's app (ie. not forwards)
+  const DedupStats& getDedupStats() const { return ((SimpleMeshTables *) getTables())->getDedupStats(); }
+
+  /** \brief  all the nodes (incl. this one), as contacts for DMs */
+  void setPeers(SimNode** peers, int num);
+
+  /** \brief  scales repeaters' flood retransmit delay, eg. to compare variants. 100 = unchanged */
+  void setRetransmitPercent(uint32_t pct) { _retransmit_pct = pct; }
+
+  /** \brief  floods an advert, tracked as reaching all 'expected' other nodes */
+  void sendTrackedAdvert(uint32_t delay_millis, int expected);
+
+  /** \brief  sends channel messages every 'interval_millis' (+/- 50% jitter), tracked as reaching 'expected' nodes */
+  void startChatter(uint32_t interval_millis, int expected);
+
+  /** \brief  sends 'count' DMs (flood routed, until a path is returned) to 'dest', every 'interval_millis', starting after 'delay_millis' */
+  void startDMs(SimNode* dest, int count, uint32_t interval_millis, uint32_t delay_millis);
+
+  void loop();
+
+  /** \returns  millis until loop() next has work to do (incl. the next message to send) */
+  uint32_t getMillisToNextWakeup(uint32_t max_millis) override;
+};
@@ -0,0 +1,382 @@
+#include <Arduino.h>
+#include <Mesh.h>
+#include <time.h>
+#include <unistd.h>
+#include "SimNode.h"
+
+/*
+ * Discrete-event simulation of a mesh: the clock jumps straight to the next event (a radio IRQ, a queued packet
+ * due, a node's timer), so hundreds of nodes can be run for hours of simulated time.
+ *
+ *   usage:  native_sim [-S scenario] [-t topology_file] [-n num_nodes] [-s sim_seconds] [-m msg_interval_secs]
+ *                      [-d retransmit_delay_pct] [-r seed] [-o report.json] [-v]
+ *
+ * Scenarios:
+ *   chatter        (default) every companion sends channel messages, every 'msg_interval_secs' (+/- 50%)
+ *   advert_storm   every node floods an advert, all within the first 10 seconds
+ *   room_sync      each companion posts once to the room server, which pushes each post on to all the others
+ *                  (default topology: a room and 30 companions, behind 3 repeaters)
+ *   dm_burst       100 DMs, from the other companions, to the last companion
+ *
+ * Topology file, one per line ('#' starts a comment):
+ *   node <name> <repeater|companion|room>
+ *   link <name> <name> <snr_db> [<snr_db_back>]      (else the same both ways)
+ *
+ * Without a topology file, a chain of 'num_nodes' repeaters is used, with a companion hanging off every
+ * fourth one.
+ *
+ * The report (stdout, and with -o as JSON) has: delivered messages/sec, p50/p99 latency, air time per delivered
+ * message, and forwards and duplicates per message, so variants (eg. -d, or a build with different tables) can be
+ * compared on the same scenario and seed.
+*/
+
+#define MAX_STALLED_ROUNDS   8    // loop()s at the same time, before forcing the clock on a millisecond
+
+#define SCENARIO_CHATTER        0
+#define SCENARIO_ADVERT_STORM   1
+#define SCENARIO_ROOM_SYNC      2
+#define SCENARIO_DM_BURST       3
+
+static const char* scenario_names[] = { "chatter", "advert_storm", "room_sync", "dm_burst" };
+
+#define ROOM_SYNC_CLIENTS      30
+#define ROOM_SYNC_REPEATERS     3
+#define ROOM_SYNC_POST_MILLIS  300000    // clients each post once, within this
+#define DM_BURST_COUNT        100
+#define DM_BURST_INTERVAL    5000    // millis, between each sender's DMs
+#define ADVERT_STORM_MILLIS 10000    // all nodes advert within this
+
+struct Sim {
+  SimClock clock;
+  SimAir* air;
+  SimStats* stats;
+  SimNode* nodes[SIM_MAX_RADIOS];
+  int num_nodes;
+  uint64_t seed;
+
+  int findNode(const char* name) const {
+    for (int i = 0; i < num_nodes; i++) {
+      if (strcmp(nodes[i]->name, name) == 0) return i;
+    }
+    return -1;
+  }
+
+  int addNode(const char* name, uint8_t role) {
+    if (num_nodes >= SIM_MAX_RADIOS) return -1;
+
+    SimRadio* radio = new SimRadio(*air);
+    SimRNG* rng = new SimRNG(seed * 100003 + num_nodes);
+    nodes[num_nodes] = new SimNode(name, role, *radio, clock, *rng, *new SimRTCClock(clock), *new SimpleMeshTables(), *stats);
+    nodes[num_nodes]->begin();
+    return num_nodes++;
+  }
+};
+
+static bool parseRole(const char* s, uint8_t* role) {
+  if (strcmp(s, "repeater") == 0) {
+    *role = SIM_ROLE_REPEATER;
+  } else if (strcmp(s, "companion") == 0) {
+    *role = SIM_ROLE_COMPANION;
+  } else if (strcmp(s, "room") == 0) {
+    *role = SIM_ROLE_ROOM;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool loadTopology(Sim& sim, const char* filename) {
+  FILE* f = fopen(filename, "r");
+  if (f == NULL) {
+    printf("can't open: %s\n", filename);
+    return false;
+  }
+  char line[128];
+  int line_num = 0;
+  bool success = true;
+  while (success && fgets(line, sizeof(line), f)) {
+    line_num++;
+    char* hash = strchr(line, '#');
+    if (hash) *hash = 0;
+
+    char a[32], b[32], c[32];
+    int snr, snr_back;
+    uint8_t role;
+    int n = sscanf(line, "node %31s %31s", a, b);
+    if (n == 2) {
+      if (!parseRole(b, &role) || sim.findNode(a) >= 0 || sim.addNode(a, role) < 0) {
+        printf("%s:%d: bad or duplicate node (or too many)\n", filename, line_num);
+        success = false;
+      }
+      continue;
+    }
+    n = sscanf(line, "link %31s %31s %d %d", a, b, &snr, &snr_back);
+    if (n >= 3) {
+      int i = sim.findNode(a), j = sim.findNode(b);
+      if (i < 0 || j < 0) {
+        printf("%s:%d: unknown node\n", filename, line_num);
+        success = false;
+      } else {
+        sim.air->link(i, j, snr, n == 4 ? snr_back : snr);
+      }
+      continue;
+    }
+    if (sscanf(line, "%31s", c) == 1) {
+      printf("%s:%d: syntax error\n", filename, line_num);
+      success = false;
+    }
+  }
+  fclose(f);
+  return success;
+}
+
+static void makeChain(Sim& sim, int num_repeaters) {
+  char name[16];
+  int prev = -1;
+  for (int i = 0; i < num_repeaters && sim.num_nodes < SIM_MAX_RADIOS; i++) {
+    sprintf(name, "R%d", i);
+    int r = sim.addNode(name, SIM_ROLE_REPEATER);
+    if (prev >= 0) sim.air->link(prev, r, 5);
+    prev = r;
+
+    if (i % 4 == 0 && sim.num_nodes < SIM_MAX_RADIOS) {
+      sprintf(name, "C%d", i);
+      sim.air->link(r, sim.addNode(name, SIM_ROLE_COMPANION), 10);
+    }
+  }
+}
+
+static void makeRoomStar(Sim& sim) {
+  char name[16];
+  int room = sim.addNode("RS", SIM_ROLE_ROOM);
+  int reps[ROOM_SYNC_REPEATERS];
+  for (int i = 0; i < ROOM_SYNC_REPEATERS; i++) {
+    sprintf(name, "R%d", i);
+    reps[i] = sim.addNode(name, SIM_ROLE_REPEATER);
+    sim.air->link(room, reps[i], 6);
+    if (i > 0) sim.air->link(reps[i - 1], reps[i], 3);
+  }
+  int first = sim.num_nodes;
+  for (int i = 0; i < ROOM_SYNC_CLIENTS; i++) {
+    sprintf(name, "C%d", i);
+    int c = sim.addNode(name, SIM_ROLE_COMPANION);
+    sim.air->link(reps[i % ROOM_SYNC_REPEATERS], c, 8);
+    for (int j = first + i % ROOM_SYNC_REPEATERS; j < c; j += ROOM_SYNC_REPEATERS) {
+      sim.air->link(j, c, -5);   // clients of the same repeater hear each other, weakly
+    }
+  }
+}
+
+static int parseScenario(const char* s) {
+  for (int i = 0; i < (int)(sizeof(scenario_names) / sizeof(scenario_names[0])); i++) {
+    if (strcmp(s, scenario_names[i]) == 0) return i;
+  }
+  return -1;
+}
+
+static int findLastNode(Sim& sim, uint8_t role) {
+  for (int i = sim.num_nodes - 1; i >= 0; i--) {
+    if (sim.nodes[i]->role == role) return i;
+  }
+  return -1;
+}
+
+static bool startScenario(Sim& sim, int scenario, int msg_interval, int num_endpoints) {
+  switch (scenario) {
+    case SCENARIO_CHATTER:
+      for (int i = 0; i < sim.num_nodes; i++) {
+        if (sim.nodes[i]->role == SIM_ROLE_COMPANION) sim.nodes[i]->startChatter(msg_interval * 1000, num_endpoints - 1);
+      }
+      return true;
+
+    case SCENARIO_ADVERT_STORM:
+      for (int i = 0; i < sim.num_nodes; i++) {
+        sim.nodes[i]->sendTrackedAdvert(sim.nodes[i]->getRNG()->nextInt(0, ADVERT_STORM_MILLIS), sim.num_nodes - 1);
+      }
+      return true;
+
+    case SCENARIO_ROOM_SYNC: {
+      int room = findLastNode(sim, SIM_ROLE_ROOM);
+      if (room < 0) {
+        printf("room_sync: needs a room node\n");
+        return false;
+      }
+      for (int i = 0; i < sim.num_nodes; i++) {
+        if (sim.nodes[i]->role == SIM_ROLE_COMPANION) {
+          sim.nodes[i]->startDMs(sim.nodes[room], 1, 0, sim.nodes[i]->getRNG()->nextInt(0, ROOM_SYNC_POST_MILLIS));
+        }
+      }
+      return true;
+    }
+
+    case SCENARIO_DM_BURST: {
+      int dest = findLastNode(sim, SIM_ROLE_COMPANION);
+      int num_senders = num_endpoints - 1;
+      if (dest < 0 || num_senders < 1) {
+        printf("dm_burst: needs at least 2 companions\n");
+        return false;
+      }
+      int left = DM_BURST_COUNT;
+      for (int i = 0; i < sim.num_nodes && left > 0; i++) {
+        SimNode* n = sim.nodes[i];
+        if (i == dest || n->role == SIM_ROLE_REPEATER) continue;
+
+        int count = (left + num_senders - 1) / num_senders;   // (share out the remainder)
+        n->startDMs(sim.nodes[dest], count, DM_BURST_INTERVAL, n->getRNG()->nextInt(0, DM_BURST_INTERVAL));
+        left -= count;
+        num_senders--;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+int main(int argc, char* argv[]) {
+  const char* topology = NULL;
+  int num_nodes = 16;
+  int sim_secs = 0;
+  int msg_interval = 300;
+  int retransmit_pct = 100;
+  int scenario = SCENARIO_CHATTER;
+  const char* report = NULL;
+  bool verbose = false;
+
+  static Sim sim;
+  sim.seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "S:t:n:s:m:d:r:o:v")) != -1) {
+    switch (opt) {
+      case 'S':
+        scenario = parseScenario(optarg);
+        if (scenario < 0) {
+          printf("unknown scenario: %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 't': topology = optarg; break;
+      case 'n': num_nodes = atoi(optarg); break;
+      case 's': sim_secs = atoi(optarg); break;
+      case 'm': msg_interval = atoi(optarg); break;
+      case 'd': retransmit_pct = atoi(optarg); break;
+      case 'r': sim.seed = strtoull(optarg, NULL, 10); break;
+      case 'o': report = optarg; break;
+      case 'v': verbose = true; break;
+      default:
+        printf("usage: %s [-S chatter|advert_storm|room_sync|dm_burst] [-t topology_file] [-n num_nodes] [-s sim_seconds]\n"
+               "         [-m msg_interval_secs] [-d retransmit_delay_pct] [-r seed] [-o report.json] [-v]\n", argv[0]);
+        return 1;
+    }
+  }
+  sim.air = new SimAir(sim.clock);
+  sim.stats = new SimStats();
+  if (topology) {
+    if (!loadTopology(sim, topology)) return 1;
+  } else if (scenario == SCENARIO_ROOM_SYNC) {
+    makeRoomStar(sim);
+  } else {
+    makeChain(sim, num_nodes);
+  }
+  if (sim.num_nodes < 2) {
+    printf("need at least 2 nodes\n");
+    return 1;
+  }
+  if (sim_secs <= 0) {   // long enough for the scenario to play out
+    sim_secs = scenario == SCENARIO_ADVERT_STORM ? 120 : 3600;
+  }
+
+  uint32_t num_endpoints = 0;
+  for (int i = 0; i < sim.num_nodes; i++) {
+    sim.nodes[i]->setPeers(sim.nodes, sim.num_nodes);
+    sim.nodes[i]->setRetransmitPercent(retransmit_pct);
+    if (sim.nodes[i]->role != SIM_ROLE_REPEATER) num_endpoints++;
+  }
+  if (!startScenario(sim, scenario, msg_interval, num_endpoints)) return 1;
+
+  clock_t started = clock();
+  unsigned long end_millis = (unsigned long) sim_secs * 1000;
+  uint32_t num_events = 0;
+  int stalled = 0;
+  while (sim.clock.getMillis() < end_millis) {
+    unsigned long now = sim.clock.getMillis();
+    for (int i = 0; i < sim.num_nodes; i++) {
+      sim.nodes[i]->loop();
+    }
+    num_events++;
+
+    // jump to the earliest next event, of any node
+    uint32_t wait = end_millis - now;
+    for (int i = 0; i < sim.num_nodes && wait > 0; i++) {
+      wait = sim.nodes[i]->getMillisToNextWakeup(wait);
+
+      unsigned long t;
+      if (sim.nodes[i]->getRadio()->getNextEventTime(&t)) mesh::Dispatcher::limitWakeup(wait, now, t);
+    }
+    if (wait == 0 && ++stalled >= MAX_STALLED_ROUNDS) {
+      wait = 1;   // eg. a radio event pending which the node is not yet taking
+    }
+    if (wait > 0) {
+      stalled = 0;
+      sim.clock.set(now + wait);
+    }
+  }
+  float cpu_secs = (float)(clock() - started) / CLOCKS_PER_SEC;
+
+  uint64_t air_by_role[3] = { 0, 0, 0 }, air_total = 0;
+  uint32_t num_collisions = 0, num_sent = 0, num_originated = 0, num_recv = 0, num_dups = 0;
+  for (int i = 0; i < sim.num_nodes; i++) {
+    SimNode* n = sim.nodes[i];
+    air_by_role[n->role] += n->getTotalAirTime();
+    air_total += n->getTotalAirTime();
+    num_collisions += n->getRadio()->getNumCollisions();
+    num_sent += n->getNumSentFlood() + n->getNumSentDirect();
+    num_originated += n->getNumOriginated();
+    num_recv += n->getNumRecvFlood() + n->getNumRecvDirect();
+    const DedupStats& dedup = n->getDedupStats();
+    for (int t = 0; t < 16; t++) num_dups += dedup.dups_by_type[t];
+
+    if (verbose) {
+      printf("%-10s %-9s adverts=%d sent=%u/%u recv=%u/%u delivered=%u collisions=%u dropped=%u air_ms=%lu\n",
+        n->name, n->role == SIM_ROLE_REPEATER ? "repeater" : (n->role == SIM_ROLE_COMPANION ? "companion" : "room"),
+        n->num_adverts, n->getNumSentFlood(), n->getNumSentDirect(), n->getNumRecvFlood(), n->getNumRecvDirect(),
+        n->getNumDelivered(), n->getRadio()->getNumCollisions(), n->getRadio()->getNumDropped(), n->getTotalAirTime());
+    }
+  }
+  SimStats* st = sim.stats;
+  unsigned long span = st->last_delivered > st->first_sent ? st->last_delivered - st->first_sent : 0;
+  double delivery_ratio = st->num_expected ? (double) st->num_deliveries / st->num_expected : 0.0;
+  double msgs_per_sec = span ? st->num_deliveries * 1000.0 / span : 0.0;
+  uint32_t p50 = st->getLatencyPercentile(50), p99 = st->getLatencyPercentile(99);
+  double air_per_delivered = st->num_deliveries ? (double) air_total / st->num_deliveries : 0.0;
+  double forwards_per_msg = num_originated ? (double)(num_sent - num_originated) / num_originated : 0.0;
+  double dup_ratio = num_recv ? (double) num_dups / num_recv : 0.0;
+
+  printf("scenario: %s, nodes: %d (%u endpoints), sim time: %ds, events: %u, cpu: %.3fs\n", scenario_names[scenario],
+    sim.num_nodes, num_endpoints, sim_secs, num_events, cpu_secs);
+  printf("messages: %u, delivered: %u/%u (%.1f%%), %.3f msgs/sec, latency p50: %u ms, p99: %u ms\n", st->num_msgs,
+    st->num_deliveries, st->num_expected, 100.0 * delivery_ratio, msgs_per_sec, p50, p99);
+  printf("air time (ms): repeaters=%llu, companions=%llu, rooms=%llu, per delivered: %.1f, collisions: %u\n",
+    (unsigned long long) air_by_role[SIM_ROLE_REPEATER], (unsigned long long) air_by_role[SIM_ROLE_COMPANION],
+    (unsigned long long) air_by_role[SIM_ROLE_ROOM], air_per_delivered, num_collisions);
+  printf("forwards per message: %.2f, duplicate ratio: %.3f\n", forwards_per_msg, dup_ratio);
+
+  if (report) {
+    FILE* f = fopen(report, "w");
+    if (f == NULL) {
+      printf("can't write: %s\n", report);
+      return 1;
+    }
+    fprintf(f, "{\n  \"scenario\": \"%s\",\n  \"nodes\": %d,\n  \"seed\": %llu,\n  \"sim_secs\": %d,\n",
+      scenario_names[scenario], sim.num_nodes, (unsigned long long) sim.seed, sim_secs);
+    fprintf(f, "  \"msgs\": %u,\n  \"expected\": %u,\n  \"delivered\": %u,\n  \"delivery_ratio\": %.4f,\n",
+      st->num_msgs, st->num_expected, st->num_deliveries, delivery_ratio);
+    fprintf(f, "  \"msgs_per_sec\": %.4f,\n  \"latency_p50\": %u,\n  \"latency_p99\": %u,\n",
+      msgs_per_sec, p50, p99);
+    fprintf(f, "  \"air_ms_total\": %llu,\n  \"air_ms_per_delivered\": %.1f,\n",
+      (unsigned long long) air_total, air_per_delivered);
+    fprintf(f, "  \"forwards_per_msg\": %.3f,\n  \"dup_ratio\": %.4f,\n  \"collisions\": %u,\n  \"cpu_secs\": %.3f\n}\n",
+      forwards_per_msg, dup_ratio, num_collisions, cpu_secs);
+    fclose(f);
+  }
+  return 0;
+}
@@ -0,0 +1,496 @@
+#include <Arduino.h>   // needed for PlatformIO
+#include <Mesh.h>
+
+#if defined(NRF52_PLATFORM)
+  #include <InternalFileSystem.h>
+#elif defined(RP2040_PLATFORM)
+  #include <LittleFS.h>
+#elif defined(ESP32)
+  #include <SPIFFS.h>
+#endif
+
+#include <helpers/ArduinoHelpers.h>
+#include <helpers/ChaChaRNG.h>
+#include <helpers/StaticPoolPacketManager.h>
+#include <helpers/SimpleMeshTables.h>
+#include <helpers/IdentityStore.h>
+#include <RTClib.h>
+#include <target.h>
+
+/*
+ * On-air load generator, for measuring what a deployed mesh (ie. its repeaters) can carry. Sends a weighted mix of
+ * direct messages (to a 'target' node), flood group messages, adverts and TRACEs (out to target and back) at a set
+ * rate, with random text sizes. Delivery ratio and latency (from ACKs, and returned TRACEs) are reported over serial
+ * as CSV:
+ *
+ *   tx,<millis>,<type>,<len>,<route>        a packet sent (route: F=flood, D=direct)
+ *   ok,<millis>,<type>,<latency_ms>         ACK / TRACE came back
+ *   lost,<millis>,<type>                    timed out
+ *   type,sent,delivered,lost,failed,delivery_pct,avg_ms,max_ms      (the 'stats' command)
+ *
+ * Group messages and adverts can't be confirmed, so just count as sent. Use a dedicated channel (LOADGEN_GROUP_PSK),
+ * and a test region or time of day, as this is real traffic!
+*/
+
+/* ---------------------------------- CONFIGURATION ------------------------------------- */
+
+#define FIRMWARE_VER_TEXT   "v1 (build: 15 Oct 2026)"
+
+#ifndef LORA_FREQ
+  #define LORA_FREQ   915.0
+#endif
+#ifndef LORA_BW
+  #define LORA_BW     250
+#endif
+#ifndef LORA_SF
+  #define LORA_SF     10
+#endif
+#ifndef LORA_CR
+  #define LORA_CR      5
+#endif
+#ifndef LORA_TX_POWER
+  #define LORA_TX_POWER  20
+#endif
+
+#ifndef MAX_CONTACTS
+  #define MAX_CONTACTS         100
+#endif
+
+#include <helpers/BaseChatMesh.h>
+
+#define SEND_TIMEOUT_BASE_MILLIS          500
+#define FLOOD_SEND_TIMEOUT_FACTOR         16.0f
+#define DIRECT_SEND_PERHOP_FACTOR         6.0f
+#define DIRECT_SEND_PERHOP_EXTRA_MILLIS   250
+
+#define LOADGEN_GROUP_PSK    "bWVzaGNvcmUtbG9hZGdlbg=="   // NOT the Public channel
+#define LOADGEN_MAX_PENDING  16     // DMs / TRACEs awaiting ACK at once
+
+#define LOAD_TYPE_DM       0
+#define LOAD_TYPE_GROUP    1
+#define LOAD_TYPE_ADVERT   2
+#define LOAD_TYPE_TRACE    3
+#define LOAD_TYPE_NUM      4
+
+static const char* load_type_names[LOAD_TYPE_NUM] = { "dm", "group", "advert", "trace" };
+
+/* -------------------------------------------------------------------------------------- */
+
+struct LoadStats {
+  uint32_t sent, delivered, lost;
+  uint32_t failed;   // couldn't send (eg. no path, pool or pending slots full)
+  uint32_t latency_sum, latency_max;
+};
+
+struct PendingSend {
+  uint32_t key;     // expected ACK crc, or TRACE tag
+  uint8_t type;
+  unsigned long sent_at;
+  unsigned long timeout;   // zero if slot unused
+};
+
+class MyMesh : public BaseChatMesh, ContactVisitor {
+  char node_name[32];
+  ChannelDetails* _group;
+  ContactInfo* target;
+  LoadStats stats[LOAD_TYPE_NUM];
+  PendingSend pending[LOADGEN_MAX_PENDING];
+  uint8_t weights[LOAD_TYPE_NUM];
+  uint16_t rate_per_min;
+  uint8_t min_len, max_len;
+  unsigned long next_send, run_until;
+  bool running, csv_events;
+  uint32_t seq;
+  char command[160];
+
+  void printEvent(const char* event, uint8_t type, int32_t value, char route = 0) {
+    if (!csv_events) return;
+    Serial.printf("%s,%lu,%s", event, _ms->getMillis(), load_type_names[type]);
+    if (value >= 0) Serial.printf(",%d", value);
+    if (route) Serial.printf(",%c", route);
+    Serial.println();
+  }
+
+  PendingSend* addPending(uint8_t type, uint32_t key, uint32_t timeout_millis) {
+    for (int i = 0; i < LOADGEN_MAX_PENDING; i++) {
+      PendingSend* p = &pending[i];
+      if (p->timeout) continue;
+
+      p->key = key;
+      p->type = type;
+      p->sent_at = _ms->getMillis();
+      p->timeout = futureMillis(timeout_millis) | 1;
+      return p;
+    }
+    return NULL;   // all in use
+  }
+
+  bool completePending(uint8_t type, uint32_t key) {
+    for (int i = 0; i < LOADGEN_MAX_PENDING; i++) {
+      PendingSend* p = &pending[i];
+      if (p->timeout == 0 || p->type != type || p->key != key) continue;
+
+      uint32_t latency = _ms->getMillis() - p->sent_at;
+      LoadStats* s = &stats[type];
+      s->delivered++;
+      s->latency_sum += latency;
+      if (latency > s->latency_max) s->latency_max = latency;
+      p->timeout = 0;
+      printEvent("ok", type, latency);
+      return true;
+    }
+    return false;   // eg. a repeat of an ACK already counted
+  }
+
+  void checkPendingTimeouts() {
+    for (int i = 0; i < LOADGEN_MAX_PENDING; i++) {
+      PendingSend* p = &pending[i];
+      if (p->timeout == 0 || !millisHasNowPassed(p->timeout)) continue;
+
+      stats[p->type].lost++;
+      p->timeout = 0;
+      printEvent("lost", p->type, -1);
+    }
+  }
+
+  int makeText(char* text) {
+    int len = min_len + (max_len > min_len ? getRNG()->nextInt(0, max_len - min_len + 1) : 0);
+    int n = snprintf(text, len + 1, "#%u ", seq++);
+    for (int i = n; i < len; i++) text[i] = 'a' + (i % 26);
+    text[len] = 0;
+    return len;
+  }
+
+  uint8_t pickType() {
+    int total = 0;
+    for (int i = 0; i < LOAD_TYPE_NUM; i++) total += weights[i];
+    if (total == 0) return LOAD_TYPE_ADVERT;
+
+    int r = getRNG()->nextInt(0, total);
+    for (int i = 0; i < LOAD_TYPE_NUM; i++) {
+      if (r < weights[i]) return i;
+      r -= weights[i];
+    }
+    return LOAD_TYPE_ADVERT;
+  }
+
+  bool sendTrace() {
+    // out along target's path, then back along the reverse, so it returns to here
+    if (target->out_path_len < 0) return false;   // no path known yet
+    int n = mesh::Packet::decodePathHops(target->out_path_len);
+    int sz = mesh::Packet::decodePathHashSize(target->out_path_len);
+    if (n == 0 || (2*n - 1)*sz >= MAX_PATH_SIZE) return false;
+
+    uint8_t hashes[MAX_PATH_SIZE];
+    memcpy(hashes, target->out_path, n*sz);
+    for (int i = 0; i < n - 1; i++) {
+      memcpy(&hashes[(n + i)*sz], &target->out_path[(n - 2 - i)*sz], sz);
+    }
+    uint32_t tag;
+    getRNG()->random((uint8_t *) &tag, 4);
+    if (tag == 0) tag = 1;
+
+    mesh::Packet* pkt = createTrace(tag, 0, sz == WIDE_HASH_SIZE ? 1 : 0);
+    if (pkt == NULL) return false;
+    uint32_t t = _radio->getEstAirtimeFor(pkt->getRawLength() + (2*n - 1)*(sz + 1));
+    if (addPending(LOAD_TYPE_TRACE, tag, calcDirectTimeoutMillisFor(t, 2*n - 1)) == NULL) {
+      releasePacket(pkt);
+      return false;
+    }
+    sendDirect(pkt, hashes, (2*n - 1)*sz);
+    printEvent("tx", LOAD_TYPE_TRACE, pkt->payload_len, 'D');
+    return true;
+  }
+
+  void sendNext() {
+    uint8_t type = pickType();
+    if ((type == LOAD_TYPE_DM || type == LOAD_TYPE_TRACE) && target == NULL) type = LOAD_TYPE_ADVERT;
+
+    char text[MAX_TEXT_LEN+1];
+    bool ok = false;
+    if (type == LOAD_TYPE_DM) {
+      int len = makeText(text);
+      uint32_t ack_crc, est_timeout;
+      int result = sendMessage(*target, getRTCClock()->getCurrentTimeUnique(), 0, text, ack_crc, est_timeout);
+      if (result != MSG_SEND_FAILED) {
+        ok = true;
+        if (addPending(LOAD_TYPE_DM, ack_crc, est_timeout) == NULL) stats[type].failed++;   // sent, but can't track
+        printEvent("tx", type, len, result == MSG_SEND_SENT_FLOOD ? 'F' : 'D');
+      }
+    } else if (type == LOAD_TYPE_GROUP) {
+      int len = makeText(text);
+      ok = sendGroupMessage(getRTCClock()->getCurrentTimeUnique(), _group->channel, node_name, text, len);
+      if (ok) printEvent("tx", type, len, 'F');
+    } else if (type == LOAD_TYPE_ADVERT) {
+      mesh::Packet* pkt = createSelfAdvert(node_name);
+      if (pkt) {
+        sendFlood(pkt);
+        ok = true;
+        printEvent("tx", type, pkt->payload_len, 'F');
+      }
+    } else {
+      ok = sendTrace();
+    }
+    if (ok) stats[type].sent++; else stats[type].failed++;
+  }
+
+  void printStats() {
+    Serial.println("type,sent,delivered,lost,failed,delivery_pct,avg_ms,max_ms");
+    for (int i = 0; i < LOAD_TYPE_NUM; i++) {
+      LoadStats* s = &stats[i];
+      uint32_t done = s->delivered + s->lost;   // (excludes those still pending)
+      Serial.printf("%s,%u,%u,%u,%u,%u,%u,%u\n", load_type_names[i], s->sent, s->delivered, s->lost, s->failed,
+          done ? s->delivered * 100 / done : 0, s->delivered ? s->latency_sum / s->delivered : 0, s->latency_max);
+    }
+  }
+
+  void scheduleNext() {
+    uint32_t interval = 60000 / (rate_per_min ? rate_per_min : 1);
+    next_send = futureMillis(interval / 2 + getRNG()->nextInt(0, interval + 1));   // jittered, so senders don't sync up
+  }
+
+protected:
+  int calcRxDelay(float score, uint32_t air_time) const override {
+    return 0;  // disable rxdelay
+  }
+
+  bool allowPacketForward(const mesh::Packet* packet) override {
+    return false;   // we are the load, not the network under test
+  }
+
+  void onDiscoveredContact(ContactInfo& contact, bool is_new, uint8_t path_len, const uint8_t* path) override {
+    if (is_new) Serial.printf("# ADVERT from: %s\n", contact.name);
+  }
+
+  void onContactPathUpdated(const ContactInfo& contact) override {
+    Serial.printf("# PATH to: %s, path_len=%d\n", contact.name, (int32_t) contact.out_path_len);
+  }
+
+  ContactInfo* processAck(const uint8_t *data) override {
+    uint32_t crc;
+    memcpy(&crc, data, 4);
+    completePending(LOAD_TYPE_DM, crc);
+    return NULL;
+  }
+
+  void onTraceRecv(mesh::Packet* packet, uint32_t tag, uint32_t auth_code, uint8_t flags, const uint8_t* path_snrs, const uint8_t* path_hashes, uint8_t path_len) override {
+    if (checkRouteProbe(packet, tag, flags, path_snrs, path_len)) return;
+    completePending(LOAD_TYPE_TRACE, tag);
+  }
+
+  void onMessageRecv(const ContactInfo& from, mesh::Packet* pkt, uint32_t sender_timestamp, const char *text) override { }
+  void onCommandDataRecv(const ContactInfo& from, mesh::Packet* pkt, uint32_t sender_timestamp, const char *text) override { }
+  void onSignedMessageRecv(const ContactInfo& from, mesh::Packet* pkt, uint32_t sender_timestamp, const uint8_t *sender_prefix, const char *text) override { }
+  void onChannelMessageRecv(const mesh::GroupChannel& channel, mesh::Packet* pkt, uint32_t timestamp, const char *text) override { }
+
+  uint8_t onContactRequest(const ContactInfo& contact, uint32_t sender_timestamp, const uint8_t* data, uint8_t len, uint8_t* reply) override {
+    return 0;  // unknown
+  }
+  void onContactResponse(const ContactInfo& contact, const uint8_t* data, uint8_t len) override { }
+
+  uint32_t calcFloodTimeoutMillisFor(uint32_t pkt_airtime_millis) const override {
+    return SEND_TIMEOUT_BASE_MILLIS + (FLOOD_SEND_TIMEOUT_FACTOR * pkt_airtime_millis);
+  }
+  uint32_t calcDirectTimeoutMillisFor(uint32_t pkt_airtime_millis, uint8_t path_len) const override {
+    return SEND_TIMEOUT_BASE_MILLIS +
+         ( (pkt_airtime_millis*DIRECT_SEND_PERHOP_FACTOR + DIRECT_SEND_PERHOP_EXTRA_MILLIS) * (mesh::Packet::decodePathHops(path_len) + 1));
+  }
+
+  void onSendTimeout() override { }   // (timeouts are tracked per packet, see checkPendingTimeouts())
+
+public:
+  MyMesh(mesh::Radio& radio, ChaChaRNG& rng, mesh::RTCClock& rtc, SimpleMeshTables& tables)
+     : BaseChatMesh(radio, *new ArduinoMillis(), rng, rtc, *new StaticPoolPacketManager(32), tables)
+  {
+    strcpy(node_name, "loadgen");
+    target = NULL;
+    memset(stats, 0, sizeof(stats));
+    memset(pending, 0, sizeof(pending));
+    weights[LOAD_TYPE_DM] = 4;
+    weights[LOAD_TYPE_GROUP] = 2;
+    weights[LOAD_TYPE_ADVERT] = 1;
+    weights[LOAD_TYPE_TRACE] = 1;
+    rate_per_min = 6;
+    min_len = 10; max_len = 100;
+    next_send = run_until = 0;
+    running = false;
+    csv_events = true;
+    seq = 0;
+    command[0] = 0;
+  }
+
+  void begin(FILESYSTEM& fs) {
+    BaseChatMesh::begin();
+
+  #if defined(NRF52_PLATFORM)
+    IdentityStore store(fs, "");
+  #elif defined(RP2040_PLATFORM)
+    IdentityStore store(fs, "/identity");
+    store.begin();
+  #else
+    IdentityStore store(fs, "/identity");
+  #endif
+    if (!store.load("_main", self_id)) {
+      self_id = mesh::LocalIdentity(getRNG());  // create new random identity
+      int count = 0;
+      while (count < 10 && (self_id.pub_key[0] == 0x00 || self_id.pub_key[0] == 0xFF)) {  // reserved id hashes
+        self_id = mesh::LocalIdentity(getRNG()); count++;
+      }
+      store.save("_main", self_id);
+    }
+    _group = addChannel("loadgen", LOADGEN_GROUP_PSK);
+  }
+
+  void showWelcome() {
+    Serial.println("# ===== MeshCore Load Generator =====");
+    Serial.print("# "); mesh::Utils::printHex(Serial, self_id.pub_key, PUB_KEY_SIZE); Serial.println();
+    Serial.println("# (enter 'help' for commands)");
+  }
+
+  // ContactVisitor
+  void onContactVisit(const ContactInfo& contact) override {
+    Serial.printf("#   %s, path_len=%d\n", contact.name, (int32_t) contact.out_path_len);
+  }
+
+  void handleCommand(char* command) {
+    while (*command == ' ') command++;  // skip leading spaces
+
+    if (memcmp(command, "to ", 3) == 0) {
+      target = searchContactsByPrefix(&command[3]);
+      Serial.println(target ? "  OK" : "  Error: name prefix not found");
+    } else if (memcmp(command, "rate ", 5) == 0) {
+      rate_per_min = atoi(&command[5]);
+      Serial.println("  OK");
+    } else if (memcmp(command, "size ", 5) == 0) {
+      int lo = 0, hi = 0;
+      sscanf(&command[5], "%d %d", &lo, &hi);
+      if (lo > 0 && hi >= lo && hi <= MAX_TEXT_LEN - 16) {
+        min_len = lo; max_len = hi;
+        Serial.println("  OK");
+      } else {
+        Serial.println("  Error: size <min> <max>");
+      }
+    } else if (memcmp(command, "mix ", 4) == 0) {
+      int w[LOAD_TYPE_NUM] = { 0 };
+      sscanf(&command[4], "%d %d %d %d", &w[0], &w[1], &w[2], &w[3]);
+      for (int i = 0; i < LOAD_TYPE_NUM; i++) weights[i] = w[i] < 0 ? 0 : (w[i] > 100 ? 100 : w[i]);
+      Serial.println("  OK");
+    } else if (memcmp(command, "name ", 5) == 0) {
+      StrHelper::strncpy(node_name, &command[5], sizeof(node_name));
+      Serial.println("  OK");
+    } else if (memcmp(command, "start", 5) == 0) {
+      uint32_t secs = command[5] == ' ' ? atoi(&command[6]) : 0;
+      run_until = secs ? futureMillis(secs * 1000) : 0;
+      running = true;
+      scheduleNext();
+      Serial.println("# started");
+    } else if (strcmp(command, "stop") == 0) {
+      running = false;
+      Serial.println("# stopped");
+    } else if (strcmp(command, "stats") == 0) {
+      printStats();
+    } else if (strcmp(command, "reset") == 0) {
+      memset(stats, 0, sizeof(stats));
+      memset(pending, 0, sizeof(pending));
+      Serial.println("  OK");
+    } else if (memcmp(command, "csv ", 4) == 0) {
+      csv_events = strcmp(&command[4], "on") == 0;
+      Serial.println("  OK");
+    } else if (strcmp(command, "list") == 0) {
+      scanRecentContacts(0, this);
+    } else if (strcmp(command, "advert") == 0) {
+      mesh::Packet* pkt = createSelfAdvert(node_name);
+      if (pkt) sendFlood(pkt);
+      Serial.println("  OK");
+    } else if (memcmp(command, "ver", 3) == 0) {
+      Serial.println(FIRMWARE_VER_TEXT);
+    } else if (memcmp(command, "help", 4) == 0) {
+      Serial.println("# Commands:");
+      Serial.println("#   to <target name prefix>     (for DMs and TRACEs, needs its advert first)");
+      Serial.println("#   rate <packets per minute>");
+      Serial.println("#   size <min> <max>            (text length)");
+      Serial.println("#   mix <dm> <group> <advert> <trace>   (weights)");
+      Serial.println("#   start {secs} | stop | stats | reset");
+      Serial.println("#   csv {on|off}                (per packet lines)");
+      Serial.println("#   name <name> | list | advert | ver");
+    } else {
+      Serial.print("  ERROR: unknown command: "); Serial.println(command);
+    }
+  }
+
+  void loop() {
+    BaseChatMesh::loop();
+    checkPendingTimeouts();
+
+    if (running && run_until && millisHasNowPassed(run_until)) {
+      running = false;
+      Serial.println("# run complete");
+      printStats();
+    }
+    if (running && millisHasNowPassed(next_send)) {
+      sendNext();
+      scheduleNext();
+    }
+
+    int len = strlen(command);
+    while (Serial.available() && len < sizeof(command)-1) {
+      char c = Serial.read();
+      if (c != '\n') {
+        command[len++] = c;
+        command[len] = 0;
+      }
+    }
+    if (len == sizeof(command)-1) {  // command buffer full
+      command[sizeof(command)-1] = '\r';
+    }
+    if (len > 0 && command[len - 1] == '\r') {  // received complete line
+      command[len - 1] = 0;
+      handleCommand(command);
+      command[0] = 0;
+    }
+  }
+};
+
+ChaChaRNG fast_rng;
+SimpleMeshTables tables;
+MyMesh the_mesh(radio_driver, fast_rng, rtc_clock, tables);
+
+void halt() {
+  while (1) ;
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  board.begin();
+
+  if (!radio_init()) { halt(); }
+
+  {
+    HardwareRNG seed_src(radio_get_rng_seed);   // 32 bytes of TRNG + radio noise
+    fast_rng.begin(seed_src);
+  }
+
+#if defined(NRF52_PLATFORM)
+  InternalFS.begin();
+  the_mesh.begin(InternalFS);
+#elif defined(RP2040_PLATFORM)
+  LittleFS.begin();
+  the_mesh.begin(LittleFS);
+#elif defined(ESP32)
+  SPIFFS.begin(true);
+  the_mesh.begin(SPIFFS);
+#else
+  #error "need to define filesystem"
+#endif
+
+  radio_set_params(LORA_FREQ, LORA_BW, LORA_SF, LORA_CR);
+  radio_set_tx_power(LORA_TX_POWER);
+
+  the_mesh.showWelcome();
+}
+
+void loop() {
+  the_mesh.loop();
+  rtc_clock.tick();
+}
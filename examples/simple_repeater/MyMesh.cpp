@@ -41,13 +41,22 @@
   #define TXT_ACK_DELAY 200
 #endif
 
-#define FIRMWARE_VER_LEVEL       1
+#define FIRMWARE_VER_LEVEL       2   // 2: login response carries a session ticket (see REQ_TYPE_RESUME_LOGIN)
 
 #define REQ_TYPE_GET_STATUS         0x01 // same as _GET_STATS
 #define REQ_TYPE_KEEP_ALIVE         0x02
 #define REQ_TYPE_GET_TELEMETRY_DATA 0x03
 #define REQ_TYPE_GET_ACCESS_LIST    0x05
 #define REQ_TYPE_GET_NEIGHBOURS     0x06
+#define REQ_TYPE_STATS_PUSH         0x07   // subscribe to periodic STATS_PUSH_MARKER responses
+#define REQ_TYPE_PREFS              0x08   // bulk get/set of prefs
+#define REQ_TYPE_RESUME_LOGIN       0x09   // login again with the ticket from a previous login response
+#define REQ_TYPE_FW_OFFER           0x0A   // (admin) start offering the running firmware to neighbours, see FirmwareXfer
+#define REQ_TYPE_GET_LINK_MAP       0x0B   // link quality per neighbour, from the TRACE sweeps
+
+#define STATS_PUSH_MARKER           0xF5   // first byte after tag, in a pushed (unsolicited) response
+#define STATS_PUSH_VERSION          1
+#define STATS_PUSH_FLAG_KEYFRAME    0x01   // values are absolute, not deltas from previous push
 
 #define RESP_SERVER_LOGIN_OK        0 // response to ANON_REQ
 
@@ -55,31 +64,215 @@
 
 #define LAZY_CONTACTS_WRITE_DELAY    5000
 
-void MyMesh::putNeighbour(const mesh::Identity &id, uint32_t timestamp, float snr) {
-#if MAX_NEIGHBOURS // check if neighbours enabled
-  // find existing neighbour, else use least recently updated
-  uint32_t oldest_timestamp = 0xFFFFFFFF;
-  NeighbourInfo *neighbour = &neighbours[0];
-  for (int i = 0; i < MAX_NEIGHBOURS; i++) {
-    // if neighbour already known, we should update it
-    if (id.matches(neighbours[i].id)) {
-      neighbour = &neighbours[i];
+#ifndef TABLES_SAVE_INTERVAL_SECS
+  #define TABLES_SAVE_INTERVAL_SECS    600    // how often to snapshot the packet dedup tables (if changed)
+#endif
+#define TABLES_SNAPSHOT_FILE         "/mesh_tables"
+
+#if defined(ESP32) && RX_SLEEP_IDLE_MILLIS
+  #include <esp_attr.h>
+
+  #define RX_SLEEP_MAGIC   0x52585331
+
+// kept in RTC memory, during deep sleep. (only plain bytes, so no constructors run at wakeup)
+struct RxSleepState {
+  uint32_t magic;
+  uint32_t sleep_time;    // RTC time went to sleep
+  uint32_t local_advert_secs, flood_advert_secs;   // until due (from sleep_time), or zero if timer stopped
+  uint64_t uptime_millis;
+#ifndef DEDUP_WINDOW_SECS
+  uint8_t tables[SimpleMeshTables::SNAPSHOT_SIZE];
+#endif
+#if MAX_NEIGHBOURS
+  uint8_t neighbours[sizeof(NeighbourInfo) * MAX_NEIGHBOURS];
+  uint8_t neighbour_buckets[sizeof(int16_t) * NEIGHBOUR_HASH_SIZE];
+#endif
+};
+static RTC_DATA_ATTR RxSleepState rx_sleep_state;
+#endif
+
+#if WARM_RESTART_SAVE_MILLIS && defined(RETAINED_RAM_ATTR)
+  #define WITH_WARM_RESTART
+
+// kept in retained RAM, through a watchdog/crash/software reset, so that a warm restart carries on where it left off
+struct WarmState {
+  uint32_t rtc_time;      // RTC time when saved
+  uint64_t uptime_millis;
+  mesh::Dispatcher::Counters counters;
+#ifndef DEDUP_WINDOW_SECS
+  uint8_t tables[SimpleMeshTables::SNAPSHOT_SIZE];
+#endif
+#if MAX_NEIGHBOURS
+  uint8_t neighbours[sizeof(NeighbourInfo) * MAX_NEIGHBOURS];
+  uint8_t neighbour_buckets[sizeof(int16_t) * NEIGHBOUR_HASH_SIZE];
+#endif
+};
+static RETAINED_RAM_ATTR RetainedState<WarmState> warm_state;
+#endif
+
+#if MAX_NEIGHBOURS
+NeighbourInfo* MyMesh::findNeighbour(const uint8_t* pub_key) {
+  for (int i = neighbour_buckets[pub_key[0] % NEIGHBOUR_HASH_SIZE]; i >= 0; i = neighbours[i].next) {
+    if (neighbours[i].id.matches(pub_key)) return &neighbours[i];
+  }
+  return NULL;  // not found
+}
+
+void MyMesh::unlinkNeighbour(int idx) {
+  int16_t* link = &neighbour_buckets[neighbours[idx].id.pub_key[0] % NEIGHBOUR_HASH_SIZE];
+  while (*link >= 0) {
+    if (*link == idx) {
+      *link = neighbours[idx].next;
       break;
     }
+    link = &neighbours[*link].next;
+  }
+  memset(&neighbours[idx], 0, sizeof(NeighbourInfo));   // now unused
+  neighbours[idx].next = -1;
+}
+
+void MyMesh::clearNeighbours() {
+  memset(neighbours, 0, sizeof(neighbours));
+  for (int i = 0; i < MAX_NEIGHBOURS; i++) neighbours[i].next = -1;
+  for (int i = 0; i < NEIGHBOUR_HASH_SIZE; i++) neighbour_buckets[i] = -1;
+}
+
+void MyMesh::expireNeighbours() {
+  uint32_t now = getRTCClock()->getCurrentTime();
+  for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+    if (neighbours[i].heard_timestamp > 0 && now - neighbours[i].heard_timestamp >= NEIGHBOUR_MAX_AGE_SECS) {
+      unlinkNeighbour(i);
+    }
+  }
+}
+#endif
 
-    // otherwise we should update the least recently updated neighbour
-    if (neighbours[i].heard_timestamp < oldest_timestamp) {
-      neighbour = &neighbours[i];
-      oldest_timestamp = neighbour->heard_timestamp;
+void MyMesh::putNeighbour(const mesh::Identity &id, uint32_t timestamp, float snr, bool low_power_rx, int8_t home_channel) {
+#if MAX_NEIGHBOURS // check if neighbours enabled
+  int8_t snr4 = (int8_t)(snr * 4);
+  NeighbourInfo *neighbour = findNeighbour(id.pub_key);
+  if (neighbour == NULL) {
+    // new neighbour, so use an unused slot, else the least recently heard
+    int idx = 0;
+    for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+      if (neighbours[i].heard_timestamp == 0) { idx = i; break; }
+      if (neighbours[i].heard_timestamp < neighbours[idx].heard_timestamp) idx = i;
     }
+    if (neighbours[idx].heard_timestamp > 0) unlinkNeighbour(idx);
+
+    neighbour = &neighbours[idx];
+    neighbour->id = id;
+    neighbour->snr_avg = snr4;
+    neighbour->link_snr_out = neighbour->link_snr_in = 127;   // not swept yet
+    int16_t* head = &neighbour_buckets[id.pub_key[0] % NEIGHBOUR_HASH_SIZE];
+    neighbour->next = *head;
+    *head = idx;
+  } else {
+    neighbour->snr_avg += (snr4 - neighbour->snr_avg) / 4;   // EWMA, alpha = 1/4
   }
 
   // update neighbour info
-  neighbour->id = id;
   neighbour->advert_timestamp = timestamp;
   neighbour->heard_timestamp = getRTCClock()->getCurrentTime();
-  neighbour->snr = (int8_t)(snr * 4);
+  neighbour->snr = snr4;
+  neighbour->low_power_rx = low_power_rx;
+  neighbour->home_channel = home_channel;
+  if (neighbour->heard_count < 0xFFFF) neighbour->heard_count++;
+#endif
+}
+
+#if MAX_NEIGHBOURS
+void MyMesh::checkLinkSweep() {
+#if LINK_SWEEP_INTERVAL_SECS
+  if (link_probe_tag && millisHasNowPassed(link_probe_timeout)) {   // TRACE never came back
+    NeighbourInfo* n = findNeighbour(link_probe_key);
+    if (n) n->link_success -= (n->link_success + 3) / 4;
+    link_probe_tag = 0;
+  }
+  if (link_probe_tag || !millisHasNowPassed(next_link_probe)) return;
+
+  if (!isIdle() || _mgr->getOutboundCount(0xFFFFFFFF) > 0 || channel_load.getPercent(millis()) > LINK_SWEEP_MAX_LOAD) {
+    next_link_probe = futureMillis(LINK_PROBE_GAP_MILLIS / 4);   // busy, try again shortly
+    return;
+  }
+
+  uint32_t now = getRTCClock()->getCurrentTime();
+  while (link_sweep_idx < MAX_NEIGHBOURS) {
+    NeighbourInfo* n = &neighbours[link_sweep_idx];
+    if (n->heard_timestamp == 0 || now - n->heard_timestamp >= NEIGHBOUR_ACTIVE_SECS) { link_sweep_idx++; continue; }
+
+    uint32_t tag;
+    getRNG()->random((uint8_t *) &tag, 4);
+    if (tag == 0) tag = 1;
+    mesh::Packet* pkt = createTrace(tag, 0, 0);
+    if (pkt == NULL) break;   // pool empty, try again later
+
+    // out to neighbour, which appends the SNR it heard us at and retransmits, so it ends back here
+    uint32_t t = _radio->getEstAirtimeFor(pkt->getRawLength() + 2);
+    sendDirect(pkt, n->id.pub_key, 1);
+    memcpy(link_probe_key, n->id.pub_key, PUB_KEY_SIZE);
+    link_probe_tag = tag;
+    link_probe_timeout = futureMillis(2*t + LINK_PROBE_TIMEOUT_MILLIS);
+    if (n->link_probes < 255) n->link_probes++;
+    link_sweep_idx++;
+    next_link_probe = futureMillis(LINK_PROBE_GAP_MILLIS);
+    return;
+  }
+  if (link_sweep_idx < MAX_NEIGHBOURS) {
+    next_link_probe = futureMillis(LINK_PROBE_GAP_MILLIS);
+  } else {
+    link_sweep_idx = 0;   // sweep done
+    next_link_probe = futureMillis(LINK_SWEEP_INTERVAL_SECS * 1000UL);
+  }
+#endif
+}
+
+int MyMesh::formatLinkMap(uint8_t* dest, uint16_t offset) {
+  // total (2 bytes), count, then per neighbour: pub_key prefix (4), snr_out, snr_in, success, probes
+  uint16_t total = 0;
+  uint8_t count = 0;
+  int ofs = 3;
+  for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+    auto n = &neighbours[i];
+    if (n->heard_timestamp == 0) continue;
+    if (total++ < offset || ofs + 8 > MAX_PACKET_PAYLOAD - 4) continue;
+
+    memcpy(&dest[ofs], n->id.pub_key, 4); ofs += 4;
+    dest[ofs++] = n->link_snr_out;
+    dest[ofs++] = n->link_snr_in;
+    dest[ofs++] = n->link_success;
+    dest[ofs++] = n->link_probes;
+    count++;
+  }
+  memcpy(&dest[0], &total, 2);
+  dest[2] = count;
+  return ofs;
+}
+#endif
+
+void MyMesh::onTraceRecv(mesh::Packet* packet, uint32_t tag, uint32_t auth_code, uint8_t flags, const uint8_t* path_snrs, const uint8_t* path_hashes, uint8_t path_len) {
+#if MAX_NEIGHBOURS
+  if (link_probe_tag == 0 || tag != link_probe_tag || packet->path_len < 1) return;   // not our sweep TRACE
+
+  link_probe_tag = 0;
+  NeighbourInfo* n = findNeighbour(link_probe_key);
+  if (n) {
+    n->link_snr_out = (int8_t) path_snrs[0];
+    n->link_snr_in = (int8_t) (packet->getSNR() * 4);
+    n->link_success += (255 - n->link_success + 3) / 4;   // EWMA, alpha = 1/4
+  }
+#endif
+}
+
+int MyMesh::countActiveNeighbours() {
+  int n = 0;
+#if MAX_NEIGHBOURS
+  uint32_t now = getRTCClock()->getCurrentTime();
+  for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+    if (neighbours[i].heard_timestamp > 0 && now - neighbours[i].heard_timestamp < NEIGHBOUR_ACTIVE_SECS) n++;
+  }
 #endif
+  return n;
 }
 
 uint8_t MyMesh::handleLoginReq(const mesh::Identity& sender, const uint8_t* secret, uint32_t sender_timestamp, const uint8_t* data, bool is_flood) {
@@ -126,19 +319,230 @@ uint8_t MyMesh::handleLoginReq(const mesh::Identity& sender, const uint8_t* secr
   if (is_flood) {
     client->out_path_len = -1;  // need to rediscover out_path
   }
+  return formatLoginReply(client);
+}
 
+uint8_t MyMesh::formatLoginReply(ClientInfo* client) {
   uint32_t now = getRTCClock()->getCurrentTimeUnique();
   memcpy(reply_data, &now, 4);   // response packets always prefixed with timestamp
   reply_data[4] = RESP_SERVER_LOGIN_OK;
   reply_data[5] = 0;  // Legacy: was recommended keep-alive interval (secs / 16)
   reply_data[6] = client->isAdmin() ? 1 : 0;
   reply_data[7] = client->permissions;
-  getRNG()->random(&reply_data[8], 4);   // random blob to help packet-hash uniqueness
+  uint32_t ticket = ClientACL::calcSessionTicket(self_id, client);   // (was a random blob, before ver level 2)
+  memcpy(&reply_data[8], &ticket, 4);
   reply_data[12] = FIRMWARE_VER_LEVEL;  // New field
 
   return 13;  // reply length
 }
 
+uint8_t MyMesh::handleResumeReq(ClientInfo* client, const uint8_t* payload, size_t payload_len, bool is_flood) {
+  uint32_t ticket;
+  if (payload_len < 5) return 0;
+  memcpy(&ticket, &payload[1], 4);
+  if (ticket != ClientACL::calcSessionTicket(self_id, client)) {   // stale, eg. permissions since changed
+    MESH_DEBUG_PRINTLN("Resume login, invalid ticket");
+    return 0;   // client will fall back to a full login
+  }
+
+  if (is_flood) {
+    client->out_path_len = -1;  // need to rediscover out_path
+  }
+  return formatLoginReply(client);
+}
+
+struct StatsPushField {
+  uint8_t offset, size;
+  bool is_signed;
+  bool is_counter;   // sent as delta from previous push, else absolute
+};
+
+#define STATS_FIELD(f, sgn, ctr)   { offsetof(RepeaterStats, f), sizeof(RepeaterStats::f), sgn, ctr }
+
+static const StatsPushField stats_push_fields[] = {   // field ids, ie. bit in presence bitmap, are index here. ONLY APPEND!
+  STATS_FIELD(batt_milli_volts, false, false),
+  STATS_FIELD(curr_tx_queue_len, false, false),
+  STATS_FIELD(noise_floor, true, false),
+  STATS_FIELD(last_rssi, true, false),
+  STATS_FIELD(last_snr, true, false),
+  STATS_FIELD(n_packets_recv, false, true),
+  STATS_FIELD(n_packets_sent, false, true),
+  STATS_FIELD(total_air_time_secs, false, true),
+  STATS_FIELD(total_up_time_secs, false, true),
+  STATS_FIELD(n_sent_flood, false, true),
+  STATS_FIELD(n_sent_direct, false, true),
+  STATS_FIELD(n_recv_flood, false, true),
+  STATS_FIELD(n_recv_direct, false, true),
+  STATS_FIELD(err_events, false, false),
+  STATS_FIELD(n_direct_dups, false, true),
+  STATS_FIELD(n_flood_dups, false, true),
+  STATS_FIELD(total_rx_air_time_secs, false, true),
+  STATS_FIELD(tables_used, false, false),
+  STATS_FIELD(n_table_evictions, false, true),
+  STATS_FIELD(dup_air_time_secs, false, true),
+  STATS_FIELD(n_bridge_pkts_in, false, true),
+  STATS_FIELD(n_bridge_pkts_out, false, true),
+  STATS_FIELD(n_bridge_bad, false, true),
+  STATS_FIELD(bridge_delay, false, false),
+};
+#define NUM_STATS_PUSH_FIELDS   (sizeof(stats_push_fields) / sizeof(stats_push_fields[0]))
+#define STATS_PUSH_BITMAP_SIZE  ((NUM_STATS_PUSH_FIELDS + 7) / 8)
+
+static int32_t getStatsField(const RepeaterStats& stats, const StatsPushField& f) {
+  const uint8_t* p = ((const uint8_t *) &stats) + f.offset;
+  if (f.size == 2) {
+    uint16_t v; memcpy(&v, p, 2);
+    return f.is_signed ? (int32_t)(int16_t)v : (int32_t)v;
+  }
+  uint32_t v; memcpy(&v, p, 4);
+  return (int32_t) v;
+}
+
+static int putVarInt(uint8_t* dest, int32_t v) {   // zig-zag, then LEB128
+  uint32_t z = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+  int n = 0;
+  while (z >= 0x80) {
+    dest[n++] = (z & 0x7F) | 0x80;
+    z >>= 7;
+  }
+  dest[n++] = z;
+  return n;
+}
+
+/**
+ * \brief  encodes [marker][version][seq][flags][bitmap][varint per field present]. Only fields which changed are present,
+ *    and counters are sent as deltas (with 32 bit wrap-around), unless 'prev' is NULL (keyframe).
+ */
+static int encodeStatsPush(uint8_t* dest, const RepeaterStats& curr, const RepeaterStats* prev, uint8_t seq) {
+  int i = 0;
+  dest[i++] = STATS_PUSH_MARKER;
+  dest[i++] = STATS_PUSH_VERSION;
+  dest[i++] = seq;
+  dest[i++] = prev ? 0 : STATS_PUSH_FLAG_KEYFRAME;
+  uint8_t* bitmap = &dest[i];
+  memset(bitmap, 0, STATS_PUSH_BITMAP_SIZE); i += STATS_PUSH_BITMAP_SIZE;
+
+  for (int f = 0; f < NUM_STATS_PUSH_FIELDS; f++) {
+    auto fld = &stats_push_fields[f];
+    int32_t v = getStatsField(curr, *fld);
+    if (prev) {
+      int32_t p = getStatsField(*prev, *fld);
+      if (v == p) continue;   // unchanged, so omit
+      if (fld->is_counter) v = (int32_t)((uint32_t)v - (uint32_t)p);
+    }
+    bitmap[f / 8] |= (1 << (f % 8));
+    i += putVarInt(&dest[i], v);
+  }
+  return i;
+}
+
+bool MyMesh::subscribeStats(const ClientInfo* client, uint16_t interval_mins) {
+  StatsSubscription* sub = NULL;
+  for (int i = 0; i < STATS_PUSH_MAX_SUBS; i++) {
+    if (stats_subs[i].interval_mins && memcmp(stats_subs[i].pub_key, client->id.pub_key, PUB_KEY_SIZE) == 0) {
+      sub = &stats_subs[i];
+      break;
+    }
+    if (sub == NULL && stats_subs[i].interval_mins == 0) sub = &stats_subs[i];   // first unused
+  }
+  if (interval_mins == 0) {   // unsubscribe
+    if (sub && sub->interval_mins) sub->interval_mins = 0;
+    return true;
+  }
+  if (sub == NULL) return false;   // all in use
+
+  if (sub->interval_mins == 0) {
+    memcpy(sub->pub_key, client->id.pub_key, PUB_KEY_SIZE);
+    sub->seq = 0;   // forces keyframe
+  }
+  sub->interval_mins = interval_mins;
+  sub->next_push = futureMillis(5000);   // first push soon after
+  return true;
+}
+
+void MyMesh::sendStatsPushes() {
+  RepeaterStats curr;
+  bool have_curr = false;
+  for (int i = 0; i < STATS_PUSH_MAX_SUBS; i++) {
+    auto sub = &stats_subs[i];
+    if (sub->interval_mins == 0 || !millisHasNowPassed(sub->next_push)) continue;
+
+    ClientInfo* client = acl.getClient(sub->pub_key, PUB_KEY_SIZE);
+    if (client == NULL || !client->isAdmin()) {   // removed from ACL since
+      sub->interval_mins = 0;
+      continue;
+    }
+    if (!have_curr) { fillRepeaterStats(curr); have_curr = true; }
+
+    uint8_t data[MAX_PACKET_PAYLOAD];
+    uint32_t now = getRTCClock()->getCurrentTime();
+    memcpy(data, &now, 4);   // tag
+    bool keyframe = (sub->seq % STATS_PUSH_KEYFRAME_EVERY) == 0;
+    int len = 4 + encodeStatsPush(&data[4], curr, keyframe ? NULL : &sub->last, sub->seq);
+    sub->seq++;
+    sub->last = curr;
+    sub->next_push = futureMillis(((uint32_t)sub->interval_mins) * 60 * 1000);
+
+    mesh::Packet* pkt = createDatagram(PAYLOAD_TYPE_RESPONSE, client->id, client->shared_secret, data, len);
+    if (pkt) {
+      if (client->out_path_len >= 0) {
+        sendDirect(pkt, client->out_path, client->out_path_len);
+      } else {
+        sendFlood(pkt);
+      }
+    }
+  }
+}
+
+void MyMesh::fillRepeaterStats(RepeaterStats& stats) {
+  stats.batt_milli_volts = board.getBattMilliVolts();
+  stats.curr_tx_queue_len = _mgr->getOutboundCount(0xFFFFFFFF);
+  stats.noise_floor = (int16_t)_radio->getNoiseFloor();
+  stats.last_rssi = (int16_t)radio_driver.getLastRSSI();
+  stats.n_packets_recv = radio_driver.getPacketsRecv();
+  stats.n_packets_sent = radio_driver.getPacketsSent();
+  stats.total_air_time_secs = getTotalAirTime() / 1000;
+  stats.total_up_time_secs = uptime_millis / 1000;
+  stats.n_sent_flood = getNumSentFlood();
+  stats.n_sent_direct = getNumSentDirect();
+  stats.n_recv_flood = getNumRecvFlood();
+  stats.n_recv_direct = getNumRecvDirect();
+  stats.err_events = _err_flags;
+  stats.last_snr = (int16_t)(radio_driver.getLastSNR() * 4);
+  stats.n_direct_dups = ((RepeaterTables *)getTables())->getNumDirectDups();
+  stats.n_flood_dups = ((RepeaterTables *)getTables())->getNumFloodDups();
+  stats.total_rx_air_time_secs = getReceiveAirTime() / 1000;
+  RepeaterTables* tables = (RepeaterTables *)getTables();
+  const DedupStats& dedup = tables->getDedupStats();
+  stats.tables_used = tables->getCount();
+  stats.tables_capacity = tables->getCapacity();
+  stats.n_table_evictions = dedup.n_evictions;
+  stats.dup_air_time_secs = dedup.dup_air_time / 1000;
+  for (int i = 0; i < 16; i++) {
+    stats.dups_by_type[i] = dedup.dups_by_type[i] > 0xFFFF ? 0xFFFF : dedup.dups_by_type[i];
+  }
+#ifdef WITH_BRIDGE
+  const BridgeStats& b = bridge.getStats();
+  stats.n_bridge_frames_in = b.n_frames_in;
+  stats.n_bridge_frames_out = b.n_frames_out;
+  stats.n_bridge_pkts_in = b.n_packets_in;
+  stats.n_bridge_pkts_out = b.n_packets_out;
+  stats.n_bridge_bad = b.n_bad_frames;
+  stats.n_bridge_dups = b.n_dups;
+  stats.bridge_queue_len = bridge.getBatchCount();
+  stats.bridge_delay = bridge.getEffectiveDelay();
+  stats.bridge_offset = bridge.getAvgOffset();
+  stats.bridge_offset_dev = bridge.getOffsetDeviation();
+#else
+  stats.n_bridge_frames_in = stats.n_bridge_frames_out = 0;
+  stats.n_bridge_pkts_in = stats.n_bridge_pkts_out = 0;
+  stats.n_bridge_bad = stats.n_bridge_dups = 0;
+  stats.bridge_queue_len = stats.bridge_delay = 0;
+  stats.bridge_offset = 0;
+  stats.bridge_offset_dev = 0;
+#endif
+}
+
 int MyMesh::handleRequest(ClientInfo *sender, uint32_t sender_timestamp, uint8_t *payload, size_t payload_len) {
   // uint32_t now = getRTCClock()->getCurrentTimeUnique();
   // memcpy(reply_data, &now, 4);   // response packets always prefixed with timestamp
@@ -146,41 +550,46 @@ int MyMesh::handleRequest(ClientInfo *sender, uint32_t sender_timestamp, uint8_t
 
   if (payload[0] == REQ_TYPE_GET_STATUS) {  // guests can also access this now
     RepeaterStats stats;
-    stats.batt_milli_volts = board.getBattMilliVolts();
-    stats.curr_tx_queue_len = _mgr->getOutboundCount(0xFFFFFFFF);
-    stats.noise_floor = (int16_t)_radio->getNoiseFloor();
-    stats.last_rssi = (int16_t)radio_driver.getLastRSSI();
-    stats.n_packets_recv = radio_driver.getPacketsRecv();
-    stats.n_packets_sent = radio_driver.getPacketsSent();
-    stats.total_air_time_secs = getTotalAirTime() / 1000;
-    stats.total_up_time_secs = uptime_millis / 1000;
-    stats.n_sent_flood = getNumSentFlood();
-    stats.n_sent_direct = getNumSentDirect();
-    stats.n_recv_flood = getNumRecvFlood();
-    stats.n_recv_direct = getNumRecvDirect();
-    stats.err_events = _err_flags;
-    stats.last_snr = (int16_t)(radio_driver.getLastSNR() * 4);
-    stats.n_direct_dups = ((SimpleMeshTables *)getTables())->getNumDirectDups();
-    stats.n_flood_dups = ((SimpleMeshTables *)getTables())->getNumFloodDups();
-    stats.total_rx_air_time_secs = getReceiveAirTime() / 1000;
+    fillRepeaterStats(stats);
 
     memcpy(&reply_data[4], &stats, sizeof(stats));
 
     return 4 + sizeof(stats); //  reply_len
   }
+  if (payload[0] == REQ_TYPE_STATS_PUSH && sender->isAdmin() && payload_len >= 3) {
+    uint16_t interval_mins;
+    memcpy(&interval_mins, &payload[1], 2);   // zero to unsubscribe
+    if (interval_mins > 0 && interval_mins < STATS_PUSH_MIN_MINS) interval_mins = STATS_PUSH_MIN_MINS;
+
+    reply_data[4] = subscribeStats(sender, interval_mins) ? 1 : 0;
+    memcpy(&reply_data[5], &interval_mins, 2);   // interval actually applied
+    return 7;
+  }
+#ifdef WITH_MESH_OTA
+  if (payload[0] == REQ_TYPE_FW_OFFER && sender->isAdmin() && payload_len >= 1 + FW_MANIFEST_LEN) {
+    reply_data[4] = isTrustedFirmware(&payload[1]) && fw_xfer.offer(&payload[1]) ? 1 : 0;
+    return 5;
+  }
+#endif
+  if (payload[0] == REQ_TYPE_PREFS && sender->isAdmin()) {
+    return 4 + _cli.handlePrefsRequest(&payload[1], payload_len - 1, &reply_data[4], sizeof(reply_data) - 4);
+  }
   if (payload[0] == REQ_TYPE_GET_TELEMETRY_DATA) {
     uint8_t perm_mask = ~(payload[1]); // NEW: first reserved byte (of 4), is now inverse mask to apply to permissions
-
-    telemetry.reset();
-    telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
-    // query other sensors -- target specific
     if ((sender->permissions & PERM_ACL_ROLE_MASK) == PERM_ACL_GUEST) {
       perm_mask = 0x00;  // just base telemetry allowed
     }
-    sensors.querySensors(perm_mask, telemetry);
 
-    uint8_t tlen = telemetry.getSize();
-    memcpy(&reply_data[4], telemetry.getBuffer(), tlen);
+    int tlen = telem_cache.get(perm_mask, &reply_data[4], millis());
+    if (tlen == 0) {   // no recent snapshot for these permissions
+      telemetry.resetInto(&reply_data[4], sizeof(reply_data) - 4);   // encode in place
+      telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
+      // query other sensors -- target specific
+      sensors.querySensors(perm_mask, telemetry);
+
+      tlen = telemetry.getSize();
+      telem_cache.put(perm_mask, &reply_data[4], tlen, millis());
+    }
     return 4 + tlen; // reply_len
   }
   if (payload[0] == REQ_TYPE_GET_ACCESS_LIST && sender->isAdmin()) {
@@ -197,9 +606,16 @@ int MyMesh::handleRequest(ClientInfo *sender, uint32_t sender_timestamp, uint8_t
       return ofs;
     }
   }
+#if MAX_NEIGHBOURS
+  if (payload[0] == REQ_TYPE_GET_LINK_MAP && payload_len >= 4 && payload[1] == 0) {   // version 0
+    uint16_t offset;
+    memcpy(&offset, &payload[2], 2);   // for paging, if more neighbours than fit
+    return 4 + formatLinkMap(&reply_data[4], offset);
+  }
+#endif
   if (payload[0] == REQ_TYPE_GET_NEIGHBOURS) {
     uint8_t request_version = payload[1];
-    if (request_version == 0) {
+    if (request_version <= 1) {   // v1 adds heard_count and snr_avg to each entry
 
       // reply data offset (after response sender_timestamp/tag)
       int reply_offset = 4;
@@ -265,7 +681,7 @@ int MyMesh::handleRequest(ClientInfo *sender, uint32_t sender_timestamp, uint8_t
       for(int index = 0; index < count && index + offset < neighbours_count; index++){
         
         // stop if we can't fit another entry in results
-        int entry_size = pubkey_prefix_length + 4 + 1;
+        int entry_size = pubkey_prefix_length + 4 + 1 + (request_version >= 1 ? 3 : 0);
         if(results_offset + entry_size > sizeof(results_buffer)){
           MESH_DEBUG_PRINTLN("REQ_TYPE_GET_NEIGHBOURS no more entries can fit in results buffer");
           break;
@@ -277,6 +693,10 @@ int MyMesh::handleRequest(ClientInfo *sender, uint32_t sender_timestamp, uint8_t
         memcpy(&results_buffer[results_offset], neighbour->id.pub_key, pubkey_prefix_length); results_offset += pubkey_prefix_length;
         memcpy(&results_buffer[results_offset], &heard_seconds_ago, 4); results_offset += 4;
         memcpy(&results_buffer[results_offset], &neighbour->snr, 1); results_offset += 1;
+        if (request_version >= 1) {
+          memcpy(&results_buffer[results_offset], &neighbour->heard_count, 2); results_offset += 2;
+          memcpy(&results_buffer[results_offset], &neighbour->snr_avg, 1); results_offset += 1;
+        }
         results_count++;
 
       }
@@ -293,33 +713,144 @@ int MyMesh::handleRequest(ClientInfo *sender, uint32_t sender_timestamp, uint8_t
   return 0; // unknown command
 }
 
-mesh::Packet *MyMesh::createSelfAdvert() {
+mesh::Packet *MyMesh::createSelfAdvert(bool allow_refresh) {
   uint8_t app_data[MAX_ADVERT_DATA_SIZE];
-  uint8_t app_data_len = _cli.buildAdvertData(ADV_TYPE_REPEATER, app_data);
+  uint8_t app_data_len = _cli.buildAdvertData(ADV_TYPE_REPEATER, app_data, ADV_CAP_NET_CODING | ADV_CAP_FRAGMENTS | (low_power_rx ? ADV_CAP_LOW_POWER_RX : 0),
+                                              (channel_plan.isEnabled() ? home_channel + 1 : 0) | ADV_FEAT2_CHANNEL_LOAD(channel_load.getAdvertPercent()));
 
+  if (allow_refresh) return createSelfAdvertPacket(app_data, app_data_len);   // (short form, if nothing changed)
   return createAdvert(self_id, app_data, app_data_len);
 }
 
-File MyMesh::openAppend(const char *fname) {
-#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
-  return _fs->open(fname, FILE_O_WRITE);
-#elif defined(RP2040_PLATFORM)
-  return _fs->open(fname, "a");
+bool MyMesh::needsLongPreamble(const mesh::Packet *packet) {
+#if MAX_NEIGHBOURS
+  uint32_t now = getRTCClock()->getCurrentTime();
+  for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+    auto n = &neighbours[i];
+    if (n->heard_timestamp == 0 || !n->low_power_rx || now - n->heard_timestamp >= NEIGHBOUR_ACTIVE_SECS) continue;
+
+    // a flood may be heard by any neighbour, and a zero-hop direct is for one we can't tell
+    if (packet->isRouteFlood() || packet->path_len == 0 || n->id.isHashMatch(packet->path)) return true;
+  }
+#endif
+  return false;
+}
+
+void MyMesh::applyRadioParams() {
+  float freq = _prefs.freq;
+  if (channel_plan.isEnabled()) {
+    rx_channel = channel_plan.getActive(home_channel, getRTCClock()->getCurrentTime());
+    freq = channel_plan.getFreq(rx_channel);
+  }
+  radio_set_params(freq, _prefs.bw, _prefs.sf, _prefs.cr);
+}
+
+uint32_t MyMesh::getExtraTxChannels(const mesh::Packet *packet) {
+  if (!channel_plan.isEnabled()) return 0;
+
+  uint32_t mask = 0;
+  if (packet->getPayloadType() == PAYLOAD_TYPE_ADVERT && packet->path_len == 0) {
+    mask = channel_plan.getAllMask();   // our own advert, so neighbours on every channel can find us
+  } else if (packet->isRouteFlood()) {
+#if MAX_NEIGHBOURS
+    uint32_t now = getRTCClock()->getCurrentTime();
+    for (int i = 0; i < MAX_NEIGHBOURS; i++) {   // bridge the flood to channels which have neighbours
+      auto n = &neighbours[i];
+      if (n->heard_timestamp == 0 || n->home_channel < 0 || now - n->heard_timestamp >= NEIGHBOUR_ACTIVE_SECS) continue;
+      mask |= 1UL << n->home_channel;
+    }
+#endif
+  }
+  return mask & channel_plan.getAllMask() & ~(1UL << home_channel);
+}
+
+float MyMesh::getTxFrequencyFor(const mesh::Packet *packet) {
+  if (!channel_plan.isEnabled()) return 0;
+
+  int target = -1;
+  if (packet->_tx_channel) {
+    target = packet->_tx_channel - 1;   // copy for another channel
+  } else if (packet->isRouteDirect() && packet->path_len > 0) {
+#if MAX_NEIGHBOURS
+    for (int i = 0; i < MAX_NEIGHBOURS; i++) {   // the channel next hop listens on
+      auto n = &neighbours[i];
+      if (n->heard_timestamp > 0 && n->home_channel >= 0 && n->id.isHashMatch(packet->path)) {
+        target = n->home_channel;
+        break;
+      }
+    }
+#endif
+  }
+  if (target < 0 || target == home_channel) return 0;   // on our own
+
+  return channel_plan.getFreq(channel_plan.getActive(target, getRTCClock()->getCurrentTime()));
+}
+
+int8_t MyMesh::getTxPowerFor(const mesh::Packet *packet) {
+#if TX_POWER_ADAPTIVE && MAX_NEIGHBOURS
+  int power = _prefs.tx_power_dbm;
+  if (packet->isRouteDirect() && packet->path_len > 0 && packet->getPayloadType() != PAYLOAD_TYPE_TRACE) {
+    uint32_t now = getRTCClock()->getCurrentTime();
+    for (int i = 0; i < MAX_NEIGHBOURS; i++) {   // next hop
+      auto n = &neighbours[i];
+      if (n->heard_timestamp == 0 || !n->id.isHashMatch(packet->path, packet->path_hash_size)) continue;
+      if (n->heard_count < 3 || now - n->heard_timestamp >= NEIGHBOUR_ACTIVE_SECS) break;   // not enough to go on
+
+      int snr4 = n->snr_avg;   // as we hear them (assumes link is symmetric)
+      if (n->link_snr_out != 127 && n->link_snr_out < snr4) snr4 = n->link_snr_out;   // as they heard us, in last sweep
+      int excess = (int) (snr4 / 4.0f - _radio->getMinSNR()) - TX_POWER_LINK_MARGIN_DB;
+      if (excess > 0) {
+        power -= excess;
+        if (power < TX_POWER_MIN_DBM) power = TX_POWER_MIN_DBM < _prefs.tx_power_dbm ? TX_POWER_MIN_DBM : _prefs.tx_power_dbm;
+      }
+      break;
+    }
+  }
+  return power;   // (everything else at the configured power)
 #else
-  return _fs->open(fname, "a", true);
+  return 0;
 #endif
 }
 
 bool MyMesh::allowPacketForward(const mesh::Packet *packet) {
   if (_prefs.disable_fwd) return false;
-  if (packet->isRouteFlood() && packet->path_len >= _prefs.flood_max) return false;
   if (packet->isRouteFlood() && recv_pkt_region == NULL) {
     MESH_DEBUG_PRINTLN("allowPacketForward: unknown transport code, or wildcard not allowed for FLOOD packet");
     return false;
   }
+#if ADAPTIVE_FLOOD_DENSITY
+  if (packet->isRouteFlood() && flood_density.shouldSkip(packet, getRNG())) {
+    MESH_DEBUG_PRINTLN("allowPacketForward: dense mesh, skipping re-broadcast");
+    return false;
+  }
+#endif
+  if (!source_limiter.allow(packet, millis())) {
+    MESH_DEBUG_PRINTLN("allowPacketForward: source 0x%02X over rate limit", (uint32_t) SourceRateLimiter::getSourceKey(packet));
+    return false;
+  }
   return true;
 }
 
+uint8_t MyMesh::getFloodSuppressCount(const mesh::Packet *queued) const {
+#if RELAY_SELECT_PERCENT > 0
+  if (queued->getSNR() >= RELAY_SELECT_SNR) {
+    // sender is close, so our re-broadcast adds little coverage. Some of the time, (a stable pick per packet, which
+    // differs between nodes) cancel it as soon as any other copy is heard. Still sent if none is, within our delay.
+    uint8_t fp[MAX_HASH_SIZE];
+    queued->calculateFingerprint(fp);
+    if (((fp[0] ^ self_id.pub_key[1]) * 100 >> 8) < RELAY_SELECT_PERCENT) return 1;
+  }
+#endif
+  return FLOOD_SUPPRESS_COUNT;
+}
+
+uint8_t MyMesh::getFloodHopLimit(const mesh::Packet *packet) {
+  uint16_t region_id = recv_pkt_region ? recv_pkt_region->id : 0;
+  uint8_t max_hops = flood_policy.getMaxHops(packet, region_id, _prefs.flood_max);
+  if (max_hops > _prefs.flood_max) max_hops = _prefs.flood_max;   // flood.max is still the overall limit
+  return channel_load.scaleHopLimit(max_hops, millis());   // and is cut back when the channel is congested
+}
+
 const char *MyMesh::getLogDateTime() {
   static char tmp[32];
   uint32_t now = getRTCClock()->getCurrentTime();
@@ -330,6 +861,7 @@ const char *MyMesh::getLogDateTime() {
 }
 
 void MyMesh::logRxRaw(float snr, float rssi, const uint8_t raw[], int len) {
+  capture.add(snr, rssi, raw, len, getRTCClock()->getCurrentTime(), millis());
 #if MESH_PACKET_LOGGING
   Serial.print(getLogDateTime());
   Serial.print(" RAW: ");
@@ -338,80 +870,100 @@ void MyMesh::logRxRaw(float snr, float rssi, const uint8_t raw[], int len) {
 #endif
 }
 
+#ifdef WITH_BRIDGE
+void MyMesh::sendToBridge(mesh::Packet *pkt) {
+  uint16_t region_id = FLOOD_RULE_ANY_REGION;   // ie. only matches rules for 'any' region
+  if (pkt->getRouteType() == ROUTE_TYPE_TRANSPORT_FLOOD) {
+    auto region = region_map.findMatch(pkt, 0);
+    if (region) region_id = region->id;
+  } else if (pkt->getRouteType() == ROUTE_TYPE_FLOOD) {
+    region_id = region_map.getWildcard().id;
+  }
+  if (bridge_filter.allow(pkt, region_id, millis())) {
+    bridge.sendPacket(pkt);
+  }
+}
+#endif
+
 void MyMesh::logRx(mesh::Packet *pkt, int len, float score) {
+  advert_sched.onAdvertHeard(pkt, _ms->getMillis());
+
 #ifdef WITH_BRIDGE
+  bridge.onRadioRecv(pkt);   // for arrival offset, vs bridged copies
   if (_prefs.bridge_pkt_src == 1) {
-    bridge.sendPacket(pkt);
+    sendToBridge(pkt);
   }
 #endif
 
   if (_logging) {
-    File f = openAppend(PACKET_LOG_FILE);
-    if (f) {
-      f.print(getLogDateTime());
-      f.printf(": RX, len=%d (type=%d, route=%s, payload_len=%d) SNR=%d RSSI=%d score=%d", len,
-               pkt->getPayloadType(), pkt->isRouteDirect() ? "D" : "F", pkt->payload_len,
-               (int)_radio->getLastSNR(), (int)_radio->getLastRSSI(), (int)(score * 1000));
-
-      if (pkt->getPayloadType() == PAYLOAD_TYPE_PATH || pkt->getPayloadType() == PAYLOAD_TYPE_REQ ||
-          pkt->getPayloadType() == PAYLOAD_TYPE_RESPONSE || pkt->getPayloadType() == PAYLOAD_TYPE_TXT_MSG) {
-        f.printf(" [%02X -> %02X]\n", (uint32_t)pkt->payload[1], (uint32_t)pkt->payload[0]);
-      } else {
-        f.printf("\n");
-      }
-      f.close();
-    }
+    packet_log.logRx(pkt, len, _radio->getLastSNR(), _radio->getLastRSSI(), score, getRTCClock()->getCurrentTime());
   }
 }
 
 void MyMesh::logTx(mesh::Packet *pkt, int len) {
 #ifdef WITH_BRIDGE
   if (_prefs.bridge_pkt_src == 0) {
-    bridge.sendPacket(pkt);
+    sendToBridge(pkt);
   }
 #endif
 
   if (_logging) {
-    File f = openAppend(PACKET_LOG_FILE);
-    if (f) {
-      f.print(getLogDateTime());
-      f.printf(": TX, len=%d (type=%d, route=%s, payload_len=%d)", len, pkt->getPayloadType(),
-               pkt->isRouteDirect() ? "D" : "F", pkt->payload_len);
-
-      if (pkt->getPayloadType() == PAYLOAD_TYPE_PATH || pkt->getPayloadType() == PAYLOAD_TYPE_REQ ||
-          pkt->getPayloadType() == PAYLOAD_TYPE_RESPONSE || pkt->getPayloadType() == PAYLOAD_TYPE_TXT_MSG) {
-        f.printf(" [%02X -> %02X]\n", (uint32_t)pkt->payload[1], (uint32_t)pkt->payload[0]);
-      } else {
-        f.printf("\n");
-      }
-      f.close();
-    }
+    packet_log.logTx(pkt, len, getRTCClock()->getCurrentTime());
   }
 }
 
 void MyMesh::logTxFail(mesh::Packet *pkt, int len) {
   if (_logging) {
-    File f = openAppend(PACKET_LOG_FILE);
-    if (f) {
-      f.print(getLogDateTime());
-      f.printf(": TX FAIL!, len=%d (type=%d, route=%s, payload_len=%d)\n", len, pkt->getPayloadType(),
-               pkt->isRouteDirect() ? "D" : "F", pkt->payload_len);
-      f.close();
-    }
+    packet_log.logTxFail(pkt, len, getRTCClock()->getCurrentTime());
   }
 }
 
-int MyMesh::calcRxDelay(float score, uint32_t air_time) const {
-  if (_prefs.rx_delay_base <= 0.0f) return 0;
-  return (int)((pow(_prefs.rx_delay_base, 0.85f - score) - 1.0) * air_time);
+float MyMesh::getRxDelayBase() const {
+  return _prefs.rx_delay_base;
+}
+
+bool MyMesh::isBackbonePeer(uint8_t hash) const {
+  for (int i = 0; i < _prefs.num_backbone_peers; i++) {
+    if (_prefs.backbone_peers[i] == hash) return true;
+  }
+  return false;
+}
+
+// Backbone repeaters are all configured with the same list (each minus itself), so all the ones which hear a packet
+// from 'peer_hash' agree on an order for forwarding it: by hash, leaving out the sender. Each then sends in its
+// own fixed slot, instead of contending with random delays.
+int MyMesh::getBackboneDelay(const mesh::Packet* packet, uint8_t peer_hash) {
+  if (!isBackbonePeer(peer_hash)) return -1;   // not backbone traffic
+
+  uint8_t self_hash = self_id.pub_key[0];
+  int slot = 0;
+  for (int i = 0; i < _prefs.num_backbone_peers; i++) {
+    uint8_t h = _prefs.backbone_peers[i];
+    if (h != peer_hash && h < self_hash) slot++;
+  }
+  uint32_t slot_millis = _radio->getEstAirtimeFor(packet->path_len + packet->payload_len + 2) + BACKBONE_SLOT_GUARD_MILLIS;
+  return slot * slot_millis;
 }
 
 uint32_t MyMesh::getRetransmitDelay(const mesh::Packet *packet) {
+  if (packet->isRouteFlood() && packet->path_len >= 2*packet->path_hash_size) {   // (path now ends with our hash)
+    int d = getBackboneDelay(packet, packet->path[packet->path_len - 2*packet->path_hash_size]);
+    if (d >= 0) return d;
+  }
   uint32_t t = (_radio->getEstAirtimeFor(packet->path_len + packet->payload_len + 2) * _prefs.tx_delay_factor);
+#if ADAPTIVE_FLOOD_DENSITY
+  t = flood_density.scaleDelay(t);   // wider window when more neighbours will be contending
+#endif
+  t = channel_load.scaleDelay(t, millis());
   return getRNG()->nextInt(0, 5*t + 1);
 }
 uint32_t MyMesh::getDirectRetransmitDelay(const mesh::Packet *packet) {
+  if (packet->path_len >= packet->path_hash_size) {   // next hop is a backbone peer, so is a backbone link
+    int d = getBackboneDelay(packet, packet->path[0]);
+    if (d >= 0) return d;
+  }
   uint32_t t = (_radio->getEstAirtimeFor(packet->path_len + packet->payload_len + 2) * _prefs.direct_tx_delay_factor);
+  t = channel_load.scaleDelay(t, millis());
   return getRNG()->nextInt(0, 5*t + 1);
 }
 
@@ -453,7 +1005,7 @@ void MyMesh::onAnonDataRecv(mesh::Packet *packet, const uint8_t *secret, const m
 
     if (packet->isRouteFlood()) {
       // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the response
-      mesh::Packet* path = createPathReturn(sender, secret, packet->path, packet->path_len,
+      mesh::Packet* path = createPathReturn(sender, secret, packet->path, packet->getEncodedPathLen(),
                                             PAYLOAD_TYPE_RESPONSE, reply_data, reply_len);
       if (path) sendFlood(path, SERVER_RESPONSE_DELAY);
     } else {
@@ -464,6 +1016,7 @@ void MyMesh::onAnonDataRecv(mesh::Packet *packet, const uint8_t *secret, const m
 }
 
 int MyMesh::searchPeersByHash(const uint8_t *hash) {
+  acl.pageInByHash(hash, PATH_HASH_SIZE);   // any dormant clients with this hash (NOTE: may evict others)
   int n = 0;
   for (int i = 0; i < acl.getNumClients(); i++) {
     if (acl.getClientByIdx(i)->id.isHashMatch(hash)) {
@@ -494,15 +1047,28 @@ void MyMesh::onAdvertRecv(mesh::Packet *packet, const mesh::Identity &id, uint32
                           const uint8_t *app_data, size_t app_data_len) {
   mesh::Mesh::onAdvertRecv(packet, id, timestamp, app_data, app_data_len); // chain to super impl
 
+  AdvertDataParser parser(app_data, app_data_len);
+  if (parser.isValid()) {
+    peer_caps.update(id.pub_key, (parser.hasNetCoding() ? PEER_CAP_NET_CODING : 0)   // who can decode CODED frames
+                               | (parser.hasBundle() ? PEER_CAP_BUNDLE : 0));       // ... and unpack BUNDLE frames
+  }
+
   // if this a zero hop advert (and not via 'Share'), add it to neighbours
   if (packet->path_len == 0 && !isShare(packet)) {
-    AdvertDataParser parser(app_data, app_data_len);
     if (parser.isValid() && parser.getType() == ADV_TYPE_REPEATER) { // just keep neigbouring Repeaters
-      putNeighbour(id, timestamp, packet->getSNR());
+      putNeighbour(id, timestamp, packet->getSNR(), parser.isLowPowerRx(), parser.getHomeChannel());
+      channel_load.onPeerLoad(parser.getChannelLoad(), millis());
     }
   }
 }
 
+void MyMesh::onAdvertRefreshRecv(mesh::Packet *packet, const mesh::Identity &id, uint32_t timestamp) {
+#if MAX_NEIGHBOURS
+  NeighbourInfo* n = packet->path_len == 0 && !isShare(packet) ? findNeighbour(id.pub_key) : NULL;
+  if (n) putNeighbour(id, timestamp, packet->getSNR(), n->low_power_rx, n->home_channel);   // (unchanged since full advert)
+#endif
+}
+
 void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx, const uint8_t *secret,
                             uint8_t *data, size_t len) {
   int i = matching_peer_indexes[sender_idx];
@@ -512,12 +1078,13 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
   }
   ClientInfo* client = acl.getClientByIdx(i);
 
-  if (type == PAYLOAD_TYPE_REQ) { // request (from a Known admin client!)
-    uint32_t timestamp;
-    memcpy(&timestamp, data, 4);
+  mesh::RequestView req;
+  if (type == PAYLOAD_TYPE_REQ && req.init(data, len)) { // request (from a Known admin client!)
+    uint32_t timestamp = req.timestamp();
 
     if (timestamp > client->last_timestamp) { // prevent replay attacks
-      int reply_len = handleRequest(client, timestamp, &data[4], len - 4);
+      int reply_len = req.type() == REQ_TYPE_RESUME_LOGIN ? handleResumeReq(client, req.request(), req.requestLen(), packet->isRouteFlood())
+                                                          : handleRequest(client, timestamp, req.request(), req.requestLen());
       if (reply_len == 0) return; // invalid command
 
       client->last_timestamp = timestamp;
@@ -525,7 +1092,7 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
 
       if (packet->isRouteFlood()) {
         // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the response
-        mesh::Packet *path = createPathReturn(client->id, secret, packet->path, packet->path_len,
+        mesh::Packet *path = createPathReturn(client->id, secret, packet->path, packet->getEncodedPathLen(),
                                               PAYLOAD_TYPE_RESPONSE, reply_data, reply_len);
         if (path) sendFlood(path, SERVER_RESPONSE_DELAY);
       } else {
@@ -546,17 +1113,21 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
     uint32_t sender_timestamp;
     memcpy(&sender_timestamp, data, 4); // timestamp (by sender's RTC clock - which could be wrong)
     uint8_t flags = (data[4] >> 2);        // message attempt number, and other flags
+    bool compressed = (flags & TXT_TYPE_COMPRESSED) != 0;
+    flags &= ~TXT_TYPE_COMPRESSED;
 
-    if (!(flags == TXT_TYPE_PLAIN || flags == TXT_TYPE_CLI_DATA)) {
+    // len can be > original length, but 'text' will be padded with zeroes
+    data[len] = 0; // need to make a C string again, with null terminator
+    char text_buf[TXT_CODEC_MAX_TEXT+1];
+    char *command = TxtCodec::unpack((char *)&data[5], compressed, text_buf, sizeof(text_buf));
+
+    if (!(flags == TXT_TYPE_PLAIN || flags == TXT_TYPE_CLI_DATA) || command == NULL) {
       MESH_DEBUG_PRINTLN("onPeerDataRecv: unsupported text type received: flags=%02x", (uint32_t)flags);
     } else if (sender_timestamp >= client->last_timestamp) { // prevent replay attacks
       bool is_retry = (sender_timestamp == client->last_timestamp);
       client->last_timestamp = sender_timestamp;
       client->last_activity = getRTCClock()->getCurrentTime();
 
-      // len can be > original length, but 'text' will be padded with zeroes
-      data[len] = 0; // need to make a C string again, with null terminator
-
       if (flags == TXT_TYPE_PLAIN) { // for legacy CLI, send Acks
         uint32_t ack_hash; // calc truncated hash of the message timestamp + text + sender pub_key, to prove
                            // to sender that we got it
@@ -566,15 +1137,14 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
         mesh::Packet *ack = createAck(ack_hash);
         if (ack) {
           if (client->out_path_len < 0) {
-            sendFlood(ack, TXT_ACK_DELAY);
+            sendFlood(ack, getAckDelay(packet, TXT_ACK_DELAY));
           } else {
-            sendDirect(ack, client->out_path, client->out_path_len, TXT_ACK_DELAY);
+            sendDirect(ack, client->out_path, client->out_path_len, getAckDelay(packet, TXT_ACK_DELAY));
           }
         }
       }
 
       uint8_t temp[166];
-      char *command = (char *)&data[5];
       char *reply = (char *)&temp[5];
       if (is_retry) {
         *reply = 0;
@@ -615,7 +1185,8 @@ bool MyMesh::onPeerPathRecv(mesh::Packet *packet, int sender_idx, const uint8_t
     MESH_DEBUG_PRINTLN("PATH to client, path_len=%d", (uint32_t)path_len);
     auto client = acl.getClientByIdx(i);
 
-    memcpy(client->out_path, path, client->out_path_len = path_len); // store a copy of path, for sendDirect()
+    memcpy(client->out_path, path, mesh::Packet::decodePathBytes(path_len)); // store a copy of path, for sendDirect()
+    client->out_path_len = path_len;
     client->last_activity = getRTCClock()->getCurrentTime();
   } else {
     MESH_DEBUG_PRINTLN("onPeerPathRecv: invalid peer idx: %d", i);
@@ -655,30 +1226,106 @@ void MyMesh::onControlDataRecv(mesh::Packet* packet) {
       }
     }
   }
+#ifdef WITH_MESH_OTA
+  else if (type == CTL_TYPE_FW_OFFER && packet->payload_len >= 1 + FW_MANIFEST_LEN) {
+    const uint8_t* manifest = &packet->payload[1];
+    if (fw_xfer.isNewOffer(manifest) && isTrustedFirmware(manifest)) {
+      fw_xfer.onOfferRecv(manifest);
+    }
+  } else if (type == CTL_TYPE_FW_NEED) {
+    fw_xfer.onNeedRecv(packet->payload, packet->payload_len, millis());
+  } else if (type == CTL_TYPE_FW_CHUNK) {
+    fw_xfer.onChunkRecv(packet->payload, packet->payload_len, millis());
+  }
+#endif
+}
+
+#ifdef WITH_MESH_OTA
+bool MyMesh::isTrustedFirmware(const uint8_t* manifest) {
+  // must be signed by one of our admins
+  auto signer = acl.getClient(&manifest[FW_MANIFEST_SIGNED_LEN], PUB_KEY_SIZE);
+  return signer && signer->isAdmin() && FirmwareXfer::isSigned(manifest);
+}
+
+void MyMesh::checkFirmwareSend() {
+  fw_xfer.loop(millis());
+
+  if (millisHasNowPassed(next_fw_send)) {
+    uint8_t data[MAX_PACKET_PAYLOAD];
+    int len = fw_xfer.nextFrame(data, millis());
+    if (len > 0) {
+      auto pkt = createControlData(data, len);
+      if (pkt) {
+        uint32_t d = getRetransmitDelay(pkt);   // random delay, as neighbours may be answering the same NEED
+        uint32_t air_time = _radio->getEstAirtimeFor(pkt->getRawLength());
+        sendZeroHop(pkt, d, QOS_BULK);
+        next_fw_send = futureMillis(d + air_time * FW_SEND_AIRTIME_FACTOR);
+      }
+    }
+  }
+}
+
+void MyMesh::handleFirmwareCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  // format:  fw [apply|stop]
+  const char* sub = &command[2];
+  while (*sub == ' ') sub++;
+
+  if (strcmp(sub, "apply") == 0) {
+    strcpy(reply, fw_xfer.apply() ? "OK - reboot to run new firmware" : "Err - no verified image staged");
+  } else if (strcmp(sub, "stop") == 0) {
+    fw_xfer.stop();
+    strcpy(reply, "OK");
+  } else {
+    fw_xfer.formatStatus(reply);
+  }
 }
+#endif
 
 MyMesh::MyMesh(mesh::MainBoard &board, mesh::Radio &radio, mesh::MillisecondClock &ms, mesh::RNG &rng,
                mesh::RTCClock &rtc, mesh::MeshTables &tables)
-    : mesh::Mesh(radio, ms, rng, rtc, *new StaticPoolPacketManager(32), tables),
-      _cli(board, rtc, sensors, &_prefs, this), telemetry(MAX_PACKET_PAYLOAD - 4), region_map(key_store), temp_map(key_store),
-      discover_limiter(4, 120)  // max 4 every 2 minutes
+#ifdef WITH_ESPNOW_BRIDGE
+    : mesh::Mesh(radio, ms, rng, rtc, *new ConcurrentPacketManager(PACKET_POOL_SIZE), tables),   // bridge receives in the Wi-Fi task
+#else
+    : mesh::Mesh(radio, ms, rng, rtc, *new ScheduledPacketManager(PACKET_POOL_SIZE, PACKET_SLAB_SMALL_SLOTS, PACKET_SLAB_MEDIUM_SLOTS), tables),
+#endif
+      _cli(board, rtc, sensors, &_prefs, this), telemetry(), region_map(key_store), temp_map(key_store),
+      discover_limiter(4, 120),  // max 4 every 2 minutes
+      source_limiter(SOURCE_RATE_PER_MIN, SOURCE_RATE_BURST)
+#ifdef WITH_MESH_OTA
+      , fw_xfer(board)
+#endif
 #if defined(WITH_RS232_BRIDGE)
-      , bridge(&_prefs, WITH_RS232_BRIDGE, _mgr, &rtc)
+      , bridge(&_prefs, WITH_RS232_BRIDGE, _mgr, &rtc, (SimpleMeshTables *)&tables)
 #endif
-#if defined(WITH_ESPNOW_BRIDGE)
-      , bridge(&_prefs, _mgr, &rtc)
+#if defined(WITH_ESPNOW_BRIDGE) || defined(WITH_UDP_BRIDGE)
+      , bridge(&_prefs, _mgr, &rtc, (SimpleMeshTables *)&tables)
 #endif
 {
   last_millis = 0;
   uptime_millis = 0;
   next_local_advert = next_flood_advert = 0;
   dirty_contacts_expiry = 0;
+  next_tables_save = 0;
+  next_warm_save = 0;
+  next_density_update = 0;
+#if MAX_NEIGHBOURS
+  link_probe_tag = 0;
+  link_probe_timeout = next_link_probe = 0;
+  link_sweep_idx = 0;
+#endif
+#ifdef WITH_MESH_OTA
+  next_fw_send = 0;
+#endif
   set_radio_at = revert_radio_at = 0;
   _logging = false;
   region_load_active = false;
+  low_power_rx = false;
+  woke_from_sleep = false;
+  home_channel = rx_channel = 0;
 
+  memset(stats_subs, 0, sizeof(stats_subs));
 #if MAX_NEIGHBOURS
-  memset(neighbours, 0, sizeof(neighbours));
+  clearNeighbours();
 #endif
 
   // defaults
@@ -700,6 +1347,10 @@ MyMesh::MyMesh(mesh::MainBoard &board, mesh::Radio &radio, mesh::MillisecondCloc
   _prefs.flood_advert_interval = 12; // 12 hours
   _prefs.flood_max = 64;
   _prefs.interference_threshold = 0; // disabled
+  _prefs.qos_aging = 2000;   // relayed floods queue up here, so let them catch up sooner
+  _prefs.net_coding = 0;     // off, until enough of the mesh decodes CODED frames
+  setCodingStore(&coding_store);
+  setPeerCaps(&peer_caps);
 
   // bridge defaults
   _prefs.bridge_enabled = 1;    // enabled
@@ -718,14 +1369,48 @@ MyMesh::MyMesh(mesh::MainBoard &board, mesh::Radio &radio, mesh::MillisecondCloc
   _prefs.adc_multiplier = 0.0f; // 0.0f means use default board multiplier
 }
 
+void MyMesh::attachSecondRadio(mesh::Radio& radio, mesh::MillisecondClock& ms) {
+  auto port = new RadioPort(radio, ms, *new ScheduledPacketManager(SECOND_RADIO_QUEUE_SIZE, *_mgr), &_prefs.airtime_factor);
+  attachPort(*port);
+}
+
 void MyMesh::begin(FILESYSTEM *fs) {
   mesh::Mesh::begin();
   _fs = fs;
+  flash_writer.begin();   // saves are written behind, from here on
+  packet_log.begin(fs);
+  {
+    int num;
+    const MemTable* tables = getMemTables(num);
+    MemoryStats::debugPrint(tables, num);
+  }
   // load persisted prefs
   _cli.loadPrefs(_fs);
+  _cli.addCommand("setperm", CLICommandTable::method<MyMesh, &MyMesh::handleSetPermCmd>, this, CLI_HAS_PARAMS);
+  _cli.addCommand("region", CLICommandTable::method<MyMesh, &MyMesh::handleRegionCmd>, this);
+  _cli.addCommand("flood.policy", CLICommandTable::method<MyMesh, &MyMesh::handleFloodPolicyCmd>, this);
+#ifdef WITH_BRIDGE
+  _cli.addCommand("bridge.filter", CLICommandTable::method<MyMesh, &MyMesh::handleBridgeFilterCmd>, this);
+#endif
+#ifdef WITH_MESH_OTA
+  _cli.addCommand("fw", CLICommandTable::method<MyMesh, &MyMesh::handleFirmwareCmd>, this);
+  fw_xfer.begin("repeater", FirmwareXfer::parseVersion(FIRMWARE_VERSION));
+#endif
   acl.load(_fs);
   // TODO: key_store.begin();
   region_map.load(_fs);
+  flood_policy.load(_fs);
+#ifdef WITH_BRIDGE
+  bridge_filter.load(_fs);
+#endif
+  ((RepeaterTables *)getTables())->setRadio(_radio);   // to estimate airtime of duplicates
+#ifndef DEDUP_WINDOW_SECS
+  ((SimpleMeshTables *)getTables())->load(_fs, TABLES_SNAPSHOT_FILE);   // so in-flight packets aren't re-forwarded after restart
+  next_tables_save = futureMillis(TABLES_SAVE_INTERVAL_SECS * 1000);
+#endif
+#if MAX_NEIGHBOURS
+  next_link_probe = futureMillis(LINK_SWEEP_START_MILLIS);
+#endif
 
 #if defined(WITH_BRIDGE)
   if (_prefs.bridge_enabled) {
@@ -733,9 +1418,14 @@ void MyMesh::begin(FILESYSTEM *fs) {
   }
 #endif
 
-  radio_set_params(_prefs.freq, _prefs.bw, _prefs.sf, _prefs.cr);
+  channel_plan.set(_prefs.freq, CHANNEL_PLAN_SPACING_KHZ, CHANNEL_PLAN_NUM, CHANNEL_PLAN_HOP_SECS);
+  home_channel = CHANNEL_PLAN_HOME >= 0 ? CHANNEL_PLAN_HOME % channel_plan.getNumChannels() : channel_plan.homeFor(self_id.pub_key);
+  applyRadioParams();
   radio_set_tx_power(_prefs.tx_power_dbm);
 
+  airtime_budget.begin(_ms->getMillis(), DUTY_CYCLE_WINDOW_SECS, DUTY_CYCLE_PERCENT);
+
+  advert_sched.begin(self_id.pub_key);
   updateAdvertTimer();
   updateFloodAdvertTimer();
 
@@ -743,9 +1433,126 @@ void MyMesh::begin(FILESYSTEM *fs) {
 
 #if ENV_INCLUDE_GPS == 1
   applyGpsPrefs();
+#endif
+  restoreSleepState();
+  restoreWarmState();
+}
+
+void MyMesh::restoreSleepState() {
+#if defined(ESP32) && RX_SLEEP_IDLE_MILLIS
+  RxSleepState* s = &rx_sleep_state;
+  if (s->magic != RX_SLEEP_MAGIC) return;   // cold start (or reset)
+  s->magic = 0;    // only restore once
+
+  uint32_t slept = getRTCClock()->getCurrentTime() - s->sleep_time;
+#ifndef DEDUP_WINDOW_SECS
+  ((SimpleMeshTables *)getTables())->restoreFrom(s->tables);
+#endif
+#if MAX_NEIGHBOURS
+  memcpy(neighbours, s->neighbours, sizeof(neighbours));
+  memcpy(neighbour_buckets, s->neighbour_buckets, sizeof(neighbour_buckets));
+#endif
+  if (s->local_advert_secs) {
+    next_local_advert = futureMillis(s->local_advert_secs > slept ? (s->local_advert_secs - slept) * 1000 : 1);
+  }
+  if (s->flood_advert_secs) {
+    next_flood_advert = futureMillis(s->flood_advert_secs > slept ? (s->flood_advert_secs - slept) * 1000 : 1);
+  }
+  uptime_millis = s->uptime_millis + (uint64_t)slept * 1000;
+  woke_from_sleep = true;
+  MESH_DEBUG_PRINTLN("woke from Rx sleep, after %u secs", slept);
+#endif
+}
+
+void MyMesh::restoreWarmState() {
+#ifdef WITH_WARM_RESTART
+  next_warm_save = futureMillis(WARM_RESTART_SAVE_MILLIS);
+  if (!warm_state.isValid() || woke_from_sleep) {   // power-on (or sleep state is newer)
+    warm_state.restarts = 0;
+    return;
+  }
+  warm_state.invalidate();   // only restore once, in case the state itself is what crashes us
+  WarmState* s = &warm_state.data;
+  warm_state.restarts++;
+
+#ifndef DEDUP_WINDOW_SECS
+  ((SimpleMeshTables *)getTables())->restoreFrom(s->tables);   // (fresher than the TABLES_SNAPSHOT_FILE)
+#endif
+#if MAX_NEIGHBOURS
+  memcpy(neighbours, s->neighbours, sizeof(neighbours));
+  memcpy(neighbour_buckets, s->neighbour_buckets, sizeof(neighbour_buckets));
+#endif
+  setCounters(s->counters);
+  uint32_t now = getRTCClock()->getCurrentTime();
+  uptime_millis = s->uptime_millis + (now > s->rtc_time ? (uint64_t)(now - s->rtc_time) * 1000 : 0);
+  MESH_DEBUG_PRINTLN("warm restart #%u, state from %u secs ago", warm_state.restarts, now - s->rtc_time);
 #endif
 }
 
+void MyMesh::saveWarmState() {
+#ifdef WITH_WARM_RESTART
+  WarmState* s = &warm_state.data;
+  s->rtc_time = getRTCClock()->getCurrentTime();
+  s->uptime_millis = uptime_millis + (millis() - last_millis);
+  getCounters(s->counters);
+#ifndef DEDUP_WINDOW_SECS
+  ((SimpleMeshTables *)getTables())->saveTo(s->tables);
+#endif
+#if MAX_NEIGHBOURS
+  memcpy(s->neighbours, neighbours, sizeof(neighbours));
+  memcpy(s->neighbour_buckets, neighbour_buckets, sizeof(neighbour_buckets));
+#endif
+  warm_state.commit();
+#endif
+}
+
+bool MyMesh::enterRxSleep() {
+#if defined(ESP32) && RX_SLEEP_IDLE_MILLIS && !defined(WITH_BRIDGE)
+  if (!isIdle() || set_radio_at || revert_radio_at) return false;
+  for (int i = 0; i < STATS_PUSH_MAX_SUBS; i++) {
+    if (stats_subs[i].interval_mins) return false;   // pushes are timed by millis(), so stay awake
+  }
+
+  unsigned long now = millis();
+  uint32_t secs = RX_SLEEP_MAX_SECS;
+  uint32_t local_secs = 0, flood_secs = 0;
+  if (next_local_advert) {
+    local_secs = (long)(next_local_advert - now) > 0 ? (next_local_advert - now) / 1000 : 0;
+    if (local_secs < secs) secs = local_secs;
+  }
+  if (next_flood_advert) {
+    flood_secs = (long)(next_flood_advert - now) > 0 ? (next_flood_advert - now) / 1000 : 0;
+    if (flood_secs < secs) secs = flood_secs;
+  }
+  if (secs == 0) return false;   // advert is due
+
+  if (dirty_contacts_expiry) {
+    acl.save(_fs);
+    dirty_contacts_expiry = 0;
+  }
+  flash_writer.flush();
+
+  RxSleepState* s = &rx_sleep_state;
+  s->sleep_time = getRTCClock()->getCurrentTime();
+  s->local_advert_secs = next_local_advert ? (local_secs > 0 ? local_secs : 1) : 0;
+  s->flood_advert_secs = next_flood_advert ? (flood_secs > 0 ? flood_secs : 1) : 0;
+  s->uptime_millis = uptime_millis + (now - last_millis);
+#ifndef DEDUP_WINDOW_SECS
+  ((SimpleMeshTables *)getTables())->saveTo(s->tables);
+#endif
+#if MAX_NEIGHBOURS
+  memcpy(s->neighbours, neighbours, sizeof(neighbours));
+  memcpy(s->neighbour_buckets, neighbour_buckets, sizeof(neighbour_buckets));
+#endif
+  s->magic = RX_SLEEP_MAGIC;
+
+  MESH_DEBUG_PRINTLN("entering Rx sleep, for up to %u secs", secs);
+  board.enterRxSleep(secs);   // doesn't return, if supported
+  s->magic = 0;
+#endif
+  return false;
+}
+
 void MyMesh::applyTempRadioParams(float freq, float bw, uint8_t sf, uint8_t cr, int timeout_mins) {
   set_radio_at = futureMillis(2000); // give CLI reply some time to be sent back, before applying temp radio params
   pending_freq = freq;
@@ -780,7 +1587,8 @@ void MyMesh::sendSelfAdvertisement(int delay_millis) {
 
 void MyMesh::updateAdvertTimer() {
   if (_prefs.advert_interval > 0) { // schedule local advert timer
-    next_local_advert = futureMillis(((uint32_t)_prefs.advert_interval) * 2 * 60 * 1000);
+    uint32_t interval = channel_load.scaleInterval(((uint32_t)_prefs.advert_interval) * 2 * 60 * 1000, millis());   // less often when congested
+    next_local_advert = futureMillis(advert_sched.jitterInterval(interval));
   } else {
     next_local_advert = 0; // stop the timer
   }
@@ -788,26 +1596,15 @@ void MyMesh::updateAdvertTimer() {
 
 void MyMesh::updateFloodAdvertTimer() {
   if (_prefs.flood_advert_interval > 0) { // schedule flood advert timer
-    next_flood_advert = futureMillis(((uint32_t)_prefs.flood_advert_interval) * 60 * 60 * 1000);
+    uint32_t interval = channel_load.scaleInterval(((uint32_t)_prefs.flood_advert_interval) * 60 * 60 * 1000, millis());
+    next_flood_advert = futureMillis(advert_sched.jitterInterval(interval));
   } else {
     next_flood_advert = 0; // stop the timer
   }
 }
 
 void MyMesh::dumpLogFile() {
-#if defined(RP2040_PLATFORM)
-  File f = _fs->open(PACKET_LOG_FILE, "r");
-#else
-  File f = _fs->open(PACKET_LOG_FILE);
-#endif
-  if (f) {
-    while (f.available()) {
-      int c = f.read();
-      if (c < 0) break;
-      Serial.print((char)c);
-    }
-    f.close();
-  }
+  packet_log.dump(Serial);
 }
 
 void MyMesh::setTxPower(uint8_t power_dbm) {
@@ -862,8 +1659,8 @@ void MyMesh::removeNeighbor(const uint8_t *pubkey, int key_len) {
 #if MAX_NEIGHBOURS
   for (int i = 0; i < MAX_NEIGHBOURS; i++) {
     NeighbourInfo *neighbour = &neighbours[i];
-    if (memcmp(neighbour->id.pub_key, pubkey, key_len) == 0) {
-      neighbours[i] = NeighbourInfo(); // clear neighbour entry
+    if (neighbour->heard_timestamp > 0 && memcmp(neighbour->id.pub_key, pubkey, key_len) == 0) {
+      unlinkNeighbour(i); // clear neighbour entry
     }
   }
 #endif
@@ -879,7 +1676,47 @@ void MyMesh::formatRadioStatsReply(char *reply) {
 
 void MyMesh::formatPacketStatsReply(char *reply) {
   StatsFormatHelper::formatPacketStats(reply, radio_driver, getNumSentFlood(), getNumSentDirect(), 
-                                       getNumRecvFlood(), getNumRecvDirect());
+                                       getNumRecvFlood(), getNumRecvDirect(), getNumInboundLate());
+}
+
+void MyMesh::formatDedupStatsReply(char *reply) {
+  RepeaterTables* tables = (RepeaterTables *)getTables();
+  StatsFormatHelper::formatDedupStats(reply, tables->getDedupStats(), tables->getCount(), tables->getCapacity());
+}
+
+const MemTable* MyMesh::getMemTables(int& num) const {
+  static constexpr MemTable tables[] = {
+    { "clients", sizeof(ClientACL) },
+  #if MAX_NEIGHBOURS
+    { "neighbours", sizeof(neighbours) + sizeof(neighbour_buckets) },
+  #endif
+    { "mesh_tables", sizeof(RepeaterTables) },
+    { "regions", sizeof(RegionMap) * 2 },   // (region_map and temp_map)
+    { "packet_pool", sizeof(mesh::Packet) * PACKET_POOL_SIZE },
+    { "stats_subs", sizeof(stats_subs) },
+    { "coding", sizeof(mesh::CodingStore) + sizeof(mesh::PeerCapsTable) },
+    { "flash_writer", FLASH_WRITER_BUF_SIZE },
+  };
+  static_assert(RAM_TABLES_BUDGET == 0 || memTablesTotal(tables, sizeof(tables) / sizeof(tables[0])) <= RAM_TABLES_BUDGET,
+                "tables exceed RAM_TABLES_BUDGET, reduce MAX_CLIENTS, MAX_NEIGHBOURS, etc.");
+  num = sizeof(tables) / sizeof(tables[0]);
+  return tables;
+}
+
+void MyMesh::formatMemoryStatsReply(char *reply) {
+  MemoryStats mem;
+  mem.read();
+  int num;
+  const MemTable* tables = getMemTables(num);
+  StatsFormatHelper::formatMemoryStats(reply, mem, memTablesTotal(tables, num));
+}
+
+void MyMesh::formatProfileStatsReply(char *reply, uint8_t type) {
+#if MESH_PROFILING
+  StatsFormatHelper::formatProfileStats(reply, getRecvProfiler(), type);
+#else
+  strcpy(reply, "Error: needs a MESH_PROFILING=1 build");
+#endif
 }
 
 void MyMesh::saveIdentity(const mesh::LocalIdentity &new_id) {
@@ -899,7 +1736,8 @@ void MyMesh::saveIdentity(const mesh::LocalIdentity &new_id) {
 void MyMesh::clearStats() {
   radio_driver.resetStats();
   resetStats();
-  ((SimpleMeshTables *)getTables())->resetStats();
+  mesh::LoopMonitor::get().reset();
+  ((RepeaterTables *)getTables())->resetStats();
 }
 
 void MyMesh::handleCommand(uint32_t sender_timestamp, char *command, char *reply) {
@@ -946,29 +1784,7 @@ void MyMesh::handleCommand(uint32_t sender_timestamp, char *command, char *reply
   }
 
   // handle ACL related commands
-  if (memcmp(command, "setperm ", 8) == 0) {   // format:  setperm {pubkey-hex} {permissions-int8}
-    char* hex = &command[8];
-    char* sp = strchr(hex, ' ');   // look for separator char
-    if (sp == NULL) {
-      strcpy(reply, "Err - bad params");
-    } else {
-      *sp++ = 0;   // replace space with null terminator
-
-      uint8_t pubkey[PUB_KEY_SIZE];
-      int hex_len = min(sp - hex, PUB_KEY_SIZE*2);
-      if (mesh::Utils::fromHex(pubkey, hex_len / 2, hex)) {
-        uint8_t perms = atoi(sp);
-        if (acl.applyPermissions(self_id, pubkey, hex_len / 2, perms)) {
-          dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);   // trigger acl.save()
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Err - invalid params");
-        }
-      } else {
-        strcpy(reply, "Err - bad pubkey");
-      }
-    }
-  } else if (sender_timestamp == 0 && strcmp(command, "get acl") == 0) {
+  if (sender_timestamp == 0 && strcmp(command, "get acl") == 0) {
     Serial.println("ACL:");
     for (int i = 0; i < acl.getNumClients(); i++) {
       auto c = acl.getClientByIdx(i);
@@ -979,92 +1795,263 @@ void MyMesh::handleCommand(uint32_t sender_timestamp, char *command, char *reply
       Serial.printf("\n");
     }
     reply[0] = 0;
-  } else if (memcmp(command, "region", 6) == 0) {
-    reply[0] = 0;
+  } else {
+    _cli.handleCommand(sender_timestamp, command, reply);  // common CLI commands, and those added in begin()
+  }
+}
 
-    const char* parts[4];
-    int n = mesh::Utils::parseTextParts(command, parts, 4, ' ');
-    if (n == 1 && sender_timestamp == 0) {
-      region_map.exportTo(Serial);
-    } else if (n >= 2 && strcmp(parts[1], "load") == 0) {
-      temp_map.resetFrom(region_map);   // rebuild regions in a temp instance
-      memset(load_stack, 0, sizeof(load_stack));
-      load_stack[0] = &temp_map.getWildcard();
-      region_load_active = true;
-    } else if (n >= 2 && strcmp(parts[1], "save") == 0) {
-      _prefs.discovery_mod_timestamp = rtc_clock.getCurrentTime();   // this node is now 'modified' (for discovery info)
-      savePrefs();
-      bool success = region_map.save(_fs);
-      strcpy(reply, success ? "OK" : "Err - save failed");
-    } else if (n >= 3 && strcmp(parts[1], "allowf") == 0) {
-      auto region = region_map.findByNamePrefix(parts[2]);
-      if (region) {
-        region->flags &= ~REGION_DENY_FLOOD;
-        strcpy(reply, "OK");
-      } else {
-        strcpy(reply, "Err - unknown region");
-      }
-    } else if (n >= 3 && strcmp(parts[1], "denyf") == 0) {
-      auto region = region_map.findByNamePrefix(parts[2]);
-      if (region) {
-        region->flags |= REGION_DENY_FLOOD;
+void MyMesh::handleSetPermCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  // format:  setperm {pubkey-hex} {permissions-int8}
+  char* hex = &command[8];
+  char* sp = strchr(hex, ' ');   // look for separator char
+  if (sp == NULL) {
+    strcpy(reply, "Err - bad params");
+  } else {
+    *sp++ = 0;   // replace space with null terminator
+
+    uint8_t pubkey[PUB_KEY_SIZE];
+    int hex_len = min(sp - hex, PUB_KEY_SIZE*2);
+    if (mesh::Utils::fromHex(pubkey, hex_len / 2, hex)) {
+      uint8_t perms = atoi(sp);
+      if (acl.applyPermissions(self_id, pubkey, hex_len / 2, perms)) {
+        dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);   // trigger acl.save()
         strcpy(reply, "OK");
       } else {
-        strcpy(reply, "Err - unknown region");
+        strcpy(reply, "Err - invalid params");
       }
-    } else if (n >= 3 && strcmp(parts[1], "get") == 0) {
-      auto region = region_map.findByNamePrefix(parts[2]);
-      if (region) {
-        auto parent = region_map.findById(region->parent);
-        if (parent && parent->id != 0) {
-          sprintf(reply, " %s (%s) %s", region->name, parent->name, (region->flags & REGION_DENY_FLOOD) ? "" : "F");
-        } else {
-          sprintf(reply, " %s %s", region->name, (region->flags & REGION_DENY_FLOOD) ? "" : "F");
-        }
+    } else {
+      strcpy(reply, "Err - bad pubkey");
+    }
+  }
+}
+
+void MyMesh::handleRegionCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  reply[0] = 0;
+
+  const char* parts[4];
+  int n = mesh::Utils::parseTextParts(command, parts, 4, ' ');
+  if (n == 1 && sender_timestamp == 0) {
+    region_map.exportTo(Serial);
+  } else if (n >= 2 && strcmp(parts[1], "load") == 0) {
+    temp_map.resetFrom(region_map);   // rebuild regions in a temp instance
+    memset(load_stack, 0, sizeof(load_stack));
+    load_stack[0] = &temp_map.getWildcard();
+    region_load_active = true;
+  } else if (n >= 2 && strcmp(parts[1], "save") == 0) {
+    _prefs.discovery_mod_timestamp = rtc_clock.getCurrentTime();   // this node is now 'modified' (for discovery info)
+    savePrefs();
+    bool success = region_map.save(_fs);
+    strcpy(reply, success ? "OK" : "Err - save failed");
+  } else if (n >= 3 && strcmp(parts[1], "allowf") == 0) {
+    auto region = region_map.findByNamePrefix(parts[2]);
+    if (region) {
+      region->flags &= ~REGION_DENY_FLOOD;
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Err - unknown region");
+    }
+  } else if (n >= 3 && strcmp(parts[1], "denyf") == 0) {
+    auto region = region_map.findByNamePrefix(parts[2]);
+    if (region) {
+      region->flags |= REGION_DENY_FLOOD;
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Err - unknown region");
+    }
+  } else if (n >= 3 && strcmp(parts[1], "get") == 0) {
+    auto region = region_map.findByNamePrefix(parts[2]);
+    if (region) {
+      auto parent = region_map.findById(region->parent);
+      if (parent && parent->id != 0) {
+        sprintf(reply, " %s (%s) %s", region->name, parent->name, (region->flags & REGION_DENY_FLOOD) ? "" : "F");
       } else {
-        strcpy(reply, "Err - unknown region");
+        sprintf(reply, " %s %s", region->name, (region->flags & REGION_DENY_FLOOD) ? "" : "F");
       }
-    } else if (n >= 3 && strcmp(parts[1], "home") == 0) {
-      auto home = region_map.findByNamePrefix(parts[2]);
-      if (home) {
-        region_map.setHomeRegion(home);
-        sprintf(reply, " home is now %s", home->name);
+    } else {
+      strcpy(reply, "Err - unknown region");
+    }
+  } else if (n >= 3 && strcmp(parts[1], "home") == 0) {
+    auto home = region_map.findByNamePrefix(parts[2]);
+    if (home) {
+      region_map.setHomeRegion(home);
+      sprintf(reply, " home is now %s", home->name);
+    } else {
+      strcpy(reply, "Err - unknown region");
+    }
+  } else if (n == 2 && strcmp(parts[1], "home") == 0) {
+    auto home = region_map.getHomeRegion();
+    sprintf(reply, " home is %s", home ? home->name : "*");
+  } else if (n >= 3 && strcmp(parts[1], "put") == 0) {
+    auto parent = n >= 4 ? region_map.findByNamePrefix(parts[3]) : &region_map.getWildcard();
+    if (parent == NULL) {
+      strcpy(reply, "Err - unknown parent");
+    } else {
+      auto region = region_map.putRegion(parts[2], parent->id);
+      if (region == NULL) {
+        strcpy(reply, "Err - unable to put");
       } else {
-        strcpy(reply, "Err - unknown region");
+        strcpy(reply, "OK");
       }
-    } else if (n == 2 && strcmp(parts[1], "home") == 0) {
-      auto home = region_map.getHomeRegion();
-      sprintf(reply, " home is %s", home ? home->name : "*");
-    } else if (n >= 3 && strcmp(parts[1], "put") == 0) {
-      auto parent = n >= 4 ? region_map.findByNamePrefix(parts[3]) : &region_map.getWildcard();
-      if (parent == NULL) {
-        strcpy(reply, "Err - unknown parent");
+    }
+  } else if (n >= 3 && strcmp(parts[1], "remove") == 0) {
+    auto region = region_map.findByName(parts[2]);
+    if (region) {
+      uint16_t id = region->id;
+      if (region_map.removeRegion(*region)) {
+        flood_policy.removeRegion(id);
+        flood_policy.save(_fs);
+#ifdef WITH_BRIDGE
+        bridge_filter.removeRegion(id);
+        bridge_filter.save(_fs);
+#endif
+        strcpy(reply, "OK");
       } else {
-        auto region = region_map.putRegion(parts[2], parent->id);
-        if (region == NULL) {
-          strcpy(reply, "Err - unable to put");
-        } else {
-          strcpy(reply, "OK");
-        }
+        strcpy(reply, "Err - not empty");
       }
-    } else if (n >= 3 && strcmp(parts[1], "remove") == 0) {
-      auto region = region_map.findByName(parts[2]);
-      if (region) {
-        if (region_map.removeRegion(*region)) {
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Err - not empty");
-        }
+    } else {
+      strcpy(reply, "Err - not found");
+    }
+  } else {
+    strcpy(reply, "Err - ??");
+  }
+}
+
+void MyMesh::handleFloodPolicyCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  // format:  flood.policy set {type|*} {max-hops} [{region}|any] [flood|tflood]
+  //          flood.policy del {type|*} [{region}|any] [flood|tflood]
+  //          flood.policy clear
+  const char* parts[6];
+  int n = mesh::Utils::parseTextParts(command, parts, 6, ' ');
+  bool is_set = n >= 2 && strcmp(parts[1], "set") == 0;
+  int i = is_set ? 4 : 3;   // index of region part
+  int type = n >= 3 ? FloodPolicy::parseTypeName(parts[2]) : -1;
+  RegionEntry* region = NULL;
+  if (n > i && strcmp(parts[i], "any") != 0) {
+    region = region_map.findByName(parts[i]);
+  }
+  uint8_t route_type = FLOOD_RULE_ANY;
+  if (n > i + 1) {
+    route_type = strcmp(parts[i + 1], "flood") == 0 ? ROUTE_TYPE_FLOOD : (strcmp(parts[i + 1], "tflood") == 0 ? ROUTE_TYPE_TRANSPORT_FLOOD : 0xFE);
+  }
+
+  if (n == 1) {
+    reply[0] = 0;
+    for (int j = 0; j < flood_policy.getCount(); j++) {
+      auto& r = flood_policy.getRule(j);
+      auto rgn = r.region_id == FLOOD_RULE_ANY_REGION ? NULL : region_map.findById(r.region_id);
+      char tmp[48];
+      sprintf(tmp, "%s%s%s%s%s %d", j > 0 ? ", " : "", FloodPolicy::getTypeName(r.payload_type),
+              rgn ? "@" : "", rgn ? rgn->name : "",
+              r.route_type == FLOOD_RULE_ANY ? "" : (r.route_type == ROUTE_TYPE_FLOOD ? "/flood" : "/tflood"), (uint32_t) r.max_hops);
+      if (strlen(reply) + strlen(tmp) >= 160) break;   // no more room
+      strcat(reply, tmp);
+    }
+    if (reply[0] == 0) strcpy(reply, "(none)");
+  } else if (n == 2 && strcmp(parts[1], "clear") == 0) {
+    flood_policy.clear();
+    strcpy(reply, flood_policy.save(_fs) ? "OK" : "Err - save failed");
+  } else if (type < 0) {
+    strcpy(reply, "Err - unknown type");
+  } else if (n > i && region == NULL && strcmp(parts[i], "any") != 0) {
+    strcpy(reply, "Err - unknown region");
+  } else if (route_type == 0xFE) {
+    strcpy(reply, "Err - bad route type");
+  } else if (is_set && n >= 4) {
+    int hops = atoi(parts[3]);
+    if (hops < 0 || hops > MAX_PATH_SIZE / PATH_HASH_SIZE) {
+      strcpy(reply, "Err - bad max-hops");
+    } else if (!flood_policy.putRule(type, route_type, region ? region->id : FLOOD_RULE_ANY_REGION, hops)) {
+      strcpy(reply, "Err - table full");
+    } else {
+      strcpy(reply, flood_policy.save(_fs) ? "OK" : "Err - save failed");
+    }
+  } else if (n >= 3 && strcmp(parts[1], "del") == 0) {
+    if (flood_policy.removeRule(type, route_type, region ? region->id : FLOOD_RULE_ANY_REGION)) {
+      strcpy(reply, flood_policy.save(_fs) ? "OK" : "Err - save failed");
+    } else {
+      strcpy(reply, "Err - not found");
+    }
+  } else {
+    strcpy(reply, "Err - ??");
+  }
+}
+
+#ifdef WITH_BRIDGE
+void MyMesh::handleBridgeFilterCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  // format:  bridge.filter set {type|*} {max-hops|-} {per-min} [{region}|any] [{route}|*]
+  //          bridge.filter deny {type|*} [{region}|any] [{route}|*]
+  //          bridge.filter del {type|*} [{region}|any] [{route}|*]
+  //          bridge.filter clear
+  const char* parts[7];
+  int n = mesh::Utils::parseTextParts(command, parts, 7, ' ');
+  bool is_set = n >= 2 && strcmp(parts[1], "set") == 0;
+  int i = is_set ? 5 : 3;   // index of region part
+  int type = n >= 3 ? FloodPolicy::parseTypeName(parts[2]) : -1;
+  RegionEntry* region = NULL;
+  if (n > i && strcmp(parts[i], "any") != 0) {
+    region = region_map.findByName(parts[i]);
+  }
+  int route_type = n > i + 1 ? BridgeFilter::parseRouteName(parts[i + 1]) : FLOOD_RULE_ANY;
+  uint16_t region_id = region ? region->id : FLOOD_RULE_ANY_REGION;
+
+  if (n == 1) {
+    reply[0] = 0;
+    for (int j = 0; j < bridge_filter.getCount(); j++) {
+      auto& r = bridge_filter.getRule(j);
+      auto rgn = r.region_id == FLOOD_RULE_ANY_REGION ? NULL : region_map.findById(r.region_id);
+      char tmp[72];
+      sprintf(tmp, "%s%s%s%s%s%s ", j > 0 ? ", " : "", FloodPolicy::getTypeName(r.payload_type),
+              rgn ? "@" : "", rgn ? rgn->name : "",
+              r.route_type == FLOOD_RULE_ANY ? "" : "/", r.route_type == FLOOD_RULE_ANY ? "" : BridgeFilter::getRouteName(r.route_type));
+      if (r.flags & BRIDGE_RULE_DENY) {
+        strcat(tmp, "deny");
       } else {
-        strcpy(reply, "Err - not found");
+        char* dp = &tmp[strlen(tmp)];
+        if (r.max_hops == BRIDGE_RULE_NO_HOPS) { strcpy(dp, "-"); } else { sprintf(dp, "%d", (uint32_t) r.max_hops); }
+        if (r.per_min) sprintf(&dp[strlen(dp)], " %d/min", (uint32_t) r.per_min);
       }
+      if (strlen(reply) + strlen(tmp) >= 160) break;   // no more room
+      strcat(reply, tmp);
+    }
+    if (reply[0] == 0) strcpy(reply, "(none)");
+  } else if (n == 2 && strcmp(parts[1], "clear") == 0) {
+    bridge_filter.clear();
+    strcpy(reply, bridge_filter.save(_fs) ? "OK" : "Err - save failed");
+  } else if (type < 0) {
+    strcpy(reply, "Err - unknown type");
+  } else if (n > i && region == NULL && strcmp(parts[i], "any") != 0) {
+    strcpy(reply, "Err - unknown region");
+  } else if (route_type < 0) {
+    strcpy(reply, "Err - bad route type");
+  } else if (is_set && n >= 4) {
+    int hops = strcmp(parts[3], "-") == 0 ? BRIDGE_RULE_NO_HOPS : atoi(parts[3]);
+    int per_min = n >= 5 ? atoi(parts[4]) : 0;
+    if (hops < 0 || (hops > MAX_PATH_SIZE / PATH_HASH_SIZE && hops != BRIDGE_RULE_NO_HOPS)) {
+      strcpy(reply, "Err - bad max-hops");
+    } else if (per_min < 0 || per_min > 6000) {
+      strcpy(reply, "Err - per-min must be 0-6000");
+    } else if (!bridge_filter.putRule(type, route_type, region_id, 0, hops, per_min)) {
+      strcpy(reply, "Err - table full");
     } else {
-      strcpy(reply, "Err - ??");
+      strcpy(reply, bridge_filter.save(_fs) ? "OK" : "Err - save failed");
     }
-  } else{
-    _cli.handleCommand(sender_timestamp, command, reply);  // common CLI commands
+  } else if (n >= 3 && strcmp(parts[1], "deny") == 0) {
+    if (!bridge_filter.putRule(type, route_type, region_id, BRIDGE_RULE_DENY, BRIDGE_RULE_NO_HOPS, 0)) {
+      strcpy(reply, "Err - table full");
+    } else {
+      strcpy(reply, bridge_filter.save(_fs) ? "OK" : "Err - save failed");
+    }
+  } else if (n >= 3 && strcmp(parts[1], "del") == 0) {
+    if (bridge_filter.removeRule(type, route_type, region_id)) {
+      strcpy(reply, bridge_filter.save(_fs) ? "OK" : "Err - save failed");
+    } else {
+      strcpy(reply, "Err - not found");
+    }
+  } else {
+    strcpy(reply, "Err - ??");
   }
 }
+#endif
 
 void MyMesh::loop() {
 #ifdef WITH_BRIDGE
@@ -1072,17 +2059,28 @@ void MyMesh::loop() {
 #endif
 
   mesh::Mesh::loop();
+  packet_log.loop(millis());
+  flash_writer.loop();
+#ifdef WITH_MESH_OTA
+  checkFirmwareSend();
+#endif
 
   if (next_flood_advert && millisHasNowPassed(next_flood_advert)) {
-    mesh::Packet *pkt = createSelfAdvert();
-    if (pkt) sendFlood(pkt);
+    uint32_t defer = advert_sched.getFloodAdvertDelay(_ms->getMillis(), getRNG());
+    if (defer) {   // advert wave in progress, or own advert still echoing
+      next_flood_advert = futureMillis(defer);
+    } else {
+      mesh::Packet *pkt = createSelfAdvert(true);
+      if (pkt) sendFlood(pkt);
 
-    updateFloodAdvertTimer(); // schedule next flood advert
-    updateAdvertTimer();      // also schedule local advert (so they don't overlap)
+      updateFloodAdvertTimer(); // schedule next flood advert
+      updateAdvertTimer();      // also schedule local advert (so they don't overlap)
+    }
   } else if (next_local_advert && millisHasNowPassed(next_local_advert)) {
-    mesh::Packet *pkt = createSelfAdvert();
-    if (pkt) sendZeroHop(pkt);
-
+    if (!advert_sched.shouldSuppressLocal(_ms->getMillis(), (uint32_t)_prefs.advert_interval * 2 * 60 * 1000)) {
+      mesh::Packet *pkt = createSelfAdvert(true);
+      if (pkt) sendZeroHop(pkt);
+    }
     updateAdvertTimer(); // schedule next local advert
   }
 
@@ -1094,16 +2092,47 @@ void MyMesh::loop() {
 
   if (revert_radio_at && millisHasNowPassed(revert_radio_at)) { // revert radio params to orig
     revert_radio_at = 0;                                        // clear timer
-    radio_set_params(_prefs.freq, _prefs.bw, _prefs.sf, _prefs.cr);
+    applyRadioParams();
     MESH_DEBUG_PRINTLN("Radio params restored");
   }
 
+  if (channel_plan.getHopSecs() && !set_radio_at && !revert_radio_at && _radio->isInRecvMode()
+      && channel_plan.getActive(home_channel, getRTCClock()->getCurrentTime()) != rx_channel) {
+    applyRadioParams();   // into next hop slot
+  }
+
   // is pending dirty contacts write needed?
   if (dirty_contacts_expiry && millisHasNowPassed(dirty_contacts_expiry)) {
     acl.save(_fs);
     dirty_contacts_expiry = 0;
   }
 
+#ifndef DEDUP_WINDOW_SECS
+  if (next_tables_save && millisHasNowPassed(next_tables_save)) {   // lazy snapshot of dedup tables
+    SimpleMeshTables* tables = (SimpleMeshTables *)getTables();
+    if (tables->isDirty()) tables->save(_fs, TABLES_SNAPSHOT_FILE);
+    next_tables_save = futureMillis(TABLES_SAVE_INTERVAL_SECS * 1000);
+  }
+#endif
+  if (next_warm_save && millisHasNowPassed(next_warm_save)) {   // cheap (RAM only), so often
+    saveWarmState();
+    next_warm_save = futureMillis(WARM_RESTART_SAVE_MILLIS);
+  }
+
+  sendStatsPushes();
+  channel_load.update(millis(), getTotalAirTime() + getReceiveAirTime());
+
+  if (millisHasNowPassed(next_density_update)) {
+#if MAX_NEIGHBOURS
+    expireNeighbours();
+#endif
+    flood_density.update(countActiveNeighbours(), getNumRecvFlood(), ((RepeaterTables *)getTables())->getNumFloodDups());
+    next_density_update = futureMillis(DENSITY_UPDATE_MILLIS);
+  }
+#if MAX_NEIGHBOURS
+  checkLinkSweep();
+#endif
+
   // update uptime
   uint32_t now = millis();
   uptime_millis += now - last_millis;
@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include <Mesh.h>
+#include <PayloadViews.h>
 #include <RTClib.h>
 #include <target.h>
 
@@ -23,17 +24,49 @@
 #define WITH_BRIDGE
 #endif
 
+#ifdef WITH_UDP_BRIDGE
+#include "helpers/bridges/UDPBridge.h"
+#define WITH_BRIDGE
+#endif
+
 #include <helpers/AdvertDataHelpers.h>
+#include <helpers/AirtimeBudget.h>
 #include <helpers/ArduinoHelpers.h>
+#include <helpers/BridgeFilter.h>
+#include <helpers/ChaChaRNG.h>
+#include <helpers/ChannelPlan.h>
 #include <helpers/ClientACL.h>
 #include <helpers/CommonCLI.h>
+#include <helpers/FlashWriter.h>
 #include <helpers/IdentityStore.h>
+#include <helpers/PacketLog.h>
 #include <helpers/SimpleMeshTables.h>
-#include <helpers/StaticPoolPacketManager.h>
+#ifdef DEDUP_WINDOW_SECS
+  #include <helpers/TimedMeshTables.h>
+  typedef TimedMeshTables RepeaterTables;   // remember packets for a minimum time, rather than count
+#else
+  typedef SimpleMeshTables RepeaterTables;
+#endif
+#include <helpers/ScheduledPacketManager.h>
+#ifdef WITH_ESPNOW_BRIDGE
+  #include <helpers/ConcurrentPacketManager.h>
+#endif
+#include <helpers/AdvertScheduler.h>
+#include <helpers/FloodDensity.h>
+#include <helpers/ChannelLoad.h>
+#include <helpers/FloodPolicy.h>
 #include <helpers/StatsFormatHelper.h>
+#include <helpers/TelemetryCache.h>
 #include <helpers/TxtDataHelpers.h>
+#include <helpers/TxtCodec.h>
 #include <helpers/RegionMap.h>
+#include <helpers/RetainedState.h>
+#include <helpers/SourceRateLimiter.h>
+#include <helpers/RadioPort.h>
 #include "RateLimiter.h"
+#ifdef WITH_MESH_OTA
+  #include <helpers/FirmwareXfer.h>
+#endif
 
 #ifdef WITH_BRIDGE
 extern AbstractBridge* bridge;
@@ -54,17 +87,145 @@ struct RepeaterStats {
   int16_t  last_snr;   // x 4
   uint16_t n_direct_dups, n_flood_dups;
   uint32_t total_rx_air_time_secs;
+  uint16_t tables_used, tables_capacity;    // dedup table occupancy
+  uint32_t n_table_evictions;
+  uint32_t dup_air_time_secs;               // airtime the duplicates would have cost
+  uint16_t dups_by_type[16];                // by PAYLOAD_TYPE_*
+  uint32_t n_bridge_frames_in, n_bridge_frames_out;
+  uint32_t n_bridge_pkts_in, n_bridge_pkts_out;
+  uint32_t n_bridge_bad, n_bridge_dups;     // failed checksum/CRC, and already bridged (looped back)
+  uint16_t bridge_queue_len;                // packets waiting in the pending batch
+  uint16_t bridge_delay;                    // millis, as applied (ie. the adaptive one, if bridge.delay is auto)
+  int16_t  bridge_offset;                   // millis, avg over-the-air copy arrival after bridged copy
+  uint16_t bridge_offset_dev;
 };
 
 #ifndef MAX_CLIENTS
   #define MAX_CLIENTS           32
 #endif
 
+#ifndef STATS_PUSH_MAX_SUBS
+  #define STATS_PUSH_MAX_SUBS    2      // admins which can subscribe to stats pushes
+#endif
+#define STATS_PUSH_MIN_MINS      15     // don't allow pushes more often than this, to save airtime
+#define STATS_PUSH_KEYFRAME_EVERY  8    // every Nth push has full values, so a missed push can be recovered from
+
+struct StatsSubscription {
+  uint8_t pub_key[PUB_KEY_SIZE];
+  uint16_t interval_mins;     // zero if slot unused
+  unsigned long next_push;
+  uint8_t seq;
+  RepeaterStats last;         // as at last push, for the deltas
+};
+
+#ifndef DUTY_CYCLE_PERCENT
+  #define DUTY_CYCLE_PERCENT     0      // disabled by default (eg. 10 for EU 869.4 - 869.65 MHz sub-band)
+#endif
+#ifndef FLOOD_SUPPRESS_COUNT
+  #define FLOOD_SUPPRESS_COUNT   0      // disabled by default, eg. 3 in dense meshes
+#endif
+#ifndef RELAY_SELECT_PERCENT
+  #define RELAY_SELECT_PERCENT   0      // % of floods heard from a close neighbour that are dropped if any other copy is heard
+#endif
+#ifndef RELAY_SELECT_SNR
+  #define RELAY_SELECT_SNR       10.0f  // SNR (dB) at or above which the sender is treated as close
+#endif
+#ifndef ADVERT_REFRESH_COUNT
+  #define ADVERT_REFRESH_COUNT   0      // short 'refresh' adverts between full ones, eg. 3 (once all repeaters support them)
+#endif
+#ifndef ADAPTIVE_FLOOD_DENSITY
+  #define ADAPTIVE_FLOOD_DENSITY   1    // scale flood retransmit delay (and skip some) by local density. 0 to disable
+#endif
+#define NEIGHBOUR_ACTIVE_SECS     (24*60*60)   // neighbours heard within this, count towards density
+#ifndef NEIGHBOUR_MAX_AGE_SECS
+  #define NEIGHBOUR_MAX_AGE_SECS  (7*24*60*60)  // neighbours not heard within this are dropped
+#endif
+#define NEIGHBOUR_HASH_SIZE       16    // buckets, by first byte of pub_key
+#ifndef LINK_SWEEP_INTERVAL_SECS
+  #define LINK_SWEEP_INTERVAL_SECS  (6*60*60)   // how often each active neighbour link is TRACEd (0 = never)
+#endif
+#define LINK_SWEEP_START_MILLIS   (10*60*1000)  // first sweep after boot (neighbour table needs to fill)
+#define LINK_PROBE_GAP_MILLIS     30000   // between TRACEs, within a sweep
+#define LINK_PROBE_TIMEOUT_MILLIS 8000    // TRACE not back within this (plus airtime) counts as lost
+#define LINK_SWEEP_MAX_LOAD       20      // channel load % above which the sweep waits
+#ifndef TX_POWER_ADAPTIVE
+  #define TX_POWER_ADAPTIVE         0       // 1 = direct hops to strong neighbours are sent at less than tx_power_dbm
+#endif
+#define TX_POWER_LINK_MARGIN_DB   10      // SNR (dB) above the demod threshold that a reduced power hop still keeps
+#define TX_POWER_MIN_DBM          2
+#ifndef CUT_THROUGH_FORWARD
+  #define CUT_THROUGH_FORWARD       1       // queue flood retransmits before local advert/group handling
+#endif
+#ifndef BUNDLE_WINDOW_MILLIS
+  #define BUNDLE_WINDOW_MILLIS      250     // DIRECT packets due this soon, for the same next hop, go in one BUNDLE frame. 0 = off
+#endif
+#define DENSITY_UPDATE_MILLIS     60000
+
+#ifndef DUTY_CYCLE_WINDOW_SECS
+  #define DUTY_CYCLE_WINDOW_SECS   3600   // 1 hour
+#endif
+#ifndef SOURCE_RATE_PER_MIN
+  #define SOURCE_RATE_PER_MIN      30     // max packets forwarded per minute, from any one source. 0 to disable
+#endif
+#ifndef SOURCE_RATE_BURST
+  #define SOURCE_RATE_BURST        10
+#endif
+#define BACKBONE_SLOT_GUARD_MILLIS  40     // between TDMA slots of backbone repeaters (see 'set backbone')
+#ifndef RADIO_RX_DUTY_CYCLE
+  #define RADIO_RX_DUTY_CYCLE      0      // low power (duty-cycled) receive, eg. for solar sites. Advertised to neighbours
+#endif
+#ifndef PACKET_POOL_SIZE
+  #define PACKET_POOL_SIZE         32
+#endif
+#ifndef PACKET_SLAB_SMALL_SLOTS
+  #define PACKET_SLAB_SMALL_SLOTS  16     // extra, truncated slots for queued packets (see PacketSlab)
+#endif
+#ifndef PACKET_SLAB_MEDIUM_SLOTS
+  #define PACKET_SLAB_MEDIUM_SLOTS  8
+#endif
+#ifndef RX_SLEEP_IDLE_MILLIS
+  #define RX_SLEEP_IDLE_MILLIS     0      // deep sleep (radio left in Rx) once idle this long, eg. for solar sites. 0 = never
+#endif
+#ifndef RX_SLEEP_MAX_SECS
+  #define RX_SLEEP_MAX_SECS        3600   // wake at least this often, even if no packets or adverts due
+#endif
+#ifndef WARM_RESTART_SAVE_MILLIS
+  #if defined(ESP32) && RX_SLEEP_IDLE_MILLIS
+    #define WARM_RESTART_SAVE_MILLIS  0    // (RTC memory is taken by the Rx sleep state)
+  #else
+    #define WARM_RESTART_SAVE_MILLIS  5000   // how often to snapshot tables, neighbours, counters to retained RAM. 0 = never
+  #endif
+#endif
+#ifndef CHANNEL_PLAN_NUM
+  #define CHANNEL_PLAN_NUM         1      // LoRa channels, from prefs freq up. 1 = single channel (no plan)
+#endif
+#ifndef CHANNEL_PLAN_SPACING_KHZ
+  #define CHANNEL_PLAN_SPACING_KHZ 250
+#endif
+#ifndef CHANNEL_PLAN_HOP_SECS
+  #define CHANNEL_PLAN_HOP_SECS    0      // all hop to next channel every this many secs (needs synced clocks). 0 = fixed
+#endif
+#ifndef CHANNEL_PLAN_HOME
+  #define CHANNEL_PLAN_HOME        -1     // our home channel (eg. by region), or -1 to spread by identity
+#endif
+#ifndef SECOND_RADIO_QUEUE_SIZE
+  #define SECOND_RADIO_QUEUE_SIZE  16     // outbound queue of second radio (WITH_SECOND_RADIO builds)
+#endif
+
 struct NeighbourInfo {
   mesh::Identity id;
   uint32_t advert_timestamp;
-  uint32_t heard_timestamp;
+  uint32_t heard_timestamp;   // zero if slot unused
   int8_t snr; // multiplied by 4, user should divide to get float value
+  int8_t snr_avg;       // EWMA of snr (also x4)
+  uint16_t heard_count;   // zero-hop adverts heard
+  bool low_power_rx;      // advertised ADV_CAP_LOW_POWER_RX
+  int8_t home_channel;    // advertised ChannelPlan home channel, or -1
+  int8_t link_snr_out;    // from last sweep TRACE: SNR (x4) of our tx as heard by neighbour, or 127 if unknown
+  int8_t link_snr_in;     // ditto, of its retransmit as heard by us
+  uint8_t link_success;   // EWMA of sweep TRACEs returned (of 255)
+  uint8_t link_probes;    // sweep TRACEs sent (saturates at 255)
+  int16_t next;         // next in same hash bucket, or -1
 };
 
 #ifndef FIRMWARE_BUILD_DATE
@@ -77,7 +238,7 @@ struct NeighbourInfo {
 
 #define FIRMWARE_ROLE "repeater"
 
-#define PACKET_LOG_FILE  "/packet_log"
+#define PACKET_LOG_FILE  "/packet_log"    // old text log, now replaced by PacketLog
 
 class MyMesh : public mesh::Mesh, public CommonCLICallbacks {
   FILESYSTEM* _fs;
@@ -85,6 +246,8 @@ class MyMesh : public mesh::Mesh, public CommonCLICallbacks {
   uint64_t uptime_millis;
   unsigned long next_local_advert, next_flood_advert;
   bool _logging;
+  PacketLog packet_log;
+  PacketCapture capture;
   NodePrefs _prefs;
   CommonCLI _cli;
   uint8_t reply_data[MAX_PACKET_PAYLOAD];
@@ -93,45 +256,122 @@ class MyMesh : public mesh::Mesh, public CommonCLICallbacks {
   RegionMap region_map, temp_map;
   RegionEntry* load_stack[8];
   RegionEntry* recv_pkt_region;
+  FloodPolicy flood_policy;
   RateLimiter discover_limiter;
+  SourceRateLimiter source_limiter;
+  AirtimeBudget airtime_budget;
   bool region_load_active;
   unsigned long dirty_contacts_expiry;
+  unsigned long next_tables_save;
+  unsigned long next_warm_save;
+  FloodDensity flood_density;
+  ChannelLoad channel_load;
+  mesh::CodingStore coding_store;
+  mesh::PeerCapsTable peer_caps;
+  AdvertScheduler advert_sched;
+  unsigned long next_density_update;
+  StatsSubscription stats_subs[STATS_PUSH_MAX_SUBS];
 #if MAX_NEIGHBOURS
   NeighbourInfo neighbours[MAX_NEIGHBOURS];
+  int16_t neighbour_buckets[NEIGHBOUR_HASH_SIZE];   // index of first in each bucket, or -1
+  uint8_t link_probe_key[PUB_KEY_SIZE];   // neighbour the sweep TRACE in flight is for
+  uint32_t link_probe_tag;                // non-zero while a sweep TRACE is in flight
+  unsigned long link_probe_timeout, next_link_probe;
+  int link_sweep_idx;                     // next neighbours[] slot in this sweep
+#endif
+  LPPSlice telemetry;
+  TelemetryCache telem_cache;
+#ifdef WITH_MESH_OTA
+  FirmwareXfer fw_xfer;
+  unsigned long next_fw_send;
 #endif
-  CayenneLPP telemetry;
   unsigned long set_radio_at, revert_radio_at;
   float pending_freq;
   float pending_bw;
   uint8_t pending_sf;
   uint8_t pending_cr;
   int  matching_peer_indexes[MAX_CLIENTS];
+  bool low_power_rx;
+  bool woke_from_sleep;
+  ChannelPlan channel_plan;
+  uint8_t home_channel, rx_channel;
 #if defined(WITH_RS232_BRIDGE)
   RS232Bridge bridge;
 #elif defined(WITH_ESPNOW_BRIDGE)
   ESPNowBridge bridge;
+#elif defined(WITH_UDP_BRIDGE)
+  UDPBridge bridge;
+#endif
+#ifdef WITH_BRIDGE
+  BridgeFilter bridge_filter;
+
+  void sendToBridge(mesh::Packet* pkt);
 #endif
 
-  void putNeighbour(const mesh::Identity& id, uint32_t timestamp, float snr);
+  void fillRepeaterStats(RepeaterStats& stats);
+  bool subscribeStats(const ClientInfo* client, uint16_t interval_mins);
+  void sendStatsPushes();
+  int countActiveNeighbours();
+  void putNeighbour(const mesh::Identity& id, uint32_t timestamp, float snr, bool low_power_rx, int8_t home_channel);
+  bool isBackbonePeer(uint8_t hash) const;
+  int getBackboneDelay(const mesh::Packet* packet, uint8_t peer_hash);
+#if MAX_NEIGHBOURS
+  NeighbourInfo* findNeighbour(const uint8_t* pub_key);
+  void unlinkNeighbour(int idx);
+  void clearNeighbours();
+  void expireNeighbours();
+  void checkLinkSweep();
+  int formatLinkMap(uint8_t* dest, uint16_t offset);
+#endif
   uint8_t handleLoginReq(const mesh::Identity& sender, const uint8_t* secret, uint32_t sender_timestamp, const uint8_t* data, bool is_flood);
+  uint8_t formatLoginReply(ClientInfo* client);
+  uint8_t handleResumeReq(ClientInfo* client, const uint8_t* payload, size_t payload_len, bool is_flood);
   int handleRequest(ClientInfo* sender, uint32_t sender_timestamp, uint8_t* payload, size_t payload_len);
-  mesh::Packet* createSelfAdvert();
+  mesh::Packet* createSelfAdvert(bool allow_refresh=false);
+  void applyRadioParams();
+  void restoreSleepState();
+  void restoreWarmState();
+  void saveWarmState();
+  const MemTable* getMemTables(int& num) const;
+  void handleSetPermCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleRegionCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleFloodPolicyCmd(uint32_t sender_timestamp, char* command, char* reply);
+#ifdef WITH_MESH_OTA
+  void handleFirmwareCmd(uint32_t sender_timestamp, char* command, char* reply);
+  bool isTrustedFirmware(const uint8_t* manifest);
+  void checkFirmwareSend();
+#endif
+#ifdef WITH_BRIDGE
+  void handleBridgeFilterCmd(uint32_t sender_timestamp, char* command, char* reply);
+#endif
 
-  File openAppend(const char* fname);
 
 protected:
   float getAirtimeBudgetFactor() const override {
     return _prefs.airtime_factor;
   }
+  uint32_t getTxBudgetDelay(const mesh::Packet* packet, uint32_t est_air_time) override {
+    return airtime_budget.getDelayFor(_ms->getMillis(), AirtimeBudget::classify(packet), est_air_time);
+  }
+  void onTxAirtimeUsed(const mesh::Packet* packet, uint32_t air_time) override {
+    airtime_budget.record(_ms->getMillis(), AirtimeBudget::classify(packet), air_time);
+  }
 
   bool allowPacketForward(const mesh::Packet* packet) override;
+  bool needsLongPreamble(const mesh::Packet* packet) override;
+  uint32_t getExtraTxChannels(const mesh::Packet* packet) override;
+  float getTxFrequencyFor(const mesh::Packet* packet) override;
+  int8_t getTxPowerFor(const mesh::Packet* packet) override;
+  uint8_t getFloodHopLimit(const mesh::Packet* packet) override;
+  bool allowCutThrough(const mesh::Packet* packet) const override { return CUT_THROUGH_FORWARD; }
+  uint32_t getBundleWindowMillis() const override { return BUNDLE_WINDOW_MILLIS; }
   const char* getLogDateTime() override;
   void logRxRaw(float snr, float rssi, const uint8_t raw[], int len) override;
 
   void logRx(mesh::Packet* pkt, int len, float score) override;
   void logTx(mesh::Packet* pkt, int len) override;
   void logTxFail(mesh::Packet* pkt, int len) override;
-  int calcRxDelay(float score, uint32_t air_time) const override;
+  float getRxDelayBase() const override;
 
   uint32_t getRetransmitDelay(const mesh::Packet* packet) override;
   uint32_t getDirectRetransmitDelay(const mesh::Packet* packet) override;
@@ -142,9 +382,22 @@ protected:
   int getAGCResetInterval() const override {
     return ((int)_prefs.agc_reset_interval) * 4000;   // milliseconds
   }
+  uint32_t getOutboundAgingMillis() const override {
+    return _prefs.qos_aging;
+  }
+  bool allowCodedForward() const override {
+    return _prefs.net_coding != 0;
+  }
   uint8_t getExtraAckTransmitCount() const override {
     return _prefs.multi_acks;
   }
+  uint8_t getFloodSuppressCount() const override {
+    return FLOOD_SUPPRESS_COUNT;
+  }
+  uint8_t getFloodSuppressCount(const mesh::Packet* queued) const override;
+  uint8_t getAdvertRefreshCount() const override {
+    return ADVERT_REFRESH_COUNT;
+  }
 
 #if ENV_INCLUDE_GPS == 1
   void applyGpsPrefs() {
@@ -158,15 +411,37 @@ protected:
   int searchPeersByHash(const uint8_t* hash) override;
   void getPeerSharedSecret(uint8_t* dest_secret, int peer_idx) override;
   void onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp, const uint8_t* app_data, size_t app_data_len);
+  void onAdvertRefreshRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp) override;
   void onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender_idx, const uint8_t* secret, uint8_t* data, size_t len) override;
   bool onPeerPathRecv(mesh::Packet* packet, int sender_idx, const uint8_t* secret, uint8_t* path, uint8_t path_len, uint8_t extra_type, uint8_t* extra, uint8_t extra_len) override;
   void onControlDataRecv(mesh::Packet* packet) override;
+  void onTraceRecv(mesh::Packet* packet, uint32_t tag, uint32_t auth_code, uint8_t flags, const uint8_t* path_snrs, const uint8_t* path_hashes, uint8_t path_len) override;
 
 public:
   MyMesh(mesh::MainBoard& board, mesh::Radio& radio, mesh::MillisecondClock& ms, mesh::RNG& rng, mesh::RTCClock& rtc, mesh::MeshTables& tables);
 
   void begin(FILESYSTEM* fs);
 
+  /**
+   * \brief  our radio is duty-cycling its Rx (RadioLibWrapper::setRxDutyCycle()), so advertise that neighbours
+   *     need to use a long preamble to reach us
+  */
+  void setLowPowerRx(bool enable) { low_power_rx = enable; }
+
+  /**
+   * \brief  if idle, deep sleep (MainBoard::enterRxSleep()) until a packet is received, or the next advert is due.
+   *     The state which needs to survive (dedup tables, neighbours, advert timers) is kept in RTC memory, and restored
+   *     by begin() on wakeup.
+   * \returns  false if not idle, or not supported (otherwise doesn't return)
+  */
+  bool enterRxSleep();
+  bool wokeFromSleep() const { return woke_from_sleep; }
+
+  /**
+   * \brief  drive a second radio (eg. on another frequency) as well. Must be called before begin()
+  */
+  void attachSecondRadio(mesh::Radio& radio, mesh::MillisecondClock& ms);
+
   const char* getFirmwareVer() override { return FIRMWARE_VERSION; }
   const char* getBuildDate() override { return FIRMWARE_BUILD_DATE; }
   const char* getRole() override { return FIRMWARE_ROLE; }
@@ -185,19 +460,27 @@ public:
   void updateAdvertTimer() override;
   void updateFloodAdvertTimer() override;
 
-  void setLoggingOn(bool enable) override { _logging = enable; }
+  void setLoggingOn(bool enable) override {
+    _logging = enable;
+    if (!enable) packet_log.flush();
+  }
 
   void eraseLogFile() override {
+    packet_log.erase();
     _fs->remove(PACKET_LOG_FILE);
   }
 
   void dumpLogFile() override;
+  PacketCapture* getPacketCapture() override { return &capture; }
   void setTxPower(uint8_t power_dbm) override;
   void formatNeighborsReply(char *reply) override;
   void removeNeighbor(const uint8_t* pubkey, int key_len) override;
   void formatStatsReply(char *reply) override;
   void formatRadioStatsReply(char *reply) override;
   void formatPacketStatsReply(char *reply) override;
+  void formatDedupStatsReply(char *reply) override;
+  void formatMemoryStatsReply(char *reply) override;
+  void formatProfileStatsReply(char *reply, uint8_t type) override;
 
   mesh::LocalIdentity& getSelfId() override { return self_id; }
 
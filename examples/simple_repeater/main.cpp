@@ -2,14 +2,19 @@
 #include <Mesh.h>
 
 #include "MyMesh.h"
+#include <LoopMonitor.h>
 
 #ifdef DISPLAY_CLASS
   #include "UITask.h"
   static UITask ui_task(display);
 #endif
 
-StdRNG fast_rng;
-SimpleMeshTables tables;
+ChaChaRNG fast_rng;
+#ifdef DEDUP_WINDOW_SECS
+  TimedMeshTables tables(*new ArduinoMillis(), DEDUP_WINDOW_SECS);
+#else
+  SimpleMeshTables tables;
+#endif
 
 MyMesh the_mesh(board, radio_driver, *new ArduinoMillis(), fast_rng, rtc_clock, tables);
 
@@ -19,11 +24,16 @@ void halt() {
 
 static char command[160];
 
+#if RX_SLEEP_IDLE_MILLIS
+static unsigned long rx_sleep_at;
+#endif
+
 void setup() {
   Serial.begin(115200);
-  delay(1000);
-
   board.begin();
+  if (board.getStartupReason() != BD_STARTUP_RX_PACKET) {
+    delay(1000);   // (time for serial monitor to connect, but not when woken, with a packet to forward)
+  }
 
 #ifdef DISPLAY_CLASS
   if (display.begin()) {
@@ -37,8 +47,20 @@ void setup() {
   if (!radio_init()) {
     halt();
   }
+#ifdef WITH_SECOND_RADIO
+  if (!radio2_init()) {   // target provides radio_driver2, for the second radio
+    halt();
+  }
+  the_mesh.attachSecondRadio(radio_driver2, *new ArduinoMillis());
+#endif
 
-  fast_rng.begin(radio_get_rng_seed());
+  {
+    HardwareRNG seed_src(radio_get_rng_seed);   // 32 bytes of TRNG + radio noise
+    fast_rng.begin(seed_src);
+  }
+#if RADIO_RX_DUTY_CYCLE
+  the_mesh.setLowPowerRx(radio_driver.setRxDutyCycle(true));
+#endif
 
   FILESYSTEM* fs;
 #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
@@ -81,10 +103,16 @@ void setup() {
 #endif
 
   // send out initial Advertisement to the mesh
-  the_mesh.sendSelfAdvertisement(16000);
+  if (!the_mesh.wokeFromSleep()) {
+    the_mesh.sendSelfAdvertisement(16000);
+  }
+#if RX_SLEEP_IDLE_MILLIS
+  rx_sleep_at = millis() + RX_SLEEP_IDLE_MILLIS;
+#endif
 }
 
 void loop() {
+  LOOP_START();
   int len = strlen(command);
   while (Serial.available() && len < sizeof(command)-1) {
     char c = Serial.read();
@@ -109,6 +137,9 @@ void loop() {
     }
 
     command[0] = 0;  // reset command buffer
+#if RX_SLEEP_IDLE_MILLIS
+    rx_sleep_at = millis() + RX_SLEEP_IDLE_MILLIS;   // stay awake for a while, for next command
+#endif
   }
 
   the_mesh.loop();
@@ -117,4 +148,19 @@ void loop() {
   ui_task.loop();
 #endif
   rtc_clock.tick();
+  LOOP_END();   // (not counting idle sleep)
+
+#ifdef IDLE_SLEEP_MAX_MILLIS
+  // nothing for the Dispatcher to do until next deadline, so let board idle (this also caps serial CLI latency)
+  board.idle(the_mesh.getMillisToNextWakeup(IDLE_SLEEP_MAX_MILLIS));
+#endif
+
+#if RX_SLEEP_IDLE_MILLIS
+  if (command[0] || !the_mesh.isIdle()) {   // (also stay awake while serial CLI in use)
+    rx_sleep_at = millis() + RX_SLEEP_IDLE_MILLIS;
+  } else if ((long)(millis() - rx_sleep_at) >= 0) {
+    the_mesh.enterRxSleep();   // doesn't return, if it can sleep now
+    rx_sleep_at = millis() + RX_SLEEP_IDLE_MILLIS;
+  }
+#endif
 }
@@ -3,19 +3,23 @@
 #define REPLY_DELAY_MILLIS          1500
 #define PUSH_NOTIFY_DELAY_MILLIS    2000
 #define SYNC_PUSH_INTERVAL          1200
+#define PUSH_IDLE_CHECK_MILLIS      30000   // longest sleep of the push loop, when no client has posts to sync
 
 #define PUSH_ACK_TIMEOUT_FLOOD      12000
 #define PUSH_TIMEOUT_BASE           4000
 #define PUSH_ACK_TIMEOUT_FACTOR     2000
 
 #define POST_SYNC_DELAY_SECS        6
+#define PUSH_WINDOW_GAP_MILLIS    200    // between posts of a window, on top of their airtime (x2, to leave room for ACKs)
 
-#define FIRMWARE_VER_LEVEL       1
+#define FIRMWARE_VER_LEVEL       2   // 2: login response carries a session ticket (see REQ_TYPE_RESUME_LOGIN)
 
 #define REQ_TYPE_GET_STATUS         0x01 // same as _GET_STATS
 #define REQ_TYPE_KEEP_ALIVE         0x02
 #define REQ_TYPE_GET_TELEMETRY_DATA 0x03
 #define REQ_TYPE_GET_ACCESS_LIST    0x05
+#define REQ_TYPE_PREFS              0x08   // bulk get/set of prefs
+#define REQ_TYPE_RESUME_LOGIN       0x09   // login again with the ticket from a previous login response
 
 #define RESP_SERVER_LOGIN_OK        0 // response to ANON_REQ
 
@@ -40,17 +44,25 @@ struct ServerStats {
 
 void MyMesh::addPost(ClientInfo *client, const char *postData) {
   // TODO: suggested postData format: <title>/<descrption>
-  posts[next_post_idx].author = client->id; // add to cyclic queue
-  StrHelper::strncpy(posts[next_post_idx].text, postData, MAX_POST_TEXT_LEN);
+  PostInfo post;
+  post.author = client->id;
+  StrHelper::strncpy(post.text, postData, MAX_POST_TEXT_LEN);
 
-  posts[next_post_idx].post_timestamp = getRTCClock()->getCurrentTimeUnique();
-  next_post_idx = (next_post_idx + 1) % MAX_UNSYNCED_POSTS;
+  post.post_timestamp = getRTCClock()->getCurrentTimeUnique();
+  if (post.post_timestamp <= posts.getLastTimestamp()) {   // clock has gone backwards (eg. reset), keep posts in order
+    post.post_timestamp = posts.getLastTimestamp() + 1;
+  }
+  posts.add(post);   // append to store (oldest is dropped, if full)
 
+  for (int i = 0; i < acl.getNumClients(); i++) {
+    auto c = acl.getClientByIdx(i);
+    if (c != client) c->extra.room.push_idle = 0;   // has something to sync now
+  }
   next_push = futureMillis(PUSH_NOTIFY_DELAY_MILLIS);
   _num_posted++; // stats
 }
 
-void MyMesh::pushPostToClient(ClientInfo *client, PostInfo &post) {
+int MyMesh::encodePost(PostInfo &post, bool compress) {
   int len = 0;
   memcpy(&reply_data[len], &post.post_timestamp, 4);
   len += 4; // this is a PAST timestamp... but should be accepted by client
@@ -64,71 +76,220 @@ void MyMesh::pushPostToClient(ClientInfo *client, PostInfo &post) {
   len += 4; // just first 4 bytes
 
   int text_len = strlen(post.text);
+#if TXT_COMPRESSION
+  if (compress) {
+    int n = TxtCodec::compress(&reply_data[len], MAX_POST_TEXT_LEN, post.text, text_len);
+    if (n > 0) {
+      reply_data[4] |= (TXT_TYPE_COMPRESSED << 2);
+      return len + n;
+    }
+  }
+#endif
   memcpy(&reply_data[len], post.text, text_len);
   len += text_len;
+  return len;
+}
+
+mesh::Packet* MyMesh::createPostPush(ClientInfo *client, PostInfo &post, uint32_t* expected_ack) {
+  int len = encodePost(post, client->extra.room.push_failures == 0);   // plain for retries, incase is older firmware
 
   // calc expected ACK reply
-  mesh::Utils::sha256((uint8_t *)&client->extra.room.pending_ack, 4, reply_data, len, client->id.pub_key, PUB_KEY_SIZE);
-  client->extra.room.push_post_timestamp = post.post_timestamp;
+  mesh::Utils::sha256((uint8_t *)expected_ack, 4, reply_data, len, client->id.pub_key, PUB_KEY_SIZE);
 
-  auto reply = createDatagram(PAYLOAD_TYPE_TXT_MSG, client->id, client->shared_secret, reply_data, len);
-  if (reply) {
-    if (client->out_path_len < 0) {
-      sendFlood(reply);
-      client->extra.room.ack_timeout = futureMillis(PUSH_ACK_TIMEOUT_FLOOD);
-    } else {
-      sendDirect(reply, client->out_path, client->out_path_len);
-      client->extra.room.ack_timeout =
-          futureMillis(PUSH_TIMEOUT_BASE + PUSH_ACK_TIMEOUT_FACTOR * (client->out_path_len + 1));
-    }
-    _num_post_pushes++; // stats
-  } else {
-    client->extra.room.pending_ack = 0;
+  return createDatagram(PAYLOAD_TYPE_TXT_MSG, client->id, client->shared_secret, reply_data, len);
+}
+
+bool MyMesh::pushPostToClient(ClientInfo *client, PostInfo &post, uint32_t& delay_millis) {
+  uint32_t expected_ack;
+  auto reply = createPostPush(client, post, &expected_ack);
+  if (reply == NULL) {
     MESH_DEBUG_PRINTLN("Unable to push post to client");
+    return false;
+  }
+
+  uint32_t t = _radio->getEstAirtimeFor(reply->getRawLength());
+  if (client->out_path_len < 0) {
+    sendFlood(reply, delay_millis);
+    client->extra.room.ack_timeout = futureMillis(delay_millis + PUSH_ACK_TIMEOUT_FLOOD);
+  } else {
+    sendDirect(reply, client->out_path, client->out_path_len, delay_millis);
+    client->extra.room.ack_timeout =
+        futureMillis(delay_millis + PUSH_TIMEOUT_BASE + PUSH_ACK_TIMEOUT_FACTOR * (mesh::Packet::decodePathHops(client->out_path_len) + 1));
+  }
+  delay_millis += 2*t + PUSH_WINDOW_GAP_MILLIS;   // for next push in window
+
+  push_acks.add(expected_ack, client->id.pub_key, post.post_timestamp);
+  client->extra.room.push_post_timestamp = post.post_timestamp;
+  client->extra.room.in_flight++;
+  _num_post_pushes++; // stats
+  return true;
+}
+
+void MyMesh::updateRoomChannel() {
+  // derived from our private key, so is the same across reboots without needing to be stored
+  uint8_t prv_key[PRV_KEY_SIZE];
+  self_id.writeTo(prv_key, PRV_KEY_SIZE);
+  memset(room_channel.secret, 0, sizeof(room_channel.secret));
+  mesh::Utils::sha256(room_channel.secret, ROOM_KEY_SIZE, prv_key, PRV_KEY_SIZE, &_prefs.room_key_epoch, 1);
+  mesh::Utils::sha256(room_channel.hash, sizeof(room_channel.hash), room_channel.secret, ROOM_KEY_SIZE);
+}
+
+bool MyMesh::isBroadcastMember(ClientInfo *client) const {
+  return _prefs.room_broadcast && client->extra.room.group_member;
+}
+
+// send the next post once, as a GRP_TXT under the room key, instead of to each member in turn
+bool MyMesh::broadcastNextPost(uint32_t now) {
+  int k = posts.findAfter(broadcast_since);
+  if (k >= posts.getCount() || now < posts.getTimestamp(k) + POST_SYNC_DELAY_SECS) return false;   // none ready
+  if (!posts.read(k, push_post)) return false;
+  broadcast_since = push_post.post_timestamp;
+
+  auto pkt = createGroupDatagram(PAYLOAD_TYPE_GRP_TXT, room_channel, reply_data, encodePost(push_post, true));
+  if (pkt == NULL) {
+    MESH_DEBUG_PRINTLN("Unable to broadcast post");
+    return false;
   }
+  sendFlood(pkt);
+  _num_post_pushes++; // stats
+  MESH_DEBUG_PRINTLN("loop - broadcast post: %s", push_post.text);
+  return true;
 }
 
-uint8_t MyMesh::getUnsyncedCount(ClientInfo *client) {
-  uint8_t count = 0;
-  for (int k = 0; k < MAX_UNSYNCED_POSTS; k++) {
-    if (posts[k].post_timestamp > client->extra.room.sync_since // is new post for this Client?
-        && !posts[k].author.matches(client->id)) {   // don't push posts to the author
-      count++;
+int MyMesh::getPushWindow(ClientInfo *client) const {
+  return client->out_path_len >= 0 ? PUSH_WINDOW_SIZE : 1;   // flood pushes are costly, so just one at a time
+}
+
+// push the posts after the last one pushed, until client has a window's worth in flight.
+// The client ACKs each as usual (which it may pack into one ACK packet), and sync_since advances as the ACKs arrive.
+int MyMesh::pushWindowToClient(ClientInfo *client, uint32_t now) {
+  int window = getPushWindow(client);
+  uint32_t after = client->extra.room.push_post_timestamp;
+  if (after < client->extra.room.sync_since) after = client->extra.room.sync_since;   // eg. just loaded/paged in
+  uint32_t delay_millis = 0;
+  uint32_t wait_secs = 0;
+  int n = 0;
+  int k;
+  client->extra.room.push_due = futureMillis(SYNC_PUSH_INTERVAL);   // give other clients a turn first
+  for (k = posts.findAfter(after); k < posts.getCount() && client->extra.room.in_flight < window; k++) {   // new posts for this Client
+    uint32_t ready_at = posts.getTimestamp(k) + POST_SYNC_DELAY_SECS;
+    if (now < ready_at) {   // too recent (as are all after it)
+      wait_secs = ready_at - now;
+      break;
     }
+    if (posts.isAuthor(k, client->id)) continue;   // don't push posts to the author
+    if (push_acks.isAcked(client->id.pub_key, posts.getTimestamp(k))) continue;   // a late ACK got here first
+    if (isBroadcastMember(client) && now < ready_at + ROOM_RECONCILE_SECS) {
+      wait_secs = ready_at + ROOM_RECONCILE_SECS - now;
+      break;   // has been broadcast, so only push if client's keep-alive hasn't since reported it received
+    }
+
+    if (!posts.read(k, push_post) || !pushPostToClient(client, push_post, delay_millis)) break;
+    MESH_DEBUG_PRINTLN("loop - pushed to client %02X: %s", (uint32_t)client->id.pub_key[0], push_post.text);
+    n++;
+  }
+
+  if (k >= posts.getCount()) {
+    client->extra.room.push_idle = 1;   // all pushed (or ACKed), so no need to look again till next post
+  } else if (wait_secs > 0 && n == 0) {
+    client->extra.room.push_due = futureMillis(wait_secs < PUSH_IDLE_CHECK_MILLIS/1000 ? wait_secs*1000 : PUSH_IDLE_CHECK_MILLIS);
   }
-  return count;
+  return n;
 }
 
-bool MyMesh::processAck(const uint8_t *data) {
+// of the clients with posts to push, and able to take more, the one which has been waiting longest (or NULL if none)
+ClientInfo* MyMesh::nextPushClient() {
+  ClientInfo* best = NULL;
   for (int i = 0; i < acl.getNumClients(); i++) {
-    auto client = acl.getClientByIdx(i);
-    if (client->extra.room.pending_ack && memcmp(data, &client->extra.room.pending_ack, 4) == 0) { // got an ACK from Client!
-      client->extra.room.pending_ack = 0; // clear this, so next push can happen
-      client->extra.room.push_failures = 0;
-      client->extra.room.sync_since = client->extra.room.push_post_timestamp; // advance Client's SINCE timestamp, to sync next post
-      return true;
+    auto c = acl.getClientByIdx(i);
+    if (c->extra.room.push_idle || c->last_activity == 0 || c->extra.room.push_failures >= 3   // nothing to push, evicted, or retries max
+        || c->extra.room.in_flight >= getPushWindow(c) || !millisHasNowPassed(c->extra.room.push_due)) continue;
+
+    if (best == NULL || (long)(c->extra.room.push_due - best->extra.room.push_due) < 0) best = c;
+  }
+  return best;
+}
+
+// when the push loop next needs to run: for the next client due, or the next ACK timeout
+unsigned long MyMesh::calcNextPushCheck() {
+  unsigned long next = futureMillis(PUSH_IDLE_CHECK_MILLIS);
+  for (int i = 0; i < acl.getNumClients(); i++) {
+    auto c = acl.getClientByIdx(i);
+    if (c->extra.room.in_flight && (long)(c->extra.room.ack_timeout - next) < 0) next = c->extra.room.ack_timeout;
+    if (!c->extra.room.push_idle && c->last_activity != 0 && c->extra.room.push_failures < 3
+        && c->extra.room.in_flight < getPushWindow(c) && (long)(c->extra.room.push_due - next) < 0) next = c->extra.room.push_due;
+  }
+  if (_prefs.room_broadcast && posts.findAfter(broadcast_since) < posts.getCount()) {
+    unsigned long b = futureMillis(SYNC_PUSH_INTERVAL);   // a post still to broadcast
+    if ((long)(b - next) < 0) next = b;
+  }
+  unsigned long soonest = futureMillis(SYNC_PUSH_INTERVAL / 8);
+  return (long)(next - soonest) < 0 ? soonest : next;
+}
+
+void MyMesh::wakePushes(uint32_t delay_millis) {
+  unsigned long t = futureMillis(delay_millis);
+  if ((long)(t - next_push) < 0) next_push = t;   // only ever bring it forward
+}
+
+void MyMesh::advanceSyncSince(ClientInfo *client) {
+  // sync_since can only move over posts which are contiguously ACKed (not counting the client's own posts)
+  for (int k = posts.findAfter(client->extra.room.sync_since); k < posts.getCount(); k++) {
+    if (posts.isAuthor(k, client->id)) continue;
+    if (!push_acks.isAcked(client->id.pub_key, posts.getTimestamp(k))) break;   // still waiting on this one
+
+    client->extra.room.sync_since = posts.getTimestamp(k);
+  }
+  push_acks.removeUpTo(client->id.pub_key, client->extra.room.sync_since);   // no longer needed
+
+  if (client->extra.room.push_post_timestamp < client->extra.room.sync_since) {
+    client->extra.room.push_post_timestamp = client->extra.room.sync_since;   // (late ACKs, after going back)
+  }
+}
+
+void MyMesh::resetPushes(ClientInfo *client) {
+  push_acks.expireClient(client->id.pub_key);   // still count them, if they arrive late
+  client->extra.room.in_flight = 0;
+  client->extra.room.push_post_timestamp = client->extra.room.sync_since;   // go back, and re-send from first un-ACKed
+  client->extra.room.push_idle = 0;
+  wakePushes(SYNC_PUSH_INTERVAL / 8);
+}
+
+uint8_t MyMesh::getUnsyncedCount(ClientInfo *client) {
+  int count = posts.countUnsynced(client->extra.room.sync_since, client->id);   // (excludes posts BY the client)
+  return count > 255 ? 255 : count;
+}
+
+bool MyMesh::processAck(const uint8_t *data) {
+  uint32_t ack;
+  memcpy(&ack, data, 4);
+  auto e = push_acks.find(ack);
+  if (e == NULL) return false;
+  if (e->state == PUSH_ACK_DONE) return true;   // duplicate
+
+  bool was_in_flight = e->state == PUSH_ACK_PENDING;
+  e->state = PUSH_ACK_DONE;
+
+  auto client = acl.getClient(e->client_key, 4);   // got an ACK from Client!
+  if (client) {
+    if (was_in_flight && client->extra.room.in_flight > 0) {
+      client->extra.room.in_flight--;   // window slides along, so next push can happen
+      if (!client->extra.room.push_idle) wakePushes(SYNC_PUSH_INTERVAL / 8);
     }
+    client->extra.room.push_failures = 0;
+    client->last_activity = getRTCClock()->getCurrentTime();   // still listening, so don't page out
+    advanceSyncSince(client);   // advance Client's SINCE timestamp, to sync next post
   }
-  return false;
+  return true;
 }
 
 mesh::Packet *MyMesh::createSelfAdvert() {
   uint8_t app_data[MAX_ADVERT_DATA_SIZE];
-  uint8_t app_data_len = _cli.buildAdvertData(ADV_TYPE_ROOM, app_data);
+  uint8_t app_data_len = _cli.buildAdvertData(ADV_TYPE_ROOM, app_data, ADV_CAP_NET_CODING);
 
   return createAdvert(self_id, app_data, app_data_len);
 }
 
-File MyMesh::openAppend(const char *fname) {
-#if defined(NRF52_PLATFORM)
-  return _fs->open(fname, FILE_O_WRITE);
-#elif defined(RP2040_PLATFORM)
-  return _fs->open(fname, "a");
-#else
-  return _fs->open(fname, "a", true);
-#endif
-}
-
 int MyMesh::handleRequest(ClientInfo *sender, uint32_t sender_timestamp, uint8_t *payload,
                           size_t payload_len) {
   // uint32_t now = getRTCClock()->getCurrentTimeUnique();
@@ -161,17 +322,20 @@ int MyMesh::handleRequest(ClientInfo *sender, uint32_t sender_timestamp, uint8_t
   }
   if (payload[0] == REQ_TYPE_GET_TELEMETRY_DATA) {
     uint8_t perm_mask = ~(payload[1]); // NEW: first reserved byte (of 4), is now inverse mask to apply to permissions
-
-    telemetry.reset();
-    telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
-    // query other sensors -- target specific
     if ((sender->permissions & PERM_ACL_ROLE_MASK) == PERM_ACL_GUEST) {
       perm_mask = 0x00;  // just base telemetry allowed
     }
-    sensors.querySensors(perm_mask, telemetry);
 
-    uint8_t tlen = telemetry.getSize();
-    memcpy(&reply_data[4], telemetry.getBuffer(), tlen);
+    int tlen = telem_cache.get(perm_mask, &reply_data[4], millis());
+    if (tlen == 0) {   // no recent snapshot for these permissions
+      telemetry.resetInto(&reply_data[4], sizeof(reply_data) - 4);   // encode in place
+      telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
+      // query other sensors -- target specific
+      sensors.querySensors(perm_mask, telemetry);
+
+      tlen = telemetry.getSize();
+      telem_cache.put(perm_mask, &reply_data[4], tlen, millis());
+    }
     return 4 + tlen; // reply_len
   }
   if (payload[0] == REQ_TYPE_GET_ACCESS_LIST && sender->isAdmin()) {
@@ -188,10 +352,14 @@ int MyMesh::handleRequest(ClientInfo *sender, uint32_t sender_timestamp, uint8_t
       return ofs;
     }
   }
+  if (payload[0] == REQ_TYPE_PREFS && sender->isAdmin()) {
+    return 4 + _cli.handlePrefsRequest(&payload[1], payload_len - 1, &reply_data[4], sizeof(reply_data) - 4);
+  }
   return 0; // unknown command
 }
 
 void MyMesh::logRxRaw(float snr, float rssi, const uint8_t raw[], int len) {
+  capture.add(snr, rssi, raw, len, getRTCClock()->getCurrentTime(), millis());
 #if MESH_PACKET_LOGGING
   Serial.print(getLogDateTime());
   Serial.print(" RAW: ");
@@ -202,56 +370,22 @@ void MyMesh::logRxRaw(float snr, float rssi, const uint8_t raw[], int len) {
 
 void MyMesh::logRx(mesh::Packet *pkt, int len, float score) {
   if (_logging) {
-    File f = openAppend(PACKET_LOG_FILE);
-    if (f) {
-      f.print(getLogDateTime());
-      f.printf(": RX, len=%d (type=%d, route=%s, payload_len=%d) SNR=%d RSSI=%d score=%d", len,
-               pkt->getPayloadType(), pkt->isRouteDirect() ? "D" : "F", pkt->payload_len,
-               (int)_radio->getLastSNR(), (int)_radio->getLastRSSI(), (int)(score * 1000));
-
-      if (pkt->getPayloadType() == PAYLOAD_TYPE_PATH || pkt->getPayloadType() == PAYLOAD_TYPE_REQ ||
-          pkt->getPayloadType() == PAYLOAD_TYPE_RESPONSE || pkt->getPayloadType() == PAYLOAD_TYPE_TXT_MSG) {
-        f.printf(" [%02X -> %02X]\n", (uint32_t)pkt->payload[1], (uint32_t)pkt->payload[0]);
-      } else {
-        f.printf("\n");
-      }
-      f.close();
-    }
+    packet_log.logRx(pkt, len, _radio->getLastSNR(), _radio->getLastRSSI(), score, getRTCClock()->getCurrentTime());
   }
 }
 void MyMesh::logTx(mesh::Packet *pkt, int len) {
   if (_logging) {
-    File f = openAppend(PACKET_LOG_FILE);
-    if (f) {
-      f.print(getLogDateTime());
-      f.printf(": TX, len=%d (type=%d, route=%s, payload_len=%d)", len, pkt->getPayloadType(),
-               pkt->isRouteDirect() ? "D" : "F", pkt->payload_len);
-
-      if (pkt->getPayloadType() == PAYLOAD_TYPE_PATH || pkt->getPayloadType() == PAYLOAD_TYPE_REQ ||
-          pkt->getPayloadType() == PAYLOAD_TYPE_RESPONSE || pkt->getPayloadType() == PAYLOAD_TYPE_TXT_MSG) {
-        f.printf(" [%02X -> %02X]\n", (uint32_t)pkt->payload[1], (uint32_t)pkt->payload[0]);
-      } else {
-        f.printf("\n");
-      }
-      f.close();
-    }
+    packet_log.logTx(pkt, len, getRTCClock()->getCurrentTime());
   }
 }
 void MyMesh::logTxFail(mesh::Packet *pkt, int len) {
   if (_logging) {
-    File f = openAppend(PACKET_LOG_FILE);
-    if (f) {
-      f.print(getLogDateTime());
-      f.printf(": TX FAIL!, len=%d (type=%d, route=%s, payload_len=%d)\n", len, pkt->getPayloadType(),
-               pkt->isRouteDirect() ? "D" : "F", pkt->payload_len);
-      f.close();
-    }
+    packet_log.logTxFail(pkt, len, getRTCClock()->getCurrentTime());
   }
 }
 
-int MyMesh::calcRxDelay(float score, uint32_t air_time) const {
-  if (_prefs.rx_delay_base <= 0.0f) return 0;
-  return (int)((pow(_prefs.rx_delay_base, 0.85f - score) - 1.0) * air_time);
+float MyMesh::getRxDelayBase() const {
+  return _prefs.rx_delay_base;
 }
 
 const char *MyMesh::getLogDateTime() {
@@ -290,7 +424,8 @@ void MyMesh::onAnonDataRecv(mesh::Packet *packet, const uint8_t *secret, const m
 
     ClientInfo* client = NULL;
     if (data[8] == 0) {   // blank password, just check if sender is in ACL
-      client = acl.getClient(sender.pub_key, PUB_KEY_SIZE);
+      client = acl.getClient(sender.pub_key, PUB_KEY_SIZE);   // (paged in, if dormant)
+      if (client) client->last_activity = getRTCClock()->getCurrentTime();   // (so not evicted again straight away)
       if (client == NULL) {
       #if MESH_DEBUG
         MESH_DEBUG_PRINTLN("Login, sender not in ACL");
@@ -312,7 +447,7 @@ void MyMesh::onAnonDataRecv(mesh::Packet *packet, const uint8_t *secret, const m
         }
       }
 
-      client = acl.putClient(sender, 0);  // add to known clients (if not already known)
+      client = acl.putClient(sender, 0);   // add to known clients (or page in a dormant one, keeping their sync_since)
       if (sender_timestamp <= client->last_timestamp) {
         MESH_DEBUG_PRINTLN("possible replay attack!");
         return;
@@ -320,9 +455,7 @@ void MyMesh::onAnonDataRecv(mesh::Packet *packet, const uint8_t *secret, const m
 
       MESH_DEBUG_PRINTLN("Login success!");
       client->last_timestamp = sender_timestamp;
-      client->extra.room.sync_since = sender_sync_since;
-      client->extra.room.pending_ack = 0;
-      client->extra.room.push_failures = 0;
+      startSession(client, sender_sync_since);
 
       client->last_activity = getRTCClock()->getCurrentTime();
       client->permissions &= ~0x03;
@@ -336,26 +469,15 @@ void MyMesh::onAnonDataRecv(mesh::Packet *packet, const uint8_t *secret, const m
       client->out_path_len = -1;  // need to rediscover out_path
     }
 
-    uint32_t now = getRTCClock()->getCurrentTimeUnique();
-    memcpy(reply_data, &now, 4); // response packets always prefixed with timestamp
-    // TODO: maybe reply with count of messages waiting to be synced for THIS client?
-    reply_data[4] = RESP_SERVER_LOGIN_OK;
-    reply_data[5] = 0; // Legacy: was recommended keep-alive interval (secs / 16)
-    reply_data[6] = (client->isAdmin() ? 1 : (client->permissions == 0 ? 2 : 0));
-    // LEGACY: reply_data[7] = getUnsyncedCount(client);
-    reply_data[7] = client->permissions; // NEW
-    getRNG()->random(&reply_data[8], 4);   // random blob to help packet-hash uniqueness
-    reply_data[12] = FIRMWARE_VER_LEVEL;  // New field
-
-    next_push = futureMillis(PUSH_NOTIFY_DELAY_MILLIS); // delay next push, give RESPONSE packet time to arrive first
+    int reply_len = formatLoginReply(client);
 
     if (packet->isRouteFlood()) {
       // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the response
-      mesh::Packet *path = createPathReturn(sender, client->shared_secret, packet->path, packet->path_len,
-                                            PAYLOAD_TYPE_RESPONSE, reply_data, 13);
+      mesh::Packet *path = createPathReturn(sender, client->shared_secret, packet->path, packet->getEncodedPathLen(),
+                                            PAYLOAD_TYPE_RESPONSE, reply_data, reply_len);
       if (path) sendFlood(path, SERVER_RESPONSE_DELAY);
     } else {
-      mesh::Packet *reply = createDatagram(PAYLOAD_TYPE_RESPONSE, sender, client->shared_secret, reply_data, 13);
+      mesh::Packet *reply = createDatagram(PAYLOAD_TYPE_RESPONSE, sender, client->shared_secret, reply_data, reply_len);
       if (reply) {
         if (client->out_path_len >= 0) { // we have an out_path, so send DIRECT
           sendDirect(reply, client->out_path, client->out_path_len, SERVER_RESPONSE_DELAY);
@@ -367,7 +489,57 @@ void MyMesh::onAnonDataRecv(mesh::Packet *packet, const uint8_t *secret, const m
   }
 }
 
+void MyMesh::startSession(ClientInfo* client, uint32_t sync_since) {
+  client->extra.room.sync_since = sync_since;
+  push_acks.removeUpTo(client->id.pub_key, 0xFFFFFFFF);   // start over
+  resetPushes(client);
+  client->extra.room.push_failures = 0;
+  client->extra.room.group_member = 0;
+}
+
+int MyMesh::formatLoginReply(ClientInfo* client) {
+  uint32_t now = getRTCClock()->getCurrentTimeUnique();
+  memcpy(reply_data, &now, 4); // response packets always prefixed with timestamp
+  // TODO: maybe reply with count of messages waiting to be synced for THIS client?
+  reply_data[4] = RESP_SERVER_LOGIN_OK;
+  reply_data[5] = 0; // Legacy: was recommended keep-alive interval (secs / 16)
+  reply_data[6] = (client->isAdmin() ? 1 : (client->permissions == 0 ? 2 : 0));
+  // LEGACY: reply_data[7] = getUnsyncedCount(client);
+  reply_data[7] = client->permissions; // NEW
+  uint32_t ticket = ClientACL::calcSessionTicket(self_id, client);   // (was a random blob, before ver level 2)
+  memcpy(&reply_data[8], &ticket, 4);
+  reply_data[12] = FIRMWARE_VER_LEVEL;  // New field
+  int reply_len = 13;
+  if (_prefs.room_broadcast) {   // give them the room key, so new posts just need sending once to everyone
+    memcpy(&reply_data[reply_len], room_channel.secret, ROOM_KEY_SIZE);
+    reply_len += ROOM_KEY_SIZE;
+    client->extra.room.group_member = 1;
+  }
+
+  next_push = futureMillis(PUSH_NOTIFY_DELAY_MILLIS); // delay next push, give RESPONSE packet time to arrive first
+  return reply_len;
+}
+
+int MyMesh::handleResumeReq(ClientInfo* client, const uint8_t* payload, size_t payload_len, bool is_flood) {
+  uint32_t ticket, sync_since;
+  if (payload_len < 9) return 0;
+  memcpy(&ticket, &payload[1], 4);
+  memcpy(&sync_since, &payload[5], 4);   // as in ANON_REQ login
+  if (ticket != ClientACL::calcSessionTicket(self_id, client)) {   // stale, eg. permissions since changed
+    MESH_DEBUG_PRINTLN("Resume login, invalid ticket");
+    return 0;   // client will fall back to a full login
+  }
+
+  MESH_DEBUG_PRINTLN("Resume login success!");
+  startSession(client, sync_since);
+  if (is_flood) {
+    client->out_path_len = -1;  // need to rediscover out_path
+  }
+  return formatLoginReply(client);
+}
+
 int MyMesh::searchPeersByHash(const uint8_t *hash) {
+  acl.pageInByHash(hash, PATH_HASH_SIZE);   // any dormant clients with this hash (NOTE: may evict others)
   int n = 0;
   for (int i = 0; i < acl.getNumClients(); i++) {
     if (acl.getClientByIdx(i)->id.isHashMatch(hash)) {
@@ -395,12 +567,20 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
     return;
   }
   auto client = acl.getClientByIdx(i);
+  mesh::RequestView req;
   if (type == PAYLOAD_TYPE_TXT_MSG && len > 5) { // a CLI command or new Post
     uint32_t sender_timestamp;
     memcpy(&sender_timestamp, data, 4); // timestamp (by sender's RTC clock - which could be wrong)
     uint8_t flags = (data[4] >> 2);        // message attempt number, and other flags
+    bool compressed = (flags & TXT_TYPE_COMPRESSED) != 0;
+    flags &= ~TXT_TYPE_COMPRESSED;
+
+    // len can be > original length, but 'text' will be padded with zeroes
+    data[len] = 0; // need to make a C string again, with null terminator
+    char text_buf[TXT_CODEC_MAX_TEXT+1];
+    char* text = TxtCodec::unpack((char *)&data[5], compressed, text_buf, sizeof(text_buf));
 
-    if (!(flags == TXT_TYPE_PLAIN || flags == TXT_TYPE_CLI_DATA)) {
+    if (!(flags == TXT_TYPE_PLAIN || flags == TXT_TYPE_CLI_DATA) || text == NULL) {
       MESH_DEBUG_PRINTLN("onPeerDataRecv: unsupported command flags received: flags=%02x", (uint32_t)flags);
     } else if (sender_timestamp >= client->last_timestamp) { // prevent replay attacks, but send Acks for retries
       bool is_retry = (sender_timestamp == client->last_timestamp);
@@ -410,9 +590,6 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
       client->last_activity = now;
       client->extra.room.push_failures = 0; // reset so push can resume (if prev failed)
 
-      // len can be > original length, but 'text' will be padded with zeroes
-      data[len] = 0; // need to make a C string again, with null terminator
-
       uint32_t ack_hash; // calc truncated hash of the message timestamp + text + sender pub_key, to prove to
                          // sender that we got it
       mesh::Utils::sha256((uint8_t *)&ack_hash, 4, data, 5 + strlen((char *)&data[5]), client->id.pub_key,
@@ -425,7 +602,7 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
           if (is_retry) {
             temp[5] = 0; // no reply
           } else {
-            handleCommand(sender_timestamp, (char *)&data[5], (char *)&temp[5]);
+            handleCommand(sender_timestamp, text, (char *)&temp[5]);
             temp[4] = (TXT_TYPE_CLI_DATA << 2); // attempt and flags,  (NOTE: legacy was: TXT_TYPE_PLAIN)
           }
           send_ack = false;
@@ -439,7 +616,7 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
           send_ack = false; // no ACK
         } else {
           if (!is_retry) {
-            addPost(client, (const char *)&data[5]);
+            addPost(client, text);
           }
           temp[5] = 0; // no reply (ACK is enough)
           send_ack = true;
@@ -450,10 +627,11 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
       if (send_ack) {
         if (client->out_path_len < 0) {
           mesh::Packet *ack = createAck(ack_hash);
-          if (ack) sendFlood(ack, TXT_ACK_DELAY);
-          delay_millis = TXT_ACK_DELAY + REPLY_DELAY_MILLIS;
+          uint32_t d = getAckDelay(packet, TXT_ACK_DELAY);
+          if (ack) sendFlood(ack, d);
+          delay_millis = d + REPLY_DELAY_MILLIS;
         } else {
-          uint32_t d = TXT_ACK_DELAY;
+          uint32_t d = getAckDelay(packet, TXT_ACK_DELAY);
           if (getExtraAckTransmitCount() > 0) {
             mesh::Packet *a1 = createMultiAck(ack_hash, 1);
             if (a1) sendDirect(a1, client->out_path, client->out_path_len, d);
@@ -492,9 +670,8 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
     } else {
       MESH_DEBUG_PRINTLN("onPeerDataRecv: possible replay attack detected");
     }
-  } else if (type == PAYLOAD_TYPE_REQ && len >= 5) {
-    uint32_t sender_timestamp;
-    memcpy(&sender_timestamp, data, 4); // timestamp (by sender's RTC clock - which could be wrong)
+  } else if (type == PAYLOAD_TYPE_REQ && req.init(data, len)) {
+    uint32_t sender_timestamp = req.timestamp(); // timestamp (by sender's RTC clock - which could be wrong)
     if (sender_timestamp < client->last_timestamp) { // prevent replay attacks
       MESH_DEBUG_PRINTLN("onPeerDataRecv: possible replay attack detected");
     } else {
@@ -504,18 +681,19 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
       client->last_activity = now; // <-- THIS will keep client connection alive
       client->extra.room.push_failures = 0;   // reset so push can resume (if prev failed)
 
-      if (data[4] == REQ_TYPE_KEEP_ALIVE && packet->isRouteDirect()) { // request type
+      if (req.type() == REQ_TYPE_KEEP_ALIVE && packet->isRouteDirect()) { // request type
         uint32_t forceSince = 0;
-        if (len >= 9) {                     // optional - last post_timestamp client received
-          memcpy(&forceSince, &data[5], 4); // NOTE: this may be 0, if part of decrypted PADDING!
+        if (req.bodyLen() >= 4) {                 // optional - last post_timestamp client received
+          memcpy(&forceSince, req.body(), 4);     // NOTE: this may be 0, if part of decrypted PADDING!
         } else {
-          memcpy(&data[5], &forceSince, 4); // make sure there are zeroes in payload (for ack_hash calc below)
+          memcpy(req.body(), &forceSince, 4);     // make sure there are zeroes in payload (for ack_hash calc below)
         }
         if (forceSince > 0) {
           client->extra.room.sync_since = forceSince; // force-update the 'sync since'
+          push_acks.removeUpTo(client->id.pub_key, forceSince);
         }
 
-        client->extra.room.pending_ack = 0;
+        resetPushes(client);
 
         // TODO: Throttle KEEP_ALIVE requests!
         // if client sends too quickly, evict()
@@ -532,11 +710,12 @@ void MyMesh::onPeerDataRecv(mesh::Packet *packet, uint8_t type, int sender_idx,
           }
         }
       } else {
-        int reply_len = handleRequest(client, sender_timestamp, &data[4], len - 4);
+        int reply_len = req.type() == REQ_TYPE_RESUME_LOGIN ? handleResumeReq(client, req.request(), req.requestLen(), packet->isRouteFlood())
+                                                            : handleRequest(client, sender_timestamp, req.request(), req.requestLen());
         if (reply_len > 0) { // valid command
           if (packet->isRouteFlood()) {
             // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the response
-            mesh::Packet *path = createPathReturn(client->id, secret, packet->path, packet->path_len,
+            mesh::Packet *path = createPathReturn(client->id, secret, packet->path, packet->getEncodedPathLen(),
                                                   PAYLOAD_TYPE_RESPONSE, reply_data, reply_len);
             if (path) sendFlood(path, SERVER_RESPONSE_DELAY);
           } else {
@@ -563,7 +742,8 @@ bool MyMesh::onPeerPathRecv(mesh::Packet *packet, int sender_idx, const uint8_t
   if (i >= 0 && i < acl.getNumClients()) { // get from our known_clients table (sender SHOULD already be known in this context)
     MESH_DEBUG_PRINTLN("PATH to client, path_len=%d", (uint32_t)path_len);
     auto client = acl.getClientByIdx(i);
-    memcpy(client->out_path, path, client->out_path_len = path_len); // store a copy of path, for sendDirect()
+    memcpy(client->out_path, path, mesh::Packet::decodePathBytes(path_len)); // store a copy of path, for sendDirect()
+    client->out_path_len = path_len;
     client->last_activity = getRTCClock()->getCurrentTime();
   } else {
     MESH_DEBUG_PRINTLN("onPeerPathRecv: invalid peer idx: %d", i);
@@ -586,8 +766,8 @@ void MyMesh::onAckRecv(mesh::Packet *packet, uint32_t ack_crc) {
 
 MyMesh::MyMesh(mesh::MainBoard &board, mesh::Radio &radio, mesh::MillisecondClock &ms, mesh::RNG &rng,
                mesh::RTCClock &rtc, mesh::MeshTables &tables)
-    : mesh::Mesh(radio, ms, rng, rtc, *new StaticPoolPacketManager(32), tables),
-      _cli(board, rtc, sensors, &_prefs, this), telemetry(MAX_PACKET_PAYLOAD - 4) {
+    : mesh::Mesh(radio, ms, rng, rtc, *new StaticPoolPacketManager(PACKET_POOL_SIZE), tables),
+      _cli(board, rtc, sensors, &_prefs, this), telemetry() {
   last_millis = 0;
   uptime_millis = 0;
   next_local_advert = next_flood_advert = 0;
@@ -615,6 +795,7 @@ MyMesh::MyMesh(mesh::MainBoard &board, mesh::Radio &radio, mesh::MillisecondCloc
   _prefs.flood_advert_interval = 12; // 12 hours
   _prefs.flood_max = 64;
   _prefs.interference_threshold = 0; // disabled
+  _prefs.qos_aging = QOS_AGING_MILLIS;
 #ifdef ROOM_PASSWORD
   StrHelper::strncpy(_prefs.guest_password, ROOM_PASSWORD, sizeof(_prefs.guest_password));
 #endif
@@ -624,20 +805,32 @@ MyMesh::MyMesh(mesh::MainBoard &board, mesh::Radio &radio, mesh::MillisecondCloc
   _prefs.gps_interval = 0;
   _prefs.advert_loc_policy = ADVERT_LOC_PREFS;
 
-  next_post_idx = 0;
-  next_client_idx = 0;
   next_push = 0;
-  memset(posts, 0, sizeof(posts));
+  next_evict_check = 0;
   _num_posted = _num_post_pushes = 0;
+  setCodingStore(&coding_store);
 }
 
 void MyMesh::begin(FILESYSTEM *fs) {
   mesh::Mesh::begin();
   _fs = fs;
+  flash_writer.begin();   // saves are written behind, from here on
+  packet_log.begin(fs);
+  {
+    int num;
+    const MemTable* tables = getMemTables(num);
+    MemoryStats::debugPrint(tables, num);
+  }
   // load persisted prefs
   _cli.loadPrefs(_fs);
+  _cli.addCommand("setperm", CLICommandTable::method<MyMesh, &MyMesh::handleSetPermCmd>, this, CLI_HAS_PARAMS);
+  _cli.addCommand("room.rekey", CLICommandTable::method<MyMesh, &MyMesh::handleRoomRekeyCmd>, this);
 
   acl.load(_fs);
+  acl.setDormantStore(_fs);   // page out inactive clients, instead of forgetting them
+  posts.begin(_fs);
+  broadcast_since = posts.getLastTimestamp();   // (don't re-broadcast old posts)
+  updateRoomChannel();
 
   radio_set_params(_prefs.freq, _prefs.bw, _prefs.sf, _prefs.cr);
   radio_set_tx_power(_prefs.tx_power_dbm);
@@ -700,19 +893,7 @@ void MyMesh::updateFloodAdvertTimer() {
 }
 
 void MyMesh::dumpLogFile() {
-#if defined(RP2040_PLATFORM)
-  File f = _fs->open(PACKET_LOG_FILE, "r");
-#else
-  File f = _fs->open(PACKET_LOG_FILE);
-#endif
-  if (f) {
-    while (f.available()) {
-      int c = f.read();
-      if (c < 0) break;
-      Serial.print((char)c);
-    }
-    f.close();
-  }
+  packet_log.dump(Serial);
 }
 
 void MyMesh::setTxPower(uint8_t power_dbm) {
@@ -731,11 +912,13 @@ void MyMesh::saveIdentity(const mesh::LocalIdentity &new_id) {
 #error "need to define saveIdentity()"
 #endif
   store.save("_main", self_id);
+  updateRoomChannel();
 }
 
 void MyMesh::clearStats() {
   radio_driver.resetStats();
   resetStats();
+  mesh::LoopMonitor::get().reset();
   ((SimpleMeshTables *)getTables())->resetStats();
 }
 
@@ -749,7 +932,38 @@ void MyMesh::formatRadioStatsReply(char *reply) {
 
 void MyMesh::formatPacketStatsReply(char *reply) {
   StatsFormatHelper::formatPacketStats(reply, radio_driver, getNumSentFlood(), getNumSentDirect(), 
-                                       getNumRecvFlood(), getNumRecvDirect());
+                                       getNumRecvFlood(), getNumRecvDirect(), getNumInboundLate());
+}
+
+const MemTable* MyMesh::getMemTables(int& num) const {
+  static constexpr MemTable tables[] = {
+    { "clients", sizeof(ClientACL) },
+    { "posts", sizeof(PostStore) },
+    { "push_acks", sizeof(PushAckTable) },
+    { "mesh_tables", sizeof(SimpleMeshTables) },
+    { "packet_pool", sizeof(mesh::Packet) * PACKET_POOL_SIZE },
+    { "flash_writer", FLASH_WRITER_BUF_SIZE },
+  };
+  static_assert(RAM_TABLES_BUDGET == 0 || memTablesTotal(tables, sizeof(tables) / sizeof(tables[0])) <= RAM_TABLES_BUDGET,
+                "tables exceed RAM_TABLES_BUDGET, reduce MAX_CLIENTS, MAX_UNSYNCED_POSTS, etc.");
+  num = sizeof(tables) / sizeof(tables[0]);
+  return tables;
+}
+
+void MyMesh::formatMemoryStatsReply(char *reply) {
+  MemoryStats mem;
+  mem.read();
+  int num;
+  const MemTable* tables = getMemTables(num);
+  StatsFormatHelper::formatMemoryStats(reply, mem, memTablesTotal(tables, num));
+}
+
+void MyMesh::formatProfileStatsReply(char *reply, uint8_t type) {
+#if MESH_PROFILING
+  StatsFormatHelper::formatProfileStats(reply, getRecvProfiler(), type);
+#else
+  strcpy(reply, "Error: needs a MESH_PROFILING=1 build");
+#endif
 }
 
 void MyMesh::handleCommand(uint32_t sender_timestamp, char *command, char *reply) {
@@ -763,29 +977,7 @@ void MyMesh::handleCommand(uint32_t sender_timestamp, char *command, char *reply
   }
 
   // handle ACL related commands
-  if (memcmp(command, "setperm ", 8) == 0) {   // format:  setperm {pubkey-hex} {permissions-int8}
-    char* hex = &command[8];
-    char* sp = strchr(hex, ' ');   // look for separator char
-    if (sp == NULL) {
-      strcpy(reply, "Err - bad params");
-    } else {
-      *sp++ = 0;   // replace space with null terminator
-
-      uint8_t pubkey[PUB_KEY_SIZE];
-      int hex_len = min(sp - hex, PUB_KEY_SIZE*2);
-      if (mesh::Utils::fromHex(pubkey, hex_len / 2, hex)) {
-        uint8_t perms = atoi(sp);
-        if (acl.applyPermissions(self_id, pubkey, hex_len / 2, perms)) {
-          dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);   // trigger acl.save()
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Err - invalid params");
-        }
-      } else {
-        strcpy(reply, "Err - bad pubkey");
-      }
-    }
-  } else if (sender_timestamp == 0 && strcmp(command, "get acl") == 0) {
+  if (sender_timestamp == 0 && strcmp(command, "get acl") == 0) {
     Serial.println("ACL:");
     for (int i = 0; i < acl.getNumClients(); i++) {
       auto c = acl.getClientByIdx(i);
@@ -796,59 +988,83 @@ void MyMesh::handleCommand(uint32_t sender_timestamp, char *command, char *reply
       Serial.printf("\n");
     }
     reply[0] = 0;
-  } else{
-    _cli.handleCommand(sender_timestamp, command, reply);  // common CLI commands
+  } else {
+    _cli.handleCommand(sender_timestamp, command, reply);  // common CLI commands, and those added in begin()
   }
 }
 
+void MyMesh::handleSetPermCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  // format:  setperm {pubkey-hex} {permissions-int8}
+  char* hex = &command[8];
+  char* sp = strchr(hex, ' ');   // look for separator char
+  if (sp == NULL) {
+    strcpy(reply, "Err - bad params");
+  } else {
+    *sp++ = 0;   // replace space with null terminator
+
+    uint8_t pubkey[PUB_KEY_SIZE];
+    int hex_len = min(sp - hex, PUB_KEY_SIZE*2);
+    if (mesh::Utils::fromHex(pubkey, hex_len / 2, hex)) {
+      uint8_t perms = atoi(sp);
+      if (acl.applyPermissions(self_id, pubkey, hex_len / 2, perms)) {
+        dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);   // trigger acl.save()
+        strcpy(reply, "OK");
+      } else {
+        strcpy(reply, "Err - invalid params");
+      }
+    } else {
+      strcpy(reply, "Err - bad pubkey");
+    }
+  }
+}
+
+void MyMesh::handleRoomRekeyCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  _prefs.room_key_epoch++;
+  savePrefs();
+  updateRoomChannel();
+  for (int i = 0; i < acl.getNumClients(); i++) {
+    acl.getClientByIdx(i)->extra.room.group_member = 0;   // have old key, so back to pushes until they login again
+  }
+  strcpy(reply, "OK - new room key");
+}
+
 bool MyMesh::saveFilter(ClientInfo* client) {
   return client->isAdmin();    // only save Admins
 }
 
+bool MyMesh::keepInRAM(ClientInfo* client) {
+  return client->extra.room.in_flight != 0;   // waiting on ACKs of pushes
+}
+
 void MyMesh::loop() {
   mesh::Mesh::loop();
+  packet_log.loop(millis());
+  flash_writer.loop();
 
   if (millisHasNowPassed(next_push) && acl.getNumClients() > 0) {
     // check for ACK timeouts
     for (int i = 0; i < acl.getNumClients(); i++) {
       auto c = acl.getClientByIdx(i);
-      if (c->extra.room.pending_ack && millisHasNowPassed(c->extra.room.ack_timeout)) {
-        c->extra.room.push_failures++;
-        c->extra.room.pending_ack = 0; // reset  (TODO: keep prev expected_ack's in a list, incase they arrive LATER, after we retry)
+      if (c->extra.room.in_flight && millisHasNowPassed(c->extra.room.ack_timeout)) {
+        c->extra.room.push_failures++;   // (is reset by any ACK, so only counts if window made no progress)
+        resetPushes(c);
+        c->extra.room.push_due = futureMillis(SYNC_PUSH_INTERVAL << c->extra.room.push_failures);   // back off
         MESH_DEBUG_PRINTLN("pending ACK timed out: push_failures: %d", (uint32_t)c->extra.room.push_failures);
       }
     }
-    // check next Round-Robin client, and sync next new post
-    auto client = acl.getClientByIdx(next_client_idx);
-    bool did_push = false;
-    if (client->extra.room.pending_ack == 0 && client->last_activity != 0 &&
-        client->extra.room.push_failures < 3) { // not already waiting for ACK, AND not evicted, AND retries not max
+
+    uint32_t now = getRTCClock()->getCurrentTime();
+    bool did_push = _prefs.room_broadcast && broadcastNextPost(now);
+
+    // sync next new posts, to the clients that have any, longest waiting first
+    // (each client checked either pushes, goes idle, or has its push_due moved on, so this ends)
+    ClientInfo* client;
+    while (!did_push && (client = nextPushClient()) != NULL) {
       MESH_DEBUG_PRINTLN("loop - checking for client %02X", (uint32_t)client->id.pub_key[0]);
-      uint32_t now = getRTCClock()->getCurrentTime();
-      for (int k = 0, idx = next_post_idx; k < MAX_UNSYNCED_POSTS; k++) {
-        auto p = &posts[idx];
-        if (now >= p->post_timestamp + POST_SYNC_DELAY_SECS &&
-            p->post_timestamp > client->extra.room.sync_since // is new post for this Client?
-            && !p->author.matches(client->id)) {   // don't push posts to the author
-          // push this post to Client, then wait for ACK
-          pushPostToClient(client, *p);
-          did_push = true;
-          MESH_DEBUG_PRINTLN("loop - pushed to client %02X: %s", (uint32_t)client->id.pub_key[0], p->text);
-          break;
-        }
-        idx = (idx + 1) % MAX_UNSYNCED_POSTS; // wrap to start of cyclic queue
-      }
-    } else {
-      MESH_DEBUG_PRINTLN("loop - skipping busy (or evicted) client %02X", (uint32_t)client->id.pub_key[0]);
+      if (pushWindowToClient(client, now) > 0) did_push = true;
     }
-    next_client_idx = (next_client_idx + 1) % acl.getNumClients(); // round robin polling for each client
 
-    if (did_push) {
-      next_push = futureMillis(SYNC_PUSH_INTERVAL);
-    } else {
-      // were no unsynced posts for curr client, so proccess next client much quicker! (in next loop())
-      next_push = futureMillis(SYNC_PUSH_INTERVAL / 8);
-    }
+    next_push = did_push ? futureMillis(SYNC_PUSH_INTERVAL) : calcNextPushCheck();
   }
 
   if (next_flood_advert && millisHasNowPassed(next_flood_advert)) {
@@ -882,7 +1098,13 @@ void MyMesh::loop() {
     dirty_contacts_expiry = 0;
   }
 
-  // TODO: periodically check for OLD/inactive entries in known_clients[], and evict
+  if (millisHasNowPassed(next_evict_check)) {
+    int n = acl.evictInactive(getRTCClock()->getCurrentTime(), CLIENT_IDLE_EVICT_SECS, MyMesh::keepInRAM);
+    if (n > 0) {
+      MESH_DEBUG_PRINTLN("loop - paged out %d inactive clients", n);
+    }
+    next_evict_check = futureMillis(CLIENT_EVICT_CHECK_MILLIS);
+  }
 
   // update uptime
   uint32_t now = millis();
@@ -2,6 +2,7 @@
 
 #include <Arduino.h>   // needed for PlatformIO
 #include <Mesh.h>
+#include <PayloadViews.h>
 
 #if defined(NRF52_PLATFORM)
   #include <InternalFileSystem.h>
@@ -12,14 +13,21 @@
 #endif
 
 #include <helpers/ArduinoHelpers.h>
+#include <helpers/ChaChaRNG.h>
 #include <helpers/StaticPoolPacketManager.h>
 #include <helpers/SimpleMeshTables.h>
 #include <helpers/IdentityStore.h>
+#include <helpers/PacketLog.h>
 #include <helpers/AdvertDataHelpers.h>
 #include <helpers/TxtDataHelpers.h>
+#include <helpers/TxtCodec.h>
 #include <helpers/CommonCLI.h>
+#include <helpers/FlashWriter.h>
 #include <helpers/StatsFormatHelper.h>
+#include <helpers/TelemetryCache.h>
 #include <helpers/ClientACL.h>
+#include "PostStore.h"
+#include "PushAckTable.h"
 #include <RTClib.h>
 #include <target.h>
 
@@ -63,10 +71,6 @@
   #define  ADMIN_PASSWORD  "password"
 #endif
 
-#ifndef MAX_UNSYNCED_POSTS
-  #define MAX_UNSYNCED_POSTS    32
-#endif
-
 #ifndef SERVER_RESPONSE_DELAY
   #define SERVER_RESPONSE_DELAY   300
 #endif
@@ -77,15 +81,26 @@
 
 #define FIRMWARE_ROLE "room_server"
 
-#define PACKET_LOG_FILE  "/packet_log"
+#ifndef PACKET_POOL_SIZE
+  #define PACKET_POOL_SIZE   32
+#endif
+
+#define PACKET_LOG_FILE  "/packet_log"    // old text log, now replaced by PacketLog
 
-#define MAX_POST_TEXT_LEN    (160-9)
 
-struct PostInfo {
-  mesh::Identity author;
-  uint32_t post_timestamp;   // by OUR clock
-  char text[MAX_POST_TEXT_LEN+1];
-};
+#ifndef CLIENT_IDLE_EVICT_SECS
+  #define CLIENT_IDLE_EVICT_SECS   (4*60*60)   // clients inactive for this long are paged out of RAM, to flash
+#endif
+#define CLIENT_EVICT_CHECK_MILLIS  60000
+#ifndef ROOM_RECONCILE_SECS
+  #define ROOM_RECONCILE_SECS   (5*60)   // time a broadcast member has to report a post received, before it's pushed to them
+#endif
+#define ROOM_KEY_SIZE           16
+
+#ifndef PUSH_WINDOW_SIZE
+  #define PUSH_WINDOW_SIZE    4     // max posts in flight (un-ACKed) to a client with a direct path
+#endif
+
 
 class MyMesh : public mesh::Mesh, public CommonCLICallbacks {
   FILESYSTEM* _fs;
@@ -93,17 +108,24 @@ class MyMesh : public mesh::Mesh, public CommonCLICallbacks {
   uint64_t uptime_millis;
   unsigned long next_local_advert, next_flood_advert;
   bool _logging;
+  PacketLog packet_log;
+  PacketCapture capture;
   NodePrefs _prefs;
   CommonCLI _cli;
   ClientACL acl;
   unsigned long dirty_contacts_expiry;
   uint8_t reply_data[MAX_PACKET_PAYLOAD];
   unsigned long next_push;
+  unsigned long next_evict_check;
   uint16_t _num_posted, _num_post_pushes;
-  int next_client_idx;  // for round-robin polling
-  int next_post_idx;
-  PostInfo posts[MAX_UNSYNCED_POSTS];   // cyclic queue
-  CayenneLPP telemetry;
+  PostStore posts;
+  PostInfo push_post;   // post being pushed, as read from 'posts'
+  PushAckTable push_acks;   // of posts pushed, to all clients
+  mesh::CodingStore coding_store;   // so CODED frames from repeaters can be decoded
+  mesh::GroupChannel room_channel;   // for broadcast mode
+  uint32_t broadcast_since;          // timestamp of last post broadcast
+  LPPSlice telemetry;
+  TelemetryCache telem_cache;
   unsigned long set_radio_at, revert_radio_at;
   float pending_freq;
   float pending_bw;
@@ -112,12 +134,29 @@ class MyMesh : public mesh::Mesh, public CommonCLICallbacks {
   int  matching_peer_indexes[MAX_CLIENTS];
 
   void addPost(ClientInfo* client, const char* postData);
-  void pushPostToClient(ClientInfo* client, PostInfo& post);
+  int encodePost(PostInfo& post, bool compress);
+  mesh::Packet* createPostPush(ClientInfo* client, PostInfo& post, uint32_t* expected_ack);
+  bool pushPostToClient(ClientInfo* client, PostInfo& post, uint32_t& delay_millis);
+  void updateRoomChannel();
+  bool isBroadcastMember(ClientInfo* client) const;
+  bool broadcastNextPost(uint32_t now);
+  int getPushWindow(ClientInfo* client) const;
+  int pushWindowToClient(ClientInfo* client, uint32_t now);
+  void advanceSyncSince(ClientInfo* client);
+  void resetPushes(ClientInfo* client);
+  ClientInfo* nextPushClient();
+  unsigned long calcNextPushCheck();
+  void wakePushes(uint32_t delay_millis);
   uint8_t getUnsyncedCount(ClientInfo* client);
   bool processAck(const uint8_t *data);
   mesh::Packet* createSelfAdvert();
-  File openAppend(const char* fname);
+  void startSession(ClientInfo* client, uint32_t sync_since);
+  int formatLoginReply(ClientInfo* client);
+  int handleResumeReq(ClientInfo* client, const uint8_t* payload, size_t payload_len, bool is_flood);
   int handleRequest(ClientInfo* sender, uint32_t sender_timestamp, uint8_t* payload, size_t payload_len);
+  void handleSetPermCmd(uint32_t sender_timestamp, char* command, char* reply);
+  const MemTable* getMemTables(int& num) const;
+  void handleRoomRekeyCmd(uint32_t sender_timestamp, char* command, char* reply);
 
 protected:
   float getAirtimeBudgetFactor() const override {
@@ -129,7 +168,7 @@ protected:
   void logTx(mesh::Packet* pkt, int len) override;
   void logTxFail(mesh::Packet* pkt, int len) override;
 
-  int calcRxDelay(float score, uint32_t air_time) const override;
+  float getRxDelayBase() const override;
   const char* getLogDateTime() override;
   uint32_t getRetransmitDelay(const mesh::Packet* packet) override;
   uint32_t getDirectRetransmitDelay(const mesh::Packet* packet) override;
@@ -140,6 +179,9 @@ protected:
   int getAGCResetInterval() const override {
     return ((int)_prefs.agc_reset_interval) * 4000;   // milliseconds
   }
+  uint32_t getOutboundAgingMillis() const override {
+    return _prefs.qos_aging;
+  }
   uint8_t getExtraAckTransmitCount() const override {
     return _prefs.multi_acks;
   }
@@ -181,13 +223,18 @@ public:
   void updateAdvertTimer() override;
   void updateFloodAdvertTimer() override;
 
-  void setLoggingOn(bool enable) override { _logging = enable; }
+  void setLoggingOn(bool enable) override {
+    _logging = enable;
+    if (!enable) packet_log.flush();
+  }
 
   void eraseLogFile() override {
+    packet_log.erase();
     _fs->remove(PACKET_LOG_FILE);
   }
 
   void dumpLogFile() override;
+  PacketCapture* getPacketCapture() override { return &capture; }
   void setTxPower(uint8_t power_dbm) override;
 
   void formatNeighborsReply(char *reply) override {
@@ -196,10 +243,13 @@ public:
   void formatStatsReply(char *reply) override;
   void formatRadioStatsReply(char *reply) override;
   void formatPacketStatsReply(char *reply) override;
+  void formatMemoryStatsReply(char *reply) override;
+  void formatProfileStatsReply(char *reply, uint8_t type) override;
 
   mesh::LocalIdentity& getSelfId() override { return self_id; }
 
   static bool saveFilter(ClientInfo* client);
+  static bool keepInRAM(ClientInfo* client);
 
   void saveIdentity(const mesh::LocalIdentity& new_id) override;
   void clearStats() override;
@@ -0,0 +1,143 @@
+#include "PostStore.h"
+
+#define POST_STORE_FILE     "/posts"
+#define POST_STORE_VER      1
+#define POST_HEADER_SIZE    8    // ver(1), reserved(1), head(2), num(2), reserved(2)
+#define POST_RECORD_SIZE    (PUB_KEY_SIZE + 4 + MAX_POST_TEXT_LEN + 1)
+
+static File openReadWrite(FILESYSTEM* fs, const char* filename) {   // for updating in place
+#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+  return fs->open(filename, FILE_O_WRITE);
+#elif defined(RP2040_PLATFORM)
+  return fs->open(filename, fs->exists(filename) ? "r+" : "w+");
+#else
+  return fs->open(filename, fs->exists(filename) ? "r+" : "w+", true);
+#endif
+}
+
+static File openRead(FILESYSTEM* fs, const char* filename) {
+#if defined(RP2040_PLATFORM)
+  return fs->open(filename, "r");
+#else
+  return fs->open(filename);
+#endif
+}
+
+void PostStore::begin(FILESYSTEM* fs) {
+  _fs = fs;
+  _head = _num = 0;
+  if (!_fs->exists(POST_STORE_FILE)) return;
+
+  File file = openRead(_fs, POST_STORE_FILE);
+  if (!file) return;
+
+  uint8_t hdr[POST_HEADER_SIZE];
+  if (file.read(hdr, POST_HEADER_SIZE) == POST_HEADER_SIZE && hdr[0] == POST_STORE_VER) {
+    uint16_t head, num;
+    memcpy(&head, &hdr[2], 2);
+    memcpy(&num, &hdr[4], 2);
+    if (head < MAX_UNSYNCED_POSTS && num <= MAX_UNSYNCED_POSTS) {
+      _head = head;
+      for (int i = 0; i < num; i++) {   // load index
+        uint8_t key_ts[PUB_KEY_SIZE + 4];
+        int pos = toPos(i);
+        if (!file.seek(POST_HEADER_SIZE + pos * POST_RECORD_SIZE) || file.read(key_ts, sizeof(key_ts)) != sizeof(key_ts)) {
+          MESH_DEBUG_PRINTLN("PostStore::begin(): short file, only %d posts", i);
+          break;
+        }
+        memcpy(&_authors[pos], key_ts, 4);
+        memcpy(&_timestamps[pos], &key_ts[PUB_KEY_SIZE], 4);
+        _num++;
+      }
+    }
+  }
+  file.close();
+}
+
+bool PostStore::writeHeader(File& file) {
+  uint8_t hdr[POST_HEADER_SIZE];
+  memset(hdr, 0, sizeof(hdr));
+  hdr[0] = POST_STORE_VER;
+  uint16_t head = _head, num = _num;
+  memcpy(&hdr[2], &head, 2);
+  memcpy(&hdr[4], &num, 2);
+  return file.seek(0) && file.write(hdr, POST_HEADER_SIZE) == POST_HEADER_SIZE;
+}
+
+bool PostStore::add(const PostInfo& post) {
+  if (_num > 0 && post.post_timestamp <= getLastTimestamp()) return false;   // must be in timestamp order
+
+  int pos = toPos(_num);   // if full, this is the oldest
+  if (_num < MAX_UNSYNCED_POSTS) {
+    _num++;
+  } else {
+    _head = (_head + 1) % MAX_UNSYNCED_POSTS;
+  }
+  memcpy(&_authors[pos], post.author.pub_key, 4);
+  _timestamps[pos] = post.post_timestamp;
+
+  if (_fs == NULL) return false;
+  File file = openReadWrite(_fs, POST_STORE_FILE);
+  if (!file) return false;
+
+  uint8_t rec[POST_RECORD_SIZE];
+  memset(rec, 0, sizeof(rec));
+  memcpy(rec, post.author.pub_key, PUB_KEY_SIZE);
+  memcpy(&rec[PUB_KEY_SIZE], &post.post_timestamp, 4);
+  StrHelper::strncpy((char *) &rec[PUB_KEY_SIZE + 4], post.text, MAX_POST_TEXT_LEN + 1);
+
+  bool success = writeHeader(file);   // (first, so that file exists up to the record)
+  if (success && file.size() < POST_HEADER_SIZE + pos * POST_RECORD_SIZE) {
+    success = false;   // would leave a hole
+  }
+  success = success && file.seek(POST_HEADER_SIZE + pos * POST_RECORD_SIZE) && file.write(rec, POST_RECORD_SIZE) == POST_RECORD_SIZE;
+  file.close();
+  if (!success) {
+    MESH_DEBUG_PRINTLN("PostStore::add(): write failed, pos=%d", pos);
+  }
+  return success;
+}
+
+void PostStore::clear() {
+  _head = _num = 0;
+  if (_fs) _fs->remove(POST_STORE_FILE);
+}
+
+int PostStore::findAfter(uint32_t since) const {
+  int lo = 0, hi = _num;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (getTimestamp(mid) > since) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+int PostStore::countUnsynced(uint32_t since, const mesh::Identity& reader) const {
+  int n = 0;
+  for (int i = findAfter(since); i < _num; i++) {
+    if (!isAuthor(i, reader)) n++;
+  }
+  return n;
+}
+
+bool PostStore::read(int i, PostInfo& dest) {
+  if (_fs == NULL || i < 0 || i >= _num) return false;
+
+  File file = openRead(_fs, POST_STORE_FILE);
+  if (!file) return false;
+
+  uint8_t rec[POST_RECORD_SIZE];
+  bool success = file.seek(POST_HEADER_SIZE + toPos(i) * POST_RECORD_SIZE) && file.read(rec, POST_RECORD_SIZE) == POST_RECORD_SIZE;
+  file.close();
+  if (!success) return false;
+
+  dest.author = mesh::Identity(rec);
+  memcpy(&dest.post_timestamp, &rec[PUB_KEY_SIZE], 4);
+  memcpy(dest.text, &rec[PUB_KEY_SIZE + 4], MAX_POST_TEXT_LEN);
+  dest.text[MAX_POST_TEXT_LEN] = 0;
+  return true;
+}
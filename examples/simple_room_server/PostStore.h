@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>   // needed for PlatformIO
+#include <Mesh.h>
+#include <helpers/IdentityStore.h>
+#include <helpers/TxtDataHelpers.h>
+
+#ifndef MAX_UNSYNCED_POSTS
+  #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+    #define MAX_UNSYNCED_POSTS    64
+  #else
+    #define MAX_UNSYNCED_POSTS    256
+  #endif
+#endif
+
+#define MAX_POST_TEXT_LEN    (160-9)
+
+struct PostInfo {
+  mesh::Identity author;
+  uint32_t post_timestamp;   // by OUR clock
+  char text[MAX_POST_TEXT_LEN+1];
+};
+
+/**
+ * \brief  The room's posts, as a ring of fixed size records in a file (so they survive a reboot), oldest overwritten
+ *     first. Posts are only ever appended, in timestamp order, so a RAM index of timestamps (and author prefixes) can be
+ *     binary searched for the first post a client hasn't yet been sent. Post text is only read from file when pushed.
+*/
+class PostStore {
+  FILESYSTEM* _fs;
+  uint32_t _timestamps[MAX_UNSYNCED_POSTS];   // by ring position
+  uint32_t _authors[MAX_UNSYNCED_POSTS];      // first 4 bytes of author's pub_key
+  int _head, _num;   // ring position of oldest, number of posts
+
+  int toPos(int i) const { return (_head + i) % MAX_UNSYNCED_POSTS; }
+  bool writeHeader(File& file);
+
+public:
+  PostStore() { _fs = NULL; _head = _num = 0; }
+
+  void begin(FILESYSTEM* fs);
+  bool add(const PostInfo& post);
+  void clear();
+
+  int getCount() const { return _num; }
+  uint32_t getTimestamp(int i) const { return _timestamps[toPos(i)]; }   // i = 0 is oldest
+  uint32_t getLastTimestamp() const { return _num > 0 ? getTimestamp(_num - 1) : 0; }
+  bool isAuthor(int i, const mesh::Identity& id) const { return memcmp(&_authors[toPos(i)], id.pub_key, 4) == 0; }
+
+  /**
+   * \returns  index of first post with timestamp after 'since', or getCount() if none
+  */
+  int findAfter(uint32_t since) const;
+
+  /**
+   * \returns  number of posts after 'since', not by 'reader'
+  */
+  int countUnsynced(uint32_t since, const mesh::Identity& reader) const;
+
+  bool read(int i, PostInfo& dest);
+};
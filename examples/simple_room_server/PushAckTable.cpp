@@ -0,0 +1,74 @@
+#include "PushAckTable.h"
+
+#define SLOT_MASK   (PUSH_ACK_TABLE_SIZE - 1)
+
+void PushAckTable::clear() {
+  memset(_slots, 0, sizeof(_slots));
+  _next_seq = 0;
+}
+
+void PushAckTable::removeAt(int i) {
+  _slots[i].state = PUSH_ACK_DELETED;
+  // if end of a probe run, can make slots UNUSED again (so lookups don't have to probe through them)
+  while (_slots[i].state == PUSH_ACK_DELETED && _slots[(i + 1) & SLOT_MASK].state == PUSH_ACK_UNUSED) {
+    _slots[i].state = PUSH_ACK_UNUSED;
+    i = (i - 1) & SLOT_MASK;
+  }
+}
+
+void PushAckTable::add(uint32_t ack, const uint8_t* client_key, uint32_t post_timestamp) {
+  PushAck* dest = NULL;
+  int i = ack & SLOT_MASK;
+  for (int n = 0; n < PUSH_ACK_TABLE_SIZE; n++, i = (i + 1) & SLOT_MASK) {
+    if (_slots[i].state == PUSH_ACK_UNUSED || _slots[i].state == PUSH_ACK_DELETED) {
+      dest = &_slots[i];
+      break;
+    }
+  }
+  if (dest == NULL) {   // full, so replace the oldest
+    dest = &_slots[0];
+    for (int j = 1; j < PUSH_ACK_TABLE_SIZE; j++) {
+      if ((uint16_t)(_next_seq - _slots[j].seq) > (uint16_t)(_next_seq - dest->seq)) dest = &_slots[j];
+    }
+  }
+  dest->ack = ack;
+  dest->post_timestamp = post_timestamp;
+  memcpy(dest->client_key, client_key, sizeof(dest->client_key));
+  dest->state = PUSH_ACK_PENDING;
+  dest->seq = _next_seq++;
+}
+
+PushAck* PushAckTable::find(uint32_t ack) {
+  int i = ack & SLOT_MASK;
+  for (int n = 0; n < PUSH_ACK_TABLE_SIZE; n++, i = (i + 1) & SLOT_MASK) {
+    auto s = &_slots[i];
+    if (s->state == PUSH_ACK_UNUSED) break;   // end of probe run
+    if (s->state != PUSH_ACK_DELETED && s->ack == ack) return s;
+  }
+  return NULL;  // not found
+}
+
+bool PushAckTable::isAcked(const uint8_t* client_key, uint32_t post_timestamp) const {
+  for (int i = 0; i < PUSH_ACK_TABLE_SIZE; i++) {
+    auto s = &_slots[i];
+    if (s->state == PUSH_ACK_DONE && s->post_timestamp == post_timestamp && memcmp(s->client_key, client_key, 4) == 0) return true;
+  }
+  return false;
+}
+
+void PushAckTable::expireClient(const uint8_t* client_key) {
+  for (int i = 0; i < PUSH_ACK_TABLE_SIZE; i++) {
+    auto s = &_slots[i];
+    if (s->state == PUSH_ACK_PENDING && memcmp(s->client_key, client_key, 4) == 0) s->state = PUSH_ACK_LATE;
+  }
+}
+
+void PushAckTable::removeUpTo(const uint8_t* client_key, uint32_t timestamp) {
+  for (int i = 0; i < PUSH_ACK_TABLE_SIZE; i++) {
+    auto s = &_slots[i];
+    if (s->state != PUSH_ACK_UNUSED && s->state != PUSH_ACK_DELETED && s->post_timestamp <= timestamp
+        && memcmp(s->client_key, client_key, 4) == 0) {
+      removeAt(i);
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>   // needed for PlatformIO
+#include <string.h>
+
+#ifndef PUSH_ACK_TABLE_SIZE
+  #define PUSH_ACK_TABLE_SIZE   32    // must be a power of 2
+#endif
+
+#define PUSH_ACK_UNUSED     0
+#define PUSH_ACK_PENDING    1    // push in flight
+#define PUSH_ACK_LATE       2    // timed out (and post will be re-sent), but ACK may yet arrive
+#define PUSH_ACK_DONE       3    // ACKed, but client's sync_since hasn't yet caught up to it
+#define PUSH_ACK_DELETED    4
+
+struct PushAck {
+  uint32_t ack;              // expected ACK CRC
+  uint32_t post_timestamp;
+  uint8_t client_key[4];     // pub_key prefix
+  uint8_t state;             // PUSH_ACK_*
+  uint16_t seq;              // order added, so oldest can be replaced when full
+};
+
+/**
+ * \brief  The expected ACKs of all posts pushed to clients, hashed by ACK CRC (open addressing), so an incoming ACK is
+ *     one lookup instead of a compare against every client. Entries are kept after their push times out, so an ACK which
+ *     arrives after the re-send is still counted, and are removed once the client's sync_since has passed the post.
+*/
+class PushAckTable {
+  PushAck _slots[PUSH_ACK_TABLE_SIZE];
+  uint16_t _next_seq;
+
+  void removeAt(int i);
+
+public:
+  PushAckTable() { clear(); }
+
+  void clear();
+  void add(uint32_t ack, const uint8_t* client_key, uint32_t post_timestamp);
+  PushAck* find(uint32_t ack);
+
+  bool isAcked(const uint8_t* client_key, uint32_t post_timestamp) const;
+
+  /**
+   * \brief  client's pushes have timed out, so change any PENDING entries to LATE
+  */
+  void expireClient(const uint8_t* client_key);
+
+  /**
+   * \brief  remove client's entries for posts up to (and including) 'timestamp'
+  */
+  void removeUpTo(const uint8_t* client_key, uint32_t timestamp);
+};
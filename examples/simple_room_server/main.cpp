@@ -2,13 +2,14 @@
 #include <Mesh.h>
 
 #include "MyMesh.h"
+#include <LoopMonitor.h>
 
 #ifdef DISPLAY_CLASS
   #include "UITask.h"
   static UITask ui_task(display);
 #endif
 
-StdRNG fast_rng;
+ChaChaRNG fast_rng;
 SimpleMeshTables tables;
 MyMesh the_mesh(board, radio_driver, *new ArduinoMillis(), fast_rng, rtc_clock, tables);
 
@@ -35,7 +36,10 @@ void setup() {
 
   if (!radio_init()) { halt(); }
 
-  fast_rng.begin(radio_get_rng_seed());
+  {
+    HardwareRNG seed_src(radio_get_rng_seed);   // 32 bytes of TRNG + radio noise
+    fast_rng.begin(seed_src);
+  }
 
   FILESYSTEM* fs;
 #if defined(NRF52_PLATFORM)
@@ -81,6 +85,7 @@ void setup() {
 }
 
 void loop() {
+  LOOP_START();
   int len = strlen(command);
   while (Serial.available() && len < sizeof(command)-1) {
     char c = Serial.read();
@@ -111,4 +116,5 @@ void loop() {
   ui_task.loop();
 #endif
   rtc_clock.tick();
+  LOOP_END();
 }
@@ -10,6 +10,7 @@
 #endif
 
 #include <helpers/ArduinoHelpers.h>
+#include <helpers/ChaChaRNG.h>
 #include <helpers/StaticPoolPacketManager.h>
 #include <helpers/SimpleMeshTables.h>
 #include <helpers/IdentityStore.h>
@@ -136,20 +137,20 @@ class MyMesh : public BaseChatMesh, ContactVisitor {
 #endif
     if (file) {
       ContactsIterator iter;
-      ContactInfo c;
+      const ContactInfo* c;
       uint8_t unused = 0;
       uint32_t reserved = 0;
 
-      while (iter.hasNext(this, c)) {
-        bool success = (file.write(c.id.pub_key, 32) == 32);
-        success = success && (file.write((uint8_t *) &c.name, 32) == 32);
-        success = success && (file.write(&c.type, 1) == 1);
-        success = success && (file.write(&c.flags, 1) == 1);
+      while ((c = iter.next(this)) != NULL) {
+        bool success = (file.write(c->id.pub_key, 32) == 32);
+        success = success && (file.write((uint8_t *) &c->name, 32) == 32);
+        success = success && (file.write(&c->type, 1) == 1);
+        success = success && (file.write(&c->flags, 1) == 1);
         success = success && (file.write(&unused, 1) == 1);
         success = success && (file.write((uint8_t *) &reserved, 4) == 4);
-        success = success && (file.write((uint8_t *) &c.out_path_len, 1) == 1);
-        success = success && (file.write((uint8_t *) &c.last_advert_timestamp, 4) == 4);
-        success = success && (file.write(c.out_path, 64) == 64);
+        success = success && (file.write((uint8_t *) &c->out_path_len, 1) == 1);
+        success = success && (file.write((uint8_t *) &c->last_advert_timestamp, 4) == 4);
+        success = success && (file.write(c->out_path, 64) == 64);
 
         if (!success) break;  // write failed
       }
@@ -267,7 +268,7 @@ protected:
   }
   uint32_t calcDirectTimeoutMillisFor(uint32_t pkt_airtime_millis, uint8_t path_len) const override {
     return SEND_TIMEOUT_BASE_MILLIS + 
-         ( (pkt_airtime_millis*DIRECT_SEND_PERHOP_FACTOR + DIRECT_SEND_PERHOP_EXTRA_MILLIS) * (path_len + 1));
+         ( (pkt_airtime_millis*DIRECT_SEND_PERHOP_FACTOR + DIRECT_SEND_PERHOP_EXTRA_MILLIS) * (mesh::Packet::decodePathHops(path_len) + 1));
   }
 
   void onSendTimeout() override {
@@ -275,7 +276,7 @@ protected:
   }
 
 public:
-  MyMesh(mesh::Radio& radio, StdRNG& rng, mesh::RTCClock& rtc, SimpleMeshTables& tables)
+  MyMesh(mesh::Radio& radio, ChaChaRNG& rng, mesh::RTCClock& rtc, SimpleMeshTables& tables)
      : BaseChatMesh(radio, *new ArduinoMillis(), rng, rtc, *new StaticPoolPacketManager(16), tables)
   {
     // defaults
@@ -312,7 +313,7 @@ public:
       while (c != '\n') {   // wait for ENTER to be pressed
         if (Serial.available()) c = Serial.read();
       }
-      ((StdRNG *)getRNG())->begin(millis());
+      ((ChaChaRNG *)getRNG())->begin(millis());
 
       self_id = mesh::LocalIdentity(getRNG());  // create new random identity
       int count = 0;
@@ -546,7 +547,7 @@ public:
   }
 };
 
-StdRNG fast_rng;
+ChaChaRNG fast_rng;
 SimpleMeshTables tables;
 MyMesh the_mesh(radio_driver, fast_rng, rtc_clock, tables);
 
@@ -561,7 +562,10 @@ void setup() {
 
   if (!radio_init()) { halt(); }
 
-  fast_rng.begin(radio_get_rng_seed());
+  {
+    HardwareRNG seed_src(radio_get_rng_seed);   // 32 bytes of TRNG + radio noise
+    fast_rng.begin(seed_src);
+  }
 
 #if defined(NRF52_PLATFORM)
   InternalFS.begin();
@@ -46,7 +46,7 @@
 
 /* ------------------------------ Code -------------------------------- */
 
-#define FIRMWARE_VER_LEVEL       1
+#define FIRMWARE_VER_LEVEL       2   // 2: login response carries a session ticket (see REQ_TYPE_RESUME_LOGIN)
 
 #define REQ_TYPE_LOGIN               0x00
 #define REQ_TYPE_GET_STATUS          0x01
@@ -54,6 +54,13 @@
 #define REQ_TYPE_GET_TELEMETRY_DATA  0x03
 #define REQ_TYPE_GET_AVG_MIN_MAX     0x04
 #define REQ_TYPE_GET_ACCESS_LIST     0x05
+#define REQ_TYPE_GET_SERIES_HISTORY  0x06
+#define REQ_TYPE_PREFS               0x08   // bulk get/set of prefs
+#define REQ_TYPE_RESUME_LOGIN        0x09   // login again with the ticket from a previous login response
+
+#define HISTORY_FORMAT_ZIGZAG_DELTAS   1   // varint of zigzag(sample - previous), newest first
+#define HISTORY_HEADER_SIZE         29
+#define HISTORY_CHUNK               32
 
 #define RESP_SERVER_LOGIN_OK      0   // response to ANON_REQ
 
@@ -170,20 +177,91 @@ static uint8_t putFloat(uint8_t * dest, float value, uint8_t size, uint32_t mult
   return size;
 }
 
+static int putVarint(uint8_t* dest, uint32_t v) {
+  int n = 0;
+  while (v >= 0x80) {
+    dest[n++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  dest[n++] = v;
+  return n;
+}
+
+int SensorMesh::buildHistoryBlock(uint8_t* dest, int max_len, uint32_t sender_timestamp, const uint8_t* payload, size_t payload_len) {
+  if (payload_len < 7) return 0;
+
+  uint8_t idx = payload[0];
+  uint32_t before_ts;    // the 'resume' token from previous block, or zero for the newest
+  memcpy(&before_ts, &payload[1], 4);
+  uint16_t max_samples;
+  memcpy(&max_samples, &payload[5], 2);
+  if (max_samples == 0) max_samples = 0xFFFF;   // as many as will fit
+
+  uint8_t channel, lpp_type;
+  auto series = querySeries(idx, channel, lpp_type);
+  if (series == NULL) return 0;
+
+  // header:  tag(4), channel, lpp_type, format, interval(4), scale(4), offset(4), newest_ts(4), resume_ts(4), num(2)
+  memcpy(dest, &sender_timestamp, 4);   // reflect sender_timestamp back (as 'tag')
+  dest[4] = channel;
+  dest[5] = lpp_type;
+  dest[6] = HISTORY_FORMAT_ZIGZAG_DELTAS;
+  uint32_t interval = series->getInterval();
+  float scale = series->getScale(), offset = series->getOffset();
+  memcpy(&dest[7], &interval, 4);
+  memcpy(&dest[11], &scale, 4);
+  memcpy(&dest[15], &offset, 4);
+
+  uint32_t newest_ts = 0, resume_ts = before_ts;
+  int ofs = HISTORY_HEADER_SIZE;
+  int num = 0;
+  int16_t prev = 0;
+  int16_t chunk[HISTORY_CHUNK];
+  // each sample is at most 3 bytes, so only read as many as are sure to fit
+  while (num < max_samples && max_len - ofs >= 3) {
+    int want = (max_len - ofs) / 3;
+    if (want > HISTORY_CHUNK) want = HISTORY_CHUNK;
+    if (want > max_samples - num) want = max_samples - num;
+
+    uint32_t first_ts, last_ts;
+    int n = series->readHistory(resume_ts, chunk, want, first_ts, last_ts);
+    if (n == 0) break;   // no more
+    if (num == 0) newest_ts = first_ts;
+    resume_ts = last_ts;
+
+    for (int i = 0; i < n; i++) {
+      int32_t delta = (int32_t) chunk[i] - prev;
+      ofs += putVarint(&dest[ofs], (uint32_t)((delta << 1) ^ (delta >> 31)));   // zigzag
+      prev = chunk[i];
+    }
+    num += n;
+  }
+  if (num == 0) resume_ts = 0;   // end of history
+
+  uint16_t num16 = num;
+  memcpy(&dest[19], &newest_ts, 4);
+  memcpy(&dest[23], &resume_ts, 4);
+  memcpy(&dest[27], &num16, 2);
+  return ofs;
+}
+
 uint8_t SensorMesh::handleRequest(uint8_t perms, uint32_t sender_timestamp, uint8_t req_type, uint8_t* payload, size_t payload_len) {
   memcpy(reply_data, &sender_timestamp, 4);   // reflect sender_timestamp back in response packet (kind of like a 'tag')
 
   if (req_type == REQ_TYPE_GET_TELEMETRY_DATA) {  // allow all
     uint8_t perm_mask = ~(payload[0]);    // NEW: first reserved byte (of 4), is now inverse mask to apply to permissions
 
-    telemetry.reset();
-    telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
-    // query other sensors -- target specific
-    sensors.querySensors(0xFF & perm_mask, telemetry);  // allow all telemetry permissions for admin or guest
-    // TODO: let requester know permissions they have:  telemetry.addPresence(TELEM_CHANNEL_SELF, perms);
+    int tlen = telem_cache.get(perm_mask, &reply_data[4], millis());
+    if (tlen == 0) {   // no recent snapshot for these permissions
+      reply_lpp.resetInto(&reply_data[4], sizeof(reply_data) - 4);   // encode in place
+      reply_lpp.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
+      // query other sensors -- target specific
+      sensors.querySensors(0xFF & perm_mask, reply_lpp);  // allow all telemetry permissions for admin or guest
+      // TODO: let requester know permissions they have:  reply_lpp.addPresence(TELEM_CHANNEL_SELF, perms);
 
-    uint8_t tlen = telemetry.getSize();
-    memcpy(&reply_data[4], telemetry.getBuffer(), tlen);
+      tlen = reply_lpp.getSize();
+      telem_cache.put(perm_mask, &reply_data[4], tlen, millis());
+    }
     return 4 + tlen;  // reply_len
   }
   if (req_type == REQ_TYPE_GET_AVG_MIN_MAX && (perms & PERM_ACL_ROLE_MASK) >= PERM_ACL_READ_ONLY) {
@@ -212,6 +290,8 @@ uint8_t SensorMesh::handleRequest(uint8_t perms, uint32_t sender_timestamp, uint
       reply_data[ofs++] = d->_channel;
       reply_data[ofs++] = d->_lpp_type;
       uint8_t sz = getDataSize(d->_lpp_type);
+      if (ofs + 2 + 3*sz > sizeof(reply_data)) break;   // no room for this entry's fields
+
       uint32_t mult = getMultiplier(d->_lpp_type);
       bool is_signed = isSigned(d->_lpp_type);
       ofs += putFloat(&reply_data[ofs], d->_min, sz, mult, is_signed);
@@ -220,6 +300,9 @@ uint8_t SensorMesh::handleRequest(uint8_t perms, uint32_t sender_timestamp, uint
     }
     return ofs;
   }
+  if (req_type == REQ_TYPE_GET_SERIES_HISTORY && (perms & PERM_ACL_ROLE_MASK) >= PERM_ACL_READ_ONLY) {
+    return buildHistoryBlock(reply_data, sizeof(reply_data), sender_timestamp, payload, payload_len);   // one packet's worth
+  }
   if (req_type == REQ_TYPE_GET_ACCESS_LIST && (perms & PERM_ACL_ROLE_MASK) == PERM_ACL_ADMIN) {
     uint8_t res1 = payload[0];   // reserved for future  (extra query params)
     uint8_t res2 = payload[1];
@@ -234,27 +317,43 @@ uint8_t SensorMesh::handleRequest(uint8_t perms, uint32_t sender_timestamp, uint
       return ofs;
     }
   }
+  if (req_type == REQ_TYPE_PREFS && (perms & PERM_ACL_ROLE_MASK) == PERM_ACL_ADMIN) {
+    return 4 + _cli.handlePrefsRequest(payload, payload_len, &reply_data[4], sizeof(reply_data) - 4);
+  }
   return 0;  // unknown command
 }
 
 mesh::Packet* SensorMesh::createSelfAdvert() {
   uint8_t app_data[MAX_ADVERT_DATA_SIZE];
+#if SENSOR_MULTIPART_HISTORY
+  uint8_t app_data_len = _cli.buildAdvertData(ADV_TYPE_SENSOR, app_data, ADV_CAP_FRAGMENTS);
+#else
   uint8_t app_data_len = _cli.buildAdvertData(ADV_TYPE_SENSOR, app_data);
+#endif
 
   return createAdvert(self_id, app_data, app_data_len);
 }
 
-void SensorMesh::sendAlert(const ClientInfo* c, Trigger* t) {
-  int text_len = strlen(t->text);
+#if SENSOR_MULTIPART_HISTORY
+void SensorMesh::onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp, const uint8_t* app_data, size_t app_data_len) {
+  AdvertDataParser parser(app_data, app_data_len);
+  if (parser.isValid()) {
+    peer_caps.update(id.pub_key, parser.hasFragments() ? PEER_CAP_FRAGMENTS : 0);
+  }
+}
+#endif
+
+void SensorMesh::sendAlert(const ClientInfo* c, AlertDelivery* d) {
+  int text_len = strlen(d->text);
 
   uint8_t data[MAX_PACKET_PAYLOAD];
-  memcpy(data, &t->timestamp, 4);
-  data[4] = (TXT_TYPE_PLAIN << 2) | t->attempt;  // attempt and flags
-  memcpy(&data[5], t->text, text_len);
+  memcpy(data, &d->timestamp, 4);
+  data[4] = (TXT_TYPE_PLAIN << 2) | d->attempt;  // attempt and flags
+  memcpy(&data[5], d->text, text_len);
 
   // calc expected ACK reply
-  mesh::Utils::sha256((uint8_t *)&t->expected_acks[t->attempt], 4, data, 5 + text_len, self_id.pub_key, PUB_KEY_SIZE);
-  t->attempt++;
+  mesh::Utils::sha256((uint8_t *)&d->expected_acks[d->attempt], 4, data, 5 + text_len, self_id.pub_key, PUB_KEY_SIZE);
+  d->attempt++;
 
   auto pkt = createDatagram(PAYLOAD_TYPE_TXT_MSG, c->id, c->shared_secret, data, 5 + text_len);
   if (pkt) {
@@ -264,35 +363,118 @@ void SensorMesh::sendAlert(const ClientInfo* c, Trigger* t) {
       sendFlood(pkt);
     }
   }
-  t->send_expiry = futureMillis(ALERT_ACK_EXPIRY_MILLIS);
+  d->send_expiry = futureMillis(ALERT_ACK_EXPIRY_MILLIS);
 }
 
 void SensorMesh::alertIf(bool condition, Trigger& t, AlertPriority pri, const char* text) {
   if (condition) {
-    if (!t.isTriggered() && num_alert_tasks < MAX_CONCURRENT_ALERTS) {
+    if (!t.isTriggered() && (t.queued || num_alert_tasks < MAX_CONCURRENT_ALERTS)) {
       StrHelper::strncpy(t.text, text, sizeof(t.text));
       t.pri = pri;
-      t.send_expiry = 0;  // signal that initial send is needed
-      t.attempt = 4;
-      t.curr_contact_idx = -1;  // start iterating thru contacts[]
 
-      alert_tasks[num_alert_tasks++] = &t;  // add to queue
+      uint16_t pri_mask = (pri == HIGH_PRI_ALERT) ? PERM_RECV_ALERTS_HI : PERM_RECV_ALERTS_LO;
+      memset(t.pending, 0, sizeof(t.pending));
+      for (int i = 0; i < acl.getNumClients() && i < MAX_CLIENTS; i++) {
+        if (acl.getClientByIdx(i)->permissions & pri_mask) t.setPending(i);   // contact wants alert
+      }
+
+      if (!t.queued) {   // add to tail of queue
+        alert_tasks[(alert_head + num_alert_tasks++) % MAX_CONCURRENT_ALERTS] = &t;
+        t.queued = true;
+      }
     }
   } else {
     if (t.isTriggered()) {
       t.text[0] = 0;
-      // remove 't' from alert queue
-      int i = 0;
-      while (i < num_alert_tasks && alert_tasks[i] != &t) i++;
-
-      if (i < num_alert_tasks) {  // found,  now delete from array
-        num_alert_tasks--;
-        while (i < num_alert_tasks) {
-          alert_tasks[i] = alert_tasks[i + 1];
-          i++;
-        }
+      memset(t.pending, 0, sizeof(t.pending));   // is removed from queue when it reaches the head
+    }
+  }
+}
+
+bool SensorMesh::isDeliveringTo(int contact_idx) const {
+  for (int i = 0; i < MAX_ALERT_DELIVERIES; i++) {
+    if (alert_deliveries[i].contact_idx == contact_idx) return true;
+  }
+  return false;
+}
+
+bool SensorMesh::startAlertDelivery(AlertDelivery* d, int contact_idx) {
+  auto c = acl.getClientByIdx(contact_idx);
+
+  // batch ALL the alerts pending for this contact into the one message
+  int len = 0;
+  bool high_pri = false;
+  for (int k = 0; k < num_alert_tasks; k++) {
+    auto t = alert_tasks[(alert_head + k) % MAX_CONCURRENT_ALERTS];
+    if (!t->isTriggered() || !t->isPendingFor(contact_idx)) continue;
+
+    uint16_t pri_mask = (t->pri == HIGH_PRI_ALERT) ? PERM_RECV_ALERTS_HI : PERM_RECV_ALERTS_LO;
+    if ((c->permissions & pri_mask) == 0) {   // no longer wants these
+      t->clearPending(contact_idx);
+      continue;
+    }
+
+    int text_len = strlen(t->text);
+    if (len == 0) {
+      if (text_len > ALERT_MAX_TEXT) text_len = ALERT_MAX_TEXT;
+    } else if (len + 1 + text_len > ALERT_MAX_TEXT) {
+      continue;   // won't fit, leave for a later message
+    } else {
+      d->text[len++] = '\n';
+    }
+    memcpy(&d->text[len], t->text, text_len);
+    len += text_len;
+    t->clearPending(contact_idx);
+    if (t->pri == HIGH_PRI_ALERT) high_pri = true;
+  }
+  if (len == 0) return false;   // nothing to send
+
+  d->text[len] = 0;
+  d->contact_idx = contact_idx;
+  d->attempt = high_pri ? 0 : 3;   // Low pri alerts, start at attempt #3 (ie. only make ONE attempt)
+  d->timestamp = getRTCClock()->getCurrentTimeUnique();   // need unique timestamp per contact
+  sendAlert(c, d);  // NOTE: modifies attempt, expected_acks[] and send_expiry
+  return true;
+}
+
+bool SensorMesh::startNextAlertDelivery(AlertDelivery* d) {
+  for (int pass = 0; pass < 2; pass++) {   // high priority alerts first
+    AlertPriority pri = (pass == 0) ? HIGH_PRI_ALERT : LOW_PRI_ALERT;
+    for (int k = 0; k < num_alert_tasks; k++) {
+      auto t = alert_tasks[(alert_head + k) % MAX_CONCURRENT_ALERTS];
+      if (!t->isTriggered() || t->pri != pri) continue;
+
+      for (int i = 0; i < acl.getNumClients() && i < MAX_CLIENTS; i++) {
+        if (t->isPendingFor(i) && !isDeliveringTo(i) && startAlertDelivery(d, i)) return true;
+      }
+    }
+  }
+  return false;
+}
+
+void SensorMesh::processAlerts() {
+  // remove alerts from head of queue, once cleared, or started to all contacts
+  while (num_alert_tasks > 0) {
+    auto t = alert_tasks[alert_head];
+    if (t->isTriggered() && t->hasPending()) break;
+
+    t->queued = false;
+    alert_head = (alert_head + 1) % MAX_CONCURRENT_ALERTS;
+    num_alert_tasks--;
+  }
+
+  for (int i = 0; i < MAX_ALERT_DELIVERIES; i++) {
+    auto d = &alert_deliveries[i];
+    if (d->contact_idx >= 0 && millisHasNowPassed(d->send_expiry)) {  // next send needed?
+      if (d->attempt >= 4 || d->contact_idx >= acl.getNumClients()) {
+        d->contact_idx = -1;   // max attempts reached (or contact list modified), give up on this contact
+      } else {
+        sendAlert(acl.getClientByIdx(d->contact_idx), d);  // send next attempt
       }
     }
+    if (d->contact_idx < 0 && num_alert_tasks > 0) {
+      startNextAlertDelivery(d);   // slot is free
+    }
   }
 }
 
@@ -306,9 +488,8 @@ bool SensorMesh::allowPacketForward(const mesh::Packet* packet) {
   return true;
 }
 
-int SensorMesh::calcRxDelay(float score, uint32_t air_time) const {
-  if (_prefs.rx_delay_base <= 0.0f) return 0;
-  return (int) ((pow(_prefs.rx_delay_base, 0.85f - score) - 1.0) * air_time);
+float SensorMesh::getRxDelayBase() const {
+  return _prefs.rx_delay_base;
 }
 
 uint32_t SensorMesh::getRetransmitDelay(const mesh::Packet* packet) {
@@ -325,6 +506,9 @@ int SensorMesh::getInterferenceThreshold() const {
 int SensorMesh::getAGCResetInterval() const {
   return ((int)_prefs.agc_reset_interval) * 4000;   // milliseconds
 }
+uint32_t SensorMesh::getOutboundAgingMillis() const {
+  return _prefs.qos_aging;
+}
 
 uint8_t SensorMesh::handleLoginReq(const mesh::Identity& sender, const uint8_t* secret, uint32_t sender_timestamp, const uint8_t* data, bool is_flood) {
   ClientInfo* client;
@@ -362,19 +546,38 @@ uint8_t SensorMesh::handleLoginReq(const mesh::Identity& sender, const uint8_t*
   if (is_flood) {
     client->out_path_len = -1;  // need to rediscover out_path
   }
+  return formatLoginReply(client);
+}
 
+uint8_t SensorMesh::formatLoginReply(ClientInfo* client) {
   uint32_t now = getRTCClock()->getCurrentTimeUnique();
   memcpy(reply_data, &now, 4);   // response packets always prefixed with timestamp
   reply_data[4] = RESP_SERVER_LOGIN_OK;
   reply_data[5] = 0;
   reply_data[6] = client->isAdmin() ? 1 : 0;
   reply_data[7] = client->permissions;
-  getRNG()->random(&reply_data[8], 4);   // random blob to help packet-hash uniqueness
+  uint32_t ticket = ClientACL::calcSessionTicket(self_id, client);   // (was a random blob, before ver level 2)
+  memcpy(&reply_data[8], &ticket, 4);
   reply_data[12] = FIRMWARE_VER_LEVEL;
 
   return 13;  // reply length
 }
 
+uint8_t SensorMesh::handleResumeReq(ClientInfo* client, const uint8_t* payload, size_t payload_len, bool is_flood) {
+  uint32_t ticket;
+  if (payload_len < 4) return 0;
+  memcpy(&ticket, payload, 4);
+  if (ticket != ClientACL::calcSessionTicket(self_id, client)) {   // stale, eg. permissions since changed
+    MESH_DEBUG_PRINTLN("Resume login, invalid ticket");
+    return 0;   // client will fall back to a full login
+  }
+
+  if (is_flood) {
+    client->out_path_len = -1;  // need to rediscover out_path
+  }
+  return formatLoginReply(client);
+}
+
 void SensorMesh::handleCommand(uint32_t sender_timestamp, char* command, char* reply) {
   while (*command == ' ') command++;   // skip leading spaces
 
@@ -390,29 +593,7 @@ void SensorMesh::handleCommand(uint32_t sender_timestamp, char* command, char* r
   }
 
   // handle sensor-specific CLI commands
-  if (memcmp(command, "setperm ", 8) == 0) {   // format:  setperm {pubkey-hex} {permissions-int8}
-    char* hex = &command[8];
-    char* sp = strchr(hex, ' ');   // look for separator char
-    if (sp == NULL) {
-      strcpy(reply, "Err - bad params");
-    } else {
-      *sp++ = 0;   // replace space with null terminator
-
-      uint8_t pubkey[PUB_KEY_SIZE];
-      int hex_len = min(sp - hex, PUB_KEY_SIZE*2);
-      if (mesh::Utils::fromHex(pubkey, hex_len / 2, hex)) {
-        uint8_t perms = atoi(sp);
-        if (acl.applyPermissions(self_id, pubkey, hex_len / 2, perms)) {
-          dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);   // trigger acl.save()
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Err - invalid params");
-        }
-      } else {
-        strcpy(reply, "Err - bad pubkey");
-      }
-    }
-  } else if (sender_timestamp == 0 && strcmp(command, "get acl") == 0) {
+  if (sender_timestamp == 0 && strcmp(command, "get acl") == 0) {
     Serial.println("ACL:");
     for (int i = 0; i < acl.getNumClients(); i++) {
       auto c = acl.getClientByIdx(i);
@@ -423,30 +604,58 @@ void SensorMesh::handleCommand(uint32_t sender_timestamp, char* command, char* r
       Serial.printf("\n");
     }
     reply[0] = 0;
-  } else if (memcmp(command, "io ", 2) == 0) { // io {value}: write, io: read 
-    if (command[2] == ' ') { // it's a write
-      uint32_t val;
-      uint32_t g = board.getGpio();
-      if (command[3] == 'r') { // reset bits
-        sscanf(&command[4], "%x", &val);
-        val = g & ~val;    
-      } else if (command[3] == 's') { // set bits
-        sscanf(&command[4], "%x", &val);
-        val |= g;    
-      } else if (command[3] == 't') { // toggle bits
-        sscanf(&command[4], "%x", &val);
-        val ^= g;    
-      } else { // set value
-        sscanf(&command[3], "%x", &val);
+  } else {
+    _cli.handleCommand(sender_timestamp, command, reply);  // common CLI commands, and those added in begin()
+  }
+}
+
+void SensorMesh::handleSetPermCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  // format:  setperm {pubkey-hex} {permissions-int8}
+  char* hex = &command[8];
+  char* sp = strchr(hex, ' ');   // look for separator char
+  if (sp == NULL) {
+    strcpy(reply, "Err - bad params");
+  } else {
+    *sp++ = 0;   // replace space with null terminator
+
+    uint8_t pubkey[PUB_KEY_SIZE];
+    int hex_len = min(sp - hex, PUB_KEY_SIZE*2);
+    if (mesh::Utils::fromHex(pubkey, hex_len / 2, hex)) {
+      uint8_t perms = atoi(sp);
+      if (acl.applyPermissions(self_id, pubkey, hex_len / 2, perms)) {
+        dirty_contacts_expiry = futureMillis(LAZY_CONTACTS_WRITE_DELAY);   // trigger acl.save()
+        strcpy(reply, "OK");
+      } else {
+        strcpy(reply, "Err - invalid params");
       }
-      board.setGpio(val);
+    } else {
+      strcpy(reply, "Err - bad pubkey");
     }
-    sprintf(reply, "%x", board.getGpio());
-  } else{
-    _cli.handleCommand(sender_timestamp, command, reply);  // common CLI commands
   }
 }
 
+void SensorMesh::handleIoCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  // io {value}: write, io: read
+  if (command[2] == ' ') { // it's a write
+    uint32_t val;
+    uint32_t g = board.getGpio();
+    if (command[3] == 'r') { // reset bits
+      sscanf(&command[4], "%x", &val);
+      val = g & ~val;    
+    } else if (command[3] == 's') { // set bits
+      sscanf(&command[4], "%x", &val);
+      val |= g;    
+    } else if (command[3] == 't') { // toggle bits
+      sscanf(&command[4], "%x", &val);
+      val ^= g;    
+    } else { // set value
+      sscanf(&command[3], "%x", &val);
+    }
+    board.setGpio(val);
+  }
+  sprintf(reply, "%x", board.getGpio());
+}
+
 void SensorMesh::onAnonDataRecv(mesh::Packet* packet, const uint8_t* secret, const mesh::Identity& sender, uint8_t* data, size_t len) {
   if (packet->getPayloadType() == PAYLOAD_TYPE_ANON_REQ) {  // received an initial request by a possible admin client (unknown at this stage)
     uint32_t timestamp;
@@ -466,7 +675,7 @@ void SensorMesh::onAnonDataRecv(mesh::Packet* packet, const uint8_t* secret, con
 
     if (packet->isRouteFlood()) {
       // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the response
-      mesh::Packet* path = createPathReturn(sender, secret, packet->path, packet->path_len,
+      mesh::Packet* path = createPathReturn(sender, secret, packet->path, packet->getEncodedPathLen(),
                                             PAYLOAD_TYPE_RESPONSE, reply_data, reply_len);
       if (path) sendFlood(path, SERVER_RESPONSE_DELAY);
     } else {
@@ -477,6 +686,7 @@ void SensorMesh::onAnonDataRecv(mesh::Packet* packet, const uint8_t* secret, con
 }
 
 int SensorMesh::searchPeersByHash(const uint8_t* hash) {
+  acl.pageInByHash(hash, PATH_HASH_SIZE);   // any dormant clients with this hash (NOTE: may evict others)
   int n = 0;
   for (int i = 0; i < acl.getNumClients() && n < MAX_SEARCH_RESULTS; i++) {
     if (acl.getClientByIdx(i)->id.isHashMatch(hash)) {
@@ -522,12 +732,28 @@ void SensorMesh::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender_i
 
   ClientInfo* from = acl.getClientByIdx(i);
 
-  if (type == PAYLOAD_TYPE_REQ) {  // request (from a known contact)
-    uint32_t timestamp;
-    memcpy(&timestamp, data, 4);
+  mesh::RequestView req;
+  if (type == PAYLOAD_TYPE_REQ && req.init(data, len)) {  // request (from a known contact)
+    uint32_t timestamp = req.timestamp();
 
     if (timestamp > from->last_timestamp) {  // prevent replay attacks
-      uint8_t reply_len = handleRequest(from->isAdmin() ? 0xFF : from->permissions, timestamp, data[4], &data[5], len - 5);
+#if SENSOR_MULTIPART_HISTORY
+      // if we have a direct path to requester, and it (and the repeaters on the way) take fragments, can send a whole block
+      if (req.type() == REQ_TYPE_GET_SERIES_HISTORY && packet->isRouteDirect() && from->out_path_len >= 0
+          && (from->isAdmin() || (from->permissions & PERM_ACL_ROLE_MASK) >= PERM_ACL_READ_ONLY)
+          && peer_caps.hasCaps(from->id.pub_key, PUB_KEY_SIZE, PEER_CAP_FRAGMENTS)
+          && peer_caps.pathHasCaps(from->out_path, from->out_path_len, PEER_CAP_FRAGMENTS)) {
+        int block_len = buildHistoryBlock(history_block, sizeof(history_block), timestamp, req.body(), req.bodyLen());
+        if (block_len > 0 && sendFragmented(PAYLOAD_TYPE_RESPONSE, from->id, secret, history_block, block_len, from->out_path, from->out_path_len) >= 0) {
+          from->last_timestamp = timestamp;
+          from->last_activity = getRTCClock()->getCurrentTime();
+          return;
+        }
+        // else, fall through to single packet reply
+      }
+#endif
+      uint8_t reply_len = req.type() == REQ_TYPE_RESUME_LOGIN ? handleResumeReq(from, req.body(), req.bodyLen(), packet->isRouteFlood())
+                          : handleRequest(from->isAdmin() ? 0xFF : from->permissions, timestamp, req.type(), req.body(), req.bodyLen());
       if (reply_len == 0) return;  // invalid command
 
       from->last_timestamp = timestamp;
@@ -535,7 +761,7 @@ void SensorMesh::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender_i
 
       if (packet->isRouteFlood()) {
         // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the response
-        mesh::Packet* path = createPathReturn(from->id, secret, packet->path, packet->path_len,
+        mesh::Packet* path = createPathReturn(from->id, secret, packet->path, packet->getEncodedPathLen(),
                                               PAYLOAD_TYPE_RESPONSE, reply_data, reply_len);
         if (path) sendFlood(path, SERVER_RESPONSE_DELAY);
       } else {
@@ -555,19 +781,28 @@ void SensorMesh::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender_i
     uint32_t sender_timestamp;
     memcpy(&sender_timestamp, data, 4);  // timestamp (by sender's RTC clock - which could be wrong)
     uint8_t flags = (data[4] >> 2);   // message attempt number, and other flags
+    bool compressed = (flags & TXT_TYPE_COMPRESSED) != 0;
+    flags &= ~TXT_TYPE_COMPRESSED;
 
-    if (sender_timestamp > from->last_timestamp) {  // prevent replay attacks
+    // len can be > original length, but 'text' will be padded with zeroes
+    data[len] = 0; // need to make a C string again, with null terminator
+    char text_buf[TXT_CODEC_MAX_TEXT+1];
+    char *text = TxtCodec::unpack((char *) &data[5], compressed, text_buf, sizeof(text_buf));
+
+    if (text == NULL) {
+      MESH_DEBUG_PRINTLN("onPeerDataRecv: bad compressed text");
+    } else if (sender_timestamp > from->last_timestamp) {  // prevent replay attacks
       if (flags == TXT_TYPE_PLAIN) {
-        bool handled = handleIncomingMsg(*from, sender_timestamp, &data[5], flags, len - 5);
+        bool handled = handleIncomingMsg(*from, sender_timestamp, (uint8_t *) text, flags, compressed ? strlen(text) : len - 5);
         if (handled) { // if msg was handled then send an ack
           uint32_t ack_hash;    // calc truncated hash of the message timestamp + text + sender pub_key, to prove to sender that we got it
           mesh::Utils::sha256((uint8_t *) &ack_hash, 4, data, 5 + strlen((char *)&data[5]), from->id.pub_key, PUB_KEY_SIZE);
 
           if (packet->isRouteFlood()) {
             // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the ACK
-            mesh::Packet* path = createPathReturn(from->id, secret, packet->path, packet->path_len,
+            mesh::Packet* path = createPathReturn(from->id, secret, packet->path, packet->getEncodedPathLen(),
                                                   PAYLOAD_TYPE_ACK, (uint8_t *) &ack_hash, 4);
-            if (path) sendFlood(path, TXT_ACK_DELAY);
+            if (path) sendFlood(path, getAckDelay(packet, TXT_ACK_DELAY));
           } else {
             sendAckTo(*from, ack_hash);
           }
@@ -576,13 +811,9 @@ void SensorMesh::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender_i
         from->last_timestamp = sender_timestamp;
         from->last_activity = getRTCClock()->getCurrentTime();
 
-        // len can be > original length, but 'text' will be padded with zeroes
-        data[len] = 0; // need to make a C string again, with null terminator
-
         uint8_t temp[166];
-        char *command = (char *) &data[5];
         char *reply = (char *) &temp[5];
-        handleCommand(sender_timestamp, command, reply);
+        handleCommand(sender_timestamp, text, reply);
 
         int text_len = strlen(reply);
         if (text_len > 0) {
@@ -666,7 +897,8 @@ bool SensorMesh::onPeerPathRecv(mesh::Packet* packet, int sender_idx, const uint
   MESH_DEBUG_PRINTLN("PATH to contact, path_len=%d", (uint32_t) path_len);
   // NOTE: for this impl, we just replace the current 'out_path' regardless, whenever sender sends us a new out_path.
   // FUTURE: could store multiple out_paths per contact, and try to find which is the 'best'(?)
-  memcpy(from->out_path, path, from->out_path_len = path_len);  // store a copy of path, for sendDirect()
+  memcpy(from->out_path, path, mesh::Packet::decodePathBytes(path_len));  // store a copy of path, for sendDirect()
+  from->out_path_len = path_len;
   from->last_activity = getRTCClock()->getCurrentTime();
 
   // REVISIT: maybe make ALL out_paths non-persisted to minimise flash writes??
@@ -680,12 +912,13 @@ bool SensorMesh::onPeerPathRecv(mesh::Packet* packet, int sender_idx, const uint
 }
 
 void SensorMesh::onAckRecv(mesh::Packet* packet, uint32_t ack_crc) {
-  if (num_alert_tasks > 0) {
-    auto t = alert_tasks[0];   // check current alert task
-    for (int i = 0; i < t->attempt; i++) {
-      if (ack_crc == t->expected_acks[i]) {   // matching ACK!
-        t->attempt = 4;  // signal to move to next contact
-        t->send_expiry = 0;
+  for (int j = 0; j < MAX_ALERT_DELIVERIES; j++) {
+    auto d = &alert_deliveries[j];
+    if (d->contact_idx < 0) continue;
+
+    for (int i = 0; i < d->attempt; i++) {
+      if (ack_crc == d->expected_acks[i]) {   // matching ACK!
+        d->contact_idx = -1;   // delivered, slot now free
         packet->markDoNotRetransmit();   // ACK was for this node, so don't retransmit
         return;
       }
@@ -694,13 +927,14 @@ void SensorMesh::onAckRecv(mesh::Packet* packet, uint32_t ack_crc) {
 }
 
 SensorMesh::SensorMesh(mesh::MainBoard& board, mesh::Radio& radio, mesh::MillisecondClock& ms, mesh::RNG& rng, mesh::RTCClock& rtc, mesh::MeshTables& tables)
-     : mesh::Mesh(radio, ms, rng, rtc, *new StaticPoolPacketManager(32), tables),
+     : mesh::Mesh(radio, ms, rng, rtc, *new StaticPoolPacketManager(PACKET_POOL_SIZE), tables),
       _cli(board, rtc, sensors, &_prefs, this), telemetry(MAX_PACKET_PAYLOAD - 4)
 {
   next_local_advert = next_flood_advert = 0;
   dirty_contacts_expiry = 0;
   last_read_time = 0;
-  num_alert_tasks = 0;
+  alert_head = num_alert_tasks = 0;
+  for (int i = 0; i < MAX_ALERT_DELIVERIES; i++) alert_deliveries[i].contact_idx = -1;
   set_radio_at = revert_radio_at = 0;
 
   // defaults
@@ -723,6 +957,7 @@ SensorMesh::SensorMesh(mesh::MainBoard& board, mesh::Radio& radio, mesh::Millise
   _prefs.disable_fwd = true;
   _prefs.flood_max = 64;
   _prefs.interference_threshold = 0;  // disabled
+  _prefs.qos_aging = QOS_AGING_MILLIS;
 
   // GPS defaults
   _prefs.gps_enabled = 0;
@@ -733,8 +968,19 @@ SensorMesh::SensorMesh(mesh::MainBoard& board, mesh::Radio& radio, mesh::Millise
 void SensorMesh::begin(FILESYSTEM* fs) {
   mesh::Mesh::begin();
   _fs = fs;
+  flash_writer.begin();   // saves are written behind, from here on
+  {
+    int num;
+    const MemTable* tables = getMemTables(num);
+    MemoryStats::debugPrint(tables, num);
+  }
+#if SENSOR_MULTIPART_HISTORY
+  setFragmentStore(&frag_store);
+#endif
   // load persisted prefs
   _cli.loadPrefs(_fs);
+  _cli.addCommand("setperm", CLICommandTable::method<SensorMesh, &SensorMesh::handleSetPermCmd>, this, CLI_HAS_PARAMS);
+  _cli.addCommand("io", CLICommandTable::method<SensorMesh, &SensorMesh::handleIoCmd>, this);
 
   acl.load(_fs);
 
@@ -826,7 +1072,40 @@ void SensorMesh::formatRadioStatsReply(char *reply) {
 
 void SensorMesh::formatPacketStatsReply(char *reply) {
   StatsFormatHelper::formatPacketStats(reply, radio_driver, getNumSentFlood(), getNumSentDirect(), 
-                                       getNumRecvFlood(), getNumRecvDirect());
+                                       getNumRecvFlood(), getNumRecvDirect(), getNumInboundLate());
+}
+
+const MemTable* SensorMesh::getMemTables(int& num) const {
+  static constexpr MemTable tables[] = {
+    { "clients", sizeof(ClientACL) },
+  #if SENSOR_MULTIPART_HISTORY
+    { "history", sizeof(frag_store) + sizeof(history_block) + sizeof(peer_caps) },
+  #endif
+    { "alerts", sizeof(alert_deliveries) },
+    { "mesh_tables", sizeof(SimpleMeshTables) },
+    { "packet_pool", sizeof(mesh::Packet) * PACKET_POOL_SIZE },
+    { "flash_writer", FLASH_WRITER_BUF_SIZE },
+  };
+  static_assert(RAM_TABLES_BUDGET == 0 || memTablesTotal(tables, sizeof(tables) / sizeof(tables[0])) <= RAM_TABLES_BUDGET,
+                "tables exceed RAM_TABLES_BUDGET, reduce MAX_CLIENTS, etc.");
+  num = sizeof(tables) / sizeof(tables[0]);
+  return tables;
+}
+
+void SensorMesh::formatMemoryStatsReply(char *reply) {
+  MemoryStats mem;
+  mem.read();
+  int num;
+  const MemTable* tables = getMemTables(num);
+  StatsFormatHelper::formatMemoryStats(reply, mem, memTablesTotal(tables, num));
+}
+
+void SensorMesh::formatProfileStatsReply(char *reply, uint8_t type) {
+#if MESH_PROFILING
+  StatsFormatHelper::formatProfileStats(reply, getRecvProfiler(), type);
+#else
+  strcpy(reply, "Error: needs a MESH_PROFILING=1 build");
+#endif
 }
 
 float SensorMesh::getTelemValue(uint8_t channel, uint8_t type) {
@@ -862,6 +1141,7 @@ bool  SensorMesh::getGPS(uint8_t channel, float& lat, float& lon, float& alt) {
 
 void SensorMesh::loop() {
   mesh::Mesh::loop();
+  flash_writer.loop();
 
   if (next_flood_advert && millisHasNowPassed(next_flood_advert)) {
     mesh::Packet* pkt = createSelfAdvert();
@@ -889,52 +1169,23 @@ void SensorMesh::loop() {
   }
 
   uint32_t curr = getRTCClock()->getCurrentTime();
-  if (curr >= last_read_time + SENSOR_READ_INTERVAL_SECS) {
+  bool changed = sensors.pollChanges();   // a scheduled sensor has moved past its change threshold
+  if (changed || curr >= last_read_time + SENSOR_READ_INTERVAL_SECS) {
     telemetry.reset();
     telemetry.addVoltage(TELEM_CHANNEL_SELF, (float)board.getBattMilliVolts() / 1000.0f);
     // query other sensors -- target specific
     sensors.querySensors(0xFF, telemetry);  // allow all telemetry permissions
 
+    if (changed) telem_cache.invalidate();   // snapshots for other permissions are now out of date
+    telem_cache.put(0xFF, telemetry.getBuffer(), telemetry.getSize(), millis());
+
     onSensorDataRead();
 
     last_read_time = curr;
   }
 
   // check the alert send queue
-  if (num_alert_tasks > 0) {
-    auto t = alert_tasks[0];   // process head of queue
-
-    if (millisHasNowPassed(t->send_expiry)) {  // next send needed?
-      if (t->attempt >= 4) {  // max attempts reached, try next contact
-        t->curr_contact_idx++;
-        if (t->curr_contact_idx >= acl.getNumClients()) {  // no more contacts to try?
-          num_alert_tasks--;   // remove t from queue
-          for (int i = 0; i < num_alert_tasks; i++) {
-            alert_tasks[i] = alert_tasks[i + 1];
-          }
-        } else {
-          auto c = acl.getClientByIdx(t->curr_contact_idx);
-          uint16_t pri_mask = (t->pri == HIGH_PRI_ALERT) ? PERM_RECV_ALERTS_HI : PERM_RECV_ALERTS_LO;
-
-          if (c->permissions & pri_mask) {   // contact wants alert
-            // reset attempts
-            t->attempt = (t->pri == LOW_PRI_ALERT) ? 3 : 0;   // Low pri alerts, start at attempt #3 (ie. only make ONE attempt)
-            t->timestamp = getRTCClock()->getCurrentTimeUnique();   // need unique timestamp per contact
-
-            sendAlert(c, t);  // NOTE: modifies attempt, expected_acks[] and send_expiry
-          } else {
-            // next contact tested in next ::loop()
-          }
-        }
-      } else if (t->curr_contact_idx < acl.getNumClients()) {
-        auto c = acl.getClientByIdx(t->curr_contact_idx);   // send next attempt
-        sendAlert(c, t);  // NOTE: modifies attempt, expected_acks[] and send_expiry
-      } else {
-        // contact list has likely been modified while waiting for alert ACK, cancel this task
-        t->attempt = 4;   // next ::loop() will remove t from queue
-      }
-    }
-  }
+  processAlerts();
 
   // is there are pending dirty contacts write needed?
   if (dirty_contacts_expiry && millisHasNowPassed(dirty_contacts_expiry)) {
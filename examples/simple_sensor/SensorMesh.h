@@ -2,6 +2,7 @@
 
 #include <Arduino.h>   // needed for PlatformIO
 #include <Mesh.h>
+#include <PayloadViews.h>
 
 #include "TimeSeriesData.h"
 
@@ -14,13 +15,17 @@
 #endif
 
 #include <helpers/ArduinoHelpers.h>
+#include <helpers/ChaChaRNG.h>
 #include <helpers/StaticPoolPacketManager.h>
 #include <helpers/SimpleMeshTables.h>
 #include <helpers/IdentityStore.h>
 #include <helpers/AdvertDataHelpers.h>
 #include <helpers/TxtDataHelpers.h>
+#include <helpers/TxtCodec.h>
 #include <helpers/CommonCLI.h>
+#include <helpers/FlashWriter.h>
 #include <helpers/StatsFormatHelper.h>
+#include <helpers/TelemetryCache.h>
 #include <helpers/ClientACL.h>
 #include <RTClib.h>
 #include <target.h>
@@ -43,7 +48,19 @@
 #define FIRMWARE_ROLE "sensor"
 
 #define MAX_SEARCH_RESULTS      8
+
+#ifndef PACKET_POOL_SIZE
+  #define PACKET_POOL_SIZE      32
+#endif
+
+#ifndef SENSOR_MULTIPART_HISTORY
+  #define SENSOR_MULTIPART_HISTORY   0   // 1 = send series history in blocks of up to FRAG_MAX_DATA_SIZE (costs ~5KB RAM)
+#endif
 #define MAX_CONCURRENT_ALERTS   4
+#ifndef MAX_ALERT_DELIVERIES
+  #define MAX_ALERT_DELIVERIES  4   // recipients that alerts can be in flight to at once
+#endif
+#define ALERT_MAX_TEXT          (10*CIPHER_BLOCK_SIZE)   // one alert message (several alerts can be batched in one)
 
 class SensorMesh : public mesh::Mesh, public CommonCLICallbacks {
 public:
@@ -73,6 +90,8 @@ public:
   void formatStatsReply(char *reply) override;
   void formatRadioStatsReply(char *reply) override;
   void formatPacketStatsReply(char *reply) override;
+  void formatMemoryStatsReply(char *reply) override;
+  void formatProfileStatsReply(char *reply, uint8_t type) override;
   mesh::LocalIdentity& getSelfId() override { return self_id; }
   void saveIdentity(const mesh::LocalIdentity& new_id) override;
   void clearStats() override { }
@@ -95,31 +114,51 @@ protected:
   enum AlertPriority { LOW_PRI_ALERT, HIGH_PRI_ALERT };
 
   struct Trigger {
-    uint32_t timestamp;
     AlertPriority pri;
-    uint32_t expected_acks[4];
-    int8_t   curr_contact_idx;
-    uint8_t  attempt;
-    unsigned long send_expiry;
+    bool queued;     // in alert queue (is left there, if condition clears, until reaches head of queue)
+    uint8_t pending[(MAX_CLIENTS + 7) / 8];   // bit per contact idx, still to be delivered to
     char text[MAX_PACKET_PAYLOAD];
 
-    Trigger() { text[0] = 0; }
+    Trigger() { text[0] = 0; queued = false; }
     bool isTriggered() const { return text[0] != 0; }
+    bool isPendingFor(int idx) const { return pending[idx >> 3] & (1 << (idx & 7)); }
+    void setPending(int idx) { pending[idx >> 3] |= (1 << (idx & 7)); }
+    void clearPending(int idx) { pending[idx >> 3] &= ~(1 << (idx & 7)); }
+    bool hasPending() const {
+      for (int i = 0; i < sizeof(pending); i++) if (pending[i]) return true;
+      return false;
+    }
+  };
+
+  // a message (of one or more alerts) being sent to one contact, until ACKed
+  struct AlertDelivery {
+    int16_t contact_idx;    // -1 if slot unused
+    uint8_t attempt;
+    uint32_t timestamp;
+    uint32_t expected_acks[4];
+    unsigned long send_expiry;
+    char text[ALERT_MAX_TEXT + 1];
   };
   void alertIf(bool condition, Trigger& t, AlertPriority pri, const char* text);
 
   virtual void onSensorDataRead() = 0;   // for app to implement
   virtual int querySeriesData(uint32_t start_secs_ago, uint32_t end_secs_ago, MinMaxAvg dest[], int max_num) = 0;  // for app to implement
+  /**
+   * \brief  for app to implement, if it keeps raw history (an encoded TimeSeriesData) for REQ_TYPE_GET_SERIES_HISTORY
+   * \returns  the series at 'idx', or NULL if none
+  */
+  virtual const TimeSeriesData* querySeries(int idx, uint8_t& channel, uint8_t& lpp_type) { return NULL; }
   virtual bool handleCustomCommand(uint32_t sender_timestamp, char* command, char* reply) { return false; }
 
   // Mesh overrides
   float getAirtimeBudgetFactor() const override;
   bool allowPacketForward(const mesh::Packet* packet) override;
-  int calcRxDelay(float score, uint32_t air_time) const override;
+  float getRxDelayBase() const override;
   uint32_t getRetransmitDelay(const mesh::Packet* packet) override;
   uint32_t getDirectRetransmitDelay(const mesh::Packet* packet) override;
   int getInterferenceThreshold() const override;
   int getAGCResetInterval() const override;
+  uint32_t getOutboundAgingMillis() const override;
   void onAnonDataRecv(mesh::Packet* packet, const uint8_t* secret, const mesh::Identity& sender, uint8_t* data, size_t len) override;
   int searchPeersByHash(const uint8_t* hash) override;
   void getPeerSharedSecret(uint8_t* dest_secret, int peer_idx) override;
@@ -127,21 +166,36 @@ protected:
   bool onPeerPathRecv(mesh::Packet* packet, int sender_idx, const uint8_t* secret, uint8_t* path, uint8_t path_len, uint8_t extra_type, uint8_t* extra, uint8_t extra_len) override;
   void onControlDataRecv(mesh::Packet* packet) override;
   void onAckRecv(mesh::Packet* packet, uint32_t ack_crc) override;
+#if SENSOR_MULTIPART_HISTORY
+  void onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp, const uint8_t* app_data, size_t app_data_len) override;
+#endif
   virtual bool handleIncomingMsg(ClientInfo& from, uint32_t timestamp, uint8_t* data, uint8_t flags, size_t len);
   void sendAckTo(const ClientInfo& dest, uint32_t ack_hash);
 private:
+  void handleSetPermCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleIoCmd(uint32_t sender_timestamp, char* command, char* reply);
+  const MemTable* getMemTables(int& num) const;
+
   FILESYSTEM* _fs;
   unsigned long next_local_advert, next_flood_advert;
   NodePrefs _prefs;
   CommonCLI _cli;
   uint8_t reply_data[MAX_PACKET_PAYLOAD];
+#if SENSOR_MULTIPART_HISTORY
+  FragmentStore frag_store;
+  uint8_t history_block[FRAG_MAX_DATA_SIZE];
+  mesh::PeerCapsTable peer_caps;   // who can take (or forward) MULTIPART fragments
+#endif
   ClientACL  acl;
   unsigned long dirty_contacts_expiry;
-  CayenneLPP telemetry;
+  CayenneLPP telemetry;   // latest (periodic) readings
+  LPPSlice reply_lpp;
+  TelemetryCache telem_cache;
   uint32_t last_read_time;
   int matching_peer_indexes[MAX_SEARCH_RESULTS];
-  int num_alert_tasks;
-  Trigger* alert_tasks[MAX_CONCURRENT_ALERTS];
+  int alert_head, num_alert_tasks;
+  Trigger* alert_tasks[MAX_CONCURRENT_ALERTS];    // ring, oldest at alert_head
+  AlertDelivery alert_deliveries[MAX_ALERT_DELIVERIES];
   unsigned long set_radio_at, revert_radio_at;
   float pending_freq;
   float pending_bw;
@@ -149,10 +203,17 @@ private:
   uint8_t pending_cr;
 
   uint8_t handleLoginReq(const mesh::Identity& sender, const uint8_t* secret, uint32_t sender_timestamp, const uint8_t* data, bool is_flood);
+  uint8_t formatLoginReply(ClientInfo* client);
+  uint8_t handleResumeReq(ClientInfo* client, const uint8_t* payload, size_t payload_len, bool is_flood);
   uint8_t handleRequest(uint8_t perms, uint32_t sender_timestamp, uint8_t req_type, uint8_t* payload, size_t payload_len);
+  int buildHistoryBlock(uint8_t* dest, int max_len, uint32_t sender_timestamp, const uint8_t* payload, size_t payload_len);
   mesh::Packet* createSelfAdvert();
 
-  void sendAlert(const ClientInfo* c, Trigger* t);
+  void sendAlert(const ClientInfo* c, AlertDelivery* d);
+  bool isDeliveringTo(int contact_idx) const;
+  bool startAlertDelivery(AlertDelivery* d, int contact_idx);
+  bool startNextAlertDelivery(AlertDelivery* d);
+  void processAlerts();
 
   #if ENV_INCLUDE_GPS == 1
   void applyGpsPrefs() {
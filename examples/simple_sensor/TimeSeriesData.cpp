@@ -1,41 +1,280 @@
 #include "TimeSeriesData.h"
 
+#define SPILL_VER           1
+#define SPILL_HEADER_SIZE   12    // ver(1), reserved(1), head(2), count(2), reserved(2), last_ts(4)
+
+static File openReadWrite(FILESYSTEM* fs, const char* filename) {   // for updating in place
+#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+  return fs->open(filename, FILE_O_WRITE);
+#elif defined(RP2040_PLATFORM)
+  return fs->open(filename, fs->exists(filename) ? "r+" : "w+");
+#else
+  return fs->open(filename, fs->exists(filename) ? "r+" : "w+", true);
+#endif
+}
+
+static File openRead(FILESYSTEM* fs, const char* filename) {
+#if defined(RP2040_PLATFORM)
+  return fs->open(filename, "r");
+#else
+  return fs->open(filename);
+#endif
+}
+
+void TimeSeriesData::putSample(int i, float value) {
+  if (data) {
+    data[i] = value;
+  } else {
+    float n = (value - offset) / scale;
+    if (isnan(n)) n = 0;
+    enc_data[i] = n >= 32767.0f ? 32767 : (n <= -32768.0f ? -32768 : (int16_t) lroundf(n));
+  }
+}
+
+bool TimeSeriesData::setSpillFile(FILESYSTEM* fs, const char* filename, int max_samples) {
+  if (enc_data == NULL || max_samples <= 0 || max_samples > 0xFFFF) return false;
+
+  spill_fs = fs;
+  spill_file = filename;
+  spill_max = max_samples;
+  if (spill_buf == NULL) spill_buf = new int16_t[TS_SPILL_BATCH];
+  spill_buf_num = 0;
+  loadSpillHeader();
+  return true;
+}
+
+void TimeSeriesData::loadSpillHeader() {
+  spill_head = spill_count = 0;
+  spill_last_ts = 0;
+  if (!spill_fs->exists(spill_file)) return;
+
+  File file = openRead(spill_fs, spill_file);
+  if (!file) return;
+  uint8_t hdr[SPILL_HEADER_SIZE];
+  if (file.read(hdr, SPILL_HEADER_SIZE) == SPILL_HEADER_SIZE && hdr[0] == SPILL_VER) {
+    uint16_t head, count;
+    memcpy(&head, &hdr[2], 2);
+    memcpy(&count, &hdr[4], 2);
+    if (head < spill_max && count <= spill_max) {   // else, was for a different max_samples, so start over
+      spill_head = head;
+      spill_count = count;
+      memcpy(&spill_last_ts, &hdr[8], 4);
+    }
+  }
+  file.close();
+}
+
+void TimeSeriesData::spill(int16_t sample, uint32_t timestamp) {
+  spill_buf[spill_buf_num++] = sample;
+  spill_last_ts = timestamp;
+  if (spill_buf_num == TS_SPILL_BATCH) flushSpill();
+}
+
+void TimeSeriesData::flushSpill() {
+  File file = openReadWrite(spill_fs, spill_file);
+  if (!file) {
+    MESH_DEBUG_PRINTLN("TimeSeriesData: unable to write spill file");
+    spill_buf_num = 0;   // drop them
+    return;
+  }
+
+  int pos = (spill_head + spill_count) % spill_max;   // append at tail
+  int i = 0;
+  while (i < spill_buf_num) {
+    int n = spill_buf_num - i;
+    if (pos + n > spill_max) n = spill_max - pos;   // up to end of ring, then wrap
+    file.seek(SPILL_HEADER_SIZE + pos * 2);
+    file.write((uint8_t *) &spill_buf[i], n * 2);
+    i += n;
+    pos = (pos + n) % spill_max;
+  }
+  spill_count += spill_buf_num;
+  if (spill_count > spill_max) {   // oldest overwritten
+    spill_head = (spill_head + spill_count - spill_max) % spill_max;
+    spill_count = spill_max;
+  }
+  spill_buf_num = 0;
+
+  uint8_t hdr[SPILL_HEADER_SIZE];
+  memset(hdr, 0, sizeof(hdr));
+  hdr[0] = SPILL_VER;
+  uint16_t head = spill_head, count = spill_count;
+  memcpy(&hdr[2], &head, 2);
+  memcpy(&hdr[4], &count, 2);
+  memcpy(&hdr[8], &spill_last_ts, 4);
+  file.seek(0);
+  file.write(hdr, SPILL_HEADER_SIZE);
+  file.close();
+}
+
+int TimeSeriesData::getEncoded(int skip, int16_t dest[], int max_num) const {
+  if (enc_data == NULL) return 0;
+
+  int n = 0;
+  for (int j = skip; j < num_recorded && n < max_num; j++) {
+    dest[n++] = enc_data[(next + num_slots - 1 - j) % num_slots];
+  }
+  return n;
+}
+
+bool TimeSeriesData::addLevel(int num_buckets, uint32_t bucket_secs) {
+  if (num_levels >= TS_MAX_LEVELS) return false;
+
+  auto l = &levels[num_levels++];
+  l->buckets = new SeriesBucket[num_buckets];
+  memset(l->buckets, 0, sizeof(SeriesBucket)*num_buckets);
+  l->num = num_buckets;
+  l->next = 0;
+  l->bucket_secs = bucket_secs;
+  return true;
+}
+
 void TimeSeriesData::recordData(mesh::RTCClock* clock, float value) {
   uint32_t now = clock->getCurrentTime();
   if (now >= last_timestamp + interval_secs) {
+    if (spill_fs && num_recorded == num_slots) {   // about to be overwritten, so spill the oldest
+      spill(enc_data[next], last_timestamp - (num_slots - 1) * interval_secs);
+    }
     last_timestamp = now;
 
-    data[next] = value;   // append to cycle table
+    putSample(next, value);   // append to cycle table
     next = (next + 1) % num_slots;
+    if (num_recorded < num_slots) num_recorded++;
+
+    for (int j = 0; j < num_levels; j++) {   // fold into current bucket of each level
+      auto l = &levels[j];
+      uint32_t start = now - (now % l->bucket_secs);
+      auto b = &l->buckets[(l->next + l->num - 1) % l->num];
+      if (b->start != start || b->_count == 0) {   // start a new bucket
+        b = &l->buckets[l->next];
+        l->next = (l->next + 1) % l->num;
+        b->start = start;
+        b->_min = b->_max = value;
+        b->_sum = 0.0f;
+        b->_count = 0;
+      }
+      if (value < b->_min) b->_min = value;
+      if (value > b->_max) b->_max = value;
+      b->_sum += value;
+      b->_count++;
+    }
+  }
+}
+
+void TimeSeriesData::addToResult(MinMaxAvg* dest, float _min, float _max, float sum, int count, float& total, int& num_values) {
+  if (num_values == 0) {
+    dest->_min = _min;
+    dest->_max = _max;
+  } else {
+    if (_min < dest->_min) dest->_min = _min;
+    if (_max > dest->_max) dest->_max = _max;
   }
+  total += sum;
+  num_values += count;
+}
+
+template <class F>
+uint32_t TimeSeriesData::visitSamples(F& fn) const {
+  uint32_t oldest = 0;
+
+  // start at most recent recording, back-track through the raw samples to oldest
+  int i = next;
+  uint32_t ts = last_timestamp;
+  for (int n = 0; n < num_recorded; n++, ts -= interval_secs) {
+    i = (i + num_slots - 1) % num_slots;  // go back by one
+    oldest = ts;
+    if (!fn(ts, enc_data ? enc_data[i] : 0, getSample(i))) return oldest;
+  }
+  if (spill_fs == NULL || (spill_buf_num == 0 && spill_count == 0)) return oldest;
+
+  // then the spilled samples, newest first
+  ts = spill_last_ts;
+  for (int j = spill_buf_num - 1; j >= 0; j--, ts -= interval_secs) {   // not yet written
+    if (oldest && ts >= oldest) continue;   // overlaps RAM samples (eg. clock changed)
+    oldest = ts;
+    if (!fn(ts, spill_buf[j], offset + spill_buf[j] * scale)) return oldest;
+  }
+
+  File file = openRead(spill_fs, spill_file);
+  if (!file) return oldest;
+
+  int16_t chunk[TS_SPILL_BATCH];
+  int p = 0;
+  while (p < spill_count) {   // back through ring, a chunk at a time
+    int last = (spill_head + spill_count - 1 - p) % spill_max;   // newest pos of this chunk
+    int n = spill_count - p;
+    if (n > TS_SPILL_BATCH) n = TS_SPILL_BATCH;
+    if (n > last + 1) n = last + 1;   // don't straddle start of ring
+    file.seek(SPILL_HEADER_SIZE + (last - n + 1) * 2);
+    if (file.read((uint8_t *) chunk, n * 2) != n * 2) break;
+
+    for (int j = n - 1; j >= 0; j--, ts -= interval_secs) {
+      if (oldest && ts >= oldest) continue;
+      oldest = ts;
+      if (!fn(ts, chunk[j], offset + chunk[j] * scale)) {
+        file.close();
+        return oldest;
+      }
+    }
+    p += n;
+  }
+  file.close();
+  return oldest;
+}
+
+int TimeSeriesData::readHistory(uint32_t before_ts, int16_t dest[], int max_num, uint32_t& newest_ts, uint32_t& oldest_ts) const {
+  if (enc_data == NULL || max_num <= 0) return 0;
+
+  int n = 0;
+  auto fn = [&](uint32_t ts, int16_t e, float v) {
+    if (before_ts && ts >= before_ts) return true;   // already sent
+    if (n == 0) newest_ts = ts;
+    oldest_ts = ts;
+    dest[n++] = e;
+    return n < max_num;
+  };
+  visitSamples(fn);
+  return n;
 }
 
 void TimeSeriesData::calcMinMaxAvg(mesh::RTCClock* clock, uint32_t start_secs_ago, uint32_t end_secs_ago, MinMaxAvg* dest, uint8_t channel, uint8_t lpp_type) const {
-  int i = next, n = num_slots;
-  uint32_t ago = clock->getCurrentTime() - last_timestamp;
+  uint32_t now = clock->getCurrentTime();
   int num_values = 0;
   float total = 0.0f;
 
   dest->_channel = channel;
   dest->_lpp_type = lpp_type;
 
-  // start at most recet recording, back-track through to oldest
-  while (n > 0) {
-    n--;
-    i = (i + num_slots - 1) % num_slots;  // go back by one
+  auto fn = [&](uint32_t ts, int16_t e, float v) {
+    uint32_t ago = now - ts;
     if (ago >= end_secs_ago && ago < start_secs_ago) {   // filter by the desired time range
-      float v = data[i];
-      num_values++;
-      total += v;
-      if (num_values == 1) {
-        dest->_max = dest->_min = v;
-      } else {
-        if (v < dest->_min) dest->_min = v;
-        if (v > dest->_max) dest->_max = v;
+      addToResult(dest, v, v, v, 1, total, num_values);
+    }
+    return ago < start_secs_ago;   // stop once past start of range
+  };
+  uint32_t oldest = visitSamples(fn);
+  uint32_t covered_ago = oldest ? now - oldest : 0;   // older than this is only in the levels
+
+  // then the buckets of each level (finest first), for the time older than what's been covered so far
+  for (int j = 0; j < num_levels; j++) {
+    auto l = &levels[j];
+    int k = l->next;
+    for (int n = 0; n < l->num; n++) {
+      k = (k + l->num - 1) % l->num;
+      auto b = &l->buckets[k];
+      if (b->_count == 0) break;   // no older buckets
+
+      uint32_t b_ago = now - b->start;   // age of bucket's start (its oldest possible sample)
+      if (b_ago <= covered_ago) continue;   // all in finer data already
+      uint32_t b_end_ago = b_ago > l->bucket_secs ? b_ago - l->bucket_secs : 0;
+      // NOTE: a bucket which straddles the end of the finer data, or the range, is counted whole
+      if (b_ago >= end_secs_ago && b_end_ago < start_secs_ago) {
+        addToResult(dest, b->_min, b->_max, b->_sum, b->_count, total, num_values);
       }
+      covered_ago = b_ago;
     }
-    ago += interval_secs;
   }
+
   // calc average
   if (num_values > 0) {
     dest->_avg = total / num_values;
@@ -2,28 +2,127 @@
 
 #include <Arduino.h>
 #include <Mesh.h>
+#include <helpers/IdentityStore.h>
+
+#ifndef TS_MAX_LEVELS
+  #define TS_MAX_LEVELS   3
+#endif
+#define TS_SPILL_BATCH    32    // samples buffered before writing to spill file
 
 struct MinMaxAvg {
   float _min, _max, _avg;
   uint8_t _lpp_type, _channel;
 };
 
+struct SeriesBucket {
+  float _min, _max, _sum;
+  uint16_t _count;
+  uint32_t start;    // by OUR clock, aligned to the level's bucket_secs (zero if unused)
+};
+
+/**
+ * \brief  Raw samples (one per interval_secs) for the recent window, plus optional levels of pre-aggregated buckets
+ *     (eg. per hour, per day) for longer ranges, which are updated as each sample is recorded. A range query then only
+ *     has to visit the raw samples and the buckets, rather than keeping a raw sample for the whole range.
+ *
+ *     Raw samples can be stored as 16-bit fixed point (value = offset + n * scale), and samples aged out of RAM can
+ *     be spilled to a ring in flash, for a longer raw history than would fit in RAM.
+*/
 class TimeSeriesData {
-  float* data;
+  struct Level {
+    SeriesBucket* buckets;
+    int num, next;
+    uint32_t bucket_secs;
+  };
+
+  float* data;        // NULL if encoded
+  int16_t* enc_data;  // NULL if raw floats
+  float scale, offset;
   int num_slots, next;
   uint32_t last_timestamp;
   uint32_t interval_secs;
+  int num_recorded;
+  Level levels[TS_MAX_LEVELS];
+  int num_levels;
+
+  FILESYSTEM* spill_fs;
+  const char* spill_file;
+  int spill_max, spill_head, spill_count;   // ring in file
+  int16_t* spill_buf;       // pending, not yet written (oldest first)
+  int spill_buf_num;
+  uint32_t spill_last_ts;   // timestamp of newest spilled sample
+
+  float getSample(int i) const { return data ? data[i] : offset + enc_data[i] * scale; }
+  void putSample(int i, float value);
+  void spill(int16_t sample, uint32_t timestamp);
+  void flushSpill();
+  void loadSpillHeader();
+  /**
+   * \brief  calls fn(timestamp, encoded, value) for each raw sample (RAM, then spilled), newest first, until it returns false
+   * \returns  timestamp of the oldest sample visited, or zero if none
+  */
+  template <class F> uint32_t visitSamples(F& fn) const;
+  static void addToResult(MinMaxAvg* dest, float _min, float _max, float sum, int count, float& total, int& num_values);
+  void init() {
+    enc_data = NULL;
+    scale = 1.0f; offset = 0.0f;
+    num_recorded = num_levels = 0;
+    spill_fs = NULL; spill_buf = NULL;
+  }
 
 public:
-  TimeSeriesData(float* array, int num, uint32_t secs) : num_slots(num), data(array), last_timestamp(0), next(0), interval_secs(secs) { 
+  TimeSeriesData(float* array, int num, uint32_t secs) : num_slots(num), data(array), last_timestamp(0), next(0), interval_secs(secs) {
+    init();
     memset(data, 0, sizeof(float)*num);
   }
   TimeSeriesData(int num, uint32_t secs) : num_slots(num), last_timestamp(0), next(0), interval_secs(secs) {
+    init();
     data = new float[num];
     memset(data, 0, sizeof(float)*num);
   }
+  /**
+   * \brief  16-bit fixed point samples, eg. scale=0.001, offset=0 for volts in mV. Values outside the range are clamped.
+  */
+  TimeSeriesData(int num, uint32_t secs, float _scale, float _offset) : num_slots(num), last_timestamp(0), next(0), interval_secs(secs) {
+    init();
+    data = NULL;
+    enc_data = new int16_t[num];
+    memset(enc_data, 0, sizeof(int16_t)*num);
+    scale = _scale; offset = _offset;
+  }
+
+  /**
+   * \brief  add a level of aggregated buckets, eg. addLevel(24, 60*60) for hourly buckets over a day. Add the finer
+   *     levels first, and bucket_secs should be a multiple of the raw interval.
+   * \returns  false if already at TS_MAX_LEVELS
+  */
+  bool addLevel(int num_buckets, uint32_t bucket_secs);
+
+  /**
+   * \brief  (encoded series only) write samples aged out of RAM to a ring of 'max_samples' in a file, in batches
+   *     of TS_SPILL_BATCH. Is read back by calcMinMaxAvg() for the older part of a range.
+  */
+  bool setSpillFile(FILESYSTEM* fs, const char* filename, int max_samples);
 
   void recordData(mesh::RTCClock* clock, float value);
   void calcMinMaxAvg(mesh::RTCClock* clock, uint32_t start_secs_ago, uint32_t end_secs_ago, MinMaxAvg* dest, uint8_t channel, uint8_t lpp_type) const;
-};
 
+  /**
+   * \brief  (encoded series only) copy the RAM samples, newest first, as a compact block for sending as is
+   * \param  skip  number of newest samples to skip
+   * \returns  number of samples copied
+  */
+  int getEncoded(int skip, int16_t dest[], int max_num) const;
+  /**
+   * \brief  (encoded series only) read the raw samples (including any spilled to flash) older than 'before_ts', newest first
+   * \param  before_ts  timestamp of oldest sample from the previous read, or zero to start with the newest
+   * \param  newest_ts  (OUT) timestamp of dest[0]. The rest follow at (about) getInterval() secs apart.
+   * \param  oldest_ts  (OUT) timestamp of the last sample read, ie. the 'before_ts' for the next read
+   * \returns  number of samples read (zero if no more)
+  */
+  int readHistory(uint32_t before_ts, int16_t dest[], int max_num, uint32_t& newest_ts, uint32_t& oldest_ts) const;
+  float getScale() const { return scale; }
+  float getOffset() const { return offset; }
+  uint32_t getInterval() const { return interval_secs; }
+  uint32_t getLastTimestamp() const { return last_timestamp; }
+};
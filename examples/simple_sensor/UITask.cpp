@@ -1,6 +1,7 @@
 #include "UITask.h"
 #include <Arduino.h>
 #include <helpers/CommonCLI.h>
+#include <LoopMonitor.h>
 
 #define AUTO_OFF_MILLIS      20000  // 20 seconds
 #define BOOT_SCREEN_MILLIS   4000   // 4 seconds
@@ -81,6 +82,7 @@ void UITask::renderCurrScreen() {
 }
 
 void UITask::loop() {
+  LOOP_SCOPE(LOOP_SECT_UI);
 #ifdef PIN_USER_BTN
   if (millis() >= _next_read) {
     int btnState = digitalRead(PIN_USER_BTN);
@@ -1,4 +1,5 @@
 #include "SensorMesh.h"
+#include <LoopMonitor.h>
 
 #ifdef DISPLAY_CLASS
   #include "UITask.h"
@@ -9,8 +10,10 @@ class MyMesh : public SensorMesh {
 public:
   MyMesh(mesh::MainBoard& board, mesh::Radio& radio, mesh::MillisecondClock& ms, mesh::RNG& rng, mesh::RTCClock& rtc, mesh::MeshTables& tables)
      : SensorMesh(board, radio, ms, rng, rtc, tables), 
-       battery_data(12*24, 5*60)    // 24 hours worth of battery data, every 5 minutes
+       battery_data(12, 5*60, 0.001f, 0.0f)    // last hour of battery data, every 5 minutes (in mV)
   {
+    battery_data.addLevel(24, 60*60);     // then hourly, for a day
+    battery_data.addLevel(7, 24*60*60);   // and daily, for a week
   }
 
 protected:
@@ -31,6 +34,13 @@ protected:
     return 1;
   }
 
+  const TimeSeriesData* querySeries(int idx, uint8_t& channel, uint8_t& lpp_type) override {
+    if (idx != 0) return NULL;
+    channel = TELEM_CHANNEL_SELF;
+    lpp_type = LPP_VOLTAGE;
+    return &battery_data;
+  }
+
   bool handleCustomCommand(uint32_t sender_timestamp, char* command, char* reply) override {
     if (strcmp(command, "magic") == 0) {    // example 'custom' command handling
       strcpy(reply, "**Magic now done**");
@@ -41,7 +51,7 @@ protected:
   /* ======================================================================= */
 };
 
-StdRNG fast_rng;
+ChaChaRNG fast_rng;
 SimpleMeshTables tables;
 
 MyMesh the_mesh(board, radio_driver, *new ArduinoMillis(), fast_rng, rtc_clock, tables);
@@ -68,7 +78,10 @@ void setup() {
 
   if (!radio_init()) { halt(); }
 
-  fast_rng.begin(radio_get_rng_seed());
+  {
+    HardwareRNG seed_src(radio_get_rng_seed);   // 32 bytes of TRNG + radio noise
+    fast_rng.begin(seed_src);
+  }
 
   FILESYSTEM* fs;
 #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
@@ -115,6 +128,7 @@ void setup() {
 }
 
 void loop() {
+  LOOP_START();
   int len = strlen(command);
   while (Serial.available() && len < sizeof(command)-1) {
     char c = Serial.read();
@@ -145,4 +159,5 @@ void loop() {
   ui_task.loop();
 #endif
   rtc_clock.tick();
+  LOOP_END();
 }
@@ -29,3 +29,37 @@ void ed25519_sign(unsigned char *signature, const unsigned char *message, size_t
     sc_reduce(hram);
     sc_muladd(signature + 32, hram, private_key, r);
 }
+
+/* dom2(phflag=1, context="") from RFC 8032 */
+static const unsigned char ed25519ph_dom2[34] = {
+    'S','i','g','E','d','2','5','5','1','9',' ','n','o',' ','E','d','2','5','5','1','9',' ',
+    'c','o','l','l','i','s','i','o','n','s', 1, 0
+};
+
+void ed25519ph_sign(unsigned char *signature, const unsigned char *prehash, const unsigned char *public_key, const unsigned char *private_key) {
+    sha512_context hash;
+    unsigned char hram[64];
+    unsigned char r[64];
+    ge_p3 R;
+
+
+    sha512_init(&hash);
+    sha512_update(&hash, ed25519ph_dom2, sizeof(ed25519ph_dom2));
+    sha512_update(&hash, private_key + 32, 32);
+    sha512_update(&hash, prehash, 64);
+    sha512_final(&hash, r);
+
+    sc_reduce(r);
+    ge_scalarmult_base(&R, r);
+    ge_p3_tobytes(signature, &R);
+
+    sha512_init(&hash);
+    sha512_update(&hash, ed25519ph_dom2, sizeof(ed25519ph_dom2));
+    sha512_update(&hash, signature, 32);
+    sha512_update(&hash, public_key, 32);
+    sha512_update(&hash, prehash, 64);
+    sha512_final(&hash, hram);
+
+    sc_reduce(hram);
+    sc_muladd(signature + 32, hram, private_key, r);
+}
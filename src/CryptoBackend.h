@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string.h>
+
+/**
+ * Block cipher and hash implementations used by mesh::Utils, selected at build time:
+ *   MESH_CRYPTO_MBEDTLS  - the platform's mbedtls, which on ESP32 targets is backed by the AES/SHA accelerators
+ *   (default)            - the software AES128 and SHA256 from the Crypto library
+ * Both provide the same (subset of) the Crypto library's interface.
+*/
+
+#if defined(MESH_CRYPTO_MBEDTLS)
+
+#include <mbedtls/version.h>
+#include <mbedtls/aes.h>
+#include <mbedtls/sha256.h>
+
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+  #define MESH_SHA256_STARTS   mbedtls_sha256_starts
+  #define MESH_SHA256_UPDATE   mbedtls_sha256_update
+  #define MESH_SHA256_FINISH   mbedtls_sha256_finish
+#else
+  #define MESH_SHA256_STARTS   mbedtls_sha256_starts_ret
+  #define MESH_SHA256_UPDATE   mbedtls_sha256_update_ret
+  #define MESH_SHA256_FINISH   mbedtls_sha256_finish_ret
+#endif
+
+class CryptoAES128 {
+  mbedtls_aes_context _enc, _dec;
+
+  CryptoAES128(const CryptoAES128&) = delete;
+  CryptoAES128& operator=(const CryptoAES128&) = delete;
+
+public:
+  CryptoAES128() { mbedtls_aes_init(&_enc); mbedtls_aes_init(&_dec); }
+  ~CryptoAES128() { mbedtls_aes_free(&_enc); mbedtls_aes_free(&_dec); }
+
+  bool setKey(const uint8_t* key, size_t len) {
+    return mbedtls_aes_setkey_enc(&_enc, key, len * 8) == 0 && mbedtls_aes_setkey_dec(&_dec, key, len * 8) == 0;
+  }
+  void encryptBlock(uint8_t* output, const uint8_t* input) { mbedtls_aes_crypt_ecb(&_enc, MBEDTLS_AES_ENCRYPT, input, output); }
+  void decryptBlock(uint8_t* output, const uint8_t* input) { mbedtls_aes_crypt_ecb(&_dec, MBEDTLS_AES_DECRYPT, input, output); }
+};
+
+class CryptoSHA256 {
+  mbedtls_sha256_context _ctx;
+
+  void formatHMACKey(uint8_t* block, const void* key, size_t len, uint8_t pad) {
+    memset(block, 0, 64);
+    if (len > 64) {   // long keys are hashed first (as per RFC 2104)
+      CryptoSHA256 h;
+      h.update(key, len);
+      h.finalize(block, 32);
+    } else {
+      memcpy(block, key, len);
+    }
+    for (int i = 0; i < 64; i++) block[i] ^= pad;
+  }
+
+public:
+  CryptoSHA256() { mbedtls_sha256_init(&_ctx); reset(); }
+  CryptoSHA256(const CryptoSHA256& other) { mbedtls_sha256_init(&_ctx); mbedtls_sha256_clone(&_ctx, &other._ctx); }
+  CryptoSHA256& operator=(const CryptoSHA256& other) {
+    if (this != &other) {
+      mbedtls_sha256_free(&_ctx);   // releases the accelerator, if held
+      mbedtls_sha256_init(&_ctx);
+      mbedtls_sha256_clone(&_ctx, &other._ctx);
+    }
+    return *this;
+  }
+  ~CryptoSHA256() { mbedtls_sha256_free(&_ctx); }
+
+  void reset() { MESH_SHA256_STARTS(&_ctx, 0); }
+  void update(const void* data, size_t len) { MESH_SHA256_UPDATE(&_ctx, (const unsigned char *) data, len); }
+  void finalize(void* hash, size_t len) {
+    uint8_t full[32];
+    MESH_SHA256_FINISH(&_ctx, full);
+    memcpy(hash, full, len < sizeof(full) ? len : sizeof(full));
+  }
+
+  void resetHMAC(const void* key, size_t key_len) {
+    uint8_t block[64];
+    formatHMACKey(block, key, key_len, 0x36);
+    reset();
+    update(block, sizeof(block));
+  }
+  void finalizeHMAC(const void* key, size_t key_len, void* hash, size_t len) {
+    uint8_t inner[32];
+    finalize(inner, sizeof(inner));
+    uint8_t block[64];
+    formatHMACKey(block, key, key_len, 0x5C);
+    reset();
+    update(block, sizeof(block));
+    update(inner, sizeof(inner));
+    finalize(hash, len);
+  }
+};
+
+#else
+
+#include <AES.h>
+#include <SHA256.h>
+
+typedef AES128 CryptoAES128;
+typedef SHA256 CryptoSHA256;
+
+#endif
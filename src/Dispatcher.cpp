@@ -14,14 +14,54 @@ namespace mesh {
   #define NOISE_FLOOR_CALIB_INTERVAL   2000     // 2 seconds
 #endif
 
+#ifndef INBOUND_DRAIN_BUDGET
+  #define INBOUND_DRAIN_BUDGET          8
+#endif
+#ifndef INBOUND_DRAIN_MILLIS
+  #define INBOUND_DRAIN_MILLIS         20
+#endif
+#ifndef INBOUND_LATE_THRESHOLD_MILLIS
+  #define INBOUND_LATE_THRESHOLD_MILLIS   100
+#endif
+
+#define RX_DELAY_FRAC_BITS   12
+
+void RxDelayTable::build(float base) {
+  _base = base;
+  for (int i = 0; i <= RX_DELAY_TABLE_STEPS; i++) {
+    if (base <= 0.0f) {
+      _factor[i] = 0;   // disabled
+    } else {
+      float score = ((float) i) / RX_DELAY_TABLE_STEPS;
+      _factor[i] = (int32_t) ((pow(base, 0.85f - score) - 1.0) * (1 << RX_DELAY_FRAC_BITS));
+    }
+  }
+}
+
+int RxDelayTable::calc(float score, uint32_t air_time) const {
+  int i = (int) (score * RX_DELAY_TABLE_STEPS + 0.5f);
+  if (i < 0) i = 0;
+  if (i > RX_DELAY_TABLE_STEPS) i = RX_DELAY_TABLE_STEPS;
+  return (int) (((int64_t)_factor[i] * air_time) >> RX_DELAY_FRAC_BITS);
+}
+
 void Dispatcher::begin() {
   n_sent_flood = n_sent_direct = 0;
   n_recv_flood = n_recv_direct = 0;
+  n_inbound_late = 0;
+  for (int i = 0; i < LATENCY_HIST_NUM; i++) latency_hist[i].reset();
   _err_flags = 0;
   radio_nonrx_start = _ms->getMillis();
+#if MESH_PROFILING
+  RecvProfiler::begin();
+#endif
+
+  rx_delay_table.build(getRxDelayBase());
 
   _radio->begin();
   prev_isrecv_mode = _radio->isInRecvMode();
+
+  if (_peer && !_host) _peer->begin();   // attached radio port
 }
 
 float Dispatcher::getAirtimeBudgetFactor() const {
@@ -29,7 +69,18 @@ float Dispatcher::getAirtimeBudgetFactor() const {
 }
 
 int Dispatcher::calcRxDelay(float score, uint32_t air_time) const {
-  return (int) ((pow(10, 0.85f - score) - 1.0) * air_time);
+  return rx_delay_table.calc(score, air_time);
+}
+
+float Dispatcher::getRxDelayBase() const {
+  return 10.0f;
+}
+
+int Dispatcher::getInboundDrainBudget() const {
+  return INBOUND_DRAIN_BUDGET;
+}
+uint32_t Dispatcher::getInboundDrainMillis() const {
+  return INBOUND_DRAIN_MILLIS;
 }
 
 uint32_t Dispatcher::getCADFailRetryDelay() const {
@@ -39,7 +90,56 @@ uint32_t Dispatcher::getCADFailMaxDuration() const {
   return 4000;   // 4 seconds
 }
 
+void Dispatcher::limitWakeup(uint32_t& wait, unsigned long now, unsigned long timestamp) {
+  long diff = (long) (timestamp - now);
+  if (diff <= 0) {
+    wait = 0;
+  } else if ((unsigned long) diff < wait) {
+    wait = diff;
+  }
+}
+
+uint32_t Dispatcher::getMillisToNextWakeup(uint32_t max_millis) {
+  if (_err_flags & ERR_EVENT_STARTRX_TIMEOUT) return 0;   // let the app deal with a stuck radio first
+
+  unsigned long now = _ms->getMillis();
+  uint32_t wait = max_millis;
+
+  limitWakeup(wait, now, next_floor_calib_time);
+  if (getAGCResetInterval() > 0) {
+    limitWakeup(wait, now, next_agc_reset_time);
+  }
+
+  if (_peer && !_host) {
+    wait = _peer->getMillisToNextWakeup(wait);
+  }
+
+  uint32_t t;
+  if (_mgr->getNextInboundTime(&t)) {
+    limitWakeup(wait, now, t);
+  }
+  if (outbound) {
+    limitWakeup(wait, now, outbound_expiry);   // send complete will raise radio IRQ before this
+  } else if (_mgr->getNextOutboundTime(&t)) {
+    if ((long) (next_tx_time - t) > 0) {
+      t = next_tx_time;   // can't send until 'radio silence' phase is over
+    }
+    limitWakeup(wait, now, t);
+  }
+  return wait;
+}
+
+bool Dispatcher::isIdle() {
+  uint32_t t;
+  if (outbound || _mgr->getNextOutboundTime(&t) || _mgr->getNextInboundTime(&t)) return false;
+  if (_peer && !_host && !_peer->isIdle()) return false;
+
+  return _radio->isInRecvMode() && !_radio->isReceiving();
+}
+
 void Dispatcher::loop() {
+  if (_peer && !_host) _peer->loop();   // attached radio port
+
   if (millisHasNowPassed(next_floor_calib_time)) {
     _radio->triggerNoiseFloorCalibrate(getInterferenceThreshold());
     next_floor_calib_time = futureMillis(NOISE_FLOOR_CALIB_INTERVAL);
@@ -58,6 +158,8 @@ void Dispatcher::loop() {
     _err_flags |= ERR_EVENT_STARTRX_TIMEOUT;
   }
 
+  drainInbound();   // process delayed inbound packets, even while a send is in progress
+
   if (outbound) {  // waiting for outbound send to be completed
     if (_radio->isSendComplete()) {
       long t = _ms->getMillis() - outbound_start;
@@ -68,6 +170,7 @@ void Dispatcher::loop() {
       next_tx_time = futureMillis(t * getAirtimeBudgetFactor());
 
       _radio->onSendFinished();
+      onTxAirtimeUsed(outbound, t);
       logTx(outbound, 2 + outbound->path_len + outbound->payload_len);
       if (outbound->isRouteFlood()) {
         n_sent_flood++;
@@ -97,24 +200,37 @@ void Dispatcher::loop() {
     next_agc_reset_time = futureMillis(getAGCResetInterval());
   }
 
-  // check inbound (delayed) queue
-  {
-    Packet* pkt = _mgr->getNextInbound(_ms->getMillis());
-    if (pkt) {
-      processRecvPacket(pkt);
-    }
-  }
   checkRecv();
   checkSend();
 }
 
+void Dispatcher::drainInbound() {
+  unsigned long start = _ms->getMillis();
+  int budget = getInboundDrainBudget();
+  while (budget-- > 0) {
+    uint32_t now = _ms->getMillis();
+    uint32_t scheduled_for;
+    Packet* pkt = _mgr->getNextInbound(now, &scheduled_for);
+    if (pkt == NULL) break;   // nothing more is due
+
+    long late = (long)(now - scheduled_for);
+    if (late > INBOUND_LATE_THRESHOLD_MILLIS) {
+      n_inbound_late++;   // missed its scheduled slot (eg. queue backed up, or loop() stalled)
+    }
+    latency_hist[LATENCY_HIST_RX_PROCESS].record(late > 0 ? late : 0);
+    processRecvPacket(pkt);
+
+    if (_ms->getMillis() - start >= getInboundDrainMillis()) break;   // time slice used up
+  }
+}
+
 void Dispatcher::checkRecv() {
   Packet* pkt;
   float score;
   uint32_t air_time;
   {
-    uint8_t raw[MAX_TRANS_UNIT+1];
-    int len = _radio->recvRaw(raw, MAX_TRANS_UNIT);
+    const uint8_t* raw = wire_buf;
+    int len = _radio->recvRaw(wire_buf, MAX_TRANS_UNIT);
     if (len > 0) {
       logRxRaw(_radio->getLastSNR(), _radio->getLastRSSI(), raw, len);
 
@@ -122,45 +238,21 @@ void Dispatcher::checkRecv() {
       if (pkt == NULL) {
         MESH_DEBUG_PRINTLN("%s Dispatcher::checkRecv(): WARNING: received data, no unused packets available!", getLogDateTime());
       } else {
-        int i = 0;
-#ifdef NODE_ID
-        uint8_t sender_id = raw[i++];
-        if (sender_id == NODE_ID - 1 || sender_id == NODE_ID + 1) {  // simulate that NODE_ID can only hear NODE_ID-1 or NODE_ID+1, eg. 3 can't hear 1
-        } else {
-          _mgr->free(pkt);  // put back into pool
-          return;
-        }
-#endif
-
-        pkt->header = raw[i++];
-        if (pkt->hasTransportCodes()) {
-          memcpy(&pkt->transport_codes[0], &raw[i], 2); i += 2;
-          memcpy(&pkt->transport_codes[1], &raw[i], 2); i += 2;
-        } else {
-          pkt->transport_codes[0] = pkt->transport_codes[1] = 0;
-        }
-        pkt->path_len = raw[i++];
-
-        if (pkt->path_len > MAX_PATH_SIZE || i + pkt->path_len > len) {
+      #if MESH_PROFILING
+        uint32_t t_decode = RecvProfiler::now();
+      #endif
+        if (!decodeRawPacket(pkt, raw, len)) {
           MESH_DEBUG_PRINTLN("%s Dispatcher::checkRecv(): partial or corrupt packet received, len=%d", getLogDateTime(), len);
           _mgr->free(pkt);  // put back into pool
           pkt = NULL;
         } else {
-          memcpy(pkt->path, &raw[i], pkt->path_len); i += pkt->path_len;
-
-          pkt->payload_len = len - i;  // payload is remainder
-          if (pkt->payload_len > sizeof(pkt->payload)) {
-            MESH_DEBUG_PRINTLN("%s Dispatcher::checkRecv(): packet payload too big, payload_len=%d", getLogDateTime(), (uint32_t)pkt->payload_len);
-            _mgr->free(pkt);  // put back into pool
-            pkt = NULL;  
-          } else {
-            memcpy(pkt->payload, &raw[i], pkt->payload_len);
-
-            pkt->_snr = _radio->getLastSNR() * 4.0f;
-            score = _radio->packetScore(_radio->getLastSNR(), len);
-            air_time = _radio->getEstAirtimeFor(len);
-            rx_air_time += air_time;
-          }
+          pkt->_snr = _radio->getLastSNR() * 4.0f;
+          score = _radio->packetScore(_radio->getLastSNR(), len);
+          air_time = _radio->getEstAirtimeFor(len);
+          rx_air_time += air_time;
+        #if MESH_PROFILING
+          (_host ? _host : this)->_prof.add(pkt->getPayloadType(), PROF_STAGE_DECODE, RecvProfiler::now() - t_decode);
+        #endif
         }
       }
     } else {
@@ -191,9 +283,14 @@ void Dispatcher::checkRecv() {
     if (pkt->isRouteFlood()) {
       n_recv_flood++;
 
+      float base = getRxDelayBase();
+      if (base != rx_delay_table.getBase()) {
+        rx_delay_table.build(base);   // prefs have changed, only now recalc the curve
+      }
       int _delay = calcRxDelay(score, air_time);
       if (_delay < 50) {
         MESH_DEBUG_PRINTLN("%s Dispatcher::checkRecv(), score delay below threshold (%d)", getLogDateTime(), _delay);
+        latency_hist[LATENCY_HIST_RX_PROCESS].record(0);
         processRecvPacket(pkt);   // is below the score delay threshold, so process immediately
       } else {
         MESH_DEBUG_PRINTLN("%s Dispatcher::checkRecv(), score delay is: %d millis", getLogDateTime(), _delay);
@@ -204,13 +301,36 @@ void Dispatcher::checkRecv() {
       }
     } else {
       n_recv_direct++;
+      latency_hist[LATENCY_HIST_RX_PROCESS].record(0);
       processRecvPacket(pkt);
     }
   }
 }
 
+bool Dispatcher::decodeRawPacket(Packet* pkt, const uint8_t* raw, int len) {
+  int i = pkt->readHeader(raw, len);
+  if (i < 0) return false;
+
+  pkt->payload_len = len - i;  // payload is remainder
+  if (pkt->payload_len > sizeof(pkt->payload)) {
+    MESH_DEBUG_PRINTLN("%s Dispatcher::checkRecv(): packet payload too big, payload_len=%d", getLogDateTime(), (uint32_t)pkt->payload_len);
+    return false;
+  }
+  memcpy(pkt->payload, &raw[i], pkt->payload_len);
+  return true;
+}
+
 void Dispatcher::processRecvPacket(Packet* pkt) {
-  DispatcherAction action = onRecvPacket(pkt);
+  unsigned long t_start = _ms->getMillis();
+#if MESH_PROFILING
+  RecvProfiler& prof = (_host ? _host : this)->_prof;
+  prof.startPacket(pkt->getPayloadType());
+#endif
+  DispatcherAction action = _host ? _host->onRecvPacket(pkt) : onRecvPacket(pkt);
+  latency_hist[LATENCY_HIST_RECV_EXEC].record(_ms->getMillis() - t_start);
+#if MESH_PROFILING
+  prof.enter(PROF_STAGE_QUEUE);
+#endif
   if (action == ACTION_RELEASE) {
     _mgr->free(pkt);
   } else if (action == ACTION_MANUAL_HOLD) {
@@ -219,12 +339,49 @@ void Dispatcher::processRecvPacket(Packet* pkt) {
     uint8_t priority = (action >> 24) - 1;
     uint32_t _delay = action & 0xFFFFFF;
 
+    pkt->_heard = 0;
+    queueOnPeer(pkt, priority, _delay);
+    queueOnChannels(pkt, priority, _delay);
     _mgr->queueOutbound(pkt, priority, futureMillis(_delay));
   }
+#if MESH_PROFILING
+  prof.endPacket();
+#endif
+}
+
+void Dispatcher::queueOnPeer(const Packet* packet, uint8_t priority, uint32_t delay_millis) {
+  if (_peer == NULL) return;
+  if (!(_host ? _host : this)->allowSendOnPeer(packet)) return;
+
+  Packet* copy = _mgr->allocNew();   // pool is shared with peer
+  if (copy == NULL) {
+    MESH_DEBUG_PRINTLN("%s Dispatcher::queueOnPeer(): no unused packets, not sent on other radio", getLogDateTime());
+    return;
+  }
+  *copy = *packet;
+  _peer->_mgr->queueOutbound(copy, priority, _peer->futureMillis(delay_millis));
+}
+
+void Dispatcher::queueOnChannels(const Packet* packet, uint8_t priority, uint32_t delay_millis) {
+  if (packet->_tx_channel) return;   // is already a copy for a specific channel
+
+  uint32_t channels = getExtraTxChannels(packet);
+  for (int ch = 0; channels != 0; ch++, channels >>= 1) {
+    if ((channels & 1) == 0) continue;
+
+    Packet* copy = _mgr->allocNew();
+    if (copy == NULL) {
+      MESH_DEBUG_PRINTLN("%s Dispatcher::queueOnChannels(): no unused packets, not sent on channel %d", getLogDateTime(), ch);
+      return;
+    }
+    *copy = *packet;
+    copy->_tx_channel = ch + 1;
+    _mgr->queueOutbound(copy, priority, futureMillis(delay_millis));
+  }
 }
 
 void Dispatcher::checkSend() {
-  if (_mgr->getOutboundCount(_ms->getMillis()) == 0) return;  // nothing waiting to send
+  if (!_mgr->hasOutboundDue(_ms->getMillis())) return;  // nothing waiting to send
   if (!millisHasNowPassed(next_tx_time)) return;   // still in 'radio silence' phase (from airtime budget setting)
   if (_radio->isReceiving()) {   // LBT - check if radio is currently mid-receive, or if channel activity
     if (cad_busy_start == 0) {
@@ -242,32 +399,49 @@ void Dispatcher::checkSend() {
       return;
     }
   }
+  if (cad_busy_start != 0) {
+    latency_hist[LATENCY_HIST_CAD_BUSY].record(_ms->getMillis() - cad_busy_start);
+  }
   cad_busy_start = 0;  // reset busy state
 
-  outbound = _mgr->getNextOutbound(_ms->getMillis());
+  uint8_t priority;
+  uint32_t scheduled_for;
+  _mgr->setOutboundAging(getOutboundAgingMillis());
+  outbound = _mgr->getNextOutbound(_ms->getMillis(), &priority, &scheduled_for);
+  if (outbound) outbound = prepareOutbound(outbound);
   if (outbound) {
     int len = 0;
-    uint8_t raw[MAX_TRANS_UNIT];
+    uint8_t* raw = wire_buf;
 
-#ifdef NODE_ID
-    raw[len++] = NODE_ID;
-#endif
-    raw[len++] = outbound->header;
-    if (outbound->hasTransportCodes()) {
-      memcpy(&raw[len], &outbound->transport_codes[0], 2); len += 2;
-      memcpy(&raw[len], &outbound->transport_codes[1], 2); len += 2;
-    }
-    raw[len++] = outbound->path_len;
-    memcpy(&raw[len], outbound->path, outbound->path_len); len += outbound->path_len;
-
-    if (len + outbound->payload_len > MAX_TRANS_UNIT) {
-      MESH_DEBUG_PRINTLN("%s Dispatcher::checkSend(): FATAL: Invalid packet queued... too long, len=%d", getLogDateTime(), len + outbound->payload_len);
+    if (len + outbound->getRawLength() > MAX_TRANS_UNIT) {
+      MESH_DEBUG_PRINTLN("%s Dispatcher::checkSend(): FATAL: Invalid packet queued... too long, len=%d", getLogDateTime(), len + outbound->getRawLength());
       _mgr->free(outbound);
       outbound = NULL;
     } else {
-      memcpy(&raw[len], outbound->payload, outbound->payload_len); len += outbound->payload_len;
+      len += outbound->writeTo(&raw[len]);
+
+      bool long_preamble = needsLongPreamble(outbound);
+      uint32_t est_airtime = _radio->getEstAirtimeFor(len, long_preamble);
+      uint32_t budget_delay = getTxBudgetDelay(outbound, est_airtime);
+      if (budget_delay == AIRTIME_NEVER) {
+        MESH_DEBUG_PRINTLN("%s Dispatcher::checkSend(): packet exceeds airtime budget, dropping", getLogDateTime());
+        releasePacket(outbound);
+        outbound = NULL;
+        return;
+      }
+      if (budget_delay > 0) {   // over duty-cycle budget for this class, try again later
+        _mgr->queueOutbound(outbound, priority, futureMillis(budget_delay));
+        outbound = NULL;
+        return;
+      }
+
+      // only now it's actually being sent, apply its radio settings
+      _radio->setLongPreamble(long_preamble);
+      _radio->setTxFrequency(getTxFrequencyFor(outbound));
+      int8_t tx_power = getTxPowerFor(outbound);
+      if (tx_power) _radio->setOutputPower(tx_power);
 
-      uint32_t max_airtime = _radio->getEstAirtimeFor(len)*3/2;
+      uint32_t max_airtime = est_airtime*3/2;
       outbound_start = _ms->getMillis();
       bool success = _radio->startSendRaw(raw, len);
       if (!success) {
@@ -280,6 +454,8 @@ void Dispatcher::checkSend() {
         return;
       }
       outbound_expiry = futureMillis(max_airtime);
+      long waited = (long)(outbound_start - scheduled_for);
+      latency_hist[LATENCY_HIST_TX_QUEUE].record(waited > 0 ? waited : 0);
 
     #if MESH_PACKET_LOGGING
       Serial.print(getLogDateTime());
@@ -302,7 +478,9 @@ Packet* Dispatcher::obtainNewPacket() {
     _err_flags |= ERR_EVENT_FULL;
   } else {
     pkt->payload_len = pkt->path_len = 0;
+    pkt->path_hash_size = PATH_HASH_SIZE;
     pkt->_snr = 0;
+    pkt->_tx_channel = 0;
   }
   return pkt;
 }
@@ -316,6 +494,9 @@ void Dispatcher::sendPacket(Packet* packet, uint8_t priority, uint32_t delay_mil
     MESH_DEBUG_PRINTLN("%s Dispatcher::sendPacket(): ERROR: invalid packet... path_len=%d, payload_len=%d", getLogDateTime(), (uint32_t) packet->path_len, (uint32_t) packet->payload_len);
     _mgr->free(packet);
   } else {
+    packet->_heard = 0;
+    queueOnPeer(packet, priority, delay_millis);
+    queueOnChannels(packet, priority, delay_millis);
     _mgr->queueOutbound(packet, priority, futureMillis(delay_millis));
   }
 }
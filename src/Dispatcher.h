@@ -4,6 +4,7 @@
 #include <Identity.h>
 #include <Packet.h>
 #include <Utils.h>
+#include <Profiler.h>
 #include <string.h>
 
 namespace mesh {
@@ -36,8 +37,35 @@ public:
   */
   virtual uint32_t getEstAirtimeFor(int len_bytes) = 0;
 
+  /**
+   * \returns  as above, but for sending with (or without) the long preamble, whatever the current setting.
+  */
+  virtual uint32_t getEstAirtimeFor(int len_bytes, bool long_preamble) { return getEstAirtimeFor(len_bytes); }
+
   virtual float packetScore(float snr, int packet_len) = 0;
 
+  /**
+   * \brief  use a long preamble for the next send (ie. for receivers which are duty-cycling their Rx). Is reverted
+   *     by onSendFinished().
+  */
+  virtual void setLongPreamble(bool enable) { }
+
+  /**
+   * \brief  send the next packet on other than the configured frequency. Is reverted by onSendFinished().
+   * \param  freq  MHz, or zero for the configured one
+  */
+  virtual void setTxFrequency(float freq) { }
+
+  /**
+   * \brief  output power for the next packet(s), eg. from Dispatcher::getTxPowerFor(). (NOT reverted after send)
+  */
+  virtual void setOutputPower(int8_t dbm) { }
+
+  /**
+   * \returns  approx. minimum SNR (dB) a packet can be received at, with the current modulation params
+  */
+  virtual float getMinSNR() const { return -20.0f; }
+
   /**
    * \brief  starts the raw packet send. (no wait)
    * \param  bytes   the raw packet data
@@ -88,13 +116,87 @@ public:
   virtual void free(Packet* packet) = 0;
 
   virtual void queueOutbound(Packet* packet, uint8_t priority, uint32_t scheduled_for) = 0;
-  virtual Packet* getNextOutbound(uint32_t now) = 0;    // by priority
+  virtual Packet* getNextOutbound(uint32_t now, uint8_t* priority=NULL, uint32_t* scheduled_for=NULL) = 0;    // by priority
+
+  /**
+   * \brief  starvation protection: a due packet gains one priority step for every 'millis' it has waited (zero to disable)
+  */
+  virtual void setOutboundAging(uint32_t millis) { }   // not supported by default
   virtual int getOutboundCount(uint32_t now) const = 0;
+  virtual bool hasOutboundDue(uint32_t now) const { return getOutboundCount(now) > 0; }
   virtual int getFreeCount() const = 0;
   virtual Packet* getOutboundByIdx(int i) = 0;
   virtual Packet* removeOutboundByIdx(int i) = 0;
   virtual void queueInbound(Packet* packet, uint32_t scheduled_for) = 0;
-  virtual Packet* getNextInbound(uint32_t now) = 0;
+  virtual Packet* getNextInbound(uint32_t now, uint32_t* scheduled_for=NULL) = 0;
+
+  /**
+   * \brief  find the earliest 'scheduled_for' time amongst the queued outbound/inbound packets.
+   * \returns  false if the queue is empty
+  */
+  virtual bool getNextOutboundTime(uint32_t* scheduled_for) const = 0;
+  virtual bool getNextInboundTime(uint32_t* scheduled_for) const = 0;
+
+  /**
+   * \brief  the 'scheduled_for' time of an outbound packet, by index (as for getOutboundByIdx())
+   * \returns  false if not supported
+  */
+  virtual bool getOutboundTimeByIdx(int i, uint32_t* scheduled_for) const { return false; }
+};
+
+#ifndef RX_DELAY_TABLE_STEPS
+  #define RX_DELAY_TABLE_STEPS   32     // quantisation of packet score [0..1]
+#endif
+
+/**
+ * \brief  Precomputed curve of rx delay multipliers (base^(0.85 - score) - 1), in 20.12 fixed point,
+ *     keyed on quantised packet score. Rebuilt only when the base changes, so calc() needs no libm.
+*/
+class RxDelayTable {
+  int32_t _factor[RX_DELAY_TABLE_STEPS + 1];
+  float _base;
+
+public:
+  RxDelayTable() { build(0.0f); }
+
+  void build(float base);
+  float getBase() const { return _base; }
+
+  /**
+   * \returns  delay (in milliseconds) for given packet score and air time. Can be negative.
+  */
+  int calc(float score, uint32_t air_time) const;
+};
+
+#define LATENCY_HIST_BUCKETS   8
+
+#define LATENCY_HIST_RX_PROCESS    0   // how late (inbound) packets are processed, relative to when due
+#define LATENCY_HIST_TX_QUEUE      1   // how long outbound packets wait to be sent, after being due
+#define LATENCY_HIST_CAD_BUSY      2   // how long LBT waits for channel to be clear
+#define LATENCY_HIST_RECV_EXEC     3   // execution time of onRecvPacket()
+#define LATENCY_HIST_NUM           4
+
+/**
+ * \brief  A cheap, fixed-bucket histogram of millisecond durations.
+ *     Bucket upper bounds are: 0, 2, 8, 32, 128, 512, 2048 millis, then everything above.
+*/
+class LatencyHistogram {
+  uint32_t _counts[LATENCY_HIST_BUCKETS];
+
+public:
+  LatencyHistogram() { reset(); }
+
+  void reset() { memset(_counts, 0, sizeof(_counts)); }
+  void record(uint32_t millis) {
+    int i = 0;
+    uint32_t limit = 0;
+    while (i < LATENCY_HIST_BUCKETS - 1 && millis > limit) {
+      i++;
+      limit = limit ? (limit << 2) : 2;
+    }
+    _counts[i]++;
+  }
+  uint32_t getCount(int bucket) const { return _counts[bucket]; }
 };
 
 typedef uint32_t  DispatcherAction;
@@ -104,6 +206,20 @@ typedef uint32_t  DispatcherAction;
 #define ACTION_RETRANSMIT(pri)   (((uint32_t)1 + (pri))<<24)
 #define ACTION_RETRANSMIT_DELAYED(pri, _delay)  ((((uint32_t)1 + (pri))<<24) | (_delay))
 
+// QoS classes, ie. the outbound queue priority (lower is more urgent)
+#define QOS_CONTROL   0   // ACKs, and zero-hop packets
+#define QOS_DIRECT    1   // direct routed datagrams (sent or forwarded)
+#define QOS_FLOOD     2   // flood datagrams. Forwarded floods get one step lower per hop travelled
+#define QOS_ADVERT    4
+#define QOS_BULK      6   // TRACE, and other background traffic
+
+#ifndef QOS_AGING_MILLIS
+  #define QOS_AGING_MILLIS   4000    // default for getOutboundAgingMillis()
+#endif
+
+#define AIRTIME_NEVER          0xFFFFFFFF   // from getTxBudgetDelay(): packet can never be sent, so drop it
+#define OUTBOUND_ANY_TIME      0xFFFFFFFF   // 'now' for getOutboundCount(), to count every queued packet (due or not)
+
 #define ERR_EVENT_FULL              (1 << 0)
 #define ERR_EVENT_CAD_TIMEOUT       (1 << 1)
 #define ERR_EVENT_STARTRX_TIMEOUT   (1 << 2)
@@ -122,17 +238,28 @@ class Dispatcher {
   bool  prev_isrecv_mode;
   uint32_t n_sent_flood, n_sent_direct;
   uint32_t n_recv_flood, n_recv_direct;
+  uint32_t n_inbound_late;
+  uint8_t wire_buf[MAX_TRANS_UNIT+1];   // raw frame buffer, shared by RX and TX (they never overlap)
+  RxDelayTable rx_delay_table;
+  LatencyHistogram latency_hist[LATENCY_HIST_NUM];
+  Dispatcher* _host;   // if this drives a secondary radio port, the Dispatcher which handles its received packets
+  Dispatcher* _peer;   // the other radio (host <-> port), or NULL
 
   void processRecvPacket(Packet* pkt);
+  void queueOnPeer(const Packet* packet, uint8_t priority, uint32_t delay_millis);
+  void queueOnChannels(const Packet* packet, uint8_t priority, uint32_t delay_millis);
 
 protected:
   PacketManager* _mgr;
   Radio* _radio;
   MillisecondClock* _ms;
   uint16_t _err_flags;
+#if MESH_PROFILING
+  RecvProfiler _prof;
+#endif
 
   Dispatcher(Radio& radio, MillisecondClock& ms, PacketManager& mgr)
-    : _radio(&radio), _ms(&ms), _mgr(&mgr)
+    : _mgr(&mgr), _radio(&radio), _ms(&ms)
   {
     outbound = NULL;
     total_air_time = rx_air_time = 0;
@@ -142,10 +269,17 @@ protected:
     _err_flags = 0;
     radio_nonrx_start = 0;
     prev_isrecv_mode = true;
+    _host = _peer = NULL;
   }
 
   virtual DispatcherAction onRecvPacket(Packet* pkt) = 0;
 
+  /**
+   * \brief  last chance to change the packet about to be sent, eg. to pack queued ones in with it.
+   * \returns  the packet to send instead (if not 'pkt', then 'pkt' must have been released)
+  */
+  virtual Packet* prepareOutbound(Packet* pkt) { return pkt; }
+
   virtual void logRxRaw(float snr, float rssi, const uint8_t raw[], int len) { }   // custom hook
 
   virtual void logRx(Packet* packet, int len, float score) { }   // hooks for custom logging
@@ -154,11 +288,51 @@ protected:
   virtual const char* getLogDateTime() { return ""; }
 
   virtual float getAirtimeBudgetFactor() const;
+
+  /**
+   * \brief  hook for a duty-cycle governor, consulted just before transmitting.
+   * \returns  millis to defer the packet by (it is re-queued), zero to send now, or AIRTIME_NEVER to drop it.
+  */
+  virtual uint32_t getTxBudgetDelay(const Packet* packet, uint32_t est_air_time) { return 0; }
+  virtual void onTxAirtimeUsed(const Packet* packet, uint32_t air_time) { }
   virtual int calcRxDelay(float score, uint32_t air_time) const;
+  virtual float getRxDelayBase() const;   // zero or less disables the default rx delay
   virtual uint32_t getCADFailRetryDelay() const;
   virtual uint32_t getCADFailMaxDuration() const;
   virtual int getInterferenceThreshold() const { return 0; }    // disabled by default
   virtual int getAGCResetInterval() const { return 0; }    // disabled by default
+  virtual uint32_t getOutboundAgingMillis() const { return QOS_AGING_MILLIS; }   // see PacketManager::setOutboundAging()
+  virtual int getInboundDrainBudget() const;     // max number of delayed inbound packets to process per loop()
+  virtual uint32_t getInboundDrainMillis() const;   // max time to spend processing delayed inbound packets per loop()
+
+  /**
+   * \brief  with a second radio attached (attachPort()), whether a packet being sent or retransmitted on one radio
+   *     should also be sent on the other one.
+  */
+  virtual bool allowSendOnPeer(const Packet* packet) { return true; }
+
+  /**
+   * \returns  true if the packet is for (or may be heard by) a neighbour with a duty-cycled receiver, so needs to be
+   *     sent with a long preamble.
+  */
+  virtual bool needsLongPreamble(const Packet* packet) { return false; }
+
+  /**
+   * \brief  (multi-channel) for a packet being sent or retransmitted, the home channels (bitmask) other than our own
+   *     which a copy should also be sent on, eg. for a flood to reach neighbours on those channels.
+  */
+  virtual uint32_t getExtraTxChannels(const Packet* packet) { return 0; }
+
+  /**
+   * \returns  (multi-channel) frequency to send the packet on (see Packet::_tx_channel), or zero for our own
+  */
+  virtual float getTxFrequencyFor(const Packet* packet) { return 0; }
+
+  /**
+   * \returns  output power (dBm) to send the packet at, eg. less for a direct hop to a close neighbour, or zero to leave
+   *     the radio as it is
+  */
+  virtual int8_t getTxPowerFor(const Packet* packet) { return 0; }
 
 public:
   void begin();
@@ -168,23 +342,79 @@ public:
   void releasePacket(Packet* packet);
   void sendPacket(Packet* packet, uint8_t priority, uint32_t delay_millis=0);
 
+  /**
+   * \brief  Attach a second radio, driven by 'port' with its own outbound queue and airtime budget. Packets received
+   *     by the port are handled by this Dispatcher's onRecvPacket() (so dedup and forwarding decisions are shared), and
+   *     sends and retransmits on either radio are copied to the other (see allowSendOnPeer()). The port must allocate
+   *     from the same packet pool as this, and is then driven by this Dispatcher's begin() and loop().
+  */
+  void attachPort(Dispatcher& port) {
+    port._host = this;
+    port._peer = this;
+    _peer = &port;
+  }
+  const Dispatcher* getPort() const { return _host ? NULL : _peer; }
+
   unsigned long getTotalAirTime() const { return total_air_time; }  // in milliseconds
   unsigned long getReceiveAirTime() const {return rx_air_time; }
   uint32_t getNumSentFlood() const { return n_sent_flood; }
   uint32_t getNumSentDirect() const { return n_sent_direct; }
   uint32_t getNumRecvFlood() const { return n_recv_flood; }
   uint32_t getNumRecvDirect() const { return n_recv_direct; }
+  uint32_t getNumInboundLate() const { return n_inbound_late; }
+  const LatencyHistogram& getLatencyHistogram(int which) const { return latency_hist[which]; }   // LATENCY_HIST_*
+#if MESH_PROFILING
+  const RecvProfiler& getRecvProfiler() const { return _prof; }
+#endif
+  /** \brief  the packet and airtime counters, as plain data, eg. to carry them over a warm restart */
+  struct Counters {
+    uint32_t n_sent_flood, n_sent_direct;
+    uint32_t n_recv_flood, n_recv_direct;
+    uint32_t total_air_time, rx_air_time;
+  };
+  void getCounters(Counters& c) const {
+    c.n_sent_flood = n_sent_flood; c.n_sent_direct = n_sent_direct;
+    c.n_recv_flood = n_recv_flood; c.n_recv_direct = n_recv_direct;
+    c.total_air_time = total_air_time; c.rx_air_time = rx_air_time;
+  }
+  void setCounters(const Counters& c) {
+    n_sent_flood = c.n_sent_flood; n_sent_direct = c.n_sent_direct;
+    n_recv_flood = c.n_recv_flood; n_recv_direct = c.n_recv_direct;
+    total_air_time = c.total_air_time; rx_air_time = c.rx_air_time;
+  }
+
   void resetStats() {
     n_sent_flood = n_sent_direct = n_recv_flood = n_recv_direct = 0;
+    n_inbound_late = 0;
+    for (int i = 0; i < LATENCY_HIST_NUM; i++) latency_hist[i].reset();
+  #if MESH_PROFILING
+    _prof.reset();
+  #endif
     _err_flags = 0;
   }
 
+  /**
+   * \brief  How long the board can idle (eg. sleep, waking on radio IRQ) before loop() next has work to do.
+   * \param  max_millis  upper limit of the result
+   * \returns  millis until next event, or zero if there is work to do right now.
+  */
+  virtual uint32_t getMillisToNextWakeup(uint32_t max_millis);
+
+  /**
+   * \returns  true if nothing is queued (inbound or outbound), being sent, or being received. ie. the board could
+   *      deep sleep with the radio left in Rx (see MainBoard::enterRxSleep())
+  */
+  bool isIdle();
+
   // helper methods
   bool millisHasNowPassed(unsigned long timestamp) const;
   unsigned long futureMillis(int millis_from_now) const;
+  static void limitWakeup(uint32_t& wait, unsigned long now, unsigned long timestamp);   // ie. wait = min(wait, timestamp - now)
+  bool decodeRawPacket(Packet* pkt, const uint8_t* raw, int len);   // from the over-the-air frame format
 
 private:
   void checkRecv();
+  void drainInbound();
   void checkSend();
 };
 
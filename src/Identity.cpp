@@ -2,6 +2,7 @@
 #include <string.h>
 #define ED25519_NO_SEED  1
 #include <ed_25519.h>
+#include <sha512.h>
 #include <Ed25519.h>
 
 namespace mesh {
@@ -92,6 +93,22 @@ void LocalIdentity::sign(uint8_t* sig, const uint8_t* message, int msg_len) cons
   ed25519_sign(sig, message, msg_len, pub_key, prv_key);
 }
 
+void LocalIdentity::signStart(SignState& state) const {
+  static_assert(sizeof(state.ctx) >= sizeof(sha512_context), "SignState too small");
+  sha512_init((sha512_context *) state.ctx);
+}
+
+void LocalIdentity::signUpdate(SignState& state, const uint8_t* data, int len) const {
+  sha512_update((sha512_context *) state.ctx, data, len);
+}
+
+void LocalIdentity::signFinish(SignState& state, uint8_t* sig) const {
+  uint8_t prehash[64];
+  sha512_final((sha512_context *) state.ctx, prehash);
+  ed25519ph_sign(sig, prehash, pub_key, prv_key);
+  memset(&state, 0, sizeof(state));
+}
+
 void LocalIdentity::calcSharedSecret(uint8_t* secret, const uint8_t* other_pub_key) const {
   ed25519_key_exchange(secret, other_pub_key, prv_key);
 }
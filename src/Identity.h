@@ -44,6 +44,14 @@ public:
   void printTo(Stream& s) const;
 };
 
+/**
+ * \brief  State of a streamed (Ed25519ph) signature, see LocalIdentity::signStart()
+*/
+class SignState {
+  uint64_t ctx[26];   // opaque SHA-512 context, of the message so far
+  friend class LocalIdentity;
+};
+
 /**
  * \brief  An Identity generated on THIS device, ie. with public/private Ed25519 key pair being on this device.
 */
@@ -62,6 +70,25 @@ public:
   */
   void sign(uint8_t* sig, const uint8_t* message, int msg_len) const;
 
+  /**
+   * \brief  Begins an Ed25519ph (RFC 8032 pre-hashed, empty context) signature, over a message supplied in pieces via
+   *     signUpdate(), so it needn't be buffered. Deterministic, but NOT the same signature as sign() over the same
+   *     message: verifiers must check it as Ed25519ph.
+   * \param state OUT - the state to pass to signUpdate() and signFinish()
+  */
+  void signStart(SignState& state) const;
+
+  /**
+   * \brief  Appends the next piece of message to a signature begun with signStart().
+  */
+  void signUpdate(SignState& state, const uint8_t* data, int len) const;
+
+  /**
+   * \brief  Completes the signature, and wipes the state.
+   * \param sig OUT - must be SIGNATURE_SIZE buffer.
+  */
+  void signFinish(SignState& state, uint8_t* sig) const;
+
   /**
    * \brief  the ECDH key exhange, with Ed25519 public key transposed to Ex25519.
    * \param  secret OUT - the 'shared secret' (must be PUB_KEY_SIZE bytes)
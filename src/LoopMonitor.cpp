@@ -0,0 +1,7 @@
+#include "LoopMonitor.h"
+
+namespace mesh {
+
+LoopMonitor LoopMonitor::_instance;
+
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <MeshCore.h>
+#include <string.h>
+
+#ifndef LOOP_MONITOR
+  #define LOOP_MONITOR   1    // 0 = don't time loop() iterations (see LoopMonitor)
+#endif
+#ifndef LOOP_STALL_MILLIS
+  #define LOOP_STALL_MILLIS   50    // a loop() iteration taking this long or longer counts as a stall
+#endif
+
+#define LOOP_SECT_OTHER     0   // anything not in a section below (eg. serial CLI, board)
+#define LOOP_SECT_MESH      1   // Mesh::loop(), ie. radio, packet handling and app callbacks
+#define LOOP_SECT_UI        2   // UITask::loop(), incl. display refresh
+#define LOOP_SECT_SENSORS   3   // SensorManager::loop(), eg. GPS parsing, sensor reads
+#define LOOP_SECT_STORE     4   // flash writes (DataStore)
+#define LOOP_SECT_NUM       5
+
+#define LOOP_HIST_BUCKETS   16   // upper bounds: 0, 1, 2, 4, .. 8192 millis, then everything above
+
+#if LOOP_MONITOR && (defined(ARDUINO) || defined(NATIVE_PLATFORM))
+  #include <Arduino.h>
+#endif
+
+namespace mesh {
+
+/**
+ * \brief  Times each iteration of the main loop() (excluding any idle sleep), to find what keeps the radio unserviced.
+ *     Keeps the max and a log2 histogram (for percentiles) of iteration times, and counts iterations of
+ *     LOOP_STALL_MILLIS or more. Time is attributed to sections (LOOP_SECT_*) with LOOP_SCOPE(), as 'self' time, so
+ *     each stall is blamed on the section which took most of that iteration.
+ *     There is one instance, get(), for the main loop task.
+*/
+class LoopMonitor {
+  uint32_t _hist[LOOP_HIST_BUCKETS];
+  uint32_t _stalls[LOOP_SECT_NUM];   // by worst section
+  uint32_t _iter_millis[LOOP_SECT_NUM];   // in current iteration
+  uint32_t _start, _last;
+  uint32_t _max_millis;
+  uint8_t _max_section;
+  uint8_t _section;
+  bool _active;   // between startIteration() .. endIteration()
+
+  static LoopMonitor _instance;
+
+  static uint32_t now() {
+  #if LOOP_MONITOR && (defined(ARDUINO) || defined(NATIVE_PLATFORM))
+    return millis();
+  #else
+    return 0;
+  #endif
+  }
+
+public:
+  LoopMonitor() { reset(); _active = false; _section = LOOP_SECT_OTHER; }
+
+  static LoopMonitor& get() { return _instance; }
+
+  void reset() {
+    memset(_hist, 0, sizeof(_hist));
+    memset(_stalls, 0, sizeof(_stalls));
+    _max_millis = 0;
+    _max_section = LOOP_SECT_OTHER;
+  }
+
+  void startIteration() {
+    memset(_iter_millis, 0, sizeof(_iter_millis));
+    _start = _last = now();
+    _section = LOOP_SECT_OTHER;
+    _active = true;
+  }
+
+  void endIteration() {
+    if (!_active) return;
+    uint32_t t = now();
+    _iter_millis[_section] += t - _last;
+    _active = false;
+
+    uint32_t total = t - _start;
+    int b = 0;
+    while (b < LOOP_HIST_BUCKETS - 1 && total > (b ? (1UL << (b - 1)) : 0)) b++;
+    _hist[b]++;
+
+    uint8_t worst = 0;
+    for (int s = 1; s < LOOP_SECT_NUM; s++) {
+      if (_iter_millis[s] > _iter_millis[worst]) worst = s;
+    }
+    if (total >= LOOP_STALL_MILLIS) _stalls[worst]++;
+    if (total > _max_millis) {
+      _max_millis = total;
+      _max_section = worst;
+    }
+  }
+
+  /** \returns  the previous section, to pass to leave() */
+  uint8_t enter(uint8_t section) {
+    if (!_active) return section;
+    uint32_t t = now();
+    _iter_millis[_section] += t - _last;
+    _last = t;
+    uint8_t prev = _section;
+    _section = section;
+    return prev;
+  }
+  void leave(uint8_t prev) {
+    if (!_active) return;
+    uint32_t t = now();
+    _iter_millis[_section] += t - _last;
+    _last = t;
+    _section = prev;
+  }
+
+  uint32_t getCount() const {
+    uint32_t n = 0;
+    for (int b = 0; b < LOOP_HIST_BUCKETS; b++) n += _hist[b];
+    return n;
+  }
+  uint32_t getMaxMillis() const { return _max_millis; }
+  uint8_t getMaxSection() const { return _max_section; }
+  uint32_t getNumStalls(uint8_t section) const { return _stalls[section]; }
+  uint32_t getNumStalls() const {
+    uint32_t n = 0;
+    for (int s = 0; s < LOOP_SECT_NUM; s++) n += _stalls[s];
+    return n;
+  }
+
+  /** \returns  upper bound (millis) of histogram bucket which the 'pct' percentile falls in */
+  uint32_t getPercentile(int pct) const {
+    uint32_t n = getCount();
+    uint32_t want = (n * pct + 99) / 100, sum = 0;
+    for (int b = 0; b < LOOP_HIST_BUCKETS - 1; b++) {
+      sum += _hist[b];
+      if (sum >= want) return b ? (1UL << (b - 1)) : 0;
+    }
+    return _max_millis;   // in the open-ended top bucket
+  }
+
+  static const char* getSectionName(uint8_t section) {
+    static const char* names[LOOP_SECT_NUM] = { "other", "mesh", "ui", "sensors", "store" };
+    return section < LOOP_SECT_NUM ? names[section] : "?";
+  }
+};
+
+#if LOOP_MONITOR
+  /** \brief  attributes the loop() time until the end of the enclosing scope to 'section' */
+  class LoopScope {
+    uint8_t _prev;
+  public:
+    LoopScope(uint8_t section) { _prev = LoopMonitor::get().enter(section); }
+    ~LoopScope() { LoopMonitor::get().leave(_prev); }
+  };
+
+  #define LOOP_SCOPE(section)   mesh::LoopScope _loop_scope(section)
+  #define LOOP_START()          mesh::LoopMonitor::get().startIteration()
+  #define LOOP_END()            mesh::LoopMonitor::get().endIteration()
+#else
+  #define LOOP_SCOPE(section)   {}
+  #define LOOP_START()          {}
+  #define LOOP_END()            {}
+#endif
+
+}
@@ -1,14 +1,189 @@
 #include "Mesh.h"
+#include "LoopMonitor.h"
+#include "PayloadViews.h"
 //#include <Arduino.h>
 
 namespace mesh {
 
+void SharedSecretCache::calcSharedSecret(uint8_t* secret, const LocalIdentity& self, const uint8_t* other_pub_key) {
+  if (memcmp(_self_pub_key, self.pub_key, PUB_KEY_SIZE) != 0) {   // identity has changed, flush
+    memset(_entries, 0, sizeof(_entries));
+    memcpy(_self_pub_key, self.pub_key, PUB_KEY_SIZE);
+  }
+
+  Entry* lru = &_entries[0];
+  for (int i = 0; i < SECRET_CACHE_SIZE; i++) {
+    Entry* e = &_entries[i];
+    if (e->last_used && memcmp(e->pub_key, other_pub_key, PUB_KEY_SIZE) == 0) {   // hit
+      e->last_used = ++_counter;
+      memcpy(secret, e->secret, PUB_KEY_SIZE);
+      return;
+    }
+    if (e->last_used < lru->last_used) lru = e;
+  }
+
+  self.calcSharedSecret(secret, other_pub_key);
+  memcpy(lru->pub_key, other_pub_key, PUB_KEY_SIZE);
+  memcpy(lru->secret, secret, PUB_KEY_SIZE);
+  lru->last_used = ++_counter;
+}
+
+int AdvertTimestampCache::check(const uint8_t* pub_key, uint32_t timestamp, const uint8_t* content_hash) const {
+  for (int i = 0; i < ADVERT_CACHE_SIZE; i++) {
+    const Entry* e = &_entries[i];
+    if (e->last_used && memcmp(e->pub_key, pub_key, MAX_HASH_SIZE) == 0) {
+      if (timestamp > e->timestamp) return ADVERT_CHECK_NEW;
+      if (timestamp == e->timestamp && memcmp(e->content_hash, content_hash, MAX_HASH_SIZE) == 0) return ADVERT_CHECK_VERIFIED;
+      return ADVERT_CHECK_STALE;
+    }
+  }
+  return ADVERT_CHECK_NEW;  // unknown
+}
+
+void AdvertTimestampCache::update(const uint8_t* pub_key, uint32_t timestamp, const uint8_t* content_hash, const uint8_t* data_hash) {
+  Entry* lru = &_entries[0];
+  for (int i = 0; i < ADVERT_CACHE_SIZE; i++) {
+    Entry* e = &_entries[i];
+    if (e->last_used && memcmp(e->pub_key, pub_key, PUB_KEY_SIZE) == 0) {
+      lru = e;
+      break;
+    }
+    if (e->last_used < lru->last_used) lru = e;
+  }
+  memcpy(lru->pub_key, pub_key, PUB_KEY_SIZE);
+  memcpy(lru->content_hash, content_hash, MAX_HASH_SIZE);
+  if (data_hash) memcpy(lru->data_hash, data_hash, ADVERT_DATA_HASH_SIZE);
+  lru->timestamp = timestamp;
+  lru->last_used = ++_counter;
+}
+
+bool AdvertTimestampCache::findBase(const uint8_t* key_prefix, uint8_t* pub_key, uint8_t* data_hash) const {
+  for (int i = 0; i < ADVERT_CACHE_SIZE; i++) {
+    const Entry* e = &_entries[i];
+    if (e->last_used && memcmp(e->pub_key, key_prefix, MAX_HASH_SIZE) == 0) {
+      memcpy(pub_key, e->pub_key, PUB_KEY_SIZE);
+      memcpy(data_hash, e->data_hash, ADVERT_DATA_HASH_SIZE);
+      return true;
+    }
+  }
+  return false;
+}
+
 void Mesh::begin() {
   Dispatcher::begin();
 }
 
 void Mesh::loop() {
+  LOOP_SCOPE(LOOP_SECT_MESH);
   Dispatcher::loop();
+  closePathWindows();
+  checkFragmentTimers();
+  processDeferredRecv();
+  for (int i = 0; i < _num_hosted; i++) _hosted[i]->loop();
+}
+
+bool Mesh::addHostedNode(HostedNode* node) {
+  if (_num_hosted >= MAX_HOSTED_NODES) return false;
+  _hosted[_num_hosted++] = node;
+  return true;
+}
+
+bool Mesh::isHostedIdentity(const uint8_t* pub_key) const {
+  for (int i = 0; i < _num_hosted; i++) {
+    if (_hosted[i]->self_id.matches(pub_key)) return true;
+  }
+  return false;
+}
+
+void Mesh::handleAck(Packet* packet, uint32_t ack_crc) {
+  onAckRecv(packet, ack_crc);
+  for (int i = 0; i < _num_hosted && !packet->isMarkedDoNotRetransmit(); i++) {
+    _hosted[i]->onAckRecv(packet, ack_crc);
+  }
+}
+
+uint32_t Mesh::getMillisToNextWakeup(uint32_t max_millis) {
+  uint32_t wait = Dispatcher::getMillisToNextWakeup(max_millis);
+  unsigned long now = _ms->getMillis();
+  for (int i = 0; i < PATH_WINDOW_SLOTS; i++) {
+    if (_path_windows[i].expires) limitWakeup(wait, now, _path_windows[i].expires);
+  }
+  if (hasFragments()) {
+    for (int i = 0; i < FRAG_RX_SLOTS; i++) {
+      if (_frags->rx[i].expires) limitWakeup(wait, now, _frags->rx[i].expires);
+    }
+    for (int i = 0; i < FRAG_TX_SLOTS; i++) {
+      if (_frags->tx[i].timeout) limitWakeup(wait, now, _frags->tx[i].timeout);
+    }
+  }
+  return wait;
+}
+
+bool Mesh::openPathWindow(const Packet* pkt, const uint8_t* src_hash, const uint8_t* secret, const uint8_t* reply_path, int reply_len) {
+  uint32_t window = getPathCollectWindow();
+  if (window == 0 || Packet::decodePathBytes(reply_len) > MAX_PATH_SIZE) return false;
+
+  for (int i = 0; i < PATH_WINDOW_SLOTS; i++) {
+    PathWindow* w = &_path_windows[i];
+    if (w->expires) continue;   // in use
+
+    pkt->calculateFingerprint(w->fingerprint);
+    w->src_hash_len = pkt->getDatagramHashSize();
+    memcpy(w->src_hash, src_hash, w->src_hash_len);
+    memcpy(w->secret, secret, PUB_KEY_SIZE);
+    memcpy(w->best_path, pkt->path, pkt->path_len);
+    w->best_len = pkt->getEncodedPathLen();
+    w->best_snr = pkt->_snr;
+    w->improved = false;
+    w->deferred = reply_path != NULL;
+    if (reply_path) memcpy(w->reply_path, reply_path, Packet::decodePathBytes(reply_len));
+    w->reply_len = reply_len;
+    w->expires = futureMillis(window);
+    return true;
+  }
+  return false;  // all slots busy
+}
+
+void Mesh::recordAltPath(const Packet* pkt) {
+  uint8_t fingerprint[MAX_HASH_SIZE];
+  bool calculated = false;
+
+  for (int i = 0; i < PATH_WINDOW_SLOTS; i++) {
+    PathWindow* w = &_path_windows[i];
+    if (w->expires == 0) continue;
+
+    if (!calculated) { pkt->calculateFingerprint(fingerprint); calculated = true; }
+    if (memcmp(w->fingerprint, fingerprint, MAX_HASH_SIZE) != 0) continue;
+
+    uint8_t enc_len = pkt->getEncodedPathLen();
+    if (enc_len < w->best_len || (enc_len == w->best_len && pkt->_snr >= w->best_snr + PATH_BETTER_SNR_MARGIN)) {
+      memcpy(w->best_path, pkt->path, pkt->path_len);
+      w->best_len = enc_len;
+      w->best_snr = pkt->_snr;
+      w->improved = true;
+    }
+    return;
+  }
+}
+
+void Mesh::closePathWindows() {
+  for (int i = 0; i < PATH_WINDOW_SLOTS; i++) {
+    PathWindow* w = &_path_windows[i];
+    if (w->expires == 0 || !millisHasNowPassed(w->expires)) continue;
+
+    if (w->deferred) {
+      // send a reciprocal return path to sender, but send DIRECTLY!
+      Packet* rpath = createPathReturn(w->src_hash, w->secret, w->best_path, w->best_len, 0, NULL, 0, w->src_hash_len);
+      if (rpath) sendDirect(rpath, w->reply_path, w->reply_len);
+    } else if (w->improved) {
+      // sender already has a path to here, but this is better. Send it back along (the reverse of) the same path
+      uint8_t reverse[MAX_PATH_SIZE];
+      reversePath(reverse, w->best_path, w->best_len);
+      Packet* rpath = createPathReturn(w->src_hash, w->secret, w->best_path, w->best_len, 0, NULL, 0, w->src_hash_len);
+      if (rpath) sendDirect(rpath, reverse, w->best_len);
+    }
+    memset(w, 0, sizeof(*w));   // also wipes the secret
+  }
 }
 
 bool Mesh::allowPacketForward(const mesh::Packet* packet) { 
@@ -25,6 +200,19 @@ uint32_t Mesh::getDirectRetransmitDelay(const Packet* packet) {
 uint8_t Mesh::getExtraAckTransmitCount() const {
   return 0;
 }
+uint32_t Mesh::getRebroadcastWindow(const Packet* received) {
+  if (!received->isRouteFlood()) return 0;
+  return _radio->getEstAirtimeFor(received->getRawLength()) * ACK_SLOT_WINDOW_FACTOR;
+}
+uint32_t Mesh::getAckDelay(const Packet* received, uint32_t min_delay) {
+  uint32_t window = getRebroadcastWindow(received);
+  if (window == 0) return min_delay;
+
+  // ACK or PATH return, going back over (about) the path the message came in on
+  uint32_t ack_air = _radio->getEstAirtimeFor(2 + received->path_len + PATH_HASH_SIZE + 4 + CIPHER_MAC_SIZE + CIPHER_BLOCK_SIZE);
+  uint32_t d = window + (self_id.pub_key[0] % ACK_SLOTS) * ack_air;
+  return d > min_delay ? d : min_delay;
+}
 
 uint32_t Mesh::getCADFailRetryDelay() const {
   return _rng->nextInt(1, 4)*120;
@@ -38,32 +226,51 @@ int Mesh::searchChannelsByHash(const uint8_t* hash, GroupChannel channels[], int
   return 0;  // not found
 }
 
+void Mesh::suppressQueuedFlood(const Packet* pkt) {
+  int n = _mgr->getOutboundCount(OUTBOUND_ANY_TIME);
+  for (int i = 0; i < n; i++) {
+    Packet* queued = _mgr->getOutboundByIdx(i);
+    if (queued->isRouteFlood() && queued->isSameContent(pkt)) {
+      uint8_t n = getFloodSuppressCount(queued);
+      if (n > 0 && ++queued->_heard >= n) {   // enough neighbours have already rebroadcast it
+        MESH_DEBUG_PRINTLN("%s Mesh::suppressQueuedFlood(): cancelling retransmit, heard %d times", getLogDateTime(), (uint32_t)queued->_heard);
+        _mgr->removeOutboundByIdx(i);
+        releasePacket(queued);
+      }
+      return;
+    }
+  }
+}
+
 DispatcherAction Mesh::onRecvPacket(Packet* pkt) {
-  if (pkt->getPayloadVer() > PAYLOAD_VER_1) {  // not supported in this firmware version
+  {
+    // arrival time, and the low bits of RSSI/SNR, are (slightly) unpredictable to an observer
+    float ev_rssi = _radio->getLastRSSI(), ev_snr = _radio->getLastSNR();
+    uint32_t ev[3] = { (uint32_t) _ms->getMillis(), 0, 0 };
+    memcpy(&ev[1], &ev_rssi, sizeof(ev_rssi));
+    memcpy(&ev[2], &ev_snr, sizeof(ev_snr));
+    _rng->addEntropy((const uint8_t *) ev, sizeof(ev));
+  }
+
+  if (pkt->getPayloadVer() > PAYLOAD_VER_3) {  // not supported in this firmware version
     MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): unsupported packet version", getLogDateTime());
     return ACTION_RELEASE;
   }
 
   if (pkt->isRouteDirect() && pkt->getPayloadType() == PAYLOAD_TYPE_TRACE) {
-    if (pkt->path_len < MAX_PATH_SIZE) {
-      uint8_t i = 0;
-      uint32_t trace_tag;
-      memcpy(&trace_tag, &pkt->payload[i], 4); i += 4;
-      uint32_t auth_code;
-      memcpy(&auth_code, &pkt->payload[i], 4); i += 4;
-      uint8_t flags = pkt->payload[i++];
-      uint8_t path_sz = flags & 0x03;  // NEW v1.11+: lower 2 bits is path hash size
-
-      uint8_t len = pkt->payload_len - i;
+    TraceView trace;
+    if (pkt->path_len < PLF_LEN_MASK && trace.init(pkt)) {
+      uint8_t path_sz = trace.hashSizeBits();
+      uint8_t len = trace.hashesLen();
       uint8_t offset = pkt->path_len << path_sz;
       if (offset >= len) {   // TRACE has reached end of given path
-        onTraceRecv(pkt, trace_tag, auth_code, flags, pkt->path, &pkt->payload[i], len);
-      } else if (self_id.isHashMatch(&pkt->payload[i + offset], 1 << path_sz) && allowPacketForward(pkt) && !_tables->hasSeen(pkt)) {
+        onTraceRecv(pkt, trace.tag(), trace.authCode(), trace.flags(), pkt->path, trace.hashes(), len);
+      } else if (self_id.isHashMatch(&trace.hashes()[offset], 1 << path_sz) && allowPacketForward(pkt) && !isSeen(pkt)) {
         // append SNR (Not hash!)
         pkt->path[pkt->path_len++] = (int8_t) (pkt->getSNR()*4);
 
         uint32_t d = getDirectRetransmitDelay(pkt);
-        return ACTION_RETRANSMIT_DELAYED(5, d);  // schedule with priority 5 (for now), maybe make configurable?
+        return ACTION_RETRANSMIT_DELAYED(QOS_BULK, d);
       }
     }
     return ACTION_RELEASE;
@@ -77,23 +284,28 @@ DispatcherAction Mesh::onRecvPacket(Packet* pkt) {
     return ACTION_RELEASE;
   }
 
-  if (pkt->isRouteDirect() && pkt->path_len >= PATH_HASH_SIZE) {
-    if (self_id.isHashMatch(pkt->path) && allowPacketForward(pkt)) {
+  if (pkt->isRouteDirect() && pkt->path_len >= pkt->path_hash_size) {
+    if (pkt->getPayloadType() == PAYLOAD_TYPE_BUNDLE) {   // (path is just the next hop)
+      if (self_id.isHashMatch(pkt->path, pkt->path_hash_size) && !isSeen(pkt)) unpackBundle(pkt);
+      return ACTION_RELEASE;
+    }
+    if (self_id.isHashMatch(pkt->path, pkt->path_hash_size) && allowPacketForward(pkt)) {
       if (pkt->getPayloadType() == PAYLOAD_TYPE_MULTIPART) {
         return forwardMultipartDirect(pkt);
       } else if (pkt->getPayloadType() == PAYLOAD_TYPE_ACK) {
-        if (!_tables->hasSeen(pkt)) {  // don't retransmit!
+        if (removeSeenAcks(pkt) > 0) {  // don't retransmit!
           removeSelfFromPath(pkt);
           routeDirectRecvAcks(pkt, 0);
         }
         return ACTION_RELEASE;
       }
 
-      if (!_tables->hasSeen(pkt)) {
+      if (!isSeen(pkt)) {
         removeSelfFromPath(pkt);
+        if (_coding && allowCodedForward()) codeWithQueued(pkt);   // (pkt may become a CODED frame)
 
         uint32_t d = getDirectRetransmitDelay(pkt);
-        return ACTION_RETRANSMIT_DELAYED(0, d);  // Routed traffic is HIGHEST priority 
+        return ACTION_RETRANSMIT_DELAYED(QOS_DIRECT, d);  // Routed traffic is HIGH priority, just behind ACKs
       }
     }
     return ACTION_RELEASE;   // this node is NOT the next hop (OR this packet has already been forwarded), so discard.
@@ -101,17 +313,38 @@ DispatcherAction Mesh::onRecvPacket(Packet* pkt) {
 
   if (pkt->isRouteFlood() && filterRecvFloodPacket(pkt)) return ACTION_RELEASE;
 
+  if (pkt->isRouteFlood()) {
+    suppressQueuedFlood(pkt);
+  }
+
   DispatcherAction action = ACTION_RELEASE;
 
   switch (pkt->getPayloadType()) {
     case PAYLOAD_TYPE_ACK: {
-      int i = 0;
-      uint32_t ack_crc;
-      memcpy(&ack_crc, &pkt->payload[i], 4); i += 4;
-      if (i > pkt->payload_len) {
+      AckView ack;
+      if (!ack.init(pkt)) {
         MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): incomplete ACK packet", getLogDateTime());
-      } else if (!_tables->hasSeen(pkt)) {
-        onAckRecv(pkt, ack_crc);
+      } else if (removeSeenAcks(pkt) > 0) {
+        if (pkt->payload_len == AckView::MIN_LEN) {
+          PROF_SCOPE(_prof, PROF_STAGE_APP);
+          handleAck(pkt, ack.crc());
+        } else {   // packed ACKs, keep just the ones not for this node (in case they need to be forwarded)
+          int num = 0;
+          for (int i = 0; i < pkt->payload_len; i += 4) {
+            Packet tmp = *pkt;
+            memcpy(tmp.payload, &pkt->payload[i], 4);
+            tmp.payload_len = 4;
+
+            uint32_t ack_crc;
+            memcpy(&ack_crc, tmp.payload, 4);
+            handleAck(&tmp, ack_crc);
+            if (!tmp.isMarkedDoNotRetransmit()) {
+              memmove(&pkt->payload[num*4], tmp.payload, 4); num++;
+            }
+          }
+          pkt->payload_len = num*4;
+          if (num == 0) pkt->markDoNotRetransmit();
+        }
         action = routeRecvPacket(pkt);
       }
       break;
@@ -120,83 +353,123 @@ DispatcherAction Mesh::onRecvPacket(Packet* pkt) {
     case PAYLOAD_TYPE_REQ:
     case PAYLOAD_TYPE_RESPONSE:
     case PAYLOAD_TYPE_TXT_MSG: {
-      int i = 0;
-      uint8_t dest_hash = pkt->payload[i++];
-      uint8_t src_hash = pkt->payload[i++];
-
-      uint8_t* macAndData = &pkt->payload[i];   // MAC + encrypted data 
-      if (i + CIPHER_MAC_SIZE >= pkt->payload_len) {
+      DatagramView dg;
+      bool is_valid = dg.init(pkt);
+      uint8_t hash_sz = dg.hashSize();
+      const uint8_t* dest_hash = dg.destHash();
+      const uint8_t* src_hash = dg.srcHash();
+      if (!is_valid) {
         MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): incomplete data packet", getLogDateTime());
-      } else if (!_tables->hasSeen(pkt)) {
-        // NOTE: this is a 'first packet wins' impl. When receiving from multiple paths, the first to arrive wins.
-        //       For flood mode, the path may not be the 'best' in terms of hops.
-        // FUTURE: could send back multiple paths, using createPathReturn(), and let sender choose which to use(?)
+      } else if (!isSeen(pkt)) {
+        // NOTE: for flood mode, copies arriving via other paths are collected for getPathCollectWindow(), and
+        //       the best path (by hops, then SNR) is returned to the sender. (see closePathWindows())
+
+        bool matched = false, found = false;
+        for (int h = -1; h < _num_hosted && !found; h++) {   // this node, then any co-hosted ones with the same hash
+          HostedNode* node = h < 0 ? NULL : _hosted[h];
+          if (!(node ? node->self_id : self_id).isHashMatch(dest_hash, hash_sz)) continue;
+          matched = true;
 
-        if (self_id.isHashMatch(&dest_hash)) {
           // scan contacts DB, for all matching hashes of 'src_hash' (max 4 matches supported ATM)
-          int num = searchPeersByHash(&src_hash);
+          int num;
+          {
+            PROF_SCOPE(_prof, PROF_STAGE_SEARCH);
+            if (node) {
+              num = node->searchPeersByHash(src_hash, hash_sz);
+            } else {
+              num = hash_sz == PATH_HASH_SIZE ? searchPeersByHash(src_hash) : searchPeersByHash(src_hash, hash_sz);
+            }
+          }
           // for each matching contact, try to decrypt data
-          bool found = false;
           for (int j = 0; j < num; j++) {
             uint8_t secret[PUB_KEY_SIZE];
-            getPeerSharedSecret(secret, j);
+            {
+              PROF_SCOPE(_prof, PROF_STAGE_CRYPTO);
+              if (node) node->getPeerSharedSecret(secret, j); else getPeerSharedSecret(secret, j);
+            }
 
             // decrypt, checking MAC is valid
             uint8_t data[MAX_PACKET_PAYLOAD];
-            int len = Utils::MACThenDecrypt(secret, data, macAndData, pkt->payload_len - i);
-            if (len > 0) {  // success!
+            int len = decryptPayload(pkt, secret, data, dg.cipher(), dg.cipherLen());
+            PathDataView pd;
+            if (len > 0 && pkt->getPayloadType() == PAYLOAD_TYPE_PATH && !pd.init(data, len)) {
+              MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): incomplete path packet", getLogDateTime());
+              found = true;   // (MAC was good, so it IS for us)
+              break;
+            }
+            if (len > 0 && node) {   // for a co-hosted node
+              if (pkt->getPayloadType() == PAYLOAD_TYPE_PATH) {
+                bool reciprocate;
+                { PROF_SCOPE(_prof, PROF_STAGE_APP); reciprocate = node->onPeerPathRecv(pkt, j, secret, pd.path(), pd.pathLen(), pd.extraType(), pd.extra(), pd.extraLen()); }
+                if (reciprocate && pkt->isRouteFlood()) {
+                  mesh::Packet* rpath = createPathReturn(src_hash, secret, pkt->path, pkt->getEncodedPathLen(), 0, NULL, 0, hash_sz, &node->self_id);
+                  if (rpath) sendDirect(rpath, pd.path(), pd.pathLen(), 500);
+                }
+              } else {
+                PROF_SCOPE(_prof, PROF_STAGE_APP);
+                node->onPeerDataRecv(pkt, pkt->getPayloadType(), j, secret, data, len);
+              }
+              found = true;
+              break;
+            } else if (len > 0) {  // success!
               if (pkt->getPayloadType() == PAYLOAD_TYPE_PATH) {
-                int k = 0;
-                uint8_t path_len = data[k++];
-                uint8_t* path = &data[k]; k += path_len;
-                uint8_t extra_type = data[k++] & 0x0F;   // upper 4 bits reserved for future use
-                uint8_t* extra = &data[k];
-                uint8_t extra_len = len - k;   // remainder of packet (may be padded with zeroes!)
-                if (onPeerPathRecv(pkt, j, secret, path, path_len, extra_type, extra, extra_len)) {
-                  if (pkt->isRouteFlood()) {
+                bool reciprocate;
+                { PROF_SCOPE(_prof, PROF_STAGE_APP); reciprocate = onPeerPathRecv(pkt, j, secret, pd.path(), pd.pathLen(), pd.extraType(), pd.extra(), pd.extraLen()); }
+                if (reciprocate) {
+                  if (pkt->isRouteFlood() && !openPathWindow(pkt, src_hash, secret, pd.path(), pd.pathLen())) {
                     // send a reciprocal return path to sender, but send DIRECTLY!
-                    mesh::Packet* rpath = createPathReturn(&src_hash, secret, pkt->path, pkt->path_len, 0, NULL, 0);
-                    if (rpath) sendDirect(rpath, path, path_len, 500);
+                    mesh::Packet* rpath = createPathReturn(src_hash, secret, pkt->path, pkt->getEncodedPathLen(), 0, NULL, 0, hash_sz);
+                    if (rpath) sendDirect(rpath, pd.path(), pd.pathLen(), 500);
                   }
                 }
               } else {
-                onPeerDataRecv(pkt, pkt->getPayloadType(), j, secret, data, len);
+                { PROF_SCOPE(_prof, PROF_STAGE_APP); onPeerDataRecv(pkt, pkt->getPayloadType(), j, secret, data, len); }
+                if (pkt->isRouteFlood() && pkt->getPayloadType() != PAYLOAD_TYPE_RESPONSE) {
+                  openPathWindow(pkt, src_hash, secret, NULL, 0);
+                }
               }
               found = true;
               break;
             }
           }
-          if (found) {
-            pkt->markDoNotRetransmit();  // packet was for this node, so don't retransmit
-          } else {
-            MESH_DEBUG_PRINTLN("%s recv matches no peers, src_hash=%02X", getLogDateTime(), (uint32_t)src_hash);
-          }
+        }
+        if (found) {
+          pkt->markDoNotRetransmit();  // packet was for this node, so don't retransmit
+        } else if (matched) {
+          MESH_DEBUG_PRINTLN("%s recv matches no peers, src_hash=%02X", getLogDateTime(), (uint32_t)src_hash[0]);
         }
         action = routeRecvPacket(pkt);
+      } else if (pkt->isRouteFlood()) {
+        recordAltPath(pkt);   // a copy, via another path
       }
       break;
     }
     case PAYLOAD_TYPE_ANON_REQ: {
-      int i = 0;
-      uint8_t dest_hash = pkt->payload[i++];
-      uint8_t* sender_pub_key = &pkt->payload[i]; i += PUB_KEY_SIZE;
-
-      uint8_t* macAndData = &pkt->payload[i];   // MAC + encrypted data 
-      if (i + 2 >= pkt->payload_len) {
+      AnonReqView req;
+      if (!req.init(pkt)) {
         MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): incomplete data packet", getLogDateTime());
-      } else if (!_tables->hasSeen(pkt)) {
-        if (self_id.isHashMatch(&dest_hash)) {
-          Identity sender(sender_pub_key);
+      } else if (!isSeen(pkt)) {
+        Identity sender(req.senderKey());
+        for (int h = -1; h < _num_hosted; h++) {   // this node, then any co-hosted ones with the same hash
+          HostedNode* node = h < 0 ? NULL : _hosted[h];
+          if (!(node ? node->self_id : self_id).isHashMatch(req.destHash())) continue;
 
           uint8_t secret[PUB_KEY_SIZE];
-          self_id.calcSharedSecret(secret, sender);
+          {
+            PROF_SCOPE(_prof, PROF_STAGE_CRYPTO);
+            if (node) node->calcSharedSecret(secret, req.senderKey()); else calcSharedSecret(secret, req.senderKey());
+          }
 
           // decrypt, checking MAC is valid
           uint8_t data[MAX_PACKET_PAYLOAD];
-          int len = Utils::MACThenDecrypt(secret, data, macAndData, pkt->payload_len - i);
+          int len = decryptPayload(pkt, secret, data, req.cipher(), req.cipherLen());
           if (len > 0) {  // success!
-            onAnonDataRecv(pkt, secret, sender, data, len);
+            {
+              PROF_SCOPE(_prof, PROF_STAGE_APP);
+              if (node) node->onAnonDataRecv(pkt, secret, sender, data, len); else onAnonDataRecv(pkt, secret, sender, data, len);
+            }
             pkt->markDoNotRetransmit();
+            break;
           }
         }
         action = routeRecvPacket(pkt);
@@ -205,71 +478,77 @@ DispatcherAction Mesh::onRecvPacket(Packet* pkt) {
     }
     case PAYLOAD_TYPE_GRP_DATA: 
     case PAYLOAD_TYPE_GRP_TXT: {
-      int i = 0;
-      uint8_t channel_hash = pkt->payload[i++];
-
-      uint8_t* macAndData = &pkt->payload[i];   // MAC + encrypted data 
-      if (i + 2 >= pkt->payload_len) {
+      if (pkt->payload_len <= 3) {   // channel hash, then MAC + encrypted data
         MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): incomplete data packet", getLogDateTime());
-      } else if (!_tables->hasSeen(pkt)) {
-        // scan channels DB, for all matching hashes of 'channel_hash' (max 4 matches supported ATM)
-        GroupChannel channels[4];
-        int num = searchChannelsByHash(&channel_hash, channels, 4);
-        // for each matching channel, try to decrypt data
-        for (int j = 0; j < num; j++) {
-          // decrypt, checking MAC is valid
-          uint8_t data[MAX_PACKET_PAYLOAD];
-          int len = Utils::MACThenDecrypt(channels[j].secret, data, macAndData, pkt->payload_len - i);
-          if (len > 0) {  // success!
-            onGroupDataRecv(pkt, pkt->getPayloadType(), channels[j], data, len);
-            break;
-          }
-        }
-        action = routeRecvPacket(pkt);
+      } else if (!isSeen(pkt)) {
+#if MESH_GROUP_RECV
+        bool routed = routeFirst(pkt, action);
+        if (!routed || action == ACTION_RELEASE) recvGroupData(pkt);
+        if (!routed) action = routeRecvPacket(pkt);
+#else
+        action = routeRecvPacket(pkt);   // no channels in this role, so just forward
+#endif
       }
       break;
     }
     case PAYLOAD_TYPE_ADVERT: {
-      int i = 0;
+      if (pkt->getPayloadVer() == PAYLOAD_VER_2) {
+        action = handleAdvertRefresh(pkt);
+        break;
+      }
+      AdvertView adv;
+      bool is_valid = adv.init(pkt);
       Identity id;
-      memcpy(id.pub_key, &pkt->payload[i], PUB_KEY_SIZE); i += PUB_KEY_SIZE;
-
-      uint32_t timestamp;
-      memcpy(&timestamp, &pkt->payload[i], 4); i += 4;
-      const uint8_t* signature = &pkt->payload[i]; i += SIGNATURE_SIZE;
+      memcpy(id.pub_key, adv.pubKey(), PUB_KEY_SIZE);
+      uint32_t timestamp = is_valid ? adv.timestamp() : 0;
+      const uint8_t* signature = adv.signature();
 
-      if (i > pkt->payload_len) {
+      if (!is_valid) {
         MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): incomplete advertisement packet", getLogDateTime());
-      } else if (self_id.matches(id.pub_key)) {
+      } else if (self_id.matches(id.pub_key) || isHostedIdentity(id.pub_key)) {
         MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): receiving SELF advert packet", getLogDateTime());
-      } else if (!_tables->hasSeen(pkt)) {
-        uint8_t* app_data = &pkt->payload[i];
-        int app_data_len = pkt->payload_len - i;
+      } else if (!isSeen(pkt)) {
+        const uint8_t* app_data = adv.appData();
+        int app_data_len = adv.appDataLen();
         if (app_data_len > MAX_ADVERT_DATA_SIZE) { app_data_len = MAX_ADVERT_DATA_SIZE; }
 
-        // check that signature is valid
-        bool is_ok;
-        {
-          uint8_t message[PUB_KEY_SIZE + 4 + MAX_ADVERT_DATA_SIZE];
-          int msg_len = 0;
-          memcpy(&message[msg_len], id.pub_key, PUB_KEY_SIZE); msg_len += PUB_KEY_SIZE;
-          memcpy(&message[msg_len], &timestamp, 4); msg_len += 4;
-          memcpy(&message[msg_len], app_data, app_data_len); msg_len += app_data_len;
-
+        uint8_t message[PUB_KEY_SIZE + 4 + MAX_ADVERT_DATA_SIZE];
+        int msg_len = 0;
+        memcpy(&message[msg_len], id.pub_key, PUB_KEY_SIZE); msg_len += PUB_KEY_SIZE;
+        memcpy(&message[msg_len], &timestamp, 4); msg_len += 4;
+        memcpy(&message[msg_len], app_data, app_data_len); msg_len += app_data_len;
+
+        uint8_t content_hash[MAX_HASH_SIZE];
+        Utils::sha256(content_hash, MAX_HASH_SIZE, message, msg_len, signature, SIGNATURE_SIZE);
+
+        // check that signature is valid (unless is a repeat of one we've already verified)
+        bool is_ok = false;
+        int check = _advert_times.check(id.pub_key, timestamp, content_hash);
+        bool is_stale = check == ADVERT_CHECK_STALE || (check == ADVERT_CHECK_NEW && isAdvertStale(id, timestamp));
+        if (is_stale) {
+          MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): stale advertisement, ignoring", getLogDateTime());
+        } else if (check == ADVERT_CHECK_VERIFIED) {
+          is_ok = true;   // exact repeat, no need to verify again
+        } else {
+          PROF_SCOPE(_prof, PROF_STAGE_CRYPTO);
           is_ok = id.verify(signature, message, msg_len);
         }
         if (is_ok) {
           MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): valid advertisement received!", getLogDateTime());
-          onAdvertRecv(pkt, id, timestamp, app_data, app_data_len);
-          action = routeRecvPacket(pkt);
-        } else {
+          uint8_t data_hash[ADVERT_DATA_HASH_SIZE];
+          Utils::sha256(data_hash, ADVERT_DATA_HASH_SIZE, app_data, app_data_len);
+          _advert_times.update(id.pub_key, timestamp, content_hash, data_hash);
+          bool routed = routeFirst(pkt, action);
+          if (!routed || action == ACTION_RELEASE) recvAdvert(pkt);
+          if (!routed) action = routeRecvPacket(pkt);
+        } else if (!is_stale) {
           MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): received advertisement with forged signature! (app_data_len=%d)", getLogDateTime(), app_data_len);
         }
       }
       break;
     }
     case PAYLOAD_TYPE_RAW_CUSTOM: {
-      if (pkt->isRouteDirect() && !_tables->hasSeen(pkt)) {
+      if (pkt->isRouteDirect() && !isSeen(pkt)) {
         onRawDataRecv(pkt);
         //action = routeRecvPacket(pkt);    don't flood route these (yet)
       }
@@ -277,30 +556,38 @@ DispatcherAction Mesh::onRecvPacket(Packet* pkt) {
     }
     case PAYLOAD_TYPE_MULTIPART:
       if (pkt->payload_len > 2) {
-        uint8_t remaining = pkt->payload[0] >> 4;  // num of packets in this multipart sequence still to be sent
         uint8_t type = pkt->payload[0] & 0x0F;
 
         if (type == PAYLOAD_TYPE_ACK && pkt->payload_len >= 5) {    // a multipart ACK
           Packet tmp;
           tmp.header = pkt->header;
           tmp.path_len = pkt->path_len;
+          tmp.path_hash_size = pkt->path_hash_size;
           memcpy(tmp.path, pkt->path, pkt->path_len);
           tmp.payload_len = pkt->payload_len - 1;
           memcpy(tmp.payload, &pkt->payload[1], tmp.payload_len);
 
-          if (!_tables->hasSeen(&tmp)) {
+          if (!isSeen(&tmp)) {
             uint32_t ack_crc;
             memcpy(&ack_crc, tmp.payload, 4);
 
-            onAckRecv(&tmp, ack_crc);
+            handleAck(&tmp, ack_crc);
             //action = routeRecvPacket(&tmp);  // NOTE: currently not needed, as multipart ACKs not sent Flood
           }
-        } else {
-          // FUTURE: other multipart types??
+        } else if (type == PAYLOAD_TYPE_REQ || type == PAYLOAD_TYPE_RESPONSE || type == PAYLOAD_TYPE_TXT_MSG) {
+          action = onFragmentRecv(pkt);   // a fragment of a larger datagram
+        } else if (type == PAYLOAD_TYPE_MULTIPART) {
+          action = onFragmentAckRecv(pkt);
         }
       }
       break;
 
+    case PAYLOAD_TYPE_CODED:
+      if (pkt->isRouteDirect() && _coding && !isSeen(pkt)) {
+        decodeCodedFrame(pkt);
+      }
+      break;
+
     default:
       MESH_DEBUG_PRINTLN("%s Mesh::onRecvPacket(): unknown payload type, header: %d", getLogDateTime(), (int) pkt->header);
       // Don't flood route unknown packet types!   action = routeRecvPacket(pkt);
@@ -309,29 +596,465 @@ DispatcherAction Mesh::onRecvPacket(Packet* pkt) {
   return action;
 }
 
+void Mesh::recvGroupData(Packet* pkt) {
+#if MESH_GROUP_RECV
+  GroupView grp;
+  if (!grp.init(pkt)) return;
+
+  // scan channels DB, for all matching hashes of 'channel_hash' (max 4 matches supported ATM)
+  GroupChannel channels[4];
+  int num;
+  { PROF_SCOPE(_prof, PROF_STAGE_SEARCH); num = searchChannelsByHash(grp.channelHash(), channels, 4); }
+  // for each matching channel, try to decrypt data
+  for (int j = 0; j < num; j++) {
+    // decrypt, checking MAC is valid
+    uint8_t data[MAX_PACKET_PAYLOAD];
+    int len = decryptPayload(pkt, channels[j].secret, data, grp.cipher(), grp.cipherLen());
+    if (len > 0) {  // success!
+      { PROF_SCOPE(_prof, PROF_STAGE_APP); onGroupDataRecv(pkt, pkt->getPayloadType(), channels[j], data, len); }
+      break;
+    }
+  }
+#endif
+}
+
+void Mesh::recvAdvert(Packet* pkt) {   // (signature already verified)
+  AdvertView adv;
+  if (!adv.init(pkt)) return;
+  Identity id;
+  memcpy(id.pub_key, adv.pubKey(), PUB_KEY_SIZE);
+
+  int app_data_len = adv.appDataLen();
+  if (app_data_len > MAX_ADVERT_DATA_SIZE) { app_data_len = MAX_ADVERT_DATA_SIZE; }
+  PROF_SCOPE(_prof, PROF_STAGE_APP);
+  onAdvertRecv(pkt, id, adv.timestamp(), adv.appData(), app_data_len);
+}
+
+/**
+ * \brief  cut-through: if allowed, decides forwarding of 'pkt' BEFORE it is handled locally, with a copy kept for
+ *     processDeferredRecv() if it is to be forwarded.
+ * \returns  true if 'action' is decided, ie. routeRecvPacket() has been called. The caller must then handle 'pkt'
+ *     locally only if 'action' is ACTION_RELEASE (as it was not deferred).
+ */
+bool Mesh::routeFirst(Packet* pkt, DispatcherAction& action) {
+  if (!pkt->isRouteFlood() || _num_deferred >= DEFERRED_RECV_QUEUE_SIZE || !allowCutThrough(pkt)) return false;
+
+  Packet* local = obtainNewPacket();
+  if (local == NULL) return false;   // pool is low, just handle inline
+  *local = *pkt;   // (before routeRecvPacket() appends to path)
+
+  action = routeRecvPacket(pkt);
+  if (action == ACTION_RELEASE) {
+    releasePacket(local);   // not being forwarded, so nothing to gain
+  } else {
+    _deferred[_num_deferred++] = local;
+  }
+  return true;
+}
+
+void Mesh::processDeferredRecv() {
+  if (_num_deferred == 0) return;
+
+  Packet* pkt = _deferred[0];   // just one per loop(), so radio work comes first
+  _num_deferred--;
+  memmove(_deferred, &_deferred[1], _num_deferred * sizeof(_deferred[0]));
+
+  if (pkt->getPayloadType() == PAYLOAD_TYPE_ADVERT) {
+    recvAdvert(pkt);
+  } else {
+    recvGroupData(pkt);
+  }
+  releasePacket(pkt);
+}
+
+// refresh advert payload: pub_key prefix (MAX_HASH_SIZE), timestamp, signature of (pub_key, timestamp, data_hash)
+#define REFRESH_MSG_LEN   (PUB_KEY_SIZE + 4 + ADVERT_DATA_HASH_SIZE)
+
+DispatcherAction Mesh::handleAdvertRefresh(Packet* pkt) {
+  if (pkt->payload_len < MAX_HASH_SIZE + 4 + SIGNATURE_SIZE) {
+    MESH_DEBUG_PRINTLN("%s Mesh::handleAdvertRefresh(): incomplete refresh advert", getLogDateTime());
+    return ACTION_RELEASE;
+  }
+  if (memcmp(pkt->payload, self_id.pub_key, MAX_HASH_SIZE) == 0 || isSeen(pkt)) return ACTION_RELEASE;
+
+  uint8_t message[REFRESH_MSG_LEN];
+  Identity id;
+  if (!_advert_times.findBase(pkt->payload, id.pub_key, &message[PUB_KEY_SIZE + 4])) {
+    MESH_DEBUG_PRINTLN("%s Mesh::handleAdvertRefresh(): no full advert known for sender", getLogDateTime());
+    return ACTION_RELEASE;   // (can't verify, so don't forward either)
+  }
+  uint32_t timestamp;
+  memcpy(&timestamp, &pkt->payload[MAX_HASH_SIZE], 4);
+  const uint8_t* signature = &pkt->payload[MAX_HASH_SIZE + 4];
+  memcpy(message, id.pub_key, PUB_KEY_SIZE);
+  memcpy(&message[PUB_KEY_SIZE], &timestamp, 4);
+
+  uint8_t content_hash[MAX_HASH_SIZE];
+  Utils::sha256(content_hash, MAX_HASH_SIZE, message, REFRESH_MSG_LEN, signature, SIGNATURE_SIZE);
+  int check = _advert_times.check(id.pub_key, timestamp, content_hash);
+  if (check == ADVERT_CHECK_STALE || (check == ADVERT_CHECK_NEW && isAdvertStale(id, timestamp))) {
+    MESH_DEBUG_PRINTLN("%s Mesh::handleAdvertRefresh(): stale advertisement, ignoring", getLogDateTime());
+    return ACTION_RELEASE;
+  }
+  if (check != ADVERT_CHECK_VERIFIED) {
+    PROF_SCOPE(_prof, PROF_STAGE_CRYPTO);
+    if (!id.verify(signature, message, REFRESH_MSG_LEN)) {
+      MESH_DEBUG_PRINTLN("%s Mesh::handleAdvertRefresh(): forged signature!", getLogDateTime());
+      return ACTION_RELEASE;
+    }
+  }
+  _advert_times.update(id.pub_key, timestamp, content_hash, NULL);
+  { PROF_SCOPE(_prof, PROF_STAGE_APP); onAdvertRefreshRecv(pkt, id, timestamp); }
+  return routeRecvPacket(pkt);
+}
+
+static bool isCodable(const Packet* pkt) {
+  uint8_t type = pkt->getPayloadType();
+  return pkt->getRouteType() == ROUTE_TYPE_DIRECT
+      && (type == PAYLOAD_TYPE_REQ || type == PAYLOAD_TYPE_RESPONSE || type == PAYLOAD_TYPE_TXT_MSG || type == PAYLOAD_TYPE_PATH)
+      && pkt->payload_len > 2*pkt->getDatagramHashSize();
+}
+
+static const uint8_t* getNextHop(const Packet* pkt, uint8_t& hash_sz) {
+  if (pkt->path_len > 0) {
+    hash_sz = pkt->path_hash_size;
+    return pkt->path;
+  }
+  hash_sz = pkt->getDatagramHashSize();
+  return pkt->payload;   // last hop, so is the dest_hash
+}
+
+static bool isSameHash(const uint8_t* a, uint8_t a_len, const uint8_t* b, uint8_t b_len) {
+  return memcmp(a, b, a_len < b_len ? a_len : b_len) == 0;
+}
+
+void PeerCapsTable::update(const uint8_t* pub_key, uint8_t caps) {
+  Entry* e = &_entries[0];
+  for (int i = 0; i < PEER_CAPS_SLOTS; i++) {
+    if (_entries[i].seq && memcmp(_entries[i].pub_key, pub_key, PUB_KEY_SIZE) == 0) { e = &_entries[i]; break; }
+    if (_entries[i].seq < e->seq) e = &_entries[i];   // else replace the oldest (or an unused one)
+  }
+  memcpy(e->pub_key, pub_key, PUB_KEY_SIZE);
+  e->caps = caps;
+  e->seq = ++_seq;
+}
+
+bool PeerCapsTable::hasCaps(const uint8_t* hash, uint8_t hash_len, uint8_t caps) const {
+  const Entry* match = NULL;
+  for (int i = 0; i < PEER_CAPS_SLOTS; i++) {
+    if (_entries[i].seq == 0 || memcmp(_entries[i].pub_key, hash, hash_len) != 0) continue;
+    if (match) return false;   // ambiguous
+    match = &_entries[i];
+  }
+  return match && (match->caps & caps) == caps;
+}
+
+bool PeerCapsTable::pathHasCaps(const uint8_t* path, uint8_t enc_path_len, uint8_t caps) const {
+  uint8_t hop_sz = Packet::decodePathHashSize(enc_path_len);
+  uint8_t len = Packet::decodePathBytes(enc_path_len);
+  for (uint8_t i = 0; i + hop_sz <= len; i += hop_sz) {
+    if (!hasCaps(&path[i], hop_sz, caps)) return false;
+  }
+  return true;
+}
+
+void Mesh::recordCodingSent(const Packet* pkt) {
+  CodingSent* s = &_coding->sent[_coding->next_sent];
+  _coding->next_sent = (_coding->next_sent + 1) % CODING_SENT_SLOTS;
+
+  uint8_t hash[MAX_HASH_SIZE];
+  pkt->calculatePacketHash(hash);
+  memcpy(s->hash, hash, CODING_HASH_SIZE);
+  memcpy(s->payload, pkt->payload, pkt->payload_len);
+  s->payload_len = pkt->payload_len;
+}
+
+// CODED frame: {header, path_len, path, payload_len, hash, src_hash}, for each of the two datagrams, then their payloads XOR'd
+static int encodeCodedPart(uint8_t* dest, const Packet* pkt) {
+  int i = 0;
+  dest[i++] = pkt->header;
+  dest[i++] = pkt->getEncodedPathLen();
+  memcpy(&dest[i], pkt->path, pkt->path_len); i += pkt->path_len;
+  dest[i++] = pkt->payload_len;
+
+  uint8_t hash[MAX_HASH_SIZE];
+  pkt->calculatePacketHash(hash);
+  memcpy(&dest[i], hash, CODING_HASH_SIZE); i += CODING_HASH_SIZE;
+  uint8_t src_sz = pkt->getDatagramHashSize();
+  memcpy(&dest[i], &pkt->payload[src_sz], src_sz); i += src_sz;
+  return i;
+}
+
+static uint8_t getCodedSrcHashSize(const uint8_t* part) {
+  return ((part[0] >> PH_VER_SHIFT) & PH_VER_MASK) == PAYLOAD_VER_3 ? WIDE_HASH_SIZE : PATH_HASH_SIZE;
+}
+
+static void holdForResend(CodingHeld* held, const Packet* pkt) {
+  uint8_t hash[MAX_HASH_SIZE];
+  pkt->calculatePacketHash(hash);
+  memcpy(held->hash, hash, CODING_HASH_SIZE);
+  held->raw_len = pkt->writeTo(held->raw);
+}
+
+bool Mesh::codeWithQueued(Packet* pkt) {
+  if (!isCodable(pkt)) return false;
+
+  uint8_t hop_sz, src_sz = pkt->getDatagramHashSize();
+  const uint8_t* hop = getNextHop(pkt, hop_sz);
+  const uint8_t* src = &pkt->payload[src_sz];
+  if (_peer_caps == NULL || !_peer_caps->hasCaps(src, src_sz, PEER_CAP_NET_CODING)
+      || !_peer_caps->hasCaps(hop, hop_sz, PEER_CAP_NET_CODING)) return false;   // (unambiguous next hops only)
+
+  int n = _mgr->getOutboundCount(OUTBOUND_ANY_TIME);
+  for (int i = 0; i < n; i++) {
+    Packet* queued = _mgr->getOutboundByIdx(i);
+    if (queued == pkt || !isCodable(queued)) continue;
+
+    // must be going the other way, ie. each next hop sent the other datagram, so can XOR it out
+    uint8_t q_hop_sz, q_src_sz = queued->getDatagramHashSize();
+    const uint8_t* q_hop = getNextHop(queued, q_hop_sz);
+    const uint8_t* q_src = &queued->payload[q_src_sz];
+    if (!isSameHash(hop, hop_sz, q_src, q_src_sz) || !isSameHash(q_hop, q_hop_sz, src, src_sz)) continue;
+
+    int xor_len = pkt->payload_len > queued->payload_len ? pkt->payload_len : queued->payload_len;
+    int part_len = 2*(4 + CODING_HASH_SIZE) + pkt->path_len + queued->path_len + src_sz + q_src_sz;
+    if (part_len + xor_len > MAX_PACKET_PAYLOAD) return false;   // too big
+
+    uint8_t frame[MAX_PACKET_PAYLOAD];
+    int len = encodeCodedPart(frame, queued);
+    len += encodeCodedPart(&frame[len], pkt);
+    for (int k = 0; k < xor_len; k++) {
+      frame[len++] = (k < queued->payload_len ? queued->payload[k] : 0) ^ (k < pkt->payload_len ? pkt->payload[k] : 0);
+    }
+
+    holdForResend(&_coding->held[0], queued);   // in case either can't decode it
+    holdForResend(&_coding->held[1], pkt);
+    _coding->held_until = futureMillis(CODING_HOLD_MILLIS);
+
+    _mgr->removeOutboundByIdx(i);
+    releasePacket(queued);
+
+    pkt->header = ROUTE_TYPE_DIRECT | (PAYLOAD_TYPE_CODED << PH_TYPE_SHIFT) | (PAYLOAD_VER_1 << PH_VER_SHIFT);
+    pkt->path_len = 0;   // zero-hop
+    pkt->path_hash_size = PATH_HASH_SIZE;
+    memcpy(pkt->payload, frame, len);
+    pkt->payload_len = len;
+    _coding->n_coded++;
+    return true;
+  }
+  return false;
+}
+
+void Mesh::resendCodingHeld(const uint8_t* hash) {
+  if (millisHasNowPassed(_coding->held_until)) return;   // too late
+
+  for (int h = 0; h < 2; h++) {
+    CodingHeld* held = &_coding->held[h];
+    if (held->raw_len == 0 || memcmp(held->hash, hash, CODING_HASH_SIZE) != 0) continue;
+
+    Packet* pkt = obtainNewPacket();
+    if (pkt == NULL) return;
+    if (pkt->readFrom(held->raw, held->raw_len)) {
+      sendPacket(pkt, QOS_DIRECT);   // plain, this time
+    } else {
+      releasePacket(pkt);
+    }
+    held->raw_len = 0;   // just the once
+    return;
+  }
+}
+
+void Mesh::decodeCodedFrame(const Packet* pkt) {
+  if (pkt->payload_len == CODING_HASH_SIZE) {   // a 'miss': {hash}, from a node which couldn't decode our CODED frame
+    resendCodingHeld(pkt->payload);
+    return;
+  }
+
+  const uint8_t* part[2];
+  int i = 0;
+  for (int p = 0; p < 2; p++) {
+    part[p] = &pkt->payload[i];
+    if (i + 2 > pkt->payload_len) return;
+    i += 2 + Packet::decodePathBytes(pkt->payload[i + 1]) + 1 + CODING_HASH_SIZE + getCodedSrcHashSize(part[p]);
+  }
+  if (i > pkt->payload_len) return;   // truncated
+  const uint8_t* xor_data = &pkt->payload[i];
+  int xor_len = pkt->payload_len - i;
+
+  for (int p = 0; p < 2; p++) {
+    const uint8_t* mine = part[p];
+    uint8_t mine_path_bytes = Packet::decodePathBytes(mine[1]);
+    uint8_t mine_len = mine[2 + mine_path_bytes];
+    const uint8_t* mine_hash = &mine[3 + mine_path_bytes];
+
+    for (int s = 0; s < CODING_SENT_SLOTS; s++) {
+      const CodingSent* sent = &_coding->sent[s];
+      if (sent->payload_len == 0 || sent->payload_len != mine_len || memcmp(sent->hash, mine_hash, CODING_HASH_SIZE) != 0) continue;
+
+      const uint8_t* other = part[1 - p];   // we sent 'mine', so can XOR it out, leaving the other
+      uint8_t other_path_bytes = Packet::decodePathBytes(other[1]);
+      uint8_t other_len = other[2 + other_path_bytes];
+      if (other_len > xor_len || mine_len > xor_len || other_path_bytes > MAX_PATH_SIZE) return;
+
+      Packet* decoded = obtainNewPacket();
+      if (decoded == NULL) return;
+      decoded->header = other[0];
+      decoded->path_len = other_path_bytes;
+      decoded->path_hash_size = Packet::decodePathHashSize(other[1]);
+      memcpy(decoded->path, &other[2], other_path_bytes);
+      for (int k = 0; k < other_len; k++) {
+        decoded->payload[k] = xor_data[k] ^ (k < mine_len ? sent->payload[k] : 0);
+      }
+      decoded->payload_len = other_len;
+      decoded->_snr = pkt->_snr;
+      _coding->n_decoded++;
+      _mgr->queueInbound(decoded, _ms->getMillis());   // processed as if received
+      return;
+    }
+  }
+
+  // not decoded. If one was sent by us, it has gone from 'sent', so ask for the other datagram as a plain one
+  for (int p = 0; p < 2; p++) {
+    const uint8_t* mine = part[p];
+    uint8_t mine_path_bytes = Packet::decodePathBytes(mine[1]);
+    if (!self_id.isHashMatch(&mine[3 + mine_path_bytes + CODING_HASH_SIZE], getCodedSrcHashSize(mine))) continue;
+
+    const uint8_t* other = part[1 - p];
+    Packet* miss = obtainNewPacket();
+    if (miss == NULL) return;
+    miss->header = ROUTE_TYPE_DIRECT | (PAYLOAD_TYPE_CODED << PH_TYPE_SHIFT) | (PAYLOAD_VER_1 << PH_VER_SHIFT);
+    miss->path_len = 0;
+    miss->path_hash_size = PATH_HASH_SIZE;
+    memcpy(miss->payload, &other[3 + Packet::decodePathBytes(other[1])], CODING_HASH_SIZE);
+    miss->payload_len = CODING_HASH_SIZE;
+    _coding->n_missed++;
+    sendZeroHop(miss);
+    return;
+  }
+}
+
+// BUNDLE frame: path is the one next hop, payload is {raw_len, raw packet (as Packet::writeTo())} for each packet
+static bool isBundlable(const Packet* pkt) {
+  uint8_t type = pkt->getPayloadType();
+  if (pkt->getRouteType() != ROUTE_TYPE_DIRECT || type == PAYLOAD_TYPE_TRACE || type == PAYLOAD_TYPE_CODED
+      || type == PAYLOAD_TYPE_BUNDLE || type == PAYLOAD_TYPE_CONTROL) return false;
+  return pkt->path_len > 0 || isCodable(pkt);   // (last hop is only known for datagrams, ie. is dest_hash)
+}
+
+Packet* Mesh::bundleWithQueued(Packet* pkt) {
+  if (!isBundlable(pkt)) return pkt;
+  uint8_t hop_sz;
+  const uint8_t* hop = getNextHop(pkt, hop_sz);
+  if (_peer_caps == NULL || !_peer_caps->hasCaps(hop, hop_sz, PEER_CAP_BUNDLE)) return pkt;   // (unambiguous next hop only)
+
+  uint32_t due_by = _ms->getMillis() + getBundleWindowMillis();
+  Packet* parts[MAX_PACKET_PAYLOAD / 8];
+  int num = 0;
+  int len = 1 + pkt->getRawLength();
+  int n = _mgr->getOutboundCount(OUTBOUND_ANY_TIME);
+  for (int i = 0; i < n && num < (int)(sizeof(parts) / sizeof(parts[0])); i++) {
+    Packet* queued = _mgr->getOutboundByIdx(i);
+    uint32_t t;
+    if (!isBundlable(queued) || queued->_tx_channel != pkt->_tx_channel || !_mgr->getOutboundTimeByIdx(i, &t)
+        || (int32_t)(t - due_by) > 0) continue;
+
+    uint8_t q_hop_sz;
+    const uint8_t* q_hop = getNextHop(queued, q_hop_sz);
+    if (q_hop_sz != hop_sz || memcmp(q_hop, hop, hop_sz) != 0) continue;
+    if (len + 1 + queued->getRawLength() > MAX_PACKET_PAYLOAD) continue;   // (a smaller one may still fit)
+
+    uint8_t h1[MAX_HASH_SIZE], h2[MAX_HASH_SIZE];
+    pkt->calculatePacketHash(h1);
+    queued->calculatePacketHash(h2);
+    if (memcmp(h1, h2, MAX_HASH_SIZE) == 0) continue;   // a repeat (eg. extra ACK), so leave it to go separately
+
+    parts[num++] = queued;
+    len += 1 + queued->getRawLength();
+  }
+  if (num == 0) return pkt;
+
+  Packet* bundle = _mgr->allocNew();   // (pkt may be a truncated slab Packet, so can't re-use it)
+  if (bundle == NULL) return pkt;
+
+  bundle->header = ROUTE_TYPE_DIRECT | (PAYLOAD_TYPE_BUNDLE << PH_TYPE_SHIFT) | (PAYLOAD_VER_1 << PH_VER_SHIFT);
+  bundle->path_hash_size = hop_sz;
+  bundle->path_len = hop_sz;
+  memcpy(bundle->path, hop, hop_sz);
+  bundle->_snr = 0;
+  bundle->_tx_channel = pkt->_tx_channel;
+  int i = 0;
+  bundle->payload[i++] = pkt->getRawLength();
+  i += pkt->writeTo(&bundle->payload[i]);
+  for (int k = 0; k < num; k++) {
+    int j = _mgr->getOutboundCount(OUTBOUND_ANY_TIME);
+    while (--j >= 0 && _mgr->getOutboundByIdx(j) != parts[k]) ;   // (indexes shift on each removal, so find it again)
+    if (j < 0) continue;
+
+    _mgr->removeOutboundByIdx(j);
+    bundle->payload[i++] = parts[k]->getRawLength();
+    i += parts[k]->writeTo(&bundle->payload[i]);
+    releasePacket(parts[k]);
+  }
+  bundle->payload_len = i;
+  releasePacket(pkt);
+  _n_bundled++;
+  return bundle;
+}
+
+void Mesh::unpackBundle(const Packet* pkt) {
+  for (int i = 0; i < pkt->payload_len; ) {
+    uint8_t len = pkt->payload[i++];
+    if (len == 0 || i + len > pkt->payload_len) return;   // truncated
+
+    Packet* part = obtainNewPacket();
+    if (part == NULL) return;
+    if (part->readFrom(&pkt->payload[i], len)) {
+      part->_snr = pkt->_snr;
+      _mgr->queueInbound(part, _ms->getMillis());   // processed as if received
+    } else {
+      releasePacket(part);
+    }
+    i += len;
+  }
+}
+
+Packet* Mesh::prepareOutbound(Packet* pkt) {
+  if (getBundleWindowMillis() == 0) return pkt;
+  return bundleWithQueued(pkt);
+}
+
+bool Mesh::isSeen(const Packet* packet) {
+  PROF_SCOPE(_prof, PROF_STAGE_DEDUP);
+  return _tables->hasSeen(packet);
+}
+
 void Mesh::removeSelfFromPath(Packet* pkt) {
   // remove our hash from 'path'
-  pkt->path_len -= PATH_HASH_SIZE;
-#if 0
-  memcpy(pkt->path, &pkt->path[PATH_HASH_SIZE], pkt->path_len);
-#elif PATH_HASH_SIZE == 1
-  for (int k = 0; k < pkt->path_len; k++) {  // shuffle bytes by 1
-    pkt->path[k] = pkt->path[k + 1];
+  pkt->path_len -= pkt->path_hash_size;
+  memmove(pkt->path, &pkt->path[pkt->path_hash_size], pkt->path_len);
+}
+
+void Mesh::reversePath(uint8_t* dest, const uint8_t* path, uint8_t path_len) {
+  uint8_t len = Packet::decodePathBytes(path_len);
+  uint8_t sz = Packet::decodePathHashSize(path_len);
+  for (int k = 0; k < len; k += sz) {
+    memcpy(&dest[k], &path[len - sz - k], sz);
   }
-#else
-  #error "need path remove impl"
-#endif
 }
 
 DispatcherAction Mesh::routeRecvPacket(Packet* packet) {
+  PROF_SCOPE(_prof, PROF_STAGE_QUEUE);
+  uint8_t sz = packet->path_hash_size;
   if (packet->isRouteFlood() && !packet->isMarkedDoNotRetransmit()
-    && packet->path_len + PATH_HASH_SIZE <= MAX_PATH_SIZE && allowPacketForward(packet)) {
+    && packet->path_len + sz <= PLF_LEN_MASK
+    && packet->path_len < getFloodHopLimit(packet) * sz && allowPacketForward(packet)) {
     // append this node's hash to 'path'
-    packet->path_len += self_id.copyHashTo(&packet->path[packet->path_len]);
+    memcpy(&packet->path[packet->path_len], self_id.pub_key, sz);   // hash is just prefix of pub_key
+    packet->path_len += sz;
 
     uint32_t d = getRetransmitDelay(packet);
     // as this propagates outwards, give it lower and lower priority
-    return ACTION_RETRANSMIT_DELAYED(packet->path_len, d);   // give priority to closer sources, than ones further away
+    return ACTION_RETRANSMIT_DELAYED(QOS_FLOOD - 1 + packet->path_len / sz, d);   // give priority to closer sources, than ones further away
   }
   return ACTION_RELEASE;
 }
@@ -344,44 +1067,407 @@ DispatcherAction Mesh::forwardMultipartDirect(Packet* pkt) {
     Packet tmp;
     tmp.header = pkt->header;
     tmp.path_len = pkt->path_len;
+    tmp.path_hash_size = pkt->path_hash_size;
     memcpy(tmp.path, pkt->path, pkt->path_len);
     tmp.payload_len = pkt->payload_len - 1;
     memcpy(tmp.payload, &pkt->payload[1], tmp.payload_len);
 
-    if (!_tables->hasSeen(&tmp)) {   // don't retransmit!
+    if (!isSeen(&tmp)) {   // don't retransmit!
       removeSelfFromPath(&tmp);
       routeDirectRecvAcks(&tmp, ((uint32_t)remaining + 1) * 300);  // expect multipart ACKs 300ms apart (x2)
     }
+  } else if (!isSeen(pkt)) {   // fragments (and fragment ACKs) are forwarded like any other datagram
+    removeSelfFromPath(pkt);
+
+    uint32_t d = getDirectRetransmitDelay(pkt);
+    return ACTION_RETRANSMIT_DELAYED(QOS_DIRECT, d);
   }
   return ACTION_RELEASE;
 }
 
+static uint16_t allFragmentsMask(int total) { return (uint16_t) ((1UL << total) - 1); }
+
+uint32_t Mesh::calcFragmentAckTimeout(const FragmentTx* tx, int num_sent) const {
+  uint32_t t = _radio->getEstAirtimeFor(MAX_PACKET_PAYLOAD);
+  uint32_t hops = tx->path_len < 0 ? 8 : Packet::decodePathHops(tx->path_len) + 1;   // (guess for flood)
+  return 3000 + t * (num_sent + 1) * hops * 2;   // fragments out, ACK back
+}
+
+int Mesh::sendFragmented(uint8_t type, const Identity& dest, const uint8_t* secret, const uint8_t* data, size_t len, const uint8_t* path, int path_len) {
+  if (!hasFragments() || len == 0 || len > FRAG_MAX_DATA_SIZE) return -1;
+  if (type != PAYLOAD_TYPE_REQ && type != PAYLOAD_TYPE_RESPONSE && type != PAYLOAD_TYPE_TXT_MSG) return -1;
+  if (path && Packet::decodePathBytes(path_len) > MAX_PATH_SIZE) return -1;
+
+  FragmentTx* tx = NULL;
+  for (int i = 0; i < FRAG_TX_SLOTS; i++) {
+    if (_frags->tx[i].timeout == 0) { tx = &_frags->tx[i]; break; }
+  }
+  if (tx == NULL) {
+    MESH_DEBUG_PRINTLN("%s Mesh::sendFragmented(): no free slot", getLogDateTime());
+    return -1;
+  }
+
+  dest.copyHashTo(tx->dest_hash);
+  do {
+    _rng->random(&tx->xfer_id, 1);
+  } while (tx->xfer_id == 0);
+  tx->type = type;
+  tx->total = (len + FRAG_CHUNK_SIZE - 1) / FRAG_CHUNK_SIZE;
+  tx->attempt = 0;
+  tx->acked = 0;
+  tx->len = len;
+  memcpy(tx->secret, secret, PUB_KEY_SIZE);
+  if (path) {
+    memcpy(tx->path, path, Packet::decodePathBytes(path_len));
+    tx->path_len = path_len;
+  } else {
+    tx->path_len = -1;
+  }
+  memcpy(tx->data, data, len);
+
+  for (int i = 0; i < tx->total; i++) {
+    sendFragment(tx, i, 0);   // pipelined, ie. no waiting for per-fragment ACKs
+  }
+  tx->timeout = futureMillis(calcFragmentAckTimeout(tx, tx->total));
+  return tx->xfer_id;
+}
+
+Packet* Mesh::createFragment(FragmentTx* tx, int index) {
+  Packet* packet = obtainNewPacket();
+  if (packet == NULL) {
+    MESH_DEBUG_PRINTLN("%s Mesh::createFragment(): error, packet pool empty", getLogDateTime());
+    return NULL;
+  }
+  packet->header = (PAYLOAD_TYPE_MULTIPART << PH_TYPE_SHIFT);  // ROUTE_TYPE_* set later
+
+  int len = 0;
+  packet->payload[len++] = ((tx->total - 1 - index) << 4) | tx->type;   // remaining | type
+  memcpy(&packet->payload[len], tx->dest_hash, PATH_HASH_SIZE); len += PATH_HASH_SIZE;
+  len += self_id.copyHashTo(&packet->payload[len]);
+  packet->payload[len++] = tx->xfer_id;
+  packet->payload[len++] = ((tx->attempt & 0x0F) << 4) | index;
+
+  uint8_t data[FRAG_META_SIZE + FRAG_CHUNK_SIZE];
+  int offset = index * FRAG_CHUNK_SIZE;
+  int chunk_len = tx->len - offset < FRAG_CHUNK_SIZE ? tx->len - offset : FRAG_CHUNK_SIZE;
+  data[0] = tx->xfer_id;   // header fields again, so they're covered by the MAC (see onFragmentRecv())
+  data[1] = ((tx->total - 1 - index) << 4) | index;
+  data[2] = tx->type;
+  data[3] = chunk_len;
+  memcpy(&data[FRAG_META_SIZE], &tx->data[offset], chunk_len);
+  len += encryptPayload(packet, len, tx->secret, data, FRAG_META_SIZE + chunk_len);
+
+  packet->payload_len = len;
+  return packet;
+}
+
+void Mesh::sendFragment(FragmentTx* tx, int index, uint32_t delay_millis) {
+  Packet* pkt = createFragment(tx, index);
+  if (pkt == NULL) return;   // will be counted as missing, and re-sent later
+
+  if (tx->path_len >= 0) {
+    sendDirect(pkt, tx->path, tx->path_len, delay_millis);
+  } else {
+    sendFlood(pkt, delay_millis);
+  }
+}
+
+void Mesh::sendFragmentAck(const Packet* frag, int sender_idx, FragmentRx* rx) {
+  Packet* packet = obtainNewPacket();
+  if (packet == NULL) {
+    MESH_DEBUG_PRINTLN("%s Mesh::sendFragmentAck(): error, packet pool empty", getLogDateTime());
+    return;
+  }
+  packet->header = (PAYLOAD_TYPE_MULTIPART << PH_TYPE_SHIFT);  // ROUTE_TYPE_* set later
+
+  int len = 0;
+  packet->payload[len++] = PAYLOAD_TYPE_MULTIPART;   // remaining = 0, type = fragment ACK
+  memcpy(&packet->payload[len], rx->src_hash, PATH_HASH_SIZE); len += PATH_HASH_SIZE;
+  len += self_id.copyHashTo(&packet->payload[len]);
+
+  uint8_t data[7];
+  data[0] = rx->xfer_id;
+  memcpy(&data[1], &rx->received, 2);
+  getRNG()->random(&data[3], 4);   // make packet_hash unique, as same bitmap may be sent again
+  len += encryptPayload(packet, len, rx->secret, data, sizeof(data));
+
+  packet->payload_len = len;
+  routeFragmentAck(packet, frag, sender_idx);
+}
+
+void Mesh::routeFragmentAck(Packet* ack, const Packet* frag, int sender_idx) {
+  if (frag->isRouteFlood()) {
+    uint8_t reverse[MAX_PATH_SIZE];   // send back along same path, in reverse
+    reversePath(reverse, frag->path, frag->getEncodedPathLen());
+    sendDirect(ack, reverse, frag->getEncodedPathLen());
+  } else {
+    sendFlood(ack);
+  }
+}
+
+void Mesh::onPeerFragmentedDataRecv(Packet* packet, uint8_t type, int sender_idx, const uint8_t* secret, uint8_t* data, size_t len) {
+  if (len <= MAX_PACKET_PAYLOAD) {
+    onPeerDataRecv(packet, type, sender_idx, secret, data, len);
+  } else {
+    MESH_DEBUG_PRINTLN("%s Mesh::onPeerFragmentedDataRecv(): too big for onPeerDataRecv(), len=%d", getLogDateTime(), (uint32_t)len);
+  }
+}
+
+DispatcherAction Mesh::onFragmentRecv(Packet* pkt) {
+  int i = 0;
+  uint8_t remaining = pkt->payload[i] >> 4;
+  uint8_t type = pkt->payload[i++] & 0x0F;
+  uint8_t dest_hash = pkt->payload[i++];
+  uint8_t src_hash = pkt->payload[i++];
+  uint8_t xfer_id = pkt->payload[i++];
+  uint8_t index = pkt->payload[i++] & 0x0F;   // upper 4 bits are the sender's attempt
+  int total = index + remaining + 1;
+
+  if (i + CIPHER_MAC_SIZE >= pkt->payload_len) {
+    MESH_DEBUG_PRINTLN("%s Mesh::onFragmentRecv(): incomplete fragment", getLogDateTime());
+    return ACTION_RELEASE;
+  }
+  if (isSeen(pkt)) return ACTION_RELEASE;
+  if (!self_id.isHashMatch(&dest_hash)) return routeRecvPacket(pkt);
+  if (!hasFragments() || total > FRAG_MAX_COUNT) return ACTION_RELEASE;   // not supported, or too big for this node
+
+  int num = searchPeersByHash(&src_hash);
+  for (int j = 0; j < num; j++) {
+    uint8_t secret[PUB_KEY_SIZE];
+    getPeerSharedSecret(secret, j);
+
+    uint8_t data[MAX_PACKET_PAYLOAD];
+    int len = decryptPayload(pkt, secret, data, &pkt->payload[i], pkt->payload_len - i);
+    if (len <= 0) continue;
+
+    pkt->markDoNotRetransmit();  // packet was for this node, so don't retransmit
+    if (len < FRAG_META_SIZE || data[0] != xfer_id || data[1] != ((remaining << 4) | index) || data[2] != type) {
+      MESH_DEBUG_PRINTLN("%s Mesh::onFragmentRecv(): header doesn't match authenticated copy", getLogDateTime());
+      break;   // renumbered, or spliced from another transfer
+    }
+    uint8_t chunk_len = data[3];
+    if (chunk_len + FRAG_META_SIZE > len || chunk_len > FRAG_CHUNK_SIZE || (index + 1 < total && chunk_len != FRAG_CHUNK_SIZE)) {
+      MESH_DEBUG_PRINTLN("%s Mesh::onFragmentRecv(): invalid chunk_len=%d", getLogDateTime(), (uint32_t)chunk_len);
+      break;
+    }
+
+    FragmentRx* rx = NULL;
+    FragmentRx* spare = NULL;
+    for (int k = 0; k < FRAG_RX_SLOTS; k++) {
+      FragmentRx* r = &_frags->rx[k];
+      if (r->expires && r->xfer_id == xfer_id && r->type == type && memcmp(r->src_hash, &src_hash, PATH_HASH_SIZE) == 0
+          && memcmp(r->secret, secret, PUB_KEY_SIZE) == 0) {
+        rx = r;
+        break;
+      }
+      if (r->expires == 0) {
+        spare = r;
+      } else if (r->done && (spare == NULL || (spare->expires && spare->expires > r->expires))) {
+        spare = r;   // can re-use a delivered one, oldest first
+      }
+    }
+    if (rx == NULL) {
+      if (spare == NULL) {
+        MESH_DEBUG_PRINTLN("%s Mesh::onFragmentRecv(): no free slot", getLogDateTime());
+        break;
+      }
+      rx = spare;
+      memcpy(rx->src_hash, &src_hash, PATH_HASH_SIZE);
+      rx->xfer_id = xfer_id;
+      rx->type = type;
+      rx->total = total;
+      rx->done = false;
+      rx->received = 0;
+      rx->len = 0;
+      memcpy(rx->secret, secret, PUB_KEY_SIZE);
+    } else if (rx->total != total) {
+      MESH_DEBUG_PRINTLN("%s Mesh::onFragmentRecv(): inconsistent total", getLogDateTime());
+      break;
+    }
+    rx->expires = futureMillis(FRAG_RX_TIMEOUT_MILLIS);
+
+    if (!rx->done) {
+      memcpy(&rx->data[index * FRAG_CHUNK_SIZE], &data[FRAG_META_SIZE], chunk_len);
+      rx->received |= (1 << index);
+      if (index + 1 == total) rx->len = index * FRAG_CHUNK_SIZE + chunk_len;
+    }
+    bool complete = rx->received == allFragmentsMask(total);
+    if (complete || remaining == 0) {
+      sendFragmentAck(pkt, j, rx);   // selective ACK, when sender has finished sending (or re-sending)
+    }
+    if (complete && !rx->done) {
+      rx->done = true;
+      rx->data[rx->len] = 0;   // null terminate, for convenience
+      onPeerFragmentedDataRecv(pkt, type, j, rx->secret, rx->data, rx->len);
+    }
+    break;
+  }
+  return ACTION_RELEASE;
+}
+
+DispatcherAction Mesh::onFragmentAckRecv(Packet* pkt) {
+  int i = 1;
+  uint8_t dest_hash = pkt->payload[i++];
+  uint8_t src_hash = pkt->payload[i++];
+
+  if (i + CIPHER_MAC_SIZE >= pkt->payload_len) {
+    MESH_DEBUG_PRINTLN("%s Mesh::onFragmentAckRecv(): incomplete packet", getLogDateTime());
+    return ACTION_RELEASE;
+  }
+  if (isSeen(pkt)) return ACTION_RELEASE;
+  if (!self_id.isHashMatch(&dest_hash)) return routeRecvPacket(pkt);
+  if (!hasFragments()) return ACTION_RELEASE;
+
+  int num = searchPeersByHash(&src_hash);
+  for (int j = 0; j < num; j++) {
+    uint8_t secret[PUB_KEY_SIZE];
+    getPeerSharedSecret(secret, j);
+
+    uint8_t data[MAX_PACKET_PAYLOAD];
+    int len = decryptPayload(pkt, secret, data, &pkt->payload[i], pkt->payload_len - i);
+    if (len < 3) continue;
+
+    pkt->markDoNotRetransmit();
+    uint16_t bitmap;
+    memcpy(&bitmap, &data[1], 2);
+
+    for (int k = 0; k < FRAG_TX_SLOTS; k++) {
+      FragmentTx* tx = &_frags->tx[k];
+      if (tx->timeout == 0 || tx->xfer_id != data[0] || memcmp(tx->dest_hash, &src_hash, PATH_HASH_SIZE) != 0
+          || memcmp(tx->secret, secret, PUB_KEY_SIZE) != 0) continue;
+
+      tx->acked |= bitmap;
+      if ((tx->acked & allFragmentsMask(tx->total)) == allFragmentsMask(tx->total)) {
+        uint8_t id = tx->xfer_id;
+        memset(tx, 0, sizeof(*tx));
+        onFragmentedSendDone(id, true);
+      } else if (tx->attempt >= FRAG_MAX_RETRIES) {
+        uint8_t id = tx->xfer_id;
+        memset(tx, 0, sizeof(*tx));
+        onFragmentedSendDone(id, false);
+      } else {
+        tx->attempt++;
+        int n = 0;
+        for (int f = 0; f < tx->total; f++) {   // re-send just the missing ones
+          if ((tx->acked & (1 << f)) == 0) { sendFragment(tx, f, 0); n++; }
+        }
+        tx->timeout = futureMillis(calcFragmentAckTimeout(tx, n));
+      }
+      break;
+    }
+    break;
+  }
+  return ACTION_RELEASE;
+}
+
+void Mesh::checkFragmentTimers() {
+  if (!hasFragments()) return;
+
+  for (int i = 0; i < FRAG_RX_SLOTS; i++) {
+    FragmentRx* rx = &_frags->rx[i];
+    if (rx->expires && millisHasNowPassed(rx->expires)) {
+      rx->expires = 0;   // abandon
+      memset(rx->secret, 0, PUB_KEY_SIZE);
+    }
+  }
+  for (int i = 0; i < FRAG_TX_SLOTS; i++) {
+    FragmentTx* tx = &_frags->tx[i];
+    if (tx->timeout == 0 || !millisHasNowPassed(tx->timeout)) continue;
+
+    if (tx->attempt >= FRAG_MAX_RETRIES) {
+      uint8_t id = tx->xfer_id;
+      memset(tx, 0, sizeof(*tx));
+      onFragmentedSendDone(id, false);
+    } else {
+      // no ACK heard, re-send the last fragment, as recipient sends ACK on this
+      tx->attempt++;
+      sendFragment(tx, tx->total - 1, 0);
+      tx->timeout = futureMillis(calcFragmentAckTimeout(tx, 1));
+    }
+  }
+}
+
 void Mesh::routeDirectRecvAcks(Packet* packet, uint32_t delay_millis) {
   if (!packet->isMarkedDoNotRetransmit()) {
-    uint32_t crc;
-    memcpy(&crc, packet->payload, 4);
+    int num = packet->payload_len / 4;   // can be a packed ACK
 
     uint8_t extra = getExtraAckTransmitCount();
     while (extra > 0) {
       delay_millis += getDirectRetransmitDelay(packet) + 300;
-      auto a1 = createMultiAck(crc, extra);
-      if (a1) {
-        memcpy(a1->path, packet->path, a1->path_len = packet->path_len);
-        a1->header &= ~PH_ROUTE_MASK;
-        a1->header |= ROUTE_TYPE_DIRECT;
-        sendPacket(a1, 0, delay_millis);
+      for (int i = 0; i < num; i++) {
+        uint32_t crc;
+        memcpy(&crc, &packet->payload[i*4], 4);
+        auto a1 = createMultiAck(crc, extra);
+        if (a1) {
+          memcpy(a1->path, packet->path, a1->path_len = packet->path_len);
+          a1->path_hash_size = packet->path_hash_size;
+          a1->header &= ~PH_ROUTE_MASK;
+          a1->header |= ROUTE_TYPE_DIRECT;
+          sendPacket(a1, QOS_CONTROL, delay_millis);
+        }
       }
       extra--;
     }
 
+    uint32_t crc;
+    memcpy(&crc, packet->payload, 4);
     auto a2 = createAck(crc);
     if (a2) {
+      memcpy(&a2->payload[4], &packet->payload[4], (num - 1)*4);
+      a2->payload_len = num*4;
       memcpy(a2->path, packet->path, a2->path_len = packet->path_len);
+      a2->path_hash_size = packet->path_hash_size;
       a2->header &= ~PH_ROUTE_MASK;
       a2->header |= ROUTE_TYPE_DIRECT;
-      sendPacket(a2, 0, delay_millis);
+      queueDirectAck(a2, delay_millis);
+    }
+  }
+}
+
+int Mesh::removeSeenAcks(Packet* packet) {
+  if (packet->payload_len == 4) return isSeen(packet) ? 0 : 1;   // the usual, single ACK
+
+  int num = 0;
+  for (int i = 0; i + 4 <= packet->payload_len; i += 4) {   // each CRC of packed ACK is tracked separately
+    Packet tmp;
+    tmp.header = packet->header;
+    tmp.path_len = 0;
+    memcpy(tmp.payload, &packet->payload[i], 4);
+    tmp.payload_len = 4;
+    if (!isSeen(&tmp)) {
+      memmove(&packet->payload[num*4], tmp.payload, 4); num++;
     }
   }
+  packet->payload_len = num*4;
+  return num;
+}
+
+bool Mesh::packIntoQueuedAck(const Packet* ack) {
+  int n = _mgr->getOutboundCount(OUTBOUND_ANY_TIME);
+  for (int i = 0; i < n; i++) {
+    Packet* queued = _mgr->getOutboundByIdx(i);
+    if (queued->header == ack->header && queued->getEncodedPathLen() == ack->getEncodedPathLen()
+        && memcmp(queued->path, ack->path, ack->path_len) == 0
+        && (!queued->hasTransportCodes() || memcmp(queued->transport_codes, ack->transport_codes, sizeof(ack->transport_codes)) == 0)
+        && queued->payload_len + ack->payload_len <= MAX_PACKED_ACKS*4) {
+      memcpy(&queued->payload[queued->payload_len], ack->payload, ack->payload_len);
+      queued->payload_len += ack->payload_len;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Mesh::queueDirectAck(Packet* ack, uint32_t delay_millis) {
+  uint32_t window = getAckPackWindow();
+  if (window > 0) {
+    if (packIntoQueuedAck(ack)) {   // going out with another ACK for same path
+      releasePacket(ack);
+      return;
+    }
+    if (delay_millis < window) delay_millis = window;   // hold, so others can join this one
+  }
+  sendPacket(ack, QOS_CONTROL, delay_millis);
 }
 
 Packet* Mesh::createAdvert(const LocalIdentity& id, const uint8_t* app_data, size_t app_data_len) {
@@ -420,16 +1506,62 @@ Packet* Mesh::createAdvert(const LocalIdentity& id, const uint8_t* app_data, siz
   return packet;
 }
 
+Packet* Mesh::createSelfAdvertPacket(const uint8_t* app_data, size_t app_data_len) {
+  uint8_t data_hash[ADVERT_DATA_HASH_SIZE];
+  Utils::sha256(data_hash, ADVERT_DATA_HASH_SIZE, app_data, app_data_len);
+  if (_refreshes_left == 0 || memcmp(data_hash, _self_data_hash, ADVERT_DATA_HASH_SIZE) != 0) {
+    Packet* packet = createAdvert(self_id, app_data, app_data_len);
+    if (packet) {
+      memcpy(_self_data_hash, data_hash, ADVERT_DATA_HASH_SIZE);
+      _refreshes_left = getAdvertRefreshCount();
+    }
+    return packet;
+  }
+
+  Packet* packet = obtainNewPacket();
+  if (packet == NULL) {
+    MESH_DEBUG_PRINTLN("%s Mesh::createSelfAdvertPacket(): error, packet pool empty", getLogDateTime());
+    return NULL;
+  }
+  packet->header = (PAYLOAD_TYPE_ADVERT << PH_TYPE_SHIFT) | (PAYLOAD_VER_2 << PH_VER_SHIFT);  // ROUTE_TYPE_* is set later
+
+  uint32_t emitted_timestamp = _rtc->getCurrentTime();
+  uint8_t message[REFRESH_MSG_LEN];
+  memcpy(message, self_id.pub_key, PUB_KEY_SIZE);
+  memcpy(&message[PUB_KEY_SIZE], &emitted_timestamp, 4);
+  memcpy(&message[PUB_KEY_SIZE + 4], data_hash, ADVERT_DATA_HASH_SIZE);
+
+  int len = 0;
+  memcpy(&packet->payload[len], self_id.pub_key, MAX_HASH_SIZE); len += MAX_HASH_SIZE;
+  memcpy(&packet->payload[len], &emitted_timestamp, 4); len += 4;
+  self_id.sign(&packet->payload[len], message, REFRESH_MSG_LEN); len += SIGNATURE_SIZE;
+  packet->payload_len = len;
+
+  _refreshes_left--;
+  return packet;
+}
+
 #define MAX_COMBINED_PATH  (MAX_PACKET_PAYLOAD - 2 - CIPHER_BLOCK_SIZE)
 
-Packet* Mesh::createPathReturn(const Identity& dest, const uint8_t* secret, const uint8_t* path, uint8_t path_len, uint8_t extra_type, const uint8_t*extra, size_t extra_len) {
-  uint8_t dest_hash[PATH_HASH_SIZE];
-  dest.copyHashTo(dest_hash);
-  return createPathReturn(dest_hash, secret, path, path_len, extra_type, extra, extra_len);
+Packet* Mesh::createPathReturn(const Identity& dest, const uint8_t* secret, const uint8_t* path, uint8_t path_len, uint8_t extra_type, const uint8_t*extra, size_t extra_len, const LocalIdentity* from) {
+  // NOTE: dest hash is just prefix of pub_key
+  return createPathReturn(dest.pub_key, secret, path, path_len, extra_type, extra, extra_len,
+                          isWideHashPeer(dest) ? WIDE_HASH_SIZE : PATH_HASH_SIZE, from);
 }
 
-Packet* Mesh::createPathReturn(const uint8_t* dest_hash, const uint8_t* secret, const uint8_t* path, uint8_t path_len, uint8_t extra_type, const uint8_t*extra, size_t extra_len) {
-  if (path_len + extra_len + 5 > MAX_COMBINED_PATH) return NULL;  // too long!!
+static int datagramHashSize(uint8_t ver) {
+  return ver == PAYLOAD_VER_3 ? WIDE_HASH_SIZE : PATH_HASH_SIZE;
+}
+static int datagramMacSize(uint8_t ver) {
+  return ver >= PAYLOAD_VER_2 ? CIPHER_MAC_V2_SIZE : CIPHER_MAC_SIZE;
+}
+static int datagramMaxPlain(uint8_t ver) {   // the most plaintext that fits, once encrypted
+  int room = MAX_PACKET_PAYLOAD - 2*datagramHashSize(ver) - datagramMacSize(ver);
+  return ver >= PAYLOAD_VER_2 ? room : (room & ~(CIPHER_BLOCK_SIZE-1));   // (AES-ECB pads to whole blocks)
+}
+
+Packet* Mesh::createPathReturn(const uint8_t* dest_hash, const uint8_t* secret, const uint8_t* path, uint8_t path_len, uint8_t extra_type, const uint8_t*extra, size_t extra_len, uint8_t dest_hash_len, const LocalIdentity* from) {
+  if (Packet::decodePathBytes(path_len) + extra_len + 5 > MAX_COMBINED_PATH) return NULL;  // too long!!
 
   Packet* packet = obtainNewPacket();
   if (packet == NULL) {
@@ -438,16 +1570,17 @@ Packet* Mesh::createPathReturn(const uint8_t* dest_hash, const uint8_t* secret,
   }
   packet->header = (PAYLOAD_TYPE_PATH << PH_TYPE_SHIFT);  // ROUTE_TYPE_* set later
 
+  uint8_t ver = dest_hash_len == WIDE_HASH_SIZE ? PAYLOAD_VER_3 : getDatagramPayloadVer();
   int len = 0;
-  memcpy(&packet->payload[len], dest_hash, PATH_HASH_SIZE); len += PATH_HASH_SIZE;  // dest hash
-  len += self_id.copyHashTo(&packet->payload[len]);  // src hash
+  memcpy(&packet->payload[len], dest_hash, dest_hash_len); len += dest_hash_len;  // dest hash
+  memcpy(&packet->payload[len], (from ? from : &self_id)->pub_key, dest_hash_len); len += dest_hash_len;  // src hash
 
   {
     int data_len = 0;
-    uint8_t data[MAX_PACKET_PAYLOAD];
+    uint8_t* data = &packet->payload[len + datagramMacSize(ver)];   // plaintext put in place, and encrypted there
 
-    data[data_len++] = path_len;
-    memcpy(&data[data_len], path, path_len); data_len += path_len;
+    data[data_len++] = path_len;   // encoded, ie. with PLF_WIDE_PATH flag if wide
+    memcpy(&data[data_len], path, Packet::decodePathBytes(path_len)); data_len += Packet::decodePathBytes(path_len);
     if (extra_len > 0) {
       data[data_len++] = extra_type;
       memcpy(&data[data_len], extra, extra_len); data_len += extra_len;
@@ -457,7 +1590,7 @@ Packet* Mesh::createPathReturn(const uint8_t* dest_hash, const uint8_t* secret,
       getRNG()->random(&data[data_len], 4); data_len += 4;
     }
 
-    len += Utils::encryptThenMAC(secret, &packet->payload[len], data, data_len);
+    len += encryptPayload(packet, len, secret, data, data_len, ver);
   }
 
   packet->payload_len = len;
@@ -465,24 +1598,71 @@ Packet* Mesh::createPathReturn(const uint8_t* dest_hash, const uint8_t* secret,
   return packet;
 }
 
-Packet* Mesh::createDatagram(uint8_t type, const Identity& dest, const uint8_t* secret, const uint8_t* data, size_t data_len) {
-  if (type == PAYLOAD_TYPE_TXT_MSG || type == PAYLOAD_TYPE_REQ || type == PAYLOAD_TYPE_RESPONSE) {
-    if (data_len + CIPHER_MAC_SIZE + CIPHER_BLOCK_SIZE-1 > MAX_PACKET_PAYLOAD) return NULL;
-  } else {
-    return NULL;  // invalid type
+int Mesh::encryptPayload(Packet* packet, int offset, const uint8_t* secret, const uint8_t* data, int data_len) {
+  return encryptPayload(packet, offset, secret, data, data_len, getDatagramPayloadVer());
+}
+
+int Mesh::encryptPayload(Packet* packet, int offset, const uint8_t* secret, const uint8_t* data, int data_len, uint8_t ver) {
+  packet->header &= ~(PH_VER_MASK << PH_VER_SHIFT);
+  packet->header |= (ver << PH_VER_SHIFT);
+
+  if (ver >= PAYLOAD_VER_2) {
+    return Utils::encryptSIV(_cipher_keys.get(secret), &packet->payload[offset], data, data_len);
   }
+  return Utils::encryptThenMAC(_cipher_keys.get(secret), &packet->payload[offset], data, data_len);
+}
+
+int Mesh::decryptPayload(const Packet* packet, const uint8_t* secret, uint8_t* dest, const uint8_t* src, int src_len) {
+  PROF_SCOPE(_prof, PROF_STAGE_CRYPTO);
+  if (packet->getPayloadVer() >= PAYLOAD_VER_2) {
+    return Utils::decryptSIV(_cipher_keys.get(secret), dest, src, src_len);
+  }
+  return Utils::MACThenDecrypt(_cipher_keys.get(secret), dest, src, src_len);
+}
+
+Packet* Mesh::createDatagram(uint8_t type, const Identity& dest, const uint8_t* secret, const uint8_t* data, size_t data_len, const LocalIdentity* from) {
+  if (data_len + CIPHER_MAC_SIZE + CIPHER_BLOCK_SIZE-1 > MAX_PACKET_PAYLOAD) return NULL;
+
+  uint8_t* plain;
+  int max_len;
+  Packet* packet = beginDatagram(type, dest, plain, max_len, from);
+  if (packet == NULL) return NULL;
+
+  return finishDatagram(packet, secret, data, data_len);
+}
+
+Packet* Mesh::beginDatagram(uint8_t type, const Identity& dest, uint8_t*& plain, int& max_len, const LocalIdentity* from) {
+  if (!(type == PAYLOAD_TYPE_TXT_MSG || type == PAYLOAD_TYPE_REQ || type == PAYLOAD_TYPE_RESPONSE)) return NULL;  // invalid type
 
   Packet* packet = obtainNewPacket();
   if (packet == NULL) {
     MESH_DEBUG_PRINTLN("%s Mesh::createDatagram(): error, packet pool empty", getLogDateTime());
     return NULL;
   }
-  packet->header = (type << PH_TYPE_SHIFT);  // ROUTE_TYPE_* set later
+  uint8_t ver = isWideHashPeer(dest) ? PAYLOAD_VER_3 : getDatagramPayloadVer();
+  packet->header = (type << PH_TYPE_SHIFT) | (ver << PH_VER_SHIFT);  // ROUTE_TYPE_* set later
 
+  int hash_sz = datagramHashSize(ver);
   int len = 0;
-  len += dest.copyHashTo(&packet->payload[len]);  // dest hash
-  len += self_id.copyHashTo(&packet->payload[len]);  // src hash
-  len += Utils::encryptThenMAC(secret, &packet->payload[len], data, data_len);
+  memcpy(&packet->payload[len], dest.pub_key, hash_sz); len += hash_sz;  // dest hash (just prefix of pub_key)
+  memcpy(&packet->payload[len], (from ? from : &self_id)->pub_key, hash_sz); len += hash_sz;  // src hash
+
+  // NOTE: encrypting in place is safe: AES-ECB blocks go in order (partial last block via a tmp), and SIV takes the
+  //   CMAC of all the plaintext first, then CTR is just a byte-wise XOR
+  len += datagramMacSize(ver);
+  plain = &packet->payload[len];
+  max_len = datagramMaxPlain(ver);
+  return packet;
+}
+
+Packet* Mesh::finishDatagram(Packet* packet, const uint8_t* secret, const uint8_t* data, size_t data_len) {
+  uint8_t ver = packet->getPayloadVer();
+  int len = 2 * datagramHashSize(ver);
+  if ((int)data_len > datagramMaxPlain(ver)) {
+    releasePacket(packet);
+    return NULL;
+  }
+  len += encryptPayload(packet, len, secret, data, data_len, ver);
 
   packet->payload_len = len;
 
@@ -510,7 +1690,7 @@ Packet* Mesh::createAnonDatagram(uint8_t type, const LocalIdentity& sender, cons
   } else {
     // FUTURE:
   }
-  len += Utils::encryptThenMAC(secret, &packet->payload[len], data, data_len);
+  len += encryptPayload(packet, len, secret, data, data_len);
 
   packet->payload_len = len;
 
@@ -530,7 +1710,7 @@ Packet* Mesh::createGroupDatagram(uint8_t type, const GroupChannel& channel, con
 
   int len = 0;
   memcpy(&packet->payload[len], channel.hash, PATH_HASH_SIZE); len += PATH_HASH_SIZE;
-  len += Utils::encryptThenMAC(channel.secret, &packet->payload[len], data, data_len);
+  len += encryptPayload(packet, len, channel.secret, data, data_len);
 
   packet->payload_len = len;
 
@@ -623,17 +1803,11 @@ void Mesh::sendFlood(Packet* packet, uint32_t delay_millis) {
   packet->header &= ~PH_ROUTE_MASK;
   packet->header |= ROUTE_TYPE_FLOOD;
   packet->path_len = 0;
+  packet->path_hash_size = getFloodPathHashSize();
 
   _tables->hasSeen(packet); // mark this packet as already sent in case it is rebroadcast back to us
 
-  uint8_t pri;
-  if (packet->getPayloadType() == PAYLOAD_TYPE_PATH) {
-    pri = 2;
-  } else if (packet->getPayloadType() == PAYLOAD_TYPE_ADVERT) {
-    pri = 3;   // de-prioritie these
-  } else {
-    pri = 1;
-  }
+  uint8_t pri = packet->getPayloadType() == PAYLOAD_TYPE_ADVERT ? QOS_ADVERT : QOS_FLOOD;   // de-prioritise adverts
   sendPacket(packet, pri, delay_millis);
 }
 
@@ -648,17 +1822,11 @@ void Mesh::sendFlood(Packet* packet, uint16_t* transport_codes, uint32_t delay_m
   packet->transport_codes[0] = transport_codes[0];
   packet->transport_codes[1] = transport_codes[1];
   packet->path_len = 0;
+  packet->path_hash_size = getFloodPathHashSize();
 
   _tables->hasSeen(packet); // mark this packet as already sent in case it is rebroadcast back to us
 
-  uint8_t pri;
-  if (packet->getPayloadType() == PAYLOAD_TYPE_PATH) {
-    pri = 2;
-  } else if (packet->getPayloadType() == PAYLOAD_TYPE_ADVERT) {
-    pri = 3;   // de-prioritie these
-  } else {
-    pri = 1;
-  }
+  uint8_t pri = packet->getPayloadType() == PAYLOAD_TYPE_ADVERT ? QOS_ADVERT : QOS_FLOOD;   // de-prioritise adverts
   sendPacket(packet, pri, delay_millis);
 }
 
@@ -673,20 +1841,29 @@ void Mesh::sendDirect(Packet* packet, const uint8_t* path, uint8_t path_len, uin
     packet->payload_len += path_len;
 
     packet->path_len = 0;
-    pri = 5;   // maybe make this configurable
+    packet->path_hash_size = PATH_HASH_SIZE;
+    pri = QOS_BULK;
   } else {
-    memcpy(packet->path, path, packet->path_len = path_len);
-    if (packet->getPayloadType() == PAYLOAD_TYPE_PATH) {
-      pri = 1;   // slightly less priority
-    } else {
-      pri = 0;
+    if (packet->hasCompactFraming() && Packet::decodePathBytes(path_len) > PLF_LEN_MASK) {
+      MESH_DEBUG_PRINTLN("%s Mesh::sendDirect(): 64 byte path can't be sent with compact framing", getLogDateTime());
+      releasePacket(packet);
+      return;
     }
+    packet->path_len = Packet::decodePathBytes(path_len);
+    packet->path_hash_size = Packet::decodePathHashSize(path_len);
+    memcpy(packet->path, path, packet->path_len);
+    pri = QOS_DIRECT;
   }
   _tables->hasSeen(packet); // mark this packet as already sent in case it is rebroadcast back to us
-  sendPacket(packet, pri, delay_millis);
+  if (_coding && packet->path_len > 0 && isCodable(packet)) recordCodingSent(packet);
+  if (packet->getPayloadType() == PAYLOAD_TYPE_ACK) {
+    queueDirectAck(packet, delay_millis);
+  } else {
+    sendPacket(packet, pri, delay_millis);
+  }
 }
 
-void Mesh::sendZeroHop(Packet* packet, uint32_t delay_millis) {
+void Mesh::sendZeroHop(Packet* packet, uint32_t delay_millis, uint8_t priority) {
   packet->header &= ~PH_ROUTE_MASK;
   packet->header |= ROUTE_TYPE_DIRECT;
 
@@ -694,7 +1871,7 @@ void Mesh::sendZeroHop(Packet* packet, uint32_t delay_millis) {
 
   _tables->hasSeen(packet); // mark this packet as already sent in case it is rebroadcast back to us
 
-  sendPacket(packet, 0, delay_millis);
+  sendPacket(packet, priority, delay_millis);
 }
 
 void Mesh::sendZeroHop(Packet* packet, uint16_t* transport_codes, uint32_t delay_millis) {
@@ -707,7 +1884,7 @@ void Mesh::sendZeroHop(Packet* packet, uint16_t* transport_codes, uint32_t delay
 
   _tables->hasSeen(packet); // mark this packet as already sent in case it is rebroadcast back to us
 
-  sendPacket(packet, 0, delay_millis);
+  sendPacket(packet, QOS_CONTROL, delay_millis);
 }
 
 }
\ No newline at end of file
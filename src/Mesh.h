@@ -19,6 +19,300 @@ public:
   virtual void clear(const Packet* packet) = 0;   // remove this packet hash from table
 };
 
+#ifndef SECRET_CACHE_SIZE
+  #define SECRET_CACHE_SIZE   8
+#endif
+
+/**
+ * \brief  A small LRU cache of (peer pub_key -> ECDH shared secret), so that repeated key exchanges with the same peer
+ *     (eg. ANON_REQ logins, contact imports) don't each need the Ed25519 -> X25519 conversion and full scalar multiply.
+ *     Is flushed if our own identity changes.
+*/
+class SharedSecretCache {
+  struct Entry {
+    uint8_t pub_key[PUB_KEY_SIZE];
+    uint8_t secret[PUB_KEY_SIZE];
+    uint32_t last_used;   // zero if unused
+  };
+  Entry _entries[SECRET_CACHE_SIZE];
+  uint8_t _self_pub_key[PUB_KEY_SIZE];   // identity the secrets were calculated with
+  uint32_t _counter;
+
+public:
+  SharedSecretCache() { memset(this, 0, sizeof(*this)); }
+
+  /**
+   * \brief  puts the shared secret between 'self' and 'other_pub_key' into 'secret', calculating it only if not cached.
+  */
+  void calcSharedSecret(uint8_t* secret, const LocalIdentity& self, const uint8_t* other_pub_key);
+};
+
+#ifndef ADVERT_CACHE_SIZE
+  #define ADVERT_CACHE_SIZE   16
+#endif
+
+#define ADVERT_CHECK_NEW        0   // must verify signature
+#define ADVERT_CHECK_VERIFIED   1   // exact repeat of an already verified advert
+#define ADVERT_CHECK_STALE      2   // older than (or conflicting with) what was last verified
+
+#define ADVERT_DATA_HASH_SIZE   8   // (truncated) SHA256 of a full advert's app_data, as signed by refresh adverts
+
+/**
+ * \brief  Remembers the (pub_key, timestamp, content hash) of the most recently verified adverts, so that
+ *     re-broadcasts of the same, or an older, advert can be handled without the Ed25519 signature math.
+ *     The content hash is a (truncated) SHA256 of the signed message AND the signature, so an exact repeat can't be
+ *     spoofed by altering the app_data, nor flooded in many variants with garbage signatures.
+ *     Also holds the full pub_key and app_data hash of the last full advert, to verify 'refresh' adverts against.
+*/
+class AdvertTimestampCache {
+  struct Entry {
+    uint8_t pub_key[PUB_KEY_SIZE];
+    uint8_t content_hash[MAX_HASH_SIZE];
+    uint8_t data_hash[ADVERT_DATA_HASH_SIZE];   // of last full advert
+    uint32_t timestamp;
+    uint32_t last_used;   // zero if unused
+  };
+  Entry _entries[ADVERT_CACHE_SIZE];
+  uint32_t _counter;
+
+public:
+  AdvertTimestampCache() { memset(this, 0, sizeof(*this)); }
+
+  /**
+   * \returns  one of ADVERT_CHECK_*
+  */
+  int check(const uint8_t* pub_key, uint32_t timestamp, const uint8_t* content_hash) const;
+
+  /**
+   * \brief  after signature verified
+   * \param  data_hash  hash of app_data, if a full advert, or NULL if a refresh
+  */
+  void update(const uint8_t* pub_key, uint32_t timestamp, const uint8_t* content_hash, const uint8_t* data_hash);
+
+  /**
+   * \brief  finds the full pub_key, and last full advert's data_hash, for a refresh advert's key prefix
+   * \returns  false if not known
+  */
+  bool findBase(const uint8_t* key_prefix, uint8_t* pub_key, uint8_t* data_hash) const;
+};
+
+#ifndef PATH_WINDOW_SLOTS
+  #define PATH_WINDOW_SLOTS   4
+#endif
+
+#define PATH_BETTER_SNR_MARGIN   8   // 2 dB (in units of Packet::_snr), to prefer a path with same hop count
+
+/**
+ * \brief  A flood packet (addressed to this node), whose copies arriving by other paths are being collected for a
+ *     short window, so the best path is the one told to the sender (via a PATH return), instead of just the first.
+*/
+struct PathWindow {
+  uint8_t fingerprint[MAX_HASH_SIZE];
+  uint8_t src_hash[WIDE_HASH_SIZE];
+  uint8_t src_hash_len;
+  uint8_t secret[PUB_KEY_SIZE];
+  uint8_t best_path[MAX_PATH_SIZE];
+  uint8_t best_len;
+  int8_t best_snr;
+  bool improved;     // a better path than the first one has arrived
+  bool deferred;     // the PATH return is still to be sent (via 'reply_path'), else is to follow one already sent
+  uint8_t reply_path[MAX_PATH_SIZE];
+  uint8_t reply_len;
+  unsigned long expires;   // zero if unused
+};
+
+/*
+ * Role stages. A role that never uses one of these can build with it set to 0. The stage's hooks are then never
+ * called, and its code is dropped at link time. Forwarding of the packets concerned is unaffected.
+ */
+#ifndef MESH_GROUP_RECV
+  #define MESH_GROUP_RECV   1   // 0 = no decoding of GRP_TXT/GRP_DATA (searchChannelsByHash(), onGroupDataRecv())
+#endif
+#ifndef MESH_FRAGMENTS
+  #define MESH_FRAGMENTS    1   // 0 = no sendFragmented(), nor reassembly of fragments addressed to us (see FragmentStore)
+#endif
+
+#ifndef FRAG_MAX_COUNT
+  #define FRAG_MAX_COUNT      8      // max fragments per datagram (16 at most, see MULTIPART format)
+#endif
+#ifndef FRAG_RX_SLOTS
+  #define FRAG_RX_SLOTS       2      // datagrams that can be reassembled at once
+#endif
+#ifndef FRAG_TX_SLOTS
+  #define FRAG_TX_SLOTS       1      // datagrams that can be in flight at once
+#endif
+#define FRAG_CHUNK_SIZE       160
+#define FRAG_META_SIZE        4      // encrypted copy of xfer_id, remaining/index, type, then chunk_len
+#define FRAG_MAX_DATA_SIZE    (FRAG_MAX_COUNT*FRAG_CHUNK_SIZE)
+#define FRAG_RX_TIMEOUT_MILLIS   60000
+#define FRAG_MAX_RETRIES      4
+
+#ifndef ACK_PACK_WINDOW_MILLIS
+  #define ACK_PACK_WINDOW_MILLIS   0     // zero to disable packing of ACKs (needs updated repeaters on paths)
+#endif
+#define MAX_PACKED_ACKS          8     // max ACK CRCs in one packet
+
+#ifndef ACK_SLOT_WINDOW_FACTOR
+  #define ACK_SLOT_WINDOW_FACTOR   3.5f  // neighbours' rebroadcasts of a flood are done within this many of its airtimes
+#endif                                   // (ie. tx_delay_factor 0.5 -> up to 5*0.5 airtimes delay, plus the airtime itself)
+#ifndef ACK_SLOTS
+  #define ACK_SLOTS                4     // ACK slots after the rebroadcast window, picked by our own hash
+#endif
+
+struct FragmentRx {
+  uint8_t src_hash[PATH_HASH_SIZE];
+  uint8_t xfer_id;
+  uint8_t type;       // PAYLOAD_TYPE_* of whole datagram
+  uint8_t total;      // number of fragments
+  bool done;          // has been delivered (slot kept a while, to re-ACK any late repeats)
+  uint16_t received;  // bitmap, by fragment index
+  uint16_t len;       // total data length (known once last fragment is received)
+  uint8_t secret[PUB_KEY_SIZE];
+  unsigned long expires;   // zero if unused
+  uint8_t data[FRAG_MAX_DATA_SIZE + 1];   // (+1 so receivers can null terminate)
+};
+
+struct FragmentTx {
+  uint8_t dest_hash[PATH_HASH_SIZE];
+  uint8_t xfer_id;
+  uint8_t type;
+  uint8_t total;
+  uint8_t attempt;    // increments each resend, so packet hashes differ (else dropped as dups by repeaters)
+  uint16_t acked;     // bitmap, by fragment index
+  uint16_t len;
+  uint8_t secret[PUB_KEY_SIZE];
+  int16_t path_len;   // -1 for flood
+  uint8_t path[MAX_PATH_SIZE];
+  unsigned long timeout;   // zero if unused
+  uint8_t data[FRAG_MAX_DATA_SIZE];
+};
+
+/**
+ * \brief  buffers for Mesh::sendFragmented() and reassembly of received fragments. Only firmware that needs large
+ *     datagrams has to spend the RAM on these, see Mesh::setFragmentStore()
+*/
+class FragmentStore {
+public:
+  FragmentRx rx[FRAG_RX_SLOTS];
+  FragmentTx tx[FRAG_TX_SLOTS];
+
+  FragmentStore() { memset(this, 0, sizeof(*this)); }
+};
+
+#ifndef CODING_SENT_SLOTS
+  #define CODING_SENT_SLOTS   4      // own DIRECT datagrams remembered, for decoding CODED frames
+#endif
+#define CODING_HASH_SIZE      4      // prefix of packet hash, identifying each datagram in a CODED frame
+#ifndef CODING_HOLD_MILLIS
+  #define CODING_HOLD_MILLIS  8000     // how long a repeater keeps the datagrams of its last CODED frame, for re-sending
+#endif
+
+struct CodingSent {
+  uint8_t hash[CODING_HASH_SIZE];
+  uint8_t payload_len;    // zero if unused
+  uint8_t payload[MAX_PACKET_PAYLOAD];
+};
+
+struct CodingHeld {
+  uint8_t hash[CODING_HASH_SIZE];
+  uint8_t raw_len;        // zero if unused
+  uint8_t raw[MAX_TRANS_UNIT];   // as Packet::writeTo()
+};
+
+/**
+ * \brief  state for network coding of two-way DIRECT traffic. When a repeater has datagrams A->B and B->A to forward
+ *     at once, it can send one CODED frame with their payloads XOR'd. A and B each XOR out the one they sent, from
+ *     'sent'. If A or B no longer has it there, it asks for the plain datagram instead, from 'held' (see
+ *     Mesh::decodeCodedFrame()). Only firmware that wants to take part has to spend the RAM on these, see Mesh::setCodingStore()
+*/
+class CodingStore {
+public:
+  CodingSent sent[CODING_SENT_SLOTS];
+  uint8_t next_sent;
+  CodingHeld held[2];     // the two datagrams of the last CODED frame sent (by a repeater)
+  unsigned long held_until;
+  uint32_t n_coded, n_decoded, n_missed;
+
+  CodingStore() { memset(this, 0, sizeof(*this)); }
+};
+
+#ifndef PEER_CAPS_SLOTS
+  #define PEER_CAPS_SLOTS   32     // nodes whose capabilities are remembered (from their adverts), see PeerCapsTable
+#endif
+
+#define PEER_CAP_NET_CODING   0x01   // decodes CODED frames (ADV_CAP_NET_CODING)
+#define PEER_CAP_BUNDLE       0x02   // unpacks BUNDLE frames (ADV_CAP_BUNDLE)
+#define PEER_CAP_FRAGMENTS    0x04   // forwards, or reassembles, MULTIPART fragments (ADV_CAP_FRAGMENTS)
+
+/**
+ * \brief  the capabilities of nodes heard advertising, by full public key, so a repeater knows which next hops it may send
+ *     frames only newer firmware can unpack. A hash only counts as capable when it matches just the one known node,
+ *     so a node without the capability, but the same hash, is never sent one. When full, the oldest entry is replaced.
+*/
+class PeerCapsTable {
+  struct Entry {
+    uint8_t pub_key[PUB_KEY_SIZE];
+    uint8_t caps;         // PEER_CAP_*
+    uint32_t seq;         // when last updated, zero if unused
+  };
+  Entry _entries[PEER_CAPS_SLOTS];
+  uint32_t _seq;
+
+public:
+  PeerCapsTable() { memset(this, 0, sizeof(*this)); }
+
+  void update(const uint8_t* pub_key, uint8_t caps);
+
+  /**
+   * \returns  true, if exactly one known node matches 'hash', and it has all of 'caps'
+  */
+  bool hasCaps(const uint8_t* hash, uint8_t hash_len, uint8_t caps) const;
+
+  /**
+   * \returns  true, if every hop in the (encoded length) path passes hasCaps()
+  */
+  bool pathHasCaps(const uint8_t* path, uint8_t enc_path_len, uint8_t caps) const;
+};
+
+#ifndef MAX_HOSTED_NODES
+  #define MAX_HOSTED_NODES   2
+#endif
+
+#ifndef DEFERRED_RECV_QUEUE_SIZE
+  #define DEFERRED_RECV_QUEUE_SIZE   4    // flood packets awaiting local handling, after being queued for forwarding
+#endif
+
+/**
+ * \brief  A further logical node (own identity, own peers) on the same radio as a Mesh, eg. a room server or sensor
+ *     co-hosted with a repeater. It shares the host's Dispatcher, packet pool and MeshTables, so each packet is heard,
+ *     de-duped and forwarded just the once. Datagrams and ANON_REQs addressed to its hash are handed to it (see
+ *     Mesh::addHostedNode()), and it sends via the host, passing 'from' (eg. Mesh::createDatagram()).
+ *     NOTE: flood paths are returned straight away, not collected over Mesh::getPathCollectWindow().
+*/
+class HostedNode {
+public:
+  LocalIdentity self_id;
+  SharedSecretCache secrets;
+
+  void calcSharedSecret(uint8_t* secret, const uint8_t* other_pub_key) { secrets.calcSharedSecret(secret, self_id, other_pub_key); }
+
+  virtual int searchPeersByHash(const uint8_t* hash, uint8_t hash_len) { return 0; }
+  virtual void getPeerSharedSecret(uint8_t* dest_secret, int peer_idx) { }
+  virtual void onPeerDataRecv(Packet* packet, uint8_t type, int sender_idx, const uint8_t* secret, uint8_t* data, size_t len) { }
+
+  /**
+   * \returns  true, if path was accepted and a reciprocal path should be sent (if 'packet' came by flood)
+  */
+  virtual bool onPeerPathRecv(Packet* packet, int sender_idx, const uint8_t* secret, uint8_t* path, uint8_t path_len, uint8_t extra_type, uint8_t* extra, uint8_t extra_len) { return false; }
+  virtual void onAnonDataRecv(Packet* packet, const uint8_t* secret, const Identity& sender, uint8_t* data, size_t len) { }
+
+  /** \brief  as per Mesh::onAckRecv(). Call packet->markDoNotRetransmit() if the ACK was for this node */
+  virtual void onAckRecv(Packet* packet, uint32_t ack_crc) { }
+
+  /** \brief  called from the host's Mesh::loop() */
+  virtual void loop() { }
+};
+
 /**
  * \brief  The next layer in the basic Dispatcher task, Mesh recognises the particular Payload TYPES,
  *     and provides virtual methods for sub-classes on handling incoming, and also preparing outbound Packets.
@@ -27,17 +321,120 @@ class Mesh : public Dispatcher {
   RTCClock* _rtc;
   RNG* _rng;
   MeshTables* _tables;
-
+  SharedSecretCache _secrets;
+  CipherKeyCache _cipher_keys;
+  AdvertTimestampCache _advert_times;
+  uint8_t _self_data_hash[ADVERT_DATA_HASH_SIZE];   // of last full advert created (for self_id)
+  uint8_t _refreshes_left;
+  PathWindow _path_windows[PATH_WINDOW_SLOTS];
+  FragmentStore* _frags;
+  CodingStore* _coding;
+  PeerCapsTable* _peer_caps;
+  HostedNode* _hosted[MAX_HOSTED_NODES];
+  int _num_hosted;
+  Packet* _deferred[DEFERRED_RECV_QUEUE_SIZE];   // copies, for processDeferredRecv()
+  int _num_deferred;
+  uint32_t _n_bundled;
+
+  bool isHostedIdentity(const uint8_t* pub_key) const;
+  void handleAck(Packet* packet, uint32_t ack_crc);   // onAckRecv(), then to hosted nodes
+  bool routeFirst(Packet* pkt, DispatcherAction& action);
+  void processDeferredRecv();
+  void recvGroupData(Packet* pkt);
+  void recvAdvert(Packet* pkt);
+  bool isSeen(const Packet* packet);   // _tables->hasSeen(), for received packets (profiled)
   void removeSelfFromPath(Packet* packet);
   void routeDirectRecvAcks(Packet* packet, uint32_t delay_millis);
+  int removeSeenAcks(Packet* packet);
+  bool packIntoQueuedAck(const Packet* ack);
+  void queueDirectAck(Packet* ack, uint32_t delay_millis);
   //void routeRecvAcks(Packet* packet, uint32_t delay_millis);
   DispatcherAction forwardMultipartDirect(Packet* pkt);
+  void suppressQueuedFlood(const Packet* pkt);
+  void recordCodingSent(const Packet* pkt);
+  bool codeWithQueued(Packet* pkt);
+  void decodeCodedFrame(const Packet* pkt);
+  void resendCodingHeld(const uint8_t* hash);
+  Packet* bundleWithQueued(Packet* pkt);
+  void unpackBundle(const Packet* pkt);
+  int encryptPayload(Packet* packet, int offset, const uint8_t* secret, const uint8_t* data, int data_len);
+  int encryptPayload(Packet* packet, int offset, const uint8_t* secret, const uint8_t* data, int data_len, uint8_t ver);
+  int decryptPayload(const Packet* packet, const uint8_t* secret, uint8_t* dest, const uint8_t* src, int src_len);
+  bool openPathWindow(const Packet* pkt, const uint8_t* src_hash, const uint8_t* secret, const uint8_t* reply_path, int reply_len);
+  void recordAltPath(const Packet* pkt);
+  void closePathWindows();
+  Packet* createFragment(FragmentTx* tx, int index);
+  void sendFragment(FragmentTx* tx, int index, uint32_t delay_millis);
+  void sendFragmentAck(const Packet* frag, int sender_idx, FragmentRx* rx);
+  DispatcherAction onFragmentRecv(Packet* pkt);
+  DispatcherAction onFragmentAckRecv(Packet* pkt);
+  DispatcherAction handleAdvertRefresh(Packet* pkt);
+  void checkFragmentTimers();
+  uint32_t calcFragmentAckTimeout(const FragmentTx* tx, int num_sent) const;
+  bool hasFragments() const { return MESH_FRAGMENTS && _frags != NULL; }
 
 protected:
   DispatcherAction onRecvPacket(Packet* pkt) override;
+  Packet* prepareOutbound(Packet* pkt) override;
 
   virtual uint32_t getCADFailRetryDelay() const override;
 
+  /**
+   * \returns  the PAYLOAD_VER_* to use for created datagrams (REQ, RESPONSE, TXT_MSG, PATH, ANON_REQ, GRP_*).
+   *      PAYLOAD_VER_2 packets are smaller (no padding), but are dropped by older firmware (incl. repeaters).
+   */
+  virtual uint8_t getDatagramPayloadVer() const { return PAYLOAD_VER_1; }
+
+  /**
+   * \returns  true, if datagrams to 'dest' are to be PAYLOAD_VER_3, with 2-byte dest/src hashes, so far fewer of its
+   *      peers match the src hash, and are tried for decrypting (eg. it advertised ADV_CAP_WIDE_HASH). As for
+   *      PAYLOAD_VER_2, these are dropped by older firmware.
+   */
+  virtual bool isWideHashPeer(const Identity& dest) { return false; }
+
+  /**
+   * \returns  size of the hash each repeater appends to the path of flood packets sent by this node. With WIDE_HASH_SIZE,
+   *      far fewer repeaters match each hop of the direct routes learned from these (so, fewer duplicate forwards), but
+   *      repeaters with older firmware drop them (see PLF_WIDE_PATH). Only applies to PAYLOAD_VER_2+ packets, as in the
+   *      older framing an empty wide path can't be told from a full 64 byte one.
+   */
+  virtual uint8_t getFloodPathHashSize() const { return PATH_HASH_SIZE; }
+
+  /**
+   * \returns  how many 'refresh' adverts (key prefix, timestamp, and signature over the last full advert's app_data
+   *      hash) createSelfAdvertPacket() may send between full adverts, while the app_data is unchanged. Zero for always
+   *      full. Refresh adverts are PAYLOAD_VER_2, so are dropped by older firmware (incl. repeaters).
+   */
+  virtual uint8_t getAdvertRefreshCount() const { return 0; }
+
+  /**
+   * \returns  milliseconds to keep collecting the paths of copies of a flood REQ, TXT_MSG or PATH (addressed to this node)
+   *      before the best is returned to the sender. For PATH, the reciprocal return is delayed until then. For REQ/TXT_MSG,
+   *      the immediate reply (using the first path) is followed by an extra PATH return, if a better path arrived.
+   *      (zero to disable, ie. 'first packet wins')
+   */
+  virtual uint32_t getPathCollectWindow() const { return 2000; }
+
+  /**
+   * \brief  A datagram sent with sendFragmented() has been fully reassembled by the recipient (or, the retries
+   *     have been exhausted).
+   */
+  virtual void onFragmentedSendDone(uint8_t xfer_id, bool delivered) { }
+
+  /**
+   * \brief  A datagram which was sent in fragments has been fully received.
+   *     Default impl passes it on to onPeerDataRecv(), but only if no bigger than a regular packet, as older handlers
+   *     assume that limit. Override to accept larger (up to FRAG_MAX_DATA_SIZE).
+   */
+  virtual void onPeerFragmentedDataRecv(Packet* packet, uint8_t type, int sender_idx, const uint8_t* secret, uint8_t* data, size_t len);
+
+  /**
+   * \brief  Send the given fragment ACK back to the sender of 'frag'.
+   *     Default impl sends DIRECT along the reverse of the path if 'frag' was flood routed, otherwise sends by flood.
+   *     Sub-classes which know a path to the sender (by 'sender_idx') should override.
+   */
+  virtual void routeFragmentAck(Packet* ack, const Packet* frag, int sender_idx);
+
   /**
    * \brief  Decide what to do with received packet, ie. discard, forward, or hold
    */
@@ -55,6 +452,18 @@ protected:
    */
   virtual bool allowPacketForward(const Packet* packet);
 
+  /**
+   * \returns  max number of hops a flood packet can have already taken, for this node to still forward it.
+   */
+  virtual uint8_t getFloodHopLimit(const Packet* packet) { return MAX_PATH_SIZE / PATH_HASH_SIZE; }
+
+  /**
+   * \brief  cut-through forwarding. If true, a flood packet whose forwarding doesn't depend on this node decoding it
+   *     (group datagrams, and adverts once verified) is queued for retransmit first, and the local decrypt and app
+   *     callbacks (onGroupDataRecv(), onAdvertRecv()) run on a later loop(), so they don't add to the per-hop delay.
+   */
+  virtual bool allowCutThrough(const Packet* packet) const { return false; }
+
   /**
    * \returns  number of milliseconds delay to apply to retransmitting the given packet.
    */
@@ -70,12 +479,64 @@ protected:
    */
   virtual uint8_t getExtraAckTransmitCount() const;
 
+  /**
+   * \returns  milliseconds after the end of the flood packet 'received' that neighbouring repeaters are expected to have
+   *      finished rebroadcasting it. (zero for DIRECT, which ends with us)
+   */
+  virtual uint32_t getRebroadcastWindow(const Packet* received);
+
+  /**
+   * \returns  milliseconds delay for sending an ACK (or PATH return carrying one) in reply to 'received', at least
+   *      'min_delay'. For a flood, this is a slot after getRebroadcastWindow(), so the ACK doesn't collide with the
+   *      rebroadcasts of the very message it acknowledges. Slots are one (return path length) ACK airtime wide, and
+   *      which one is fixed by our own hash, so nodes ACKing the same flood (eg. group of sensors) are spread out.
+   */
+  uint32_t getAckDelay(const Packet* received, uint32_t min_delay);
+
+  /**
+   * \returns  milliseconds to hold an outbound DIRECT ACK in the send queue, so that other ACKs for the same path can
+   *      be packed into the same packet. (zero to disable)
+   *      NOTE: older firmware only sees the first CRC of a packed ACK, so only enable once repeaters are updated.
+   */
+  virtual uint32_t getAckPackWindow() const { return ACK_PACK_WINDOW_MILLIS; }
+
+  /**
+   * \returns  number of times a flood packet, queued for retransmit, must be heard from neighbours before our
+   *      retransmit is cancelled. (zero to disable)
+   */
+  virtual uint8_t getFloodSuppressCount() const { return 0; }
+
+  /**
+   * \brief  as above, but for a specific queued packet (eg. fewer, for one received at high SNR from a close neighbour,
+   *      whose coverage mostly overlaps this node's). Defaults to getFloodSuppressCount()
+   */
+  virtual uint8_t getFloodSuppressCount(const Packet* queued) const { return getFloodSuppressCount(); }
+
+  /**
+   * \returns  true, if a DIRECT datagram being forwarded can be sent in a CODED frame, with one queued going the other
+   *      way (see CodingStore). Both senders must have advertised ADV_CAP_NET_CODING.
+   */
+  virtual bool allowCodedForward() const { return false; }
+
+  /**
+   * \returns  millis ahead of now, in which DIRECT packets queued for the same next hop are sent along with the one
+   *      now due, packed into one BUNDLE frame (so paying the preamble and header airtime once). The next hop must have
+   *      advertised ADV_CAP_BUNDLE, and be unambiguous (see setPeerCaps()). Zero to disable.
+   */
+  virtual uint32_t getBundleWindowMillis() const { return 0; }
+
   /**
    * \brief  Perform search of local DB of peers/contacts.
    * \returns  Number of peers with matching hash
    */
   virtual int searchPeersByHash(const uint8_t* hash);
 
+  /**
+   * \brief  as above, but 'hash' is 'hash_len' bytes (ie. WIDE_HASH_SIZE, from a PAYLOAD_VER_3 datagram).
+   *      Default impl. just matches the first byte.
+   */
+  virtual int searchPeersByHash(const uint8_t* hash, uint8_t hash_len) { return searchPeersByHash(hash); }
+
   /**
    * \brief  lookup the ECDH shared-secret between this node and peer by idx (calculate if necessary)
    * \param  dest_secret  destination array to copy the secret (must be PUB_KEY_SIZE bytes)
@@ -110,16 +571,30 @@ protected:
    *         NOTE: these can be received multiple times (per sender), via differen routes
    * \param  sender_idx  index of peer, [0..n) where n is what searchPeersByHash() returned
    * \param  secret   the pre-calculated shared-secret (handy for sending response packet)
+   * \param  path_len   encoded path length (see Packet::getEncodedPathLen()), as is to be passed to sendDirect()
    * \returns   true, if path was accepted and that reciprocal path should be sent
   */
   virtual bool onPeerPathRecv(Packet* packet, int sender_idx, const uint8_t* secret, uint8_t* path, uint8_t path_len, uint8_t extra_type, uint8_t* extra, uint8_t extra_len) { return false; }
 
+  /**
+   * \brief  Called before an advert's signature is checked.
+   * \returns  true, if this advert is known to be a replay (ie. not newer than what was last accepted from 'id'),
+   *        in which case it is dropped without verifying.
+  */
+  virtual bool isAdvertStale(const Identity& id, uint32_t timestamp) { return false; }
+
   /**
    * \brief  A new incoming Advertisement has been received.
    *         NOTE: these can be received multiple times (per id/timestamp), via different routes
   */
   virtual void onAdvertRecv(Packet* packet, const Identity& id, uint32_t timestamp, const uint8_t* app_data, size_t app_data_len) { }
 
+  /**
+   * \brief  A 'refresh' advert has been received, ie. 'id' is still around, with the same app_data as its last full
+   *         advert (which was passed to onAdvertRecv()), but at a new timestamp.
+  */
+  virtual void onAdvertRefreshRecv(Packet* packet, const Identity& id, uint32_t timestamp) { }
+
   /**
    * \brief  A (now decrypted) data packet has been received.
    *         NOTE: these can be received multiple times (per sender/contents), via different routes
@@ -160,35 +635,115 @@ protected:
   virtual void onGroupDataRecv(Packet* packet, uint8_t type, const GroupChannel& channel, uint8_t* data, size_t len) { }
 
   /**
-   * \brief  A simple ACK packet has been received.
+   * \brief  A simple ACK packet has been received. (called once for each CRC of a packed ACK)
    *         NOTE: same ACK can be received multiple times, via different routes
   */
   virtual void onAckRecv(Packet* packet, uint32_t ack_crc) { }
 
   Mesh(Radio& radio, MillisecondClock& ms, RNG& rng, RTCClock& rtc, PacketManager& mgr, MeshTables& tables)
-    : Dispatcher(radio, ms, mgr), _rng(&rng), _rtc(&rtc), _tables(&tables)
+    : Dispatcher(radio, ms, mgr), _rtc(&rtc), _rng(&rng), _tables(&tables)
   {
+    memset(_path_windows, 0, sizeof(_path_windows));
+    _frags = NULL;
+    _coding = NULL;
+    _peer_caps = NULL;
+    _num_hosted = 0;
+    _num_deferred = 0;
+    _n_bundled = 0;
+    memset(_self_data_hash, 0, sizeof(_self_data_hash));
+    _refreshes_left = 0;
   }
 
   MeshTables* getTables() const { return _tables; }
 
+  /**
+   * \brief  copies the hashes of 'path' to 'dest', in reverse order
+   * \param  path_len   encoded path length (see Packet::getEncodedPathLen())
+  */
+  static void reversePath(uint8_t* dest, const uint8_t* path, uint8_t path_len);
+
 public:
   void begin();
   void loop();
+  uint32_t getMillisToNextWakeup(uint32_t max_millis) override;
 
   LocalIdentity self_id;
 
+  /**
+   * \brief  calculates the ECDH shared secret between self_id and 'other_pub_key' (cached for recent peers)
+  */
+  void calcSharedSecret(uint8_t* secret, const uint8_t* other_pub_key) { _secrets.calcSharedSecret(secret, self_id, other_pub_key); }
+
+  /**
+   * \brief  enables sending/receiving of datagrams too big for one packet (see sendFragmented())
+  */
+  void setFragmentStore(FragmentStore* store) { _frags = store; }
+  bool hasFragmentStore() const { return _frags != NULL; }
+
+  /**
+   * \brief  enables decoding of CODED frames (and sending them, see allowCodedForward())
+  */
+  void setCodingStore(CodingStore* store) { _coding = store; }
+  CodingStore* getCodingStore() const { return _coding; }
+
+  /**
+   * \brief  sets where the capabilities of next hops are looked up (needed for sending CODED and BUNDLE frames)
+  */
+  void setPeerCaps(PeerCapsTable* caps) { _peer_caps = caps; }
+
+  uint32_t getNumBundled() const { return _n_bundled; }   // BUNDLE frames sent
+
+  /**
+   * \brief  co-hosts another logical node on this radio (see HostedNode)
+   * \returns  false if already MAX_HOSTED_NODES
+  */
+  bool addHostedNode(HostedNode* node);
+
+  /**
+   * \brief  sends a datagram (REQ, RESPONSE or TXT_MSG) of up to FRAG_MAX_DATA_SIZE in MULTIPART fragments. The recipient
+   *      replies with one selective ACK, at end, and only the missing fragments are re-sent.
+   *      NOTE: older repeaters drop MULTIPART packets (other than ACKs), whether flood or direct, and older recipients
+   *      can't reassemble them. So only send to a dest, and by a path, known to have ADV_CAP_FRAGMENTS (see PeerCapsTable)
+   * \param  path  the path to send DIRECT by, or NULL to send by flood
+   * \returns  transfer id (see onFragmentedSendDone()), or -1 if failed (eg. no free slot)
+  */
+  int sendFragmented(uint8_t type, const Identity& dest, const uint8_t* secret, const uint8_t* data, size_t len, const uint8_t* path, int path_len);
+
   RNG* getRNG() const { return _rng; }
   RTCClock* getRTCClock() const { return _rtc; }
 
   Packet* createAdvert(const LocalIdentity& id, const uint8_t* app_data=NULL, size_t app_data_len=0);
-  Packet* createDatagram(uint8_t type, const Identity& dest, const uint8_t* secret, const uint8_t* data, size_t len);
+
+  /**
+   * \brief  creates an advert for self_id: a short 'refresh' advert if app_data is unchanged since the last full one
+   *      (and getAdvertRefreshCount() allows), otherwise a full advert. (NOT for sharing, use createAdvert() for that)
+  */
+  Packet* createSelfAdvertPacket(const uint8_t* app_data, size_t app_data_len);
+  /**
+   * \param  from  sender, if not self_id (ie. a HostedNode's)
+  */
+  Packet* createDatagram(uint8_t type, const Identity& dest, const uint8_t* secret, const uint8_t* data, size_t len, const LocalIdentity* from=NULL);
+
+  /**
+   * \brief  for composing a datagram's plaintext directly in the packet, instead of in a temp buffer on the stack.
+   *      Fills in the header and src/dest hashes, then call finishDatagram() to encrypt the plaintext in place.
+   * \param  plain  OUT: where to write the plaintext
+   * \param  max_len  OUT: room (bytes) at 'plain'
+   * \returns  NULL if invalid type, or packet pool empty
+  */
+  Packet* beginDatagram(uint8_t type, const Identity& dest, uint8_t*& plain, int& max_len, const LocalIdentity* from=NULL);
+
+  /**
+   * \brief  encrypts the plaintext of a packet from beginDatagram(), or from 'data' if elsewhere
+   * \returns  NULL (and packet released) if 'data_len' too big
+  */
+  Packet* finishDatagram(Packet* packet, const uint8_t* secret, const uint8_t* data, size_t data_len);
   Packet* createAnonDatagram(uint8_t type, const LocalIdentity& sender, const Identity& dest, const uint8_t* secret, const uint8_t* data, size_t data_len);
   Packet* createGroupDatagram(uint8_t type, const GroupChannel& channel, const uint8_t* data, size_t data_len);
   Packet* createAck(uint32_t ack_crc);
   Packet* createMultiAck(uint32_t ack_crc, uint8_t remaining);
-  Packet* createPathReturn(const uint8_t* dest_hash, const uint8_t* secret, const uint8_t* path, uint8_t path_len, uint8_t extra_type, const uint8_t*extra, size_t extra_len);
-  Packet* createPathReturn(const Identity& dest, const uint8_t* secret, const uint8_t* path, uint8_t path_len, uint8_t extra_type, const uint8_t*extra, size_t extra_len);
+  Packet* createPathReturn(const uint8_t* dest_hash, const uint8_t* secret, const uint8_t* path, uint8_t path_len, uint8_t extra_type, const uint8_t*extra, size_t extra_len, uint8_t dest_hash_len=PATH_HASH_SIZE, const LocalIdentity* from=NULL);
+  Packet* createPathReturn(const Identity& dest, const uint8_t* secret, const uint8_t* path, uint8_t path_len, uint8_t extra_type, const uint8_t*extra, size_t extra_len, const LocalIdentity* from=NULL);
   Packet* createRawData(const uint8_t* data, size_t len);
   Packet* createTrace(uint32_t tag, uint32_t auth_code, uint8_t flags = 0);
   Packet* createControlData(const uint8_t* data, size_t len);
@@ -206,13 +761,15 @@ public:
 
   /**
    * \brief  send a locally-generated Packet with Direct routing
+   * \param path_len   encoded path length, ie. with PLF_WIDE_PATH flag if path has wide hashes (see Packet::getEncodedPathLen())
   */
   void sendDirect(Packet* packet, const uint8_t* path, uint8_t path_len, uint32_t delay_millis=0);
 
   /**
    * \brief  send a locally-generated Packet to just neigbor nodes (zero hops)
+   * \param priority  QOS_* class, eg. QOS_BULK for background transfers
   */
-  void sendZeroHop(Packet* packet, uint32_t delay_millis=0);
+  void sendZeroHop(Packet* packet, uint32_t delay_millis=0, uint8_t priority=QOS_CONTROL);
 
   /**
    * \brief  send a locally-generated Packet to just neigbor nodes (zero hops), with specific transort codes
@@ -15,6 +15,9 @@
 #define CIPHER_MAC_SIZE      2
 #define PATH_HASH_SIZE       1
 
+// V2
+#define CIPHER_MAC_V2_SIZE   4
+
 #define MAX_PACKET_PAYLOAD  184
 #define MAX_PATH_SIZE        64
 #define MAX_TRANS_UNIT      255
@@ -39,6 +42,9 @@ namespace mesh {
 #define  BD_STARTUP_NORMAL     0  // getStartupReason() codes
 #define  BD_STARTUP_RX_PACKET  1
 
+#define  FW_IMAGE_RUNNING      0  // readFirmwareImage() sources
+#define  FW_IMAGE_STAGED       1
+
 class MainBoard {
 public:
   virtual uint16_t getBattMilliVolts() = 0;
@@ -49,10 +55,34 @@ public:
   virtual void onAfterTransmit() { }
   virtual void reboot() = 0;
   virtual void powerOff() { /* no op */ }
+
+  /**
+   * \brief  idle the CPU (eg. light sleep) for up to 'max_millis', waking early on radio IRQ.
+   *      Default is to return immediately (ie. busy polling).
+  */
+  virtual void idle(uint32_t max_millis) { }
+
+  /**
+   * \brief  deep sleep, with the radio left in Rx, until a packet is received or 'secs' (if non-zero) have passed.
+   *      Wakes up as a restart, with getStartupReason() == BD_STARTUP_RX_PACKET if woken by a packet. Only RTC/retained
+   *      memory survives, so caller must stash any state it needs first.
+   * \returns  false if not supported (otherwise doesn't return)
+  */
+  virtual bool enterRxSleep(uint32_t secs) { return false; }
   virtual uint32_t getGpio() { return 0; }
   virtual void setGpio(uint32_t values) {}
   virtual uint8_t getStartupReason() const = 0;
   virtual bool startOTAUpdate(const char* id, char reply[]) { return false; }   // not supported
+
+  /**
+   * \brief  (mesh firmware distribution) access to the firmware image slots. Default is not supported.
+   * \returns  max size of an image which can be staged, or zero if not supported
+  */
+  virtual uint32_t getFirmwareImageMax() { return 0; }
+  virtual bool readFirmwareImage(uint8_t which, uint32_t offset, uint8_t* dest, int len) { return false; }  // FW_IMAGE_*
+  virtual bool beginFirmwareImage(uint32_t size) { return false; }   // prepare (erase) the staging slot
+  virtual bool writeFirmwareImage(uint32_t offset, const uint8_t* src, int len) { return false; }   // in any order
+  virtual bool applyFirmwareImage() { return false; }   // staged image is to boot on next reboot()
 };
 
 /**
@@ -7,11 +7,19 @@ namespace mesh {
 Packet::Packet() {
   header = 0;
   path_len = 0;
+  path_hash_size = PATH_HASH_SIZE;
   payload_len = 0;
+  _heard = 0;
+  _tx_channel = 0;
+}
+
+int Packet::getTransportCodesLength() const {
+  if (!hasTransportCodes()) return 0;
+  return (hasCompactFraming() && transport_codes[1] == 0) ? 2 : 4;
 }
 
 int Packet::getRawLength() const {
-  return 2 + path_len + payload_len + (hasTransportCodes() ? 4 : 0);
+  return 2 + path_len + payload_len + getTransportCodesLength();
 }
 
 void Packet::calculatePacketHash(uint8_t* hash) const {
@@ -25,32 +33,100 @@ void Packet::calculatePacketHash(uint8_t* hash) const {
   sha.finalize(hash, MAX_HASH_SIZE);
 }
 
+bool Packet::isSameContent(const Packet* other) const {
+  uint8_t t = getPayloadType();
+  if (t != other->getPayloadType() || payload_len != other->payload_len) return false;
+  if (t == PAYLOAD_TYPE_TRACE && path_len != other->path_len) return false;
+  return memcmp(payload, other->payload, payload_len) == 0;
+}
+
+#define FNV64_OFFSET  0xCBF29CE484222325ULL
+#define FNV64_PRIME   0x00000100000001B3ULL
+
+static inline uint64_t fnv1a(uint64_t h, const uint8_t* data, int len) {
+  for (int i = 0; i < len; i++) {
+    h ^= data[i];
+    h *= FNV64_PRIME;
+  }
+  return h;
+}
+
+void Packet::calculateFingerprint(uint8_t* dest) const {
+  uint8_t t = getPayloadType();
+  uint64_t h = fnv1a(FNV64_OFFSET, &t, 1);
+  if (t == PAYLOAD_TYPE_TRACE) {
+    h = fnv1a(h, (const uint8_t *) &path_len, sizeof(path_len));   // same CAVEAT as calculatePacketHash()
+  }
+  h = fnv1a(h, payload, payload_len);
+
+  // final avalanche (from MurmurHash3), so all output bits depend on all input bits
+  h ^= h >> 33;  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  memcpy(dest, &h, MAX_HASH_SIZE);
+}
+
 uint8_t Packet::writeTo(uint8_t dest[]) const {
   uint8_t i = 0;
   dest[i++] = header;
-  if (hasTransportCodes()) {
-    memcpy(&dest[i], &transport_codes[0], 2); i += 2;
-    memcpy(&dest[i], &transport_codes[1], 2); i += 2;
+  if (hasCompactFraming()) {   // path_len (with flags) comes before transport codes
+    uint8_t len_flags = path_len | (path_hash_size == WIDE_HASH_SIZE ? PLF_WIDE_PATH : 0);   // (can be empty wide)
+    if (getTransportCodesLength() == 2) len_flags |= PLF_NO_TRANSPORT_CODE2;
+    dest[i++] = len_flags;
+    if (hasTransportCodes()) {
+      memcpy(&dest[i], &transport_codes[0], 2); i += 2;
+      if ((len_flags & PLF_NO_TRANSPORT_CODE2) == 0) {
+        memcpy(&dest[i], &transport_codes[1], 2); i += 2;
+      }
+    }
+  } else {
+    if (hasTransportCodes()) {
+      memcpy(&dest[i], &transport_codes[0], 2); i += 2;
+      memcpy(&dest[i], &transport_codes[1], 2); i += 2;
+    }
+    dest[i++] = getEncodedPathLen();   // (as older firmware, 64 bytes is a bare 0x40, so empty is never wide)
   }
-  dest[i++] = path_len;
   memcpy(&dest[i], path, path_len); i += path_len;
   memcpy(&dest[i], payload, payload_len); i += payload_len;
   return i;
 }
 
-bool Packet::readFrom(const uint8_t src[], uint8_t len) {
-  uint8_t i = 0;
+int Packet::readHeader(const uint8_t src[], int len) {
+  int i = 0;
+  if (len < 2) return -1;
   header = src[i++];
-  if (hasTransportCodes()) {
-    memcpy(&transport_codes[0], &src[i], 2); i += 2;
-    memcpy(&transport_codes[1], &src[i], 2); i += 2;
+  transport_codes[0] = transport_codes[1] = 0;
+  if (hasCompactFraming()) {
+    uint8_t len_flags = src[i++];
+    path_len = len_flags & PLF_LEN_MASK;   // NOT decodePathBytes(), a bare PLF_WIDE_PATH is an empty wide path here
+    path_hash_size = (len_flags & PLF_WIDE_PATH) ? WIDE_HASH_SIZE : PATH_HASH_SIZE;
+    if (hasTransportCodes()) {
+      int n = (len_flags & PLF_NO_TRANSPORT_CODE2) ? 2 : 4;
+      if (i + n > len) return -1;
+      memcpy(&transport_codes[0], &src[i], 2); i += 2;
+      if (n == 4) {
+        memcpy(&transport_codes[1], &src[i], 2); i += 2;
+      }
+    }
   } else {
-    transport_codes[0] = transport_codes[1] = 0;
+    if (hasTransportCodes()) {
+      if (i + 5 > len) return -1;
+      memcpy(&transport_codes[0], &src[i], 2); i += 2;
+      memcpy(&transport_codes[1], &src[i], 2); i += 2;
+    }
+    uint8_t len_flags = src[i++];
+    if (len_flags & ~(PLF_WIDE_PATH | PLF_LEN_MASK)) return -1;   // bad encoding
+    path_len = decodePathBytes(len_flags);
+    path_hash_size = decodePathHashSize(len_flags);
   }
-  path_len = src[i++];
-  if (path_len > sizeof(path)) return false;   // bad encoding
+  if (path_len > sizeof(path) || i + path_len > len) return -1;   // bad encoding
   memcpy(path, &src[i], path_len); i += path_len;
-  if (i >= len) return false;   // bad encoding
+  return i;
+}
+
+bool Packet::readFrom(const uint8_t src[], uint8_t len) {
+  int i = readHeader(src, len);
+  if (i < 0 || i >= len) return false;   // bad encoding
   payload_len = len - i;
   if (payload_len > sizeof(payload)) return false;  // bad encoding
   memcpy(payload, &src[i], payload_len); //i += payload_len;
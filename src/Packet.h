@@ -28,14 +28,23 @@ namespace mesh {
 #define PAYLOAD_TYPE_TRACE       0x09    // trace a path, collecting SNI for each hop
 #define PAYLOAD_TYPE_MULTIPART   0x0A    // packet is one of a set of packets
 #define PAYLOAD_TYPE_CONTROL     0x0B    // a control/discovery packet
+#define PAYLOAD_TYPE_CODED       0x0C    // two DIRECT datagrams going opposite ways, payloads XOR'd (zero-hop, from a repeater)
+#define PAYLOAD_TYPE_BUNDLE      0x0D    // several DIRECT packets for the same next hop, packed into one frame (path is the next hop)
 //...
 #define PAYLOAD_TYPE_RAW_CUSTOM   0x0F    // custom packet as raw bytes, for applications with custom encryption, payloads, etc
 
 #define PAYLOAD_VER_1       0x00   // 1-byte src/dest hashes, 2-byte MAC
-#define PAYLOAD_VER_2       0x01   // FUTURE (eg. 2-byte hashes, 4-byte MAC ??)
-#define PAYLOAD_VER_3       0x02   // FUTURE
+#define PAYLOAD_VER_2       0x01   // 1-byte src/dest hashes, 4-byte MAC, AES-CTR (no padding)
+#define PAYLOAD_VER_3       0x02   // 2-byte src/dest hashes, 4-byte MAC, AES-CTR (no padding). Only datagrams (REQ, RESPONSE, TXT_MSG, PATH)
 #define PAYLOAD_VER_4       0x03   // FUTURE
 
+// PAYLOAD_VER_2 (and later) framing: path_len byte comes before transport codes, with flags in its upper bits
+#define PLF_NO_TRANSPORT_CODE2   0x80   // transport_codes[1] is zero, so is omitted (PAYLOAD_VER_2+ only)
+#define PLF_WIDE_PATH            0x40   // path hashes are WIDE_HASH_SIZE bytes each (all versions)
+#define PLF_LEN_MASK             0x3F   // so, max encodable path is 63 bytes (but see decodePathBytes())
+
+#define WIDE_HASH_SIZE      2      // src/dest hashes of PAYLOAD_VER_3 datagrams
+
 /**
  * \brief  The fundamental transmission unit.
 */
@@ -47,8 +56,11 @@ public:
   uint16_t payload_len, path_len;
   uint16_t transport_codes[2];
   uint8_t path[MAX_PATH_SIZE];
-  uint8_t payload[MAX_PACKET_PAYLOAD];
+  uint8_t path_hash_size;   // bytes per hop in path[], PATH_HASH_SIZE or WIDE_HASH_SIZE (see PLF_WIDE_PATH)
   int8_t _snr;
+  uint8_t _heard;   // number of times heard from neighbours, while queued for retransmit
+  uint8_t _tx_channel;   // (local only) 1 + home channel of nodes to send to (see Dispatcher::getExtraTxChannels()), or zero
+  uint8_t payload[MAX_PACKET_PAYLOAD];   // NOTE: must be last, queued Packets may be held truncated (see PacketSlab)
 
   /**
    * \brief calculate the hash of payload + type
@@ -56,6 +68,13 @@ public:
    */
   void calculatePacketHash(uint8_t* dest_hash) const;
 
+  /**
+   * \brief  calculate a fast (non-cryptographic) 64-bit fingerprint of the same fields as calculatePacketHash().
+   *     Is for local duplicate detection only, use calculatePacketHash() where the hash needs to be shared/compared with other nodes.
+   * \param  dest   destination to store the fingerprint (must be MAX_HASH_SIZE bytes)
+   */
+  void calculateFingerprint(uint8_t* dest) const;
+
   /**
    * \returns  one of ROUTE_ values
    */
@@ -66,6 +85,16 @@ public:
 
   bool hasTransportCodes() const { return getRouteType() == ROUTE_TYPE_TRANSPORT_FLOOD || getRouteType() == ROUTE_TYPE_TRANSPORT_DIRECT; }
 
+  /**
+   * \returns  true if wire format has the compact framing (flags in path_len byte, see PLF_*)
+   */
+  bool hasCompactFraming() const { return getPayloadVer() >= PAYLOAD_VER_2; }
+
+  /**
+   * \returns  number of bytes the transport codes take in the wire format
+   */
+  int getTransportCodesLength() const;
+
   /**
    * \returns  one of PAYLOAD_TYPE_ values
    */
@@ -76,11 +105,47 @@ public:
    */
   uint8_t getPayloadVer() const { return (header >> PH_VER_SHIFT) & PH_VER_MASK; }
 
+  /**
+   * \returns  size of each of the dest/src hashes which prefix datagram payloads (REQ, RESPONSE, TXT_MSG, PATH)
+   */
+  uint8_t getDatagramHashSize() const { return getPayloadVer() == PAYLOAD_VER_3 ? WIDE_HASH_SIZE : PATH_HASH_SIZE; }
+
+  /**
+   * \returns  path_len, with the PLF_WIDE_PATH flag if path hashes are wide. This is the form of path length which
+   *     is passed between Mesh and the application layer (eg. sendDirect(), createPathReturn(), onPeerPathRecv())
+   */
+  uint8_t getEncodedPathLen() const { return path_len > 0 && path_hash_size == WIDE_HASH_SIZE ? path_len | PLF_WIDE_PATH : path_len; }
+
+  /**
+   * \returns  number of bytes in path, given an encoded path length (see getEncodedPathLen())
+   *     NOTE: a bare PLF_WIDE_PATH is a 64 byte path of PATH_HASH_SIZE hashes, as older firmware encoded it
+   *     (an empty path is always just zero)
+   */
+  static uint8_t decodePathBytes(uint8_t enc_len) { return enc_len == PLF_WIDE_PATH ? MAX_PATH_SIZE : enc_len & PLF_LEN_MASK; }
+
+  /**
+   * \returns  size of each hop's hash, given an encoded path length (see getEncodedPathLen())
+   */
+  static uint8_t decodePathHashSize(uint8_t enc_len) {
+    return (enc_len & PLF_WIDE_PATH) && enc_len != PLF_WIDE_PATH ? WIDE_HASH_SIZE : PATH_HASH_SIZE;
+  }
+
+  /**
+   * \returns  number of hops, given an encoded path length (see getEncodedPathLen())
+   */
+  static uint8_t decodePathHops(uint8_t enc_len) { return decodePathBytes(enc_len) / decodePathHashSize(enc_len); }
+
   void markDoNotRetransmit() { header = 0xFF; }
   bool isMarkedDoNotRetransmit() const { return header == 0xFF; }
 
   float getSNR() const { return ((float)_snr) / 4.0f; }
 
+  /**
+   * \returns  true if 'other' is a copy of this packet (ie. same type and payload, path may differ)
+   *     NOTE: this is equivalent to comparing calculatePacketHash(), but without the SHA256 cost
+   */
+  bool isSameContent(const Packet* other) const;
+
   /**
    * \returns  the encoded/wire format length of this packet
    */
@@ -99,6 +164,12 @@ public:
    * \param  len  the packet length (as returned by writeTo())
    */
   bool readFrom(const uint8_t src[], uint8_t len);
+
+  /**
+   * \brief  decodes just the header, transport codes and path, of the wire format
+   * \returns  offset of payload in 'src', or -1 if bad encoding
+   */
+  int readHeader(const uint8_t src[], int len);
 };
 
 }
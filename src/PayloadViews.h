@@ -0,0 +1,145 @@
+#pragma once
+
+#include <Packet.h>
+#include <string.h>
+
+namespace mesh {
+
+/**
+ * \brief  Zero-copy views over wire payloads (and decrypted datagram contents). Each view's layout is a set of
+ *     constexpr field offsets. init() validates the length once, up front (false if too short), and the accessors then
+ *     read straight out of the buffer with no further checks. Multi-byte fields are little-endian, read by memcpy()
+ *     (safe for unaligned fields, and compiles to a plain load).
+ *  NOTE: a view is only valid while the buffer it was given is unchanged.
+*/
+class PayloadView {
+protected:
+  const uint8_t* _p;
+  int _len;
+
+  bool bind(const uint8_t* p, int len, int min_len) { _p = p; _len = len; return len >= min_len; }
+  uint32_t u32(int off) const { uint32_t v; memcpy(&v, &_p[off], 4); return v; }
+  uint16_t u16(int off) const { uint16_t v; memcpy(&v, &_p[off], 2); return v; }
+
+public:
+  PayloadView() : _p(NULL), _len(0) { }
+  int length() const { return _len; }
+};
+
+/** \brief  ACK: ack_crc(4) */
+class AckView : public PayloadView {
+public:
+  static constexpr int CRC = 0, MIN_LEN = 4;
+
+  bool init(const Packet* pkt) { return bind(pkt->payload, pkt->payload_len, MIN_LEN); }
+  uint32_t crc() const { return u32(CRC); }
+};
+
+/** \brief  TRACE: tag(4), auth_code(4), flags(1), path hashes (1 << (flags & 3) bytes each) */
+class TraceView : public PayloadView {
+public:
+  static constexpr int TAG = 0, AUTH_CODE = 4, FLAGS = 8, HASHES = 9, MIN_LEN = 9;
+
+  bool init(const Packet* pkt) { return bind(pkt->payload, pkt->payload_len, MIN_LEN); }
+  uint32_t tag() const { return u32(TAG); }
+  uint32_t authCode() const { return u32(AUTH_CODE); }
+  uint8_t flags() const { return _p[FLAGS]; }
+  uint8_t hashSizeBits() const { return _p[FLAGS] & 0x03; }   // NEW v1.11+: lower 2 bits is path hash size
+  const uint8_t* hashes() const { return &_p[HASHES]; }
+  int hashesLen() const { return _len - HASHES; }
+};
+
+/** \brief  PATH, REQ, RESPONSE, TXT_MSG: dest_hash, src_hash (getDatagramHashSize() bytes each), MAC + ciphertext */
+class DatagramView : public PayloadView {
+  uint8_t _hash_sz;
+
+public:
+  bool init(const Packet* pkt) {
+    _hash_sz = pkt->getDatagramHashSize();
+    return bind(pkt->payload, pkt->payload_len, 2*_hash_sz + CIPHER_MAC_SIZE + 1);
+  }
+  uint8_t hashSize() const { return _hash_sz; }
+  const uint8_t* destHash() const { return _p; }
+  const uint8_t* srcHash() const { return &_p[_hash_sz]; }
+  const uint8_t* cipher() const { return &_p[2*_hash_sz]; }   // MAC + encrypted data
+  int cipherLen() const { return _len - 2*_hash_sz; }
+};
+
+/** \brief  ANON_REQ: dest_hash(1), sender pub_key(PUB_KEY_SIZE), MAC + ciphertext */
+class AnonReqView : public PayloadView {
+public:
+  static constexpr int DEST_HASH = 0, SENDER_KEY = 1, CIPHER = 1 + PUB_KEY_SIZE, MIN_LEN = CIPHER + 3;
+
+  bool init(const Packet* pkt) { return bind(pkt->payload, pkt->payload_len, MIN_LEN); }
+  const uint8_t* destHash() const { return &_p[DEST_HASH]; }
+  const uint8_t* senderKey() const { return &_p[SENDER_KEY]; }
+  const uint8_t* cipher() const { return &_p[CIPHER]; }
+  int cipherLen() const { return _len - CIPHER; }
+};
+
+/** \brief  GRP_TXT, GRP_DATA: channel_hash(1), MAC + ciphertext */
+class GroupView : public PayloadView {
+public:
+  static constexpr int CHANNEL_HASH = 0, CIPHER = 1, MIN_LEN = CIPHER + 3;
+
+  bool init(const Packet* pkt) { return bind(pkt->payload, pkt->payload_len, MIN_LEN); }
+  const uint8_t* channelHash() const { return &_p[CHANNEL_HASH]; }
+  const uint8_t* cipher() const { return &_p[CIPHER]; }
+  int cipherLen() const { return _len - CIPHER; }
+};
+
+/** \brief  ADVERT (full, ie. not a PAYLOAD_VER_2 refresh): pub_key, timestamp(4), signature, app_data */
+class AdvertView : public PayloadView {
+public:
+  static constexpr int PUB_KEY = 0, TIMESTAMP = PUB_KEY_SIZE, SIGNATURE = TIMESTAMP + 4, APP_DATA = SIGNATURE + SIGNATURE_SIZE;
+  static constexpr int MIN_LEN = APP_DATA;
+
+  bool init(const Packet* pkt) { return bind(pkt->payload, pkt->payload_len, MIN_LEN); }
+  const uint8_t* pubKey() const { return &_p[PUB_KEY]; }
+  uint32_t timestamp() const { return u32(TIMESTAMP); }
+  const uint8_t* signature() const { return &_p[SIGNATURE]; }
+  const uint8_t* appData() const { return &_p[APP_DATA]; }
+  int appDataLen() const { return _len - APP_DATA; }   // NOTE: not capped at MAX_ADVERT_DATA_SIZE
+};
+
+/**
+ * \brief  decrypted PATH contents: path_len(1, encoded), path, extra_type(1), extra (may be zero padded).
+ *     Is over a (writable) decrypt buffer, so path() and extra() can be handed on to callbacks which take them non-const.
+*/
+class PathDataView : public PayloadView {
+  int _extra;   // offset of extra_type
+
+public:
+  static constexpr int PATH_LEN = 0, PATH = 1;
+
+  bool init(uint8_t* data, int len) {
+    if (!bind(data, len, PATH + 1)) return false;
+    _extra = PATH + Packet::decodePathBytes(data[PATH_LEN]);
+    return len >= _extra + 1;
+  }
+  uint8_t pathLen() const { return _p[PATH_LEN]; }   // encoded, ie. may have PLF_WIDE_PATH flag
+  uint8_t* path() const { return (uint8_t *) &_p[PATH]; }
+  uint8_t extraType() const { return _p[_extra] & 0x0F; }   // upper 4 bits reserved for future use
+  uint8_t* extra() const { return (uint8_t *) &_p[_extra + 1]; }
+  int extraLen() const { return _len - _extra - 1; }
+};
+
+/**
+ * \brief  decrypted REQ (and ANON_REQ, TXT_MSG) contents: timestamp(4), type(1), then type specific data. The
+ *     repeater, room server and sensor REQ_TYPE_* requests all use this layout. Is over a (writable) decrypt buffer,
+ *     as per PathDataView.
+*/
+class RequestView : public PayloadView {
+public:
+  static constexpr int TIMESTAMP = 0, TYPE = 4, BODY = 5, MIN_LEN = 5;
+
+  bool init(uint8_t* data, int len) { return bind(data, len, MIN_LEN); }
+  uint32_t timestamp() const { return u32(TIMESTAMP); }
+  uint8_t type() const { return _p[TYPE]; }
+  uint8_t* request() const { return (uint8_t *) &_p[TYPE]; }   // type, then body (as handleRequest()s take it)
+  int requestLen() const { return _len - TYPE; }
+  uint8_t* body() const { return (uint8_t *) &_p[BODY]; }
+  int bodyLen() const { return _len - BODY; }
+};
+
+}
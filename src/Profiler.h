@@ -0,0 +1,147 @@
+#pragma once
+
+#include <MeshCore.h>
+#include <string.h>
+
+#ifndef MESH_PROFILING
+  #define MESH_PROFILING   0    // 1 = attribute CPU time of received packet handling to stages (see RecvProfiler)
+#endif
+
+#define PROF_STAGE_DECODE    0   // Dispatcher::checkRecv(), reading the raw frame into a Packet
+#define PROF_STAGE_DEDUP     1   // hasSeen() checks
+#define PROF_STAGE_SEARCH    2   // searchPeersByHash(), searchChannelsByHash()
+#define PROF_STAGE_CRYPTO    3   // ECDH (shared secrets), MAC check + decrypt, signature verify
+#define PROF_STAGE_APP       4   // the on...Recv() callbacks, incl. anything they send
+#define PROF_STAGE_QUEUE     5   // routing decision, and queueing of retransmits
+#define PROF_STAGE_OTHER     6   // the rest of onRecvPacket() (parsing, etc)
+#define PROF_STAGE_NUM       7
+
+#if MESH_PROFILING
+  #if defined(NRF52_PLATFORM)
+    #include <nrf.h>
+  #elif defined(ARDUINO) || defined(NATIVE_PLATFORM)
+    #include <Arduino.h>
+  #endif
+#endif
+
+namespace mesh {
+
+/**
+ * \brief  Per payload type, the CPU cycles spent in each stage (PROF_STAGE_*) of handling a received packet.
+ *    Time is 'self' time: a stage nested inside another (eg. a send from an app callback) is not also counted in
+ *    the outer one. Uses the DWT cycle counter on nRF52, the CCOUNT register on ESP32, and micros() elsewhere.
+*/
+class RecvProfiler {
+  uint64_t _cycles[16][PROF_STAGE_NUM];   // by payload type
+  uint32_t _counts[16];
+  uint32_t _last;
+  uint8_t _type;
+  uint8_t _stage;
+  bool _active;   // between startPacket() and endPacket()
+
+public:
+  RecvProfiler() { reset(); }
+
+  static void begin() {
+  #if MESH_PROFILING && defined(NRF52_PLATFORM)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  #endif
+  }
+
+  static uint32_t now() {
+  #if MESH_PROFILING && defined(NRF52_PLATFORM)
+    return DWT->CYCCNT;
+  #elif MESH_PROFILING && defined(ESP32)
+    return ESP.getCycleCount();   // (ie. esp_cpu_get_cycle_count())
+  #elif MESH_PROFILING && (defined(ARDUINO) || defined(NATIVE_PLATFORM))
+    return micros();
+  #else
+    return 0;
+  #endif
+  }
+
+  /** \returns  true if now() is in CPU cycles, false if in microseconds */
+  static bool isCycles() {
+  #if defined(NRF52_PLATFORM) || defined(ESP32)
+    return true;
+  #else
+    return false;
+  #endif
+  }
+
+  void reset() {
+    memset(_cycles, 0, sizeof(_cycles));
+    memset(_counts, 0, sizeof(_counts));
+    _type = 0;
+    _stage = PROF_STAGE_OTHER;
+    _active = false;
+  }
+
+  void add(uint8_t type, uint8_t stage, uint32_t cycles) { _cycles[type & 0x0F][stage] += cycles; }
+
+  /** \brief  start of onRecvPacket() for a packet of given type */
+  void startPacket(uint8_t type) {
+    _type = type & 0x0F;
+    _stage = PROF_STAGE_OTHER;
+    _last = now();
+    _active = true;
+  }
+  void endPacket() {
+    uint32_t t = now();
+    _cycles[_type][_stage] += t - _last;
+    _counts[_type]++;
+    _active = false;
+  }
+
+  /** \returns  the previous stage, to pass to leave(). (no-op outside of startPacket() .. endPacket()) */
+  uint8_t enter(uint8_t stage) {
+    if (!_active) return stage;
+    uint32_t t = now();
+    _cycles[_type][_stage] += t - _last;
+    _last = t;
+    uint8_t prev = _stage;
+    _stage = stage;
+    return prev;
+  }
+  void leave(uint8_t prev) {
+    if (!_active) return;
+    uint32_t t = now();
+    _cycles[_type][_stage] += t - _last;
+    _last = t;
+    _stage = prev;
+  }
+
+  uint32_t getCount(uint8_t type) const { return _counts[type]; }
+  uint64_t getCycles(uint8_t type, uint8_t stage) const { return _cycles[type][stage]; }
+
+  /** \returns  average per packet, over all types if 'type' is 0xFF */
+  uint32_t getAvgCycles(uint8_t type, uint8_t stage) const {
+    uint64_t total = 0;
+    uint32_t count = 0;
+    for (int t = 0; t < 16; t++) {
+      if (type != 0xFF && t != type) continue;
+      total += _cycles[t][stage];
+      count += _counts[t];
+    }
+    return count ? (uint32_t)(total / count) : 0;
+  }
+};
+
+#if MESH_PROFILING
+  /** \brief  attributes the time until the end of the enclosing scope to 'stage' */
+  class ProfScope {
+    RecvProfiler* _prof;
+    uint8_t _prev;
+  public:
+    ProfScope(RecvProfiler& prof, uint8_t stage) : _prof(&prof) { _prev = prof.enter(stage); }
+    ~ProfScope() { _prof->leave(_prev); }
+  };
+
+  #define PROF_SCOPE(prof, stage)   mesh::ProfScope _prof_scope(prof, stage)
+#else
+  #define PROF_SCOPE(prof, stage)   {}
+#endif
+
+}
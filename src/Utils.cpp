@@ -1,6 +1,4 @@
 #include "Utils.h"
-#include <AES.h>
-#include <SHA256.h>
 
 #ifdef ARDUINO
   #include <Arduino.h>
@@ -9,30 +7,35 @@
 namespace mesh {
 
 uint32_t RNG::nextInt(uint32_t _min, uint32_t _max) {
+  uint32_t range = _max - _min;
+  if (range == 0) return _min;
+
+  uint32_t threshold = (0 - range) % range;   // ie. 2^32 mod range
   uint32_t num;
-  random((uint8_t *) &num, sizeof(num));
-  return (num % (_max - _min)) + _min;
+  do {
+    random((uint8_t *) &num, sizeof(num));
+  } while (num < threshold);   // reject the (partial) lowest run, so every result is equally likely
+  return (num % range) + _min;
 }
 
 void Utils::sha256(uint8_t *hash, size_t hash_len, const uint8_t* msg, int msg_len) {
-  SHA256 sha;
+  CryptoSHA256 sha;
   sha.update(msg, msg_len);
   sha.finalize(hash, hash_len);
 }
 
 void Utils::sha256(uint8_t *hash, size_t hash_len, const uint8_t* frag1, int frag1_len, const uint8_t* frag2, int frag2_len) {
-  SHA256 sha;
+  CryptoSHA256 sha;
   sha.update(frag1, frag1_len);
   sha.update(frag2, frag2_len);
   sha.finalize(hash, hash_len);
 }
 
-int Utils::decrypt(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* src, int src_len) {
-  AES128 aes;
+template <typename C>
+static int decryptBlocks(C& aes, uint8_t* dest, const uint8_t* src, int src_len) {
   uint8_t* dp = dest;
   const uint8_t* sp = src;
 
-  aes.setKey(shared_secret, CIPHER_KEY_SIZE);
   while (sp - src < src_len) {
     aes.decryptBlock(dp, sp);
     dp += 16; sp += 16;
@@ -41,11 +44,10 @@ int Utils::decrypt(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* s
   return sp - src;  // will always be multiple of 16
 }
 
-int Utils::encrypt(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* src, int src_len) {
-  AES128 aes;
+template <typename C>
+static int encryptBlocks(C& aes, uint8_t* dest, const uint8_t* src, int src_len) {
   uint8_t* dp = dest;
 
-  aes.setKey(shared_secret, CIPHER_KEY_SIZE);
   while (src_len >= 16) {
     aes.encryptBlock(dp, src);
     dp += 16; src += 16; src_len -= 16;
@@ -60,10 +62,30 @@ int Utils::encrypt(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* s
   return dp - dest;  // will always be multiple of 16
 }
 
+int Utils::decrypt(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* src, int src_len) {
+  CryptoAES128 aes;
+  aes.setKey(shared_secret, CIPHER_KEY_SIZE);
+  return decryptBlocks(aes, dest, src, src_len);
+}
+
+int Utils::encrypt(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* src, int src_len) {
+  CryptoAES128 aes;
+  aes.setKey(shared_secret, CIPHER_KEY_SIZE);
+  return encryptBlocks(aes, dest, src, src_len);
+}
+
+int Utils::decrypt(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len) {
+  return decryptBlocks(key, dest, src, src_len);
+}
+
+int Utils::encrypt(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len) {
+  return encryptBlocks(key, dest, src, src_len);
+}
+
 int Utils::encryptThenMAC(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* src, int src_len) {
   int enc_len = encrypt(shared_secret, dest + CIPHER_MAC_SIZE, src, src_len);
 
-  SHA256 sha;
+  CryptoSHA256 sha;
   sha.resetHMAC(shared_secret, PUB_KEY_SIZE);
   sha.update(dest + CIPHER_MAC_SIZE, enc_len);
   sha.finalizeHMAC(shared_secret, PUB_KEY_SIZE, dest, CIPHER_MAC_SIZE);
@@ -71,12 +93,19 @@ int Utils::encryptThenMAC(const uint8_t* shared_secret, uint8_t* dest, const uin
   return CIPHER_MAC_SIZE + enc_len;
 }
 
+int Utils::encryptThenMAC(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len) {
+  int enc_len = encrypt(key, dest + CIPHER_MAC_SIZE, src, src_len);
+  key.calcMAC(dest, dest + CIPHER_MAC_SIZE, enc_len);
+
+  return CIPHER_MAC_SIZE + enc_len;
+}
+
 int Utils::MACThenDecrypt(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* src, int src_len) {
   if (src_len <= CIPHER_MAC_SIZE) return 0;  // invalid src bytes
 
   uint8_t hmac[CIPHER_MAC_SIZE];
   {
-    SHA256 sha;
+    CryptoSHA256 sha;
     sha.resetHMAC(shared_secret, PUB_KEY_SIZE);
     sha.update(src + CIPHER_MAC_SIZE, src_len - CIPHER_MAC_SIZE);
     sha.finalizeHMAC(shared_secret, PUB_KEY_SIZE, hmac, CIPHER_MAC_SIZE);
@@ -87,6 +116,144 @@ int Utils::MACThenDecrypt(const uint8_t* shared_secret, uint8_t* dest, const uin
   return 0; // invalid HMAC
 }
 
+int Utils::MACThenDecrypt(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len) {
+  if (src_len <= CIPHER_MAC_SIZE) return 0;  // invalid src bytes
+
+  uint8_t hmac[CIPHER_MAC_SIZE];
+  key.calcMAC(hmac, src + CIPHER_MAC_SIZE, src_len - CIPHER_MAC_SIZE);
+  if (memcmp(hmac, src, CIPHER_MAC_SIZE) == 0) {
+    return decrypt(key, dest, src + CIPHER_MAC_SIZE, src_len - CIPHER_MAC_SIZE);
+  }
+  return 0; // invalid HMAC
+}
+
+int Utils::encryptSIV(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len) {
+  uint8_t iv[CIPHER_BLOCK_SIZE];
+  key.calcCMAC(iv, src, src_len);
+  memset(&iv[CIPHER_MAC_V2_SIZE], 0, CIPHER_BLOCK_SIZE - CIPHER_MAC_V2_SIZE);   // IV is just the transmitted MAC
+
+  memcpy(dest, iv, CIPHER_MAC_V2_SIZE);
+  key.cryptCTR(dest + CIPHER_MAC_V2_SIZE, src, src_len, iv);
+  return CIPHER_MAC_V2_SIZE + src_len;
+}
+
+int Utils::decryptSIV(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len) {
+  if (src_len <= CIPHER_MAC_V2_SIZE) return 0;  // invalid src bytes
+
+  uint8_t iv[CIPHER_BLOCK_SIZE];
+  memcpy(iv, src, CIPHER_MAC_V2_SIZE);
+  memset(&iv[CIPHER_MAC_V2_SIZE], 0, CIPHER_BLOCK_SIZE - CIPHER_MAC_V2_SIZE);
+
+  int len = src_len - CIPHER_MAC_V2_SIZE;
+  key.cryptCTR(dest, src + CIPHER_MAC_V2_SIZE, len, iv);
+
+  uint8_t mac[CIPHER_BLOCK_SIZE];
+  key.calcCMAC(mac, dest, len);
+  if (memcmp(mac, src, CIPHER_MAC_V2_SIZE) == 0) return len;
+  return 0; // invalid MAC
+}
+
+static void cmacDouble(uint8_t* dest, const uint8_t* src) {
+  uint8_t carry = 0;
+  for (int i = CIPHER_BLOCK_SIZE - 1; i >= 0; i--) {
+    uint8_t b = src[i];
+    dest[i] = (b << 1) | carry;
+    carry = b >> 7;
+  }
+  if (carry) dest[CIPHER_BLOCK_SIZE - 1] ^= 0x87;
+}
+
+void CipherKey::init(const uint8_t* shared_secret) {
+  _aes.setKey(shared_secret, CIPHER_KEY_SIZE);
+
+  uint8_t mac_key[CIPHER_KEY_SIZE];   // separate key for CMAC (secret may only be 128-bit, eg. channels)
+  Utils::sha256(mac_key, sizeof(mac_key), shared_secret, PUB_KEY_SIZE);
+  _mac_aes.setKey(mac_key, sizeof(mac_key));
+  memset(mac_key, 0, sizeof(mac_key));
+
+  uint8_t l[CIPHER_BLOCK_SIZE];
+  memset(l, 0, sizeof(l));
+  _mac_aes.encryptBlock(l, l);
+  cmacDouble(_k1, l);
+  cmacDouble(_k2, _k1);
+
+  uint8_t block[64];   // SHA256 block size
+  memset(block, 0, sizeof(block));
+  memcpy(block, shared_secret, PUB_KEY_SIZE);
+  for (int i = 0; i < (int) sizeof(block); i++) block[i] ^= 0x36;   // inner pad
+  _inner.reset();
+  _inner.update(block, sizeof(block));
+
+  for (int i = 0; i < (int) sizeof(block); i++) block[i] ^= (0x36 ^ 0x5C);   // outer pad
+  _outer.reset();
+  _outer.update(block, sizeof(block));
+  memset(block, 0, sizeof(block));
+}
+
+void CipherKey::calcMAC(uint8_t* mac, const uint8_t* data, int len) const {
+  uint8_t inner_hash[32];
+  CryptoSHA256 sha = _inner;
+  sha.update(data, len);
+  sha.finalize(inner_hash, sizeof(inner_hash));
+
+  sha = _outer;
+  sha.update(inner_hash, sizeof(inner_hash));
+  sha.finalize(mac, CIPHER_MAC_SIZE);
+}
+
+void CipherKey::calcCMAC(uint8_t* mac, const uint8_t* data, int len) {
+  uint8_t x[CIPHER_BLOCK_SIZE];
+  memset(x, 0, sizeof(x));
+  while (len > CIPHER_BLOCK_SIZE) {
+    for (int i = 0; i < CIPHER_BLOCK_SIZE; i++) x[i] ^= data[i];
+    _mac_aes.encryptBlock(x, x);
+    data += CIPHER_BLOCK_SIZE; len -= CIPHER_BLOCK_SIZE;
+  }
+  // final block
+  if (len == CIPHER_BLOCK_SIZE) {
+    for (int i = 0; i < CIPHER_BLOCK_SIZE; i++) x[i] ^= data[i] ^ _k1[i];
+  } else {
+    for (int i = 0; i < len; i++) x[i] ^= data[i];
+    x[len] ^= 0x80;   // pad
+    for (int i = 0; i < CIPHER_BLOCK_SIZE; i++) x[i] ^= _k2[i];
+  }
+  _mac_aes.encryptBlock(mac, x);
+}
+
+void CipherKey::cryptCTR(uint8_t* dest, const uint8_t* src, int len, const uint8_t* iv) {
+  uint8_t ctr[CIPHER_BLOCK_SIZE], stream[CIPHER_BLOCK_SIZE];
+  memcpy(ctr, iv, CIPHER_BLOCK_SIZE);
+  while (len > 0) {
+    _aes.encryptBlock(stream, ctr);
+    int n = len < CIPHER_BLOCK_SIZE ? len : CIPHER_BLOCK_SIZE;
+    for (int i = 0; i < n; i++) dest[i] = src[i] ^ stream[i];
+    dest += n; src += n; len -= n;
+
+    for (int i = CIPHER_BLOCK_SIZE - 1; i >= 0 && ++ctr[i] == 0; i--) ;   // big-endian increment
+  }
+}
+
+CipherKeyCache::CipherKeyCache() {
+  for (int i = 0; i < CIPHER_KEY_CACHE_SIZE; i++) _entries[i].last_used = 0;
+  _counter = 0;
+}
+
+CipherKey& CipherKeyCache::get(const uint8_t* shared_secret) {
+  Entry* lru = &_entries[0];
+  for (int i = 0; i < CIPHER_KEY_CACHE_SIZE; i++) {
+    Entry* e = &_entries[i];
+    if (e->last_used && memcmp(e->secret, shared_secret, PUB_KEY_SIZE) == 0) {   // hit
+      e->last_used = ++_counter;
+      return e->key;
+    }
+    if (e->last_used < lru->last_used) lru = e;
+  }
+  memcpy(lru->secret, shared_secret, PUB_KEY_SIZE);
+  lru->key.init(shared_secret);
+  lru->last_used = ++_counter;
+  return lru->key;
+}
+
 static const char hex_chars[] = "0123456789ABCDEF";
 
 void Utils::toHex(char* dest, const uint8_t* src, size_t len) {
@@ -2,6 +2,7 @@
 
 #include <MeshCore.h>
 #include <Stream.h>
+#include <CryptoBackend.h>
 #include <string.h>
 
 namespace mesh {
@@ -10,12 +11,59 @@ class RNG {
 public:
   virtual void random(uint8_t* dest, size_t sz) = 0;
 
+  /**
+   * \brief  mixes event data (eg. packet SNR, RSSI, timing) into the RNG state. Ignored by default.
+   */
+  virtual void addEntropy(const uint8_t* data, size_t len) { }
+
   /**
    * \returns  random number between _min (inclusive) and _max (exclusive)
    */
   uint32_t nextInt(uint32_t _min, uint32_t _max);
 };
 
+/**
+ * \brief  The expanded key material for a given shared_secret: the AES128 key schedule, plus the HMAC-SHA256 state
+ *     with the inner and outer key blocks already hashed. So, encrypting or checking a MAC only needs to process the data.
+*/
+class CipherKey {
+  CryptoAES128 _aes;
+  CryptoSHA256 _inner, _outer;
+  CryptoAES128 _mac_aes;              // for PAYLOAD_VER_2 (AES-CMAC), key is derived from shared_secret
+  uint8_t _k1[16], _k2[16];     // CMAC sub-keys
+
+public:
+  void init(const uint8_t* shared_secret);
+  void calcMAC(uint8_t* mac, const uint8_t* data, int len) const;
+  void calcCMAC(uint8_t* mac, const uint8_t* data, int len);   // full 16 byte tag
+  void cryptCTR(uint8_t* dest, const uint8_t* src, int len, const uint8_t* iv);
+  void encryptBlock(uint8_t* dest, const uint8_t* src) { _aes.encryptBlock(dest, src); }
+  void decryptBlock(uint8_t* dest, const uint8_t* src) { _aes.decryptBlock(dest, src); }
+};
+
+#ifndef CIPHER_KEY_CACHE_SIZE
+  #define CIPHER_KEY_CACHE_SIZE   4
+#endif
+
+/**
+ * \brief  A small LRU cache of prepared CipherKey's, by shared_secret. As entries are matched on the secret itself,
+ *     a changed secret simply misses, and its old key material ages out.
+*/
+class CipherKeyCache {
+  struct Entry {
+    uint8_t secret[PUB_KEY_SIZE];
+    CipherKey key;
+    uint32_t last_used;   // zero if unused
+  };
+  Entry _entries[CIPHER_KEY_CACHE_SIZE];
+  uint32_t _counter;
+
+public:
+  CipherKeyCache();
+
+  CipherKey& get(const uint8_t* shared_secret);
+};
+
 class Utils {
 public:
   /**
@@ -42,17 +90,38 @@ public:
   */
   static int decrypt(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* src, int src_len);
 
+  /**
+   * \brief  same as above, but with the key schedule already expanded.
+  */
+  static int encrypt(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len);
+  static int decrypt(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len);
+
   /**
    * \brief  encrypts bytes in src, then calculates MAC on ciphertext, inserting into leading bytes of 'dest'.
    * \returns  total length of bytes in 'dest' (MAC + ciphertext)
   */
   static int encryptThenMAC(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* src, int src_len);
+  static int encryptThenMAC(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len);
 
   /**
    * \brief  checks the MAC (in leading bytes of 'src'), then if valid, decrypts remaining bytes in src.
    * \returns  zero if MAC is invalid, otherwise the length of decrypted bytes in 'dest'
   */
   static int MACThenDecrypt(const uint8_t* shared_secret, uint8_t* dest, const uint8_t* src, int src_len);
+  static int MACThenDecrypt(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len);
+
+  /**
+   * \brief  PAYLOAD_VER_2 encryption: AES128-CTR, with a synthetic IV (the AES-CMAC of the plaintext, truncated to
+   *         CIPHER_MAC_V2_SIZE) which is also the MAC, inserted into leading bytes of 'dest'. No padding.
+   * \returns  total length of bytes in 'dest' (MAC + ciphertext)
+  */
+  static int encryptSIV(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len);
+
+  /**
+   * \brief  reverse of encryptSIV(), then checks the MAC against the decrypted bytes.
+   * \returns  zero if MAC is invalid, otherwise the length of decrypted bytes in 'dest'
+  */
+  static int decryptSIV(CipherKey& key, uint8_t* dest, const uint8_t* src, int src_len);
 
   /**
    * \brief  converts 'src' bytes with given length to Hex representation, and null terminates.
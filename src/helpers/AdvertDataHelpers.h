@@ -16,6 +16,18 @@
 #define ADV_FEAT2_MASK        0x40   // FUTURE
 #define ADV_NAME_MASK         0x80
 
+// feat1 bits
+#define ADV_CAP_LOW_POWER_RX  0x0001   // receiver is duty-cycled, so must be sent to with a long preamble
+#define ADV_CAP_WIDE_HASH     0x0002   // accepts PAYLOAD_VER_3 datagrams (2-byte src/dest hashes)
+#define ADV_CAP_ACK_PIGGYBACK 0x0004   // takes an ACK from the trailer of a TXT_MSG (see TXT_ACK_TRAILER_SIZE)
+#define ADV_CAP_NET_CODING    0x0008   // decodes CODED frames, so repeaters may XOR its DIRECT datagrams with replies
+#define ADV_CAP_BUNDLE        0x0010   // unpacks BUNDLE frames, so may be sent several DIRECT packets in one
+#define ADV_CAP_FRAGMENTS     0x0020   // repeater: forwards MULTIPART fragments. Others: reassembles those sent to it
+
+// feat2: low byte is 1 + home channel (of a ChannelPlan), or zero if single channel
+//        high byte is 1 + channel load percent (see ChannelLoad), or zero if not advertised
+#define ADV_FEAT2_CHANNEL_LOAD(percent)   ((uint16_t)(1 + (percent)) << 8)
+
 class AdvertDataBuilder {
   uint8_t _type;
   bool _has_loc;
@@ -54,6 +66,14 @@ public:
   uint8_t getType() const { return _flags & 0x0F; }
   uint16_t getFeat1() const { return _extra1; }
   uint16_t getFeat2() const { return _extra2; }
+  bool isLowPowerRx() const { return (_extra1 & ADV_CAP_LOW_POWER_RX) != 0; }
+  bool hasWideHash() const { return (_extra1 & ADV_CAP_WIDE_HASH) != 0; }
+  bool hasAckPiggyback() const { return (_extra1 & ADV_CAP_ACK_PIGGYBACK) != 0; }
+  bool hasNetCoding() const { return (_extra1 & ADV_CAP_NET_CODING) != 0; }
+  bool hasBundle() const { return (_extra1 & ADV_CAP_BUNDLE) != 0; }
+  bool hasFragments() const { return (_extra1 & ADV_CAP_FRAGMENTS) != 0; }
+  int getHomeChannel() const { return ((int)(_extra2 & 0xFF)) - 1; }   // -1 if not advertised
+  int getChannelLoad() const { return ((int)(_extra2 >> 8)) - 1; }     // percent, or -1 if not advertised
 
   bool hasName() const { return _name[0] != 0; }
   const char* getName() const { return _name; }
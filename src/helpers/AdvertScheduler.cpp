@@ -0,0 +1,58 @@
+#include "AdvertScheduler.h"
+
+void AdvertScheduler::begin(const uint8_t* self_pub_key) {
+  memcpy(_prefix, self_pub_key, sizeof(_prefix));
+  uint16_t seed = (self_pub_key[1] << 8) | self_pub_key[2];   // (not [0], as that is the path hash, which may be picked)
+  _jitter = (int16_t)(seed % (2*ADVERT_JITTER_PERMILLE + 1)) - ADVERT_JITTER_PERMILLE;
+}
+
+uint32_t AdvertScheduler::jitterInterval(uint32_t interval_millis) const {
+  return (uint32_t)((int64_t) interval_millis * (1000 + _jitter) / 1000);
+}
+
+void AdvertScheduler::advanceWindow(unsigned long now) {
+  unsigned long elapsed = now - _window_start;
+  if (elapsed < ADVERT_WAVE_WINDOW_MILLIS) return;
+
+  _prev_count = elapsed < 2*ADVERT_WAVE_WINDOW_MILLIS ? _curr_count : 0;
+  _curr_count = 0;
+  _window_start = now;
+}
+
+void AdvertScheduler::onAdvertHeard(const mesh::Packet* packet, unsigned long now) {
+  if (packet->getPayloadType() != PAYLOAD_TYPE_ADVERT || packet->payload_len < PUB_KEY_SIZE) return;
+
+  if (memcmp(packet->payload, _prefix, sizeof(_prefix)) == 0) {
+    if (packet->isRouteFlood() && packet->path_len > 0) _last_echo = now | 1;   // a neighbour re-flooding ours
+    return;
+  }
+  advanceWindow(now);
+  if (_curr_count < 0xFFFF) _curr_count++;
+}
+
+bool AdvertScheduler::isWaveInProgress(unsigned long now) {
+  advanceWindow(now);
+  return _curr_count >= ADVERT_WAVE_THRESHOLD || _prev_count >= ADVERT_WAVE_THRESHOLD;
+}
+
+bool AdvertScheduler::isOwnAdvertEchoing(unsigned long now, uint32_t within_millis) const {
+  return _last_echo && now - _last_echo < within_millis;
+}
+
+uint32_t AdvertScheduler::getFloodAdvertDelay(unsigned long now, mesh::RNG* rng) {
+  if (_n_defers < ADVERT_MAX_DEFERS && (isWaveInProgress(now) || isOwnAdvertEchoing(now, ADVERT_ECHO_HOLD_MILLIS))) {
+    _n_defers++;
+    _n_deferred++;
+    return rng->nextInt(ADVERT_DEFER_MIN_MILLIS, ADVERT_DEFER_MAX_MILLIS);
+  }
+  _n_defers = 0;
+  return 0;
+}
+
+bool AdvertScheduler::shouldSuppressLocal(unsigned long now, uint32_t interval_millis) {
+  if (isOwnAdvertEchoing(now, interval_millis)) {
+    _n_suppressed++;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Mesh.h>
+
+#define ADVERT_JITTER_PERMILLE       100      // intervals are +/- up to this, per node (by pub_key)
+#define ADVERT_WAVE_WINDOW_MILLIS    60000
+#define ADVERT_WAVE_THRESHOLD        6        // adverts heard (incl. re-floods) in a window, for it to be an 'advert wave'
+#define ADVERT_DEFER_MIN_MILLIS      (2*60*1000)
+#define ADVERT_DEFER_MAX_MILLIS      (10*60*1000)
+#define ADVERT_MAX_DEFERS            6        // then send regardless
+#define ADVERT_ECHO_HOLD_MILLIS      (5*60*1000)   // own advert re-flooded within this, so another is not needed yet
+
+/**
+ * \brief  Spreads out a node's scheduled adverts from those of other nodes. The intervals are offset by a fixed
+ *     amount derived from the node's pub_key, so nodes which all rebooted together (eg. after a power outage) don't
+ *     flood their adverts at the same time, and flood adverts are deferred while an advert wave is in progress, or
+ *     while the node's own previous advert is still being re-flooded by its neighbours.
+*/
+class AdvertScheduler {
+  int16_t _jitter;   // permille
+  uint8_t _prefix[4];
+  unsigned long _window_start;
+  uint16_t _curr_count, _prev_count;
+  unsigned long _last_echo;   // zero if none
+  uint8_t _n_defers;
+  uint32_t _n_deferred, _n_suppressed;
+
+  void advanceWindow(unsigned long now);
+
+public:
+  AdvertScheduler() {
+    _jitter = 0; memset(_prefix, 0, sizeof(_prefix));
+    _window_start = 0; _curr_count = _prev_count = 0;
+    _last_echo = 0; _n_defers = 0;
+    _n_deferred = _n_suppressed = 0;
+  }
+
+  void begin(const uint8_t* self_pub_key);
+
+  /** \returns  'interval_millis' offset by this node's jitter */
+  uint32_t jitterInterval(uint32_t interval_millis) const;
+
+  /** \brief  call for every advert packet received, including duplicates (eg. from Dispatcher::logRx()) */
+  void onAdvertHeard(const mesh::Packet* packet, unsigned long now);
+
+  bool isWaveInProgress(unsigned long now);
+  bool isOwnAdvertEchoing(unsigned long now, uint32_t within_millis) const;
+
+  /**
+   * \brief  call when the flood advert timer is due
+   * \returns  millis to defer the flood advert by, or zero to send it now
+  */
+  uint32_t getFloodAdvertDelay(unsigned long now, mesh::RNG* rng);
+
+  /**
+   * \brief  call when the local (zero hop) advert timer is due
+   * \returns  true, if it is not needed, as neighbours have re-flooded our advert within 'interval_millis'
+  */
+  bool shouldSuppressLocal(unsigned long now, uint32_t interval_millis);
+
+  uint32_t getNumDeferred() const { return _n_deferred; }
+  uint32_t getNumSuppressed() const { return _n_suppressed; }
+};
@@ -0,0 +1,87 @@
+#include "AirtimeBudget.h"
+
+static const uint8_t default_shares[AIRTIME_NUM_CLASSES] = { 10, 40, 40, 10 };   // ack, direct, flood, advert
+
+void AirtimeBudget::begin(uint32_t now, uint32_t window_secs, float duty_percent, const uint8_t* share_percent) {
+  if (share_percent == NULL) share_percent = default_shares;
+
+  _slot_millis = window_secs * 1000 / AIRTIME_BUDGET_SLOTS;
+  _slot_start = now;
+  _curr = 0;
+  _budget = 0;
+  uint32_t budget = (uint32_t) (window_secs * 10.0f * duty_percent);   // ie. secs * 1000 * (duty_percent / 100)
+  for (int c = 0; c < AIRTIME_NUM_CLASSES; c++) {
+    _share[c] = budget * share_percent[c] / 100;
+    _budget += _share[c];
+    _total[c] = 0;
+  }
+  memset(_used, 0, sizeof(_used));
+  if (_slot_millis == 0) _budget = 0;  // invalid window, disable
+}
+
+int AirtimeBudget::classify(const mesh::Packet* packet) {
+  uint8_t type = packet->getPayloadType();
+  if (type == PAYLOAD_TYPE_ACK || type == PAYLOAD_TYPE_MULTIPART) return AIRTIME_CLASS_ACK;
+  if (type == PAYLOAD_TYPE_ADVERT) return AIRTIME_CLASS_ADVERT;
+  return packet->isRouteFlood() ? AIRTIME_CLASS_FLOOD : AIRTIME_CLASS_DIRECT;
+}
+
+void AirtimeBudget::advance(uint32_t now) {
+  if (now - _slot_start >= _slot_millis * AIRTIME_BUDGET_SLOTS) {   // whole window has expired
+    memset(_used, 0, sizeof(_used));
+    memset(_total, 0, sizeof(_total));
+    _slot_start = now;
+    return;
+  }
+  while (now - _slot_start >= _slot_millis) {
+    _slot_start += _slot_millis;
+    _curr = (_curr + 1) % AIRTIME_BUDGET_SLOTS;   // oldest slot drops out of window, re-use it
+    for (int c = 0; c < AIRTIME_NUM_CLASSES; c++) {
+      _total[c] -= _used[_curr][c];
+      _used[_curr][c] = 0;
+    }
+  }
+}
+
+bool AirtimeBudget::fits(const uint32_t used[], int cls, uint32_t air_time) const {
+  uint32_t all = air_time, own = air_time, own_share = 0;
+  for (int c = 0; c < AIRTIME_NUM_CLASSES; c++) {
+    all += used[c];
+    if (c >= cls) {   // this class, plus the less important ones it can borrow from
+      own += used[c];
+      own_share += _share[c];
+    }
+  }
+  return all <= _budget && own <= own_share;
+}
+
+uint32_t AirtimeBudget::getDelayFor(uint32_t now, int cls, uint32_t air_time) {
+  if (!isEnabled()) return 0;
+
+  advance(now);
+  if (fits(_total, cls, air_time)) return 0;
+
+  // find how many of the oldest slots need to expire before it fits
+  uint32_t remaining[AIRTIME_NUM_CLASSES];
+  memcpy(remaining, _total, sizeof(remaining));
+  for (int k = 1; k <= AIRTIME_BUDGET_SLOTS; k++) {
+    int i = (_curr + k) % AIRTIME_BUDGET_SLOTS;
+    for (int c = 0; c < AIRTIME_NUM_CLASSES; c++) {
+      remaining[c] -= _used[i][c];
+    }
+    if (fits(remaining, cls, air_time)) {
+      return _slot_start + k*_slot_millis - now;
+    }
+  }
+  return AIRTIME_NEVER;
+}
+
+void AirtimeBudget::record(uint32_t now, int cls, uint32_t air_time) {
+  if (!isEnabled()) return;
+
+  advance(now);
+  uint32_t n = _used[_curr][cls] + air_time;
+  if (n > 0xFFFF) n = 0xFFFF;
+  _total[cls] += n - _used[_curr][cls];
+  _used[_curr][cls] = n;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Dispatcher.h>
+#include <string.h>
+
+#define AIRTIME_CLASS_ACK      0    // most important
+#define AIRTIME_CLASS_DIRECT   1
+#define AIRTIME_CLASS_FLOOD    2
+#define AIRTIME_CLASS_ADVERT   3    // least important
+#define AIRTIME_NUM_CLASSES    4
+
+#ifndef AIRTIME_BUDGET_SLOTS
+  #define AIRTIME_BUDGET_SLOTS   60
+#endif
+
+/**
+ * \brief  A sliding-window duty-cycle governor (eg. for EU 1% / 10% sub-band rules).
+ *     Airtime used over the last 'window' is tracked per traffic class, in AIRTIME_BUDGET_SLOTS time slots.
+ *     Each class has a reserved share of the total budget, and may also borrow any unused share of the
+ *     less important classes, but never from the more important ones.
+*/
+class AirtimeBudget {
+  uint32_t _slot_millis, _slot_start;
+  uint32_t _budget;                                       // total allowed millis per window (0 = disabled)
+  uint32_t _share[AIRTIME_NUM_CLASSES];                   // reserved millis per window, by class
+  uint32_t _total[AIRTIME_NUM_CLASSES];                   // used millis over the window, by class
+  uint16_t _used[AIRTIME_BUDGET_SLOTS][AIRTIME_NUM_CLASSES];
+  uint8_t _curr;
+
+  void advance(uint32_t now);
+  bool fits(const uint32_t used[], int cls, uint32_t air_time) const;
+
+public:
+  AirtimeBudget() { _budget = 0; }
+
+  /**
+   * \param  window_secs  length of sliding window. (max of about 3900 secs with 60 slots)
+   * \param  duty_percent  max percent of the window that may be used for transmitting. (zero to disable)
+   * \param  share_percent  (optional) percent of budget reserved for each class, must add up to 100.
+  */
+  void begin(uint32_t now, uint32_t window_secs, float duty_percent, const uint8_t* share_percent=NULL);
+  bool isEnabled() const { return _budget > 0; }
+
+  static int classify(const mesh::Packet* packet);
+
+  /**
+   * \returns  millis to wait until 'air_time' can be spent by class 'cls', zero if now,
+   *       or AIRTIME_NEVER if it exceeds what this class can ever be allowed.
+  */
+  uint32_t getDelayFor(uint32_t now, int cls, uint32_t air_time);
+  void record(uint32_t now, int cls, uint32_t air_time);
+
+  uint32_t getBudget() const { return _budget; }
+  uint32_t getUsed(int cls) const { return _total[cls]; }
+};
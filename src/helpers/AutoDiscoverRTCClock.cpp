@@ -37,12 +37,13 @@ void AutoDiscoverRTCClock::begin(TwoWire& wire) {
   }
 }
 
-uint32_t AutoDiscoverRTCClock::getCurrentTime() {
+bool AutoDiscoverRTCClock::readHardware(uint32_t& time) {
   if (ds3231_success) {
-    return rtc_3231.now().unixtime();
+    time = rtc_3231.now().unixtime();
+    return true;
   }
   if (rv3028_success) {
-    return DateTime(
+    time = DateTime(
         rtc_rv3028.getYear(),
         rtc_rv3028.getMonth(),
         rtc_rv3028.getDate(),
@@ -50,11 +51,27 @@ uint32_t AutoDiscoverRTCClock::getCurrentTime() {
         rtc_rv3028.getMinute(),
         rtc_rv3028.getSecond()
     ).unixtime();
+    return true;
   }
   if(rtc_8563_success){
-    return rtc_8563.now().unixtime();
+    time = rtc_8563.now().unixtime();
+    return true;
+  }
+  return false;
+}
+
+uint32_t AutoDiscoverRTCClock::getCurrentTime() {
+  // an I2C read is slow, and this is called per packet, so only read the chip every RTC_REREAD_MILLIS
+  unsigned long now = millis();
+  if (!_cache_valid || now - _cached_at >= RTC_REREAD_MILLIS) {
+    uint32_t time;
+    if (!readHardware(time)) return _fallback->getCurrentTime();   // no RTC chip found
+
+    _cached_time = time;
+    _cached_at = now;
+    _cache_valid = true;
   }
-  return _fallback->getCurrentTime();
+  return _cached_time + (now - _cached_at) / 1000;
 }
 
 void AutoDiscoverRTCClock::setCurrentTime(uint32_t time) { 
@@ -68,5 +85,9 @@ void AutoDiscoverRTCClock::setCurrentTime(uint32_t time) {
     rtc_8563.adjust(DateTime(time));
   } else {
     _fallback->setCurrentTime(time);
+    return;
   }
+  _cached_time = time;
+  _cached_at = millis();
+  _cache_valid = true;
 }
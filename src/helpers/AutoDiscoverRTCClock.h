@@ -4,12 +4,20 @@
 #include <Arduino.h>
 #include <Wire.h>
 
+#ifndef RTC_REREAD_MILLIS
+  #define RTC_REREAD_MILLIS   (5*60*1000)   // how often the RTC chip is actually read, in between time is from millis()
+#endif
+
 class AutoDiscoverRTCClock : public mesh::RTCClock {
   mesh::RTCClock* _fallback;
+  uint32_t _cached_time;       // as last read from (or written to) the RTC chip
+  unsigned long _cached_at;    // millis() at the time
+  bool _cache_valid;
 
   bool i2c_probe(TwoWire& wire, uint8_t addr);
+  bool readHardware(uint32_t& time);
 public:
-  AutoDiscoverRTCClock(mesh::RTCClock& fallback) : _fallback(&fallback) { }
+  AutoDiscoverRTCClock(mesh::RTCClock& fallback) : _fallback(&fallback) { _cached_time = 0; _cached_at = 0; _cache_valid = false; }
 
   void begin(TwoWire& wire);
   uint32_t getCurrentTime() override;
@@ -9,6 +9,16 @@
   #define TXT_ACK_DELAY     200
 #endif
 
+#ifndef KEEP_ALIVE_COALESCE_DIV
+  #define KEEP_ALIVE_COALESCE_DIV   4   // keep-alives due within (interval / this) are sent early, with one on the same path
+#endif
+
+#define CONN_CHECK_MAX_MILLIS   60000   // longest between connections[] checks (pings and expiries bring it forward)
+
+#ifndef ACK_HOLD_MILLIS
+  #define ACK_HOLD_MILLIS   600     // how long an ACK waits for a reply to ride on (must be well inside sender's timeout)
+#endif
+
 void BaseChatMesh::sendFloodScoped(const ContactInfo& recipient, mesh::Packet* pkt, uint32_t delay_millis) {
   sendFlood(pkt, delay_millis);
 }
@@ -21,6 +31,8 @@ mesh::Packet* BaseChatMesh::createSelfAdvert(const char* name) {
   uint8_t app_data_len;
   {
     AdvertDataBuilder builder(ADV_TYPE_CHAT, name);
+    builder.setFeat1(ADV_CAP_WIDE_HASH | ADV_CAP_ACK_PIGGYBACK | ADV_CAP_NET_CODING | ADV_CAP_BUNDLE
+                     | (hasFragmentStore() ? ADV_CAP_FRAGMENTS : 0));
     app_data_len = builder.encodeTo(app_data);
   }
 
@@ -32,18 +44,20 @@ mesh::Packet* BaseChatMesh::createSelfAdvert(const char* name, double lat, doubl
   uint8_t app_data_len;
   {
     AdvertDataBuilder builder(ADV_TYPE_CHAT, name, lat, lon);
+    builder.setFeat1(ADV_CAP_WIDE_HASH | ADV_CAP_ACK_PIGGYBACK | ADV_CAP_NET_CODING | ADV_CAP_BUNDLE
+                     | (hasFragmentStore() ? ADV_CAP_FRAGMENTS : 0));
     app_data_len = builder.encodeTo(app_data);
   }
 
   return createAdvert(self_id, app_data, app_data_len);
 }
 
-void BaseChatMesh::sendAckTo(const ContactInfo& dest, uint32_t ack_hash) {
+void BaseChatMesh::sendAckTo(const ContactInfo& dest, uint32_t ack_hash, uint32_t delay_millis) {
   if (dest.out_path_len < 0) {
     mesh::Packet* ack = createAck(ack_hash);
-    if (ack) sendFloodScoped(dest, ack, TXT_ACK_DELAY);
+    if (ack) sendFloodScoped(dest, ack, delay_millis);
   } else {
-    uint32_t d = TXT_ACK_DELAY;
+    uint32_t d = delay_millis;
     if (getExtraAckTransmitCount() > 0) {
       mesh::Packet* a1 = createMultiAck(ack_hash, 1);
       if (a1) sendDirect(a1, dest.out_path, dest.out_path_len, d);
@@ -55,6 +69,57 @@ void BaseChatMesh::sendAckTo(const ContactInfo& dest, uint32_t ack_hash) {
   }
 }
 
+void BaseChatMesh::holdAckTo(int idx, uint32_t ack_hash) {
+  const ContactInfo& dest = contacts[idx];
+  if (hasAckPiggyback(idx) && dest.out_path_len >= 0) {
+    for (int i = 0; i < ACK_HOLD_SLOTS; i++) {
+      HeldAck* h = &held_acks[i];
+      if (!h->in_use) {   // hold it, in case we reply soon (see composeMsgPacket())
+        memcpy(h->pub_key, dest.id.pub_key, sizeof(h->pub_key));
+        h->ack_hash = ack_hash;
+        h->due = futureMillis(ACK_HOLD_MILLIS);
+        h->in_use = true;
+        return;
+      }
+    }
+  }
+  sendAckTo(dest, ack_hash, TXT_ACK_DELAY);
+}
+
+int BaseChatMesh::findHeldAck(const ContactInfo& contact) const {
+  for (int i = 0; i < ACK_HOLD_SLOTS; i++) {
+    if (held_acks[i].in_use && memcmp(held_acks[i].pub_key, contact.id.pub_key, sizeof(held_acks[i].pub_key)) == 0) return i;
+  }
+  return -1;
+}
+
+void BaseChatMesh::checkHeldAcks() {
+  for (int i = 0; i < ACK_HOLD_SLOTS; i++) {
+    HeldAck* h = &held_acks[i];
+    if (h->in_use && millisHasNowPassed(h->due)) {   // no reply to carry it, so send on its own
+      h->in_use = false;
+      ContactInfo* dest = lookupContactByPubKey(h->pub_key, sizeof(h->pub_key));
+      if (dest) sendAckTo(*dest, h->ack_hash, 0);
+    }
+  }
+}
+
+void BaseChatMesh::recvPiggybackAck(mesh::Packet* packet, const uint8_t* data, size_t len, int txt_ofs) {
+  size_t t = txt_ofs + strlen((const char *) &data[txt_ofs]) + 1;   // skip text + null terminator
+  if (t + TXT_ACK_TRAILER_SIZE > len) return;   // no trailer
+
+  uint32_t ack_crc;
+  memcpy(&ack_crc, &data[t], TXT_ACK_TRAILER_SIZE);
+  if (ack_crc != 0) onAckRecv(packet, ack_crc);   // (a bogus one, eg. hidden attempt number, just won't match)
+}
+
+bool BaseChatMesh::isAdvertStale(const mesh::Identity& id, uint32_t timestamp) {
+  for (int i = contact_heads[id.pub_key[0]]; i >= 0; i = contact_next[i]) {
+    if (id.matches(contacts[i].id)) return timestamp <= contacts[i].last_advert_timestamp;   // replay, or unchanged
+  }
+  return false;
+}
+
 void BaseChatMesh::onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp, const uint8_t* app_data, size_t app_data_len) {
   AdvertDataParser parser(app_data, app_data_len);
   if (!(parser.isValid() && parser.hasName())) {
@@ -62,8 +127,18 @@ void BaseChatMesh::onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id,
     return;
   }
 
+  if ((packet->isRouteFlood() && packet->path_hash_size == PATH_HASH_SIZE) || packet->path_len == 0) {   // learn routes to the repeaters it came via
+    uint8_t path[MAX_PATH_SIZE];
+    int n = 0;
+    if (parser.getType() == ADV_TYPE_REPEATER && packet->path_len < MAX_PATH_SIZE) {
+      path[n++] = id.pub_key[0];   // and the advertising repeater itself
+    }
+    memcpy(&path[n], packet->path, packet->path_len); n += packet->path_len;
+    topology.learnFloodPath(path, n, self_id.pub_key[0], getRTCClock()->getCurrentTime());
+  }
+
   ContactInfo* from = NULL;
-  for (int i = 0; i < num_contacts; i++) {
+  for (int i = contact_heads[id.pub_key[0]]; i >= 0; i = contact_next[i]) {
     if (id.matches(contacts[i].id)) {  // is from one of our contacts
       from = &contacts[i];
       if (timestamp <= from->last_advert_timestamp) {  // check for replay attacks!!
@@ -74,6 +149,20 @@ void BaseChatMesh::onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id,
     }
   }
 
+  if (from) {   // (even if advert is otherwise unchanged)
+    setWideHash(from - contacts, parser.hasWideHash());
+    setAckPiggyback(from - contacts, parser.hasAckPiggyback());
+  }
+  if (packet->path_len == 0 && parser.getType() == ADV_TYPE_REPEATER) {
+    channel_load.onPeerLoad(parser.getChannelLoad(), _ms->getMillis());
+  }
+
+  if (isAdvertUnchanged(from, id, parser, app_data, app_data_len)) {   // eg. re-advert during a flood advert wave
+    if (from) from->last_advert_timestamp = timestamp;   // (still need this for replay checks, but no need to persist now)
+    n_adverts_coalesced++;
+    return;
+  }
+
   // save a copy of raw advert packet (to support "Share..." function)
   int plen;
   {
@@ -100,7 +189,7 @@ void BaseChatMesh::onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id,
       }
       ci.last_advert_timestamp = timestamp;
       ci.lastmod = getRTCClock()->getCurrentTime();
-      onDiscoveredContact(ci, true, packet->path_len, packet->path);       // let UI know
+      onDiscoveredContact(ci, true, packet->getEncodedPathLen(), packet->path);       // let UI know
       return;
     }
 
@@ -108,13 +197,17 @@ void BaseChatMesh::onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id,
     if (num_contacts < MAX_CONTACTS) {
       from = &contacts[num_contacts++];
       from->id = id;
+      indexContact(num_contacts - 1);
+      setWideHash(num_contacts - 1, parser.hasWideHash());
+      setAckPiggyback(num_contacts - 1, parser.hasAckPiggyback());
+      recent[num_contacts - 1] = num_contacts - 1;
       from->out_path_len = -1;  // initially out_path is unknown
       from->gps_lat = 0;   // initially unknown GPS loc
       from->gps_lon = 0;
       from->sync_since = 0;
 
       // only need to calculate the shared_secret once, for better performance
-      self_id.calcSharedSecret(from->shared_secret, id);
+      calcSharedSecret(from->shared_secret, id.pub_key);
     } else {
       MESH_DEBUG_PRINTLN("onAdvertRecv: contacts table is full!");
       return;
@@ -131,19 +224,98 @@ void BaseChatMesh::onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id,
   from->last_advert_timestamp = timestamp;
   from->lastmod = getRTCClock()->getCurrentTime();
 
-  onDiscoveredContact(*from, is_new, packet->path_len, packet->path);       // let UI know
+  onDiscoveredContact(*from, is_new, packet->getEncodedPathLen(), packet->path);       // let UI know
+}
+
+void BaseChatMesh::onAdvertRefreshRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp) {
+  for (int i = contact_heads[id.pub_key[0]]; i >= 0; i = contact_next[i]) {
+    if (id.matches(contacts[i].id)) {
+      if (timestamp > contacts[i].last_advert_timestamp) contacts[i].last_advert_timestamp = timestamp;   // (as a coalesced advert)
+      return;
+    }
+  }
+}
+
+static uint16_t calcAdvertSig(const uint8_t* app_data, size_t app_data_len) {
+  uint16_t sig = 0xA500 | (uint8_t) app_data_len;
+  for (size_t i = 0; i < app_data_len; i++) {
+    sig = (sig << 3 | sig >> 13) ^ app_data[i];
+  }
+  return sig;
+}
+
+bool BaseChatMesh::isAdvertUnchanged(const ContactInfo* from, const mesh::Identity& id, const AdvertDataParser& parser,
+                                     const uint8_t* app_data, size_t app_data_len) {
+  uint32_t now = getRTCClock()->getCurrentTime();
+  if (from) {
+    if (now < from->lastmod || now >= from->lastmod + ADVERT_COALESCE_SECS) return false;   // refresh stored advert now and then, regardless
+    if (strncmp(from->name, parser.getName(), sizeof(from->name) - 1) != 0 || from->type != parser.getType()) return false;
+    return !(parser.hasLatLon() && (from->gps_lat != parser.getIntLat() || from->gps_lon != parser.getIntLon()));
+  }
+
+  // not a contact (auto-add is off), so track the last few which were notified
+  uint16_t sig = calcAdvertSig(app_data, app_data_len);
+  RecentAdvert* r = NULL;
+  for (int i = 0; i < ADVERT_RECENT_SLOTS; i++) {
+    if (memcmp(recent_adverts[i].pub_key, id.pub_key, sizeof(r->pub_key)) == 0) {
+      r = &recent_adverts[i];
+      if (r->data_sig == sig && now >= r->notified_at && now < r->notified_at + ADVERT_COALESCE_SECS) return true;
+      break;
+    }
+  }
+  if (r == NULL) {   // round-robin
+    r = &recent_adverts[next_recent_advert];
+    next_recent_advert = (next_recent_advert + 1) % ADVERT_RECENT_SLOTS;
+    memcpy(r->pub_key, id.pub_key, sizeof(r->pub_key));
+  }
+  r->data_sig = sig;
+  r->notified_at = now;
+  return false;
+}
+
+void BaseChatMesh::indexContact(int idx) {
+  int16_t* p = &contact_heads[contacts[idx].id.pub_key[0]];
+  while (*p >= 0 && *p < idx) p = &contact_next[*p];   // insert, so buckets stay in contacts[] order
+  contact_next[idx] = *p;
+  *p = idx;
+}
+
+void BaseChatMesh::unindexContact(int idx) {
+  int16_t* p = &contact_heads[contacts[idx].id.pub_key[0]];
+  while (*p >= 0 && *p != idx) p = &contact_next[*p];
+  if (*p == idx) *p = contact_next[idx];
+}
+
+void BaseChatMesh::rebuildContactIndex() {
+  memset(contact_heads, 0xFF, sizeof(contact_heads));   // all -1
+  for (int i = 0; i < num_contacts; i++) {
+    indexContact(i);
+  }
 }
 
 int BaseChatMesh::searchPeersByHash(const uint8_t* hash) {
+  return searchPeersByHash(hash, PATH_HASH_SIZE);
+}
+
+int BaseChatMesh::searchPeersByHash(const uint8_t* hash, uint8_t hash_len) {
   int n = 0;
-  for (int i = 0; i < num_contacts && n < MAX_SEARCH_RESULTS; i++) {
-    if (contacts[i].id.isHashMatch(hash)) {
+  for (int i = contact_heads[hash[0]]; i >= 0 && n < MAX_SEARCH_RESULTS; i = contact_next[i]) {
+    if (contacts[i].id.isHashMatch(hash, hash_len)) {
       matching_peer_indexes[n++] = i;  // store the INDEXES of matching contacts (for subsequent 'peer' methods)
     }
   }
   return n;
 }
 
+bool BaseChatMesh::isWideHashPeer(const mesh::Identity& dest) {
+  if (getDatagramPayloadVer() < PAYLOAD_VER_2) return false;   // not using the newer (non back-compatible) formats
+
+  for (int i = contact_heads[dest.pub_key[0]]; i >= 0; i = contact_next[i]) {
+    if (dest.matches(contacts[i].id)) return hasWideHash(i);
+  }
+  return false;
+}
+
 void BaseChatMesh::getPeerSharedSecret(uint8_t* dest_secret, int peer_idx) {
   int i = matching_peer_indexes[peer_idx];
   if (i >= 0 && i < num_contacts) {
@@ -160,6 +332,7 @@ void BaseChatMesh::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender
     MESH_DEBUG_PRINTLN("onPeerDataRecv: Invalid sender idx: %d", i);
     return;
   }
+  if (packet->getPayloadVer() == PAYLOAD_VER_3) setWideHash(i, true);   // (in case we missed its advert)
 
   ContactInfo& from = contacts[i];
 
@@ -167,32 +340,45 @@ void BaseChatMesh::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender
     uint32_t timestamp;
     memcpy(&timestamp, data, 4);  // timestamp (by sender's RTC clock - which could be wrong)
     uint8_t flags = data[4] >> 2;   // message attempt number, and other flags
+    bool compressed = (flags & TXT_TYPE_COMPRESSED) != 0;
+    flags &= ~TXT_TYPE_COMPRESSED;
 
     // len can be > original length, but 'text' will be padded with zeroes
     data[len] = 0; // need to make a C string again, with null terminator
 
+    char text_buf[TXT_CODEC_MAX_TEXT+1];
+    if (compressed && flags == TXT_TYPE_SIGNED_PLAIN) {
+      if (len < 9 || TxtCodec::unpack((char *) &data[9], true, text_buf, sizeof(text_buf)) == NULL) flags = 0xFF;   // bad
+    } else if (compressed && TxtCodec::unpack((char *) &data[5], true, text_buf, sizeof(text_buf)) == NULL) {
+      flags = 0xFF;   // bad, so is dropped (with no ACK)
+    }
+
+    if (flags == TXT_TYPE_PLAIN || flags == TXT_TYPE_SIGNED_PLAIN) {
+      recvPiggybackAck(packet, data, len, flags == TXT_TYPE_SIGNED_PLAIN ? 9 : 5);
+    }
+
     if (flags == TXT_TYPE_PLAIN) {
       from.lastmod = getRTCClock()->getCurrentTime(); // update last heard time
-      onMessageRecv(from, packet, timestamp, (const char *) &data[5]);  // let UI know
+      onMessageRecv(from, packet, timestamp, compressed ? text_buf : (const char *) &data[5]);  // let UI know
 
       uint32_t ack_hash;    // calc truncated hash of the message timestamp + text + sender pub_key, to prove to sender that we got it
       mesh::Utils::sha256((uint8_t *) &ack_hash, 4, data, 5 + strlen((char *)&data[5]), from.id.pub_key, PUB_KEY_SIZE);
 
       if (packet->isRouteFlood()) {
         // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the ACK
-        mesh::Packet* path = createPathReturn(from.id, secret, packet->path, packet->path_len,
+        mesh::Packet* path = createPathReturn(from.id, secret, packet->path, packet->getEncodedPathLen(),
                                                 PAYLOAD_TYPE_ACK, (uint8_t *) &ack_hash, 4);
-        if (path) sendFloodScoped(from, path, TXT_ACK_DELAY);
+        if (path) sendFloodScoped(from, path, getAckDelay(packet, TXT_ACK_DELAY));
       } else {
-        sendAckTo(from, ack_hash);
+        holdAckTo(i, ack_hash);
       }
     } else if (flags == TXT_TYPE_CLI_DATA) {
-      onCommandDataRecv(from, packet, timestamp, (const char *) &data[5]);  // let UI know
+      onCommandDataRecv(from, packet, timestamp, compressed ? text_buf : (const char *) &data[5]);  // let UI know
       // NOTE: no ack expected for CLI_DATA replies
 
       if (packet->isRouteFlood()) {
         // let this sender know path TO here, so they can use sendDirect() (NOTE: no ACK as extra)
-        mesh::Packet* path = createPathReturn(from.id, secret, packet->path, packet->path_len, 0, NULL, 0);
+        mesh::Packet* path = createPathReturn(from.id, secret, packet->path, packet->getEncodedPathLen(), 0, NULL, 0);
         if (path) sendFloodScoped(from, path);
       }
     } else if (flags == TXT_TYPE_SIGNED_PLAIN) {
@@ -200,18 +386,18 @@ void BaseChatMesh::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender
         from.sync_since = timestamp;
       }
       from.lastmod = getRTCClock()->getCurrentTime(); // update last heard time
-      onSignedMessageRecv(from, packet, timestamp, &data[5], (const char *) &data[9]);  // let UI know
+      onSignedMessageRecv(from, packet, timestamp, &data[5], compressed ? text_buf : (const char *) &data[9]);  // let UI know
 
       uint32_t ack_hash;    // calc truncated hash of the message timestamp + text + OUR pub_key, to prove to sender that we got it
       mesh::Utils::sha256((uint8_t *) &ack_hash, 4, data, 9 + strlen((char *)&data[9]), self_id.pub_key, PUB_KEY_SIZE);
 
       if (packet->isRouteFlood()) {
         // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the ACK
-        mesh::Packet* path = createPathReturn(from.id, secret, packet->path, packet->path_len,
+        mesh::Packet* path = createPathReturn(from.id, secret, packet->path, packet->getEncodedPathLen(),
                                                 PAYLOAD_TYPE_ACK, (uint8_t *) &ack_hash, 4);
-        if (path) sendFloodScoped(from, path, TXT_ACK_DELAY);
+        if (path) sendFloodScoped(from, path, getAckDelay(packet, TXT_ACK_DELAY));
       } else {
-        sendAckTo(from, ack_hash);
+        holdAckTo(i, ack_hash);
       }
     } else {
       MESH_DEBUG_PRINTLN("onPeerDataRecv: unsupported message type: %u", (uint32_t) flags);
@@ -223,7 +409,7 @@ void BaseChatMesh::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender
     if (reply_len > 0) {
       if (packet->isRouteFlood()) {
         // let this sender know path TO here, so they can use sendDirect(), and ALSO encode the response
-        mesh::Packet* path = createPathReturn(from.id, secret, packet->path, packet->path_len,
+        mesh::Packet* path = createPathReturn(from.id, secret, packet->path, packet->getEncodedPathLen(),
                                               PAYLOAD_TYPE_RESPONSE, temp_buf, reply_len);
         if (path) sendFloodScoped(from, path, SERVER_RESPONSE_DELAY);
       } else {
@@ -238,10 +424,11 @@ void BaseChatMesh::onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender
       }
     }
   } else if (type == PAYLOAD_TYPE_RESPONSE && len > 0) {
+    checkLoginResponse(from, data, len);
     onContactResponse(from, data, len);
     if (packet->isRouteFlood() && from.out_path_len >= 0) {
       // we have direct path, but other node is still sending flood response, so maybe they didn't receive reciprocal path properly(?)
-      handleReturnPathRetry(from, packet->path, packet->path_len);
+      handleReturnPathRetry(from, packet->path, packet->getEncodedPathLen());
     }
   }
 }
@@ -252,44 +439,104 @@ bool BaseChatMesh::onPeerPathRecv(mesh::Packet* packet, int sender_idx, const ui
     MESH_DEBUG_PRINTLN("onPeerPathRecv: Invalid sender idx: %d", i);
     return false;
   }
+  if (packet->getPayloadVer() == PAYLOAD_VER_3) setWideHash(i, true);
 
   ContactInfo& from = contacts[i];
 
-  return onContactPathRecv(from, packet->path, packet->path_len, path, path_len, extra_type, extra, extra_len);
+  return onContactPathRecv(from, packet->path, packet->getEncodedPathLen(), path, path_len, extra_type, extra, extra_len);
 }
 
 bool BaseChatMesh::onContactPathRecv(ContactInfo& from, uint8_t* in_path, uint8_t in_path_len, uint8_t* out_path, uint8_t out_path_len, uint8_t extra_type, uint8_t* extra, uint8_t extra_len) {
   // NOTE: default impl, we just replace the current 'out_path' regardless, whenever sender sends us a new out_path.
-  // FUTURE: could store multiple out_paths per contact, and try to find which is the 'best'(?)
-  memcpy(from.out_path, out_path, from.out_path_len = out_path_len);  // store a copy of path, for sendDirect()
-  from.lastmod = getRTCClock()->getCurrentTime();
+  //       (unless a path discovery is collecting paths from sender, then the best is chosen later)
+  if (collectDiscoveredPaths(from, in_path, in_path_len, out_path, out_path_len)) {
+    from.lastmod = getRTCClock()->getCurrentTime();
+    topology.learnFloodPath(in_path, in_path_len, self_id.pub_key[0], from.lastmod);
+  } else {
+    memcpy(from.out_path, out_path, mesh::Packet::decodePathBytes(out_path_len));  // store a copy of path, for sendDirect()
+    from.out_path_len = out_path_len;
+    from.lastmod = getRTCClock()->getCurrentTime();
+
+    topology.learnFloodPath(in_path, in_path_len, self_id.pub_key[0], from.lastmod);
+    topology.learnDirectPath(out_path, out_path_len, self_id.pub_key[0], from.lastmod);
+    if (path_guess.pending && memcmp(from.id.pub_key, path_guess.pub_key, sizeof(path_guess.pub_key)) == 0) {
+      path_guess.pending = false;   // have a real path now
+    }
 
-  onContactPathUpdated(from);
+    onContactPathUpdated(from);
+  }
 
   if (extra_type == PAYLOAD_TYPE_ACK && extra_len >= 4) {
     // also got an encoded ACK!
-    if (processAck(extra) != NULL) {
-      txt_send_timeout = 0;   // matched one we're waiting for, cancel timeout timer
-    }
+    matchAck(extra);
   } else if (extra_type == PAYLOAD_TYPE_RESPONSE && extra_len > 0) {
+    checkLoginResponse(from, extra, extra_len);
     onContactResponse(from, extra, extra_len);
   }
   return true;  // send reciprocal path if necessary
 }
 
+ContactInfo* BaseChatMesh::matchAck(const uint8_t* data) {
+  for (int i = 0; i < MSG_SEND_QUEUE_SIZE; i++) {
+    QueuedMessage* msg = &send_queue[i];
+    if (msg->state == MSGQ_FREE) continue;
+
+    for (int k = 0; k <= msg->attempt; k++) {   // (could be a late ACK of an earlier attempt)
+      if (memcmp(data, &msg->acks[k], 4) != 0) continue;
+
+      ContactInfo* recipient = lookupContactByPubKey(msg->pub_key, sizeof(msg->pub_key));
+      if (k == msg->attempt && msg->state == MSGQ_AWAIT_ACK) recordRouteResult(msg->route_idx, msg->sent_at, true);
+      finishQueuedMessage(msg, recipient, true);
+      return recipient;
+    }
+  }
+
+  ContactInfo* from = processAck(data);
+  if (from) {
+    txt_send_timeout = 0;   // matched one we're waiting for, cancel timeout timer
+    recordRouteResult(true);
+  }
+  return from;
+}
+
 void BaseChatMesh::onAckRecv(mesh::Packet* packet, uint32_t ack_crc) {
   ContactInfo* from;
-  if ((from = processAck((uint8_t *)&ack_crc)) != NULL) {
-    txt_send_timeout = 0;   // matched one we're waiting for, cancel timeout timer
+  if ((from = matchAck((uint8_t *)&ack_crc)) != NULL) {
     packet->markDoNotRetransmit();   // ACK was for this node, so don't retransmit
 
+    if (path_guess.pending && memcmp(from->id.pub_key, path_guess.pub_key, sizeof(path_guess.pub_key)) == 0) {
+      adoptGuessedPath(*from);   // the guessed path worked
+    }
+
     if (packet->isRouteFlood() && from->out_path_len >= 0) {
       // we have direct path, but other node is still sending flood, so maybe they didn't receive reciprocal path properly(?)
-      handleReturnPathRetry(*from, packet->path, packet->path_len);
+      handleReturnPathRetry(*from, packet->path, packet->getEncodedPathLen());
     }
   }
 }
 
+void BaseChatMesh::routeFragmentAck(mesh::Packet* ack, const mesh::Packet* frag, int sender_idx) {
+  int i = matching_peer_indexes[sender_idx];
+  if (i >= 0 && i < num_contacts && contacts[i].out_path_len >= 0) {
+    sendDirect(ack, contacts[i].out_path, contacts[i].out_path_len);   // we have a path to sender
+  } else {
+    Mesh::routeFragmentAck(ack, frag, sender_idx);
+  }
+}
+
+void BaseChatMesh::onPeerFragmentedDataRecv(mesh::Packet* packet, uint8_t type, int sender_idx, const uint8_t* secret, uint8_t* data, size_t len) {
+  if (len <= MAX_PACKET_PAYLOAD) {
+    Mesh::onPeerFragmentedDataRecv(packet, type, sender_idx, secret, data, len);
+    return;
+  }
+  int i = matching_peer_indexes[sender_idx];
+  if (i >= 0 && i < num_contacts && type == PAYLOAD_TYPE_RESPONSE) {
+    onContactLargeResponse(contacts[i], data, len);
+  } else {
+    MESH_DEBUG_PRINTLN("onPeerFragmentedDataRecv: dropped, type=%d, len=%d", (uint32_t) type, (uint32_t) len);
+  }
+}
+
 void BaseChatMesh::handleReturnPathRetry(const ContactInfo& contact, const uint8_t* path, uint8_t path_len) {
   // NOTE: simplest impl is just to re-send a reciprocal return path to sender (DIRECTLY)
   //        override this method in various firmwares, if there's a better strategy
@@ -299,11 +546,10 @@ void BaseChatMesh::handleReturnPathRetry(const ContactInfo& contact, const uint8
 
 #ifdef MAX_GROUP_CHANNELS
 int BaseChatMesh::searchChannelsByHash(const uint8_t* hash, mesh::GroupChannel dest[], int max_matches) {
+  // NOTE: most group packets heard are for channels we don't have, which is just an empty bucket here
   int n = 0;
-  for (int i = 0; i < MAX_GROUP_CHANNELS && n < max_matches; i++) {
-    if (channels[i].channel.hash[0] == hash[0]) {
-      dest[n++] = channels[i].channel;
-    }
+  for (int i = channel_heads[hash[0]]; i >= 0 && n < max_matches; i = channel_next[i]) {
+    dest[n++] = channels[i].channel;
   }
   return n;
 }
@@ -311,15 +557,22 @@ int BaseChatMesh::searchChannelsByHash(const uint8_t* hash, mesh::GroupChannel d
 
 void BaseChatMesh::onGroupDataRecv(mesh::Packet* packet, uint8_t type, const mesh::GroupChannel& channel, uint8_t* data, size_t len) {
   uint8_t txt_type = data[4];
-  if (type == PAYLOAD_TYPE_GRP_TXT && len > 5 && (txt_type >> 2) == 0) {  // 0 = plain text msg
+  if (type == PAYLOAD_TYPE_GRP_TXT && len > 5 && ((txt_type >> 2) & ~TXT_TYPE_COMPRESSED) == 0) {  // 0 = plain text msg
     uint32_t timestamp;
     memcpy(&timestamp, data, 4);
 
     // len can be > original length, but 'text' will be padded with zeroes
     data[len] = 0; // need to make a C string again, with null terminator
 
+    char text_buf[TXT_CODEC_MAX_TEXT+1];
+    const char* text = TxtCodec::unpack((char *) &data[5], (txt_type >> 2) & TXT_TYPE_COMPRESSED, text_buf, sizeof(text_buf));
+    if (text == NULL) {
+      MESH_DEBUG_PRINTLN("onGroupDataRecv: bad compressed text");
+      return;
+    }
+
     // notify UI  of this new message
-    onChannelMessageRecv(channel, packet, timestamp, (const char *) &data[5]);  // let UI know
+    onChannelMessageRecv(channel, packet, timestamp, text);  // let UI know
   }
 }
 
@@ -328,21 +581,48 @@ mesh::Packet* BaseChatMesh::composeMsgPacket(const ContactInfo& recipient, uint3
   if (text_len > MAX_TEXT_LEN) return NULL;
   if (attempt > 3 && text_len > MAX_TEXT_LEN-2) return NULL;
 
-  uint8_t temp[5+MAX_TEXT_LEN+1];
+  uint8_t* temp;   // plaintext composed directly in the packet
+  int max_len;
+  mesh::Packet* pkt = beginDatagram(PAYLOAD_TYPE_TXT_MSG, recipient.id, temp, max_len);
+  if (pkt == NULL) return NULL;
+  if (max_len < 5 + MAX_TEXT_LEN + 2) {   // (can't happen, see MAX_TEXT_LEN)
+    releasePacket(pkt);
+    return NULL;
+  }
+
   memcpy(temp, &timestamp, 4);   // mostly an extra blob to help make packet_hash unique
   temp[4] = (attempt & 3);
   memcpy(&temp[5], text, text_len + 1);
 
-  // calc expected ACK reply
+#if TXT_COMPRESSION
+  if (attempt < 2) {   // later attempts are plain, incase recipient is older firmware
+    int n = TxtCodec::compress(&temp[5], MAX_TEXT_LEN, text, text_len);
+    if (n > 0) {
+      temp[4] |= (TXT_TYPE_COMPRESSED << 2);
+      temp[5 + n] = 0;
+      text_len = n;
+    }
+  }
+#endif
+
+  // calc expected ACK reply (NOTE: is of the text as sent, ie. compressed)
   mesh::Utils::sha256((uint8_t *)&expected_ack, 4, temp, 5 + text_len, self_id.pub_key, PUB_KEY_SIZE);
 
   int len = 5 + text_len;
   if (attempt > 3) {
     temp[len++] = 0;  // null terminator
     temp[len++] = attempt;  // hide attempt number at tail end of payload
+  } else {
+    int h = findHeldAck(recipient);
+    if (h >= 0 && len + 1 + TXT_ACK_TRAILER_SIZE <= max_len) {
+      temp[len++] = 0;  // null terminator
+      memcpy(&temp[len], &held_acks[h].ack_hash, TXT_ACK_TRAILER_SIZE);   // piggyback the ACK we owe them
+      len += TXT_ACK_TRAILER_SIZE;
+      held_acks[h].in_use = false;
+    }
   }
 
-  return createDatagram(PAYLOAD_TYPE_TXT_MSG, recipient.id, recipient.shared_secret, temp, len);
+  return finishDatagram(pkt, recipient.shared_secret, temp, len);
 }
 
 int  BaseChatMesh::sendMessage(const ContactInfo& recipient, uint32_t timestamp, uint8_t attempt, const char* text, uint32_t& expected_ack, uint32_t& est_timeout) {
@@ -352,7 +632,14 @@ int  BaseChatMesh::sendMessage(const ContactInfo& recipient, uint32_t timestamp,
   uint32_t t = _radio->getEstAirtimeFor(pkt->getRawLength());
 
   int rc;
-  if (recipient.out_path_len < 0) {
+  pending_route = -1;
+  path_guess.pending = false;
+  if (recipient.out_path_len < 0 && guessPathTo(recipient)) {   // no out_path yet, but can try one via known repeaters
+    sendDirect(pkt, path_guess.path, path_guess.path_len);
+    txt_send_timeout = futureMillis(est_timeout = calcDirectTimeoutMillisFor(t, path_guess.path_len));
+    path_guess.pending = true;
+    rc = MSG_SEND_SENT_DIRECT;
+  } else if (recipient.out_path_len < 0) {
     sendFloodScoped(recipient, pkt);
     txt_send_timeout = futureMillis(est_timeout = calcFloodTimeoutMillisFor(t));
     rc = MSG_SEND_SENT_FLOOD;
@@ -360,10 +647,112 @@ int  BaseChatMesh::sendMessage(const ContactInfo& recipient, uint32_t timestamp,
     sendDirect(pkt, recipient.out_path, recipient.out_path_len);
     txt_send_timeout = futureMillis(est_timeout = calcDirectTimeoutMillisFor(t, recipient.out_path_len));
     rc = MSG_SEND_SENT_DIRECT;
+
+    RouteStats* stats = findRouteStats(recipient, true);   // measure this route, by whether/when ACK comes back
+    if (stats) {
+      pending_route = stats - route_stats;
+      pending_sent_at = _ms->getMillis();
+    }
+  }
+  return rc;
+}
+
+int BaseChatMesh::sendQueuedAttempt(QueuedMessage* msg, const ContactInfo& recipient, uint32_t& est_timeout) {
+  mesh::Packet* pkt = composeMsgPacket(recipient, msg->timestamp, msg->attempt, msg->text, msg->acks[msg->attempt]);
+  if (pkt == NULL) return MSG_SEND_FAILED;
+
+  uint32_t t = _radio->getEstAirtimeFor(pkt->getRawLength());
+  msg->state = MSGQ_AWAIT_ACK;
+  msg->direct = recipient.out_path_len >= 0;
+  msg->route_idx = -1;
+  msg->sent_at = _ms->getMillis();
+  if (!msg->direct) {
+    sendFloodScoped(recipient, pkt);
+    msg->timeout = futureMillis(est_timeout = calcFloodTimeoutMillisFor(t));
+    return MSG_SEND_SENT_FLOOD;
+  }
+  sendDirect(pkt, recipient.out_path, recipient.out_path_len);
+  msg->timeout = futureMillis(est_timeout = calcDirectTimeoutMillisFor(t, recipient.out_path_len));
+
+  RouteStats* stats = findRouteStats(recipient, true);   // measure this route, as for sendMessage()
+  if (stats) msg->route_idx = stats - route_stats;
+  return MSG_SEND_SENT_DIRECT;
+}
+
+int  BaseChatMesh::sendMessageWithRetry(const ContactInfo& recipient, uint32_t timestamp, const char* text, uint32_t& expected_ack, uint32_t& est_timeout) {
+  if (strlen(text) > MAX_TEXT_LEN) return MSG_SEND_FAILED;
+
+  QueuedMessage* msg = NULL;
+  for (int i = 0; i < MSG_SEND_QUEUE_SIZE; i++) {
+    if (send_queue[i].state == MSGQ_FREE) { msg = &send_queue[i]; break; }
+  }
+  if (msg == NULL) return MSG_SEND_FAILED;   // queue is full
+
+  memset(msg, 0, sizeof(*msg));
+  msg->route_idx = -1;
+  memcpy(msg->pub_key, recipient.id.pub_key, sizeof(msg->pub_key));
+  msg->timestamp = timestamp;
+  strcpy(msg->text, text);
+  msg->first_sent = _ms->getMillis();
+
+  int rc = sendQueuedAttempt(msg, recipient, est_timeout);
+  if (rc == MSG_SEND_FAILED) {
+    msg->state = MSGQ_FREE;
+  } else {
+    expected_ack = msg->acks[0];
   }
   return rc;
 }
 
+int BaseChatMesh::getNumQueuedMessages() const {
+  int n = 0;
+  for (int i = 0; i < MSG_SEND_QUEUE_SIZE; i++) {
+    if (send_queue[i].state != MSGQ_FREE) n++;
+  }
+  return n;
+}
+
+void BaseChatMesh::finishQueuedMessage(QueuedMessage* msg, ContactInfo* recipient, bool delivered) {
+  msg->state = MSGQ_FREE;
+  onMessageSendResult(recipient, msg->acks[0], delivered, _ms->getMillis() - msg->first_sent, msg->attempt + 1);
+}
+
+void BaseChatMesh::checkSendQueue() {
+  for (int i = 0; i < MSG_SEND_QUEUE_SIZE; i++) {
+    QueuedMessage* msg = &send_queue[i];
+    if (msg->state == MSGQ_FREE || !millisHasNowPassed(msg->timeout)) continue;
+
+    ContactInfo* recipient = lookupContactByPubKey(msg->pub_key, sizeof(msg->pub_key));
+    if (msg->state == MSGQ_AWAIT_ACK) {   // no ACK
+      recordRouteResult(msg->route_idx, msg->sent_at, false);
+
+      if (recipient == NULL || msg->attempt + 1 >= MSG_RETRY_MAX_ATTEMPTS) {
+        finishQueuedMessage(msg, recipient, false);
+        continue;
+      }
+      if (msg->direct && recipient->out_path_len >= 0 && msg->attempt + 1 >= MSG_RETRY_FLOOD_AFTER) {
+        if (!useAltPath(*recipient)) resetPathTo(*recipient);   // rest of attempts are by flood (or alternate path)
+        onContactPathUpdated(*recipient);
+      }
+      uint32_t backoff = channel_load.scaleDelay(MSG_RETRY_BACKOFF_MILLIS << msg->attempt, _ms->getMillis());   // back off further when congested
+      msg->timeout = futureMillis(backoff + getRNG()->nextInt(0, backoff));
+      msg->state = MSGQ_BACKOFF;
+    } else {   // MSGQ_BACKOFF, time for next attempt
+      if (recipient == NULL) {
+        finishQueuedMessage(msg, NULL, false);
+        continue;
+      }
+      msg->attempt++;
+      uint32_t est_timeout;
+      if (sendQueuedAttempt(msg, *recipient, est_timeout) == MSG_SEND_FAILED) {
+        msg->attempt--;
+        msg->timeout = futureMillis(MSG_RETRY_BACKOFF_MILLIS);   // eg. packet pool exhausted, try again shortly
+        msg->state = MSGQ_BACKOFF;
+      }
+    }
+  }
+}
+
 int  BaseChatMesh::sendCommandData(const ContactInfo& recipient, uint32_t timestamp, uint8_t attempt, const char* text, uint32_t& est_timeout) {
   int text_len = strlen(text);
   if (text_len > MAX_TEXT_LEN) return MSG_SEND_FAILED;
@@ -403,7 +792,18 @@ bool BaseChatMesh::sendGroupMessage(uint32_t timestamp, mesh::GroupChannel& chan
   memcpy(ep, text, text_len);
   ep[text_len] = 0;  // null terminator
 
-  auto pkt = createGroupDatagram(PAYLOAD_TYPE_GRP_TXT, channel, temp, 5 + prefix_len + text_len);
+  int len = 5 + prefix_len + text_len;
+#if TXT_COMPRESSION
+  uint8_t packed[MAX_TEXT_LEN];
+  int n = TxtCodec::compress(packed, sizeof(packed), (const char *) &temp[5], prefix_len + text_len);
+  if (n > 0) {
+    temp[4] |= (TXT_TYPE_COMPRESSED << 2);
+    memcpy(&temp[5], packed, n);
+    len = 5 + n;
+  }
+#endif
+
+  auto pkt = createGroupDatagram(PAYLOAD_TYPE_GRP_TXT, channel, temp, len);
   if (pkt) {
     sendFloodScoped(channel, pkt);
     return true;
@@ -430,23 +830,76 @@ uint8_t BaseChatMesh::exportContact(const ContactInfo& contact, uint8_t dest_buf
 }
 
 bool BaseChatMesh::importContact(const uint8_t src_buf[], uint8_t len) {
-  auto pkt = obtainNewPacket();
-  if (pkt) {
-    if (pkt->readFrom(src_buf, len) && pkt->getPayloadType() == PAYLOAD_TYPE_ADVERT) {
-      pkt->header |= ROUTE_TYPE_FLOOD;   // simulate it being received flood-mode
-      getTables()->clear(pkt);  // remove packet hash from table, so we can receive/process it again
-      _pendingLoopback = pkt;  // loop-back, as if received over radio
-      return true;  // success
-    } else {
-      releasePacket(pkt);   // undo the obtainNewPacket()
-    }
+  mesh::Packet pkt;
+  if (pkt.readFrom(src_buf, len) && pkt.getPayloadType() == PAYLOAD_TYPE_ADVERT) {
+    memcpy(loopback_buf, src_buf, loopback_len = len);  // loop-back, as if received over radio (no pool Packet needed till then)
+    return true;  // success
   }
   return false; // error
 }
 
+bool BaseChatMesh::importContactNow(const uint8_t src_buf[], uint8_t len) {
+  mesh::Packet pkt;
+  if (pkt.readFrom(src_buf, len) && pkt.getPayloadType() == PAYLOAD_TYPE_ADVERT) {
+    pkt.header |= ROUTE_TYPE_FLOOD;   // simulate it being received flood-mode
+    getTables()->clear(&pkt);  // remove packet hash from table, so we can receive/process it again
+    onRecvPacket(&pkt);  // as if received over radio (is never retransmitted, as not from pool)
+    return true;
+  }
+  return false; // error
+}
+
+LoginTicket* BaseChatMesh::findLoginTicket(const ContactInfo& server, bool alloc) {
+  for (int i = 0; i < LOGIN_TICKET_SLOTS; i++) {
+    LoginTicket* t = &login_tickets[i];
+    if (t->in_use && memcmp(t->pub_key, server.id.pub_key, sizeof(t->pub_key)) == 0) return t;
+  }
+  if (!alloc) return NULL;
+
+  LoginTicket* t = &login_tickets[next_login_ticket];   // recycle oldest
+  next_login_ticket = (next_login_ticket + 1) % LOGIN_TICKET_SLOTS;
+  memset(t, 0, sizeof(*t));
+  memcpy(t->pub_key, server.id.pub_key, sizeof(t->pub_key));
+  t->in_use = true;
+  return t;
+}
+
+void BaseChatMesh::checkLoginResponse(const ContactInfo& from, const uint8_t* data, uint8_t len) {
+  LoginTicket* t = findLoginTicket(from, false);
+  if (t == NULL || !t->pending) return;
+
+  if (len >= 13 && data[4] == RESP_SERVER_LOGIN_OK) {
+    t->pending = false;
+    if (data[12] >= LOGIN_TICKET_VER_LEVEL) {   // older firmware just has a random blob here
+      memcpy(&t->ticket, &data[8], 4);
+      t->has_ticket = true;
+    }
+  }
+}
+
 int BaseChatMesh::sendLogin(const ContactInfo& recipient, const char* password, uint32_t& est_timeout) {
+  uint16_t pass_hash;
+  mesh::Utils::sha256((uint8_t *) &pass_hash, sizeof(pass_hash), (const uint8_t *) password, strlen(password));
+  LoginTicket* lt = findLoginTicket(recipient, true);
+
   mesh::Packet* pkt;
-  {
+  if (lt->has_ticket && lt->pass_hash == pass_hash) {
+    // resume previous session, with a plain REQ (server already has our shared secret, so no ECDH needed there)
+    lt->has_ticket = false;   // one use only, if this fails the next login is a full one
+    int tlen;
+    uint8_t temp[13];
+    uint32_t now = getRTCClock()->getCurrentTimeUnique();
+    memcpy(temp, &now, 4);
+    temp[4] = REQ_TYPE_RESUME_LOGIN;
+    memcpy(&temp[5], &lt->ticket, 4);
+    if (recipient.type == ADV_TYPE_ROOM) {
+      memcpy(&temp[9], &recipient.sync_since, 4);
+      tlen = 13;
+    } else {
+      tlen = 9;
+    }
+    pkt = createDatagram(PAYLOAD_TYPE_REQ, recipient.id, recipient.shared_secret, temp, tlen);
+  } else {
     int tlen;
     uint8_t temp[24];
     uint32_t now = getRTCClock()->getCurrentTimeUnique();
@@ -464,6 +917,9 @@ int BaseChatMesh::sendLogin(const ContactInfo& recipient, const char* password,
 
     pkt = createAnonDatagram(PAYLOAD_TYPE_ANON_REQ, self_id, recipient.id, recipient.shared_secret, temp, tlen);
   }
+  lt->pass_hash = pass_hash;
+  lt->pending = true;
+
   if (pkt) {
     uint32_t t = _radio->getEstAirtimeFor(pkt->getRawLength());
     if (recipient.out_path_len < 0) {
@@ -551,6 +1007,7 @@ bool BaseChatMesh::startConnection(const ContactInfo& contact, uint16_t keep_ali
   connections[use_idx].next_ping = futureMillis(interval);
   connections[use_idx].expected_ack = 0;
   connections[use_idx].last_activity = getRTCClock()->getCurrentTime();
+  if ((long)(connections[use_idx].next_ping - next_conn_check) < 0) next_conn_check = connections[use_idx].next_ping;
   return true;  // success
 }
 
@@ -602,12 +1059,41 @@ ContactInfo* BaseChatMesh::checkConnectionsAck(const uint8_t* data) {
   return NULL;  /// no match
 }
 
+void BaseChatMesh::sendKeepAlive(ConnectionInfo& conn, const ContactInfo& contact) {
+  uint8_t data[9];
+  uint32_t now = getRTCClock()->getCurrentTimeUnique();
+  memcpy(data, &now, 4);
+  data[4] = REQ_TYPE_KEEP_ALIVE;
+  memcpy(&data[5], &contact.sync_since, 4);
+
+  // calc expected ACK reply
+  mesh::Utils::sha256((uint8_t *)&conn.expected_ack, 4, data, 9, self_id.pub_key, PUB_KEY_SIZE);
+
+  auto pkt = createDatagram(PAYLOAD_TYPE_REQ, contact.id, contact.shared_secret, data, 9);
+  if (pkt) {
+    sendDirect(pkt, contact.out_path, contact.out_path_len);
+  }
+
+  // schedule next KEEP_ALIVE
+  conn.next_ping = futureMillis(conn.keep_alive_millis);
+}
+
+static bool isSamePath(const ContactInfo* a, const ContactInfo* b) {
+  return a->out_path_len == b->out_path_len
+      && memcmp(a->out_path, b->out_path, mesh::Packet::decodePathBytes(a->out_path_len)) == 0;
+}
+
 void BaseChatMesh::checkConnections() {
+  if (!millisHasNowPassed(next_conn_check)) return;   // no ping or expiry due yet
+
   // scan connections[] table, send KEEP_ALIVE requests
+  // NOTE: contacts are looked up (via the hash index) only for pings due, as contacts[] can be compacted under us
+  uint32_t now = getRTCClock()->getCurrentTime();
+  const ContactInfo* pinged[MAX_CONNECTIONS];
+  int num_pinged = 0;
   for (int i = 0; i < MAX_CONNECTIONS; i++) {
     if (connections[i].keep_alive_millis == 0) continue;  // unused slot
 
-    uint32_t now = getRTCClock()->getCurrentTime();
     uint32_t expire_secs = (connections[i].keep_alive_millis / 1000) * 5 / 2;   // 2.5 x keep_alive interval
     if (now >= connections[i].last_activity + expire_secs) {
       // connection now lost
@@ -628,48 +1114,414 @@ void BaseChatMesh::checkConnections() {
         MESH_DEBUG_PRINTLN("checkConnections(): Keep_alive contact, no out_path!");
         continue;
       }
+      sendKeepAlive(connections[i], *contact);
+      pinged[num_pinged++] = contact;
+    }
+  }
+
+  if (num_pinged > 0) {
+    // coalesce: servers on the same path as one just pinged, which are due soon anyway, get theirs now too
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+      if (connections[i].keep_alive_millis == 0) continue;
+      if ((long)(connections[i].next_ping - futureMillis(connections[i].keep_alive_millis / KEEP_ALIVE_COALESCE_DIV)) > 0) continue;
 
-      // send KEEP_ALIVE request
-      uint8_t data[9];
-      uint32_t now = getRTCClock()->getCurrentTimeUnique();
-      memcpy(data, &now, 4);
-      data[4] = REQ_TYPE_KEEP_ALIVE;
-      memcpy(&data[5], &contact->sync_since, 4);
-    
-      // calc expected ACK reply
-      mesh::Utils::sha256((uint8_t *)&connections[i].expected_ack, 4, data, 9, self_id.pub_key, PUB_KEY_SIZE);
-
-      auto pkt = createDatagram(PAYLOAD_TYPE_REQ, contact->id, contact->shared_secret, data, 9);
-      if (pkt) {
-        sendDirect(pkt, contact->out_path, contact->out_path_len);
+      auto contact = lookupContactByPubKey(connections[i].server_id.pub_key, PUB_KEY_SIZE);
+      if (contact == NULL || contact->out_path_len < 0) continue;
+      for (int k = 0; k < num_pinged; k++) {
+        if (pinged[k] != contact && isSamePath(pinged[k], contact)) {
+          sendKeepAlive(connections[i], *contact);
+          break;
+        }
       }
-    
-      // schedule next KEEP_ALIVE
-      connections[i].next_ping = futureMillis(connections[i].keep_alive_millis);
     }
   }
+
+  // work out when next to look, from the soonest ping or expiry
+  next_conn_check = futureMillis(CONN_CHECK_MAX_MILLIS);
+  for (int i = 0; i < MAX_CONNECTIONS; i++) {
+    if (connections[i].keep_alive_millis == 0) continue;
+
+    if ((long)(connections[i].next_ping - next_conn_check) < 0) next_conn_check = connections[i].next_ping;
+    uint32_t expire_at = connections[i].last_activity + (connections[i].keep_alive_millis / 1000) * 5 / 2;
+    unsigned long t = futureMillis(expire_at > now ? (expire_at - now) * 1000 : 0);
+    if ((long)(t - next_conn_check) < 0) next_conn_check = t;
+  }
 }
 
 void BaseChatMesh::resetPathTo(ContactInfo& recipient) {
   recipient.out_path_len = -1;
+  AltPath* alt = findAltPath(recipient.id.pub_key, false);
+  if (alt) memset(alt, 0, sizeof(*alt));   // flood next time, to find new paths
+}
+
+static uint16_t calcPathSig(const ContactInfo& contact) {
+  uint16_t sig = 0x5A00 | (uint8_t) contact.out_path_len;
+  for (int i = 0; i < mesh::Packet::decodePathBytes(contact.out_path_len); i++) {
+    sig = (sig << 3 | sig >> 13) ^ contact.out_path[i];
+  }
+  return sig;
+}
+
+RouteStats* BaseChatMesh::findRouteStats(const ContactInfo& contact, bool create) {
+  if (contact.out_path_len < 0) return NULL;   // no route
+
+  uint16_t sig = calcPathSig(contact);
+  RouteStats* lru = &route_stats[0];
+  for (int i = 0; i < ROUTE_STATS_SLOTS; i++) {
+    RouteStats* s = &route_stats[i];
+    if (s->last_used && memcmp(s->pub_key, contact.id.pub_key, sizeof(s->pub_key)) == 0) {
+      if (s->path_sig != sig) {   // path has changed since, start over
+        lru = s;
+        break;
+      }
+      return s;
+    }
+    if (s->last_used < lru->last_used) lru = s;
+  }
+  if (!create) return NULL;
+
+  if (pending_route == lru - route_stats) pending_route = -1;   // slot is being re-used
+  for (int i = 0; i < MSG_SEND_QUEUE_SIZE; i++) {
+    if (send_queue[i].route_idx == lru - route_stats) send_queue[i].route_idx = -1;
+  }
+  memset(lru, 0, sizeof(*lru));
+  memcpy(lru->pub_key, contact.id.pub_key, sizeof(lru->pub_key));
+  lru->path_sig = sig;
+  lru->success = 255;   // assume good, until shown otherwise
+  lru->min_snr = 127;
+  lru->last_used = _ms->getMillis() | 1;
+  return lru;
+}
+
+void BaseChatMesh::recordRouteResult(bool acked) {
+  if (pending_route < 0) return;
+  int idx = pending_route;
+  pending_route = -1;
+  recordRouteResult(idx, pending_sent_at, acked);
+}
+
+void BaseChatMesh::recordRouteResult(int route_idx, unsigned long sent_at, bool acked) {
+  if (route_idx < 0) return;
+  RouteStats* s = &route_stats[route_idx];
+
+  if (acked) {
+    s->success += (255 - s->success) / 4;
+    uint32_t latency = _ms->getMillis() - sent_at;
+    if (latency > 0xFFFF) latency = 0xFFFF;
+    s->ack_latency = s->n_samples == 0 ? latency : (3*(uint32_t)s->ack_latency + latency) / 4;
+  } else {
+    s->success -= (s->success + 3) / 4;
+  }
+  if (s->n_samples < 255) s->n_samples++;
+  s->last_used = _ms->getMillis() | 1;
+}
+
+bool BaseChatMesh::sendTraceProbe(const uint8_t* path, uint8_t path_len, uint32_t& tag, unsigned long& timeout) {
+  // TRACE out along the path, then back along the reverse, so it returns to here with the SNR of each hop
+  int n = mesh::Packet::decodePathHops(path_len);
+  int sz = mesh::Packet::decodePathHashSize(path_len);
+  if (n == 0 || (2*n - 1)*sz >= MAX_PATH_SIZE) return false;   // nothing to trace, or too long
+
+  uint8_t hashes[MAX_PATH_SIZE];
+  memcpy(hashes, path, n*sz);
+  for (int i = 0; i < n - 1; i++) {
+    memcpy(&hashes[(n + i)*sz], &path[(n - 2 - i)*sz], sz);
+  }
+
+  getRNG()->random((uint8_t *) &tag, 4);
+  if (tag == 0) tag = 1;
+  mesh::Packet* pkt = createTrace(tag, 0, sz == WIDE_HASH_SIZE ? 1 : 0);   // lower 2 bits of flags: hash size is 1 << bits
+  if (pkt == NULL) return false;
+
+  uint32_t t = _radio->getEstAirtimeFor(pkt->getRawLength() + (2*n - 1)*(sz + 1));
+  sendDirect(pkt, hashes, (2*n - 1)*sz);
+
+  timeout = futureMillis(calcDirectTimeoutMillisFor(t, 2*n - 1));
+  return true;
+}
+
+bool BaseChatMesh::sendRouteProbe(RouteStats* stats, const ContactInfo& contact) {
+  if (!sendTraceProbe(contact.out_path, contact.out_path_len, stats->probe_tag, stats->probe_timeout)) return false;
+
+  stats->last_probe = _ms->getMillis() | 1;
+  return true;
+}
+
+static int8_t calcProbeMinSNR(const mesh::Packet* packet, const uint8_t* path_snrs) {
+  int8_t min_snr = (int8_t) (packet->getSNR() * 4);   // final hop, back to here
+  for (int k = 0; k < packet->path_len; k++) {   // SNR as heard by each hop
+    if ((int8_t) path_snrs[k] < min_snr) min_snr = (int8_t) path_snrs[k];
+  }
+  return min_snr;
+}
+
+bool BaseChatMesh::checkRouteProbe(mesh::Packet* packet, uint32_t tag, uint8_t flags, const uint8_t* path_snrs, uint8_t path_len) {
+  if (tag == 0) return false;
+
+  if (path_disc.state == PATH_DISC_PROBING) {
+    for (int i = 0; i < path_disc.num_paths; i++) {
+      PathCandidate* c = &path_disc.paths[i];
+      if (c->probe_tag != tag) continue;
+
+      c->probe_tag = 0;
+      c->min_snr = calcProbeMinSNR(packet, path_snrs);
+      return true;
+    }
+  }
+
+  for (int i = 0; i < ROUTE_STATS_SLOTS; i++) {
+    RouteStats* s = &route_stats[i];
+    if (s->last_used == 0 || s->probe_tag != tag) continue;
+
+    s->probe_tag = 0;
+    int8_t min_snr = calcProbeMinSNR(packet, path_snrs);
+    s->min_snr = min_snr;
+    if (s->success < ROUTE_DEGRADED_SUCCESS) s->success = ROUTE_DEGRADED_SUCCESS;   // path is still there, give it another chance
+
+    ContactInfo* contact = lookupContactByPubKey(s->pub_key, sizeof(s->pub_key));
+    if (contact && contact->out_path_len >= 0 && calcPathSig(*contact) == s->path_sig) {
+      if (min_snr < ROUTE_DEGRADED_SNR) {
+        onRouteDegraded(*contact);
+      } else {
+        topology.learnDirectPath(contact->out_path, contact->out_path_len, self_id.pub_key[0], getRTCClock()->getCurrentTime());
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+void BaseChatMesh::onTraceRecv(mesh::Packet* packet, uint32_t tag, uint32_t auth_code, uint8_t flags, const uint8_t* path_snrs, const uint8_t* path_hashes, uint8_t path_len) {
+  checkRouteProbe(packet, tag, flags, path_snrs, path_len);
+}
+
+void BaseChatMesh::onRouteDegraded(ContactInfo& contact) {
+  if (!useAltPath(contact)) resetPathTo(contact);
+  onContactPathUpdated(contact);
 }
 
-static ContactInfo* table;  // pass via global :-(
+AltPath* BaseChatMesh::findAltPath(const uint8_t* pub_key, bool create) {
+  AltPath* lru = &alt_paths[0];
+  for (int i = 0; i < ALT_PATH_SLOTS; i++) {
+    AltPath* a = &alt_paths[i];
+    if (a->last_used && memcmp(a->pub_key, pub_key, sizeof(a->pub_key)) == 0) return a;
+    if (a->last_used < lru->last_used) lru = a;
+  }
+  if (!create) return NULL;
+
+  memset(lru, 0, sizeof(*lru));
+  memcpy(lru->pub_key, pub_key, sizeof(lru->pub_key));
+  return lru;
+}
+
+bool BaseChatMesh::useAltPath(ContactInfo& contact) {
+  AltPath* alt = findAltPath(contact.id.pub_key, false);
+  if (alt == NULL) return false;
+
+  memcpy(contact.out_path, alt->path, mesh::Packet::decodePathBytes(alt->path_len));
+  contact.out_path_len = alt->path_len;
+  memset(alt, 0, sizeof(*alt));   // just the one failover, then flood to find new paths
+  return true;
+}
+
+void BaseChatMesh::startPathDiscovery(const ContactInfo& contact, uint32_t timeout_millis) {
+  memset(&path_disc, 0, sizeof(path_disc));   // NOTE: just one at a time, any previous one is abandoned
+  memcpy(path_disc.pub_key, contact.id.pub_key, sizeof(path_disc.pub_key));
+  path_disc.state = PATH_DISC_COLLECTING;
+  path_disc.deadline = futureMillis(timeout_millis);
+}
+
+void BaseChatMesh::addPathCandidate(const uint8_t* path, uint8_t path_len) {
+  if (mesh::Packet::decodePathBytes(path_len) > MAX_PATH_SIZE) return;
+
+  for (int i = 0; i < path_disc.num_paths; i++) {
+    PathCandidate* c = &path_disc.paths[i];
+    if (c->path_len == path_len && memcmp(c->path, path, mesh::Packet::decodePathBytes(path_len)) == 0) return;   // already have it
+  }
+  if (path_disc.num_paths >= PATH_DISCOVERY_MAX_PATHS) return;
+
+  PathCandidate* c = &path_disc.paths[path_disc.num_paths++];
+  memcpy(c->path, path, mesh::Packet::decodePathBytes(path_len));
+  c->path_len = path_len;
+  c->min_snr = 127;
+}
+
+bool BaseChatMesh::collectDiscoveredPaths(const ContactInfo& from, const uint8_t* in_path, uint8_t in_path_len, const uint8_t* out_path, uint8_t out_path_len) {
+  if (path_disc.state != PATH_DISC_COLLECTING || memcmp(from.id.pub_key, path_disc.pub_key, sizeof(path_disc.pub_key)) != 0) {
+    return false;
+  }
+  if (path_disc.num_paths == 0) {
+    path_disc.deadline = futureMillis(PATH_DISCOVERY_COLLECT_MILLIS);   // got first reply, now wait for any others
+  }
+  addPathCandidate(out_path, out_path_len);
+
+  if (mesh::Packet::decodePathBytes(in_path_len) <= MAX_PATH_SIZE) {
+    // the path the reply took back to here, reversed, is also a path to sender
+    uint8_t reverse[MAX_PATH_SIZE];
+    reversePath(reverse, in_path, in_path_len);
+    addPathCandidate(reverse, in_path_len);
+  }
+  return true;
+}
+
+void BaseChatMesh::checkPathDiscovery() {
+  if (path_disc.state == PATH_DISC_COLLECTING) {
+    if (!millisHasNowPassed(path_disc.deadline)) return;
+
+    if (path_disc.num_paths == 0) {   // no reply
+      path_disc.state = PATH_DISC_IDLE;
+      return;
+    }
+    for (int i = 0; i < path_disc.num_paths; i++) {
+      PathCandidate* c = &path_disc.paths[i];
+      sendTraceProbe(c->path, c->path_len, c->probe_tag, c->probe_timeout);   // (zero hop paths aren't probed)
+    }
+    path_disc.state = PATH_DISC_PROBING;
+  }
+  if (path_disc.state == PATH_DISC_PROBING) {
+    for (int i = 0; i < path_disc.num_paths; i++) {
+      PathCandidate* c = &path_disc.paths[i];
+      if (c->probe_tag == 0) continue;
+      if (!millisHasNowPassed(c->probe_timeout)) return;   // still waiting on this one
+
+      c->probe_tag = 0;
+      c->failed = true;
+    }
+    selectDiscoveredPaths();
+    path_disc.state = PATH_DISC_IDLE;
+  }
+}
+
+static bool isBetterCandidate(const PathCandidate* a, const PathCandidate* b) {
+  if (a->failed != b->failed) return b->failed;
+  uint8_t a_hops = mesh::Packet::decodePathHops(a->path_len), b_hops = mesh::Packet::decodePathHops(b->path_len);
+  if (a_hops != b_hops) return a_hops < b_hops;   // fewest hops
+  return a->min_snr != 127 && (b->min_snr == 127 || a->min_snr > b->min_snr);   // then strongest weakest hop
+}
+
+void BaseChatMesh::selectDiscoveredPaths() {
+  ContactInfo* contact = lookupContactByPubKey(path_disc.pub_key, sizeof(path_disc.pub_key));
+  if (contact == NULL) return;   // removed since
+
+  // rank, by insertion sort (only a few)
+  PathCandidate* ranked[PATH_DISCOVERY_MAX_PATHS];
+  int n = 0;
+  for (int i = 0; i < path_disc.num_paths; i++) {
+    PathCandidate* c = &path_disc.paths[i];
+    int j = n++;
+    while (j > 0 && isBetterCandidate(c, ranked[j - 1])) {
+      ranked[j] = ranked[j - 1];
+      j--;
+    }
+    ranked[j] = c;
+  }
+  if (n == 0) return;
+
+  // NOTE: if all probes failed, the best by hops is still taken (the PATH replies did get here)
+  memcpy(contact->out_path, ranked[0]->path, mesh::Packet::decodePathBytes(ranked[0]->path_len));
+  contact->out_path_len = ranked[0]->path_len;
+  contact->lastmod = getRTCClock()->getCurrentTime();
+  if (!ranked[0]->failed) topology.learnDirectPath(contact->out_path, contact->out_path_len, self_id.pub_key[0], contact->lastmod);
+
+  if (n > 1 && !ranked[1]->failed) {
+    AltPath* alt = findAltPath(contact->id.pub_key, true);
+    memcpy(alt->path, ranked[1]->path, mesh::Packet::decodePathBytes(ranked[1]->path_len));
+    alt->path_len = ranked[1]->path_len;
+    alt->last_used = _ms->getMillis() | 1;
+  } else {
+    AltPath* alt = findAltPath(contact->id.pub_key, false);
+    if (alt) memset(alt, 0, sizeof(*alt));
+  }
+  onContactPathUpdated(*contact);
+}
+
+bool BaseChatMesh::guessPathTo(const ContactInfo& contact) {
+  if (!isPathGuessEnabled()) return false;
 
-static int cmp_adv_timestamp(const void *a, const void *b) {
-  int a_idx = *((int *)a);
-  int b_idx = *((int *)b);
-  if (table[b_idx].last_advert_timestamp > table[a_idx].last_advert_timestamp) return 1;
-  if (table[b_idx].last_advert_timestamp < table[a_idx].last_advert_timestamp) return -1;
-  return 0;
+  uint32_t now = getRTCClock()->getCurrentTime();
+  if (now - contact.lastmod > TOPO_ADVERT_MAX_AGE) return false;   // not heard from recently, may have moved
+  if (memcmp(contact.id.pub_key, failed_guess_key, sizeof(failed_guess_key)) == 0 && contact.lastmod == failed_guess_lastmod) {
+    return false;   // already failed, for same advert
+  }
+
+  int plen = getBlobByKey(contact.id.pub_key, PUB_KEY_SIZE, temp_buf);  // retrieve last raw advert packet
+  mesh::Packet adv;
+  if (plen == 0 || !adv.readFrom(temp_buf, plen) || adv.getPayloadType() != PAYLOAD_TYPE_ADVERT) return false;
+
+  int via;
+  int n = topology.buildPath(adv.path, adv.path_len, path_guess.path, &via, now);
+  if (n > TOPO_MAX_GUESS_HOPS) return false;   // too long to risk a direct timeout on
+
+  memcpy(path_guess.pub_key, contact.id.pub_key, sizeof(path_guess.pub_key));
+  path_guess.path_len = n;
+  path_guess.via_hash = via;
+  return true;
+}
+
+void BaseChatMesh::adoptGuessedPath(ContactInfo& contact) {
+  path_guess.pending = false;
+  memcpy(contact.out_path, path_guess.path, contact.out_path_len = path_guess.path_len);
+  contact.lastmod = getRTCClock()->getCurrentTime();
+  topology.learnDirectPath(contact.out_path, contact.out_path_len, self_id.pub_key[0], contact.lastmod);
+
+  onContactPathUpdated(contact);
+}
+
+void BaseChatMesh::onGuessedPathFailed() {
+  path_guess.pending = false;
+  if (path_guess.via_hash >= 0) topology.forget(path_guess.via_hash);
+
+  ContactInfo* contact = lookupContactByPubKey(path_guess.pub_key, sizeof(path_guess.pub_key));
+  if (contact) {
+    memcpy(failed_guess_key, path_guess.pub_key, sizeof(failed_guess_key));   // flood next time, until a newer advert
+    failed_guess_lastmod = contact->lastmod;
+  }
+}
+
+void BaseChatMesh::checkRouteProbes() {
+  for (int i = 0; i < ROUTE_STATS_SLOTS; i++) {
+    RouteStats* s = &route_stats[i];
+    if (s->last_used == 0 || s->probe_tag == 0 || !millisHasNowPassed(s->probe_timeout)) continue;
+
+    // probe never returned, route is broken
+    ContactInfo* contact = lookupContactByPubKey(s->pub_key, sizeof(s->pub_key));
+    bool same_path = contact && contact->out_path_len >= 0 && calcPathSig(*contact) == s->path_sig;
+    if (pending_route == i) pending_route = -1;
+    memset(s, 0, sizeof(*s));
+    if (same_path) onRouteDegraded(*contact);
+  }
+
+  if (!millisHasNowPassed(next_probe_check)) return;
+  next_probe_check = futureMillis(ROUTE_PROBE_CHECK_MILLIS);
+
+  for (int i = 0; i < ROUTE_STATS_SLOTS; i++) {
+    RouteStats* s = &route_stats[i];
+    if (s->last_used == 0 || s->probe_tag != 0 || i == pending_route) continue;
+    if (s->last_probe && _ms->getMillis() - s->last_probe < ROUTE_PROBE_MIN_INTERVAL) continue;
+
+    bool degraded = (s->n_samples >= 2 && s->success < ROUTE_DEGRADED_SUCCESS) || (s->min_snr != 127 && s->min_snr < ROUTE_DEGRADED_SNR);
+    if (!degraded) continue;
+
+    ContactInfo* contact = lookupContactByPubKey(s->pub_key, sizeof(s->pub_key));
+    if (contact && contact->out_path_len >= 0 && calcPathSig(*contact) == s->path_sig) {
+      if (sendRouteProbe(s, *contact)) break;   // just one probe at a time
+    }
+  }
 }
 
 void BaseChatMesh::scanRecentContacts(int last_n, ContactVisitor* visitor) {
-  for (int i = 0; i < num_contacts; i++) {  // sort the INDEXES into contacts[]
-    sort_array[i] = i;
+  // recent[] is only out of order by the contacts which have advertised since last time (or were added), so an
+  // insertion sort is close to O(n) here
+  for (int i = 1; i < num_contacts; i++) {
+    int16_t idx = recent[i];
+    uint32_t ts = contacts[idx].last_advert_timestamp;
+    int j = i;
+    while (j > 0 && contacts[recent[j - 1]].last_advert_timestamp < ts) {
+      recent[j] = recent[j - 1];
+      j--;
+    }
+    recent[j] = idx;
   }
-  table = contacts; // pass via global *sigh* :-(
-  qsort(sort_array, num_contacts, sizeof(sort_array[0]), cmp_adv_timestamp);
 
   if (last_n == 0) {
     last_n = num_contacts;   // scan ALL
@@ -677,7 +1529,7 @@ void BaseChatMesh::scanRecentContacts(int last_n, ContactVisitor* visitor) {
     if (last_n > num_contacts) last_n = num_contacts;
   }
   for (int i = 0; i < last_n; i++) {
-    visitor->onContactVisit(contacts[sort_array[i]]);
+    visitor->onContactVisit(contacts[recent[i]]);
   }
 }
 
@@ -691,6 +1543,13 @@ ContactInfo* BaseChatMesh::searchContactsByPrefix(const char* name_prefix) {
 }
 
 ContactInfo* BaseChatMesh::lookupContactByPubKey(const uint8_t* pub_key, int prefix_len) {
+  if (prefix_len > 0) {
+    for (int i = contact_heads[pub_key[0]]; i >= 0; i = contact_next[i]) {
+      auto c = &contacts[i];
+      if (memcmp(c->id.pub_key, pub_key, prefix_len) == 0) return c;
+    }
+    return NULL;  // not found
+  }
   for (int i = 0; i < num_contacts; i++) {
     auto c = &contacts[i];
     if (memcmp(c->id.pub_key, pub_key, prefix_len) == 0) return c;
@@ -698,13 +1557,17 @@ ContactInfo* BaseChatMesh::lookupContactByPubKey(const uint8_t* pub_key, int pre
   return NULL;  // not found
 }
 
-bool BaseChatMesh::addContact(const ContactInfo& contact) {
+bool BaseChatMesh::addContact(const ContactInfo& contact, bool calc_secret) {
   if (num_contacts < MAX_CONTACTS) {
     auto dest = &contacts[num_contacts++];
     *dest = contact;
+    indexContact(num_contacts - 1);
+    setWideHash(num_contacts - 1, false);   // until its next advert
+    setAckPiggyback(num_contacts - 1, false);
+    recent[num_contacts - 1] = num_contacts - 1;
 
     // calc the ECDH shared secret (just once for performance)
-    self_id.calcSharedSecret(dest->shared_secret, contact.id);
+    if (calc_secret) calcSharedSecret(dest->shared_secret, contact.id.pub_key);
 
     return true;  // success
   }
@@ -712,24 +1575,47 @@ bool BaseChatMesh::addContact(const ContactInfo& contact) {
 }
 
 bool BaseChatMesh::removeContact(ContactInfo& contact) {
-  int idx = 0;
-  while (idx < num_contacts && !contacts[idx].id.matches(contact.id)) {
-    idx++;
+  int idx = -1;
+  for (int i = contact_heads[contact.id.pub_key[0]]; i >= 0; i = contact_next[i]) {
+    if (contacts[i].id.matches(contact.id)) { idx = i; break; }
   }
-  if (idx >= num_contacts) return false;   // not found
-
-  // remove from contacts array
-  num_contacts--;
-  while (idx < num_contacts) {
-    contacts[idx] = contacts[idx + 1];
-    idx++;
+  if (idx < 0) return false;   // not found
+
+  // remove from contacts array, by moving the last contact into its slot
+  int last = num_contacts - 1;
+  unindexContact(idx);
+  if (idx != last) {
+    unindexContact(last);
+    contacts[idx] = contacts[last];
+    indexContact(idx);
+    setWideHash(idx, hasWideHash(last));
+    setAckPiggyback(idx, hasAckPiggyback(last));
   }
+  int j = 0;
+  for (int i = 0; i < num_contacts; i++) {
+    if (recent[i] == idx) continue;
+    recent[j++] = recent[i] == last ? idx : recent[i];
+  }
+  num_contacts--;
   return true;  // Success
 }
 
 #ifdef MAX_GROUP_CHANNELS
 #include <base64.hpp>
 
+void BaseChatMesh::rebuildChannelIndex() {
+  static uint8_t zeroes[] = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
+
+  memset(channel_heads, 0xFF, sizeof(channel_heads));   // all -1
+  for (int i = MAX_GROUP_CHANNELS - 1; i >= 0; i--) {   // (backwards, so buckets are in channels[] order)
+    if (memcmp(channels[i].channel.secret, zeroes, 16) == 0) continue;   // unused slot
+
+    uint8_t h = channels[i].channel.hash[0];
+    channel_next[i] = channel_heads[h];
+    channel_heads[h] = i;
+  }
+}
+
 ChannelDetails* BaseChatMesh::addChannel(const char* name, const char* psk_base64) {
   if (num_channels < MAX_GROUP_CHANNELS) {
     auto dest = &channels[num_channels];
@@ -740,6 +1626,7 @@ ChannelDetails* BaseChatMesh::addChannel(const char* name, const char* psk_base6
       mesh::Utils::sha256(dest->channel.hash, sizeof(dest->channel.hash), dest->channel.secret, len);
       StrHelper::strncpy(dest->name, name, sizeof(dest->name));
       num_channels++;
+      rebuildChannelIndex();
       return dest;
     }
   }
@@ -762,6 +1649,7 @@ bool BaseChatMesh::setChannel(int idx, const ChannelDetails& src) {
     } else {
       mesh::Utils::sha256(channels[idx].channel.hash, sizeof(channels[idx].channel.hash), src.channel.secret, 32);  // 256-bit key
     }
+    rebuildChannelIndex();
     return true;
   }
   return false;
@@ -799,24 +1687,49 @@ ContactsIterator BaseChatMesh::startContactsIterator() {
 }
 
 bool ContactsIterator::hasNext(const BaseChatMesh* mesh, ContactInfo& dest) {
-  if (next_idx >= mesh->getNumContacts()) return false;
+  auto c = next(mesh);
+  if (c == NULL) return false;
 
-  dest = mesh->contacts[next_idx++];
+  dest = *c;
   return true;
 }
 
+const ContactInfo* ContactsIterator::next(const BaseChatMesh* mesh) {
+  if (next_idx >= mesh->getNumContacts()) return NULL;
+
+  return &mesh->contacts[next_idx++];
+}
+
 void BaseChatMesh::loop() {
   Mesh::loop();
+  channel_load.update(_ms->getMillis(), getTotalAirTime() + getReceiveAirTime());
 
   if (txt_send_timeout && millisHasNowPassed(txt_send_timeout)) {
     // failed to get an ACK
+    int failed_route = pending_route;
+    recordRouteResult(false);
+    if (failed_route >= 0) {
+      // was sent by out_path, so fail over to the alternate path (if one), rather than the retry going by flood
+      ContactInfo* contact = lookupContactByPubKey(route_stats[failed_route].pub_key, sizeof(route_stats[failed_route].pub_key));
+      if (contact && contact->out_path_len >= 0 && calcPathSig(*contact) == route_stats[failed_route].path_sig && useAltPath(*contact)) {
+        onContactPathUpdated(*contact);
+      }
+    }
+    if (path_guess.pending) onGuessedPathFailed();
     onSendTimeout();
     txt_send_timeout = 0;
   }
-
-  if (_pendingLoopback) {
-    onRecvPacket(_pendingLoopback);  // loop-back, as if received over radio
-    releasePacket(_pendingLoopback);   // undo the obtainNewPacket()
-    _pendingLoopback = NULL;
+  checkRouteProbes();
+  checkPathDiscovery();
+  checkSendQueue();
+  checkHeldAcks();
+
+  if (loopback_len) {
+    mesh::Packet pkt;
+    pkt.readFrom(loopback_buf, loopback_len);
+    loopback_len = 0;
+    pkt.header |= ROUTE_TYPE_FLOOD;   // simulate it being received flood-mode
+    getTables()->clear(&pkt);  // remove packet hash from table, so we can receive/process it again
+    onRecvPacket(&pkt);  // loop-back, as if received over radio (is never retransmitted, as not from pool)
   }
 }
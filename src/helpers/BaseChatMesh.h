@@ -4,6 +4,10 @@
 #include <Mesh.h>
 #include <helpers/AdvertDataHelpers.h>
 #include <helpers/TxtDataHelpers.h>
+#include <helpers/TxtCodec.h>
+#include <helpers/TopologyCache.h>
+#include <helpers/ChannelLoad.h>
+#include <helpers/ExtRamArray.h>
 
 #define MAX_TEXT_LEN    (10*CIPHER_BLOCK_SIZE)  // must be LESS than (MAX_PACKET_PAYLOAD - 4 - CIPHER_MAC_SIZE - 1)
 
@@ -17,8 +21,10 @@
 
 #define REQ_TYPE_GET_STATUS      0x01   // same as _GET_STATS
 #define REQ_TYPE_KEEP_ALIVE      0x02
+#define REQ_TYPE_RESUME_LOGIN    0x09   // login with the session ticket from a previous login response
 
 #define RESP_SERVER_LOGIN_OK      0   // response to ANON_REQ
+#define LOGIN_TICKET_VER_LEVEL    2   // server firmware ver level, from which login responses carry a session ticket
 
 class ContactVisitor {
 public:
@@ -31,6 +37,12 @@ class ContactsIterator {
   int next_idx = 0;
 public:
   bool hasNext(const BaseChatMesh* mesh, ContactInfo& dest);
+
+  /**
+   * \brief  as per hasNext(), but without copying the contact.
+   * \returns  the next contact, or NULL at end. (only valid until contacts are next added/removed)
+  */
+  const ContactInfo* next(const BaseChatMesh* mesh);
 };
 
 #ifndef MAX_CONTACTS
@@ -49,6 +61,159 @@ struct ConnectionInfo {
   uint32_t expected_ack;
 };
 
+#ifndef ROUTE_STATS_SLOTS
+  #define ROUTE_STATS_SLOTS  8
+#endif
+
+#define ROUTE_PROBE_CHECK_MILLIS    30000        // how often to look for a degraded route to probe
+#define ROUTE_PROBE_MIN_INTERVAL    (5*60*1000)  // min time between probes of same route
+#define ROUTE_DEGRADED_SUCCESS      160          // smoothed success rate (of 255), below which route is probed
+#define ROUTE_DEGRADED_SNR          (-10*4)      // weakest hop SNR (x4), below which route is probed
+
+/**
+ * \brief  quality measures of the current out_path to a contact, reset whenever the path changes. (runtime only)
+*/
+struct RouteStats {
+  uint8_t pub_key[4];       // prefix of contact's key
+  uint16_t path_sig;        // checksum of the out_path these stats are for
+  uint16_t ack_latency;     // smoothed millis, from direct send until ACK
+  uint8_t success;          // smoothed rate of direct sends ACKed, 0..255
+  uint8_t n_samples;        // (saturates)
+  int8_t min_snr;           // weakest hop SNR (x4) from last probe, or 127 if unknown
+  uint32_t probe_tag;       // non-zero while a probe (TRACE) is in flight
+  unsigned long probe_timeout;
+  unsigned long last_probe;
+  unsigned long last_used;  // zero if slot unused
+};
+
+#ifndef TOPO_MAX_GUESS_HOPS
+  #define TOPO_MAX_GUESS_HOPS   4     // max length of a direct path built from topology, instead of flooding
+#endif
+#define TOPO_ADVERT_MAX_AGE     (12*60*60)   // secs, contact must have been heard from within this, to guess a path
+
+/**
+ * \brief  a direct path to a contact (with no out_path), built from TopologyCache, which has yet to be ACKed
+*/
+struct PathGuess {
+  uint8_t pub_key[4];       // prefix of contact's key
+  uint8_t path[MAX_PATH_SIZE];
+  uint8_t path_len;
+  int16_t via_hash;         // repeater whose learned route was used, or -1
+  bool pending;             // message sent by this path, awaiting ACK
+};
+
+#ifndef PATH_DISCOVERY_MAX_PATHS
+  #define PATH_DISCOVERY_MAX_PATHS   4
+#endif
+#define PATH_DISCOVERY_COLLECT_MILLIS  6000   // after first PATH reply, to collect others (eg. a better path from the destination's collect window)
+#define ALT_PATH_SLOTS               8
+
+/**
+ * \brief  a path to a contact found by path discovery, to be ranked once its TRACE probe returns
+*/
+struct PathCandidate {
+  uint8_t path[MAX_PATH_SIZE];
+  uint8_t path_len;
+  int8_t min_snr;           // weakest hop SNR (x4) from probe, or 127 if unknown
+  bool failed;              // probe never returned
+  uint32_t probe_tag;       // non-zero while a probe (TRACE) is in flight
+  unsigned long probe_timeout;
+};
+
+#define PATH_DISC_IDLE        0
+#define PATH_DISC_COLLECTING  1
+#define PATH_DISC_PROBING     2
+
+/**
+ * \brief  a path discovery in progress: all PATH replies within a window are collected, then each path is probed
+ *     and the best two are kept, as the contact's out_path and an alternate. (runtime only)
+*/
+struct PathDiscovery {
+  uint8_t pub_key[4];       // prefix of contact's key
+  PathCandidate paths[PATH_DISCOVERY_MAX_PATHS];
+  uint8_t num_paths;
+  uint8_t state;            // PATH_DISC_*
+  unsigned long deadline;   // for first reply, then for collecting others
+};
+
+/**
+ * \brief  the second best path found by last path discovery, to fail over to when the out_path times out. (runtime only)
+*/
+struct AltPath {
+  uint8_t pub_key[4];       // prefix of contact's key
+  uint8_t path[MAX_PATH_SIZE];
+  uint8_t path_len;
+  unsigned long last_used;  // zero if slot unused
+};
+
+#ifndef MSG_SEND_QUEUE_SIZE
+  #define MSG_SEND_QUEUE_SIZE      4
+#endif
+#define MSG_RETRY_MAX_ATTEMPTS     4      // in all (attempt number is 2 bits in message)
+#define MSG_RETRY_FLOOD_AFTER      2      // direct attempts, before the path is reset and the rest are by flood
+#define MSG_RETRY_BACKOFF_MILLIS   2000   // after first timeout, doubled for each further, plus random up to the same again
+
+#define MSGQ_FREE         0
+#define MSGQ_AWAIT_ACK    1
+#define MSGQ_BACKOFF      2
+
+/**
+ * \brief  a text message being sent by sendMessageWithRetry(), until ACKed or out of attempts. (runtime only)
+*/
+struct QueuedMessage {
+  uint8_t pub_key[8];       // prefix of recipient's key
+  uint32_t timestamp;
+  uint32_t acks[MSG_RETRY_MAX_ATTEMPTS];   // expected ACK of each attempt so far (acks[0] identifies the message)
+  uint8_t attempt;          // of last send
+  uint8_t state;            // MSGQ_*
+  bool direct;              // last send was by out_path
+  int8_t route_idx;         // route_stats[] slot of that out_path, or -1
+  unsigned long sent_at;    // of last send
+  unsigned long first_sent;
+  unsigned long timeout;    // for ACK, or until next attempt
+  char text[MAX_TEXT_LEN+1];
+};
+
+#ifndef ADVERT_COALESCE_SECS
+  #define ADVERT_COALESCE_SECS  (5*60)   // a re-advert within this of the last one stored, with nothing changed, is not stored or notified
+#endif
+#define ADVERT_RECENT_SLOTS     8        // non-contacts (auto-add off) recently notified, for coalescing their re-adverts
+
+/**
+ * \brief  an advert from a non-contact which was passed to onDiscoveredContact() (runtime only)
+*/
+struct RecentAdvert {
+  uint8_t pub_key[4];       // prefix of sender's key
+  uint16_t data_sig;        // checksum of the advert's app_data
+  uint32_t notified_at;     // by OUR clock
+};
+
+#define ACK_HOLD_SLOTS          4        // ACKs held back briefly, in case a reply to the same contact can carry them
+
+/**
+ * \brief  an ACK waiting to go to a contact which accepts piggybacked ACKs (runtime only)
+*/
+struct HeldAck {
+  uint8_t pub_key[4];       // prefix of contact's key
+  uint32_t ack_hash;
+  unsigned long due;        // when to send it on its own
+  bool in_use;
+};
+
+#define LOGIN_TICKET_SLOTS      4        // servers we can resume a login session with
+
+/**
+ * \brief  session ticket from a server's last login response, so next login can skip the ANON_REQ (runtime only)
+*/
+struct LoginTicket {
+  uint8_t pub_key[4];       // prefix of server's key
+  uint32_t ticket;
+  uint16_t pass_hash;       // of password given at login, a different password needs a full login
+  bool pending;             // login sent, awaiting response
+  bool has_ticket;
+  bool in_use;
+};
+
 #include "ChannelDetails.h"
 
 /**
@@ -58,40 +223,134 @@ class BaseChatMesh : public mesh::Mesh {
 
   friend class ContactsIterator;
 
-  ContactInfo contacts[MAX_CONTACTS];
+  ExtRamArray<ContactInfo, MAX_CONTACTS> contacts;   // (lookup indexes below stay in internal RAM)
   int num_contacts;
-  int sort_array[MAX_CONTACTS];
+  int16_t contact_heads[256];          // index, by first byte of pub_key, of first contact in bucket (or -1)
+  int16_t contact_next[MAX_CONTACTS];  // next contact in same bucket (or -1), in ascending order
+  int16_t recent[MAX_CONTACTS];         // indexes into contacts[], kept (roughly) by most recent advert first
+  uint8_t wide_hash_bits[(MAX_CONTACTS + 7) / 8];   // by index into contacts[], contact accepts PAYLOAD_VER_3 (runtime only)
+  uint8_t ack_piggyback_bits[(MAX_CONTACTS + 7) / 8];   // by index into contacts[], contact accepts piggybacked ACKs (runtime only)
   int matching_peer_indexes[MAX_SEARCH_RESULTS];
   unsigned long txt_send_timeout;
 #ifdef MAX_GROUP_CHANNELS
   ChannelDetails channels[MAX_GROUP_CHANNELS];
   int num_channels;  // only for addChannel()
+  int16_t channel_heads[256];                 // index, by channel hash, of first channel in bucket (or -1)
+  int16_t channel_next[MAX_GROUP_CHANNELS];   // next channel in same bucket (or -1)
 #endif
-  mesh::Packet* _pendingLoopback;
+  uint8_t loopback_buf[MAX_TRANS_UNIT];   // imported advert, to be processed in next loop() (as if received)
+  uint8_t loopback_len;
   uint8_t temp_buf[MAX_TRANS_UNIT];
   ConnectionInfo connections[MAX_CONNECTIONS];
+  unsigned long next_conn_check;   // soonest next_ping, or expiry, in connections[]
+  RouteStats route_stats[ROUTE_STATS_SLOTS];
+  int pending_route;              // idx in route_stats[] of direct send awaiting ACK, or -1
+  unsigned long pending_sent_at;
+  unsigned long next_probe_check;
+  TopologyCache topology;
+  ChannelLoad channel_load;    // own, and as advertised by neighbouring repeaters
+  PathGuess path_guess;
+  uint8_t failed_guess_key[4];    // contact the last guessed path failed for
+  uint32_t failed_guess_lastmod;  // (and contact's lastmod at the time)
+  RecentAdvert recent_adverts[ADVERT_RECENT_SLOTS];
+  uint8_t next_recent_advert;
+  uint32_t n_adverts_coalesced;
+  PathDiscovery path_disc;
+  AltPath alt_paths[ALT_PATH_SLOTS];
+  QueuedMessage send_queue[MSG_SEND_QUEUE_SIZE];
+  HeldAck held_acks[ACK_HOLD_SLOTS];
+  mesh::CodingStore coding_store;
+  LoginTicket login_tickets[LOGIN_TICKET_SLOTS];
+  uint8_t next_login_ticket;
 
   mesh::Packet* composeMsgPacket(const ContactInfo& recipient, uint32_t timestamp, uint8_t attempt, const char *text, uint32_t& expected_ack);
-  void sendAckTo(const ContactInfo& dest, uint32_t ack_hash);
+  void sendAckTo(const ContactInfo& dest, uint32_t ack_hash, uint32_t delay_millis);
+  void holdAckTo(int idx, uint32_t ack_hash);
+  int findHeldAck(const ContactInfo& contact) const;
+  void checkHeldAcks();
+  void sendKeepAlive(ConnectionInfo& conn, const ContactInfo& contact);
+  LoginTicket* findLoginTicket(const ContactInfo& server, bool alloc);
+  void checkLoginResponse(const ContactInfo& from, const uint8_t* data, uint8_t len);
+  void recvPiggybackAck(mesh::Packet* packet, const uint8_t* data, size_t len, int txt_ofs);
+  void indexContact(int idx);
+  void unindexContact(int idx);
+  void rebuildContactIndex();
+  bool hasWideHash(int idx) const { return (wide_hash_bits[idx >> 3] & (1 << (idx & 7))) != 0; }
+  void setWideHash(int idx, bool enable) {
+    if (enable) wide_hash_bits[idx >> 3] |= (1 << (idx & 7)); else wide_hash_bits[idx >> 3] &= ~(1 << (idx & 7));
+  }
+  bool hasAckPiggyback(int idx) const { return (ack_piggyback_bits[idx >> 3] & (1 << (idx & 7))) != 0; }
+  void setAckPiggyback(int idx, bool enable) {
+    if (enable) ack_piggyback_bits[idx >> 3] |= (1 << (idx & 7)); else ack_piggyback_bits[idx >> 3] &= ~(1 << (idx & 7));
+  }
+#ifdef MAX_GROUP_CHANNELS
+  void rebuildChannelIndex();
+#endif
+  RouteStats* findRouteStats(const ContactInfo& contact, bool create);
+  void recordRouteResult(bool acked);
+  void recordRouteResult(int route_idx, unsigned long sent_at, bool acked);
+  ContactInfo* matchAck(const uint8_t* data);
+  int sendQueuedAttempt(QueuedMessage* msg, const ContactInfo& recipient, uint32_t& est_timeout);
+  void finishQueuedMessage(QueuedMessage* msg, ContactInfo* recipient, bool delivered);
+  void checkSendQueue();
+  void checkRouteProbes();
+  bool sendRouteProbe(RouteStats* stats, const ContactInfo& contact);
+  bool sendTraceProbe(const uint8_t* path, uint8_t path_len, uint32_t& tag, unsigned long& timeout);
+  void addPathCandidate(const uint8_t* path, uint8_t path_len);
+  void checkPathDiscovery();
+  void selectDiscoveredPaths();
+  AltPath* findAltPath(const uint8_t* pub_key, bool create);
+  bool guessPathTo(const ContactInfo& contact);
+  void adoptGuessedPath(ContactInfo& contact);
+  void onGuessedPathFailed();
+  bool isAdvertUnchanged(const ContactInfo* from, const mesh::Identity& id, const AdvertDataParser& parser,
+                         const uint8_t* app_data, size_t app_data_len);
 
 protected:
   BaseChatMesh(mesh::Radio& radio, mesh::MillisecondClock& ms, mesh::RNG& rng, mesh::RTCClock& rtc, mesh::PacketManager& mgr, mesh::MeshTables& tables)
       : mesh::Mesh(radio, ms, rng, rtc, mgr, tables)
   { 
     num_contacts = 0;
+    rebuildContactIndex();
+    memset(wide_hash_bits, 0, sizeof(wide_hash_bits));
+    memset(ack_piggyback_bits, 0, sizeof(ack_piggyback_bits));
   #ifdef MAX_GROUP_CHANNELS
     memset(channels, 0, sizeof(channels));
     num_channels = 0;
+    rebuildChannelIndex();
   #endif
     txt_send_timeout = 0;
-    _pendingLoopback = NULL;
+    loopback_len = 0;
     memset(connections, 0, sizeof(connections));
+    next_conn_check = 0;
+    memset(route_stats, 0, sizeof(route_stats));
+    pending_route = -1;
+    next_probe_check = 0;
+    memset(&path_guess, 0, sizeof(path_guess));
+    memset(failed_guess_key, 0, sizeof(failed_guess_key));
+    failed_guess_lastmod = 0;
+    memset(recent_adverts, 0, sizeof(recent_adverts));
+    next_recent_advert = 0;
+    n_adverts_coalesced = 0;
+    memset(&path_disc, 0, sizeof(path_disc));
+    memset(alt_paths, 0, sizeof(alt_paths));
+    memset(send_queue, 0, sizeof(send_queue));
+    memset(held_acks, 0, sizeof(held_acks));
+    setCodingStore(&coding_store);
+    memset(login_tickets, 0, sizeof(login_tickets));
+    next_login_ticket = 0;
   }
 
-  void resetContacts() { num_contacts = 0; }
+  void resetContacts() {
+    num_contacts = 0;
+    rebuildContactIndex();
+    memset(wide_hash_bits, 0, sizeof(wide_hash_bits));
+    memset(ack_piggyback_bits, 0, sizeof(ack_piggyback_bits));
+  }
 
   // 'UI' concepts, for sub-classes to implement
   virtual bool isAutoAddEnabled() const { return true; }
+  // NOTE: path_len is encoded (see Packet::getEncodedPathLen())
   virtual void onDiscoveredContact(ContactInfo& contact, bool is_new, uint8_t path_len, const uint8_t* path) = 0;
   virtual ContactInfo* processAck(const uint8_t *data) = 0;
   virtual void onContactPathUpdated(const ContactInfo& contact) = 0;
@@ -102,11 +361,43 @@ protected:
   virtual uint32_t calcFloodTimeoutMillisFor(uint32_t pkt_airtime_millis) const = 0;
   virtual uint32_t calcDirectTimeoutMillisFor(uint32_t pkt_airtime_millis, uint8_t path_len) const = 0;
   virtual void onSendTimeout() = 0;
+
+  /**
+   * \brief  final outcome of a message sent by sendMessageWithRetry()
+   * \param  recipient  NULL if contact has been removed since
+   * \param  expected_ack  as returned by sendMessageWithRetry() (ie. of first attempt)
+   * \param  trip_millis  from first send until ACK (if delivered)
+  */
+  virtual void onMessageSendResult(const ContactInfo* recipient, uint32_t expected_ack, bool delivered, uint32_t trip_millis, uint8_t attempts) { }
   virtual void onChannelMessageRecv(const mesh::GroupChannel& channel, mesh::Packet* pkt, uint32_t timestamp, const char *text) = 0;
   virtual uint8_t onContactRequest(const ContactInfo& contact, uint32_t sender_timestamp, const uint8_t* data, uint8_t len, uint8_t* reply) = 0;
   virtual void onContactResponse(const ContactInfo& contact, const uint8_t* data, uint8_t len) = 0;
+
+  /**
+   * \brief  a RESPONSE too big for one packet, reassembled from MULTIPART fragments. Only sent to nodes that advertise
+   *     ADV_CAP_FRAGMENTS, ie. have called setFragmentStore(). Default impl ignores it.
+  */
+  virtual void onContactLargeResponse(const ContactInfo& contact, const uint8_t* data, size_t len) { }
   virtual void handleReturnPathRetry(const ContactInfo& contact, const uint8_t* path, uint8_t path_len);
 
+  /**
+   * \brief  called when the out_path to contact has been found to be broken or weak (by route probe)
+   *     Default impl forgets the path, so next send is by flood, which will find a new one, rather than waiting on a direct timeout first.
+  */
+  virtual void onRouteDegraded(ContactInfo& contact);
+
+  /**
+   * \brief  switches contact's out_path to the alternate found by path discovery, if there is one (which is then forgotten)
+   * \returns  true, if switched. Caller is to call onContactPathUpdated()
+  */
+  bool useAltPath(ContactInfo& contact);
+
+  /**
+   * \returns  true, if a message to a contact with no out_path may be sent DIRECT by a path built from the contact's last
+   *     advert path and known repeater routes (see TopologyCache), rather than by flood. If ACKed, the path becomes the out_path.
+  */
+  virtual bool isPathGuessEnabled() const { return true; }
+
   virtual void sendFloodScoped(const ContactInfo& recipient, mesh::Packet* pkt, uint32_t delay_millis=0);
   virtual void sendFloodScoped(const mesh::GroupChannel& channel, mesh::Packet* pkt, uint32_t delay_millis=0);
 
@@ -115,12 +406,18 @@ protected:
   virtual bool putBlobByKey(const uint8_t key[], int key_len, const uint8_t src_buf[], int len) { return false; }
 
   // Mesh overrides
+  bool isAdvertStale(const mesh::Identity& id, uint32_t timestamp) override;
   void onAdvertRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp, const uint8_t* app_data, size_t app_data_len) override;
+  void onAdvertRefreshRecv(mesh::Packet* packet, const mesh::Identity& id, uint32_t timestamp) override;
   int searchPeersByHash(const uint8_t* hash) override;
+  int searchPeersByHash(const uint8_t* hash, uint8_t hash_len) override;
+  bool isWideHashPeer(const mesh::Identity& dest) override;
   void getPeerSharedSecret(uint8_t* dest_secret, int peer_idx) override;
   void onPeerDataRecv(mesh::Packet* packet, uint8_t type, int sender_idx, const uint8_t* secret, uint8_t* data, size_t len) override;
   bool onPeerPathRecv(mesh::Packet* packet, int sender_idx, const uint8_t* secret, uint8_t* path, uint8_t path_len, uint8_t extra_type, uint8_t* extra, uint8_t extra_len) override;
   void onAckRecv(mesh::Packet* packet, uint32_t ack_crc) override;
+  void routeFragmentAck(mesh::Packet* ack, const mesh::Packet* frag, int sender_idx) override;
+  void onPeerFragmentedDataRecv(mesh::Packet* packet, uint8_t type, int sender_idx, const uint8_t* secret, uint8_t* data, size_t len) override;
 #ifdef MAX_GROUP_CHANNELS
   int searchChannelsByHash(const uint8_t* hash, mesh::GroupChannel channels[], int max_matches) override;
 #endif
@@ -134,10 +431,38 @@ protected:
   ContactInfo* checkConnectionsAck(const uint8_t* data);
   void checkConnections();
 
+  // Route quality
+  /**
+   * \brief  sub-classes which override onTraceRecv() must call this first, and ignore the TRACE if it returns true.
+   * \returns  true, if the TRACE was a route probe (sent by this class)
+  */
+  bool checkRouteProbe(mesh::Packet* packet, uint32_t tag, uint8_t flags, const uint8_t* path_snrs, uint8_t path_len);
+  void onTraceRecv(mesh::Packet* packet, uint32_t tag, uint32_t auth_code, uint8_t flags, const uint8_t* path_snrs, const uint8_t* path_hashes, uint8_t path_len) override;
+
+  // Path discovery
+  /**
+   * \brief  collects the paths from PATH replies from contact, instead of taking the first as its out_path. The request
+   *     (flood) is to be sent by caller. After the window, each path is probed, and the best two kept (see PathDiscovery)
+   * \param  timeout_millis  how long to wait for the first reply
+  */
+  void startPathDiscovery(const ContactInfo& contact, uint32_t timeout_millis);
+  /**
+   * \brief  sub-classes which override onContactPathRecv() and don't call the base impl, must call this first.
+   * \returns  true, if a path discovery to 'from' is collecting, and the paths have been added as candidates
+  */
+  bool collectDiscoveredPaths(const ContactInfo& from, const uint8_t* in_path, uint8_t in_path_len, const uint8_t* out_path, uint8_t out_path_len);
+
 public:
   mesh::Packet* createSelfAdvert(const char* name);
   mesh::Packet* createSelfAdvert(const char* name, double lat, double lon);
   int  sendMessage(const ContactInfo& recipient, uint32_t timestamp, uint8_t attempt, const char* text, uint32_t& expected_ack, uint32_t& est_timeout);
+  /**
+   * \brief  like sendMessage(), but retries are done here (with backoff, falling back to flood), rather than by caller.
+   *     Several may be outstanding at once, and onMessageSendResult() is called once with the outcome.
+   * \returns  MSG_SEND_FAILED if queue is full, else how first attempt was sent
+  */
+  int  sendMessageWithRetry(const ContactInfo& recipient, uint32_t timestamp, const char* text, uint32_t& expected_ack, uint32_t& est_timeout);
+  int  getNumQueuedMessages() const;
   int  sendCommandData(const ContactInfo& recipient, uint32_t timestamp, uint8_t attempt, const char* text, uint32_t& est_timeout);
   bool sendGroupMessage(uint32_t timestamp, mesh::GroupChannel& channel, const char* sender_name, const char* text, int text_len);
   int  sendLogin(const ContactInfo& recipient, const char* password, uint32_t& est_timeout);
@@ -146,12 +471,24 @@ public:
   bool shareContactZeroHop(const ContactInfo& contact);
   uint8_t exportContact(const ContactInfo& contact, uint8_t dest_buf[]);
   bool importContact(const uint8_t src_buf[], uint8_t len);
+
+  /**
+   * \brief  like importContact(), but the advert is processed straight away (not on next loop()), so many can be
+   *      imported in one go
+   * \returns  false if not a valid advert packet
+  */
+  bool importContactNow(const uint8_t src_buf[], uint8_t len);
   void resetPathTo(ContactInfo& recipient);
+  const RouteStats* getRouteStats(const ContactInfo& contact) { return findRouteStats(contact, false); }
+  const AltPath* getAltPath(const ContactInfo& contact) { return findAltPath(contact.id.pub_key, false); }
+  bool isPathDiscoveryActive() const { return path_disc.state != PATH_DISC_IDLE; }
+  int getNumKnownRepeaterRoutes() { return topology.getCount(getRTCClock()->getCurrentTime()); }
+  uint32_t getNumAdvertsCoalesced() const { return n_adverts_coalesced; }   // re-adverts not stored nor notified
   void scanRecentContacts(int last_n, ContactVisitor* visitor);
   ContactInfo* searchContactsByPrefix(const char* name_prefix);
   ContactInfo* lookupContactByPubKey(const uint8_t* pub_key, int prefix_len);
   bool  removeContact(ContactInfo& contact);
-  bool  addContact(const ContactInfo& contact);
+  bool  addContact(const ContactInfo& contact, bool calc_secret=true);   // calc_secret false: contact.shared_secret is already valid (eg. cached)
   int getNumContacts() const { return num_contacts; }
   bool getContactByIdx(uint32_t idx, ContactInfo& contact);
   ContactsIterator startContactsIterator();
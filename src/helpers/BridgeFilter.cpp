@@ -0,0 +1,187 @@
+#include "BridgeFilter.h"
+
+#define BRIDGE_FILTER_FILE   "/bridge_filter"
+
+static const char* route_names[] = { "tflood", "flood", "direct", "tdirect" };   // by ROUTE_TYPE_*
+
+static File openWrite(FILESYSTEM* _fs, const char* filename) {
+  #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+    _fs->remove(filename);
+    return _fs->open(filename, FILE_O_WRITE);
+  #elif defined(RP2040_PLATFORM)
+    return _fs->open(filename, "w");
+  #else
+    return _fs->open(filename, "w", true);
+  #endif
+}
+
+bool BridgeFilter::load(FILESYSTEM* _fs) {
+  _num = 0;
+  if (!_fs->exists(BRIDGE_FILTER_FILE)) return false;
+
+#if defined(RP2040_PLATFORM)
+  File file = _fs->open(BRIDGE_FILTER_FILE, "r");
+#else
+  File file = _fs->open(BRIDGE_FILTER_FILE);
+#endif
+  if (!file) return false;
+
+  while (_num < MAX_BRIDGE_RULES) {
+    auto r = &_rules[_num];
+    uint8_t pad[2];
+
+    bool success = file.read(&r->payload_type, 1) == 1;
+    success = success && file.read(&r->route_type, 1) == 1;
+    success = success && file.read((uint8_t *) &r->region_id, sizeof(r->region_id)) == sizeof(r->region_id);
+    success = success && file.read(&r->flags, 1) == 1;
+    success = success && file.read(&r->max_hops, 1) == 1;
+    success = success && file.read((uint8_t *) &r->per_min, sizeof(r->per_min)) == sizeof(r->per_min);
+    success = success && file.read(pad, sizeof(pad)) == sizeof(pad);   // reserved
+
+    if (!success) break; // EOF
+    resetTokens(_num);
+    _num++;
+  }
+  file.close();
+  return true;
+}
+
+bool BridgeFilter::save(FILESYSTEM* _fs) {
+  File file = openWrite(_fs, BRIDGE_FILTER_FILE);
+  if (!file) return false;
+
+  bool success = true;
+  for (int i = 0; i < _num && success; i++) {
+    auto r = &_rules[i];
+    uint8_t pad[2];
+    memset(pad, 0, sizeof(pad));
+
+    success = file.write(&r->payload_type, 1) == 1;
+    success = success && file.write(&r->route_type, 1) == 1;
+    success = success && file.write((uint8_t *) &r->region_id, sizeof(r->region_id)) == sizeof(r->region_id);
+    success = success && file.write(&r->flags, 1) == 1;
+    success = success && file.write(&r->max_hops, 1) == 1;
+    success = success && file.write((uint8_t *) &r->per_min, sizeof(r->per_min)) == sizeof(r->per_min);
+    success = success && file.write(pad, sizeof(pad)) == sizeof(pad);
+  }
+  file.close();
+  return success;
+}
+
+void BridgeFilter::resetTokens(int i) {
+  uint32_t burst = _rules[i].per_min * BRIDGE_RULE_BURST_SECS / 60;
+  _tokens[i] = (burst < 1 ? 1 : burst) * 1000;   // starts full
+  _last_refill[i] = millis();
+}
+
+BridgeRule* BridgeFilter::find(uint8_t payload_type, uint8_t route_type, uint16_t region_id) {
+  for (int i = 0; i < _num; i++) {
+    auto r = &_rules[i];
+    if (r->payload_type == payload_type && r->route_type == route_type && r->region_id == region_id) return r;
+  }
+  return NULL;
+}
+
+bool BridgeFilter::putRule(uint8_t payload_type, uint8_t route_type, uint16_t region_id, uint8_t flags, uint8_t max_hops, uint16_t per_min) {
+  auto r = find(payload_type, route_type, region_id);
+  if (r == NULL) {
+    if (_num >= MAX_BRIDGE_RULES) return false;   // table full
+    r = &_rules[_num++];
+    r->payload_type = payload_type;
+    r->route_type = route_type;
+    r->region_id = region_id;
+  }
+  r->flags = flags;
+  r->max_hops = max_hops;
+  r->per_min = per_min;
+  resetTokens(r - _rules);
+  return true;
+}
+
+bool BridgeFilter::removeRule(uint8_t payload_type, uint8_t route_type, uint16_t region_id) {
+  auto r = find(payload_type, route_type, region_id);
+  if (r == NULL) return false;
+
+  int i = r - _rules;
+  _num--;
+  memmove(&_rules[i], &_rules[i + 1], (_num - i) * sizeof(BridgeRule));   // keep in insertion order
+  memmove(&_tokens[i], &_tokens[i + 1], (_num - i) * sizeof(_tokens[0]));
+  memmove(&_last_refill[i], &_last_refill[i + 1], (_num - i) * sizeof(_last_refill[0]));
+  return true;
+}
+
+void BridgeFilter::removeRegion(uint16_t region_id) {
+  int j = 0;
+  for (int i = 0; i < _num; i++) {
+    if (_rules[i].region_id != region_id) {
+      _rules[j] = _rules[i];
+      _tokens[j] = _tokens[i];
+      _last_refill[j] = _last_refill[i];
+      j++;
+    }
+  }
+  _num = j;
+}
+
+int BridgeFilter::specificity(const BridgeRule& r) {
+  // region is most specific, then payload type, then route type
+  return (r.region_id != FLOOD_RULE_ANY_REGION ? 4 : 0) + (r.payload_type != FLOOD_RULE_ANY ? 2 : 0) + (r.route_type != FLOOD_RULE_ANY ? 1 : 0);
+}
+
+bool BridgeFilter::allow(const mesh::Packet* packet, uint16_t region_id, unsigned long now_millis) {
+  uint8_t payload_type = packet->getPayloadType();
+  uint8_t route_type = packet->getRouteType();
+
+  int best = -1;
+  for (int i = 0; i < _num; i++) {
+    auto r = &_rules[i];
+    if (r->payload_type != FLOOD_RULE_ANY && r->payload_type != payload_type) continue;
+    if (r->route_type != FLOOD_RULE_ANY && r->route_type != route_type) continue;
+    if (r->region_id != FLOOD_RULE_ANY_REGION && r->region_id != region_id) continue;
+
+    if (best < 0 || specificity(*r) > specificity(_rules[best])) best = i;   // first of equal specificity wins
+  }
+  if (best < 0) return true;   // no rule, so bridge it
+
+  auto r = &_rules[best];
+  if (r->flags & BRIDGE_RULE_DENY) {
+    _num_denied++;
+    return false;
+  }
+  // NOTE: for direct packets, the path is what's still to go, so only floods have a hop count to check
+  if (r->max_hops != BRIDGE_RULE_NO_HOPS && packet->isRouteFlood() && packet->path_len / packet->path_hash_size > r->max_hops) {
+    _num_denied++;
+    return false;
+  }
+  if (r->per_min) {   // token bucket, as SourceRateLimiter
+    uint32_t burst = r->per_min * BRIDGE_RULE_BURST_SECS / 60;
+    if (burst < 1) burst = 1;
+    uint32_t elapsed = now_millis - _last_refill[best];
+    if (elapsed > 600000) elapsed = 600000;   // 10 mins, long enough to be full again (and no overflow below)
+    uint32_t tokens = _tokens[best] + elapsed * r->per_min / 60;   // x1000 per minute, is per_min/60 per milli
+    if (tokens > burst * 1000) tokens = burst * 1000;
+    _tokens[best] = tokens;
+    _last_refill[best] = now_millis;
+
+    if (tokens < 1000) {
+      _num_denied++;
+      return false;
+    }
+    _tokens[best] -= 1000;
+  }
+  return true;
+}
+
+const char* BridgeFilter::getRouteName(uint8_t route_type) {
+  if (route_type == FLOOD_RULE_ANY) return "*";
+  if (route_type < 4) return route_names[route_type];
+  return "?";
+}
+
+int BridgeFilter::parseRouteName(const char* name) {
+  if (strcmp(name, "*") == 0) return FLOOD_RULE_ANY;
+  for (int i = 0; i < 4; i++) {
+    if (strcmp(name, route_names[i]) == 0) return i;
+  }
+  return -1;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>   // needed for PlatformIO
+#include <Packet.h>
+#include <helpers/IdentityStore.h>
+#include <helpers/FloodPolicy.h>
+
+#ifndef MAX_BRIDGE_RULES
+  #define MAX_BRIDGE_RULES   8
+#endif
+#ifndef BRIDGE_RULE_BURST_SECS
+  #define BRIDGE_RULE_BURST_SECS   10    // a rule's per_min cap allows this many secs worth back-to-back
+#endif
+
+#define BRIDGE_RULE_DENY       0x01
+#define BRIDGE_RULE_NO_HOPS    0xFF     // for max_hops, no limit
+
+struct BridgeRule {
+  uint8_t payload_type;   // PAYLOAD_TYPE_*, or FLOOD_RULE_ANY
+  uint8_t route_type;     // ROUTE_TYPE_*, or FLOOD_RULE_ANY
+  uint16_t region_id;     // RegionEntry::id, or FLOOD_RULE_ANY_REGION
+  uint8_t flags;          // BRIDGE_RULE_DENY
+  uint8_t max_hops;       // flood packets which have taken more hops than this aren't bridged
+  uint16_t per_min;       // cap on packets bridged by this rule (zero for no cap)
+};
+
+/**
+ * \brief  Table of which packets are sent across the bridge, by payload type/route type/region, so that traffic which is
+ *     only useful locally (eg. zero-hop adverts, or far travelled floods) doesn't use the backhaul, nor the far side's
+ *     airtime. Where several rules match a packet, the most specific one applies (as FloodPolicy). With no matching
+ *     rule, a packet is bridged.
+*/
+class BridgeFilter {
+  BridgeRule _rules[MAX_BRIDGE_RULES];
+  uint32_t _tokens[MAX_BRIDGE_RULES];   // x1000, for per_min caps (not persisted)
+  unsigned long _last_refill[MAX_BRIDGE_RULES];
+  int _num;
+  uint32_t _num_denied;
+
+  static int specificity(const BridgeRule& r);
+  BridgeRule* find(uint8_t payload_type, uint8_t route_type, uint16_t region_id);
+  void resetTokens(int i);
+
+public:
+  BridgeFilter() { _num = 0; _num_denied = 0; }
+
+  bool load(FILESYSTEM* _fs);
+  bool save(FILESYSTEM* _fs);
+
+  /**
+   * \brief  add rule, or replace the limits of an existing rule with same keys
+   * \returns  false if table is full
+  */
+  bool putRule(uint8_t payload_type, uint8_t route_type, uint16_t region_id, uint8_t flags, uint8_t max_hops, uint16_t per_min);
+  bool removeRule(uint8_t payload_type, uint8_t route_type, uint16_t region_id);
+  void removeRegion(uint16_t region_id);
+  void clear() { _num = 0; }
+
+  int getCount() const { return _num; }
+  const BridgeRule& getRule(int i) const { return _rules[i]; }
+  uint32_t getNumDenied() const { return _num_denied; }
+
+  /**
+   * \param  region_id  the region the packet was matched to (RegionMap::findMatch()), or FLOOD_RULE_ANY_REGION if none
+   * \returns  true if packet should be sent across the bridge
+  */
+  bool allow(const mesh::Packet* packet, uint16_t region_id, unsigned long now_millis);
+
+  static const char* getRouteName(uint8_t route_type);
+  static int parseRouteName(const char* name);   // returns -1 if not recognised
+};
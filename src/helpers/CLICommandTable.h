@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef CLI_MAX_COMMANDS
+  #define CLI_MAX_COMMANDS   40
+#endif
+
+#define CLI_SERIAL_ONLY    0x01    // not accepted from remote admins (ie. sender_timestamp != 0)
+#define CLI_HAS_PARAMS     0x02    // only matches if followed by params (ie. "{name} ...")
+
+/**
+ * \param  command  the whole command line (handlers parse their own params/sub-commands from it)
+*/
+typedef void (*CLICommandFn)(void* ctx, uint32_t sender_timestamp, char* command, char* reply);
+
+/**
+ * \brief  The CLI's commands, keyed by their first word (eg. "get", "neighbor.remove"), kept sorted so a command
+ *     is found with a binary search, instead of trying every command's prefix in turn.
+*/
+class CLICommandTable {
+  struct Entry {
+    const char* name;
+    CLICommandFn fn;
+    void* ctx;
+    uint8_t flags;
+  };
+  Entry _entries[CLI_MAX_COMMANDS];
+  int _num;
+
+  static int compare(const char* word, int len, const char* name) {
+    int c = strncmp(word, name, len);
+    if (c != 0) return c;
+    return name[len] == 0 ? 0 : -1;   // word is a prefix of name
+  }
+
+  int find(const char* word, int len) const {
+    int lo = 0, hi = _num - 1;
+    while (lo <= hi) {
+      int mid = (lo + hi) / 2;
+      int c = compare(word, len, _entries[mid].name);
+      if (c == 0) return mid;
+      if (c < 0) hi = mid - 1; else lo = mid + 1;
+    }
+    return -1;
+  }
+
+public:
+  CLICommandTable() : _num(0) { }
+
+  /**
+   * \brief  adds a command, or replaces the handler of an existing one (eg. an app overriding a common command)
+   * \returns  false if table is full
+  */
+  bool add(const char* name, CLICommandFn fn, void* ctx, uint8_t flags = 0) {
+    int len = strlen(name);
+    int i = find(name, len);
+    if (i < 0) {
+      if (_num >= CLI_MAX_COMMANDS) return false;
+      i = _num;
+      while (i > 0 && strcmp(_entries[i - 1].name, name) > 0) {   // insert in order
+        _entries[i] = _entries[i - 1];
+        i--;
+      }
+      _num++;
+    }
+    _entries[i].name = name;
+    _entries[i].fn = fn;
+    _entries[i].ctx = ctx;
+    _entries[i].flags = flags;
+    return true;
+  }
+
+  /**
+   * \returns  false if no (allowed) command matches the first word of 'command'
+  */
+  bool dispatch(uint32_t sender_timestamp, char* command, char* reply) const {
+    int len = 0;
+    while (command[len] && command[len] != ' ') len++;
+
+    int i = find(command, len);
+    if (i < 0) return false;
+    if (sender_timestamp != 0 && (_entries[i].flags & CLI_SERIAL_ONLY)) return false;
+    if (command[len] != ' ' && (_entries[i].flags & CLI_HAS_PARAMS)) return false;
+
+    _entries[i].fn(_entries[i].ctx, sender_timestamp, command, reply);
+    return true;
+  }
+
+  int getCount() const { return _num; }
+
+  /** \brief  adapts a member function, of object 'ctx', to a CLICommandFn.  eg. CLICommandTable::method<MyMesh, &MyMesh::handleFooCmd> */
+  template<class T, void (T::*M)(uint32_t, char*, char*)>
+  static void method(void* ctx, uint32_t sender_timestamp, char* command, char* reply) {
+    (((T *) ctx)->*M)(sender_timestamp, command, reply);
+  }
+};
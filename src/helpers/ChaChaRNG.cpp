@@ -0,0 +1,114 @@
+#include "ChaChaRNG.h"
+#include <Arduino.h>
+
+#if defined(ESP32)
+  #include <esp_random.h>
+#elif defined(NRF52_PLATFORM)
+  #include <nrf_sdm.h>
+  #include <nrf_soc.h>
+#endif
+
+#define CHACHA_KEY_SIZE   32
+
+#ifndef CHACHA_RESEED_EVENTS
+  #define CHACHA_RESEED_EVENTS   8
+#endif
+
+void ChaChaRNG::refill() {
+  static const uint8_t zero_iv[8] = { 0 };
+
+  memset(_buf, 0, sizeof(_buf));
+  _chacha.setIV(zero_iv, sizeof(zero_iv));   // counter back to zero, key is always fresh
+  _chacha.encrypt(_buf, _buf, sizeof(_buf));   // keystream
+
+  _chacha.setKey(_buf, CHACHA_KEY_SIZE);   // first part becomes the next key
+  memset(_buf, 0, CHACHA_KEY_SIZE);
+  _avail = sizeof(_buf) - CHACHA_KEY_SIZE;
+}
+
+void ChaChaRNG::begin(mesh::RNG& source) {
+  uint8_t key[CHACHA_KEY_SIZE];
+  source.random(key, sizeof(key));
+  _chacha.setKey(key, sizeof(key));
+  memset(key, 0, sizeof(key));
+  refill();
+}
+
+void ChaChaRNG::begin(long seed) {
+  randomSeed(seed);
+  uint8_t key[CHACHA_KEY_SIZE];
+  for (int i = 0; i < (int) sizeof(key); i++) {
+    key[i] = (::random(0, 256) & 0xFF);
+  }
+  mesh::Utils::sha256(key, sizeof(key), key, sizeof(key), (const uint8_t *) &seed, sizeof(seed));
+  _chacha.setKey(key, sizeof(key));
+  memset(key, 0, sizeof(key));
+  refill();
+}
+
+void ChaChaRNG::addEntropy(const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    _pool[_pool_pos] ^= data[i];
+    _pool_pos = (_pool_pos + 1) % sizeof(_pool);
+  }
+  if (++_pool_events >= CHACHA_RESEED_EVENTS) {
+    rekey(_pool, sizeof(_pool));
+    memset(_pool, 0, sizeof(_pool));
+    _pool_pos = _pool_events = 0;
+  }
+}
+
+void ChaChaRNG::rekey(const uint8_t* data, size_t len) {
+  uint8_t key[CHACHA_KEY_SIZE];
+  random(key, sizeof(key));
+  mesh::Utils::sha256(key, sizeof(key), key, sizeof(key), data, len);
+  _chacha.setKey(key, sizeof(key));
+  memset(key, 0, sizeof(key));
+  refill();   // discard any output buffered under the old key
+}
+
+void ChaChaRNG::random(uint8_t* dest, size_t sz) {
+  while (sz > 0) {
+    if (_avail == 0) refill();
+
+    size_t n = sz < _avail ? sz : _avail;
+    uint8_t* src = &_buf[sizeof(_buf) - _avail];
+    memcpy(dest, src, n);
+    memset(src, 0, n);   // each byte is only handed out once
+    _avail -= n;
+    dest += n; sz -= n;
+  }
+}
+
+void HardwareRNG::random(uint8_t* dest, size_t sz) {
+  while (sz > 0) {
+    uint32_t r = _sample();
+#if defined(ESP32)
+    r ^= esp_random();
+#elif defined(NRF52_PLATFORM)
+    uint8_t sd_enabled = 0;
+    sd_softdevice_is_enabled(&sd_enabled);
+    if (sd_enabled) {
+      uint8_t avail = 0;
+      uint32_t hw = 0;
+      while (avail < sizeof(hw)) sd_rand_application_bytes_available_get(&avail);
+      sd_rand_application_vector_get((uint8_t *) &hw, sizeof(hw));
+      r ^= hw;
+    } else {
+      NRF_RNG->CONFIG = RNG_CONFIG_DERCEN_Msk;   // bias correction
+      NRF_RNG->TASKS_START = 1;
+      for (int i = 0; i < 4; i++) {
+        NRF_RNG->EVENTS_VALRDY = 0;
+        while (NRF_RNG->EVENTS_VALRDY == 0) ;
+        r ^= ((uint32_t) NRF_RNG->VALUE) << (i * 8);
+      }
+      NRF_RNG->TASKS_STOP = 1;
+    }
+#elif defined(RP2040_PLATFORM)
+    r ^= rp2040.hwrand32();
+#endif
+    size_t n = sz < sizeof(r) ? sz : sizeof(r);
+    memcpy(dest, &r, n);
+    dest += n; sz -= n;
+  }
+}
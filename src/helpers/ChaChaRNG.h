@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Mesh.h>
+#include <ChaCha.h>
+
+/**
+ * \brief  A fast RNG, being the ChaCha20 keystream, seeded once from a (slow) entropy source. Output is generated
+ *     a block at a time and buffered, so most random() / nextInt() calls are just a copy. After each block, the key
+ *     is replaced with part of that block's own output (fast key erasure), so earlier output can't be recovered
+ *     from the current state.
+*/
+class ChaChaRNG : public mesh::RNG {
+  ChaCha _chacha;
+  uint8_t _buf[64];
+  uint8_t _avail;     // unused bytes, at end of _buf
+  uint8_t _pool[32];  // pending addEntropy() data, folded into the key every CHACHA_RESEED_EVENTS calls
+  uint8_t _pool_pos, _pool_events;
+
+  void refill();
+  void rekey(const uint8_t* data, size_t len);
+
+public:
+  ChaChaRNG() { _avail = _pool_pos = _pool_events = 0; memset(_buf, 0, sizeof(_buf)); memset(_pool, 0, sizeof(_pool)); }
+
+  /**
+   * \brief  (re)seeds from the given source, eg. the radio noise, or a hardware TRNG. (only called at startup)
+  */
+  void begin(mesh::RNG& source);
+
+  /**
+   * \brief  (re)seeds from the given number, mixed with the platform's random(). Same entropy as StdRNG::begin().
+  */
+  void begin(long seed);
+
+  /**
+   * \brief  mixes more entropy into the current key, eg. packet timings or SNR. Cheap: the data is XOR'd into a
+   *     pool, which is hashed into a new key every CHACHA_RESEED_EVENTS calls.
+  */
+  void addEntropy(const uint8_t* data, size_t len) override;
+
+  void random(uint8_t* dest, size_t sz) override;
+};
+
+/**
+ * \brief  A slow, seed-only entropy source for ChaChaRNG::begin(): the MCU's hardware TRNG (ESP32, nRF52, RP2040),
+ *     XOR'd with fresh values from 'sample' on every 4 bytes, eg. radio_get_rng_seed(), which samples radio noise.
+*/
+class HardwareRNG : public mesh::RNG {
+  uint32_t (*_sample)();
+
+public:
+  HardwareRNG(uint32_t (*sample)()) : _sample(sample) { }
+
+  void random(uint8_t* dest, size_t sz) override;
+};
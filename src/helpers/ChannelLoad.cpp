@@ -0,0 +1,56 @@
+#include "ChannelLoad.h"
+
+void ChannelLoad::update(unsigned long now, uint32_t total_air_time) {
+  if (!_started || total_air_time < _last_air) {   // first call, or stats were reset, just re-sync
+    _started = true;
+    _last_update = now;
+    _last_air = total_air_time;
+    return;
+  }
+  unsigned long elapsed = now - _last_update;
+  if (elapsed < CHANNEL_LOAD_WINDOW_MILLIS) return;
+
+  uint32_t sample = (uint64_t)(total_air_time - _last_air) * 100 / elapsed;
+  if (sample > 100) sample = 100;
+
+  _own = (_own + sample) / 2;   // EWMA, alpha = 1/2
+  _last_update = now;
+  _last_air = total_air_time;
+}
+
+void ChannelLoad::onPeerLoad(int percent, unsigned long now) {
+  if (percent < 0) return;   // not advertised
+  if (percent > 100) percent = 100;
+
+  if (!_has_peer || percent >= _peer || now - _peer_heard >= CHANNEL_LOAD_PEER_MAX_AGE_MILLIS) {
+    _peer = percent;
+    _peer_heard = now;
+    _has_peer = true;
+  }
+}
+
+uint8_t ChannelLoad::getPercent(unsigned long now) const {
+  if (_has_peer && now - _peer_heard < CHANNEL_LOAD_PEER_MAX_AGE_MILLIS && _peer > _own) return _peer;
+  return _own;
+}
+
+uint32_t ChannelLoad::scaleDelay(uint32_t window, unsigned long now) const {
+  uint8_t load = getPercent(now);
+  if (load <= CHANNEL_LOAD_NOMINAL_PERCENT) return window;
+  return window * (100 + 2*(load - CHANNEL_LOAD_NOMINAL_PERCENT)) / 100;   // up to 2.6x, when fully busy
+}
+
+uint8_t ChannelLoad::scaleHopLimit(uint8_t max_hops, unsigned long now) const {
+  uint8_t load = getPercent(now);
+  if (load <= CHANNEL_LOAD_HIGH_PERCENT) return max_hops;
+
+  int limit = CHANNEL_LOAD_HOPS_AT_HIGH - (CHANNEL_LOAD_HOPS_AT_HIGH - CHANNEL_LOAD_HOPS_AT_FULL)
+                  * (load - CHANNEL_LOAD_HIGH_PERCENT) / (100 - CHANNEL_LOAD_HIGH_PERCENT);
+  return limit < max_hops ? limit : max_hops;
+}
+
+uint32_t ChannelLoad::scaleInterval(uint32_t interval_millis, unsigned long now) const {
+  uint8_t load = getPercent(now);
+  if (load <= CHANNEL_LOAD_NOMINAL_PERCENT) return interval_millis;
+  return (uint64_t) interval_millis * (100 + 5*(load - CHANNEL_LOAD_NOMINAL_PERCENT)) / 100;   // up to 5x, when fully busy
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Mesh.h>
+
+#define CHANNEL_LOAD_WINDOW_MILLIS     60000   // sample period for own air time
+#define CHANNEL_LOAD_NOMINAL_PERCENT   20      // channel busy, at or below which nothing is scaled
+#define CHANNEL_LOAD_HIGH_PERCENT      50      // channel busy, above which flood hop limits are reduced
+#define CHANNEL_LOAD_HOPS_AT_HIGH      16      // flood hop limit at CHANNEL_LOAD_HIGH_PERCENT...
+#define CHANNEL_LOAD_HOPS_AT_FULL      4       // ...falling to this, when the channel is fully busy
+#define CHANNEL_LOAD_PEER_MAX_AGE_MILLIS  (30*60*1000)   // how long a neighbour's advertised load is used for
+#define CHANNEL_LOAD_ADVERT_STEP       10      // advertised percent is rounded down to this, so it rarely changes the advert
+
+/**
+ * \brief  Tracks how busy the radio channel is, as a percentage of time spent transmitting or receiving.
+ *     The own figure is sampled from the Dispatcher's air time counters, and is published in adverts (see
+ *     ADV_FEAT2_CHANNEL_LOAD), so neighbours learn of congestion they may not hear themselves (eg. hidden nodes).
+ *     The effective load is the greater of our own and the highest recently advertised by a neighbour, and from it
+ *     retransmit delays and advert intervals are stretched, and flood hop limits cut, so the mesh throttles itself
+ *     as the channel fills up.
+*/
+class ChannelLoad {
+  unsigned long _last_update;
+  uint32_t _last_air;
+  uint8_t _own;      // smoothed percent
+  uint8_t _peer;     // percent, highest heard recently
+  unsigned long _peer_heard;
+  bool _started, _has_peer;
+
+public:
+  ChannelLoad() { _last_update = _peer_heard = 0; _last_air = 0; _own = _peer = 0; _started = _has_peer = false; }
+
+  /**
+   * \brief  call regularly (eg. from loop()), samples are taken every CHANNEL_LOAD_WINDOW_MILLIS
+   * \param  total_air_time  running total of tx + rx air time, in millis
+  */
+  void update(unsigned long now, uint32_t total_air_time);
+
+  /**
+   * \brief  call with the load advertised by a neighbour
+   * \param  percent  as from AdvertDataParser::getChannelLoad(), ie. -1 if not advertised
+  */
+  void onPeerLoad(int percent, unsigned long now);
+
+  uint8_t getOwnPercent() const { return _own; }
+  uint8_t getAdvertPercent() const { return _own - _own % CHANNEL_LOAD_ADVERT_STEP; }
+  uint8_t getPercent(unsigned long now) const;
+
+  /** \returns  a retransmit delay window, widened for the current load */
+  uint32_t scaleDelay(uint32_t window, unsigned long now) const;
+
+  /** \returns  the given flood hop limit, or a lower one if the channel is heavily loaded */
+  uint8_t scaleHopLimit(uint8_t max_hops, unsigned long now) const;
+
+  /** \returns  an advert (or other periodic) interval, stretched for the current load */
+  uint32_t scaleInterval(uint32_t interval_millis, unsigned long now) const;
+};
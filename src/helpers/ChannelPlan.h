@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#define CHANNEL_PLAN_MAX   16   // channels, so a set of them fits a bitmask
+
+/**
+ * \brief  A plan of 'num' LoRa channels, from a base frequency up, at 'spacing' apart. Each node has a home channel
+ *     (eg. by region) which it listens on. Optionally, all channels hop together every 'hop_secs' (by RTC clock), so
+ *     each node keeps its offset from the others, and a neighbour's current channel is still known from its home one.
+*/
+class ChannelPlan {
+  float _base, _spacing;   // MHz
+  uint8_t _num;
+  uint32_t _hop_secs;
+
+public:
+  ChannelPlan() : _base(0), _spacing(0), _num(1), _hop_secs(0) { }
+
+  void set(float base_freq, float spacing_khz, uint8_t num, uint32_t hop_secs) {
+    _base = base_freq;
+    _spacing = spacing_khz / 1000.0f;
+    _num = num < 1 ? 1 : (num > CHANNEL_PLAN_MAX ? CHANNEL_PLAN_MAX : num);
+    _hop_secs = hop_secs;
+  }
+
+  bool isEnabled() const { return _num > 1; }
+  uint8_t getNumChannels() const { return _num; }
+  uint32_t getHopSecs() const { return _hop_secs; }
+  uint32_t getAllMask() const { return (1UL << _num) - 1; }
+
+  /**
+   * \returns  the channel that nodes with 'home' channel are listening on, at RTC time 'now'
+  */
+  uint8_t getActive(uint8_t home, uint32_t now) const {
+    if (_hop_secs == 0) return home % _num;
+    return (home + now / _hop_secs) % _num;
+  }
+
+  float getFreq(uint8_t channel) const { return _base + (channel % _num) * _spacing; }
+
+  /**
+   * \returns  a default home channel, spread evenly by node identity
+  */
+  uint8_t homeFor(const uint8_t* pub_key) const { return pub_key[0] % _num; }
+};
@@ -1,122 +1,421 @@
 #include "ClientACL.h"
+#include "FlashWriter.h"
 
-static File openWrite(FILESYSTEM* _fs, const char* filename) {
+#define ACL_FILE       "/s_contacts"
+#define DORMANT_FILE   "/s_dormant"
+
+static File openReadWrite(FILESYSTEM* _fs, const char* filename) {   // for updating in place
   #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
-    _fs->remove(filename);
     return _fs->open(filename, FILE_O_WRITE);
   #elif defined(RP2040_PLATFORM)
-    return _fs->open(filename, "w");
+    return _fs->open(filename, _fs->exists(filename) ? "r+" : "w+");
   #else
-    return _fs->open(filename, "w", true);
+    return _fs->open(filename, _fs->exists(filename) ? "r+" : "w+", true);
   #endif
 }
 
+void ClientACL::packRecord(uint8_t* dest, const ClientInfo* c) {
+  uint8_t* dp = dest;
+  memcpy(dp, c->id.pub_key, 32); dp += 32;
+  *dp++ = c->permissions;
+  memcpy(dp, &c->extra.room.sync_since, 4); dp += 4;
+  memset(dp, 0, 2); dp += 2;   // unused
+  *dp++ = (uint8_t) c->out_path_len;
+  memcpy(dp, c->out_path, 64); dp += 64;
+  memcpy(dp, c->shared_secret, PUB_KEY_SIZE);
+}
+
+void ClientACL::unpackRecord(ClientInfo* c, const uint8_t* src) {
+  const uint8_t* sp = src;
+  memset(c, 0, sizeof(*c));
+  c->id = mesh::Identity(sp); sp += 32;
+  c->permissions = *sp++;
+  memcpy(&c->extra.room.sync_since, sp, 4); sp += 4;
+  sp += 2;   // unused
+  c->out_path_len = (int8_t) *sp++;
+  memcpy(c->out_path, sp, 64); sp += 64;
+  memcpy(c->shared_secret, sp, PUB_KEY_SIZE);
+}
+
+uint32_t ClientACL::recordHash(const uint8_t* rec) {
+  uint32_t h = 2166136261UL;   // FNV-1a
+  for (int i = 0; i < ACL_RECORD_SIZE; i++) {
+    h = (h ^ rec[i]) * 16777619UL;
+  }
+  return h;
+}
+
+void ClientACL::rebuildIndex() {
+  for (int b = 0; b < ACL_HASH_SIZE; b++) hash_head[b] = -1;
+  for (int i = 0; i < num_clients; i++) {
+    int b = clients[i].id.pub_key[0] % ACL_HASH_SIZE;
+    hash_next[i] = hash_head[b];
+    hash_head[b] = i;
+  }
+}
+
 void ClientACL::load(FILESYSTEM* _fs) {
+  _acl_fs = _fs;
   num_clients = 0;
-  if (_fs->exists("/s_contacts")) {
+  num_dormant = 0;
+  num_pinned = 0;
+  num_file_recs = 0;
+  need_rewrite = false;
+  if (_fs->exists(ACL_FILE)) {
   #if defined(RP2040_PLATFORM)
-    File file = _fs->open("/s_contacts", "r");
+    File file = _fs->open(ACL_FILE, "r");
   #else
-    File file = _fs->open("/s_contacts");
+    File file = _fs->open(ACL_FILE);
   #endif
     if (file) {
-      bool full = false;
-      while (!full) {
-        ClientInfo c;
-        uint8_t pub_key[32];
-        uint8_t unused[2];
-
-        memset(&c, 0, sizeof(c));
-
-        bool success = (file.read(pub_key, 32) == 32);
-        success = success && (file.read((uint8_t *) &c.permissions, 1) == 1);
-        success = success && (file.read((uint8_t *) &c.extra.room.sync_since, 4) == 4);
-        success = success && (file.read(unused, 2) == 2);
-        success = success && (file.read((uint8_t *)&c.out_path_len, 1) == 1);
-        success = success && (file.read(c.out_path, 64) == 64);
-        success = success && (file.read(c.shared_secret, PUB_KEY_SIZE) == PUB_KEY_SIZE);
-
-        if (!success) break; // EOF
-
-        c.id = mesh::Identity(pub_key);
-        if (num_clients < MAX_CLIENTS) {
-          clients[num_clients++] = c;
-        } else {
-          full = true;
+      uint8_t buf[ACL_RECORD_SIZE * ACL_LOAD_BATCH];
+      bool eof = false;
+      while (!eof) {
+        int n = file.read(buf, sizeof(buf)) / ACL_RECORD_SIZE;   // any partial record at end is ignored
+        if (n < ACL_LOAD_BATCH) eof = true;
+
+        for (int k = 0; k < n; k++, num_file_recs++) {
+          const uint8_t* rec = &buf[k * ACL_RECORD_SIZE];
+          if (rec[32] == 0) {
+            need_rewrite = true;   // a blanked record, compact the file (if it can be) on next save()
+          } else if (num_clients < MAX_CLIENTS) {
+            unpackRecord(&clients[num_clients], rec);
+            file_idx[num_clients] = num_file_recs;
+            file_hash[num_clients] = recordHash(rec);
+            num_clients++;
+          } else if (num_dormant < ACL_MAX_DORMANT) {   // just index it, see getClient()
+            addDormant(rec, num_file_recs);
+          } else {
+            need_rewrite = true;   // doesn't fit, so drop it on next save() (if there are none indexed)
+          }
         }
       }
       file.close();
     }
   }
+  rebuildIndex();
+  if (_dormant_fs) indexDormantFile();
 }
 
-void ClientACL::save(FILESYSTEM* _fs, bool (*filter)(ClientInfo*)) {
-  File file = openWrite(_fs, "/s_contacts");
-  if (file) {
-    uint8_t unused[2];
-    memset(unused, 0, sizeof(unused));
+void ClientACL::addDormant(const uint8_t* pub_key, int16_t rec_idx) {
+  memcpy(dormant[num_dormant].prefix, pub_key, ACL_DORMANT_PREFIX);
+  dormant[num_dormant].rec_idx = rec_idx;
+  num_dormant++;
+}
+
+bool ClientACL::hasDormantFileRecs() const {
+  for (int j = 0; j < num_dormant; j++) {
+    if (dormant[j].rec_idx >= 0) return true;
+  }
+  return false;
+}
+
+void ClientACL::setDormantStore(FILESYSTEM* fs) {
+  _dormant_fs = fs;
+  if (fs) indexDormantFile();
+}
+
+void ClientACL::indexDormantFile() {
+  for (int j = num_dormant - 1; j >= 0; j--) {   // (in case of re-index) forget the /s_dormant entries
+    if (dormant[j].rec_idx < 0) dormant[j] = dormant[--num_dormant];
+  }
+  if (!_dormant_fs->exists(DORMANT_FILE)) return;
+#if defined(RP2040_PLATFORM)
+  File file = _dormant_fs->open(DORMANT_FILE, "r");
+#else
+  File file = _dormant_fs->open(DORMANT_FILE);
+#endif
+  if (!file) return;
+
+  uint8_t rec[ACL_DORMANT_REC_SIZE];
+  for (int n = 0; n < ACL_MAX_DORMANT && num_dormant < ACL_MAX_DORMANT
+                  && file.read(rec, ACL_DORMANT_REC_SIZE) == ACL_DORMANT_REC_SIZE; n++) {
+    bool in_ram = false;
+    for (int i = hash_head[rec[0] % ACL_HASH_SIZE]; i >= 0 && !in_ram; i = hash_next[i]) {
+      in_ram = memcmp(rec, clients[i].id.pub_key, PUB_KEY_SIZE) == 0;
+    }
+    if (!isFreeDormant(rec) && !in_ram) addDormant(rec, -(1 + n));
+  }
+  file.close();
+}
+
+#define ACL_WRITE_RECS   4     // records per queued write, when rewriting whole file
+
+bool ClientACL::rewriteAll(FILESYSTEM* _fs, bool (*filter)(ClientInfo*)) {
+  bool success = true;
+  uint8_t buf[ACL_WRITE_RECS*ACL_RECORD_SIZE];
+  int n = 0;
+  uint8_t mode = FLASH_WRITE_REPLACE;
+  num_file_recs = 0;
+  for (int i = 0; i < num_clients; i++) {
+    auto c = &clients[i];
+    file_idx[i] = -1;
+    if (!success || c->permissions == 0 || (filter && !filter(c))) continue;    // skip deleted entries, or by filter function
+
+    packRecord(&buf[n], c);
+    file_idx[i] = num_file_recs++;
+    file_hash[i] = recordHash(&buf[n]);
+    n += ACL_RECORD_SIZE;
+    if (n == sizeof(buf)) {
+      success = flash_writer.write(_fs, ACL_FILE, buf, n, mode);
+      mode = FLASH_WRITE_APPEND;
+      n = 0;
+    }
+  }
+  if (success && (n > 0 || mode == FLASH_WRITE_REPLACE)) {   // (empty file, if no records)
+    success = flash_writer.write(_fs, ACL_FILE, buf, n, mode);
+  }
+  return success;
+}
 
-    for (int i = 0; i < num_clients; i++) {
+void ClientACL::save(FILESYSTEM* _fs, bool (*filter)(ClientInfo*)) {
+  _acl_fs = _fs;
+  if (!hasDormantFileRecs()) {   // else, the file holds dormant clients, so is only updated in place
+    if (!need_rewrite && !_fs->exists(ACL_FILE) && !flash_writer.isPending(ACL_FILE)) need_rewrite = true;
+    for (int i = 0; i < num_clients && !need_rewrite; i++) {
       auto c = &clients[i];
-      if (c->permissions == 0 || (filter && !filter(c))) continue;    // skip deleted entries, or by filter function
+      bool keep = c->permissions != 0 && (filter == NULL || filter(c));
+      if (!keep && file_idx[i] >= 0) need_rewrite = true;   // record has to be removed from file
+    }
+    if (need_rewrite) {
+      need_rewrite = !rewriteAll(_fs, filter);
+      return;
+    }
+  }
+
+  uint8_t rec[ACL_RECORD_SIZE];
+  for (int i = 0; i < num_clients; i++) {
+    auto c = &clients[i];
+    if (c->permissions == 0 || (filter && !filter(c))) {
+      if (file_idx[i] >= 0) {
+        blankRecord(file_idx[i]);
+        file_idx[i] = -1;
+      }
+      continue;
+    }
 
-      bool success = (file.write(c->id.pub_key, 32) == 32);
-      success = success && (file.write((uint8_t *) &c->permissions, 1) == 1);
-      success = success && (file.write((uint8_t *) &c->extra.room.sync_since, 4) == 4);
-      success = success && (file.write(unused, 2) == 2);
-      success = success && (file.write((uint8_t *)&c->out_path_len, 1) == 1);
-      success = success && (file.write(c->out_path, 64) == 64);
-      success = success && (file.write(c->shared_secret, PUB_KEY_SIZE) == PUB_KEY_SIZE);
+    packRecord(rec, c);
+    uint32_t h = recordHash(rec);
+    if (file_idx[i] >= 0 && h == file_hash[i]) continue;   // not changed
 
-      if (!success) break; // write failed
+    int idx = file_idx[i] >= 0 ? file_idx[i] : num_file_recs;   // in place, or append
+    if (!flash_writer.write(_fs, ACL_FILE, rec, ACL_RECORD_SIZE, FLASH_WRITE_AT, idx * ACL_RECORD_SIZE)) {
+      MESH_DEBUG_PRINTLN("ClientACL::save(): write failed, idx=%d", idx);
+      need_rewrite = true;   // try again from scratch, next time
+      break;
     }
-    file.close();
+    if (file_idx[i] < 0) file_idx[i] = num_file_recs++;
+    file_hash[i] = h;
   }
 }
 
 ClientInfo* ClientACL::getClient(const uint8_t* pubkey, int key_len) {
-  for (int i = 0; i < num_clients; i++) {
+  if (key_len < 1) {
+    return num_clients > 0 ? &clients[0] : NULL;   // (empty prefix matches anything)
+  }
+  for (int i = hash_head[pubkey[0] % ACL_HASH_SIZE]; i >= 0; i = hash_next[i]) {
     if (memcmp(pubkey, clients[i].id.pub_key, key_len) == 0) return &clients[i];  // already known
   }
-  return NULL;  // not found
+
+  num_pinned = 0;
+  int cmp_len = key_len < ACL_DORMANT_PREFIX ? key_len : ACL_DORMANT_PREFIX;
+  for (int j = 0; j < num_dormant; j++) {
+    if (memcmp(dormant[j].prefix, pubkey, cmp_len) != 0) continue;
+
+    ClientInfo* c = pageInAt(j, pubkey, key_len);
+    if (c) return c;   // else, a prefix clash
+  }
+  return NULL;
 }
 
-ClientInfo* ClientACL::putClient(const mesh::Identity& id, uint8_t init_perms) {
+int ClientACL::pageInByHash(const uint8_t* hash, int hash_len) {
+  num_pinned = 0;
+  for (int i = 0; i < num_clients && num_pinned < ACL_PAGE_IN_MATCHES; i++) {   // don't evict the ones already in RAM
+    if (memcmp(clients[i].id.pub_key, hash, hash_len) == 0) pinned[num_pinned++] = i;
+  }
+
+  int n = 0;
+  int cmp_len = hash_len < ACL_DORMANT_PREFIX ? hash_len : ACL_DORMANT_PREFIX;
+  int j = 0, left = num_dormant;   // (page-ins may append evicted clients, these aren't looked at)
+  for (; left > 0 && n < ACL_PAGE_IN_MATCHES; left--) {
+    if (memcmp(dormant[j].prefix, hash, cmp_len) == 0 && pageInAt(j, hash, hash_len)) {
+      n++;   // entry j is now the one that was last
+    } else {
+      j++;
+    }
+  }
+  return n;
+}
+
+bool ClientACL::isPinned(int i) const {
+  for (int k = 0; k < num_pinned; k++) {
+    if (pinned[k] == i) return true;
+  }
+  return false;
+}
+
+int ClientACL::allocSlot(bool& evicted) {
+  if (num_clients < MAX_CLIENTS) {
+    evicted = false;
+    file_idx[num_clients] = -1;
+    return num_clients++;
+  }
+
   uint32_t min_time = 0xFFFFFFFF;
-  ClientInfo* oldest = &clients[MAX_CLIENTS - 1];
+  int oldest = MAX_CLIENTS - 1;
   for (int i = 0; i < num_clients; i++) {
-    if (id.matches(clients[i].id)) return &clients[i];  // already known
-    if (!clients[i].isAdmin() && clients[i].last_activity < min_time) {
-      oldest = &clients[i];
-      min_time = oldest->last_activity;
+    if (!isPinned(i) && !clients[i].isAdmin() && clients[i].last_activity < min_time) {
+      oldest = i;
+      min_time = clients[i].last_activity;
     }
   }
+  // evict least active contact: to the dormant index, if there's room (else its record in file, if any, is
+  // overwritten by next save())
+  pageOut(oldest);
+  evicted = true;
+  return oldest;
+}
 
-  ClientInfo* c;
-  if (num_clients < MAX_CLIENTS) {
-    c = &clients[num_clients++];
+bool ClientACL::pageOut(int i) {
+  const ClientInfo* c = &clients[i];
+  if (file_idx[i] < 0) {   // no record in file, so to /s_dormant (if enabled)
+    return _dormant_fs && writeDormant(c) >= 0;
+  }
+  if (_acl_fs == NULL || num_dormant >= ACL_MAX_DORMANT) return false;
+
+  uint8_t rec[ACL_RECORD_SIZE];
+  packRecord(rec, c);
+  if (recordHash(rec) != file_hash[i]
+      && !flash_writer.write(_acl_fs, ACL_FILE, rec, ACL_RECORD_SIZE, FLASH_WRITE_AT, file_idx[i] * ACL_RECORD_SIZE)) {
+    return false;   // couldn't bring its record up to date
+  }
+  addDormant(c->id.pub_key, file_idx[i]);
+  file_idx[i] = -1;
+  return true;
+}
+
+ClientInfo* ClientACL::pageInAt(int j, const uint8_t* pubkey, int key_len) {
+  int16_t rec_idx = dormant[j].rec_idx;
+  uint8_t rec[ACL_DORMANT_REC_SIZE];
+  bool found = rec_idx >= 0 ? readRecord(rec_idx, rec) : readDormant(-1 - rec_idx, rec);
+  if (!found || (rec_idx >= 0 ? rec[32] == 0 : isFreeDormant(rec)) || memcmp(rec, pubkey, key_len) != 0) return NULL;   // prefix clash
+
+  dormant[j] = dormant[--num_dormant];
+  if (rec_idx < 0) {   // free the /s_dormant slot (zeroed pub_key)
+    File file = openReadWrite(_dormant_fs, DORMANT_FILE);
+    if (file) {
+      uint8_t zero[PUB_KEY_SIZE];
+      memset(zero, 0, sizeof(zero));
+      file.seek((-1 - rec_idx) * ACL_DORMANT_REC_SIZE);
+      file.write(zero, sizeof(zero));
+      file.close();
+    }
+  }
+
+  bool evicted;
+  int i = allocSlot(evicted);
+  unpackRecord(&clients[i], rec);
+  if (rec_idx >= 0) {
+    file_idx[i] = rec_idx;
+    file_hash[i] = recordHash(rec);
   } else {
-    c = oldest;  // evict least active contact
+    file_idx[i] = -1;
+    memcpy(&clients[i].last_activity, &rec[ACL_RECORD_SIZE], 4);
+  }
+  if (num_pinned < (int) (sizeof(pinned) / sizeof(pinned[0]))) pinned[num_pinned++] = i;
+  rebuildIndex();
+  return &clients[i];
+}
+
+bool ClientACL::readRecord(int idx, uint8_t* rec) {
+  if (flash_writer.isPending(ACL_FILE)) flash_writer.flush();   // (may be changes to this record queued)
+#if defined(RP2040_PLATFORM)
+  File file = _acl_fs->open(ACL_FILE, "r");
+#else
+  File file = _acl_fs->open(ACL_FILE);
+#endif
+  if (!file) return false;
+
+  bool success = file.seek(idx * ACL_RECORD_SIZE) && file.read(rec, ACL_RECORD_SIZE) == ACL_RECORD_SIZE;
+  file.close();
+  return success;
+}
+
+bool ClientACL::isFreeDormant(const uint8_t* rec) {
+  for (int k = 0; k < PUB_KEY_SIZE; k++) {
+    if (rec[k] != 0) return false;
+  }
+  return true;   // (can't use permissions = 0, as guests have that)
+}
+
+bool ClientACL::readDormant(int slot, uint8_t* rec) {
+#if defined(RP2040_PLATFORM)
+  File file = _dormant_fs->open(DORMANT_FILE, "r");
+#else
+  File file = _dormant_fs->open(DORMANT_FILE);
+#endif
+  if (!file) return false;
+
+  bool success = file.seek(slot * ACL_DORMANT_REC_SIZE) && file.read(rec, ACL_DORMANT_REC_SIZE) == ACL_DORMANT_REC_SIZE;
+  file.close();
+  return success;
+}
+
+void ClientACL::blankRecord(int idx) {
+  if (_acl_fs == NULL) return;
+
+  uint8_t zero = 0;   // permissions = 0, ie. a hole, skipped by load()
+  if (!flash_writer.write(_acl_fs, ACL_FILE, &zero, 1, FLASH_WRITE_AT, idx * ACL_RECORD_SIZE + 32)) {
+    MESH_DEBUG_PRINTLN("ClientACL::blankRecord(): write failed, idx=%d", idx);
   }
+}
+
+ClientInfo* ClientACL::putClient(const mesh::Identity& id, uint8_t init_perms) {
+  ClientInfo* c = getClient(id.pub_key, PUB_KEY_SIZE);
+  if (c) return c;  // already known
+
+  bool evicted;
+  c = &clients[allocSlot(evicted)];
   memset(c, 0, sizeof(*c));
   c->permissions = init_perms;
   c->id = id;
   c->out_path_len = -1;  // initially out_path is unknown
+
+  if (evicted) {
+    rebuildIndex();
+  } else {
+    int i = c - clients;
+    int b = id.pub_key[0] % ACL_HASH_SIZE;
+    hash_next[i] = hash_head[b];
+    hash_head[b] = i;
+  }
   return c;
 }
 
+void ClientACL::removeAt(int i) {
+  if (file_idx[i] >= 0) {
+    blankRecord(file_idx[i]);   // (in case the file can't be rewritten, see save())
+    need_rewrite = true;        // is a hole in the file now
+  }
+  num_pinned = 0;
+
+  num_clients--;   // delete from clients[]
+  while (i < num_clients) {
+    clients[i] = clients[i + 1];
+    file_idx[i] = file_idx[i + 1];
+    file_hash[i] = file_hash[i + 1];
+    i++;
+  }
+  rebuildIndex();
+}
+
 bool ClientACL::applyPermissions(const mesh::LocalIdentity& self_id, const uint8_t* pubkey, int key_len, uint8_t perms) {
   ClientInfo* c;
   if ((perms & PERM_ACL_ROLE_MASK) == PERM_ACL_GUEST) {  // guest role is not persisted in contacts
     c = getClient(pubkey, key_len);
     if (c == NULL) return false;   // partial pubkey not found
 
-    num_clients--;   // delete from contacts[]
-    int i = c - clients;
-    while (i < num_clients) {
-      clients[i] = clients[i + 1];
-      i++;
-    }
+    removeAt(c - clients);
   } else {
     if (key_len < PUB_KEY_SIZE) return false;   // need complete pubkey when adding/modifying
 
@@ -128,3 +427,78 @@ bool ClientACL::applyPermissions(const mesh::LocalIdentity& self_id, const uint8
   }
   return true;
 }
+
+int ClientACL::writeDormant(const ClientInfo* c) {
+  uint8_t used[(ACL_MAX_DORMANT + 7) / 8];   // /s_dormant slots in the index
+  memset(used, 0, sizeof(used));
+  for (int j = 0; j < num_dormant; j++) {
+    int slot = -1 - dormant[j].rec_idx;
+    if (slot >= 0) used[slot >> 3] |= (1 << (slot & 7));
+  }
+
+  File file = openReadWrite(_dormant_fs, DORMANT_FILE);
+  if (!file) return -1;
+
+  uint8_t rec[ACL_DORMANT_REC_SIZE];
+  int slot = -1;
+  if (num_dormant < ACL_MAX_DORMANT) {   // a free slot
+    for (slot = 0; used[slot >> 3] & (1 << (slot & 7)); slot++) ;
+  } else {   // index is full, so replace the least recently active in /s_dormant
+    uint32_t min_time = 0xFFFFFFFF;
+    for (int n = 0; n < ACL_MAX_DORMANT && file.read(rec, ACL_DORMANT_REC_SIZE) == ACL_DORMANT_REC_SIZE; n++) {
+      uint32_t t;
+      memcpy(&t, &rec[ACL_RECORD_SIZE], 4);
+      if ((used[n >> 3] & (1 << (n & 7))) && t < min_time) {
+        min_time = t;
+        slot = n;
+      }
+    }
+    if (slot < 0) {   // index is all records in /s_contacts
+      file.close();
+      return -1;
+    }
+  }
+
+  packRecord(rec, c);
+  memcpy(&rec[ACL_RECORD_SIZE], &c->last_activity, 4);
+  bool success = file.seek(slot * ACL_DORMANT_REC_SIZE) && file.write(rec, ACL_DORMANT_REC_SIZE) == ACL_DORMANT_REC_SIZE;
+  file.close();
+  if (!success) {
+    MESH_DEBUG_PRINTLN("ClientACL::writeDormant(): write failed, slot=%d", slot);
+    return -1;
+  }
+
+  for (int j = 0; j < num_dormant; j++) {   // forget the one replaced (if any)
+    if (dormant[j].rec_idx == -(1 + slot)) { dormant[j] = dormant[--num_dormant]; break; }
+  }
+  addDormant(c->id.pub_key, -(1 + slot));
+  return slot;
+}
+
+int ClientACL::evictInactive(uint32_t now, uint32_t max_idle_secs, bool (*keep)(ClientInfo*)) {
+  int num = 0;
+  for (int i = num_clients - 1; i >= 0; i--) {
+    auto c = &clients[i];
+    if (c->isAdmin() || c->last_activity == 0 || now - c->last_activity < max_idle_secs) continue;
+    if (keep && keep(c)) continue;
+
+    if (pageOut(i)) {
+      removeAt(i);
+      num++;
+    }
+  }
+  return num;
+}
+
+uint32_t ClientACL::calcSessionTicket(mesh::LocalIdentity& self_id, const ClientInfo* c) {
+  uint8_t prv_key[PRV_KEY_SIZE];
+  self_id.writeTo(prv_key, PRV_KEY_SIZE);
+
+  uint8_t client_data[PUB_KEY_SIZE + 1];
+  memcpy(client_data, c->id.pub_key, PUB_KEY_SIZE);
+  client_data[PUB_KEY_SIZE] = c->permissions;
+
+  uint32_t ticket;
+  mesh::Utils::sha256((uint8_t *) &ticket, sizeof(ticket), prv_key, PRV_KEY_SIZE, client_data, sizeof(client_data));
+  return ticket;
+}
@@ -21,10 +21,13 @@ struct ClientInfo {
   union  {
     struct {
       uint32_t sync_since;  // sync messages SINCE this timestamp (by OUR clock)
-      uint32_t pending_ack;
-      uint32_t push_post_timestamp;
+      uint32_t push_post_timestamp;   // newest post pushed (can be ahead of sync_since, by the posts in flight)
       unsigned long ack_timeout;
+      uint8_t  in_flight;             // pushes not yet ACKed
       uint8_t  push_failures;
+      uint8_t  group_member;          // was given the room key at login (broadcast mode)
+      uint8_t  push_idle;             // nothing left to push, until a new post (or pushes are reset)
+      unsigned long push_due;         // don't look for posts to push before this
     } room;
   } extra;
   
@@ -35,22 +38,120 @@ struct ClientInfo {
   #define MAX_CLIENTS           20
 #endif
 
+#define ACL_HASH_SIZE          16    // index buckets, by first byte of pub_key
+#define ACL_RECORD_SIZE        136   // bytes per client, in /s_contacts
+#define ACL_LOAD_BATCH         4     // records read from file at a time
+#ifndef ACL_MAX_DORMANT
+  #define ACL_MAX_DORMANT      128   // clients not in RAM (record in /s_contacts or /s_dormant), 6 bytes each of index
+#endif
+#define ACL_DORMANT_REC_SIZE   (ACL_RECORD_SIZE + 4)   // + last_activity
+#define ACL_DORMANT_PREFIX     4     // bytes of pub_key kept in the dormant index
+#ifndef ACL_PAGE_IN_MATCHES
+  #define ACL_PAGE_IN_MATCHES  4     // max clients paged in by one pageInByHash()
+#endif
+
+struct DormantClient {   // index entry, for a client not in RAM
+  uint8_t prefix[ACL_DORMANT_PREFIX];   // of pub_key
+  int16_t rec_idx;                      // record index in /s_contacts, or -(1 + slot) in /s_dormant
+};
+
+/**
+ * \brief  The clients of a server node, persisted in /s_contacts as fixed size records. save() only writes the
+ *     records which have changed since last loaded/saved (in place), and appends new ones. The whole file is only
+ *     rewritten when a record has to be removed from it.
+ *     Only MAX_CLIENTS are kept in RAM. The rest are 'dormant': just indexed (pub_key prefix -> record), and
+ *     getClient() pages one in on demand, evicting the least active client. A dormant client's record is either its
+ *     record in the file (ie. clients beyond MAX_CLIENTS at load(), or evicted ones which had a record), or, if
+ *     setDormantStore() was called, a slot in /s_dormant (evicted ones with no record in the file, eg. not persisted
+ *     by save()'s filter). While any file records are indexed, the file can't be rewritten, so a removed record is
+ *     blanked in place instead (permissions = 0), and skipped by load(). A free slot in /s_dormant has a zeroed pub_key.
+ *     NOTE: a ClientInfo* (or index) is only valid until the next call which may evict: getClient(), putClient(),
+ *     applyPermissions(), pageInByHash() or evictInactive(). (a client paged in by the same call is never evicted)
+*/
 class ClientACL {
   ClientInfo clients[MAX_CLIENTS];
   int num_clients;
+  int16_t file_idx[MAX_CLIENTS];     // record index in file, or -1 if not in file
+  uint32_t file_hash[MAX_CLIENTS];   // of record as last written to (or read from) file
+  int num_file_recs;
+  bool need_rewrite;
+  int16_t hash_head[ACL_HASH_SIZE];   // first client in each bucket, or -1
+  int16_t hash_next[MAX_CLIENTS];
+  DormantClient dormant[ACL_MAX_DORMANT];
+  int num_dormant;
+  int16_t pinned[ACL_PAGE_IN_MATCHES*2];   // clients matched/paged in by the current call (not to be evicted by it)
+  int num_pinned;
+  FILESYSTEM* _acl_fs;       // set by load()/save()
+  FILESYSTEM* _dormant_fs;   // NULL if /s_dormant is disabled
+
+  void rebuildIndex();
+  void removeAt(int i);
+  bool rewriteAll(FILESYSTEM* _fs, bool (*filter)(ClientInfo*));
+  static void packRecord(uint8_t* dest, const ClientInfo* c);
+  static void unpackRecord(ClientInfo* c, const uint8_t* src);
+  static uint32_t recordHash(const uint8_t* rec);
+  void indexDormantFile();
+  bool hasDormantFileRecs() const;
+  int writeDormant(const ClientInfo* c);
+  bool isPinned(int i) const;
+  int allocSlot(bool& evicted);
+  bool pageOut(int i);
+  ClientInfo* pageInAt(int j, const uint8_t* pubkey, int key_len);
+  bool readRecord(int idx, uint8_t* rec);
+  static bool isFreeDormant(const uint8_t* rec);
+  bool readDormant(int slot, uint8_t* rec);
+  void blankRecord(int idx);
+  void addDormant(const uint8_t* pub_key, int16_t rec_idx);
 
 public:
   ClientACL() { 
     memset(clients, 0, sizeof(clients));
     num_clients = 0;
+    num_file_recs = 0;
+    need_rewrite = true;
+    num_dormant = 0;
+    num_pinned = 0;
+    _acl_fs = NULL;
+    _dormant_fs = NULL;
+    rebuildIndex();
   }
   void load(FILESYSTEM* _fs);
   void save(FILESYSTEM* _fs, bool (*filter)(ClientInfo*)=NULL);
 
+  /**
+   * \returns  the client with this pub_key (prefix), paging it in from file if need be (which may evict another,
+   *      so any ClientInfo* from an earlier call may since refer to a different client)
+  */
   ClientInfo* getClient(const uint8_t* pubkey, int key_len);
   ClientInfo* putClient(const mesh::Identity& id, uint8_t init_perms);
   bool applyPermissions(const mesh::LocalIdentity& self_id, const uint8_t* pubkey, int key_len, uint8_t perms);
 
-  int getNumClients() const { return num_clients; }
+  /**
+   * \brief  enables /s_dormant, for evicted clients which have no record in /s_contacts (else they're forgotten).
+   *     Indexes the clients already in it. (call after load())
+  */
+  void setDormantStore(FILESYSTEM* fs);
+
+  /**
+   * \brief  pages in (up to ACL_PAGE_IN_MATCHES) dormant clients whose pub_key starts with 'hash', so that a search
+   *     of those in RAM (ie. by getClientByIdx()) also finds them. Eg. for Mesh::searchPeersByHash()
+   * \returns  number paged in
+  */
+  int pageInByHash(const uint8_t* hash, int hash_len);
+
+  /**
+   * \brief  page out (non-admin) clients which haven't been active for 'max_idle_secs', unless 'keep' says not to
+   * \returns  number of clients paged out
+  */
+  int evictInactive(uint32_t now, uint32_t max_idle_secs, bool (*keep)(ClientInfo*)=NULL);
+
+  int getNumClients() const { return num_clients; }   // (in RAM)
+  int getNumDormant() const { return num_dormant; }
   ClientInfo* getClientByIdx(int idx) { return &clients[idx]; }
+
+  /**
+   * \returns  session ticket given to 'c' in its login response, so it can log in again with a plain REQ (no ANON_REQ,
+   *      and no ECDH here). Derived from our private key, so nothing is stored, and changes with c's permissions.
+  */
+  static uint32_t calcSessionTicket(mesh::LocalIdentity& self_id, const ClientInfo* c);
 };
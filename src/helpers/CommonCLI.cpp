@@ -2,6 +2,9 @@
 #include "CommonCLI.h"
 #include "TxtDataHelpers.h"
 #include "AdvertDataHelpers.h"
+#include "FloodPolicy.h"
+#include "FlashWriter.h"
+#include "StatsFormatHelper.h"
 #include <RTClib.h>
 
 // Believe it or not, this std C function is busted on some platforms!
@@ -14,13 +17,27 @@ static uint32_t _atoi(const char* sp) {
   return n;
 }
 
+#define COM_PREFS_VERSION   1
+#define COM_PREFS_LEN       184
+
 void CommonCLI::loadPrefs(FILESYSTEM* fs) {
-  if (fs->exists("/com_prefs")) {
-    loadPrefsInt(fs, "/com_prefs");   // new filename
+  uint8_t blob[COM_PREFS_LEN];
+  uint8_t version;
+  int len = _prefs_file.load(fs, blob, sizeof(blob), version);
+  if (len >= 0 && version == COM_PREFS_VERSION) {
+    unpackPrefs(blob, len);
+  } else if (fs->exists("/com_prefs")) {
+    loadPrefsInt(fs, "/com_prefs");   // field by field format
+    if (savePrefs(fs)) {  // convert
+      flash_writer.flush();
+      fs->remove("/com_prefs");
+    }
   } else if (fs->exists("/node_prefs")) {
     loadPrefsInt(fs, "/node_prefs");
-    savePrefs(fs);  // save to new filename
-    fs->remove("/node_prefs");  // remove old
+    if (savePrefs(fs)) {  // remove old
+      flash_writer.flush();
+      fs->remove("/node_prefs");
+    }
   }
 }
 
@@ -31,130 +48,143 @@ void CommonCLI::loadPrefsInt(FILESYSTEM* fs, const char* filename) {
   File file = fs->open(filename);
 #endif
   if (file) {
-    uint8_t pad[8];
-
-    file.read((uint8_t *)&_prefs->airtime_factor, sizeof(_prefs->airtime_factor));    // 0
-    file.read((uint8_t *)&_prefs->node_name, sizeof(_prefs->node_name));              // 4
-    file.read(pad, 4);                                                                // 36
-    file.read((uint8_t *)&_prefs->node_lat, sizeof(_prefs->node_lat));                // 40
-    file.read((uint8_t *)&_prefs->node_lon, sizeof(_prefs->node_lon));                // 48
-    file.read((uint8_t *)&_prefs->password[0], sizeof(_prefs->password));             // 56
-    file.read((uint8_t *)&_prefs->freq, sizeof(_prefs->freq));                        // 72
-    file.read((uint8_t *)&_prefs->tx_power_dbm, sizeof(_prefs->tx_power_dbm));        // 76
-    file.read((uint8_t *)&_prefs->disable_fwd, sizeof(_prefs->disable_fwd));          // 77
-    file.read((uint8_t *)&_prefs->advert_interval, sizeof(_prefs->advert_interval));  // 78
-    file.read((uint8_t *)pad, 1);                                                     // 79  was 'unused'
-    file.read((uint8_t *)&_prefs->rx_delay_base, sizeof(_prefs->rx_delay_base));      // 80
-    file.read((uint8_t *)&_prefs->tx_delay_factor, sizeof(_prefs->tx_delay_factor));  // 84
-    file.read((uint8_t *)&_prefs->guest_password[0], sizeof(_prefs->guest_password)); // 88
-    file.read((uint8_t *)&_prefs->direct_tx_delay_factor, sizeof(_prefs->direct_tx_delay_factor)); // 104
-    file.read(pad, 4);                                                                             // 108
-    file.read((uint8_t *)&_prefs->sf, sizeof(_prefs->sf));                                         // 112
-    file.read((uint8_t *)&_prefs->cr, sizeof(_prefs->cr));                                         // 113
-    file.read((uint8_t *)&_prefs->allow_read_only, sizeof(_prefs->allow_read_only));               // 114
-    file.read((uint8_t *)&_prefs->multi_acks, sizeof(_prefs->multi_acks));                         // 115
-    file.read((uint8_t *)&_prefs->bw, sizeof(_prefs->bw));                                         // 116
-    file.read((uint8_t *)&_prefs->agc_reset_interval, sizeof(_prefs->agc_reset_interval));         // 120
-    file.read(pad, 3);                                                                             // 121
-    file.read((uint8_t *)&_prefs->flood_max, sizeof(_prefs->flood_max));                           // 124
-    file.read((uint8_t *)&_prefs->flood_advert_interval, sizeof(_prefs->flood_advert_interval));   // 125
-    file.read((uint8_t *)&_prefs->interference_threshold, sizeof(_prefs->interference_threshold)); // 126
-    file.read((uint8_t *)&_prefs->bridge_enabled, sizeof(_prefs->bridge_enabled));                 // 127
-    file.read((uint8_t *)&_prefs->bridge_delay, sizeof(_prefs->bridge_delay));                     // 128
-    file.read((uint8_t *)&_prefs->bridge_pkt_src, sizeof(_prefs->bridge_pkt_src));                 // 130
-    file.read((uint8_t *)&_prefs->bridge_baud, sizeof(_prefs->bridge_baud));                       // 131
-    file.read((uint8_t *)&_prefs->bridge_channel, sizeof(_prefs->bridge_channel));                 // 135
-    file.read((uint8_t *)&_prefs->bridge_secret, sizeof(_prefs->bridge_secret));                   // 136
-    file.read(pad, 4);                                                                             // 152
-    file.read((uint8_t *)&_prefs->gps_enabled, sizeof(_prefs->gps_enabled));                       // 156
-    file.read((uint8_t *)&_prefs->gps_interval, sizeof(_prefs->gps_interval));                     // 157
-    file.read((uint8_t *)&_prefs->advert_loc_policy, sizeof (_prefs->advert_loc_policy));          // 161
-    file.read((uint8_t *)&_prefs->discovery_mod_timestamp, sizeof(_prefs->discovery_mod_timestamp)); // 162
-    file.read((uint8_t *)&_prefs->adc_multiplier, sizeof(_prefs->adc_multiplier)); // 166
-    // 170
-
-    // sanitise bad pref values
-    _prefs->rx_delay_base = constrain(_prefs->rx_delay_base, 0, 20.0f);
-    _prefs->tx_delay_factor = constrain(_prefs->tx_delay_factor, 0, 2.0f);
-    _prefs->direct_tx_delay_factor = constrain(_prefs->direct_tx_delay_factor, 0, 2.0f);
-    _prefs->airtime_factor = constrain(_prefs->airtime_factor, 0, 9.0f);
-    _prefs->freq = constrain(_prefs->freq, 400.0f, 2500.0f);
-    _prefs->bw = constrain(_prefs->bw, 7.8f, 500.0f);
-    _prefs->sf = constrain(_prefs->sf, 5, 12);
-    _prefs->cr = constrain(_prefs->cr, 5, 8);
-    _prefs->tx_power_dbm = constrain(_prefs->tx_power_dbm, 1, 30);
-    _prefs->multi_acks = constrain(_prefs->multi_acks, 0, 1);
-    _prefs->adc_multiplier = constrain(_prefs->adc_multiplier, 0.0f, 10.0f);
-
-    // sanitise bad bridge pref values
-    _prefs->bridge_enabled = constrain(_prefs->bridge_enabled, 0, 1);
-    _prefs->bridge_delay = constrain(_prefs->bridge_delay, 0, 10000);
-    _prefs->bridge_pkt_src = constrain(_prefs->bridge_pkt_src, 0, 1);
-    _prefs->bridge_baud = constrain(_prefs->bridge_baud, 9600, 115200);
-    _prefs->bridge_channel = constrain(_prefs->bridge_channel, 0, 14);
-
-    _prefs->gps_enabled = constrain(_prefs->gps_enabled, 0, 1);
-    _prefs->advert_loc_policy = constrain(_prefs->advert_loc_policy, 0, 2);
-
+    uint8_t blob[COM_PREFS_LEN];
+    int len = file.read(blob, sizeof(blob));   // same layout as the blob
     file.close();
+    if (len > 0) unpackPrefs(blob, len);
   }
 }
 
-void CommonCLI::savePrefs(FILESYSTEM* fs) {
-#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
-  fs->remove("/com_prefs");
-  File file = fs->open("/com_prefs", FILE_O_WRITE);
-#elif defined(RP2040_PLATFORM)
-  File file = fs->open("/com_prefs", "w");
-#else
-  File file = fs->open("/com_prefs", "w", true);
-#endif
-  if (file) {
-    uint8_t pad[8];
-    memset(pad, 0, sizeof(pad));
-
-    file.write((uint8_t *)&_prefs->airtime_factor, sizeof(_prefs->airtime_factor));    // 0
-    file.write((uint8_t *)&_prefs->node_name, sizeof(_prefs->node_name));              // 4
-    file.write(pad, 4);                                                                // 36
-    file.write((uint8_t *)&_prefs->node_lat, sizeof(_prefs->node_lat));                // 40
-    file.write((uint8_t *)&_prefs->node_lon, sizeof(_prefs->node_lon));                // 48
-    file.write((uint8_t *)&_prefs->password[0], sizeof(_prefs->password));             // 56
-    file.write((uint8_t *)&_prefs->freq, sizeof(_prefs->freq));                        // 72
-    file.write((uint8_t *)&_prefs->tx_power_dbm, sizeof(_prefs->tx_power_dbm));        // 76
-    file.write((uint8_t *)&_prefs->disable_fwd, sizeof(_prefs->disable_fwd));          // 77
-    file.write((uint8_t *)&_prefs->advert_interval, sizeof(_prefs->advert_interval));  // 78
-    file.write((uint8_t *)pad, 1);                                                     // 79  was 'unused'
-    file.write((uint8_t *)&_prefs->rx_delay_base, sizeof(_prefs->rx_delay_base));      // 80
-    file.write((uint8_t *)&_prefs->tx_delay_factor, sizeof(_prefs->tx_delay_factor));  // 84
-    file.write((uint8_t *)&_prefs->guest_password[0], sizeof(_prefs->guest_password)); // 88
-    file.write((uint8_t *)&_prefs->direct_tx_delay_factor, sizeof(_prefs->direct_tx_delay_factor)); // 104
-    file.write(pad, 4);                                                                             // 108
-    file.write((uint8_t *)&_prefs->sf, sizeof(_prefs->sf));                                         // 112
-    file.write((uint8_t *)&_prefs->cr, sizeof(_prefs->cr));                                         // 113
-    file.write((uint8_t *)&_prefs->allow_read_only, sizeof(_prefs->allow_read_only));               // 114
-    file.write((uint8_t *)&_prefs->multi_acks, sizeof(_prefs->multi_acks));                         // 115
-    file.write((uint8_t *)&_prefs->bw, sizeof(_prefs->bw));                                         // 116
-    file.write((uint8_t *)&_prefs->agc_reset_interval, sizeof(_prefs->agc_reset_interval));         // 120
-    file.write(pad, 3);                                                                             // 121
-    file.write((uint8_t *)&_prefs->flood_max, sizeof(_prefs->flood_max));                           // 124
-    file.write((uint8_t *)&_prefs->flood_advert_interval, sizeof(_prefs->flood_advert_interval));   // 125
-    file.write((uint8_t *)&_prefs->interference_threshold, sizeof(_prefs->interference_threshold)); // 126
-    file.write((uint8_t *)&_prefs->bridge_enabled, sizeof(_prefs->bridge_enabled));                 // 127
-    file.write((uint8_t *)&_prefs->bridge_delay, sizeof(_prefs->bridge_delay));                     // 128
-    file.write((uint8_t *)&_prefs->bridge_pkt_src, sizeof(_prefs->bridge_pkt_src));                 // 130
-    file.write((uint8_t *)&_prefs->bridge_baud, sizeof(_prefs->bridge_baud));                       // 131
-    file.write((uint8_t *)&_prefs->bridge_channel, sizeof(_prefs->bridge_channel));                 // 135
-    file.write((uint8_t *)&_prefs->bridge_secret, sizeof(_prefs->bridge_secret));                   // 136
-    file.write(pad, 4);                                                                             // 152
-    file.write((uint8_t *)&_prefs->gps_enabled, sizeof(_prefs->gps_enabled));                       // 156
-    file.write((uint8_t *)&_prefs->gps_interval, sizeof(_prefs->gps_interval));                     // 157
-    file.write((uint8_t *)&_prefs->advert_loc_policy, sizeof(_prefs->advert_loc_policy));           // 161
-    file.write((uint8_t *)&_prefs->discovery_mod_timestamp, sizeof(_prefs->discovery_mod_timestamp)); // 162
-    file.write((uint8_t *)&_prefs->adc_multiplier, sizeof(_prefs->adc_multiplier));                 // 166
-    // 170
+void CommonCLI::unpackPrefs(const uint8_t* blob, int len) {
+  int i = 0;
+  PrefsFile::getField(blob, len, i, &_prefs->airtime_factor, sizeof(_prefs->airtime_factor));                   // 0
+  PrefsFile::getField(blob, len, i, &_prefs->node_name, sizeof(_prefs->node_name));                             // 4
+  i += 4;                                                                                                       // 36
+  PrefsFile::getField(blob, len, i, &_prefs->node_lat, sizeof(_prefs->node_lat));                               // 40
+  PrefsFile::getField(blob, len, i, &_prefs->node_lon, sizeof(_prefs->node_lon));                               // 48
+  PrefsFile::getField(blob, len, i, &_prefs->password[0], sizeof(_prefs->password));                            // 56
+  PrefsFile::getField(blob, len, i, &_prefs->freq, sizeof(_prefs->freq));                                       // 72
+  PrefsFile::getField(blob, len, i, &_prefs->tx_power_dbm, sizeof(_prefs->tx_power_dbm));                       // 76
+  PrefsFile::getField(blob, len, i, &_prefs->disable_fwd, sizeof(_prefs->disable_fwd));                         // 77
+  PrefsFile::getField(blob, len, i, &_prefs->advert_interval, sizeof(_prefs->advert_interval));                 // 78
+  i += 1;                                                                                                       // 79  was 'unused'
+  PrefsFile::getField(blob, len, i, &_prefs->rx_delay_base, sizeof(_prefs->rx_delay_base));                     // 80
+  PrefsFile::getField(blob, len, i, &_prefs->tx_delay_factor, sizeof(_prefs->tx_delay_factor));                 // 84
+  PrefsFile::getField(blob, len, i, &_prefs->guest_password[0], sizeof(_prefs->guest_password));                // 88
+  PrefsFile::getField(blob, len, i, &_prefs->direct_tx_delay_factor, sizeof(_prefs->direct_tx_delay_factor));   // 104
+  i += 4;                                                                                                       // 108
+  PrefsFile::getField(blob, len, i, &_prefs->sf, sizeof(_prefs->sf));                                           // 112
+  PrefsFile::getField(blob, len, i, &_prefs->cr, sizeof(_prefs->cr));                                           // 113
+  PrefsFile::getField(blob, len, i, &_prefs->allow_read_only, sizeof(_prefs->allow_read_only));                 // 114
+  PrefsFile::getField(blob, len, i, &_prefs->multi_acks, sizeof(_prefs->multi_acks));                           // 115
+  PrefsFile::getField(blob, len, i, &_prefs->bw, sizeof(_prefs->bw));                                           // 116
+  PrefsFile::getField(blob, len, i, &_prefs->agc_reset_interval, sizeof(_prefs->agc_reset_interval));           // 120
+  i += 3;                                                                                                       // 121
+  PrefsFile::getField(blob, len, i, &_prefs->flood_max, sizeof(_prefs->flood_max));                             // 124
+  PrefsFile::getField(blob, len, i, &_prefs->flood_advert_interval, sizeof(_prefs->flood_advert_interval));     // 125
+  PrefsFile::getField(blob, len, i, &_prefs->interference_threshold, sizeof(_prefs->interference_threshold));   // 126
+  PrefsFile::getField(blob, len, i, &_prefs->bridge_enabled, sizeof(_prefs->bridge_enabled));                   // 127
+  PrefsFile::getField(blob, len, i, &_prefs->bridge_delay, sizeof(_prefs->bridge_delay));                       // 128
+  PrefsFile::getField(blob, len, i, &_prefs->bridge_pkt_src, sizeof(_prefs->bridge_pkt_src));                   // 130
+  PrefsFile::getField(blob, len, i, &_prefs->bridge_baud, sizeof(_prefs->bridge_baud));                         // 131
+  PrefsFile::getField(blob, len, i, &_prefs->bridge_channel, sizeof(_prefs->bridge_channel));                   // 135
+  PrefsFile::getField(blob, len, i, &_prefs->bridge_secret, sizeof(_prefs->bridge_secret));                     // 136
+  i += 4;                                                                                                       // 152
+  PrefsFile::getField(blob, len, i, &_prefs->gps_enabled, sizeof(_prefs->gps_enabled));                         // 156
+  PrefsFile::getField(blob, len, i, &_prefs->gps_interval, sizeof(_prefs->gps_interval));                       // 157
+  PrefsFile::getField(blob, len, i, &_prefs->advert_loc_policy, sizeof(_prefs->advert_loc_policy));             // 161
+  PrefsFile::getField(blob, len, i, &_prefs->discovery_mod_timestamp, sizeof(_prefs->discovery_mod_timestamp)); // 162
+  PrefsFile::getField(blob, len, i, &_prefs->adc_multiplier, sizeof(_prefs->adc_multiplier));                   // 166
+  PrefsFile::getField(blob, len, i, &_prefs->num_backbone_peers, sizeof(_prefs->num_backbone_peers));           // 170
+  PrefsFile::getField(blob, len, i, &_prefs->backbone_peers, sizeof(_prefs->backbone_peers));                   // 171
+  PrefsFile::getField(blob, len, i, &_prefs->room_broadcast, sizeof(_prefs->room_broadcast));                   // 179
+  PrefsFile::getField(blob, len, i, &_prefs->room_key_epoch, sizeof(_prefs->room_key_epoch));                   // 180
+  PrefsFile::getField(blob, len, i, &_prefs->qos_aging, sizeof(_prefs->qos_aging));                             // 181
+  PrefsFile::getField(blob, len, i, &_prefs->net_coding, sizeof(_prefs->net_coding));                           // 183
+  // 184
 
-    file.close();
-  }
+  // sanitise bad pref values
+  _prefs->rx_delay_base = constrain(_prefs->rx_delay_base, 0, 20.0f);
+  _prefs->tx_delay_factor = constrain(_prefs->tx_delay_factor, 0, 2.0f);
+  _prefs->direct_tx_delay_factor = constrain(_prefs->direct_tx_delay_factor, 0, 2.0f);
+  _prefs->airtime_factor = constrain(_prefs->airtime_factor, 0, 9.0f);
+  _prefs->freq = constrain(_prefs->freq, 400.0f, 2500.0f);
+  _prefs->bw = constrain(_prefs->bw, 7.8f, 500.0f);
+  _prefs->sf = constrain(_prefs->sf, 5, 12);
+  _prefs->cr = constrain(_prefs->cr, 5, 8);
+  _prefs->tx_power_dbm = constrain(_prefs->tx_power_dbm, 1, 30);
+  _prefs->multi_acks = constrain(_prefs->multi_acks, 0, 1);
+  _prefs->adc_multiplier = constrain(_prefs->adc_multiplier, 0.0f, 10.0f);
+  _prefs->num_backbone_peers = constrain(_prefs->num_backbone_peers, 0, MAX_BACKBONE_PEERS);
+  _prefs->room_broadcast = constrain(_prefs->room_broadcast, 0, 1);
+  _prefs->qos_aging = constrain(_prefs->qos_aging, 0, 60000);
+  _prefs->net_coding = constrain(_prefs->net_coding, 0, 1);
+
+  // sanitise bad bridge pref values
+  _prefs->bridge_enabled = constrain(_prefs->bridge_enabled, 0, 1);
+  if (_prefs->bridge_delay != BRIDGE_DELAY_AUTO) _prefs->bridge_delay = constrain(_prefs->bridge_delay, 0, 10000);
+  _prefs->bridge_pkt_src = constrain(_prefs->bridge_pkt_src, 0, 1);
+  _prefs->bridge_baud = constrain(_prefs->bridge_baud, 9600, 921600);
+  _prefs->bridge_channel = constrain(_prefs->bridge_channel, 0, 14);
+
+  _prefs->gps_enabled = constrain(_prefs->gps_enabled, 0, 1);
+  _prefs->advert_loc_policy = constrain(_prefs->advert_loc_policy, 0, 2);
+}
+
+void CommonCLI::packPrefs(uint8_t* blob) {
+  int i = 0;
+  memset(blob, 0, COM_PREFS_LEN);   // for the pads
+
+  PrefsFile::putField(blob, i, &_prefs->airtime_factor, sizeof(_prefs->airtime_factor));                   // 0
+  PrefsFile::putField(blob, i, &_prefs->node_name, sizeof(_prefs->node_name));                             // 4
+  i += 4;                                                                                                  // 36
+  PrefsFile::putField(blob, i, &_prefs->node_lat, sizeof(_prefs->node_lat));                               // 40
+  PrefsFile::putField(blob, i, &_prefs->node_lon, sizeof(_prefs->node_lon));                               // 48
+  PrefsFile::putField(blob, i, &_prefs->password[0], sizeof(_prefs->password));                            // 56
+  PrefsFile::putField(blob, i, &_prefs->freq, sizeof(_prefs->freq));                                       // 72
+  PrefsFile::putField(blob, i, &_prefs->tx_power_dbm, sizeof(_prefs->tx_power_dbm));                       // 76
+  PrefsFile::putField(blob, i, &_prefs->disable_fwd, sizeof(_prefs->disable_fwd));                         // 77
+  PrefsFile::putField(blob, i, &_prefs->advert_interval, sizeof(_prefs->advert_interval));                 // 78
+  i += 1;                                                                                                  // 79  was 'unused'
+  PrefsFile::putField(blob, i, &_prefs->rx_delay_base, sizeof(_prefs->rx_delay_base));                     // 80
+  PrefsFile::putField(blob, i, &_prefs->tx_delay_factor, sizeof(_prefs->tx_delay_factor));                 // 84
+  PrefsFile::putField(blob, i, &_prefs->guest_password[0], sizeof(_prefs->guest_password));                // 88
+  PrefsFile::putField(blob, i, &_prefs->direct_tx_delay_factor, sizeof(_prefs->direct_tx_delay_factor));   // 104
+  i += 4;                                                                                                  // 108
+  PrefsFile::putField(blob, i, &_prefs->sf, sizeof(_prefs->sf));                                           // 112
+  PrefsFile::putField(blob, i, &_prefs->cr, sizeof(_prefs->cr));                                           // 113
+  PrefsFile::putField(blob, i, &_prefs->allow_read_only, sizeof(_prefs->allow_read_only));                 // 114
+  PrefsFile::putField(blob, i, &_prefs->multi_acks, sizeof(_prefs->multi_acks));                           // 115
+  PrefsFile::putField(blob, i, &_prefs->bw, sizeof(_prefs->bw));                                           // 116
+  PrefsFile::putField(blob, i, &_prefs->agc_reset_interval, sizeof(_prefs->agc_reset_interval));           // 120
+  i += 3;                                                                                                  // 121
+  PrefsFile::putField(blob, i, &_prefs->flood_max, sizeof(_prefs->flood_max));                             // 124
+  PrefsFile::putField(blob, i, &_prefs->flood_advert_interval, sizeof(_prefs->flood_advert_interval));     // 125
+  PrefsFile::putField(blob, i, &_prefs->interference_threshold, sizeof(_prefs->interference_threshold));   // 126
+  PrefsFile::putField(blob, i, &_prefs->bridge_enabled, sizeof(_prefs->bridge_enabled));                   // 127
+  PrefsFile::putField(blob, i, &_prefs->bridge_delay, sizeof(_prefs->bridge_delay));                       // 128
+  PrefsFile::putField(blob, i, &_prefs->bridge_pkt_src, sizeof(_prefs->bridge_pkt_src));                   // 130
+  PrefsFile::putField(blob, i, &_prefs->bridge_baud, sizeof(_prefs->bridge_baud));                         // 131
+  PrefsFile::putField(blob, i, &_prefs->bridge_channel, sizeof(_prefs->bridge_channel));                   // 135
+  PrefsFile::putField(blob, i, &_prefs->bridge_secret, sizeof(_prefs->bridge_secret));                     // 136
+  i += 4;                                                                                                  // 152
+  PrefsFile::putField(blob, i, &_prefs->gps_enabled, sizeof(_prefs->gps_enabled));                         // 156
+  PrefsFile::putField(blob, i, &_prefs->gps_interval, sizeof(_prefs->gps_interval));                       // 157
+  PrefsFile::putField(blob, i, &_prefs->advert_loc_policy, sizeof(_prefs->advert_loc_policy));             // 161
+  PrefsFile::putField(blob, i, &_prefs->discovery_mod_timestamp, sizeof(_prefs->discovery_mod_timestamp)); // 162
+  PrefsFile::putField(blob, i, &_prefs->adc_multiplier, sizeof(_prefs->adc_multiplier));                   // 166
+  PrefsFile::putField(blob, i, &_prefs->num_backbone_peers, sizeof(_prefs->num_backbone_peers));           // 170
+  PrefsFile::putField(blob, i, &_prefs->backbone_peers, sizeof(_prefs->backbone_peers));                   // 171
+  PrefsFile::putField(blob, i, &_prefs->room_broadcast, sizeof(_prefs->room_broadcast));                   // 179
+  PrefsFile::putField(blob, i, &_prefs->room_key_epoch, sizeof(_prefs->room_key_epoch));                   // 180
+  PrefsFile::putField(blob, i, &_prefs->qos_aging, sizeof(_prefs->qos_aging));                             // 181
+  PrefsFile::putField(blob, i, &_prefs->net_coding, sizeof(_prefs->net_coding));                           // 183
+}
+
+bool CommonCLI::savePrefs(FILESYSTEM* fs) {
+  uint8_t blob[COM_PREFS_LEN];
+  packPrefs(blob);
+  return _prefs_file.save(fs, blob, sizeof(blob), COM_PREFS_VERSION);
 }
 
 #define MIN_LOCAL_ADVERT_INTERVAL   60
@@ -166,535 +196,960 @@ void CommonCLI::savePrefs() {
   _callbacks->savePrefs();
 }
 
-uint8_t CommonCLI::buildAdvertData(uint8_t node_type, uint8_t* app_data) {
+uint8_t CommonCLI::buildAdvertData(uint8_t node_type, uint8_t* app_data, uint16_t feat1, uint16_t feat2) {
+  feat1 |= ADV_CAP_WIDE_HASH | ADV_CAP_BUNDLE;   // Mesh always accepts PAYLOAD_VER_3, and unpacks BUNDLE frames
   if (_prefs->advert_loc_policy == ADVERT_LOC_NONE) {
     AdvertDataBuilder builder(node_type, _prefs->node_name);
+    builder.setFeat1(feat1);
+    builder.setFeat2(feat2);
     return builder.encodeTo(app_data);
   } else if (_prefs->advert_loc_policy == ADVERT_LOC_SHARE) {
     AdvertDataBuilder builder(node_type, _prefs->node_name, _sensors->node_lat, _sensors->node_lon);
+    builder.setFeat1(feat1);
+    builder.setFeat2(feat2);
     return builder.encodeTo(app_data);
   } else {
     AdvertDataBuilder builder(node_type, _prefs->node_name, _prefs->node_lat, _prefs->node_lon);
+    builder.setFeat1(feat1);
+    builder.setFeat2(feat2);
     return builder.encodeTo(app_data);
   }
 }
 
-void CommonCLI::handleCommand(uint32_t sender_timestamp, const char* command, char* reply) {
-    if (memcmp(command, "reboot", 6) == 0) {
-      _board->reboot();  // doesn't return
-    } else if (memcmp(command, "advert", 6) == 0) {
-      _callbacks->sendSelfAdvertisement(1500);  // longer delay, give CLI response time to be sent first
-      strcpy(reply, "OK - Advert sent");
-    } else if (memcmp(command, "clock sync", 10) == 0) {
-      uint32_t curr = getRTCClock()->getCurrentTime();
-      if (sender_timestamp > curr) {
-        getRTCClock()->setCurrentTime(sender_timestamp + 1);
-        uint32_t now = getRTCClock()->getCurrentTime();
-        DateTime dt = DateTime(now);
-        sprintf(reply, "OK - clock set: %02d:%02d - %d/%d/%d UTC", dt.hour(), dt.minute(), dt.day(), dt.month(), dt.year());
-      } else {
-        strcpy(reply, "ERR: clock cannot go backwards");
-      }
-    } else if (memcmp(command, "start ota", 9) == 0) {
-      if (!_board->startOTAUpdate(_prefs->node_name, reply)) {
-        strcpy(reply, "Error");
+static uint8_t parseCaptureRoutes(const char* s) {
+  if (strcmp(s, "*") == 0) return PACKET_CAPTURE_ALL_ROUTES;
+  if (strcmp(s, "flood") == 0) return (1 << ROUTE_TYPE_FLOOD) | (1 << ROUTE_TYPE_TRANSPORT_FLOOD);
+  if (strcmp(s, "direct") == 0) return (1 << ROUTE_TYPE_DIRECT) | (1 << ROUTE_TYPE_TRANSPORT_DIRECT);
+  return 0;
+}
+
+void CommonCLI::handleCaptureCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  PacketCapture* cap = _callbacks->getPacketCapture();
+  if (cap == NULL) {
+    strcpy(reply, "Unknown command");
+    return;
+  }
+  command += 7;   // skip "capture"
+  while (*command == ' ') command++;
+
+  if (*command == 0) {
+    char* dp = reply;
+    dp += sprintf(dp, "> %s%s, %d/%d frames (%u seen), types=", cap->isEnabled() ? "on" : "off",
+                  cap->isStreaming() ? " (streaming)" : "", cap->getCount(), PACKET_CAPTURE_SLOTS, cap->getNumSeen());
+    if (cap->getTypeMask() == PACKET_CAPTURE_ALL_TYPES) {
+      dp += sprintf(dp, "*");
+    } else {
+      for (int t = 0; t <= PH_TYPE_MASK; t++) {
+        if (cap->getTypeMask() & (1 << t)) dp += sprintf(dp, "%s%s", dp[-1] == '=' ? "" : ",", FloodPolicy::getTypeName(t));
       }
-    } else if (memcmp(command, "clock", 5) == 0) {
+    }
+    uint8_t routes = cap->getRouteMask();
+    sprintf(dp, ", routes=%s", routes == PACKET_CAPTURE_ALL_ROUTES ? "*" : (routes == parseCaptureRoutes("flood") ? "flood" : "direct"));
+  } else if (strcmp(command, "on") == 0) {
+    cap->setEnabled(true);
+    strcpy(reply, "OK - capture on");
+  } else if (strcmp(command, "off") == 0) {
+    cap->setEnabled(false);
+    strcpy(reply, "OK - capture off");
+  } else if (strcmp(command, "clear") == 0) {
+    cap->clear();
+    strcpy(reply, "OK");
+  } else if (memcmp(command, "filter ", 7) == 0) {   // capture filter {type,...|*} [flood|direct|*]
+    char buf[48];
+    StrHelper::strncpy(buf, &command[7], sizeof(buf));
+    const char* parts[2];
+    int n = mesh::Utils::parseTextParts(buf, parts, 2, ' ');
+    uint8_t routes = n > 1 ? parseCaptureRoutes(parts[1]) : PACKET_CAPTURE_ALL_ROUTES;
+
+    uint16_t types = 0;
+    char* sp = (char *) parts[0];
+    while (sp && *sp) {
+      char* ep = strchr(sp, ',');
+      if (ep) *ep++ = 0;
+      int t = FloodPolicy::parseTypeName(sp);
+      if (t < 0) { types = 0; break; }
+      types |= t == FLOOD_RULE_ANY ? PACKET_CAPTURE_ALL_TYPES : (1 << t);
+      sp = ep;
+    }
+    if (types == 0 || routes == 0) {
+      strcpy(reply, "Err - bad filter");
+    } else {
+      cap->setFilter(types, routes);
+      strcpy(reply, "OK");
+    }
+  } else if (sender_timestamp == 0 && strcmp(command, "dump") == 0) {   // serial only
+    cap->exportHex(Serial, _prefs->freq, _prefs->bw, _prefs->sf);
+    strcpy(reply, "   EOF");
+  } else if (sender_timestamp == 0 && strcmp(command, "stream") == 0) {   // serial only
+    cap->setEnabled(true);
+    cap->setStream(&Serial, _prefs->freq, _prefs->bw, _prefs->sf);
+    strcpy(reply, "OK - streaming");
+  } else if (sender_timestamp == 0 && strcmp(command, "stream off") == 0) {
+    cap->setStream(NULL, 0, 0, 0);
+    strcpy(reply, "OK - stream off");
+  } else {
+    strcpy(reply, "Unknown command");
+  }
+}
+
+#define CLI_METHOD(fn)   CLICommandTable::method<CommonCLI, &CommonCLI::fn>
+
+void CommonCLI::addCommonCommands() {
+  addCommand("advert", CLI_METHOD(handleAdvertCmd), this);
+  addCommand("board", CLI_METHOD(handleBoardCmd), this);
+  addCommand("capture", CLI_METHOD(handleCaptureCmd), this);
+  addCommand("clear", CLI_METHOD(handleClearCmd), this);
+  addCommand("clock", CLI_METHOD(handleClockCmd), this);
+  addCommand("erase", CLI_METHOD(handleEraseCmd), this, CLI_SERIAL_ONLY);
+  addCommand("get", CLI_METHOD(handleGetCmd), this, CLI_HAS_PARAMS);
+#if ENV_INCLUDE_GPS == 1
+  addCommand("gps", CLI_METHOD(handleGpsCmd), this);
+#endif
+  addCommand("log", CLI_METHOD(handleLogCmd), this);
+  addCommand("neighbor.remove", CLI_METHOD(handleNeighborRemoveCmd), this, CLI_HAS_PARAMS);
+  addCommand("neighbors", CLI_METHOD(handleNeighborsCmd), this);
+  addCommand("password", CLI_METHOD(handlePasswordCmd), this, CLI_HAS_PARAMS);
+  addCommand("reboot", CLI_METHOD(handleRebootCmd), this);
+  addCommand("sensor", CLI_METHOD(handleSensorCmd), this);
+  addCommand("set", CLI_METHOD(handleSetCmd), this, CLI_HAS_PARAMS);
+  addCommand("start", CLI_METHOD(handleStartCmd), this);
+  addCommand("stats-core", CLI_METHOD(handleStatsCmd), this, CLI_SERIAL_ONLY);
+  addCommand("stats-dedup", CLI_METHOD(handleStatsCmd), this, CLI_SERIAL_ONLY);
+  addCommand("stats-loop", CLI_METHOD(handleStatsCmd), this, CLI_SERIAL_ONLY);
+  addCommand("stats-memory", CLI_METHOD(handleStatsCmd), this, CLI_SERIAL_ONLY);
+  addCommand("stats-packets", CLI_METHOD(handleStatsCmd), this, CLI_SERIAL_ONLY);
+  addCommand("stats-profile", CLI_METHOD(handleStatsCmd), this, CLI_SERIAL_ONLY);
+  addCommand("stats-radio", CLI_METHOD(handleStatsCmd), this, CLI_SERIAL_ONLY);
+  addCommand("tempradio", CLI_METHOD(handleTempRadioCmd), this, CLI_HAS_PARAMS);
+  addCommand("time", CLI_METHOD(handleTimeCmd), this, CLI_HAS_PARAMS);
+  addCommand("ver", CLI_METHOD(handleVerCmd), this);
+}
+
+bool CommonCLI::addCommand(const char* name, CLICommandFn fn, void* ctx, uint8_t flags) {
+  if (!_commands.add(name, fn, ctx, flags)) {
+    MESH_DEBUG_PRINTLN("CommonCLI::addCommand() table full, '%s' not added", name);
+    return false;
+  }
+  return true;
+}
+
+void CommonCLI::handleCommand(uint32_t sender_timestamp, char* command, char* reply) {
+  if (!_commands.dispatch(sender_timestamp, command, reply)) {
+    strcpy(reply, "Unknown command");
+  }
+}
+
+void CommonCLI::handleRebootCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  flash_writer.flush();   // (any saves still queued)
+  _board->reboot();  // doesn't return
+}
+
+void CommonCLI::handleAdvertCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  _callbacks->sendSelfAdvertisement(1500);  // longer delay, give CLI response time to be sent first
+  strcpy(reply, "OK - Advert sent");
+}
+
+void CommonCLI::handleClockCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  if (memcmp(command, "clock sync", 10) == 0) {
+    uint32_t curr = getRTCClock()->getCurrentTime();
+    if (sender_timestamp > curr) {
+      getRTCClock()->setCurrentTime(sender_timestamp + 1);
       uint32_t now = getRTCClock()->getCurrentTime();
       DateTime dt = DateTime(now);
-      sprintf(reply, "%02d:%02d - %d/%d/%d UTC", dt.hour(), dt.minute(), dt.day(), dt.month(), dt.year());
-    } else if (memcmp(command, "time ", 5) == 0) {  // set time (to epoch seconds)
-      uint32_t secs = _atoi(&command[5]);
-      uint32_t curr = getRTCClock()->getCurrentTime();
-      if (secs > curr) {
-        getRTCClock()->setCurrentTime(secs);
-        uint32_t now = getRTCClock()->getCurrentTime();
-        DateTime dt = DateTime(now);
-        sprintf(reply, "OK - clock set: %02d:%02d - %d/%d/%d UTC", dt.hour(), dt.minute(), dt.day(), dt.month(), dt.year());
-      } else {
-        strcpy(reply, "(ERR: clock cannot go backwards)");
-      }
-    } else if (memcmp(command, "neighbors", 9) == 0) {
-      _callbacks->formatNeighborsReply(reply);
-    } else if (memcmp(command, "neighbor.remove ", 16) == 0) {
-      const char* hex = &command[16];
-      uint8_t pubkey[PUB_KEY_SIZE];
-      int hex_len = min((int)strlen(hex), PUB_KEY_SIZE*2);
-      int pubkey_len = hex_len / 2;
-      if (mesh::Utils::fromHex(pubkey, pubkey_len, hex)) {
-        _callbacks->removeNeighbor(pubkey, pubkey_len);
-        strcpy(reply, "OK");
-      } else {
-        strcpy(reply, "ERR: bad pubkey");
-      }
-    } else if (memcmp(command, "tempradio ", 10) == 0) {
-      strcpy(tmp, &command[10]);
-      const char *parts[5];
-      int num = mesh::Utils::parseTextParts(tmp, parts, 5);
-      float freq  = num > 0 ? strtof(parts[0], nullptr) : 0.0f;
-      float bw    = num > 1 ? strtof(parts[1], nullptr) : 0.0f;
-      uint8_t sf  = num > 2 ? atoi(parts[2]) : 0;
-      uint8_t cr  = num > 3 ? atoi(parts[3]) : 0;
-      int temp_timeout_mins  = num > 4 ? atoi(parts[4]) : 0;
-      if (freq >= 300.0f && freq <= 2500.0f && sf >= 5 && sf <= 12 && cr >= 5 && cr <= 8 && bw >= 7.0f && bw <= 500.0f && temp_timeout_mins > 0) {
-        _callbacks->applyTempRadioParams(freq, bw, sf, cr, temp_timeout_mins);
-        sprintf(reply, "OK - temp params for %d mins", temp_timeout_mins);
-      } else {
-        strcpy(reply, "Error, invalid params");
-      }
-    } else if (memcmp(command, "password ", 9) == 0) {
-      // change admin password
-      StrHelper::strncpy(_prefs->password, &command[9], sizeof(_prefs->password));
-      savePrefs();
-      sprintf(reply, "password now: %s", _prefs->password);   // echo back just to let admin know for sure!!
-    } else if (memcmp(command, "clear stats", 11) == 0) {
-      _callbacks->clearStats();
-      strcpy(reply, "(OK - stats reset)");
-    /*
-     * GET commands
-     */
-    } else if (memcmp(command, "get ", 4) == 0) {
-      const char* config = &command[4];
-      if (memcmp(config, "af", 2) == 0) {
-        sprintf(reply, "> %s", StrHelper::ftoa(_prefs->airtime_factor));
-      } else if (memcmp(config, "int.thresh", 10) == 0) {
-        sprintf(reply, "> %d", (uint32_t) _prefs->interference_threshold);
-      } else if (memcmp(config, "agc.reset.interval", 18) == 0) {
-        sprintf(reply, "> %d", ((uint32_t) _prefs->agc_reset_interval) * 4);
-      } else if (memcmp(config, "multi.acks", 10) == 0) {
-        sprintf(reply, "> %d", (uint32_t) _prefs->multi_acks);
-      } else if (memcmp(config, "allow.read.only", 15) == 0) {
-        sprintf(reply, "> %s", _prefs->allow_read_only ? "on" : "off");
-      } else if (memcmp(config, "flood.advert.interval", 21) == 0) {
-        sprintf(reply, "> %d", ((uint32_t) _prefs->flood_advert_interval));
-      } else if (memcmp(config, "advert.interval", 15) == 0) {
-        sprintf(reply, "> %d", ((uint32_t) _prefs->advert_interval) * 2);
-      } else if (memcmp(config, "guest.password", 14) == 0) {
-        sprintf(reply, "> %s", _prefs->guest_password);
-      } else if (sender_timestamp == 0 && memcmp(config, "prv.key", 7) == 0) {  // from serial command line only
-        uint8_t prv_key[PRV_KEY_SIZE];
-        int len = _callbacks->getSelfId().writeTo(prv_key, PRV_KEY_SIZE);
-        mesh::Utils::toHex(tmp, prv_key, len);
-        sprintf(reply, "> %s", tmp);
-      } else if (memcmp(config, "name", 4) == 0) {
-        sprintf(reply, "> %s", _prefs->node_name);
-      } else if (memcmp(config, "repeat", 6) == 0) {
-        sprintf(reply, "> %s", _prefs->disable_fwd ? "off" : "on");
-      } else if (memcmp(config, "lat", 3) == 0) {
-        sprintf(reply, "> %s", StrHelper::ftoa(_prefs->node_lat));
-      } else if (memcmp(config, "lon", 3) == 0) {
-        sprintf(reply, "> %s", StrHelper::ftoa(_prefs->node_lon));
-      } else if (memcmp(config, "radio", 5) == 0) {
-        char freq[16], bw[16];
-        strcpy(freq, StrHelper::ftoa(_prefs->freq));
-        strcpy(bw, StrHelper::ftoa3(_prefs->bw));
-        sprintf(reply, "> %s,%s,%d,%d", freq, bw, (uint32_t)_prefs->sf, (uint32_t)_prefs->cr);
-      } else if (memcmp(config, "rxdelay", 7) == 0) {
-        sprintf(reply, "> %s", StrHelper::ftoa(_prefs->rx_delay_base));
-      } else if (memcmp(config, "txdelay", 7) == 0) {
-        sprintf(reply, "> %s", StrHelper::ftoa(_prefs->tx_delay_factor));
-      } else if (memcmp(config, "flood.max", 9) == 0) {
-        sprintf(reply, "> %d", (uint32_t)_prefs->flood_max);
-      } else if (memcmp(config, "direct.txdelay", 14) == 0) {
-        sprintf(reply, "> %s", StrHelper::ftoa(_prefs->direct_tx_delay_factor));
-      } else if (memcmp(config, "tx", 2) == 0 && (config[2] == 0 || config[2] == ' ')) {
-        sprintf(reply, "> %d", (uint32_t) _prefs->tx_power_dbm);
-      } else if (memcmp(config, "freq", 4) == 0) {
-        sprintf(reply, "> %s", StrHelper::ftoa(_prefs->freq));
-      } else if (memcmp(config, "public.key", 10) == 0) {
-        strcpy(reply, "> ");
-        mesh::Utils::toHex(&reply[2], _callbacks->getSelfId().pub_key, PUB_KEY_SIZE);
-      } else if (memcmp(config, "role", 4) == 0) {
-        sprintf(reply, "> %s", _callbacks->getRole());
-      } else if (memcmp(config, "bridge.type", 11) == 0) {
-        sprintf(reply, "> %s",
+      sprintf(reply, "OK - clock set: %02d:%02d - %d/%d/%d UTC", dt.hour(), dt.minute(), dt.day(), dt.month(), dt.year());
+    } else {
+      strcpy(reply, "ERR: clock cannot go backwards");
+    }
+  } else {
+    uint32_t now = getRTCClock()->getCurrentTime();
+    DateTime dt = DateTime(now);
+    sprintf(reply, "%02d:%02d - %d/%d/%d UTC", dt.hour(), dt.minute(), dt.day(), dt.month(), dt.year());
+  }
+}
+
+void CommonCLI::handleStartCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  if (memcmp(command, "start ota", 9) == 0) {
+    if (!_board->startOTAUpdate(_prefs->node_name, reply)) {
+      strcpy(reply, "Error");
+    }
+  } else {
+    strcpy(reply, "Unknown command");
+  }
+}
+
+void CommonCLI::handleTimeCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  uint32_t secs = _atoi(&command[5]);
+  uint32_t curr = getRTCClock()->getCurrentTime();
+  if (secs > curr) {
+    getRTCClock()->setCurrentTime(secs);
+    uint32_t now = getRTCClock()->getCurrentTime();
+    DateTime dt = DateTime(now);
+    sprintf(reply, "OK - clock set: %02d:%02d - %d/%d/%d UTC", dt.hour(), dt.minute(), dt.day(), dt.month(), dt.year());
+  } else {
+    strcpy(reply, "(ERR: clock cannot go backwards)");
+  }
+}
+
+void CommonCLI::handleNeighborsCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  _callbacks->formatNeighborsReply(reply);
+}
+
+void CommonCLI::handleNeighborRemoveCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  const char* hex = &command[16];
+  uint8_t pubkey[PUB_KEY_SIZE];
+  int hex_len = min((int)strlen(hex), PUB_KEY_SIZE*2);
+  int pubkey_len = hex_len / 2;
+  if (mesh::Utils::fromHex(pubkey, pubkey_len, hex)) {
+    _callbacks->removeNeighbor(pubkey, pubkey_len);
+    strcpy(reply, "OK");
+  } else {
+    strcpy(reply, "ERR: bad pubkey");
+  }
+}
+
+void CommonCLI::handleTempRadioCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  strcpy(tmp, &command[10]);
+  const char *parts[5];
+  int num = mesh::Utils::parseTextParts(tmp, parts, 5);
+  float freq  = num > 0 ? strtof(parts[0], nullptr) : 0.0f;
+  float bw    = num > 1 ? strtof(parts[1], nullptr) : 0.0f;
+  uint8_t sf  = num > 2 ? atoi(parts[2]) : 0;
+  uint8_t cr  = num > 3 ? atoi(parts[3]) : 0;
+  int temp_timeout_mins  = num > 4 ? atoi(parts[4]) : 0;
+  if (freq >= 300.0f && freq <= 2500.0f && sf >= 5 && sf <= 12 && cr >= 5 && cr <= 8 && bw >= 7.0f && bw <= 500.0f && temp_timeout_mins > 0) {
+    _callbacks->applyTempRadioParams(freq, bw, sf, cr, temp_timeout_mins);
+    sprintf(reply, "OK - temp params for %d mins", temp_timeout_mins);
+  } else {
+    strcpy(reply, "Error, invalid params");
+  }
+}
+
+void CommonCLI::handlePasswordCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  // change admin password
+  StrHelper::strncpy(_prefs->password, &command[9], sizeof(_prefs->password));
+  savePrefs();
+  sprintf(reply, "password now: %s", _prefs->password);   // echo back just to let admin know for sure!!
+}
+
+void CommonCLI::handleClearCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  if (memcmp(command, "clear stats", 11) == 0) {
+    _callbacks->clearStats();
+    strcpy(reply, "(OK - stats reset)");
+  } else {
+    strcpy(reply, "Unknown command");
+  }
+}
+
+void CommonCLI::handleGetCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  const char* config = &command[4];
+  if (memcmp(config, "af", 2) == 0) {
+    sprintf(reply, "> %s", StrHelper::ftoa(_prefs->airtime_factor));
+  } else if (memcmp(config, "int.thresh", 10) == 0) {
+    sprintf(reply, "> %d", (uint32_t) _prefs->interference_threshold);
+  } else if (memcmp(config, "agc.reset.interval", 18) == 0) {
+    sprintf(reply, "> %d", ((uint32_t) _prefs->agc_reset_interval) * 4);
+  } else if (memcmp(config, "multi.acks", 10) == 0) {
+    sprintf(reply, "> %d", (uint32_t) _prefs->multi_acks);
+  } else if (memcmp(config, "allow.read.only", 15) == 0) {
+    sprintf(reply, "> %s", _prefs->allow_read_only ? "on" : "off");
+  } else if (memcmp(config, "room.broadcast", 14) == 0) {
+    sprintf(reply, "> %s", _prefs->room_broadcast ? "on" : "off");
+  } else if (memcmp(config, "qos.aging", 9) == 0) {
+    sprintf(reply, "> %d", (uint32_t) _prefs->qos_aging);
+  } else if (memcmp(config, "net.coding", 10) == 0) {
+    sprintf(reply, "> %s", _prefs->net_coding ? "on" : "off");
+  } else if (memcmp(config, "flood.advert.interval", 21) == 0) {
+    sprintf(reply, "> %d", ((uint32_t) _prefs->flood_advert_interval));
+  } else if (memcmp(config, "advert.interval", 15) == 0) {
+    sprintf(reply, "> %d", ((uint32_t) _prefs->advert_interval) * 2);
+  } else if (memcmp(config, "guest.password", 14) == 0) {
+    sprintf(reply, "> %s", _prefs->guest_password);
+  } else if (sender_timestamp == 0 && memcmp(config, "prv.key", 7) == 0) {  // from serial command line only
+    uint8_t prv_key[PRV_KEY_SIZE];
+    int len = _callbacks->getSelfId().writeTo(prv_key, PRV_KEY_SIZE);
+    mesh::Utils::toHex(tmp, prv_key, len);
+    sprintf(reply, "> %s", tmp);
+  } else if (memcmp(config, "name", 4) == 0) {
+    sprintf(reply, "> %s", _prefs->node_name);
+  } else if (memcmp(config, "repeat", 6) == 0) {
+    sprintf(reply, "> %s", _prefs->disable_fwd ? "off" : "on");
+  } else if (memcmp(config, "lat", 3) == 0) {
+    sprintf(reply, "> %s", StrHelper::ftoa(_prefs->node_lat));
+  } else if (memcmp(config, "lon", 3) == 0) {
+    sprintf(reply, "> %s", StrHelper::ftoa(_prefs->node_lon));
+  } else if (memcmp(config, "radio", 5) == 0) {
+    char freq[16], bw[16];
+    strcpy(freq, StrHelper::ftoa(_prefs->freq));
+    strcpy(bw, StrHelper::ftoa3(_prefs->bw));
+    sprintf(reply, "> %s,%s,%d,%d", freq, bw, (uint32_t)_prefs->sf, (uint32_t)_prefs->cr);
+  } else if (memcmp(config, "rxdelay", 7) == 0) {
+    sprintf(reply, "> %s", StrHelper::ftoa(_prefs->rx_delay_base));
+  } else if (memcmp(config, "txdelay", 7) == 0) {
+    sprintf(reply, "> %s", StrHelper::ftoa(_prefs->tx_delay_factor));
+  } else if (memcmp(config, "flood.max", 9) == 0) {
+    sprintf(reply, "> %d", (uint32_t)_prefs->flood_max);
+  } else if (memcmp(config, "direct.txdelay", 14) == 0) {
+    sprintf(reply, "> %s", StrHelper::ftoa(_prefs->direct_tx_delay_factor));
+  } else if (memcmp(config, "tx", 2) == 0 && (config[2] == 0 || config[2] == ' ')) {
+    sprintf(reply, "> %d", (uint32_t) _prefs->tx_power_dbm);
+  } else if (memcmp(config, "freq", 4) == 0) {
+    sprintf(reply, "> %s", StrHelper::ftoa(_prefs->freq));
+  } else if (memcmp(config, "public.key", 10) == 0) {
+    strcpy(reply, "> ");
+    mesh::Utils::toHex(&reply[2], _callbacks->getSelfId().pub_key, PUB_KEY_SIZE);
+  } else if (memcmp(config, "role", 4) == 0) {
+    sprintf(reply, "> %s", _callbacks->getRole());
+  } else if (memcmp(config, "bridge.type", 11) == 0) {
+    sprintf(reply, "> %s",
 #ifdef WITH_RS232_BRIDGE
-                "rs232"
+            "rs232"
 #elif WITH_ESPNOW_BRIDGE
-                "espnow"
+            "espnow"
+#elif WITH_UDP_BRIDGE
+            "udp"
 #else
-                "none"
+            "none"
 #endif
-        );
+    );
 #ifdef WITH_BRIDGE
-      } else if (memcmp(config, "bridge.enabled", 14) == 0) {
-        sprintf(reply, "> %s", _prefs->bridge_enabled ? "on" : "off");
-      } else if (memcmp(config, "bridge.delay", 12) == 0) {
-        sprintf(reply, "> %d", (uint32_t)_prefs->bridge_delay);
-      } else if (memcmp(config, "bridge.source", 13) == 0) {
-        sprintf(reply, "> %s", _prefs->bridge_pkt_src ? "logRx" : "logTx");
+  } else if (memcmp(config, "bridge.enabled", 14) == 0) {
+    sprintf(reply, "> %s", _prefs->bridge_enabled ? "on" : "off");
+  } else if (memcmp(config, "bridge.delay", 12) == 0) {
+    if (_prefs->bridge_delay == BRIDGE_DELAY_AUTO) {
+      strcpy(reply, "> auto");
+    } else {
+      sprintf(reply, "> %d", (uint32_t)_prefs->bridge_delay);
+    }
+  } else if (memcmp(config, "bridge.source", 13) == 0) {
+    sprintf(reply, "> %s", _prefs->bridge_pkt_src ? "logRx" : "logTx");
 #endif
 #ifdef WITH_RS232_BRIDGE
-      } else if (memcmp(config, "bridge.baud", 11) == 0) {
-        sprintf(reply, "> %d", (uint32_t)_prefs->bridge_baud);
+  } else if (memcmp(config, "bridge.baud", 11) == 0) {
+    sprintf(reply, "> %d", (uint32_t)_prefs->bridge_baud);
 #endif
 #ifdef WITH_ESPNOW_BRIDGE
-      } else if (memcmp(config, "bridge.channel", 14) == 0) {
-        sprintf(reply, "> %d", (uint32_t)_prefs->bridge_channel);
-      } else if (memcmp(config, "bridge.secret", 13) == 0) {
-        sprintf(reply, "> %s", _prefs->bridge_secret);
+  } else if (memcmp(config, "bridge.channel", 14) == 0) {
+    sprintf(reply, "> %d", (uint32_t)_prefs->bridge_channel);
 #endif
-      } else if (memcmp(config, "adc.multiplier", 14) == 0) {
-        float adc_mult = _board->getAdcMultiplier();
-        if (adc_mult == 0.0f) {
-          strcpy(reply, "Error: unsupported by this board");
-        } else {
-          sprintf(reply, "> %.3f", adc_mult);
-        }
-      } else {
-        sprintf(reply, "??: %s", config);
+#if defined(WITH_ESPNOW_BRIDGE) || defined(WITH_UDP_BRIDGE)
+  } else if (memcmp(config, "bridge.secret", 13) == 0) {
+    sprintf(reply, "> %s", _prefs->bridge_secret);
+#endif
+  } else if (memcmp(config, "backbone", 8) == 0) {
+    if (_prefs->num_backbone_peers == 0) {
+      strcpy(reply, "> off");
+    } else {
+      char* dp = &reply[2];
+      strcpy(reply, "> ");
+      for (int i = 0; i < _prefs->num_backbone_peers; i++) {
+        if (i > 0) *dp++ = ',';
+        mesh::Utils::toHex(dp, &_prefs->backbone_peers[i], 1); dp += 2;
       }
-    /*
-     * SET commands
-     */
-    } else if (memcmp(command, "set ", 4) == 0) {
-      const char* config = &command[4];
-      if (memcmp(config, "af ", 3) == 0) {
-        _prefs->airtime_factor = atof(&config[3]);
-        savePrefs();
-        strcpy(reply, "OK");
-      } else if (memcmp(config, "int.thresh ", 11) == 0) {
-        _prefs->interference_threshold = atoi(&config[11]);
-        savePrefs();
-        strcpy(reply, "OK");
-      } else if (memcmp(config, "agc.reset.interval ", 19) == 0) {
-        _prefs->agc_reset_interval = atoi(&config[19]) / 4;
-        savePrefs();
-        sprintf(reply, "OK - interval rounded to %d", ((uint32_t) _prefs->agc_reset_interval) * 4);
-      } else if (memcmp(config, "multi.acks ", 11) == 0) {
-        _prefs->multi_acks = atoi(&config[11]);
-        savePrefs();
-        strcpy(reply, "OK");
-      } else if (memcmp(config, "allow.read.only ", 16) == 0) {
-        _prefs->allow_read_only = memcmp(&config[16], "on", 2) == 0;
-        savePrefs();
-        strcpy(reply, "OK");
-      } else if (memcmp(config, "flood.advert.interval ", 22) == 0) {
-        int hours = _atoi(&config[22]);
-        if ((hours > 0 && hours < 3) || (hours > 48)) {
-          strcpy(reply, "Error: interval range is 3-48 hours");
-        } else {
-          _prefs->flood_advert_interval = (uint8_t)(hours);
-          _callbacks->updateFloodAdvertTimer();
-          savePrefs();
-          strcpy(reply, "OK");
-        }
-      } else if (memcmp(config, "advert.interval ", 16) == 0) {
-        int mins = _atoi(&config[16]);
-        if ((mins > 0 && mins < MIN_LOCAL_ADVERT_INTERVAL) || (mins > 240)) {
-          sprintf(reply, "Error: interval range is %d-240 minutes", MIN_LOCAL_ADVERT_INTERVAL);
-        } else {
-          _prefs->advert_interval = (uint8_t)(mins / 2);
-          _callbacks->updateAdvertTimer();
-          savePrefs();
-          strcpy(reply, "OK");
-        }
-      } else if (memcmp(config, "guest.password ", 15) == 0) {
-        StrHelper::strncpy(_prefs->guest_password, &config[15], sizeof(_prefs->guest_password));
-        savePrefs();
-        strcpy(reply, "OK");
-      } else if (sender_timestamp == 0 &&
-                 memcmp(config, "prv.key ", 8) == 0) { // from serial command line only
-        uint8_t prv_key[PRV_KEY_SIZE];
-        bool success = mesh::Utils::fromHex(prv_key, PRV_KEY_SIZE, &config[8]);
-        if (success) {
-          mesh::LocalIdentity new_id;
-          new_id.readFrom(prv_key, PRV_KEY_SIZE);
-          _callbacks->saveIdentity(new_id);
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Error, invalid key");
-        }
-      } else if (memcmp(config, "name ", 5) == 0) {
-        StrHelper::strncpy(_prefs->node_name, &config[5], sizeof(_prefs->node_name));
-        savePrefs();
-        strcpy(reply, "OK");
-      } else if (memcmp(config, "repeat ", 7) == 0) {
-        _prefs->disable_fwd = memcmp(&config[7], "off", 3) == 0;
-        savePrefs();
-        strcpy(reply, _prefs->disable_fwd ? "OK - repeat is now OFF" : "OK - repeat is now ON");
-      } else if (memcmp(config, "radio ", 6) == 0) {
-        strcpy(tmp, &config[6]);
-        const char *parts[4];
-        int num = mesh::Utils::parseTextParts(tmp, parts, 4);
-        float freq  = num > 0 ? strtof(parts[0], nullptr) : 0.0f;
-        float bw    = num > 1 ? strtof(parts[1], nullptr) : 0.0f;
-        uint8_t sf  = num > 2 ? atoi(parts[2]) : 0;
-        uint8_t cr  = num > 3 ? atoi(parts[3]) : 0;
-        if (freq >= 300.0f && freq <= 2500.0f && sf >= 5 && sf <= 12 && cr >= 5 && cr <= 8 && bw >= 7.0f && bw <= 500.0f) {
-          _prefs->sf = sf;
-          _prefs->cr = cr;
-          _prefs->freq = freq;
-          _prefs->bw = bw;
-          _callbacks->savePrefs();
-          strcpy(reply, "OK - reboot to apply");
-        } else {
-          strcpy(reply, "Error, invalid radio params");
-        }
-      } else if (memcmp(config, "lat ", 4) == 0) {
-        _prefs->node_lat = atof(&config[4]);
-        savePrefs();
-        strcpy(reply, "OK");
-      } else if (memcmp(config, "lon ", 4) == 0) {
-        _prefs->node_lon = atof(&config[4]);
-        savePrefs();
-        strcpy(reply, "OK");
-      } else if (memcmp(config, "rxdelay ", 8) == 0) {
-        float db = atof(&config[8]);
-        if (db >= 0) {
-          _prefs->rx_delay_base = db;
-          savePrefs();
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Error, cannot be negative");
-        }
-      } else if (memcmp(config, "txdelay ", 8) == 0) {
-        float f = atof(&config[8]);
-        if (f >= 0) {
-          _prefs->tx_delay_factor = f;
-          savePrefs();
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Error, cannot be negative");
-        }
-      } else if (memcmp(config, "flood.max ", 10) == 0) {
-        uint8_t m = atoi(&config[10]);
-        if (m <= 64) {
-          _prefs->flood_max = m;
-          savePrefs();
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Error, max 64");
-        }
-      } else if (memcmp(config, "direct.txdelay ", 15) == 0) {
-        float f = atof(&config[15]);
-        if (f >= 0) {
-          _prefs->direct_tx_delay_factor = f;
-          savePrefs();
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Error, cannot be negative");
-        }
-      } else if (memcmp(config, "tx ", 3) == 0) {
-        _prefs->tx_power_dbm = atoi(&config[3]);
-        savePrefs();
-        _callbacks->setTxPower(_prefs->tx_power_dbm);
-        strcpy(reply, "OK");
-      } else if (sender_timestamp == 0 && memcmp(config, "freq ", 5) == 0) {
-        _prefs->freq = atof(&config[5]);
-        savePrefs();
-        strcpy(reply, "OK - reboot to apply");
+    }
+  } else if (memcmp(config, "adc.multiplier", 14) == 0) {
+    float adc_mult = _board->getAdcMultiplier();
+    if (adc_mult == 0.0f) {
+      strcpy(reply, "Error: unsupported by this board");
+    } else {
+      sprintf(reply, "> %.3f", adc_mult);
+    }
+  } else {
+    sprintf(reply, "??: %s", config);
+  }
+}
+
+void CommonCLI::handleSetCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  const char* config = &command[4];
+  if (memcmp(config, "af ", 3) == 0) {
+    _prefs->airtime_factor = atof(&config[3]);
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "int.thresh ", 11) == 0) {
+    _prefs->interference_threshold = atoi(&config[11]);
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "agc.reset.interval ", 19) == 0) {
+    _prefs->agc_reset_interval = atoi(&config[19]) / 4;
+    savePrefs();
+    sprintf(reply, "OK - interval rounded to %d", ((uint32_t) _prefs->agc_reset_interval) * 4);
+  } else if (memcmp(config, "multi.acks ", 11) == 0) {
+    _prefs->multi_acks = atoi(&config[11]);
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "allow.read.only ", 16) == 0) {
+    _prefs->allow_read_only = memcmp(&config[16], "on", 2) == 0;
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "room.broadcast ", 15) == 0) {
+    _prefs->room_broadcast = memcmp(&config[15], "on", 2) == 0;
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "qos.aging ", 10) == 0) {
+    uint32_t millis = _atoi(&config[10]);
+    if (millis > 60000) {
+      strcpy(reply, "Error: aging range is 0-60000 millis");
+    } else {
+      _prefs->qos_aging = millis;
+      savePrefs();
+      strcpy(reply, "OK");
+    }
+  } else if (memcmp(config, "net.coding ", 11) == 0) {
+    _prefs->net_coding = memcmp(&config[11], "on", 2) == 0;
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "flood.advert.interval ", 22) == 0) {
+    int hours = _atoi(&config[22]);
+    if ((hours > 0 && hours < 3) || (hours > 48)) {
+      strcpy(reply, "Error: interval range is 3-48 hours");
+    } else {
+      _prefs->flood_advert_interval = (uint8_t)(hours);
+      _callbacks->updateFloodAdvertTimer();
+      savePrefs();
+      strcpy(reply, "OK");
+    }
+  } else if (memcmp(config, "advert.interval ", 16) == 0) {
+    int mins = _atoi(&config[16]);
+    if ((mins > 0 && mins < MIN_LOCAL_ADVERT_INTERVAL) || (mins > 240)) {
+      sprintf(reply, "Error: interval range is %d-240 minutes", MIN_LOCAL_ADVERT_INTERVAL);
+    } else {
+      _prefs->advert_interval = (uint8_t)(mins / 2);
+      _callbacks->updateAdvertTimer();
+      savePrefs();
+      strcpy(reply, "OK");
+    }
+  } else if (memcmp(config, "guest.password ", 15) == 0) {
+    StrHelper::strncpy(_prefs->guest_password, &config[15], sizeof(_prefs->guest_password));
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (sender_timestamp == 0 &&
+             memcmp(config, "prv.key ", 8) == 0) { // from serial command line only
+    uint8_t prv_key[PRV_KEY_SIZE];
+    bool success = mesh::Utils::fromHex(prv_key, PRV_KEY_SIZE, &config[8]);
+    if (success) {
+      mesh::LocalIdentity new_id;
+      new_id.readFrom(prv_key, PRV_KEY_SIZE);
+      _callbacks->saveIdentity(new_id);
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Error, invalid key");
+    }
+  } else if (memcmp(config, "name ", 5) == 0) {
+    StrHelper::strncpy(_prefs->node_name, &config[5], sizeof(_prefs->node_name));
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "repeat ", 7) == 0) {
+    _prefs->disable_fwd = memcmp(&config[7], "off", 3) == 0;
+    savePrefs();
+    strcpy(reply, _prefs->disable_fwd ? "OK - repeat is now OFF" : "OK - repeat is now ON");
+  } else if (memcmp(config, "radio ", 6) == 0) {
+    strcpy(tmp, &config[6]);
+    const char *parts[4];
+    int num = mesh::Utils::parseTextParts(tmp, parts, 4);
+    float freq  = num > 0 ? strtof(parts[0], nullptr) : 0.0f;
+    float bw    = num > 1 ? strtof(parts[1], nullptr) : 0.0f;
+    uint8_t sf  = num > 2 ? atoi(parts[2]) : 0;
+    uint8_t cr  = num > 3 ? atoi(parts[3]) : 0;
+    if (freq >= 300.0f && freq <= 2500.0f && sf >= 5 && sf <= 12 && cr >= 5 && cr <= 8 && bw >= 7.0f && bw <= 500.0f) {
+      _prefs->sf = sf;
+      _prefs->cr = cr;
+      _prefs->freq = freq;
+      _prefs->bw = bw;
+      _callbacks->savePrefs();
+      strcpy(reply, "OK - reboot to apply");
+    } else {
+      strcpy(reply, "Error, invalid radio params");
+    }
+  } else if (memcmp(config, "lat ", 4) == 0) {
+    _prefs->node_lat = atof(&config[4]);
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "lon ", 4) == 0) {
+    _prefs->node_lon = atof(&config[4]);
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "rxdelay ", 8) == 0) {
+    float db = atof(&config[8]);
+    if (db >= 0) {
+      _prefs->rx_delay_base = db;
+      savePrefs();
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Error, cannot be negative");
+    }
+  } else if (memcmp(config, "txdelay ", 8) == 0) {
+    float f = atof(&config[8]);
+    if (f >= 0) {
+      _prefs->tx_delay_factor = f;
+      savePrefs();
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Error, cannot be negative");
+    }
+  } else if (memcmp(config, "flood.max ", 10) == 0) {
+    uint8_t m = atoi(&config[10]);
+    if (m <= 64) {
+      _prefs->flood_max = m;
+      savePrefs();
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Error, max 64");
+    }
+  } else if (memcmp(config, "direct.txdelay ", 15) == 0) {
+    float f = atof(&config[15]);
+    if (f >= 0) {
+      _prefs->direct_tx_delay_factor = f;
+      savePrefs();
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Error, cannot be negative");
+    }
+  } else if (memcmp(config, "tx ", 3) == 0) {
+    _prefs->tx_power_dbm = atoi(&config[3]);
+    savePrefs();
+    _callbacks->setTxPower(_prefs->tx_power_dbm);
+    strcpy(reply, "OK");
+  } else if (sender_timestamp == 0 && memcmp(config, "freq ", 5) == 0) {
+    _prefs->freq = atof(&config[5]);
+    savePrefs();
+    strcpy(reply, "OK - reboot to apply");
 #ifdef WITH_BRIDGE
-      } else if (memcmp(config, "bridge.enabled ", 15) == 0) {
-        _prefs->bridge_enabled = memcmp(&config[15], "on", 2) == 0;
-        _callbacks->setBridgeState(_prefs->bridge_enabled);
-        savePrefs();
-        strcpy(reply, "OK");
-      } else if (memcmp(config, "bridge.delay ", 13) == 0) {
-        int delay = _atoi(&config[13]);
-        if (delay >= 0 && delay <= 10000) {
-          _prefs->bridge_delay = (uint16_t)delay;
-          savePrefs();
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Error: delay must be between 0-10000 ms");
-        }
-      } else if (memcmp(config, "bridge.source ", 14) == 0) {
-        _prefs->bridge_pkt_src = memcmp(&config[14], "rx", 2) == 0;
-        savePrefs();
-        strcpy(reply, "OK");
+  } else if (memcmp(config, "bridge.enabled ", 15) == 0) {
+    _prefs->bridge_enabled = memcmp(&config[15], "on", 2) == 0;
+    _callbacks->setBridgeState(_prefs->bridge_enabled);
+    savePrefs();
+    strcpy(reply, "OK");
+  } else if (memcmp(config, "bridge.delay ", 13) == 0) {
+    int delay = strcmp(&config[13], "auto") == 0 ? BRIDGE_DELAY_AUTO : _atoi(&config[13]);
+    if (delay == BRIDGE_DELAY_AUTO || (delay >= 0 && delay <= 10000)) {
+      _prefs->bridge_delay = (uint16_t)delay;
+      savePrefs();
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Error: delay must be between 0-10000 ms, or auto");
+    }
+  } else if (memcmp(config, "bridge.source ", 14) == 0) {
+    _prefs->bridge_pkt_src = memcmp(&config[14], "rx", 2) == 0;
+    savePrefs();
+    strcpy(reply, "OK");
 #endif
 #ifdef WITH_RS232_BRIDGE
-      } else if (memcmp(config, "bridge.baud ", 12) == 0) {
-        uint32_t baud = atoi(&config[12]);
-        if (baud >= 9600 && baud <= 115200) {
-          _prefs->bridge_baud = (uint32_t)baud;
-          _callbacks->restartBridge();
-          savePrefs();
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Error: baud rate must be between 9600-115200");
-        }
+  } else if (memcmp(config, "bridge.baud ", 12) == 0) {
+    uint32_t baud = atoi(&config[12]);
+    if (baud >= 9600 && baud <= 921600) {
+      _prefs->bridge_baud = (uint32_t)baud;
+      _callbacks->restartBridge();
+      savePrefs();
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Error: baud rate must be between 9600-921600");
+    }
 #endif
 #ifdef WITH_ESPNOW_BRIDGE
-      } else if (memcmp(config, "bridge.channel ", 15) == 0) {
-        int ch = atoi(&config[15]);
-        if (ch > 0 && ch < 15) {
-          _prefs->bridge_channel = (uint8_t)ch;
-          _callbacks->restartBridge();
-          savePrefs();
-          strcpy(reply, "OK");
-        } else {
-          strcpy(reply, "Error: channel must be between 1-14");
-        }
-      } else if (memcmp(config, "bridge.secret ", 14) == 0) {
-        StrHelper::strncpy(_prefs->bridge_secret, &config[14], sizeof(_prefs->bridge_secret));
-        _callbacks->restartBridge();
-        savePrefs();
-        strcpy(reply, "OK");
+  } else if (memcmp(config, "bridge.channel ", 15) == 0) {
+    int ch = atoi(&config[15]);
+    if (ch > 0 && ch < 15) {
+      _prefs->bridge_channel = (uint8_t)ch;
+      _callbacks->restartBridge();
+      savePrefs();
+      strcpy(reply, "OK");
+    } else {
+      strcpy(reply, "Error: channel must be between 1-14");
+    }
 #endif
-      } else if (memcmp(config, "adc.multiplier ", 15) == 0) {
-        _prefs->adc_multiplier = atof(&config[15]);
-        if (_board->setAdcMultiplier(_prefs->adc_multiplier)) {
-          savePrefs();
-          if (_prefs->adc_multiplier == 0.0f) {
-            strcpy(reply, "OK - using default board multiplier");
-          } else {
-            sprintf(reply, "OK - multiplier set to %.3f", _prefs->adc_multiplier);
-          }
-        } else {
-          _prefs->adc_multiplier = 0.0f;
-          strcpy(reply, "Error: unsupported by this board");
-        };
-      } else {
-        sprintf(reply, "unknown config: %s", config);
+#if defined(WITH_ESPNOW_BRIDGE) || defined(WITH_UDP_BRIDGE)
+  } else if (memcmp(config, "bridge.secret ", 14) == 0) {
+    StrHelper::strncpy(_prefs->bridge_secret, &config[14], sizeof(_prefs->bridge_secret));
+    _callbacks->restartBridge();
+    savePrefs();
+    strcpy(reply, "OK");
+#endif
+  } else if (memcmp(config, "backbone ", 9) == 0) {
+    if (strcmp(&config[9], "off") == 0) {
+      _prefs->num_backbone_peers = 0;
+      savePrefs();
+      strcpy(reply, "OK");
+    } else {
+      StrHelper::strncpy(tmp, &config[9], sizeof(tmp));
+      const char* parts[MAX_BACKBONE_PEERS + 1];
+      int num = mesh::Utils::parseTextParts(tmp, parts, MAX_BACKBONE_PEERS + 1, ',');
+      uint8_t peers[MAX_BACKBONE_PEERS];
+      bool valid = num > 0 && num <= MAX_BACKBONE_PEERS;
+      for (int i = 0; i < num && valid; i++) {
+        valid = strlen(parts[i]) == 2 && mesh::Utils::fromHex(&peers[i], 1, parts[i]);
       }
-    } else if (sender_timestamp == 0 && strcmp(command, "erase") == 0) {
-      bool s = _callbacks->formatFileSystem();
-      sprintf(reply, "File system erase: %s", s ? "OK" : "Err");
-    } else if (memcmp(command, "ver", 3) == 0) {
-      sprintf(reply, "%s (Build: %s)", _callbacks->getFirmwareVer(), _callbacks->getBuildDate());
-    } else if (memcmp(command, "board", 5) == 0) {
-      sprintf(reply, "%s", _board->getManufacturerName());
-    } else if (memcmp(command, "sensor get ", 11) == 0) {
-      const char* key = command + 11;
-      const char* val = _sensors->getSettingByKey(key);
-      if (val != NULL) {
-        sprintf(reply, "> %s", val);
+      if (valid) {
+        memcpy(_prefs->backbone_peers, peers, num);
+        _prefs->num_backbone_peers = num;
+        savePrefs();
+        strcpy(reply, "OK");
       } else {
-        strcpy(reply, "null");
+        sprintf(reply, "Error, expected up to %d hex hashes, eg. 3A,7F", MAX_BACKBONE_PEERS);
       }
-    } else if (memcmp(command, "sensor set ", 11) == 0) {
-      strcpy(tmp, &command[11]);
-      const char *parts[2]; 
-      int num = mesh::Utils::parseTextParts(tmp, parts, 2, ' ');
-      const char *key = (num > 0) ? parts[0] : "";
-      const char *value = (num > 1) ? parts[1] : "null";
-      if (_sensors->setSettingValue(key, value)) {
-        strcpy(reply, "ok");
+    }
+  } else if (memcmp(config, "adc.multiplier ", 15) == 0) {
+    _prefs->adc_multiplier = atof(&config[15]);
+    if (_board->setAdcMultiplier(_prefs->adc_multiplier)) {
+      savePrefs();
+      if (_prefs->adc_multiplier == 0.0f) {
+        strcpy(reply, "OK - using default board multiplier");
       } else {
-        strcpy(reply, "can't find custom var");
-      }
-    } else if (memcmp(command, "sensor list", 11) == 0) {
-      char* dp = reply;
-      int start = 0;
-      int end = _sensors->getNumSettings();
-      if (strlen(command) > 11) {
-        start = _atoi(command+12);
+        sprintf(reply, "OK - multiplier set to %.3f", _prefs->adc_multiplier);
       }
-      if (start >= end) {
-        strcpy(reply, "no custom var");
-      } else {
-        sprintf(dp, "%d vars\n", end);
+    } else {
+      _prefs->adc_multiplier = 0.0f;
+      strcpy(reply, "Error: unsupported by this board");
+    };
+  } else {
+    sprintf(reply, "unknown config: %s", config);
+  }
+}
+
+void CommonCLI::handleEraseCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  flash_writer.flush();
+  bool s = _callbacks->formatFileSystem();
+  sprintf(reply, "File system erase: %s", s ? "OK" : "Err");
+}
+
+void CommonCLI::handleVerCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  sprintf(reply, "%s (Build: %s)", _callbacks->getFirmwareVer(), _callbacks->getBuildDate());
+}
+
+void CommonCLI::handleBoardCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  sprintf(reply, "%s", _board->getManufacturerName());
+}
+
+void CommonCLI::handleSensorCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  if (memcmp(command, "sensor get ", 11) == 0) {
+    const char* key = command + 11;
+    const char* val = _sensors->getSettingByKey(key);
+    if (val != NULL) {
+      sprintf(reply, "> %s", val);
+    } else {
+      strcpy(reply, "null");
+    }
+  } else if (memcmp(command, "sensor set ", 11) == 0) {
+    strcpy(tmp, &command[11]);
+    const char *parts[2]; 
+    int num = mesh::Utils::parseTextParts(tmp, parts, 2, ' ');
+    const char *key = (num > 0) ? parts[0] : "";
+    const char *value = (num > 1) ? parts[1] : "null";
+    if (_sensors->setSettingValue(key, value)) {
+      strcpy(reply, "ok");
+    } else {
+      strcpy(reply, "can't find custom var");
+    }
+  } else if (memcmp(command, "sensor list", 11) == 0) {
+    char* dp = reply;
+    int start = 0;
+    int end = _sensors->getNumSettings();
+    if (strlen(command) > 11) {
+      start = _atoi(command+12);
+    }
+    if (start >= end) {
+      strcpy(reply, "no custom var");
+    } else {
+      sprintf(dp, "%d vars\n", end);
+      dp = strchr(dp, 0);
+      int i;
+      for (i = start; i < end && (dp-reply < 134); i++) {
+        sprintf(dp, "%s=%s\n", 
+          _sensors->getSettingName(i),
+          _sensors->getSettingValue(i));
         dp = strchr(dp, 0);
-        int i;
-        for (i = start; i < end && (dp-reply < 134); i++) {
-          sprintf(dp, "%s=%s\n", 
-            _sensors->getSettingName(i),
-            _sensors->getSettingValue(i));
-          dp = strchr(dp, 0);
-        }
-        if (i < end) {
-          sprintf(dp, "... next:%d", i);
-        } else {
-          *(dp-1) = 0; // remove last CR
-        }
-      }
-#if ENV_INCLUDE_GPS == 1
-    } else if (memcmp(command, "gps on", 6) == 0) {
-      if (_sensors->setSettingValue("gps", "1")) {
-        _prefs->gps_enabled = 1;
-        savePrefs();
-        strcpy(reply, "ok");
-      } else {
-        strcpy(reply, "gps toggle not found");
       }
-    } else if (memcmp(command, "gps off", 7) == 0) {
-      if (_sensors->setSettingValue("gps", "0")) {
-        _prefs->gps_enabled = 0;
-        savePrefs();
-        strcpy(reply, "ok");
+      if (i < end) {
+        sprintf(dp, "... next:%d", i);
       } else {
-        strcpy(reply, "gps toggle not found");
+        *(dp-1) = 0; // remove last CR
       }
-    } else if (memcmp(command, "gps sync", 8) == 0) {
-      LocationProvider * l = _sensors->getLocationProvider();
-      if (l != NULL) {
-        l->syncTime();
+    }
+  } else {
+    strcpy(reply, "Unknown command");
+  }
+}
+
+#if ENV_INCLUDE_GPS == 1
+void CommonCLI::handleGpsCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  if (memcmp(command, "gps on", 6) == 0) {
+    if (_sensors->setSettingValue("gps", "1")) {
+      _prefs->gps_enabled = 1;
+      savePrefs();
+      strcpy(reply, "ok");
+    } else {
+      strcpy(reply, "gps toggle not found");
+    }
+  } else if (memcmp(command, "gps off", 7) == 0) {
+    if (_sensors->setSettingValue("gps", "0")) {
+      _prefs->gps_enabled = 0;
+      savePrefs();
+      strcpy(reply, "ok");
+    } else {
+      strcpy(reply, "gps toggle not found");
+    }
+  } else if (memcmp(command, "gps sync", 8) == 0) {
+    LocationProvider * l = _sensors->getLocationProvider();
+    if (l != NULL) {
+      l->syncTime();
+    }
+  } else if (memcmp(command, "gps setloc", 10) == 0) {
+    _prefs->node_lat = _sensors->node_lat;
+    _prefs->node_lon = _sensors->node_lon;
+    savePrefs();
+    strcpy(reply, "ok");
+  } else if (memcmp(command, "gps advert", 10) == 0) {
+    if (strlen(command) == 10) {
+      switch (_prefs->advert_loc_policy) {
+        case ADVERT_LOC_NONE:
+          strcpy(reply, "> none");
+          break;
+        case ADVERT_LOC_PREFS:
+          strcpy(reply, "> prefs");
+          break;
+        case ADVERT_LOC_SHARE:
+          strcpy(reply, "> share");
+          break;
+        default:
+          strcpy(reply, "error");
       }
-    } else if (memcmp(command, "gps setloc", 10) == 0) {
-      _prefs->node_lat = _sensors->node_lat;
-      _prefs->node_lon = _sensors->node_lon;
+    } else if (memcmp(command+11, "none", 4) == 0) {
+      _prefs->advert_loc_policy = ADVERT_LOC_NONE;
       savePrefs();
       strcpy(reply, "ok");
-    } else if (memcmp(command, "gps advert", 10) == 0) {
-      if (strlen(command) == 10) {
-        switch (_prefs->advert_loc_policy) {
-          case ADVERT_LOC_NONE:
-            strcpy(reply, "> none");
-            break;
-          case ADVERT_LOC_PREFS:
-            strcpy(reply, "> prefs");
-            break;
-          case ADVERT_LOC_SHARE:
-            strcpy(reply, "> share");
-            break;
-          default:
-            strcpy(reply, "error");
-        }
-      } else if (memcmp(command+11, "none", 4) == 0) {
-        _prefs->advert_loc_policy = ADVERT_LOC_NONE;
-        savePrefs();
-        strcpy(reply, "ok");
-      } else if (memcmp(command+11, "share", 5) == 0) {
-        _prefs->advert_loc_policy = ADVERT_LOC_SHARE;
-        savePrefs();
-        strcpy(reply, "ok");
-      } else if (memcmp(command+11, "prefs", 4) == 0) {
-        _prefs->advert_loc_policy = ADVERT_LOC_PREFS;
-        savePrefs();
-        strcpy(reply, "ok");
+    } else if (memcmp(command+11, "share", 5) == 0) {
+      _prefs->advert_loc_policy = ADVERT_LOC_SHARE;
+      savePrefs();
+      strcpy(reply, "ok");
+    } else if (memcmp(command+11, "prefs", 4) == 0) {
+      _prefs->advert_loc_policy = ADVERT_LOC_PREFS;
+      savePrefs();
+      strcpy(reply, "ok");
+    } else {
+      strcpy(reply, "error");
+    }
+  } else {
+    LocationProvider * l = _sensors->getLocationProvider();
+    if (l != NULL) {
+      bool enabled = l->isEnabled(); // is EN pin on ?
+      bool fix = l->isValid();       // has fix ?
+      int sats = l->satellitesCount();
+      bool active = !strcmp(_sensors->getSettingByKey("gps"), "1");
+      if (enabled) {
+        sprintf(reply, "on, %s, %s, %d sats",
+          active?"active":"deactivated", 
+          fix?"fix":"no fix", 
+          sats);
       } else {
-        strcpy(reply, "error");
+        strcpy(reply, "off");
       }
-    } else if (memcmp(command, "gps", 3) == 0) {
-      LocationProvider * l = _sensors->getLocationProvider();
-      if (l != NULL) {
-        bool enabled = l->isEnabled(); // is EN pin on ?
-        bool fix = l->isValid();       // has fix ?
-        int sats = l->satellitesCount();
-        bool active = !strcmp(_sensors->getSettingByKey("gps"), "1");
-        if (enabled) {
-          sprintf(reply, "on, %s, %s, %d sats",
-            active?"active":"deactivated", 
-            fix?"fix":"no fix", 
-            sats);
-        } else {
-          strcpy(reply, "off");
-        }
+    } else {
+      strcpy(reply, "Can't find GPS");
+    }
+  }
+}
+#endif
+
+void CommonCLI::handleLogCmd(uint32_t sender_timestamp, char* command, char* reply) {
+  if (memcmp(command, "log start", 9) == 0) {
+    _callbacks->setLoggingOn(true);
+    strcpy(reply, "   logging on");
+  } else if (memcmp(command, "log stop", 8) == 0) {
+    _callbacks->setLoggingOn(false);
+    strcpy(reply, "   logging off");
+  } else if (memcmp(command, "log erase", 9) == 0) {
+    _callbacks->eraseLogFile();
+    strcpy(reply, "   log erased");
+  } else if (sender_timestamp == 0 && memcmp(command, "log", 3) == 0) {
+    _callbacks->dumpLogFile();
+    strcpy(reply, "   EOF");
+  } else {
+    strcpy(reply, "Unknown command");
+  }
+}
+
+void CommonCLI::handleStatsCmd(uint32_t sender_timestamp, char* command, char* reply) {   // serial only
+  if (memcmp(command, "stats-packets", 13) == 0) {
+    _callbacks->formatPacketStatsReply(reply);
+  } else if (memcmp(command, "stats-dedup", 11) == 0) {
+    _callbacks->formatDedupStatsReply(reply);
+  } else if (memcmp(command, "stats-radio", 11) == 0) {
+    _callbacks->formatRadioStatsReply(reply);
+  } else if (memcmp(command, "stats-memory", 12) == 0) {
+    _callbacks->formatMemoryStatsReply(reply);
+  } else if (memcmp(command, "stats-loop", 10) == 0) {
+    StatsFormatHelper::formatLoopStats(reply, mesh::LoopMonitor::get());
+  } else if (memcmp(command, "stats-profile", 13) == 0) {   // optional param: payload type
+    _callbacks->formatProfileStatsReply(reply, command[13] == ' ' ? atoi(&command[14]) & 0x0F : 0xFF);
+  } else {
+    _callbacks->formatStatsReply(reply);
+  }
+}
+
+/*
+ * Binary get/set of prefs (see handlePrefsRequest())
+ */
+#define PREF_U8      1
+#define PREF_U16     2
+#define PREF_U32     3
+#define PREF_F32     4
+#define PREF_F64     5
+#define PREF_STR     6
+
+#define PREF_ZERO_OK         0x01   // zero is allowed, as well as the range (ie. 'off')
+#define PREF_AUTO_OK         0x02   // BRIDGE_DELAY_AUTO is allowed, as well as the range
+#define PREF_TX_POWER        0x04   // effects, once applied
+#define PREF_ADVERT_TIMER    0x08
+#define PREF_FLOOD_TIMER     0x10
+#define PREF_BRIDGE_STATE    0x20
+#define PREF_BRIDGE_RESTART  0x40
+#define PREF_REBOOT          0x80
+
+struct PrefDef {
+  uint8_t key;
+  uint8_t type;
+  uint8_t flags;
+  uint8_t size;
+  uint16_t offset;   // in NodePrefs
+  float min, max;    // valid range, or for PREF_STR, min length
+};
+
+#define PREF(key, type, field, min, max, flags)  { key, type, flags, sizeof(NodePrefs::field), offsetof(NodePrefs, field), min, max }
+
+static const PrefDef pref_defs[] = {
+  PREF(PREF_KEY_AIRTIME_FACTOR,  PREF_F32, airtime_factor, 0, 9, 0),
+  PREF(PREF_KEY_NODE_NAME,       PREF_STR, node_name, 1, 0, 0),
+  PREF(PREF_KEY_NODE_LAT,        PREF_F64, node_lat, -90, 90, 0),
+  PREF(PREF_KEY_NODE_LON,        PREF_F64, node_lon, -180, 180, 0),
+  PREF(PREF_KEY_FREQ,            PREF_F32, freq, 300, 2500, PREF_REBOOT),
+  PREF(PREF_KEY_BW,              PREF_F32, bw, 7, 500, PREF_REBOOT),
+  PREF(PREF_KEY_SF,              PREF_U8,  sf, 5, 12, PREF_REBOOT),
+  PREF(PREF_KEY_CR,              PREF_U8,  cr, 5, 8, PREF_REBOOT),
+  PREF(PREF_KEY_TX_POWER,        PREF_U8,  tx_power_dbm, 1, 30, PREF_TX_POWER),
+  PREF(PREF_KEY_DISABLE_FWD,     PREF_U8,  disable_fwd, 0, 1, 0),
+  PREF(PREF_KEY_ADVERT_INTERVAL, PREF_U8,  advert_interval, MIN_LOCAL_ADVERT_INTERVAL / 2, 120, PREF_ZERO_OK | PREF_ADVERT_TIMER),
+  PREF(PREF_KEY_FLOOD_ADVERT_INTERVAL, PREF_U8, flood_advert_interval, 3, 48, PREF_ZERO_OK | PREF_FLOOD_TIMER),
+  PREF(PREF_KEY_RX_DELAY,        PREF_F32, rx_delay_base, 0, 20, 0),
+  PREF(PREF_KEY_TX_DELAY,        PREF_F32, tx_delay_factor, 0, 2, 0),
+  PREF(PREF_KEY_DIRECT_TX_DELAY, PREF_F32, direct_tx_delay_factor, 0, 2, 0),
+  PREF(PREF_KEY_GUEST_PASSWORD,  PREF_STR, guest_password, 0, 0, 0),
+  PREF(PREF_KEY_ALLOW_READ_ONLY, PREF_U8,  allow_read_only, 0, 1, 0),
+  PREF(PREF_KEY_MULTI_ACKS,      PREF_U8,  multi_acks, 0, 1, 0),
+  PREF(PREF_KEY_FLOOD_MAX,       PREF_U8,  flood_max, 0, 64, 0),
+  PREF(PREF_KEY_INT_THRESH,      PREF_U8,  interference_threshold, 0, 255, 0),
+  PREF(PREF_KEY_AGC_RESET_INTERVAL, PREF_U8, agc_reset_interval, 0, 255, 0),
+  PREF(PREF_KEY_ROOM_BROADCAST,  PREF_U8,  room_broadcast, 0, 1, 0),
+  PREF(PREF_KEY_ADVERT_LOC_POLICY, PREF_U8, advert_loc_policy, 0, 2, 0),
+  PREF(PREF_KEY_QOS_AGING,       PREF_U16, qos_aging, 0, 60000, 0),
+  PREF(PREF_KEY_NET_CODING,      PREF_U8,  net_coding, 0, 1, 0),
+#ifdef WITH_BRIDGE
+  PREF(PREF_KEY_BRIDGE_ENABLED,  PREF_U8,  bridge_enabled, 0, 1, PREF_BRIDGE_STATE),
+  PREF(PREF_KEY_BRIDGE_DELAY,    PREF_U16, bridge_delay, 0, 10000, PREF_AUTO_OK),
+  PREF(PREF_KEY_BRIDGE_SOURCE,   PREF_U8,  bridge_pkt_src, 0, 1, 0),
+#endif
+#ifdef WITH_RS232_BRIDGE
+  PREF(PREF_KEY_BRIDGE_BAUD,     PREF_U32, bridge_baud, 9600, 921600, PREF_BRIDGE_RESTART),
+#endif
+#ifdef WITH_ESPNOW_BRIDGE
+  PREF(PREF_KEY_BRIDGE_CHANNEL,  PREF_U8,  bridge_channel, 1, 14, PREF_BRIDGE_RESTART),
+#endif
+#if defined(WITH_ESPNOW_BRIDGE) || defined(WITH_UDP_BRIDGE)
+  PREF(PREF_KEY_BRIDGE_SECRET,   PREF_STR, bridge_secret, 0, 0, PREF_BRIDGE_RESTART),
+#endif
+};
+
+#define NUM_PREF_DEFS   (sizeof(pref_defs) / sizeof(pref_defs[0]))
+
+static const PrefDef* findPrefDef(uint8_t key) {
+  for (int i = 0; i < NUM_PREF_DEFS; i++) {
+    if (pref_defs[i].key == key) return &pref_defs[i];
+  }
+  return NULL;
+}
+
+// validates a value (in its wire form), and stores it in 'prefs'
+static bool putPrefValue(NodePrefs& prefs, const PrefDef* def, const uint8_t* val, int len) {
+  uint8_t* dest = ((uint8_t *) &prefs) + def->offset;
+  if (def->type == PREF_STR) {
+    if (len >= def->size || len < def->min) return false;   // (min is min length)
+    memcpy(dest, val, len);
+    dest[len] = 0;
+    return true;
+  }
+
+  double v;
+  if (len != def->size) return false;
+  switch (def->type) {
+    case PREF_U8:  v = val[0]; break;
+    case PREF_U16: { uint16_t n; memcpy(&n, val, 2); v = n; break; }
+    case PREF_U32: { uint32_t n; memcpy(&n, val, 4); v = n; break; }
+    case PREF_F32: { float f; memcpy(&f, val, 4); v = f; break; }
+    default:       memcpy(&v, val, 8); break;
+  }
+  bool ok = (v >= def->min && v <= def->max)
+         || ((def->flags & PREF_ZERO_OK) && v == 0)
+         || ((def->flags & PREF_AUTO_OK) && v == BRIDGE_DELAY_AUTO);
+  if (ok) memcpy(dest, val, len);
+  return ok;
+}
+
+int CommonCLI::handlePrefsRequest(const uint8_t* req, int req_len, uint8_t* reply, int max_len) {
+  if (req_len < 1 || max_len < 2) return 0;
+
+  reply[0] = PREFS_REQ_OK;
+  reply[1] = 0;   // flags
+  int ofs = 2;
+
+  if (req[0] == PREFS_REQ_OP_GET) {
+    bool all = req_len < 2 || req[1] == 0;   // no keys given, so all of them
+    int n = all ? NUM_PREF_DEFS : req_len - 1;
+    for (int i = 0; i < n; i++) {
+      const PrefDef* def;
+      if (all) {
+        def = &pref_defs[i];
       } else {
-        strcpy(reply, "Can't find GPS");
+        if (req[1 + i] == 0) break;   // end of keys (or the cipher's zero padding)
+        def = findPrefDef(req[1 + i]);
+        if (def == NULL) continue;    // not supported by this firmware, just left out of reply
       }
-#endif
-    } else if (memcmp(command, "log start", 9) == 0) {
-      _callbacks->setLoggingOn(true);
-      strcpy(reply, "   logging on");
-    } else if (memcmp(command, "log stop", 8) == 0) {
-      _callbacks->setLoggingOn(false);
-      strcpy(reply, "   logging off");
-    } else if (memcmp(command, "log erase", 9) == 0) {
-      _callbacks->eraseLogFile();
-      strcpy(reply, "   log erased");
-    } else if (sender_timestamp == 0 && memcmp(command, "log", 3) == 0) {
-      _callbacks->dumpLogFile();
-      strcpy(reply, "   EOF");
-    } else if (sender_timestamp == 0 && memcmp(command, "stats-packets", 13) == 0 && (command[13] == 0 || command[13] == ' ')) {
-      _callbacks->formatPacketStatsReply(reply);
-    } else if (sender_timestamp == 0 && memcmp(command, "stats-radio", 11) == 0 && (command[11] == 0 || command[11] == ' ')) {
-      _callbacks->formatRadioStatsReply(reply);
-    } else if (sender_timestamp == 0 && memcmp(command, "stats-core", 10) == 0 && (command[10] == 0 || command[10] == ' ')) {
-      _callbacks->formatStatsReply(reply);
-    } else {
-      strcpy(reply, "Unknown command");
+      const uint8_t* src = ((const uint8_t *) _prefs) + def->offset;
+      int len = def->type == PREF_STR ? strlen((const char *) src) : def->size;
+      if (ofs + 2 + len > max_len) {
+        reply[1] |= PREFS_REPLY_TRUNCATED;   // requester should ask for the rest
+        break;
+      }
+      reply[ofs++] = def->key;
+      reply[ofs++] = len;
+      memcpy(&reply[ofs], src, len); ofs += len;
+    }
+    return ofs;
+  }
+
+  if (req[0] == PREFS_REQ_OP_SET) {
+    NodePrefs updated = *_prefs;   // all or nothing, so apply to a copy first
+    uint8_t effects = 0;
+    int i = 1;
+    while (i + 2 <= req_len && req[i] != 0) {   // TLVs, up to a zero key (or the cipher's zero padding)
+      uint8_t key = req[i], len = req[i + 1];
+      const PrefDef* def = findPrefDef(key);
+      if (i + 2 + len > req_len || def == NULL || !putPrefValue(updated, def, &req[i + 2], len)) {
+        reply[0] = def == NULL ? PREFS_REQ_ERR_KEY : PREFS_REQ_ERR_VALUE;
+        reply[ofs++] = key;
+        return ofs;
+      }
+      effects |= def->flags;
+      i += 2 + len;
     }
+
+    *_prefs = updated;
+    savePrefs();   // one write, for all of them
+    if (effects & PREF_TX_POWER) _callbacks->setTxPower(_prefs->tx_power_dbm);
+    if (effects & PREF_ADVERT_TIMER) _callbacks->updateAdvertTimer();
+    if (effects & PREF_FLOOD_TIMER) _callbacks->updateFloodAdvertTimer();
+    if (effects & PREF_BRIDGE_STATE) _callbacks->setBridgeState(_prefs->bridge_enabled);
+    if (effects & PREF_BRIDGE_RESTART) _callbacks->restartBridge();   // (no op if not running)
+    if (effects & PREF_REBOOT) reply[1] |= PREFS_REPLY_NEEDS_REBOOT;
+    return ofs;
+  }
+
+  reply[0] = PREFS_REQ_ERR_FORMAT;
+  return ofs;
 }
@@ -3,8 +3,11 @@
 #include "Mesh.h"
 #include <helpers/IdentityStore.h>
 #include <helpers/SensorManager.h>
+#include <helpers/PacketCapture.h>
+#include <helpers/PrefsFile.h>
+#include <helpers/CLICommandTable.h>
 
-#if defined(WITH_RS232_BRIDGE) || defined(WITH_ESPNOW_BRIDGE)
+#if defined(WITH_RS232_BRIDGE) || defined(WITH_ESPNOW_BRIDGE) || defined(WITH_UDP_BRIDGE)
 #define WITH_BRIDGE
 #endif
 
@@ -12,6 +15,55 @@
 #define ADVERT_LOC_SHARE      1
 #define ADVERT_LOC_PREFS      2
 
+#define MAX_BACKBONE_PEERS   8
+
+#define BRIDGE_DELAY_AUTO    0xFFFF   // bridge_delay value to have the delay tuned from measured arrival offsets
+
+// ops, for the binary prefs request (see CommonCLI::handlePrefsRequest())
+#define PREFS_REQ_OP_GET        1    // {key}*  (none for all)
+#define PREFS_REQ_OP_SET        2    // {key, len, value}*
+
+#define PREFS_REQ_OK            0
+#define PREFS_REQ_ERR_KEY       1    // unknown key
+#define PREFS_REQ_ERR_VALUE     2    // bad length, or out of range
+#define PREFS_REQ_ERR_FORMAT    3
+
+#define PREFS_REPLY_TRUNCATED     0x01   // not all keys fit in reply
+#define PREFS_REPLY_NEEDS_REBOOT  0x02   // radio params saved, but only applied on reboot
+
+// pref keys (values are little-endian, in the units they are stored in NodePrefs). Never re-number!
+#define PREF_KEY_AIRTIME_FACTOR          1    // float
+#define PREF_KEY_NODE_NAME               2    // string
+#define PREF_KEY_NODE_LAT                3    // double
+#define PREF_KEY_NODE_LON                4    // double
+#define PREF_KEY_FREQ                    5    // float, MHz
+#define PREF_KEY_BW                      6    // float, kHz
+#define PREF_KEY_SF                      7    // uint8
+#define PREF_KEY_CR                      8    // uint8
+#define PREF_KEY_TX_POWER                9    // uint8, dBm
+#define PREF_KEY_DISABLE_FWD            10    // uint8, boolean
+#define PREF_KEY_ADVERT_INTERVAL        11    // uint8, minutes / 2
+#define PREF_KEY_FLOOD_ADVERT_INTERVAL  12    // uint8, hours
+#define PREF_KEY_RX_DELAY               13    // float
+#define PREF_KEY_TX_DELAY               14    // float
+#define PREF_KEY_DIRECT_TX_DELAY        15    // float
+#define PREF_KEY_GUEST_PASSWORD         16    // string
+#define PREF_KEY_ALLOW_READ_ONLY        17    // uint8, boolean
+#define PREF_KEY_MULTI_ACKS             18    // uint8
+#define PREF_KEY_FLOOD_MAX              19    // uint8, hops
+#define PREF_KEY_INT_THRESH             20    // uint8
+#define PREF_KEY_AGC_RESET_INTERVAL     21    // uint8, secs / 4
+#define PREF_KEY_ROOM_BROADCAST         22    // uint8, boolean
+#define PREF_KEY_ADVERT_LOC_POLICY      23    // uint8, ADVERT_LOC_*
+#define PREF_KEY_QOS_AGING              24    // uint16, millis
+#define PREF_KEY_NET_CODING             25    // uint8, boolean
+#define PREF_KEY_BRIDGE_ENABLED         30    // uint8, boolean
+#define PREF_KEY_BRIDGE_DELAY           31    // uint16, millis, or BRIDGE_DELAY_AUTO
+#define PREF_KEY_BRIDGE_SOURCE          32    // uint8, 0 = logTx, 1 = logRx
+#define PREF_KEY_BRIDGE_BAUD            33    // uint32
+#define PREF_KEY_BRIDGE_CHANNEL         34    // uint8
+#define PREF_KEY_BRIDGE_SECRET          35    // string
+
 struct NodePrefs { // persisted to file
   float airtime_factor;
   char node_name[32];
@@ -37,17 +89,23 @@ struct NodePrefs { // persisted to file
   uint8_t agc_reset_interval; // secs / 4
   // Bridge settings
   uint8_t bridge_enabled; // boolean
-  uint16_t bridge_delay;  // milliseconds (default 500 ms)
+  uint16_t bridge_delay;  // milliseconds (default 500 ms), or BRIDGE_DELAY_AUTO
   uint8_t bridge_pkt_src; // 0 = logTx, 1 = logRx (default logTx)
   uint32_t bridge_baud;   // 9600, 19200, 38400, 57600, 115200 (default 115200)
   uint8_t bridge_channel; // 1-14 (ESP-NOW only)
-  char bridge_secret[16]; // for XOR encryption of bridge packets (ESP-NOW only)
+  char bridge_secret[16]; // for XOR encryption of bridge packets (ESP-NOW, UDP)
   // Gps settings
   uint8_t gps_enabled;
   uint32_t gps_interval; // in seconds
   uint8_t advert_loc_policy;
   uint32_t discovery_mod_timestamp;
   float adc_multiplier;
+  uint8_t num_backbone_peers;
+  uint8_t backbone_peers[MAX_BACKBONE_PEERS];  // path hashes of the other fixed backbone repeaters
+  uint8_t room_broadcast;  // boolean, room server sends each post once, under a group key
+  uint8_t room_key_epoch;  // bumped to issue a new room group key
+  uint16_t qos_aging;      // millis per outbound priority step of waiting (zero disables aging)
+  uint8_t net_coding;      // boolean, repeater XORs two-way DIRECT datagrams into one CODED frame
 };
 
 class CommonCLICallbacks {
@@ -71,6 +129,15 @@ public:
   virtual void formatStatsReply(char *reply) = 0;
   virtual void formatRadioStatsReply(char *reply) = 0;
   virtual void formatPacketStatsReply(char *reply) = 0;
+  virtual void formatDedupStatsReply(char *reply) {
+    strcpy(reply, "Unknown command");   // not supported by default
+  }
+  virtual void formatMemoryStatsReply(char *reply) {
+    strcpy(reply, "Unknown command");   // not supported by default
+  }
+  virtual void formatProfileStatsReply(char *reply, uint8_t type) {   // type = PAYLOAD_TYPE_*, or 0xFF for all
+    strcpy(reply, "Unknown command");   // not supported by default
+  }
   virtual mesh::LocalIdentity& getSelfId() = 0;
   virtual void saveIdentity(const mesh::LocalIdentity& new_id) = 0;
   virtual void clearStats() = 0;
@@ -83,6 +150,8 @@ public:
   virtual void restartBridge() {
     // no op by default
   };
+
+  virtual PacketCapture* getPacketCapture() { return NULL; }   // not supported by default
 };
 
 class CommonCLI {
@@ -91,18 +160,61 @@ class CommonCLI {
   CommonCLICallbacks* _callbacks;
   mesh::MainBoard* _board;
   SensorManager* _sensors;
+  PrefsFile _prefs_file;
+  CLICommandTable _commands;
   char tmp[PRV_KEY_SIZE*2 + 4];
 
   mesh::RTCClock* getRTCClock() { return _rtc; }
   void savePrefs();
   void loadPrefsInt(FILESYSTEM* _fs, const char* filename);
+  void unpackPrefs(const uint8_t* blob, int len);
+  void packPrefs(uint8_t* blob);
+  void addCommonCommands();
+  void handleRebootCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleAdvertCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleClockCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleStartCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleTimeCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleNeighborsCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleNeighborRemoveCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleTempRadioCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handlePasswordCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleClearCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleGetCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleSetCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleEraseCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleVerCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleBoardCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleSensorCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleGpsCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleCaptureCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleLogCmd(uint32_t sender_timestamp, char* command, char* reply);
+  void handleStatsCmd(uint32_t sender_timestamp, char* command, char* reply);
 
 public:
   CommonCLI(mesh::MainBoard& board, mesh::RTCClock& rtc, SensorManager& sensors, NodePrefs* prefs, CommonCLICallbacks* callbacks)
-      : _board(&board), _rtc(&rtc), _sensors(&sensors), _prefs(prefs), _callbacks(callbacks) { }
+      : _board(&board), _rtc(&rtc), _sensors(&sensors), _prefs(prefs), _callbacks(callbacks), _prefs_file("/com_prefs") {
+    addCommonCommands();
+  }
 
   void loadPrefs(FILESYSTEM* _fs);
-  void savePrefs(FILESYSTEM* _fs);
-  void handleCommand(uint32_t sender_timestamp, const char* command, char* reply);
-  uint8_t buildAdvertData(uint8_t node_type, uint8_t* app_data);
+  bool savePrefs(FILESYSTEM* _fs);
+
+  /**
+   * \brief  adds an app-specific command (or replaces a common one), keyed by its first word, eg. "region".
+   *    Use CLICommandTable::method<> for the handler, to have it be a member function of the app.
+   * \param  flags  CLI_SERIAL_ONLY, CLI_HAS_PARAMS
+  */
+  bool addCommand(const char* name, CLICommandFn fn, void* ctx, uint8_t flags = 0);
+  void handleCommand(uint32_t sender_timestamp, char* command, char* reply);
+
+  /**
+   * \brief  gets or sets many prefs in one (admin) request, instead of a CLI command per pref. A set is all or
+   *    nothing: if any key or value is bad, none are applied. Otherwise, prefs are saved once, for all of them.
+   * \param  req  {op(1)} then, for GET: {key(1)}*, for SET: {key(1), len(1), value(len)}*. A zero key ends the list.
+   * \param  reply  (OUT) {status(1), flags(1)} then, for GET: {key(1), len(1), value(len)}*, or on error: {key(1)}
+   * \returns  length of reply
+  */
+  int handlePrefsRequest(const uint8_t* req, int req_len, uint8_t* reply, int max_len);
+  uint8_t buildAdvertData(uint8_t node_type, uint8_t* app_data, uint16_t feat1 = 0, uint16_t feat2 = 0);   // see AdvertDataHelpers.h
 };
@@ -0,0 +1,135 @@
+#include "ConcurrentPacketManager.h"
+
+#define POOL_NIL   0xFFFF
+
+LockFreePacketPool::LockFreePacketPool(int pool_size) {
+  _size = pool_size < POOL_NIL ? pool_size : POOL_NIL - 1;
+  _packets = new mesh::Packet[_size];
+  _next = new std::atomic<uint16_t>[_size];
+  for (int i = 0; i < _size; i++) {
+    _next[i].store(i + 1 < _size ? i + 1 : POOL_NIL, std::memory_order_relaxed);
+  }
+  _head.store(_size > 0 ? 0 : POOL_NIL, std::memory_order_relaxed);
+  _num.store(_size, std::memory_order_relaxed);
+}
+
+mesh::Packet* LockFreePacketPool::alloc() {
+  uint32_t h = _head.load(std::memory_order_acquire);
+  for (;;) {
+    uint16_t top = h & 0xFFFF;
+    if (top == POOL_NIL) return NULL;   // empty
+
+    // NOTE: _next[top] may be stale if 'top' was popped meanwhile, but then the tag will have moved on, and the CAS fails
+    uint32_t nh = ((h & 0xFFFF0000) + 0x10000) | _next[top].load(std::memory_order_relaxed);
+    if (_head.compare_exchange_weak(h, nh, std::memory_order_acquire, std::memory_order_acquire)) {
+      _num.fetch_sub(1, std::memory_order_relaxed);
+      return &_packets[top];
+    }
+  }
+}
+
+bool LockFreePacketPool::free(mesh::Packet* packet) {
+  if (packet < _packets || packet >= &_packets[_size]) return false;
+
+  uint16_t idx = packet - _packets;
+  uint32_t h = _head.load(std::memory_order_relaxed);
+  for (;;) {
+    _next[idx].store(h & 0xFFFF, std::memory_order_relaxed);
+    uint32_t nh = ((h & 0xFFFF0000) + 0x10000) | idx;
+    if (_head.compare_exchange_weak(h, nh, std::memory_order_release, std::memory_order_relaxed)) break;
+  }
+  _num.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+ConcurrentPacketManager::ConcurrentPacketManager(int pool_size)
+  : unused(pool_size), queues(pool_size, *this), _consumer(NULL) {
+}
+
+void ConcurrentPacketManager::drainOutbound() const {
+  noteConsumer();
+  Queued q;
+  while (outbox.pop(q)) queues.queueOutbound(q.packet, q.priority, q.scheduled_for);
+}
+
+void ConcurrentPacketManager::drainInbound() const {
+  noteConsumer();
+  Queued q;
+  while (inbox.pop(q)) queues.queueInbound(q.packet, q.scheduled_for);
+}
+
+mesh::Packet* ConcurrentPacketManager::allocNew() {
+  return unused.alloc();  // returns NULL if empty
+}
+
+void ConcurrentPacketManager::free(mesh::Packet* packet) {
+  packet->_tx_channel = 0;   // local only, so don't leave it for the next user
+  if (!unused.free(packet)) {
+    MESH_DEBUG_PRINTLN("ConcurrentPacketManager::free(): WARNING: not from pool");
+  }
+}
+
+void ConcurrentPacketManager::queueOutbound(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) {
+  if (onConsumerTask()) {
+    queues.queueOutbound(packet, priority, scheduled_for);   // no need for the mailbox
+    return;
+  }
+  Queued q = { packet, scheduled_for, priority };
+  if (!outbox.push(q)) {
+    MESH_DEBUG_PRINTLN("ConcurrentPacketManager::queueOutbound(): mailbox full, packet dropped");
+    free(packet);   // don't leak it from the pool
+  }
+}
+
+// NOTE: index based access is only valid after getOutboundCount(), which is when the outbox is drained
+
+mesh::Packet* ConcurrentPacketManager::getNextOutbound(uint32_t now, uint8_t* priority, uint32_t* scheduled_for) {
+  drainOutbound();
+  return queues.getNextOutbound(now, priority, scheduled_for);
+}
+
+int ConcurrentPacketManager::getOutboundCount(uint32_t now) const {
+  drainOutbound();
+  return queues.getOutboundCount(now);
+}
+
+bool ConcurrentPacketManager::hasOutboundDue(uint32_t now) const {
+  drainOutbound();
+  return queues.hasOutboundDue(now);
+}
+
+bool ConcurrentPacketManager::getNextOutboundTime(uint32_t* scheduled_for) const {
+  drainOutbound();
+  return queues.getNextOutboundTime(scheduled_for);
+}
+
+int ConcurrentPacketManager::getFreeCount() const {
+  return unused.count();
+}
+
+mesh::Packet* ConcurrentPacketManager::getOutboundByIdx(int i) {
+  return queues.getOutboundByIdx(i);
+}
+mesh::Packet* ConcurrentPacketManager::removeOutboundByIdx(int i) {
+  return queues.removeOutboundByIdx(i);
+}
+
+void ConcurrentPacketManager::queueInbound(mesh::Packet* packet, uint32_t scheduled_for) {
+  if (onConsumerTask()) {
+    queues.queueInbound(packet, scheduled_for);
+    return;
+  }
+  Queued q = { packet, scheduled_for, 0 };
+  if (!inbox.push(q)) {
+    MESH_DEBUG_PRINTLN("ConcurrentPacketManager::queueInbound(): mailbox full, packet dropped");
+    free(packet);
+  }
+}
+mesh::Packet* ConcurrentPacketManager::getNextInbound(uint32_t now, uint32_t* scheduled_for) {
+  drainInbound();
+  return queues.getNextInbound(now, scheduled_for);
+}
+bool ConcurrentPacketManager::getNextInboundTime(uint32_t* scheduled_for) const {
+  drainInbound();
+  return queues.getNextInboundTime(scheduled_for);
+}
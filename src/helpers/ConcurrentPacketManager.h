@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Dispatcher.h>
+#include <helpers/ScheduledPacketManager.h>
+#include <helpers/MPSCQueue.h>
+#include <atomic>
+
+#if defined(ESP32)
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/task.h>
+#endif
+
+#ifndef PACKET_MAILBOX_SIZE
+  #define PACKET_MAILBOX_SIZE    16    // per direction, must be a power of 2
+#endif
+
+/**
+ * \brief  A fixed pool of Packets, as a lock-free (Treiber) stack, so alloc() and free() are safe from any task or ISR.
+ *     The stack links are indices into the pool, and the head carries a 16-bit tag (bumped on every change) alongside
+ *     the top index, so a CAS against a head that was popped and pushed back in the meantime (ABA) still fails.
+*/
+class LockFreePacketPool {
+  mesh::Packet* _packets;
+  std::atomic<uint16_t>* _next;
+  std::atomic<uint32_t> _head;   // tag << 16 | index of top (or NIL)
+  std::atomic<int> _num;
+  int _size;
+
+public:
+  LockFreePacketPool(int pool_size);
+  mesh::Packet* alloc();
+
+  /** \returns  false if 'packet' is not one of ours */
+  bool free(mesh::Packet* packet);
+  int count() const { return _num.load(std::memory_order_relaxed); }
+};
+
+/**
+ * \brief  A PacketManager which can be given Packets from other tasks, ISRs or cores (eg. a bridge's Wi-Fi callback),
+ *     without any global critical section. allocNew(), free(), queueOutbound() and queueInbound() may be called from
+ *     anywhere. Queued packets go into a lock-free MPSC mailbox per direction, and are moved into the (deadline
+ *     scheduled) queues by the Dispatcher, ie. the one consumer, whenever it next looks at them. All other methods
+ *     are for the Dispatcher's task only.
+ *     Packets queued by the Dispatcher's own task skip the mailbox (so are never dropped for it being full).
+ *  NOTE: no PacketSlab compaction, as that rewrites queued entries. A full mailbox drops (and frees) the packet, which
+ *     is counted in getNumDropped().
+*/
+class ConcurrentPacketManager : public mesh::PacketManager {
+  struct Queued {
+    mesh::Packet* packet;
+    uint32_t scheduled_for;
+    uint8_t priority;
+  };
+  LockFreePacketPool unused;
+  mutable ScheduledPacketManager queues;   // (Packets alloc'd from, and freed to, this)
+  mutable MPSCQueue<Queued, PACKET_MAILBOX_SIZE> outbox, inbox;
+  mutable std::atomic<void*> _consumer;   // task which drains the mailboxes (the Dispatcher's), NULL until known
+
+  static void* currentTask() {
+  #if defined(ESP32)
+    return (void *) xTaskGetCurrentTaskHandle();
+  #else
+    return NULL;   // (no tasks, so always use the mailboxes)
+  #endif
+  }
+  void noteConsumer() const { if (_consumer.load(std::memory_order_relaxed) == NULL) _consumer.store(currentTask()); }
+  bool onConsumerTask() const {
+    void* c = _consumer.load(std::memory_order_relaxed);
+    return c != NULL && c == currentTask();
+  }
+
+  void drainOutbound() const;
+  void drainInbound() const;
+
+public:
+  ConcurrentPacketManager(int pool_size);
+
+  mesh::Packet* allocNew() override;
+  void free(mesh::Packet* packet) override;
+  void queueOutbound(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) override;
+  mesh::Packet* getNextOutbound(uint32_t now, uint8_t* priority=NULL, uint32_t* scheduled_for=NULL) override;
+  void setOutboundAging(uint32_t millis) override { queues.setOutboundAging(millis); }
+  int getOutboundCount(uint32_t now) const override;
+  bool hasOutboundDue(uint32_t now) const override;
+  bool getNextOutboundTime(uint32_t* scheduled_for) const override;
+  int getFreeCount() const override;
+  mesh::Packet* getOutboundByIdx(int i) override;
+  mesh::Packet* removeOutboundByIdx(int i) override;
+  void queueInbound(mesh::Packet* packet, uint32_t scheduled_for) override;
+  mesh::Packet* getNextInbound(uint32_t now, uint32_t* scheduled_for=NULL) override;
+  bool getNextInboundTime(uint32_t* scheduled_for) const override;
+  bool getOutboundTimeByIdx(int i, uint32_t* scheduled_for) const override { return queues.getOutboundTimeByIdx(i, scheduled_for); }
+
+  uint32_t getNumDropped() const { return outbox.getNumDropped() + inbox.getNumDropped(); }
+};
@@ -43,4 +43,37 @@ bool ESP32Board::startOTAUpdate(const char* id, char reply[]) {
 }
 #endif
 
+uint32_t ESP32Board::getFirmwareImageMax() {
+  auto part = esp_ota_get_next_update_partition(NULL);
+  return part ? part->size : 0;   // no OTA partition scheme
+}
+
+bool ESP32Board::readFirmwareImage(uint8_t which, uint32_t offset, uint8_t* dest, int len) {
+  auto part = which == FW_IMAGE_RUNNING ? esp_ota_get_running_partition() : esp_ota_get_next_update_partition(NULL);
+  if (part == NULL || offset + len > part->size) return false;
+  return esp_partition_read(part, offset, dest, len) == ESP_OK;
+}
+
+bool ESP32Board::beginFirmwareImage(uint32_t size) {
+  if (_ota_handle) {
+    esp_ota_abort(_ota_handle);   // discard previous
+    _ota_handle = 0;
+  }
+  _ota_part = esp_ota_get_next_update_partition(NULL);
+  if (_ota_part == NULL || size > _ota_part->size) return false;
+  return esp_ota_begin(_ota_part, size, &_ota_handle) == ESP_OK;   // (erases just 'size' bytes)
+}
+
+bool ESP32Board::writeFirmwareImage(uint32_t offset, const uint8_t* src, int len) {
+  if (_ota_handle == 0) return false;
+  return esp_ota_write_with_offset(_ota_handle, src, len, offset) == ESP_OK;
+}
+
+bool ESP32Board::applyFirmwareImage() {
+  if (_ota_handle == 0) return false;
+  esp_err_t err = esp_ota_end(_ota_handle);   // also validates the app image
+  _ota_handle = 0;
+  return err == ESP_OK && esp_ota_set_boot_partition(_ota_part) == ESP_OK;
+}
+
 #endif
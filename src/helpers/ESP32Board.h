@@ -8,12 +8,18 @@
 #include <rom/rtc.h>
 #include <sys/time.h>
 #include <Wire.h>
+#include <esp_ota_ops.h>
 
 class ESP32Board : public mesh::MainBoard {
+  esp_ota_handle_t _ota_handle;   // staged firmware image being written, or zero
+  const esp_partition_t* _ota_part;
+
 protected:
   uint8_t startup_reason;
 
 public:
+  ESP32Board() : _ota_handle(0), _ota_part(NULL) { }
+
   void begin() {
     // for future use, sub-classes SHOULD call this from their begin()
     startup_reason = BD_STARTUP_NORMAL;
@@ -87,6 +93,12 @@ public:
   }
 
   bool startOTAUpdate(const char* id, char reply[]) override;
+
+  uint32_t getFirmwareImageMax() override;
+  bool readFirmwareImage(uint8_t which, uint32_t offset, uint8_t* dest, int len) override;
+  bool beginFirmwareImage(uint32_t size) override;
+  bool writeFirmwareImage(uint32_t offset, const uint8_t* src, int len) override;
+  bool applyFirmwareImage() override;
 };
 
 class ESP32RTCClock : public mesh::RTCClock {
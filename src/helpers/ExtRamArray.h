@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+
+#ifndef EXT_RAM_TABLES
+  #if defined(ESP32) && defined(BOARD_HAS_PSRAM)
+    #define EXT_RAM_TABLES   1    // large, colder tables (see ExtRamArray) go in PSRAM
+  #else
+    #define EXT_RAM_TABLES   0
+  #endif
+#endif
+
+#if EXT_RAM_TABLES
+  #include <Arduino.h>
+  #include <esp_heap_caps.h>
+#endif
+
+/**
+ * \brief  allocates (zeroed) table memory from external RAM (PSRAM), falling back to the internal heap if
+ *     there is none (or not enough). NOTE: may be called from global constructors, ie. before initArduino()
+ *     has brought PSRAM up, hence the psramInit() (which is a no-op once done).
+*/
+inline void* extRamCalloc(size_t size) {
+#if EXT_RAM_TABLES
+  if (psramInit()) {
+    void* p = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p) return p;
+  }
+#endif
+  return calloc(1, size);
+}
+
+/**
+ * \brief  A fixed size array, T[N], for large tables which are not on the hot path (eg. contacts, the offline
+ *     message queue, but NOT the dedup ring). With EXT_RAM_TABLES the items live in PSRAM, allocated once at
+ *     construction and never freed, otherwise it is a plain inline array (so no change on boards without PSRAM).
+ *     Converts to T*, so indexing and pointer arithmetic are as for a plain array, but sizeof() is not; use BYTES.
+ *     Keep any index which is searched per packet (eg. CyclicTableIndex) in internal RAM, next to the owner.
+*/
+template<typename T, int N>
+class ExtRamArray {
+#if EXT_RAM_TABLES
+  T* _items;
+#else
+  T _items[N];
+#endif
+
+public:
+  static constexpr size_t BYTES = sizeof(T) * N;
+
+#if EXT_RAM_TABLES
+  ExtRamArray() {
+    _items = (T *) extRamCalloc(BYTES);
+    for (int i = 0; i < N; i++) new (&_items[i]) T;   // (zeroed, as for a static array)
+  }
+  ExtRamArray(const ExtRamArray&) = delete;
+  ExtRamArray& operator=(const ExtRamArray&) = delete;
+#endif
+
+  operator T*() { return _items; }
+  operator const T*() const { return _items; }
+  static constexpr int size() { return N; }
+};
@@ -0,0 +1,268 @@
+#include "FirmwareXfer.h"
+
+#define MF_VER_OFS      FW_TARGET_SIZE
+#define MF_SIZE_OFS     (FW_TARGET_SIZE + 4)
+#define MF_HASH_OFS     (FW_TARGET_SIZE + 8)
+#define MF_SIGNER_OFS   FW_MANIFEST_SIGNED_LEN
+#define MF_SIG_OFS      (FW_MANIFEST_SIGNED_LEN + PUB_KEY_SIZE)
+
+FirmwareXfer::FirmwareXfer(mesh::MainBoard& board) : _board(&board) {
+  memset(_target, 0, sizeof(_target));
+  memset(_failed_id, 0, sizeof(_failed_id));
+  memset(_manifest, 0, sizeof(_manifest));
+  _size = _num_chunks = _num_received = _hash_pos = 0;
+  _failed_at = 0;
+  _running_ver = 0;
+  _attempts = 0;
+  _state = FW_STATE_IDLE;
+  _seeded = false;
+  _last_chunk = _last_progress = _next_offer = 0;
+  _need_interval = FW_NEED_IDLE_MILLIS;
+}
+
+void FirmwareXfer::begin(const char* role, uint32_t running_ver) {
+  _running_ver = running_ver;
+  char name[80];
+  snprintf(name, sizeof(name), "%s/%s", _board->getManufacturerName(), role);
+  mesh::Utils::sha256(_target, FW_TARGET_SIZE, (const uint8_t *) name, strlen(name));
+}
+
+uint32_t FirmwareXfer::parseVersion(const char* ver) {
+  if (*ver == 'v') ver++;
+  uint32_t result = 0;
+  for (int i = 0; i < 3; i++) {
+    uint32_t n = 0;
+    while (*ver >= '0' && *ver <= '9') n = n*10 + (*ver++ - '0');
+    result = (result << 8) | (n > 0xFF ? 0xFF : n);
+    if (*ver == '.') ver++;
+  }
+  return result;
+}
+
+int FirmwareXfer::getChunkLen(uint16_t idx) const {
+  uint32_t ofs = (uint32_t)idx * FW_CHUNK_SIZE;
+  return _size - ofs < FW_CHUNK_SIZE ? _size - ofs : FW_CHUNK_SIZE;
+}
+
+bool FirmwareXfer::isNewOffer(const uint8_t* manifest) const {
+  if (memcmp(manifest, _target, FW_TARGET_SIZE) != 0) return false;   // for other boards/roles
+  uint32_t ver;
+  memcpy(&ver, &manifest[MF_VER_OFS], 4);
+  if (ver <= _running_ver) return false;   // no rollbacks (nor re-installs)
+  if (memcmp(&manifest[MF_HASH_OFS], _failed_id, FW_ID_SIZE) == 0) return false;
+  if (_state == FW_STATE_IDLE || _state == FW_STATE_FAILED) return true;
+  return false;   // busy with a transfer (maybe this one)
+}
+
+bool FirmwareXfer::isSigned(const uint8_t* manifest) {
+  mesh::Identity signer(&manifest[MF_SIGNER_OFS]);
+  return signer.verify(&manifest[MF_SIG_OFS], manifest, FW_MANIFEST_SIGNED_LEN);
+}
+
+void FirmwareXfer::start(const uint8_t* manifest, bool seeded) {
+  memcpy(_manifest, manifest, FW_MANIFEST_LEN);
+  memcpy(&_size, &_manifest[MF_SIZE_OFS], 4);
+  _seeded = seeded;
+
+  uint32_t max_size = _board->getFirmwareImageMax();
+  if (max_size > FW_MAX_IMAGE_SIZE) max_size = FW_MAX_IMAGE_SIZE;
+  if (_size == 0 || _size > max_size) {
+    MESH_DEBUG_PRINTLN("FirmwareXfer: image size not supported: %u", _size);
+    _state = FW_STATE_FAILED;
+    return;
+  }
+  _num_chunks = (_size + FW_CHUNK_SIZE - 1) / FW_CHUNK_SIZE;
+  _attempts = 0;
+  _state = FW_STATE_CHECKING;   // first, see if we are already running this image
+  _hash_pos = 0;
+  _sha.reset();
+}
+
+bool FirmwareXfer::offer(const uint8_t* manifest) {
+  if (_board->getFirmwareImageMax() == 0 || memcmp(manifest, _target, FW_TARGET_SIZE) != 0) return false;
+  uint32_t ver;
+  memcpy(&ver, &manifest[MF_VER_OFS], 4);
+  if (ver != _running_ver) return false;
+
+  start(manifest, true);
+  return _state != FW_STATE_FAILED;
+}
+
+void FirmwareXfer::onOfferRecv(const uint8_t* manifest) {
+  start(manifest, false);
+}
+
+void FirmwareXfer::onNeedRecv(const uint8_t* data, int len, unsigned long now) {
+  if (len < 1 + FW_ID_SIZE + 2 + FW_NEED_WINDOW/8 || memcmp(&data[1], getId(), FW_ID_SIZE) != 0) return;
+
+  if (_state == FW_STATE_RECEIVING) {
+    _last_chunk = now;   // a neighbour has just asked, so hold off asking ourselves (we'll hear the chunks too)
+  } else if (_state == FW_STATE_HOLDING) {
+    uint16_t base;
+    memcpy(&base, &data[1 + FW_ID_SIZE], 2);
+
+    bool serving = false;
+    for (int i = 0; i < (int) sizeof(_serve); i++) { if (_serve[i]) { serving = true; break; } }
+    if (serving && base != _serve_base) return;   // busy with another window (asker will repeat)
+
+    _serve_base = base;
+    const uint8_t* bits = &data[1 + FW_ID_SIZE + 2];
+    for (int i = 0; i < FW_NEED_WINDOW && base + i < _num_chunks; i++) {
+      if (bits[i >> 3] & (1 << (i & 7))) _serve[i >> 3] |= (1 << (i & 7));
+    }
+  }
+}
+
+void FirmwareXfer::onChunkRecv(const uint8_t* data, int len, unsigned long now) {
+  if (len < 1 + FW_ID_SIZE + 2 || memcmp(&data[1], getId(), FW_ID_SIZE) != 0) return;
+
+  uint16_t idx;
+  memcpy(&idx, &data[1 + FW_ID_SIZE], 2);
+  if (idx >= _num_chunks) return;
+
+  if (_state == FW_STATE_HOLDING) {
+    int i = idx - _serve_base;
+    if (i >= 0 && i < FW_NEED_WINDOW) _serve[i >> 3] &= ~(1 << (i & 7));   // another holder has just sent it
+  } else if (_state == FW_STATE_RECEIVING) {
+    const uint8_t* chunk = &data[1 + FW_ID_SIZE + 2];
+    int chunk_len = len - (1 + FW_ID_SIZE + 2);
+    if (chunk_len != getChunkLen(idx) || (_have[idx >> 3] & (1 << (idx & 7)))) return;   // bad length, or dup
+
+    if (_board->writeFirmwareImage((uint32_t)idx * FW_CHUNK_SIZE, chunk, chunk_len)) {
+      _have[idx >> 3] |= (1 << (idx & 7));
+      _last_chunk = _last_progress = now;
+      _need_interval = FW_NEED_IDLE_MILLIS;
+      if (++_num_received == _num_chunks) {
+        _state = FW_STATE_VERIFYING;
+        _hash_pos = 0;
+        _sha.reset();
+      }
+    }
+  }
+}
+
+void FirmwareXfer::onHashed(unsigned long now) {
+  uint8_t hash[32];
+  _sha.finalize(hash, sizeof(hash));
+  bool match = memcmp(hash, &_manifest[MF_HASH_OFS], sizeof(hash)) == 0;
+
+  if (_state == FW_STATE_CHECKING && !match && !_seeded) {   // don't have it yet, so start receiving
+    startReceiving(now);
+  } else if (match) {
+    _source = _state == FW_STATE_CHECKING ? FW_IMAGE_RUNNING : FW_IMAGE_STAGED;
+    _state = FW_STATE_HOLDING;
+    memset(_serve, 0, sizeof(_serve));
+    _next_offer = now;   // let neighbours know
+  } else if (_state == FW_STATE_VERIFYING && ++_attempts < FW_MAX_ATTEMPTS) {
+    // chunks aren't authenticated, so can't tell which was bad (corrupt, or forged by a neighbour). Fetch them all again
+    MESH_DEBUG_PRINTLN("FirmwareXfer: image hash mismatch, re-fetching");
+    startReceiving(now);
+  } else {
+    MESH_DEBUG_PRINTLN("FirmwareXfer: image hash mismatch");
+    memcpy(_failed_id, getId(), FW_ID_SIZE);
+    _failed_at = now;
+    _state = FW_STATE_FAILED;
+  }
+}
+
+void FirmwareXfer::startReceiving(unsigned long now) {
+  if (_board->beginFirmwareImage(_size)) {
+    memset(_have, 0, sizeof(_have));
+    _num_received = 0;
+    _state = FW_STATE_RECEIVING;
+    _need_interval = FW_NEED_IDLE_MILLIS;
+    _last_chunk = now - _need_interval;   // ask for chunks straight away
+    _last_progress = now;
+  } else {
+    _state = FW_STATE_FAILED;
+  }
+}
+
+void FirmwareXfer::loop(unsigned long now) {
+  if (_failed_at && now - _failed_at >= FW_FAILED_HOLD_MILLIS) {   // give that image another chance
+    memset(_failed_id, 0, sizeof(_failed_id));
+    _failed_at = 0;
+  }
+  if (_state == FW_STATE_RECEIVING && now - _last_progress >= FW_RX_TIMEOUT_MILLIS) {
+    MESH_DEBUG_PRINTLN("FirmwareXfer: no chunks received, giving up");
+    _state = FW_STATE_IDLE;
+    return;
+  }
+  if (_state != FW_STATE_CHECKING && _state != FW_STATE_VERIFYING) return;
+
+  uint8_t which = _state == FW_STATE_CHECKING ? FW_IMAGE_RUNNING : FW_IMAGE_STAGED;
+  uint8_t buf[256];
+  for (int n = 0; n < FW_HASH_STEP && _hash_pos < _size; n += sizeof(buf)) {
+    int len = _size - _hash_pos < sizeof(buf) ? _size - _hash_pos : sizeof(buf);
+    if (!_board->readFirmwareImage(which, _hash_pos, buf, len)) {
+      _state = FW_STATE_FAILED;
+      return;
+    }
+    _sha.update(buf, len);
+    _hash_pos += len;
+  }
+  if (_hash_pos >= _size) onHashed(now);
+}
+
+int FirmwareXfer::nextFrame(uint8_t* dest, unsigned long now) {
+  if (_state == FW_STATE_HOLDING) {
+    for (int i = 0; i < FW_NEED_WINDOW; i++) {   // serve lowest chunk asked for
+      if ((_serve[i >> 3] & (1 << (i & 7))) == 0) continue;
+      _serve[i >> 3] &= ~(1 << (i & 7));
+
+      uint16_t idx = _serve_base + i;
+      if (idx >= _num_chunks) continue;
+      int len = getChunkLen(idx);
+      int ofs = 0;
+      dest[ofs++] = CTL_TYPE_FW_CHUNK;
+      memcpy(&dest[ofs], getId(), FW_ID_SIZE); ofs += FW_ID_SIZE;
+      memcpy(&dest[ofs], &idx, 2); ofs += 2;
+      if (!_board->readFirmwareImage(_source, (uint32_t)idx * FW_CHUNK_SIZE, &dest[ofs], len)) return 0;
+      return ofs + len;
+    }
+    if ((long)(now - _next_offer) >= 0) {
+      _next_offer = now + FW_OFFER_INTERVAL_MILLIS;
+      dest[0] = CTL_TYPE_FW_OFFER;
+      memcpy(&dest[1], _manifest, FW_MANIFEST_LEN);
+      return 1 + FW_MANIFEST_LEN;
+    }
+  } else if (_state == FW_STATE_RECEIVING && now - _last_chunk >= _need_interval) {
+    uint16_t base = 0;
+    while (base < _num_chunks && (_have[base >> 3] & (1 << (base & 7)))) base++;   // first missing
+
+    int ofs = 0;
+    dest[ofs++] = CTL_TYPE_FW_NEED;
+    memcpy(&dest[ofs], getId(), FW_ID_SIZE); ofs += FW_ID_SIZE;
+    memcpy(&dest[ofs], &base, 2); ofs += 2;
+    uint8_t* bits = &dest[ofs];
+    memset(bits, 0, FW_NEED_WINDOW/8); ofs += FW_NEED_WINDOW/8;
+    for (int i = 0; i < FW_NEED_WINDOW && base + i < _num_chunks; i++) {
+      int idx = base + i;
+      if ((_have[idx >> 3] & (1 << (idx & 7))) == 0) bits[i >> 3] |= (1 << (i & 7));
+    }
+    _last_chunk = now;   // (ask again, if still nothing heard after a longer idle period)
+    if (_need_interval < FW_NEED_MAX_MILLIS) _need_interval *= 2;
+    return ofs;
+  }
+  return 0;
+}
+
+bool FirmwareXfer::apply() {
+  if (_state != FW_STATE_HOLDING || _source != FW_IMAGE_STAGED) return false;
+  return _board->applyFirmwareImage();
+}
+
+void FirmwareXfer::stop() {
+  _state = FW_STATE_IDLE;
+}
+
+void FirmwareXfer::formatStatus(char* reply) const {
+  switch (_state) {
+    case FW_STATE_IDLE:      strcpy(reply, "idle"); break;
+    case FW_STATE_CHECKING:  sprintf(reply, "checking running image %u/%u", _hash_pos, _size); break;
+    case FW_STATE_RECEIVING: sprintf(reply, "receiving %u/%u chunks", (uint32_t)_num_received, (uint32_t)_num_chunks); break;
+    case FW_STATE_VERIFYING: sprintf(reply, "verifying %u/%u", _hash_pos, _size); break;
+    case FW_STATE_HOLDING:   sprintf(reply, "holding %s image, %u bytes", _source == FW_IMAGE_RUNNING ? "running" : "staged", _size); break;
+    default:                 strcpy(reply, "failed"); break;
+  }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Mesh.h>
+#include <SHA256.h>
+
+#ifndef FW_MAX_IMAGE_SIZE
+  #define FW_MAX_IMAGE_SIZE     (2*1024*1024)
+#endif
+#define FW_CHUNK_SIZE           160
+#define FW_MAX_CHUNKS           ((FW_MAX_IMAGE_SIZE + FW_CHUNK_SIZE - 1) / FW_CHUNK_SIZE)
+#define FW_NEED_WINDOW          128    // chunks covered by the bitmap in one NEED
+#define FW_ID_SIZE              4      // prefix of image's SHA256, identifying a transfer
+#define FW_TARGET_SIZE          4      // prefix of SHA256 of "{manufacturer name}/{role}"
+#define FW_MANIFEST_SIGNED_LEN  (FW_TARGET_SIZE + 4 + 4 + 32)   // target, version, image size, image SHA256
+#define FW_MANIFEST_LEN         (FW_MANIFEST_SIGNED_LEN + PUB_KEY_SIZE + SIGNATURE_SIZE)   // + signer, signature
+
+// control data sub-types (zero-hop, see docs/payloads.md)
+#define CTL_TYPE_FW_OFFER       0xA0
+#define CTL_TYPE_FW_NEED        0xB0
+#define CTL_TYPE_FW_CHUNK       0xC0
+
+#ifndef FW_HASH_STEP
+  #define FW_HASH_STEP          4096   // bytes of an image hashed per loop()
+#endif
+#ifndef FW_NEED_IDLE_MILLIS
+  #define FW_NEED_IDLE_MILLIS   8000   // no chunks heard for this long, so ask (again) for missing ones
+#endif
+#define FW_NEED_MAX_MILLIS      (5*60*1000UL)   // unanswered NEEDs back off (doubling) up to this
+#define FW_RX_TIMEOUT_MILLIS    (60*60*1000UL)  // no chunks for this long, so give up (until next OFFER)
+#ifndef FW_MAX_ATTEMPTS
+  #define FW_MAX_ATTEMPTS       3      // whole image re-fetched after a hash mismatch (eg. a corrupt/forged chunk)
+#endif
+#define FW_FAILED_HOLD_MILLIS   (6*60*60*1000UL)   // then, offers of that image are ignored for this long
+#ifndef FW_OFFER_INTERVAL_MILLIS
+  #define FW_OFFER_INTERVAL_MILLIS  (15*60*1000UL)
+#endif
+#ifndef FW_SEND_AIRTIME_FACTOR
+  #define FW_SEND_AIRTIME_FACTOR  4    // gap between sends, as multiple of the last one's air time
+#endif
+
+#define FW_STATE_IDLE        0
+#define FW_STATE_CHECKING    1   // hashing the running image, in case it's the one offered
+#define FW_STATE_RECEIVING   2
+#define FW_STATE_VERIFYING   3   // hashing the staged image, once all chunks are in
+#define FW_STATE_HOLDING     4   // have the whole image, so can serve chunks of it
+#define FW_STATE_FAILED      5
+
+/**
+ * \brief  Distribution of a firmware image over the mesh, to all the nodes of a neighbourhood at once. A node holding
+ *     the image sends a signed OFFER (zero-hop). Neighbours stage the image via MainBoard::writeFirmwareImage(). They
+ *     ask for missing chunks with NEED bitmaps (selective repeat), and any holder answers with CHUNKs. Every chunk
+ *     sent is heard by all neighbours, so each is sent roughly once per neighbourhood, not once per node. Once its
+ *     image has been verified (SHA256), a node becomes a holder itself, so the update spreads hop by hop.
+ *     The caller checks the OFFER's signer (eg. an admin in the ACL), and sends the frames from nextFrame().
+*/
+class FirmwareXfer {
+  mesh::MainBoard* _board;
+  uint8_t _target[FW_TARGET_SIZE];
+  uint8_t _manifest[FW_MANIFEST_LEN];
+  uint8_t _failed_id[FW_ID_SIZE];   // image that failed verification, so its offers are ignored (for a while)
+  unsigned long _failed_at;
+  uint32_t _running_ver;
+  uint8_t _attempts;  // fetches of current image which failed verification
+  uint8_t _state;
+  uint8_t _source;    // FW_IMAGE_*, when holding
+  bool _seeded;       // was given by offer(), ie. must be the running image
+  uint32_t _size;
+  uint16_t _num_chunks, _num_received;
+  uint32_t _hash_pos;
+  SHA256 _sha;
+  uint8_t _have[(FW_MAX_CHUNKS + 7) / 8];   // bitmap, by chunk index
+  uint16_t _serve_base;
+  uint8_t _serve[FW_NEED_WINDOW / 8];       // chunks asked for by neighbours, from _serve_base
+  unsigned long _last_chunk, _last_progress, _next_offer;
+  uint32_t _need_interval;
+
+  const uint8_t* getId() const { return &_manifest[FW_TARGET_SIZE + 8]; }   // (prefix of SHA256)
+  int getChunkLen(uint16_t idx) const;
+  void start(const uint8_t* manifest, bool seeded);
+  void startReceiving(unsigned long now);
+  void onHashed(unsigned long now);
+
+public:
+  FirmwareXfer(mesh::MainBoard& board);
+
+  /**
+   * \brief  sets this node's target (which images it will accept)
+   * \param  role  eg. "repeater"
+   * \param  running_ver  version of the running image (see parseVersion()). Only newer images are accepted.
+  */
+  void begin(const char* role, uint32_t running_ver);
+
+  /**
+   * \returns  "v1.11.0" as 0x010B00, ie. major, minor, patch (8 bits each), for manifest versions
+  */
+  static uint32_t parseVersion(const char* ver);
+
+  /**
+   * \returns  true if 'manifest' is for this node's target, is newer than the running image, and an image not already
+   *     being handled (so is worth verifying the signature of)
+  */
+  bool isNewOffer(const uint8_t* manifest) const;
+
+  /** \returns  true if signature in 'manifest' is valid. (caller still needs to check the signer is trusted) */
+  static bool isSigned(const uint8_t* manifest);
+
+  /**
+   * \brief  (seed node) starts offering the running image, eg. after it was updated by Wi-Fi. Fails (later) if the
+   *     running image isn't the one in 'manifest'
+   * \returns  false if not supported, or is for another target, or version isn't the running one
+  */
+  bool offer(const uint8_t* manifest);
+
+  void onOfferRecv(const uint8_t* manifest);   // after checking isNewOffer(), and signer
+  void onNeedRecv(const uint8_t* data, int len, unsigned long now);
+  void onChunkRecv(const uint8_t* data, int len, unsigned long now);
+
+  void loop(unsigned long now);
+
+  /**
+   * \brief  the next OFFER, NEED or CHUNK frame (as control data) to send, if any is due
+   * \returns  length of frame put in 'dest' (MAX_PACKET_PAYLOAD), or zero
+  */
+  int nextFrame(uint8_t* dest, unsigned long now);
+
+  bool apply();   // staged image (when holding) boots on next reboot
+  void stop();
+  uint8_t getState() const { return _state; }
+  void formatStatus(char* reply) const;
+};
@@ -0,0 +1,211 @@
+#include <Arduino.h>
+#include "FlashWriter.h"
+#include "TxtDataHelpers.h"
+#include <LoopMonitor.h>
+
+FlashWriter flash_writer;
+
+FlashWriter::FlashWriter() {
+  _buf = NULL;
+  _buf_used = 0;
+  _head = _num = 0;
+  _done = 0;
+  _file_open = false;
+  _n_queued = _n_sync = _n_failed = 0;
+#if defined(ESP32)
+  _task = NULL;
+  _mutex = _work = NULL;
+#endif
+}
+
+#if defined(ESP32)
+void FlashWriter::taskMain(void* p) {
+  auto self = (FlashWriter *) p;
+  for (;;) {
+    if (xSemaphoreTake(self->_work, portMAX_DELAY) == pdTRUE) {
+      while (self->step(FLASH_WRITER_BUF_SIZE)) { }
+    }
+  }
+}
+#endif
+
+void FlashWriter::begin() {
+  if (_buf) return;  // already started
+  _buf = new uint8_t[FLASH_WRITER_BUF_SIZE];
+#if defined(ESP32)
+  _mutex = xSemaphoreCreateMutex();
+  _work = xSemaphoreCreateBinary();
+  if (_mutex == NULL || _work == NULL
+      || xTaskCreate(taskMain, "flash_wr", 4096, this, FLASH_WRITER_PRIO, &_task) != pdPASS) {
+    MESH_DEBUG_PRINTLN("FlashWriter::begin(): can't start task, writing from loop()");
+    _task = NULL;
+  }
+#endif
+}
+
+void FlashWriter::lock() {
+#if defined(ESP32)
+  if (_mutex) xSemaphoreTake(_mutex, portMAX_DELAY);
+#endif
+}
+
+void FlashWriter::unlock() {
+#if defined(ESP32)
+  if (_mutex) xSemaphoreGive(_mutex);
+#endif
+}
+
+File FlashWriter::openFor(const Job& job) {
+#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+  if (job.mode == FLASH_WRITE_REPLACE) job.fs->remove(job.filename);
+  return job.fs->open(job.filename, FILE_O_WRITE);
+#elif defined(RP2040_PLATFORM)
+  if (job.mode == FLASH_WRITE_APPEND) return job.fs->open(job.filename, "a");
+  if (job.mode == FLASH_WRITE_AT) return job.fs->open(job.filename, "r+");
+  return job.fs->open(job.filename, "w");
+#else
+  if (job.mode == FLASH_WRITE_APPEND) return job.fs->open(job.filename, "a", true);
+  if (job.mode == FLASH_WRITE_AT) return job.fs->open(job.filename, "r+");
+  return job.fs->open(job.filename, "w", true);
+#endif
+}
+
+bool FlashWriter::writeNow(FILESYSTEM* fs, const char* filename, const uint8_t* data, int len, uint8_t mode, uint32_t pos) {
+  LOOP_SCOPE(LOOP_SECT_STORE);
+  Job job;
+  job.fs = fs;
+  StrHelper::strncpy(job.filename, filename, sizeof(job.filename));
+  job.mode = mode;
+  File file = openFor(job);
+  if (!file) return false;
+  bool success = (mode != FLASH_WRITE_AT || file.seek(pos)) && file.write(data, len) == (size_t) len;
+  file.close();
+  return success;
+}
+
+bool FlashWriter::step(int max_bytes) {
+  lock();
+  if (_num == 0) {
+    unlock();
+    return false;
+  }
+  Job job = _jobs[_head];   // (the head job is never changed by write())
+  unlock();
+
+  bool finished = true;
+  if (!job.superseded) {
+    if (!_file_open) {
+      _file = openFor(job);
+      _file_open = (bool) _file;
+      _done = 0;
+      if (_file_open && job.mode == FLASH_WRITE_AT && !_file.seek(job.pos)) {
+        _file.close();
+        _file_open = false;
+      }
+    }
+    if (_file_open) {
+      int n = job.len - _done;
+      if (n > max_bytes) n = max_bytes;
+      if (_file.write(&_buf[job.off + _done], n) != (size_t) n) {
+        _done = job.len;
+        _n_failed++;
+      } else {
+        _done += n;
+      }
+      finished = _done >= job.len;
+      if (finished) {
+        _file.close();
+        _file_open = false;
+      }
+    } else {
+      MESH_DEBUG_PRINTLN("FlashWriter: can't open %s", job.filename);
+      _n_failed++;
+    }
+  }
+
+  if (finished) {
+    lock();
+    _head = (_head + 1) % FLASH_WRITER_MAX_JOBS;
+    _num--;
+    if (_num == 0) _buf_used = 0;   // empty, so can start from the top again
+    unlock();
+  }
+  return true;
+}
+
+bool FlashWriter::write(FILESYSTEM* fs, const char* filename, const uint8_t* data, int len, uint8_t mode, uint32_t pos) {
+  if (_buf == NULL || len > FLASH_WRITER_BUF_SIZE || strlen(filename) >= sizeof(_jobs[0].filename)) {
+    flush();   // (keep the order of writes)
+    _n_sync++;
+    return writeNow(fs, filename, data, len, mode, pos);
+  }
+
+  lock();
+  if (_num >= FLASH_WRITER_MAX_JOBS || _buf_used + len > FLASH_WRITER_BUF_SIZE) {
+    unlock();
+    flush();   // queue is full, so have to wait for it
+    _n_sync++;
+    lock();
+  }
+  if (mode == FLASH_WRITE_REPLACE) {   // supersedes any pending writes to the file (not the one in progress, at head)
+    for (int i = 1; i < _num; i++) {
+      auto j = &_jobs[(_head + i) % FLASH_WRITER_MAX_JOBS];
+      if (j->fs == fs && strcmp(j->filename, filename) == 0) j->superseded = true;
+    }
+  }
+  auto job = &_jobs[(_head + _num) % FLASH_WRITER_MAX_JOBS];
+  job->fs = fs;
+  strcpy(job->filename, filename);
+  job->off = _buf_used;
+  job->len = len;
+  job->pos = pos;
+  job->mode = mode;
+  job->superseded = false;
+  memcpy(&_buf[_buf_used], data, len);
+  _buf_used += len;
+  _num++;
+  _n_queued++;
+  unlock();
+
+#if defined(ESP32)
+  if (_task) xSemaphoreGive(_work);
+#endif
+  return true;
+}
+
+bool FlashWriter::isPending(const char* filename) {
+  bool found = false;
+  lock();
+  for (int i = 0; i < _num && !found; i++) {
+    auto j = &_jobs[(_head + i) % FLASH_WRITER_MAX_JOBS];
+    if (!j->superseded && strcmp(j->filename, filename) == 0) found = true;
+  }
+  unlock();
+  return found;
+}
+
+bool FlashWriter::isIdle() {
+  lock();
+  bool idle = _num == 0;
+  unlock();
+  return idle;
+}
+
+void FlashWriter::flush() {
+  LOOP_SCOPE(LOOP_SECT_STORE);
+#if defined(ESP32)
+  if (_task) {
+    while (!isIdle()) vTaskDelay(1);
+    return;
+  }
+#endif
+  while (step(FLASH_WRITER_BUF_SIZE)) { }
+}
+
+void FlashWriter::loop() {
+#if defined(ESP32)
+  if (_task) return;   // task does it
+#endif
+  LOOP_SCOPE(LOOP_SECT_STORE);
+  step(FLASH_WRITER_CHUNK);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <helpers/IdentityStore.h>   // for FILESYSTEM
+
+#ifndef FLASH_WRITER_BUF_SIZE
+  #if defined(ESP32)
+    #define FLASH_WRITER_BUF_SIZE   4096    // bytes of queued writes (snapshots)
+  #else
+    #define FLASH_WRITER_BUF_SIZE   2048
+  #endif
+#endif
+#ifndef FLASH_WRITER_MAX_JOBS
+  #define FLASH_WRITER_MAX_JOBS     8
+#endif
+#ifndef FLASH_WRITER_PRIO
+  #define FLASH_WRITER_PRIO         1       // same as the Arduino loop, so the mesh isn't starved
+#endif
+#ifndef FLASH_WRITER_CHUNK
+  #define FLASH_WRITER_CHUNK        256     // bytes written per loop() (when no writer task)
+#endif
+
+#define FLASH_WRITE_REPLACE   0   // (re)create file, with just this data
+#define FLASH_WRITE_APPEND    1
+#define FLASH_WRITE_AT        2   // overwrite at 'pos', in an existing file
+
+/**
+ * \brief  Write-behind queue for file saves, so that the main loop (and radio) doesn't wait on flash page erases.
+ *     write() copies the data (a snapshot), and returns at once. On ESP32 the queue is written out by a low priority
+ *     task, otherwise by loop(), FLASH_WRITER_CHUNK bytes at a time. Writes are done in the order queued, and a pending
+ *     REPLACE of a file is superseded by a newer one.
+ *     If begin() hasn't been called, or a write doesn't fit, it's done there and then (after what's queued).
+ *  NOTE: call flush() before reading back a file which may have writes pending (see isPending()), before removing/
+ *     renaming such a file, and before a reboot or power off.
+*/
+class FlashWriter {
+  struct Job {
+    FILESYSTEM* fs;
+    char filename[32];
+    uint16_t off, len;   // of data, in _buf
+    uint32_t pos;
+    uint8_t mode;
+    bool superseded;
+  };
+  uint8_t* _buf;
+  int _buf_used;
+  Job _jobs[FLASH_WRITER_MAX_JOBS];
+  int _head, _num;        // FIFO of jobs
+  int _done;              // bytes of head job already written (in chunked mode)
+  File _file;             // head job's file, while being chunked
+  bool _file_open;
+  uint32_t _n_queued, _n_sync, _n_failed;
+#if defined(ESP32)
+  TaskHandle_t _task;
+  SemaphoreHandle_t _mutex, _work;
+  static void taskMain(void* p);
+#endif
+
+  void lock();
+  void unlock();
+  static File openFor(const Job& job);
+  bool writeNow(FILESYSTEM* fs, const char* filename, const uint8_t* data, int len, uint8_t mode, uint32_t pos);
+  bool step(int max_bytes);   // does (some of) head job, returns false if queue empty
+
+public:
+  FlashWriter();
+
+  void begin();
+
+  /**
+   * \returns  false only if written synchronously, and that failed (errors in the background are just counted)
+  */
+  bool write(FILESYSTEM* fs, const char* filename, const uint8_t* data, int len, uint8_t mode = FLASH_WRITE_REPLACE, uint32_t pos = 0);
+
+  bool isPending(const char* filename);
+  bool isIdle();
+
+  /** \brief  blocks until all queued writes are done */
+  void flush();
+
+  void loop();
+
+  uint32_t getNumQueued() const { return _n_queued; }
+  uint32_t getNumSync() const { return _n_sync; }       // done synchronously (no room in queue)
+  uint32_t getNumFailed() const { return _n_failed; }
+};
+
+extern FlashWriter flash_writer;
@@ -0,0 +1,49 @@
+#include "FloodDensity.h"
+
+void FloodDensity::update(int num_neighbours, uint32_t total_recv, uint32_t total_dups) {
+  if (total_recv < _last_recv || total_dups < _last_dups) {   // stats were reset, just re-sync
+    _last_recv = total_recv;
+    _last_dups = total_dups;
+    return;
+  }
+
+  uint32_t dups = total_dups - _last_dups;
+  uint32_t recv = total_recv - _last_recv;
+  uint32_t unique = recv > dups ? recv - dups : 0;
+
+  uint32_t sample;
+  if (unique >= FLOOD_MIN_SAMPLES) {
+    sample = dups * 16 / unique;
+    _measured = true;
+  } else if (!_measured) {
+    sample = num_neighbours * 16;   // no traffic measured yet, assume each neighbour will echo
+  } else {
+    return;  // too quiet to tell, keep the current estimate
+  }
+  if (sample > 0xFFFF) sample = 0xFFFF;
+
+  _echoes = (3*(uint32_t)_echoes + sample) / 4;
+  _last_recv = total_recv;
+  _last_dups = total_dups;
+}
+
+uint32_t FloodDensity::scaleDelay(uint32_t window) const {
+  uint32_t e = _echoes;
+  if (e < FLOOD_ECHOES_NOMINAL*16 / 2) e = FLOOD_ECHOES_NOMINAL*16 / 2;   // no less than half, when sparse
+  if (e > FLOOD_ECHOES_NOMINAL*16 * 5/2) e = FLOOD_ECHOES_NOMINAL*16 * 5/2;   // no more than 2.5x, when dense
+  return window * e / (FLOOD_ECHOES_NOMINAL*16);
+}
+
+bool FloodDensity::shouldSkip(const mesh::Packet* packet, mesh::RNG* rng) {
+  uint8_t type = packet->getPayloadType();
+  if (type == PAYLOAD_TYPE_ACK || type == PAYLOAD_TYPE_PATH) return false;   // losing these just causes retries
+  if (_echoes <= FLOOD_ECHOES_DROP_MIN*16) return false;
+
+  uint32_t percent = (_echoes - FLOOD_ECHOES_DROP_MIN*16) * 10 / 16;   // 10% per echo above the minimum
+  if (percent > FLOOD_DROP_MAX_PERCENT) percent = FLOOD_DROP_MAX_PERCENT;
+  if (rng->nextInt(0, 100) < percent) {
+    _n_skipped++;
+    return true;
+  }
+  return false;
+}
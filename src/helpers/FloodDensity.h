@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Mesh.h>
+
+#define FLOOD_ECHOES_NOMINAL     2    // echoes per flood packet, at which delays are unscaled
+#define FLOOD_ECHOES_DROP_MIN    4    // echoes per flood packet, above which some re-broadcasts are skipped
+#define FLOOD_DROP_MAX_PERCENT   50
+#define FLOOD_MIN_SAMPLES        8    // new flood packets in update period, to trust the echo count
+
+/**
+ * \brief  Estimates how dense the local mesh is, ie. how many other nodes re-broadcast the same flood packets
+ *     within earshot. Is based on the number of duplicates ('echoes') heard per new flood packet, or, while there
+ *     is too little traffic to measure that, on the number of recently heard neighbours.
+ *     From this, scales the flood retransmit delay window (wider when dense, narrower when sparse) and gives a
+ *     probability of not re-broadcasting at all, in dense meshes where plenty of others will.
+*/
+class FloodDensity {
+  uint32_t _last_recv, _last_dups;
+  uint16_t _echoes;    // smoothed echoes per new flood packet, x16
+  bool _measured;
+  uint32_t _n_skipped;
+
+public:
+  FloodDensity() { _last_recv = _last_dups = 0; _echoes = FLOOD_ECHOES_NOMINAL*16; _measured = false; _n_skipped = 0; }
+
+  /**
+   * \brief  call periodically (eg. every minute)
+   * \param  num_neighbours  number of neighbours heard recently
+   * \param  total_recv  running count of flood packets received (incl. duplicates)
+   * \param  total_dups  running count of duplicate flood packets
+  */
+  void update(int num_neighbours, uint32_t total_recv, uint32_t total_dups);
+
+  uint16_t getEchoes() const { return _echoes; }   // x16
+  uint32_t getNumSkipped() const { return _n_skipped; }
+
+  /**
+   * \returns  the retransmit delay window, scaled for density
+  */
+  uint32_t scaleDelay(uint32_t window) const;
+
+  /**
+   * \returns  true, if this node should not re-broadcast the given flood packet, as others nearby most likely will
+  */
+  bool shouldSkip(const mesh::Packet* packet, mesh::RNG* rng);
+};
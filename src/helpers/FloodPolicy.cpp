@@ -0,0 +1,141 @@
+#include "FloodPolicy.h"
+
+#define FLOOD_POLICY_FILE   "/flood_policy"
+
+static const char* type_names[] = {
+  "req", "resp", "txt", "ack", "advert", "grp.txt", "grp.data", "anon", "path", "trace", "multi", "ctrl"
+};
+#define NUM_TYPE_NAMES   ((int) (sizeof(type_names) / sizeof(type_names[0])))
+
+static File openWrite(FILESYSTEM* _fs, const char* filename) {
+  #if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+    _fs->remove(filename);
+    return _fs->open(filename, FILE_O_WRITE);
+  #elif defined(RP2040_PLATFORM)
+    return _fs->open(filename, "w");
+  #else
+    return _fs->open(filename, "w", true);
+  #endif
+}
+
+bool FloodPolicy::load(FILESYSTEM* _fs) {
+  _num = 0;
+  if (!_fs->exists(FLOOD_POLICY_FILE)) return false;
+
+#if defined(RP2040_PLATFORM)
+  File file = _fs->open(FLOOD_POLICY_FILE, "r");
+#else
+  File file = _fs->open(FLOOD_POLICY_FILE);
+#endif
+  if (!file) return false;
+
+  while (_num < MAX_FLOOD_RULES) {
+    auto r = &_rules[_num];
+    uint8_t pad[3];
+
+    bool success = file.read(&r->payload_type, 1) == 1;
+    success = success && file.read(&r->route_type, 1) == 1;
+    success = success && file.read((uint8_t *) &r->region_id, sizeof(r->region_id)) == sizeof(r->region_id);
+    success = success && file.read(&r->max_hops, 1) == 1;
+    success = success && file.read(pad, sizeof(pad)) == sizeof(pad);   // reserved
+
+    if (!success) break; // EOF
+    _num++;
+  }
+  file.close();
+  return true;
+}
+
+bool FloodPolicy::save(FILESYSTEM* _fs) {
+  File file = openWrite(_fs, FLOOD_POLICY_FILE);
+  if (!file) return false;
+
+  bool success = true;
+  for (int i = 0; i < _num && success; i++) {
+    auto r = &_rules[i];
+    uint8_t pad[3];
+    memset(pad, 0, sizeof(pad));
+
+    success = file.write(&r->payload_type, 1) == 1;
+    success = success && file.write(&r->route_type, 1) == 1;
+    success = success && file.write((uint8_t *) &r->region_id, sizeof(r->region_id)) == sizeof(r->region_id);
+    success = success && file.write(&r->max_hops, 1) == 1;
+    success = success && file.write(pad, sizeof(pad)) == sizeof(pad);
+  }
+  file.close();
+  return success;
+}
+
+FloodRule* FloodPolicy::find(uint8_t payload_type, uint8_t route_type, uint16_t region_id) {
+  for (int i = 0; i < _num; i++) {
+    auto r = &_rules[i];
+    if (r->payload_type == payload_type && r->route_type == route_type && r->region_id == region_id) return r;
+  }
+  return NULL;
+}
+
+bool FloodPolicy::putRule(uint8_t payload_type, uint8_t route_type, uint16_t region_id, uint8_t max_hops) {
+  auto r = find(payload_type, route_type, region_id);
+  if (r == NULL) {
+    if (_num >= MAX_FLOOD_RULES) return false;   // table full
+    r = &_rules[_num++];
+    r->payload_type = payload_type;
+    r->route_type = route_type;
+    r->region_id = region_id;
+  }
+  r->max_hops = max_hops;
+  return true;
+}
+
+bool FloodPolicy::removeRule(uint8_t payload_type, uint8_t route_type, uint16_t region_id) {
+  auto r = find(payload_type, route_type, region_id);
+  if (r == NULL) return false;
+
+  int i = r - _rules;
+  _num--;
+  memmove(&_rules[i], &_rules[i + 1], (_num - i) * sizeof(FloodRule));   // keep in insertion order
+  return true;
+}
+
+void FloodPolicy::removeRegion(uint16_t region_id) {
+  int j = 0;
+  for (int i = 0; i < _num; i++) {
+    if (_rules[i].region_id != region_id) _rules[j++] = _rules[i];
+  }
+  _num = j;
+}
+
+int FloodPolicy::specificity(const FloodRule& r) {
+  // region is most specific, then payload type, then route type
+  return (r.region_id != FLOOD_RULE_ANY_REGION ? 4 : 0) + (r.payload_type != FLOOD_RULE_ANY ? 2 : 0) + (r.route_type != FLOOD_RULE_ANY ? 1 : 0);
+}
+
+uint8_t FloodPolicy::getMaxHops(const mesh::Packet* packet, uint16_t region_id, uint8_t def_hops) const {
+  uint8_t payload_type = packet->getPayloadType();
+  uint8_t route_type = packet->getRouteType();
+
+  const FloodRule* best = NULL;
+  for (int i = 0; i < _num; i++) {
+    auto r = &_rules[i];
+    if (r->payload_type != FLOOD_RULE_ANY && r->payload_type != payload_type) continue;
+    if (r->route_type != FLOOD_RULE_ANY && r->route_type != route_type) continue;
+    if (r->region_id != FLOOD_RULE_ANY_REGION && r->region_id != region_id) continue;
+
+    if (best == NULL || specificity(*r) > specificity(*best)) best = r;   // first of equal specificity wins
+  }
+  return best ? best->max_hops : def_hops;
+}
+
+const char* FloodPolicy::getTypeName(uint8_t payload_type) {
+  if (payload_type == FLOOD_RULE_ANY) return "*";
+  if (payload_type < NUM_TYPE_NAMES) return type_names[payload_type];
+  return "?";
+}
+
+int FloodPolicy::parseTypeName(const char* name) {
+  if (strcmp(name, "*") == 0) return FLOOD_RULE_ANY;
+  for (int i = 0; i < NUM_TYPE_NAMES; i++) {
+    if (strcmp(name, type_names[i]) == 0) return i;
+  }
+  return -1;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>   // needed for PlatformIO
+#include <Packet.h>
+#include <helpers/IdentityStore.h>
+
+#ifndef MAX_FLOOD_RULES
+  #define MAX_FLOOD_RULES   8
+#endif
+
+#define FLOOD_RULE_ANY         0xFF     // for payload_type, route_type
+#define FLOOD_RULE_ANY_REGION  0xFFFF
+
+struct FloodRule {
+  uint8_t payload_type;   // PAYLOAD_TYPE_*, or FLOOD_RULE_ANY
+  uint8_t route_type;     // ROUTE_TYPE_FLOOD or ROUTE_TYPE_TRANSPORT_FLOOD, or FLOOD_RULE_ANY
+  uint16_t region_id;     // RegionEntry::id, or FLOOD_RULE_ANY_REGION
+  uint8_t max_hops;       // flood packets which have already taken this many hops aren't forwarded
+};
+
+/**
+ * \brief  Table of per payload type/route type/region hop limits for forwarding flood packets, so that eg. adverts
+ *     can be kept more local than TXT floods. Where several rules match a packet, the most specific one applies.
+*/
+class FloodPolicy {
+  FloodRule _rules[MAX_FLOOD_RULES];
+  int _num;
+
+  static int specificity(const FloodRule& r);
+  FloodRule* find(uint8_t payload_type, uint8_t route_type, uint16_t region_id);
+
+public:
+  FloodPolicy() { _num = 0; }
+
+  bool load(FILESYSTEM* _fs);
+  bool save(FILESYSTEM* _fs);
+
+  /**
+   * \brief  add rule, or replace the max_hops of an existing rule with same keys
+   * \returns  false if table is full
+  */
+  bool putRule(uint8_t payload_type, uint8_t route_type, uint16_t region_id, uint8_t max_hops);
+  bool removeRule(uint8_t payload_type, uint8_t route_type, uint16_t region_id);
+  void removeRegion(uint16_t region_id);
+  void clear() { _num = 0; }
+
+  int getCount() const { return _num; }
+  const FloodRule& getRule(int i) const { return _rules[i]; }
+
+  /**
+   * \param  region_id  the region the packet was matched to (RegionMap::findMatch())
+   * \returns  max hops, from the most specific matching rule, else 'def_hops'
+  */
+  uint8_t getMaxHops(const mesh::Packet* packet, uint16_t region_id, uint8_t def_hops) const;
+
+  static const char* getTypeName(uint8_t payload_type);
+  static int parseTypeName(const char* name);   // returns -1 if not recognised
+};
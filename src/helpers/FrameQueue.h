@@ -0,0 +1,65 @@
+#pragma once
+
+#include "BaseSerialInterface.h"
+#include <string.h>
+
+/**
+ * \brief  FIFO of variable length frames, packed as [len][bytes] into a ring of BUF_SIZE bytes, so short frames
+ *     (ACKs, PUSH_CODE_*) don't each take a full MAX_FRAME_SIZE slot. Frames are never split across the end of the
+ *     ring, so front() can be handed straight to the transport without first copying out.
+*/
+template <int BUF_SIZE>
+class FrameQueue {
+  uint8_t _buf[BUF_SIZE];
+  int _head, _tail;   // read, write positions
+  int _count;
+
+public:
+  FrameQueue() { clear(); }
+
+  void clear() { _head = _tail = _count = 0; }
+  int count() const { return _count; }
+  bool isEmpty() const { return _count == 0; }
+
+  /**
+   * \returns  false if not enough room (frame is dropped)
+  */
+  bool push(const uint8_t* src, size_t len) {
+    if (len == 0 || len > MAX_FRAME_SIZE) return false;
+    if (_count == 0) _head = _tail = 0;   // empty, so can start from the top again
+
+    int need = len + 1;
+    int t = _tail;
+    if (t > _head || _count == 0) {
+      if (t + need > BUF_SIZE) {   // no room at end, so wrap around
+        if (need > _head) return false;
+        if (t < BUF_SIZE) _buf[t] = 0;   // marker: skip to start
+        t = 0;
+      }
+    } else if (t + need > _head) {
+      return false;   // full
+    }
+    _buf[t] = len;
+    memcpy(&_buf[t + 1], src, len);
+    _tail = t + need;
+    _count++;
+    return true;
+  }
+
+  /**
+   * \returns  the oldest frame, or NULL if empty. Stays valid until pop().
+  */
+  const uint8_t* front(size_t& len) const {
+    if (_count == 0) return NULL;
+    len = _buf[_head];
+    return &_buf[_head + 1];
+  }
+
+  void pop() {
+    if (_count == 0) return;
+    int h = _head + _buf[_head] + 1;
+    if (h >= BUF_SIZE || _buf[h] == 0) h = 0;   // wrapped (only read if another frame is queued)
+    _head = h;
+    _count--;
+  }
+};
@@ -58,6 +58,7 @@ bool IdentityStore::save(const char *name, const mesh::LocalIdentity& id) {
     bool success = id.writeTo(file);
     file.close();
     MESH_DEBUG_PRINTLN("IdentityStore::save() write - %s", success ? "OK" : "Err");
+    (void) success;   // (only logged)
     return true;
   }
   MESH_DEBUG_PRINTLN("IdentityStore::save() failed");
@@ -82,7 +83,7 @@ bool IdentityStore::save(const char *name, const mesh::LocalIdentity& id, const
     uint8_t tmp[32];
     memset(tmp, 0, sizeof(tmp));
     int n = strlen(display_name);
-    if (n > sizeof(tmp)-1) n = sizeof(tmp)-1;
+    if (n > (int) sizeof(tmp)-1) n = sizeof(tmp)-1;
     memcpy(tmp, display_name, n);
     file.write(tmp, sizeof(tmp));
 
@@ -8,6 +8,9 @@
   #define FILESYSTEM  Adafruit_LittleFS
 
   using namespace Adafruit_LittleFS_Namespace;
+#elif defined(NATIVE_PLATFORM)
+  #include <helpers/native/NativeFS.h>
+  #define FILESYSTEM  NativeFS
 #endif
 #include <Identity.h>
 
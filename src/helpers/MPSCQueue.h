@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * \brief  Lock-free, bounded FIFO from any number of producers (tasks, ISRs, other cores) to exactly one consumer.
+ *     Each slot has a sequence number: a producer claims a slot by CAS on the write count, fills it, then publishes
+ *     it by bumping its sequence. The consumer only reads slots whose sequence says they are complete, so never blocks.
+ *  NOTE: N must be a power of 2. A producer pre-empted between claim and publish holds back later items until it resumes.
+*/
+template <class T, int N>
+class MPSCQueue {
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    T item;
+  };
+  Slot _slots[N];
+  std::atomic<uint32_t> _tail;   // write count (producers)
+  uint32_t _head;                // read count (consumer only)
+  std::atomic<uint32_t> _dropped;
+
+public:
+  MPSCQueue() : _tail(0), _head(0), _dropped(0) {
+    for (uint32_t i = 0; i < N; i++) _slots[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  /** \returns  false if full (item is dropped) */
+  bool push(const T& item) {
+    uint32_t t = _tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& s = _slots[t % N];
+      int32_t diff = (int32_t)(s.seq.load(std::memory_order_acquire) - t);
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) break;   // claimed (else 't' is reloaded)
+      } else if (diff < 0) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;   // slot not yet consumed from last time round, ie. full
+      } else {
+        t = _tail.load(std::memory_order_relaxed);   // another producer got there first
+      }
+    }
+    Slot& s = _slots[t % N];
+    s.item = item;
+    s.seq.store(t + 1, std::memory_order_release);   // publish only once item is complete
+    return true;
+  }
+
+  bool pop(T& item) {
+    Slot& s = _slots[_head % N];
+    if ((int32_t)(s.seq.load(std::memory_order_acquire) - (_head + 1)) < 0) return false;   // empty (or not yet published)
+    item = s.item;
+    s.seq.store(_head + N, std::memory_order_release);   // slot can now be re-used, next time round
+    _head++;
+    return true;
+  }
+
+  uint32_t getNumDropped() const { return _dropped.load(std::memory_order_relaxed); }
+};
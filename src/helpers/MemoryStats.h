@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+#include <MeshCore.h>
+
+#ifndef RAM_TABLES_BUDGET
+  #define RAM_TABLES_BUDGET   0    // max bytes for an app's static tables (see MemTable), checked at build time. 0 = no check
+#endif
+
+/**
+ * \brief  the RAM taken by one of an app's fixed size tables (eg. contacts[MAX_CONTACTS]), for the build time
+ *     budget check (RAM_TABLES_BUDGET) and the memory stats
+*/
+struct MemTable {
+  const char* name;
+  uint32_t bytes;
+};
+
+constexpr uint32_t memTablesTotal(const MemTable* tables, int num) {
+  return num == 0 ? 0 : tables[0].bytes + memTablesTotal(tables + 1, num - 1);
+}
+
+#define MEM_STACK_LOOP     0    // the Arduino loop()
+#define MEM_STACK_MESH     1    // MeshTask (MESH_TASK_CORE builds)
+#define MEM_STACK_WRITER   2    // FlashWriter's task
+#define MEM_STACK_NUM      3
+
+/**
+ * \brief  heap and stack headroom, at runtime. Fields the platform can't tell are zero.
+*/
+struct MemoryStats {
+  uint32_t free_heap;
+  uint32_t min_free_heap;   // low-water mark, since boot
+  uint32_t max_alloc;       // largest block which can be allocated now
+  uint32_t stack_free[MEM_STACK_NUM];   // high-water marks, ie. bytes of stack never used (zero if no such task)
+
+  void read() {
+    memset(this, 0, sizeof(*this));
+  #if defined(ESP32)
+    free_heap = ESP.getFreeHeap();
+    min_free_heap = ESP.getMinFreeHeap();
+    max_alloc = ESP.getMaxAllocHeap();
+    stack_free[MEM_STACK_LOOP] = getStackFree(xTaskGetHandle("loopTask"));
+    stack_free[MEM_STACK_MESH] = getStackFree(xTaskGetHandle("mesh"));
+    stack_free[MEM_STACK_WRITER] = getStackFree(xTaskGetHandle("flash_wr"));
+  #elif defined(NRF52_PLATFORM)
+    free_heap = max_alloc = dbgHeapTotal() - dbgHeapUsed();   // (heap only grows up, so is all one block)
+    stack_free[MEM_STACK_LOOP] = uxTaskGetStackHighWaterMark(NULL) * 4;   // in words. (the mesh runs in loop())
+  #elif defined(RP2040_PLATFORM)
+    free_heap = max_alloc = rp2040.getFreeHeap();
+  #endif
+  }
+
+#if defined(ESP32)
+  static uint32_t getStackFree(TaskHandle_t task) {
+    return task ? uxTaskGetStackHighWaterMark(task) : 0;   // (in bytes, on ESP-IDF)
+  }
+#endif
+
+  static void debugPrint(const MemTable tables[], int num) {
+    for (int i = 0; i < num; i++) {
+      MESH_DEBUG_PRINTLN("RAM: %s = %u bytes", tables[i].name, tables[i].bytes);
+    }
+    MESH_DEBUG_PRINTLN("RAM: tables total = %u bytes", memTablesTotal(tables, num));
+  }
+};
@@ -58,6 +58,11 @@ public:
     esp_deep_sleep_start();   // CPU halts here and never returns!
   }
 
+  bool enterRxSleep(uint32_t secs) override {
+    enterDeepSleep(secs);   // radio stays in Rx, and wakes us on DIO1
+    return true;
+  }
+
   void powerOff() override {
     // TODO: re-enable this when there is a definite wake-up source pin:
     //  enterDeepSleep(0);
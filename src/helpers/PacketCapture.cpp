@@ -0,0 +1,112 @@
+#include "PacketCapture.h"
+#include <Utils.h>
+
+#define PCAP_MAGIC            0xA1B2C3D4
+#define LINKTYPE_LORATAP      270
+#define LORATAP_HDR_LEN       15
+#define LORA_SYNC_WORD        0x12    // RADIOLIB_SX126X_SYNC_WORD_PRIVATE
+
+static void printHexLine(Stream& out, const uint8_t* src, int len) {
+  while (len > 0) {
+    int n = len < 32 ? len : 32;   // keep lines short, for serial consoles
+    mesh::Utils::printHex(out, src, n);
+    out.println();
+    src += n; len -= n;
+  }
+}
+
+void PacketCapture::add(float snr, float rssi, const uint8_t raw[], int len, uint32_t timestamp, unsigned long now_millis) {
+  if (!_enabled || len <= 0) return;
+
+  uint8_t route = raw[0] & PH_ROUTE_MASK;
+  uint8_t type = (raw[0] >> PH_TYPE_SHIFT) & PH_TYPE_MASK;
+  if ((_route_mask & (1 << route)) == 0 || (_type_mask & (1 << type)) == 0) return;   // filtered out
+
+  auto f = &_frames[_next];
+  _next = (_next + 1) % PACKET_CAPTURE_SLOTS;
+  if (_count < PACKET_CAPTURE_SLOTS) _count++;
+  _seen++;
+
+  if (!_has_base) {
+    _base_time = timestamp;
+    _base_millis = now_millis;
+    _has_base = true;
+  }
+  unsigned long elapsed = now_millis - _base_millis;   // (RTC may be set mid-capture, so don't use it after the first)
+  f->timestamp = _base_time + elapsed / 1000;
+  f->millis = elapsed % 1000;
+  f->snr = (int8_t) (snr * 4);
+  f->rssi = (int16_t) rssi;
+  f->orig_len = len;
+  f->len = len < PACKET_CAPTURE_SNAPLEN ? len : PACKET_CAPTURE_SNAPLEN;
+  memcpy(f->data, raw, f->len);
+
+  if (_stream) {
+    uint8_t buf[16 + LORATAP_HDR_LEN + PACKET_CAPTURE_SNAPLEN];
+    printHexLine(*_stream, buf, writePcapRecord(buf, *f, _freq, _bw, _sf));
+  }
+}
+
+void PacketCapture::setStream(Stream* out, float freq, float bw, uint8_t sf) {
+  _stream = out;
+  _freq = freq; _bw = bw; _sf = sf;
+  if (out) {
+    uint8_t buf[24];
+    printHexLine(*out, buf, writePcapHeader(buf));
+  }
+}
+
+const CapturedFrame& PacketCapture::getFrame(int i) const {
+  return _frames[(_next - _count + i + PACKET_CAPTURE_SLOTS) % PACKET_CAPTURE_SLOTS];
+}
+
+static void putLE32(uint8_t* dest, uint32_t v) { memcpy(dest, &v, 4); }   // pcap is in host (little endian) order
+static void putLE16(uint8_t* dest, uint16_t v) { memcpy(dest, &v, 2); }
+
+int PacketCapture::writePcapHeader(uint8_t* dest) {
+  putLE32(&dest[0], PCAP_MAGIC);
+  putLE16(&dest[4], 2);   // version 2.4
+  putLE16(&dest[6], 4);
+  putLE32(&dest[8], 0);   // thiszone
+  putLE32(&dest[12], 0);  // sigfigs
+  putLE32(&dest[16], PACKET_CAPTURE_SNAPLEN + LORATAP_HDR_LEN);
+  putLE32(&dest[20], LINKTYPE_LORATAP);
+  return 24;
+}
+
+int PacketCapture::writePcapRecord(uint8_t* dest, const CapturedFrame& f, float freq, float bw, uint8_t sf) {
+  putLE32(&dest[0], f.timestamp);
+  putLE32(&dest[4], f.millis * 1000);   // usecs
+  putLE32(&dest[8], LORATAP_HDR_LEN + f.len);
+  putLE32(&dest[12], LORATAP_HDR_LEN + f.orig_len);
+
+  // LoRaTap v0 header (fields are big endian)
+  uint8_t* h = &dest[16];
+  uint32_t hz = (uint32_t) (freq * 1000000.0f);
+  int rssi = f.rssi + 139;   // LoRaTap RSSI is -139 + value
+  if (rssi < 0) rssi = 0; else if (rssi > 255) rssi = 255;
+  h[0] = 0;    // version
+  h[1] = 0;    // padding
+  h[2] = 0; h[3] = LORATAP_HDR_LEN;
+  h[4] = hz >> 24; h[5] = hz >> 16; h[6] = hz >> 8; h[7] = hz;
+  h[8] = (uint8_t) (bw / 125.0f);   // in 125kHz units
+  h[9] = sf;
+  h[10] = rssi;   // packet_rssi
+  h[11] = 0xFF;   // max_rssi (n/a)
+  h[12] = 0xFF;   // current_rssi (n/a)
+  h[13] = (uint8_t) f.snr;   // 0.25 dB units
+  h[14] = LORA_SYNC_WORD;
+
+  memcpy(&dest[16 + LORATAP_HDR_LEN], f.data, f.len);
+  return 16 + LORATAP_HDR_LEN + f.len;
+}
+
+void PacketCapture::exportHex(Stream& out, float freq, float bw, uint8_t sf) const {
+  uint8_t buf[16 + LORATAP_HDR_LEN + PACKET_CAPTURE_SNAPLEN];
+  int len = writePcapHeader(buf);
+  printHexLine(out, buf, len);
+  for (int i = 0; i < _count; i++) {
+    len = writePcapRecord(buf, getFrame(i), freq, bw, sf);
+    printHexLine(out, buf, len);
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>   // needed for PlatformIO
+#include <Packet.h>
+
+#ifndef PACKET_CAPTURE_SLOTS
+  #define PACKET_CAPTURE_SLOTS    8
+#endif
+#ifndef PACKET_CAPTURE_SNAPLEN
+  #define PACKET_CAPTURE_SNAPLEN  MAX_TRANS_UNIT   // bytes captured of each frame
+#endif
+
+#define PACKET_CAPTURE_ALL_TYPES    0xFFFF
+#define PACKET_CAPTURE_ALL_ROUTES   0x0F
+
+struct CapturedFrame {
+  uint32_t timestamp;    // by our RTC clock, at first frame captured, then advanced by millis() (so never goes backwards)
+  uint16_t millis;       // 0..999, sub-second part
+  int8_t snr;            // x4
+  int16_t rssi;
+  uint8_t orig_len;
+  uint8_t len;           // bytes captured
+  uint8_t data[PACKET_CAPTURE_SNAPLEN];
+};
+
+/**
+ * \brief  Fixed RAM ring of the last PACKET_CAPTURE_SLOTS raw frames received, for diagnosing remote nodes without a
+ *     logging build. Frames can be filtered by payload type and route type, and are exported as a pcap file with
+ *     the LoRaTap link-type, so can be opened directly in Wireshark.
+*/
+class PacketCapture {
+  CapturedFrame _frames[PACKET_CAPTURE_SLOTS];
+  int _next, _count;
+  uint32_t _seen;
+  uint16_t _type_mask;   // bit per PAYLOAD_TYPE_*
+  uint8_t _route_mask;   // bit per ROUTE_TYPE_*
+  bool _enabled;
+  bool _has_base;
+  uint32_t _base_time;   // RTC time, and millis(), of first frame since enabled/cleared
+  unsigned long _base_millis;
+  Stream* _stream;
+  float _freq, _bw;
+  uint8_t _sf;
+
+public:
+  PacketCapture() {
+    _next = _count = 0; _seen = 0; _enabled = _has_base = false; _stream = NULL;
+    _type_mask = PACKET_CAPTURE_ALL_TYPES; _route_mask = PACKET_CAPTURE_ALL_ROUTES;
+  }
+
+  void setEnabled(bool enable) { if (enable && !_enabled) _has_base = false; _enabled = enable; }
+  bool isEnabled() const { return _enabled; }
+  void setFilter(uint16_t type_mask, uint8_t route_mask) { _type_mask = type_mask; _route_mask = route_mask; }
+  uint16_t getTypeMask() const { return _type_mask; }
+  uint8_t getRouteMask() const { return _route_mask; }
+  void clear() { _next = _count = 0; _seen = 0; _has_base = false; }
+
+  /**
+   * \brief  also writes each frame captured to 'out', as it arrives, as a hex encoded pcap (header written now).
+   *     For recording traffic for longer than the ring holds, eg. for replay by native_replay. NULL to stop.
+  */
+  void setStream(Stream* out, float freq, float bw, uint8_t sf);
+  bool isStreaming() const { return _stream != NULL; }
+
+  /**
+   * \brief  call from Dispatcher::logRxRaw() hook
+  */
+  void add(float snr, float rssi, const uint8_t raw[], int len, uint32_t timestamp, unsigned long now_millis);
+
+  int getCount() const { return _count; }
+  uint32_t getNumSeen() const { return _seen; }   // frames matching filter, including those since overwritten
+  const CapturedFrame& getFrame(int i) const;   // 0 is oldest
+
+  /**
+   * \returns  length of pcap global header written to dest (24 bytes)
+  */
+  static int writePcapHeader(uint8_t* dest);
+  /**
+   * \param  dest  must be at least 16 + 15 + PACKET_CAPTURE_SNAPLEN
+   * \returns  length of pcap record (with LoRaTap header) written to dest
+  */
+  static int writePcapRecord(uint8_t* dest, const CapturedFrame& f, float freq, float bw, uint8_t sf);
+
+  /**
+   * \brief  writes whole capture as pcap file, hex encoded (so is safe on a text console, decode with 'xxd -r -p')
+  */
+  void exportHex(Stream& out, float freq, float bw, uint8_t sf) const;
+};
@@ -0,0 +1,156 @@
+#include "PacketLog.h"
+#include <RTClib.h>
+
+#define PACKET_LOG_BIN_FILE   "/packet_log.bin"
+#define PACKET_LOG_HDR_SIZE   4    // uint32_t next index
+
+static File openReadWrite(FILESYSTEM* fs, const char* filename) {   // for updating in place
+#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+  return fs->open(filename, FILE_O_WRITE);
+#elif defined(RP2040_PLATFORM)
+  return fs->open(filename, fs->exists(filename) ? "r+" : "w+");
+#else
+  return fs->open(filename, fs->exists(filename) ? "r+" : "w+", true);
+#endif
+}
+
+static File openRead(FILESYSTEM* fs, const char* filename) {
+#if defined(RP2040_PLATFORM)
+  return fs->open(filename, "r");
+#else
+  return fs->open(filename);
+#endif
+}
+
+void PacketLog::begin(FILESYSTEM* fs) {
+  _fs = fs;
+  _num_buf = 0;
+  _next = 0;
+
+  File f = openRead(_fs, PACKET_LOG_BIN_FILE);
+  if (f) {
+    if (f.read((uint8_t *) &_next, sizeof(_next)) != sizeof(_next) || _next >= PACKET_LOG_MAX_RECS) {
+      _next = 0;  // corrupt, start again
+    }
+    f.close();
+  }
+}
+
+PacketLogRecord* PacketLog::addRecord(uint8_t kind, const mesh::Packet* pkt, int len, uint32_t now) {
+  if (_num_buf >= PACKET_LOG_BUF_RECS) {
+    _dropped++;   // loop() hasn't had a chance to flush
+    return NULL;
+  }
+  auto r = &_buf[_num_buf++];
+  memset(r, 0, sizeof(*r));
+  r->timestamp = now;
+  r->kind = kind;
+  r->header = pkt->header;
+  r->len = len;
+  r->payload_len = pkt->payload_len;
+
+  uint8_t type = pkt->getPayloadType();
+  if (type == PAYLOAD_TYPE_PATH || type == PAYLOAD_TYPE_REQ || type == PAYLOAD_TYPE_RESPONSE || type == PAYLOAD_TYPE_TXT_MSG) {
+    r->has_hashes = 1;
+    r->dest_hash = pkt->payload[0];
+    r->src_hash = pkt->payload[pkt->getDatagramHashSize()];   // (first byte of)
+  }
+  return r;
+}
+
+void PacketLog::logRx(const mesh::Packet* pkt, int len, float snr, float rssi, float score, uint32_t now) {
+  auto r = addRecord(PACKET_LOG_RX, pkt, len, now);
+  if (r) {
+    r->snr = (int8_t) snr;
+    r->rssi = (int16_t) rssi;
+    r->score = (uint16_t) (score * 1000);
+  }
+}
+
+void PacketLog::logTx(const mesh::Packet* pkt, int len, uint32_t now) {
+  addRecord(PACKET_LOG_TX, pkt, len, now);
+}
+
+void PacketLog::logTxFail(const mesh::Packet* pkt, int len, uint32_t now) {
+  addRecord(PACKET_LOG_TX_FAIL, pkt, len, now);
+}
+
+void PacketLog::loop(unsigned long now_millis) {
+  if (_num_buf == 0) {
+    _next_flush = now_millis + PACKET_LOG_FLUSH_SECS*1000;   // timer starts from first buffered record
+  } else if (_num_buf >= PACKET_LOG_BUF_RECS/2 || (long)(now_millis - _next_flush) >= 0) {
+    flush();
+  }
+}
+
+bool PacketLog::flush() {
+  if (_num_buf == 0) return true;
+
+  File f = openReadWrite(_fs, PACKET_LOG_BIN_FILE);
+  if (!f) {
+    _num_buf = 0;   // discard, rather than retry on every loop()
+    return false;
+  }
+  uint32_t new_next = (_next + _num_buf) % PACKET_LOG_MAX_RECS;
+  f.seek(0);   // header first, so file is never shorter than records being seeked to
+  bool success = f.write((uint8_t *) &new_next, sizeof(new_next)) == sizeof(new_next);
+  int i = 0;
+  while (success && i < _num_buf) {
+    int n = _num_buf - i;    // write as one block, up to end of ring
+    if (n > PACKET_LOG_MAX_RECS - _next) n = PACKET_LOG_MAX_RECS - _next;
+
+    f.seek(PACKET_LOG_HDR_SIZE + _next * sizeof(PacketLogRecord));
+    size_t sz = n * sizeof(PacketLogRecord);
+    success = f.write((uint8_t *) &_buf[i], sz) == sz;
+    i += n;
+    _next = (_next + n) % PACKET_LOG_MAX_RECS;
+  }
+  f.close();
+
+  _num_buf = 0;
+  return success;
+}
+
+void PacketLog::erase() {
+  _num_buf = 0;
+  _next = 0;
+  _fs->remove(PACKET_LOG_BIN_FILE);
+}
+
+static void printRecord(Stream& out, const PacketLogRecord& r) {
+  DateTime dt = DateTime(r.timestamp);
+  out.printf("%02d:%02d:%02d - %d/%d/%d U", dt.hour(), dt.minute(), dt.second(), dt.day(), dt.month(), dt.year());
+
+  const char* route = (r.header & PH_ROUTE_MASK) == ROUTE_TYPE_DIRECT || (r.header & PH_ROUTE_MASK) == ROUTE_TYPE_TRANSPORT_DIRECT ? "D" : "F";
+  int type = (r.header >> PH_TYPE_SHIFT) & PH_TYPE_MASK;
+  const char* kind = r.kind == PACKET_LOG_RX ? "RX" : (r.kind == PACKET_LOG_TX ? "TX" : "TX FAIL!");
+  out.printf(": %s, len=%d (type=%d, route=%s, payload_len=%d)", kind, (int)r.len, type, route, (int)r.payload_len);
+  if (r.kind == PACKET_LOG_RX) {
+    out.printf(" SNR=%d RSSI=%d score=%d", (int)r.snr, (int)r.rssi, (int)r.score);
+  }
+  if (r.has_hashes && r.kind != PACKET_LOG_TX_FAIL) {
+    out.printf(" [%02X -> %02X]\n", (uint32_t)r.src_hash, (uint32_t)r.dest_hash);
+  } else {
+    out.printf("\n");
+  }
+}
+
+void PacketLog::dump(Stream& out) {
+  flush();
+
+  File f = openRead(_fs, PACKET_LOG_BIN_FILE);
+  if (!f) return;
+
+  uint32_t num = f.size() > PACKET_LOG_HDR_SIZE ? (f.size() - PACKET_LOG_HDR_SIZE) / sizeof(PacketLogRecord) : 0;
+  if (num > PACKET_LOG_MAX_RECS) num = PACKET_LOG_MAX_RECS;
+  uint32_t start = num < PACKET_LOG_MAX_RECS ? 0 : _next;   // once ring has wrapped, oldest is at _next
+  for (uint32_t i = 0; i < num; i++) {
+    PacketLogRecord r;
+    f.seek(PACKET_LOG_HDR_SIZE + ((start + i) % num) * sizeof(r));
+    if (f.read((uint8_t *) &r, sizeof(r)) != sizeof(r)) break;
+    printRecord(out, r);
+  }
+  f.close();
+
+  if (_dropped > 0) out.printf("(%u records dropped)\n", _dropped);
+}
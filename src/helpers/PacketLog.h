@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>   // needed for PlatformIO
+#include <Packet.h>
+#include <helpers/IdentityStore.h>
+
+#ifndef PACKET_LOG_MAX_RECS
+  #define PACKET_LOG_MAX_RECS    512    // file is a ring of this many records (16 bytes each)
+#endif
+#ifndef PACKET_LOG_BUF_RECS
+  #define PACKET_LOG_BUF_RECS    16     // records held in RAM, before being written out in one block
+#endif
+#ifndef PACKET_LOG_FLUSH_SECS
+  #define PACKET_LOG_FLUSH_SECS  30
+#endif
+
+#define PACKET_LOG_RX        1
+#define PACKET_LOG_TX        2
+#define PACKET_LOG_TX_FAIL   3
+
+struct PacketLogRecord {
+  uint32_t timestamp;     // by our RTC clock
+  uint8_t kind;           // PACKET_LOG_*
+  uint8_t header;         // Packet::header (route and payload type)
+  uint8_t len;            // raw length
+  uint8_t payload_len;
+  int8_t snr;             // RX only
+  uint8_t src_hash, dest_hash;   // if has_hashes
+  uint8_t has_hashes;
+  int16_t rssi;           // RX only
+  uint16_t score;         // RX only, x1000
+};
+
+/**
+ * \brief  Log of packets sent and received, as fixed-size binary records. These are buffered in RAM and written out in
+ *     blocks from loop(), so the RX/TX paths only do a memcpy. The file is a ring of PACKET_LOG_MAX_RECS, so the oldest
+ *     records get overwritten, and is decoded to the same text lines as before by dump().
+*/
+class PacketLog {
+  FILESYSTEM* _fs;
+  PacketLogRecord _buf[PACKET_LOG_BUF_RECS];
+  int _num_buf;
+  uint32_t _next;     // index of next record to write, in file (which is a ring)
+  uint32_t _dropped;  // records lost because _buf was full
+  unsigned long _next_flush;
+
+  PacketLogRecord* addRecord(uint8_t kind, const mesh::Packet* pkt, int len, uint32_t now);
+
+public:
+  PacketLog() { _fs = NULL; _num_buf = 0; _next = 0; _dropped = 0; _next_flush = 0; }
+
+  void begin(FILESYSTEM* fs);
+
+  void logRx(const mesh::Packet* pkt, int len, float snr, float rssi, float score, uint32_t now);
+  void logTx(const mesh::Packet* pkt, int len, uint32_t now);
+  void logTxFail(const mesh::Packet* pkt, int len, uint32_t now);
+
+  /**
+   * \brief  call from main loop(), writes out the buffered records every PACKET_LOG_FLUSH_SECS, or when buffer half full
+  */
+  void loop(unsigned long now_millis);
+  bool flush();
+  void erase();
+
+  /**
+   * \brief  prints the log as text, oldest first (flushes first)
+  */
+  void dump(Stream& out);
+
+  uint32_t getNumDropped() const { return _dropped; }
+};
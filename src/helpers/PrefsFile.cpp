@@ -0,0 +1,119 @@
+#include <Arduino.h>
+#include "PrefsFile.h"
+#include "FlashWriter.h"
+
+#define PREFS_MAGIC_0      'P'
+#define PREFS_MAGIC_1      'F'
+#define PREFS_HDR_SIZE     16    // magic(2), version(1), reserved(1), len(2), reserved(2), seq(4), crc(4)
+#define PREFS_CRC_OFFSET   12    // crc covers the header up to here, then the blob
+
+static const uint32_t crc32_nibble_table[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t PrefsFile::crc32(const uint8_t* data, int len, uint32_t crc) {
+  crc = ~crc;
+  for (int i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+    crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+PrefsFile::PrefsFile(const char* base) {
+  snprintf(_names[0], sizeof(_names[0]), "%s.a", base);
+  snprintf(_names[1], sizeof(_names[1]), "%s.b", base);
+  _seq = 0;
+  _slot = -1;
+}
+
+int PrefsFile::readSlot(FILESYSTEM* fs, int slot, uint8_t* dest, int max_len, uint8_t& version, uint32_t& seq) {
+  if (!fs->exists(_names[slot])) return -1;
+
+#if defined(RP2040_PLATFORM)
+  File file = fs->open(_names[slot], "r");
+#else
+  File file = fs->open(_names[slot]);
+#endif
+  if (!file) return -1;
+
+  uint8_t buf[PREFS_HDR_SIZE + PREFS_FILE_MAX_BLOB];
+  int n = file.read(buf, sizeof(buf));
+  file.close();
+
+  if (n < PREFS_HDR_SIZE || buf[0] != PREFS_MAGIC_0 || buf[1] != PREFS_MAGIC_1) {
+    MESH_DEBUG_PRINTLN("PrefsFile: %s not valid", _names[slot]);
+    return -1;
+  }
+  int len = buf[4] | (buf[5] << 8);
+  uint32_t crc;
+  memcpy(&crc, &buf[PREFS_CRC_OFFSET], 4);
+  if (len > PREFS_FILE_MAX_BLOB || n < PREFS_HDR_SIZE + len
+      || crc32(&buf[PREFS_HDR_SIZE], len, crc32(buf, PREFS_CRC_OFFSET)) != crc) {
+    MESH_DEBUG_PRINTLN("PrefsFile: %s truncated or bad CRC", _names[slot]);
+    return -1;
+  }
+
+  version = buf[2];
+  memcpy(&seq, &buf[8], 4);
+  if (len > max_len) len = max_len;   // newer firmware's fields, which this one doesn't know
+  memcpy(dest, &buf[PREFS_HDR_SIZE], len);
+  return len;
+}
+
+int PrefsFile::load(FILESYSTEM* fs, uint8_t* blob, int max_len, uint8_t& version) {
+  uint8_t tmp[PREFS_FILE_MAX_BLOB];
+  uint8_t ver_a, ver_b;
+  uint32_t seq_a, seq_b;
+  if (max_len > PREFS_FILE_MAX_BLOB) max_len = PREFS_FILE_MAX_BLOB;
+
+  int len_a = readSlot(fs, 0, blob, max_len, ver_a, seq_a);
+  int len_b = readSlot(fs, 1, tmp, max_len, ver_b, seq_b);
+
+  if (len_b >= 0 && (len_a < 0 || (int32_t)(seq_b - seq_a) > 0)) {
+    memcpy(blob, tmp, len_b);
+    version = ver_b;
+    _seq = seq_b;
+    _slot = 1;
+    return len_b;
+  }
+  if (len_a >= 0) {
+    version = ver_a;
+    _seq = seq_a;
+    _slot = 0;
+  }
+  return len_a;
+}
+
+bool PrefsFile::save(FILESYSTEM* fs, const uint8_t* blob, int len, uint8_t version) {
+  if (len > PREFS_FILE_MAX_BLOB) {
+    MESH_DEBUG_PRINTLN("PrefsFile::save() blob too big: %d", len);
+    return false;
+  }
+
+  uint8_t buf[PREFS_HDR_SIZE + PREFS_FILE_MAX_BLOB];
+  uint32_t seq = _seq + 1;
+  buf[0] = PREFS_MAGIC_0;
+  buf[1] = PREFS_MAGIC_1;
+  buf[2] = version;
+  buf[3] = 0;
+  buf[4] = len & 0xFF;
+  buf[5] = len >> 8;
+  buf[6] = buf[7] = 0;
+  memcpy(&buf[8], &seq, 4);
+  memcpy(&buf[PREFS_HDR_SIZE], blob, len);
+  uint32_t crc = crc32(&buf[PREFS_HDR_SIZE], len, crc32(buf, PREFS_CRC_OFFSET));
+  memcpy(&buf[PREFS_CRC_OFFSET], &crc, 4);
+
+  int slot = _slot == 0 ? 1 : 0;   // never overwrite the current copy
+  if (!flash_writer.write(fs, _names[slot], buf, PREFS_HDR_SIZE + len)) {   // (queued, normally)
+    MESH_DEBUG_PRINTLN("PrefsFile::save() write failed: %s", _names[slot]);
+    return false;
+  }
+
+  _seq = seq;
+  _slot = slot;
+  return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <helpers/IdentityStore.h>   // for FILESYSTEM
+
+#ifndef PREFS_FILE_MAX_BLOB
+  #define PREFS_FILE_MAX_BLOB   256
+#endif
+
+/**
+ * \brief  Stores a prefs blob as one record: header (magic, layout version, length, sequence number, CRC-32) plus the
+ *     blob, read and written with a single I/O each. Alternates between two files ("<base>.a" and "<base>.b"), always
+ *     writing the one not loaded from, so a save cut short by a reset or power loss leaves the previous copy intact.
+ *     Loading takes whichever copy is valid and newer.
+ *     Saves go through the FlashWriter queue (so a load straight after one needs a flash_writer.flush() first).
+ *  NOTE: new fields are to be appended to the blob, with the loader only taking the fields within the loaded length
+ *     (older copies keep their defaults). The version is for layout changes which aren't just appending.
+*/
+class PrefsFile {
+  char _names[2][32];
+  uint32_t _seq;
+  int _slot;   // slot last loaded/saved, or -1
+
+  int readSlot(FILESYSTEM* fs, int slot, uint8_t* dest, int max_len, uint8_t& version, uint32_t& seq);
+
+public:
+  PrefsFile(const char* base);
+
+  /**
+   * \param  blob  (OUT) the newest valid copy
+   * \param  version  (OUT) layout version that copy was saved with
+   * \returns  length of blob, or -1 if neither file holds a valid copy
+  */
+  int load(FILESYSTEM* fs, uint8_t* blob, int max_len, uint8_t& version);
+
+  bool save(FILESYSTEM* fs, const uint8_t* blob, int len, uint8_t version);
+
+  static uint32_t crc32(const uint8_t* data, int len, uint32_t crc = 0);
+
+  /** \brief  unpacks a field at offset 'i' (then advances it), if the field is within the 'len' loaded */
+  static void getField(const uint8_t* blob, int len, int& i, void* dest, int n) {
+    if (i + n <= len) memcpy(dest, &blob[i], n);
+    i += n;
+  }
+  static void putField(uint8_t* blob, int& i, const void* src, int n) {
+    memcpy(&blob[i], src, n);
+    i += n;
+  }
+};
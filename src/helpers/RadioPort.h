@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Dispatcher.h>
+
+/**
+ * \brief  Drives a second radio for a node, eg. a repeater with two LoRa radios on different frequencies. Has its own
+ *     outbound queue, LBT state and airtime budget, but received packets are handed to the host Dispatcher (see
+ *     Dispatcher::attachPort()), so dedup and routing are done once, by the host's Mesh.
+*/
+class RadioPort : public mesh::Dispatcher {
+  const float* _airtime_factor;
+
+protected:
+  mesh::DispatcherAction onRecvPacket(mesh::Packet* pkt) override { return ACTION_RELEASE; }  // not called, host handles these
+  float getAirtimeBudgetFactor() const override { return _airtime_factor ? *_airtime_factor : 2.0f; }
+
+public:
+  /**
+   * \param  mgr  its queues, allocating from the host's packet pool, ie. ScheduledPacketManager(queue_size, pool)
+   * \param  airtime_factor  (optional) eg. the host's prefs, so changes apply to both radios. Default is 2.0
+  */
+  RadioPort(mesh::Radio& radio, mesh::MillisecondClock& ms, mesh::PacketManager& mgr, const float* airtime_factor=NULL)
+    : mesh::Dispatcher(radio, ms, mgr), _airtime_factor(airtime_factor) { }
+
+  mesh::Radio* getRadio() const { return _radio; }
+};
@@ -2,8 +2,11 @@
 #include <helpers/TxtDataHelpers.h>
 #include <SHA256.h>
 
+#define REGION_PAD_AUTO_KEY   0x01   // in reserved bytes of region record: pad[1..16] is the hashtag region's key
+
 RegionMap::RegionMap(TransportKeyStore& store) : _store(&store) {
   next_id = 1; num_regions = 0; home_id = 0;
+  invalidateMatches();
   wildcard.id = wildcard.parent = 0;
   wildcard.flags = 0;  // default behaviour, allow flood and direct
   strcpy(wildcard.name, "*");
@@ -36,6 +39,7 @@ bool RegionMap::load(FILESYSTEM* _fs) {
       uint8_t pad[128];
 
       num_regions = 0; next_id = 1; home_id = 0;
+      invalidateMatches();
 
       bool success = file.read(pad, 5) == 5;  // reserved header
       success = success && file.read((uint8_t *) &home_id, sizeof(home_id)) == sizeof(home_id);
@@ -54,6 +58,12 @@ bool RegionMap::load(FILESYSTEM* _fs) {
 
           if (!success) break; // EOF
 
+          if (r->name[0] == '#' && (pad[0] & REGION_PAD_AUTO_KEY)) {   // saves re-deriving it
+            TransportKey key;
+            memcpy(key.key, &pad[1], sizeof(key.key));
+            _store->putAutoKey(r->id, key);
+          }
+
           if (r->id >= next_id) {    // make sure next_id is valid
             next_id = r->id + 1;
           }
@@ -86,7 +96,16 @@ bool RegionMap::save(FILESYSTEM* _fs) {
         success = success && file.write((uint8_t *) &r->parent, sizeof(r->parent)) == sizeof(r->parent);
         success = success && file.write((uint8_t *) r->name, sizeof(r->name)) == sizeof(r->name);
         success = success && file.write((uint8_t *) &r->flags, sizeof(r->flags)) == sizeof(r->flags);
-        success = success && file.write(pad, sizeof(pad)) == sizeof(pad);
+
+        uint8_t rpad[sizeof(pad)];
+        memset(rpad, 0, sizeof(rpad));
+        if (r->name[0] == '#') {   // keep the derived key, with the region
+          TransportKey key;
+          _store->getAutoKeyFor(r->id, r->name, key);
+          rpad[0] = REGION_PAD_AUTO_KEY;
+          memcpy(&rpad[1], key.key, sizeof(key.key));
+        }
+        success = success && file.write(rpad, sizeof(rpad)) == sizeof(rpad);
         if (!success) break; // write failed
       }
     }
@@ -103,6 +122,7 @@ RegionEntry* RegionMap::putRegion(const char* name, uint16_t parent_id, uint16_t
     sp++;
   }
 
+  invalidateMatches();
   auto region = findByName(name);
   if (region) {
     if (region->id == parent_id) return NULL;   // ERROR: invalid parent!
@@ -120,7 +140,10 @@ RegionEntry* RegionMap::putRegion(const char* name, uint16_t parent_id, uint16_t
   return region;
 }
 
-RegionEntry* RegionMap::findMatch(mesh::Packet* packet, uint8_t mask) {
+int RegionMap::calcMatch(mesh::Packet* packet, uint8_t mask) {
+  uint16_t want = packet->transport_codes[0];
+  if (want == 0 || want == 0xFFFF) return -1;   // reserved, can never match a calculated code
+
   for (int i = 0; i < num_regions; i++) {
     auto region = &regions[i];
     if ((region->flags & mask) == 0) {   // does region allow this? (per 'mask' param)
@@ -134,13 +157,43 @@ RegionEntry* RegionMap::findMatch(mesh::Packet* packet, uint8_t mask) {
       }
       for (int j = 0; j < num; j++) {
         uint16_t code = keys[j].calcTransportCode(packet);
-        if (packet->transport_codes[0] == code) {   // a match!!
-          return region;
+        if (want == code) {   // a match!!
+          return i;
         }
       }
     }
   }
-  return NULL;  // no matches
+  return -1;  // no matches
+}
+
+RegionEntry* RegionMap::findMatch(mesh::Packet* packet, uint8_t mask) {
+  uint8_t fp[MAX_HASH_SIZE];
+  packet->calculateFingerprint(fp);
+
+  RegionMatch* m = NULL;
+  for (int i = 0; i < num_matches; i++) {   // is this a copy of a recent packet?
+    auto c = &match_cache[i];
+    if (c->code == packet->transport_codes[0] && c->mask == mask && memcmp(c->fingerprint, fp, MAX_HASH_SIZE) == 0) {
+      if (c->idx < 0) return NULL;
+      if ((regions[c->idx].flags & mask) == 0) return &regions[c->idx];
+      m = c;   // flags have changed since, search again (and replace this entry)
+      break;
+    }
+  }
+
+  int idx = calcMatch(packet, mask);
+
+  if (m == NULL) {
+    m = &match_cache[next_match];
+    next_match = (next_match + 1) % REGION_MATCH_CACHE_SIZE;
+    if (num_matches < REGION_MATCH_CACHE_SIZE) num_matches++;
+    memcpy(m->fingerprint, fp, MAX_HASH_SIZE);
+    m->code = packet->transport_codes[0];
+    m->mask = mask;
+  }
+  m->idx = idx;
+
+  return idx < 0 ? NULL : &regions[idx];
 }
 
 RegionEntry* RegionMap::findByName(const char* name) {
@@ -200,6 +253,8 @@ bool RegionMap::removeRegion(const RegionEntry& region) {
   }
   if (i >= num_regions) return false;  // failed (not found)
 
+  invalidateMatches();
+  _store->removeKeys(region.id);
   num_regions--;    // remove from regions array
   while (i < num_regions) {
     regions[i] = regions[i + 1];
@@ -210,6 +265,7 @@ bool RegionMap::removeRegion(const RegionEntry& region) {
 
 bool RegionMap::clear() {
   num_regions = 0;
+  invalidateMatches();
   return true;  // success
 }
 
@@ -8,6 +8,10 @@
   #define MAX_REGION_ENTRIES  32
 #endif
 
+#ifndef REGION_MATCH_CACHE_SIZE
+  #define REGION_MATCH_CACHE_SIZE  8
+#endif
+
 #define REGION_DENY_FLOOD   0x01
 #define REGION_DENY_DIRECT  0x02   // reserved for future
 
@@ -18,14 +22,29 @@ struct RegionEntry {
   char name[31];
 };
 
+/**
+ * \brief  result of a recent findMatch(), so the (many) copies of the same flood packet don't each need the
+ *     transport code calculated for every region key.
+*/
+struct RegionMatch {
+  uint8_t fingerprint[MAX_HASH_SIZE];   // of packet type + payload (same fields the transport code is calculated over)
+  uint16_t code;
+  uint8_t mask;
+  int16_t idx;   // index into regions[], or -1 if no match
+};
+
 class RegionMap {
   TransportKeyStore* _store;
   uint16_t next_id, home_id;
   uint16_t num_regions;
   RegionEntry regions[MAX_REGION_ENTRIES];
   RegionEntry wildcard;
+  RegionMatch match_cache[REGION_MATCH_CACHE_SIZE];
+  uint8_t num_matches, next_match;
 
   void printChildRegions(int indent, const RegionEntry* parent, Stream& out) const;
+  int calcMatch(mesh::Packet* packet, uint8_t mask);
+  void invalidateMatches() { num_matches = next_match = 0; }
 
 public:
   RegionMap(TransportKeyStore& store);
@@ -45,7 +64,7 @@ public:
   void setHomeRegion(const RegionEntry* home);
   bool removeRegion(const RegionEntry& region);
   bool clear();
-  void resetFrom(const RegionMap& src) { num_regions = 0; next_id = src.next_id; }
+  void resetFrom(const RegionMap& src) { num_regions = 0; next_id = src.next_id; invalidateMatches(); }
   int getCount() const { return num_regions; }
 
   void exportTo(Stream& out) const;
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <helpers/PrefsFile.h>
+
+/**
+ * RETAINED_RAM_ATTR places a variable in RAM which is neither zeroed nor loaded at startup, so it keeps its contents
+ * across a warm restart (watchdog, crash, software reset). Its contents after a power-on are garbage, so must be
+ * checked (see RetainedState).
+*/
+#if defined(ESP32)
+  #include <esp_attr.h>
+  #define RETAINED_RAM_ATTR   RTC_NOINIT_ATTR    // RTC slow memory, (usually) also kept through brownout resets
+#elif defined(NRF52_PLATFORM)
+  #define RETAINED_RAM_ATTR   __attribute__((section(".noinit")))
+#elif defined(RP2040_PLATFORM)
+  #define RETAINED_RAM_ATTR   __attribute__((section(".uninitialized_data")))
+#endif
+
+#define RETAINED_STATE_MAGIC   0x524D5357   // "WSMR"
+
+/**
+ * \brief  A snapshot of T in retained RAM (declare as RETAINED_RAM_ATTR), with a header (magic, size, CRC-32) so
+ *     that a stale or half-written snapshot, a different firmware layout, or power-on garbage is never restored.
+ *     Write the fields of 'data', then commit(). On boot, restore from 'data' only if isValid(), then invalidate().
+*/
+template <typename T>
+struct RetainedState {
+  uint32_t magic;
+  uint32_t size;
+  uint32_t crc;
+  uint32_t restarts;   // number of warm restarts restored from (in a row)
+  T data;
+
+  uint32_t calcCrc() const { return PrefsFile::crc32((const uint8_t *) &data, sizeof(T)); }
+
+  bool isValid() const { return magic == RETAINED_STATE_MAGIC && size == sizeof(T) && crc == calcCrc(); }
+
+  void commit() {
+    magic = 0;   // (in case reset mid-way)
+    size = sizeof(T);
+    crc = calcCrc();
+    magic = RETAINED_STATE_MAGIC;
+  }
+
+  void invalidate() { magic = 0; }
+};
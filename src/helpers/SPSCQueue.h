@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * \brief  Lock-free FIFO between exactly one producer task and one consumer task (eg. the mesh task and the UI task).
+ *     Head and tail are free running, and each is written only by its own side, so neither side ever blocks.
+ *  NOTE: N must be a power of 2.
+*/
+template <class T, int N>
+class SPSCQueue {
+  T _items[N];
+  std::atomic<uint16_t> _head, _tail;   // read, write counts
+  uint32_t _dropped;   // (producer side)
+
+public:
+  SPSCQueue() : _head(0), _tail(0), _dropped(0) { }
+
+  /** \returns  false if full (item is dropped) */
+  bool push(const T& item) {
+    uint16_t t = _tail.load(std::memory_order_relaxed);
+    if ((uint16_t)(t - _head.load(std::memory_order_acquire)) >= N) {
+      _dropped++;
+      return false;
+    }
+    _items[t % N] = item;
+    _tail.store(t + 1, std::memory_order_release);   // publish only once item is complete
+    return true;
+  }
+
+  bool pop(T& item) {
+    uint16_t h = _head.load(std::memory_order_relaxed);
+    if (h == _tail.load(std::memory_order_acquire)) return false;   // empty
+    item = _items[h % N];
+    _head.store(h + 1, std::memory_order_release);   // slot can now be re-used
+    return true;
+  }
+
+  bool isEmpty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+  uint32_t getNumDropped() const { return _dropped; }
+};
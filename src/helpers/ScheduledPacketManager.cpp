@@ -0,0 +1,232 @@
+#include "ScheduledPacketManager.h"
+
+ScheduledQueue::ScheduledQueue(int max_entries, bool fair) {
+  _due = new Entry[max_entries];
+  _pending = new Entry[max_entries];
+  _size = max_entries;
+  _num_due = _num_pending = 0;
+  _next_seq = 0;
+  _fair = fair;
+  _aging = 0;
+  _vtime = 0;
+  memset(_src_finish, 0, sizeof(_src_finish));
+}
+
+void ScheduledQueue::siftUp(Entry* heap, int i, EntryCmp cmp) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!cmp(heap[i], heap[parent])) break;
+    Entry tmp = heap[i]; heap[i] = heap[parent]; heap[parent] = tmp;
+    i = parent;
+  }
+}
+
+void ScheduledQueue::siftDown(Entry* heap, int num, int i, EntryCmp cmp) {
+  while (true) {
+    int best = i;
+    int l = 2*i + 1, r = l + 1;
+    if (l < num && cmp(heap[l], heap[best])) best = l;
+    if (r < num && cmp(heap[r], heap[best])) best = r;
+    if (best == i) break;
+    Entry tmp = heap[i]; heap[i] = heap[best]; heap[best] = tmp;
+    i = best;
+  }
+}
+
+void ScheduledQueue::push(Entry* heap, int& num, const Entry& e, EntryCmp cmp) {
+  heap[num] = e;
+  siftUp(heap, num, cmp);
+  num++;
+}
+
+ScheduledQueue::Entry ScheduledQueue::pop(Entry* heap, int& num, EntryCmp cmp) {
+  Entry top = heap[0];
+  num--;
+  if (num > 0) {
+    heap[0] = heap[num];
+    siftDown(heap, num, 0, cmp);
+  }
+  return top;
+}
+
+void ScheduledQueue::removeAt(Entry* heap, int& num, int i, EntryCmp cmp) {
+  num--;
+  if (i < num) {
+    heap[i] = heap[num];   // move last entry into the hole, then restore heap order
+    siftDown(heap, num, i, cmp);
+    siftUp(heap, i, cmp);
+  }
+}
+
+int ScheduledQueue::countPendingBefore(int i, uint32_t now) const {
+  if (i >= _num_pending || _pending[i].scheduled_for > now) return 0;   // whole sub-tree is in the future
+  return 1 + countPendingBefore(2*i + 1, now) + countPendingBefore(2*i + 2, now);
+}
+
+void ScheduledQueue::promoteDue(uint32_t now) {
+  while (_num_pending > 0 && _pending[0].scheduled_for <= now) {
+    Entry e = pop(_pending, _num_pending, isEarlier);
+    push(_due, _num_due, e, isMoreUrgent);
+  }
+}
+
+bool ScheduledQueue::add(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) {
+  if (count() >= _size) {
+    MESH_DEBUG_PRINTLN("ScheduledQueue::add(): FATAL: queue is full!");
+    return false;
+  }
+  Entry e;
+  e.packet = packet;
+  e.priority = priority;
+  e.scheduled_for = scheduled_for;
+  e.seq = _next_seq++;
+  e.rank = calcRank(e);
+  e.vfinish = 0;
+  if (_fair) {
+    uint32_t* finish = &_src_finish[SourceRateLimiter::getSourceKey(packet) % FAIR_QUEUE_BUCKETS];
+    uint32_t start = (int32_t)(*finish - _vtime) > 0 ? *finish : _vtime;   // source's backlog, else now
+    e.vfinish = *finish = start + packet->path_len + packet->payload_len + 2;   // cost ~ airtime
+  }
+  push(_pending, _num_pending, e, isEarlier);
+  return true;
+}
+
+mesh::Packet* ScheduledQueue::get(uint32_t now, uint32_t* scheduled_for, uint8_t* priority) {
+  promoteDue(now);
+  if (_num_due == 0) return NULL;   // empty, or all items are still in the future
+
+  Entry top = pop(_due, _num_due, isMoreUrgent);
+  if (_fair && (int32_t)(top.vfinish - _vtime) > 0) _vtime = top.vfinish;
+  if (scheduled_for) *scheduled_for = top.scheduled_for;
+  if (priority) *priority = top.priority;
+  return top.packet;
+}
+
+void ScheduledQueue::setAging(uint32_t millis) {
+  if (millis == _aging) return;
+
+  _aging = millis;
+  for (int i = 0; i < _num_pending; i++) _pending[i].rank = calcRank(_pending[i]);   // heap order unaffected
+  for (int i = 0; i < _num_due; i++) {
+    _due[i].rank = calcRank(_due[i]);
+    siftUp(_due, i, isMoreUrgent);   // rebuild heap, top-down
+  }
+}
+
+mesh::Packet* ScheduledQueue::itemAt(int i) const {
+  if (i < _num_due) return _due[i].packet;
+  return _pending[i - _num_due].packet;
+}
+
+void ScheduledQueue::replaceAt(int i, mesh::Packet* packet) {
+  if (i < _num_due) {
+    _due[i].packet = packet;
+  } else {
+    _pending[i - _num_due].packet = packet;
+  }
+}
+
+mesh::Packet* ScheduledQueue::removeByIdx(int i) {
+  if (i < 0 || i >= count()) return NULL;  // invalid index
+
+  mesh::Packet* item;
+  if (i < _num_due) {
+    item = _due[i].packet;
+    removeAt(_due, _num_due, i, isMoreUrgent);
+  } else {
+    i -= _num_due;
+    item = _pending[i].packet;
+    removeAt(_pending, _num_pending, i, isEarlier);
+  }
+  return item;
+}
+
+ScheduledPacketManager::ScheduledPacketManager(int pool_size, int slab_small, int slab_medium)
+  : unused(pool_size), slab(slab_small, slab_medium), send_queue(pool_size + slab_small + slab_medium, true), rx_queue(pool_size) {
+  _pool = NULL;
+}
+
+ScheduledPacketManager::ScheduledPacketManager(int queue_size, mesh::PacketManager& pool)
+  : unused(0), slab(0, 0), send_queue(queue_size, true), rx_queue(queue_size) {
+  _pool = &pool;
+}
+
+bool ScheduledPacketManager::compactOutbound() {
+  for (int i = send_queue.count() - 1; i >= 0; i--) {   // pending (not yet due) entries first
+    mesh::Packet* packet = send_queue.itemAt(i);
+    mesh::Packet* copy = slab.shrink(packet);
+    if (copy == NULL) continue;   // already a slab packet, or no slot that fits
+
+    send_queue.replaceAt(i, copy);
+    unused.free(packet);
+    return true;
+  }
+  return false;
+}
+
+mesh::Packet* ScheduledPacketManager::allocNew() {
+  if (_pool) return _pool->allocNew();
+  mesh::Packet* packet = unused.alloc();
+  if (packet == NULL && compactOutbound()) packet = unused.alloc();
+  return packet;  // returns NULL if empty
+}
+
+void ScheduledPacketManager::free(mesh::Packet* packet) {
+  packet->_tx_channel = 0;   // local only, so don't leave it for the next user
+  if (_pool) {
+    _pool->free(packet);
+  } else if (!slab.free(packet) && !unused.free(packet)) {
+    MESH_DEBUG_PRINTLN("ScheduledPacketManager::free(): WARNING: pool is full, double free?");
+  }
+}
+
+void ScheduledPacketManager::queueOutbound(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) {
+  if (!send_queue.add(packet, priority, scheduled_for)) {
+    free(packet);   // don't leak it from the pool
+  }
+}
+
+mesh::Packet* ScheduledPacketManager::getNextOutbound(uint32_t now, uint8_t* priority, uint32_t* scheduled_for) {
+  return send_queue.get(now, scheduled_for, priority);
+}
+
+int ScheduledPacketManager::getOutboundCount(uint32_t now) const {
+  return send_queue.countBefore(now);
+}
+
+bool ScheduledPacketManager::hasOutboundDue(uint32_t now) const {
+  return send_queue.hasDue(now);
+}
+
+bool ScheduledPacketManager::getNextOutboundTime(uint32_t* scheduled_for) const {
+  return send_queue.getEarliest(scheduled_for);
+}
+
+int ScheduledPacketManager::getFreeCount() const {
+  if (_pool) return _pool->getFreeCount();
+  return unused.count();
+}
+
+mesh::Packet* ScheduledPacketManager::getOutboundByIdx(int i) {
+  return send_queue.itemAt(i);
+}
+mesh::Packet* ScheduledPacketManager::removeOutboundByIdx(int i) {
+  return send_queue.removeByIdx(i);
+}
+bool ScheduledPacketManager::getOutboundTimeByIdx(int i, uint32_t* scheduled_for) const {
+  if (i < 0 || i >= send_queue.count()) return false;
+  *scheduled_for = send_queue.timeAt(i);
+  return true;
+}
+
+void ScheduledPacketManager::queueInbound(mesh::Packet* packet, uint32_t scheduled_for) {
+  if (!rx_queue.add(packet, 0, scheduled_for)) {
+    free(packet);
+  }
+}
+mesh::Packet* ScheduledPacketManager::getNextInbound(uint32_t now, uint32_t* scheduled_for) {
+  return rx_queue.get(now, scheduled_for);
+}
+bool ScheduledPacketManager::getNextInboundTime(uint32_t* scheduled_for) const {
+  return rx_queue.getEarliest(scheduled_for);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Dispatcher.h>
+#include <helpers/StaticPoolPacketManager.h>
+#include <helpers/SourceRateLimiter.h>
+
+#define FAIR_QUEUE_BUCKETS   16
+
+/**
+ * \brief  A queue of Packets ordered by deadline, then priority.
+ *     Entries still in the future are kept in a min-heap keyed on 'scheduled_for' (so the earliest
+ *     deadline is always at the top), and are moved into a second min-heap keyed on priority once
+ *     they become due. Equal priorities are served in FIFO order, or if 'fair', by start-time fair queuing across
+ *     packet sources (hashed into FAIR_QUEUE_BUCKETS), so that a burst from one source is interleaved with others.
+ *     With aging, the priority is offset by 'scheduled_for' / aging, so older entries catch up with newer, more urgent ones.
+*/
+class ScheduledQueue {
+  struct Entry {
+    mesh::Packet* packet;
+    uint32_t scheduled_for;
+    uint32_t vfinish;   // virtual finish time, if fair (else zero)
+    uint32_t rank;      // priority, offset by age (see setAging())
+    uint16_t seq;       // insertion order (for FIFO amongst equal priorities)
+    uint8_t priority;
+  };
+  typedef bool (*EntryCmp)(const Entry& a, const Entry& b);
+
+  Entry* _due;        // heap, by rank (then seq)
+  Entry* _pending;    // heap, by scheduled_for
+  int _size, _num_due, _num_pending;
+  uint16_t _next_seq;
+  bool _fair;
+  uint32_t _aging;
+  uint32_t _vtime;    // vfinish of last entry served
+  uint32_t _src_finish[FAIR_QUEUE_BUCKETS];   // vfinish of last entry added, per source bucket
+
+  static bool isEarlier(const Entry& a, const Entry& b) { return a.scheduled_for < b.scheduled_for; }
+  static bool isMoreUrgent(const Entry& a, const Entry& b) {
+    if (a.rank != b.rank) return (int32_t)(a.rank - b.rank) < 0;
+    if (a.vfinish != b.vfinish) return (int32_t)(a.vfinish - b.vfinish) < 0;
+    return (int16_t)(a.seq - b.seq) < 0;
+  }
+  static void siftUp(Entry* heap, int i, EntryCmp cmp);
+  static void siftDown(Entry* heap, int num, int i, EntryCmp cmp);
+  static void push(Entry* heap, int& num, const Entry& e, EntryCmp cmp);
+  static Entry pop(Entry* heap, int& num, EntryCmp cmp);
+  static void removeAt(Entry* heap, int& num, int i, EntryCmp cmp);
+
+  uint32_t calcRank(const Entry& e) const { return _aging ? e.priority + e.scheduled_for / _aging : e.priority; }
+  int countPendingBefore(int i, uint32_t now) const;
+  void promoteDue(uint32_t now);
+
+public:
+  ScheduledQueue(int max_entries, bool fair=false);
+
+  bool add(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for);
+  mesh::Packet* get(uint32_t now, uint32_t* scheduled_for=NULL, uint8_t* priority=NULL);
+  void setAging(uint32_t millis);
+  bool hasDue(uint32_t now) const {
+    return _num_due > 0 || (_num_pending > 0 && _pending[0].scheduled_for <= now);
+  }
+  bool getEarliest(uint32_t* scheduled_for) const {
+    if (_num_due > 0) { *scheduled_for = _due[0].scheduled_for; return true; }   // already due
+    if (_num_pending > 0) { *scheduled_for = _pending[0].scheduled_for; return true; }
+    return false;
+  }
+  int count() const { return _num_due + _num_pending; }
+  int countBefore(uint32_t now) const { return _num_due + countPendingBefore(0, now); }
+  mesh::Packet* itemAt(int i) const;
+  uint32_t timeAt(int i) const { return i < _num_due ? _due[i].scheduled_for : _pending[i - _num_due].scheduled_for; }
+  void replaceAt(int i, mesh::Packet* packet);
+  mesh::Packet* removeByIdx(int i);
+};
+
+/**
+ * \brief  A PacketManager with a static pool of Packets, where the outbound and inbound queues are
+ *     scheduled by deadline. Checking for a due packet is O(1), and getting the next due packet is O(log n).
+*/
+class ScheduledPacketManager : public mesh::PacketManager {
+  PacketPool unused;
+  PacketSlab slab;
+  ScheduledQueue send_queue, rx_queue;
+  mesh::PacketManager* _pool;   // if not NULL, Packets are allocated from (and freed to) this instead of 'unused'
+
+  bool compactOutbound();
+
+public:
+  /**
+   * \param  slab_small, slab_medium   number of slots in each PacketSlab size class (zero for none)
+   */
+  ScheduledPacketManager(int pool_size, int slab_small=0, int slab_medium=0);
+
+  /**
+   * \brief  just the queues, with Packets allocated from another manager's pool (eg. for a second radio)
+  */
+  ScheduledPacketManager(int queue_size, mesh::PacketManager& pool);
+
+  mesh::Packet* allocNew() override;
+  void free(mesh::Packet* packet) override;
+  void queueOutbound(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) override;
+  mesh::Packet* getNextOutbound(uint32_t now, uint8_t* priority=NULL, uint32_t* scheduled_for=NULL) override;
+  void setOutboundAging(uint32_t millis) override { send_queue.setAging(millis); }
+  int getOutboundCount(uint32_t now) const override;
+  bool hasOutboundDue(uint32_t now) const override;
+  bool getNextOutboundTime(uint32_t* scheduled_for) const override;
+  int getFreeCount() const override;
+  mesh::Packet* getOutboundByIdx(int i) override;
+  mesh::Packet* removeOutboundByIdx(int i) override;
+  void queueInbound(mesh::Packet* packet, uint32_t scheduled_for) override;
+  mesh::Packet* getNextInbound(uint32_t now, uint32_t* scheduled_for=NULL) override;
+  bool getNextInboundTime(uint32_t* scheduled_for) const override;
+  bool getOutboundTimeByIdx(int i, uint32_t* scheduled_for) const override;
+};
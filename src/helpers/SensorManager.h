@@ -9,6 +9,24 @@
 
 #define TELEM_CHANNEL_SELF   1   // LPP data channel for 'self' device
 
+/**
+ * \brief  A CayenneLPP which encodes straight into a slice of the caller's buffer (eg. the reply payload, after its tag),
+ *     instead of into its own heap buffer, so the result needn't be copied out. Call resetInto() before each use.
+*/
+class LPPSlice : public CayenneLPP {
+  uint8_t* _own;
+
+public:
+  LPPSlice() : CayenneLPP(0) { _own = _buffer; }
+  ~LPPSlice() { _buffer = _own; }   // (base class frees its own buffer)
+
+  void resetInto(uint8_t* dest, uint8_t max_len) {
+    _buffer = dest;
+    _maxsize = max_len;
+    reset();
+  }
+};
+
 class SensorManager {
 public:
   double node_lat, node_lon;  // modify these, if you want to affect Advert location
@@ -18,6 +36,7 @@ public:
   virtual bool begin() { return false; }
   virtual bool querySensors(uint8_t requester_permissions, CayenneLPP& telemetry) { return false; }
   virtual void loop() { }
+  virtual bool pollChanges() { return false; }   // true (once) if a reading has changed by more than its threshold
   virtual int getNumSettings() const { return 0; }
   virtual const char* getSettingName(int i) const { return NULL; }
   virtual const char* getSettingValue(int i) const { return NULL; }
@@ -0,0 +1,73 @@
+#include "SimpleMeshTables.h"
+
+#define TABLES_FILE_MAGIC     0x4C42544D   // "MTBL"
+#define TABLES_FILE_VERSION   1            // v1: keys are Packet::calculateFingerprint()
+
+struct TablesFileHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t hash_size;
+  uint16_t num_hashes, num_acks;
+  uint16_t next_idx, next_ack_idx;
+};
+
+bool SimpleMeshTables::load(FILESYSTEM* fs, const char* filename) {
+  if (!fs->exists(filename)) return false;
+#if defined(RP2040_PLATFORM)
+  File file = fs->open(filename, "r");
+#else
+  File file = fs->open(filename);
+#endif
+  if (!file) return false;
+
+  TablesFileHeader hdr;
+  bool success = (file.read((uint8_t *) &hdr, sizeof(hdr)) == sizeof(hdr));
+  success = success && hdr.magic == TABLES_FILE_MAGIC && hdr.version == TABLES_FILE_VERSION && hdr.hash_size == MAX_HASH_SIZE
+              && hdr.num_hashes == MAX_PACKET_HASHES && hdr.num_acks == MAX_PACKET_ACKS
+              && hdr.next_idx < MAX_PACKET_HASHES && hdr.next_ack_idx < MAX_PACKET_ACKS;
+  success = success && (file.read(_hashes, sizeof(_hashes)) == sizeof(_hashes));
+  success = success && (file.read((uint8_t *) &_acks[0], sizeof(_acks)) == sizeof(_acks));
+  file.close();
+
+  if (success) {
+    _next_idx = hdr.next_idx;
+    _next_ack_idx = hdr.next_ack_idx;
+  } else {
+    MESH_DEBUG_PRINTLN("SimpleMeshTables::load(): invalid or old format snapshot, ignoring");
+    memset(_hashes, 0, sizeof(_hashes));   // may have partially read
+    memset(_acks, 0, sizeof(_acks));
+    _next_idx = _next_ack_idx = 0;
+  }
+  rebuildIndexes();
+  _dirty = false;
+  return success;
+}
+
+bool SimpleMeshTables::save(FILESYSTEM* fs, const char* filename) {
+#if defined(NRF52_PLATFORM) || defined(STM32_PLATFORM)
+  fs->remove(filename);
+  File file = fs->open(filename, FILE_O_WRITE);
+#elif defined(RP2040_PLATFORM)
+  File file = fs->open(filename, "w");
+#else
+  File file = fs->open(filename, "w", true);
+#endif
+  if (!file) return false;
+
+  TablesFileHeader hdr;
+  hdr.magic = TABLES_FILE_MAGIC;
+  hdr.version = TABLES_FILE_VERSION;
+  hdr.hash_size = MAX_HASH_SIZE;
+  hdr.num_hashes = MAX_PACKET_HASHES;
+  hdr.num_acks = MAX_PACKET_ACKS;
+  hdr.next_idx = _next_idx;
+  hdr.next_ack_idx = _next_ack_idx;
+
+  bool success = (file.write((const uint8_t *) &hdr, sizeof(hdr)) == sizeof(hdr));
+  success = success && (file.write(_hashes, sizeof(_hashes)) == sizeof(_hashes));
+  success = success && (file.write((const uint8_t *) &_acks[0], sizeof(_acks)) == sizeof(_acks));
+  file.close();
+
+  if (success) _dirty = false;
+  return success;
+}
@@ -1,28 +1,281 @@
 #pragma once
 
 #include <Mesh.h>
+#include <helpers/IdentityStore.h>
 
-#ifdef ESP32
-  #include <FS.h>
+#ifndef MAX_PACKET_HASHES
+  #define MAX_PACKET_HASHES  128
+#endif
+#ifndef MAX_PACKET_ACKS
+  #define MAX_PACKET_ACKS     64
 #endif
 
-#define MAX_PACKET_HASHES  128
-#define MAX_PACKET_ACKS     64
+/**
+ * \brief  An open-addressing (linear probing) hash index over the slots of a cyclic table of fixed-size keys,
+ *     so that lookups are O(1) instead of a scan. The table itself (and its eviction order) is owned by the caller,
+ *     who must remove() a slot BEFORE overwriting or clearing it. Zeroed slots are treated as empty.
+*/
+template <int NUM_SLOTS, int KEY_SIZE>
+class CyclicTableIndex {
+  static constexpr int calcBuckets(int n, int b = 1) { return b >= 2*n ? b : calcBuckets(n, b*2); }
+  enum { NUM_BUCKETS = calcBuckets(NUM_SLOTS), EMPTY = 0xFFFF };
+
+  const uint8_t* _table;
+  uint16_t _slots[NUM_BUCKETS];   // slot number, or EMPTY
+
+  static int bucketFor(const uint8_t* key) {
+    uint32_t h;
+    memcpy(&h, key, 4);   // keys are hashes (or ACK CRCs) already, just need to spread them
+    return ((h * 2654435761u) >> 16) & (NUM_BUCKETS - 1);
+  }
+  const uint8_t* keyAt(int slot) const { return &_table[slot*KEY_SIZE]; }
+
+public:
+  CyclicTableIndex(const uint8_t* table) : _table(table) { reset(); }
+
+  void reset() {
+    for (int i = 0; i < NUM_BUCKETS; i++) _slots[i] = EMPTY;
+  }
+
+  void rebuild() {
+    static const uint8_t zeroes[KEY_SIZE] = { 0 };
+    reset();
+    for (int s = 0; s < NUM_SLOTS; s++) {
+      if (memcmp(keyAt(s), zeroes, KEY_SIZE) != 0) insert(s);
+    }
+  }
+
+  /**
+   * \returns  slot number holding 'key', or -1 if not found
+  */
+  int find(const uint8_t* key) const {
+    for (int i = bucketFor(key); _slots[i] != EMPTY; i = (i + 1) & (NUM_BUCKETS - 1)) {
+      if (memcmp(keyAt(_slots[i]), key, KEY_SIZE) == 0) return _slots[i];
+    }
+    return -1;
+  }
+
+  void insert(int slot) {
+    int i = bucketFor(keyAt(slot));
+    while (_slots[i] != EMPTY) i = (i + 1) & (NUM_BUCKETS - 1);
+    _slots[i] = slot;
+  }
+
+  void remove(int slot) {
+    int i = bucketFor(keyAt(slot));
+    while (_slots[i] != EMPTY && _slots[i] != slot) i = (i + 1) & (NUM_BUCKETS - 1);
+    if (_slots[i] == EMPTY) return;   // not indexed (eg. slot was cleared)
+
+    // backward-shift the rest of the probe chain, so no tombstones are needed
+    int j = i;
+    while (true) {
+      j = (j + 1) & (NUM_BUCKETS - 1);
+      if (_slots[j] == EMPTY) break;
+      int home = bucketFor(keyAt(_slots[j]));
+      bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+      if (!stays) {
+        _slots[i] = _slots[j];
+        i = j;
+      }
+    }
+    _slots[i] = EMPTY;
+  }
+};
+
+#ifndef ACK_FILTER_BITS
+  #define ACK_FILTER_BITS   (MAX_PACKET_ACKS*16)   // must be a power of 2
+#endif
+
+/**
+ * \brief  A two-generation Bloom filter (k=2) of ACK CRCs, in front of the exact ACK table, so the common 'not seen'
+ *     case is answered with a couple of bit tests. Generations rotate every 'capacity' inserts, so the last 'capacity'
+ *     inserts (ie. everything still in the cyclic table) are always in one of them, and no deletes are needed.
+*/
+class AckBloomFilter {
+  uint32_t _curr[ACK_FILTER_BITS/32], _prev[ACK_FILTER_BITS/32];
+  int _capacity, _num_inserts;
+
+  static uint32_t bit1(uint32_t ack) { return ((ack * 2654435761u) >> 7) & (ACK_FILTER_BITS - 1); }
+  static uint32_t bit2(uint32_t ack) { return ((ack * 0x85EBCA6Bu) >> 11) & (ACK_FILTER_BITS - 1); }
+  static bool test(const uint32_t* bits, uint32_t b) { return (bits[b >> 5] >> (b & 31)) & 1; }
+
+public:
+  AckBloomFilter(int capacity) : _capacity(capacity) { reset(); }
+
+  void reset() {
+    memset(_curr, 0, sizeof(_curr));
+    memset(_prev, 0, sizeof(_prev));
+    _num_inserts = 0;
+  }
+
+  bool mightContain(uint32_t ack) const {
+    uint32_t b1 = bit1(ack), b2 = bit2(ack);
+    return (test(_curr, b1) && test(_curr, b2)) || (test(_prev, b1) && test(_prev, b2));
+  }
+
+  void insert(uint32_t ack) {
+    if (++_num_inserts > _capacity) {   // rotate generations
+      memcpy(_prev, _curr, sizeof(_prev));
+      memset(_curr, 0, sizeof(_curr));
+      _num_inserts = 1;
+    }
+    uint32_t b1 = bit1(ack), b2 = bit2(ack);
+    _curr[b1 >> 5] |= (1UL << (b1 & 31));
+    _curr[b2 >> 5] |= (1UL << (b2 & 31));
+  }
+};
+
+/**
+ * \brief  duplicate stats, for capacity planning (eg. sizing MAX_PACKET_HASHES from real traffic)
+*/
+struct DedupStats {
+  uint32_t dups_by_type[16];    // by PAYLOAD_TYPE_*
+  uint32_t dup_air_time;        // millis, that the duplicates would have cost to re-transmit
+  uint32_t n_evictions;         // live entries overwritten to make room
+
+  void reset() { memset(this, 0, sizeof(*this)); }
+
+  void countDup(const mesh::Packet* packet, mesh::Radio* radio) {
+    dups_by_type[packet->getPayloadType() & 0x0F]++;
+    if (radio) dup_air_time += radio->getEstAirtimeFor(packet->getRawLength());
+  }
+};
+
+#define TABLES_SEEN_MESH     0x01   // by hasSeen()
+#define TABLES_SEEN_BRIDGE   0x02   // by hasBridged(), ie. sent to or received from a bridge
 
 class SimpleMeshTables : public mesh::MeshTables {
   uint8_t _hashes[MAX_PACKET_HASHES*MAX_HASH_SIZE];
+  uint8_t _hash_origin[MAX_PACKET_HASHES];   // TABLES_SEEN_* flags (not persisted)
   int _next_idx;
   uint32_t _acks[MAX_PACKET_ACKS];
+  uint8_t _ack_origin[MAX_PACKET_ACKS];
   int _next_ack_idx;
   uint32_t _direct_dups, _flood_dups;
+  DedupStats _stats;
+  mesh::Radio* _radio;
+  bool _dirty;
+  CyclicTableIndex<MAX_PACKET_HASHES, MAX_HASH_SIZE> _hash_index;
+  CyclicTableIndex<MAX_PACKET_ACKS, 4> _ack_index;
+  AckBloomFilter _ack_filter;
+
+  void rebuildIndexes() {
+    _hash_index.rebuild();
+    _ack_index.rebuild();
+    _ack_filter.reset();
+    for (int i = 0; i < MAX_PACKET_ACKS; i++) {
+      int j = (_next_ack_idx + i) % MAX_PACKET_ACKS;   // oldest first
+      if (_acks[j]) _ack_filter.insert(_acks[j]);
+      _ack_origin[j] = _acks[j] ? TABLES_SEEN_MESH : 0;
+    }
+    for (int i = 0; i < MAX_PACKET_HASHES; i++) {
+      _hash_origin[i] = isHashUsed(i) ? TABLES_SEEN_MESH : 0;
+    }
+  }
+
+  /**
+   * \brief  find the packet's slot, else add it (evicting the oldest)
+   * \returns  the slot's TABLES_SEEN_* flags, to be updated by caller (zero if just added)
+  */
+  uint8_t* findOrAdd(const mesh::Packet* packet) {
+    if (packet->getPayloadType() == PAYLOAD_TYPE_ACK) {
+      uint32_t ack;
+      memcpy(&ack, packet->payload, 4);
+      if (_ack_filter.mightContain(ack)) {
+        int i = _ack_index.find((const uint8_t *) &ack);
+        if (i >= 0) return &_ack_origin[i];
+      }
+
+      _dirty = true;
+      if (_acks[_next_ack_idx]) _stats.n_evictions++;
+      _ack_index.remove(_next_ack_idx);   // evict oldest
+      _acks[_next_ack_idx] = ack;
+      _ack_index.insert(_next_ack_idx);
+      _ack_filter.insert(ack);
+      uint8_t* origin = &_ack_origin[_next_ack_idx];
+      _next_ack_idx = (_next_ack_idx + 1) % MAX_PACKET_ACKS;  // cyclic table
+      *origin = 0;
+      return origin;
+    }
+
+    uint8_t hash[MAX_HASH_SIZE];
+    packet->calculateFingerprint(hash);
+
+    int i = _hash_index.find(hash);
+    if (i >= 0) return &_hash_origin[i];
+
+    _dirty = true;
+    if (isHashUsed(_next_idx)) _stats.n_evictions++;
+    _hash_index.remove(_next_idx);   // evict oldest
+    memcpy(&_hashes[_next_idx*MAX_HASH_SIZE], hash, MAX_HASH_SIZE);
+    _hash_index.insert(_next_idx);
+    uint8_t* origin = &_hash_origin[_next_idx];
+    _next_idx = (_next_idx + 1) % MAX_PACKET_HASHES;  // cyclic table
+    *origin = 0;
+    return origin;
+  }
+
+  void countDup(const mesh::Packet* packet) {
+    if (packet->isRouteDirect()) {
+      _direct_dups++;   // keep some stats
+    } else {
+      _flood_dups++;
+    }
+    _stats.countDup(packet, _radio);
+  }
+
+  bool isHashUsed(int i) const {
+    for (int k = 0; k < MAX_HASH_SIZE; k++) {
+      if (_hashes[i*MAX_HASH_SIZE + k]) return true;
+    }
+    return false;
+  }
 
 public:
-  SimpleMeshTables() { 
+  SimpleMeshTables() : _hash_index(&_hashes[0]), _ack_index((const uint8_t *) _acks), _ack_filter(MAX_PACKET_ACKS) {
     memset(_hashes, 0, sizeof(_hashes));
+    memset(_hash_origin, 0, sizeof(_hash_origin));
     _next_idx = 0;
     memset(_acks, 0, sizeof(_acks));
+    memset(_ack_origin, 0, sizeof(_ack_origin));
     _next_ack_idx = 0;
     _direct_dups = _flood_dups = 0;
+    _stats.reset();
+    _radio = NULL;
+    _dirty = false;
+  }
+
+  /**
+   * \brief  (optional) radio, to estimate the airtime of duplicates
+  */
+  void setRadio(mesh::Radio* radio) { _radio = radio; }
+
+  /**
+   * \brief  restore/persist a (versioned) snapshot of the tables, so that packets still in flight are not
+   *      re-forwarded after a restart.
+   * \returns  false if file is missing, or was saved with a different format or table sizes.
+  */
+  bool load(FILESYSTEM* fs, const char* filename);
+  bool save(FILESYSTEM* fs, const char* filename);
+  bool isDirty() const { return _dirty; }   // changed since last save()
+
+  static const int SNAPSHOT_SIZE = sizeof(_hashes) + sizeof(_next_idx) + sizeof(_acks) + sizeof(_next_ack_idx);
+
+  /**
+   * \brief  raw copy of the tables, to/from memory which is kept during deep sleep. 'buf' is SNAPSHOT_SIZE bytes
+  */
+  void saveTo(uint8_t* buf) const {
+    memcpy(buf, _hashes, sizeof(_hashes)); buf += sizeof(_hashes);
+    memcpy(buf, &_next_idx, sizeof(_next_idx)); buf += sizeof(_next_idx);
+    memcpy(buf, _acks, sizeof(_acks)); buf += sizeof(_acks);
+    memcpy(buf, &_next_ack_idx, sizeof(_next_ack_idx));
+  }
+  void restoreFrom(const uint8_t* buf) {
+    memcpy(_hashes, buf, sizeof(_hashes)); buf += sizeof(_hashes);
+    memcpy(&_next_idx, buf, sizeof(_next_idx)); buf += sizeof(_next_idx);
+    memcpy(_acks, buf, sizeof(_acks)); buf += sizeof(_acks);
+    memcpy(&_next_ack_idx, buf, sizeof(_next_ack_idx));
+    rebuildIndexes();
   }
 
 #ifdef ESP32
@@ -31,6 +284,7 @@ public:
     f.read((uint8_t *) &_next_idx, sizeof(_next_idx));
     f.read((uint8_t *) &_acks[0], sizeof(_acks));
     f.read((uint8_t *) &_next_ack_idx, sizeof(_next_ack_idx));
+    rebuildIndexes();
   }
   void saveTo(File f) {
     f.write(_hashes, sizeof(_hashes));
@@ -41,65 +295,47 @@ public:
 #endif
 
   bool hasSeen(const mesh::Packet* packet) override {
-    if (packet->getPayloadType() == PAYLOAD_TYPE_ACK) {
-      uint32_t ack;
-      memcpy(&ack, packet->payload, 4);
-      for (int i = 0; i < MAX_PACKET_ACKS; i++) {
-        if (ack == _acks[i]) { 
-          if (packet->isRouteDirect()) {
-            _direct_dups++;   // keep some stats
-          } else {
-            _flood_dups++;
-          }
-          return true;
-        }
-      }
-  
-      _acks[_next_ack_idx] = ack;
-      _next_ack_idx = (_next_ack_idx + 1) % MAX_PACKET_ACKS;  // cyclic table  
-      return false;
-    }
-
-    uint8_t hash[MAX_HASH_SIZE];
-    packet->calculatePacketHash(hash);
-
-    const uint8_t* sp = _hashes;
-    for (int i = 0; i < MAX_PACKET_HASHES; i++, sp += MAX_HASH_SIZE) {
-      if (memcmp(hash, sp, MAX_HASH_SIZE) == 0) { 
-        if (packet->isRouteDirect()) {
-          _direct_dups++;   // keep some stats
-        } else {
-          _flood_dups++;
-        }
-        return true;
-      }
+    uint8_t* origin = findOrAdd(packet);
+    if (*origin & TABLES_SEEN_MESH) {
+      countDup(packet);
+      return true;
     }
+    *origin |= TABLES_SEEN_MESH;
+    return false;
+  }
 
-    memcpy(&_hashes[_next_idx*MAX_HASH_SIZE], hash, MAX_HASH_SIZE);
-    _next_idx = (_next_idx + 1) % MAX_PACKET_HASHES;  // cyclic table
+  /**
+   * \brief  for a bridge (see BridgeBase), so it can share these tables instead of keeping its own. A packet is only
+   *     passed across the bridge once (either way), independent of hasSeen(), so the mesh still processes it once too.
+   * \returns  true if the packet has already been across the bridge
+  */
+  bool hasBridged(const mesh::Packet* packet) {
+    uint8_t* origin = findOrAdd(packet);
+    if (*origin & TABLES_SEEN_BRIDGE) return true;
+    *origin |= TABLES_SEEN_BRIDGE;
     return false;
   }
 
   void clear(const mesh::Packet* packet) override {
+    _dirty = true;
     if (packet->getPayloadType() == PAYLOAD_TYPE_ACK) {
       uint32_t ack;
       memcpy(&ack, packet->payload, 4);
-      for (int i = 0; i < MAX_PACKET_ACKS; i++) {
-        if (ack == _acks[i]) { 
-          _acks[i] = 0;
-          break;
-        }
+      int i = _ack_index.find((const uint8_t *) &ack);
+      if (i >= 0) {
+        _ack_index.remove(i);
+        _acks[i] = 0;
+        _ack_origin[i] = 0;
       }
     } else {
       uint8_t hash[MAX_HASH_SIZE];
-      packet->calculatePacketHash(hash);
-
-      uint8_t* sp = _hashes;
-      for (int i = 0; i < MAX_PACKET_HASHES; i++, sp += MAX_HASH_SIZE) {
-        if (memcmp(hash, sp, MAX_HASH_SIZE) == 0) { 
-          memset(sp, 0, MAX_HASH_SIZE);
-          break;
-        }
+      packet->calculateFingerprint(hash);
+
+      int i = _hash_index.find(hash);
+      if (i >= 0) {
+        _hash_index.remove(i);
+        memset(&_hashes[i*MAX_HASH_SIZE], 0, MAX_HASH_SIZE);
+        _hash_origin[i] = 0;
       }
     }
   }
@@ -107,5 +343,18 @@ public:
   uint32_t getNumDirectDups() const { return _direct_dups; }
   uint32_t getNumFloodDups() const { return _flood_dups; }
 
-  void resetStats() { _direct_dups = _flood_dups = 0; }
+  const DedupStats& getDedupStats() const { return _stats; }
+  int getCapacity() const { return MAX_PACKET_HASHES + MAX_PACKET_ACKS; }
+  int getCount() const {   // current occupancy
+    int n = 0;
+    for (int i = 0; i < MAX_PACKET_HASHES; i++) {
+      if (isHashUsed(i)) n++;
+    }
+    for (int i = 0; i < MAX_PACKET_ACKS; i++) {
+      if (_acks[i]) n++;
+    }
+    return n;
+  }
+
+  void resetStats() { _direct_dups = _flood_dups = 0; _stats.reset(); }
 };
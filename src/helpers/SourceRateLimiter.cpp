@@ -0,0 +1,66 @@
+#include "SourceRateLimiter.h"
+#include <string.h>
+
+SourceRateLimiter::SourceRateLimiter(uint16_t per_min, uint16_t burst) : _per_min(per_min), _burst(burst) {
+  memset(_buckets, 0, sizeof(_buckets));
+  _num_denied = 0;
+}
+
+int SourceRateLimiter::findSourceKey(const mesh::Packet* packet) {
+  switch (packet->getPayloadType()) {
+    case PAYLOAD_TYPE_REQ:
+    case PAYLOAD_TYPE_RESPONSE:
+    case PAYLOAD_TYPE_TXT_MSG:
+    case PAYLOAD_TYPE_PATH:
+      if (packet->payload_len > packet->getDatagramHashSize()) return packet->payload[packet->getDatagramHashSize()];   // src_hash
+      break;
+    case PAYLOAD_TYPE_ADVERT:
+      if (packet->payload_len > 0) return packet->payload[0];   // first byte of pub_key
+      break;
+  }
+  if (packet->isRouteFlood() && packet->path_len > 0) return packet->path[0];   // where it entered the mesh
+  return -1;  // unknown
+}
+
+SourceRateLimiter::Bucket* SourceRateLimiter::getBucket(uint8_t key, unsigned long now_millis) {
+  Bucket* lru = &_buckets[0];
+  for (int i = 0; i < SOURCE_RATE_SLOTS; i++) {
+    auto b = &_buckets[i];
+    if (b->used && b->key == key) return b;
+    if (!b->used) { lru = b; break; }
+    if ((long)(b->last_refill - lru->last_refill) < 0) lru = b;
+  }
+  lru->used = true;    // new source, starts with full bucket
+  lru->key = key;
+  lru->tokens = _burst * 1000;
+  lru->last_refill = now_millis;
+  return lru;
+}
+
+bool SourceRateLimiter::allow(const mesh::Packet* packet, unsigned long now_millis) {
+  if (_per_min == 0) return true;   // disabled
+
+  uint8_t type = packet->getPayloadType();
+  if (type == PAYLOAD_TYPE_ACK || (type == PAYLOAD_TYPE_MULTIPART && packet->payload_len > 0
+      && (packet->payload[0] & 0x0F) == PAYLOAD_TYPE_ACK)) {
+    return true;   // ACKs are never limited (dropping them just causes resends)
+  }
+  int key = findSourceKey(packet);
+  if (key < 0) return true;   // don't lump all unknown sources into one bucket
+
+  Bucket* b = getBucket(key, now_millis);
+
+  uint32_t elapsed = now_millis - b->last_refill;
+  if (elapsed > 600000) elapsed = 600000;   // 10 mins, long enough to be full again (and no overflow below)
+  uint32_t tokens = b->tokens + elapsed * _per_min / 60;   // x1000 per minute, is per_min/60 per milli
+  if (tokens > _burst * 1000) tokens = _burst * 1000;
+  b->tokens = tokens;
+  b->last_refill = now_millis;
+
+  if (b->tokens < 1000) {
+    _num_denied++;
+    return false;
+  }
+  b->tokens -= 1000;
+  return true;
+}
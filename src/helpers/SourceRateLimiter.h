@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Packet.h>
+
+#ifndef SOURCE_RATE_SLOTS
+  #define SOURCE_RATE_SLOTS    16
+#endif
+
+/**
+ * \brief  Token bucket per packet source, so that one chatty or malfunctioning node can't use up all of a repeater's
+ *     forwarding capacity. The source is the 1 byte src_hash for payloads which have one, else the hop the packet
+ *     first entered the mesh at (path[0]). Least recently used buckets are recycled for new sources.
+ *     Packets whose source can't be told (eg. DIRECT ACKs, TRACE, zero-hop floods), and ACKs, are never limited.
+*/
+class SourceRateLimiter {
+  struct Bucket {
+    uint8_t key;
+    bool used;
+    uint32_t tokens;       // x1000
+    unsigned long last_refill;
+  };
+  Bucket _buckets[SOURCE_RATE_SLOTS];
+  uint16_t _per_min, _burst;
+  uint32_t _num_denied;
+
+  Bucket* getBucket(uint8_t key, unsigned long now_millis);
+
+public:
+  /**
+   * \param  per_min  sustained rate allowed per source (zero to disable)
+   * \param  burst    max packets which can be sent back-to-back
+  */
+  SourceRateLimiter(uint16_t per_min, uint16_t burst);
+
+  bool allow(const mesh::Packet* packet, unsigned long now_millis);
+  uint32_t getNumDenied() const { return _num_denied; }
+
+  /**
+   * \returns  'source' of packet, or -1 if it can't be told
+  */
+  static int findSourceKey(const mesh::Packet* packet);
+
+  /**
+   * \returns  'source' of packet, for fair queuing (zero if it can't be told)
+  */
+  static uint8_t getSourceKey(const mesh::Packet* packet) {
+    int key = findSourceKey(packet);
+    return key < 0 ? 0 : key;
+  }
+};
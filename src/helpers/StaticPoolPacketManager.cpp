@@ -1,4 +1,5 @@
 #include "StaticPoolPacketManager.h"
+#include <stddef.h>
 
 PacketQueue::PacketQueue(int max_entries) {
   _table = new mesh::Packet*[max_entries];
@@ -6,6 +7,7 @@ PacketQueue::PacketQueue(int max_entries) {
   _schedule_table = new uint32_t[max_entries];
   _size = max_entries;
   _num = 0;
+  _aging = 0;
 }
 
 int PacketQueue::countBefore(uint32_t now) const {
@@ -17,19 +19,33 @@ int PacketQueue::countBefore(uint32_t now) const {
   return n;
 }
 
-mesh::Packet* PacketQueue::get(uint32_t now) {
-  uint8_t min_pri = 0xFF;
+bool PacketQueue::getEarliest(uint32_t* scheduled_for) const {
+  if (_num == 0) return false;
+  uint32_t t = _schedule_table[0];
+  for (int j = 1; j < _num; j++) {
+    if (_schedule_table[j] < t) t = _schedule_table[j];
+  }
+  *scheduled_for = t;
+  return true;
+}
+
+mesh::Packet* PacketQueue::get(uint32_t now, uint32_t* scheduled_for, uint8_t* priority) {
+  uint32_t min_rank = 0;
   int best_idx = -1;
   for (int j = 0; j < _num; j++) {
     if (_schedule_table[j] > now) continue;   // scheduled for future... ignore for now
-    if (_pri_table[j] < min_pri) {  // select most important priority amongst non-future entries
-      min_pri = _pri_table[j];
+    // with aging, an entry gains one priority step for every '_aging' millis it has been due
+    uint32_t rank = _aging ? _pri_table[j] + _schedule_table[j] / _aging : _pri_table[j];
+    if (best_idx < 0 || (int32_t)(rank - min_rank) < 0) {  // select most important priority amongst non-future entries
+      min_rank = rank;
       best_idx = j;
     }
   }
   if (best_idx < 0) return NULL;   // empty, or all items are still in the future
 
   mesh::Packet* top = _table[best_idx];
+  if (scheduled_for) *scheduled_for = _schedule_table[best_idx];
+  if (priority) *priority = _pri_table[best_idx];
   int i = best_idx;
   _num--;
   while (i < _num) {
@@ -66,34 +82,107 @@ void PacketQueue::add(mesh::Packet* packet, uint8_t priority, uint32_t scheduled
   _num++;
 }
 
-StaticPoolPacketManager::StaticPoolPacketManager(int pool_size): unused(pool_size), send_queue(pool_size), rx_queue(pool_size) {
+PacketPool::PacketPool(int pool_size) {
+  _stack = new mesh::Packet*[pool_size];
+  _size = pool_size;
   // load up our unusued Packet pool
-  for (int i = 0; i < pool_size; i++) {
-    unused.add(new mesh::Packet(), 0, 0);
+  for (_num = 0; _num < pool_size; _num++) {
+    _stack[_num] = new mesh::Packet();
+  }
+}
+
+#define SLAB_HEADER_SIZE   offsetof(mesh::Packet, payload)
+
+PacketSlab::PacketSlab(int num_small, int num_medium) {
+  _size[0] = num_small;
+  _size[1] = num_medium;
+  _slot_size[0] = (SLAB_HEADER_SIZE + PACKET_SLAB_SMALL_PAYLOAD + 3) & ~3;   // keep slots 4-byte aligned
+  _slot_size[1] = (SLAB_HEADER_SIZE + PACKET_SLAB_MEDIUM_PAYLOAD + 3) & ~3;
+  for (int c = 0; c < 2; c++) {
+    _mem[c] = _size[c] > 0 ? new uint8_t[_size[c] * _slot_size[c]] : NULL;
+    _stack[c] = _size[c] > 0 ? new uint8_t*[_size[c]] : NULL;
+    for (_num[c] = 0; _num[c] < _size[c]; _num[c]++) {
+      _stack[c][_num[c]] = &_mem[c][_num[c] * _slot_size[c]];
+    }
   }
 }
 
+int PacketSlab::classOf(const mesh::Packet* packet) const {
+  const uint8_t* p = (const uint8_t *) packet;
+  for (int c = 0; c < 2; c++) {
+    if (_size[c] > 0 && p >= _mem[c] && p < &_mem[c][_size[c] * _slot_size[c]]) return c;
+  }
+  return -1;   // not one of ours
+}
+
+mesh::Packet* PacketSlab::shrink(const mesh::Packet* packet) {
+  if (classOf(packet) >= 0) return NULL;   // is already truncated
+
+  for (int c = 0; c < 2; c++) {
+    if (_num[c] == 0 || SLAB_HEADER_SIZE + packet->payload_len > _slot_size[c]) continue;
+
+    uint8_t* slot = _stack[c][--_num[c]];
+    memcpy(slot, packet, SLAB_HEADER_SIZE + packet->payload_len);   // just the header fields, and payload used
+    return (mesh::Packet *) slot;
+  }
+  return NULL;
+}
+
+bool PacketSlab::free(mesh::Packet* packet) {
+  int c = classOf(packet);
+  if (c < 0) return false;
+  _stack[c][_num[c]++] = (uint8_t *) packet;
+  return true;
+}
+
+StaticPoolPacketManager::StaticPoolPacketManager(int pool_size, int slab_small, int slab_medium)
+  : unused(pool_size), slab(slab_small, slab_medium),
+    send_queue(pool_size + slab_small + slab_medium), rx_queue(pool_size) {
+}
+
+bool StaticPoolPacketManager::compactOutbound() {
+  for (int i = send_queue.count() - 1; i >= 0; i--) {   // most recently queued first (likely to wait longest)
+    mesh::Packet* packet = send_queue.itemAt(i);
+    mesh::Packet* copy = slab.shrink(packet);
+    if (copy == NULL) continue;   // already a slab packet, or no slot that fits
+
+    send_queue.replaceAt(i, copy);
+    unused.free(packet);
+    return true;
+  }
+  return false;
+}
+
 mesh::Packet* StaticPoolPacketManager::allocNew() {
-  return unused.removeByIdx(0);  // just get first one (returns NULL if empty)
+  mesh::Packet* packet = unused.alloc();
+  if (packet == NULL && compactOutbound()) packet = unused.alloc();
+  return packet;  // returns NULL if empty
 }
 
 void StaticPoolPacketManager::free(mesh::Packet* packet) {
-  unused.add(packet, 0, 0);
+  packet->_tx_channel = 0;   // local only, so don't leave it for the next user
+  if (!slab.free(packet) && !unused.free(packet)) {
+    MESH_DEBUG_PRINTLN("StaticPoolPacketManager::free(): WARNING: pool is full, double free?");
+  }
 }
 
 void StaticPoolPacketManager::queueOutbound(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) {
   send_queue.add(packet, priority, scheduled_for);
 }
 
-mesh::Packet* StaticPoolPacketManager::getNextOutbound(uint32_t now) {
+mesh::Packet* StaticPoolPacketManager::getNextOutbound(uint32_t now, uint8_t* priority, uint32_t* scheduled_for) {
   //send_queue.sort();   // sort by scheduled_for/priority first
-  return send_queue.get(now);
+  return send_queue.get(now, scheduled_for, priority);
 }
 
 int  StaticPoolPacketManager::getOutboundCount(uint32_t now) const {
   return send_queue.countBefore(now);
 }
 
+bool StaticPoolPacketManager::getNextOutboundTime(uint32_t* scheduled_for) const {
+  return send_queue.getEarliest(scheduled_for);
+}
+
 int StaticPoolPacketManager::getFreeCount() const {
   return unused.count();
 }
@@ -104,10 +193,18 @@ mesh::Packet* StaticPoolPacketManager::getOutboundByIdx(int i) {
 mesh::Packet* StaticPoolPacketManager::removeOutboundByIdx(int i) {
   return send_queue.removeByIdx(i);
 }
+bool StaticPoolPacketManager::getOutboundTimeByIdx(int i, uint32_t* scheduled_for) const {
+  if (i < 0 || i >= send_queue.count()) return false;
+  *scheduled_for = send_queue.timeAt(i);
+  return true;
+}
 
 void StaticPoolPacketManager::queueInbound(mesh::Packet* packet, uint32_t scheduled_for) {
   rx_queue.add(packet, 0, scheduled_for);
 }
-mesh::Packet* StaticPoolPacketManager::getNextInbound(uint32_t now) {
-  return rx_queue.get(now);
+mesh::Packet* StaticPoolPacketManager::getNextInbound(uint32_t now, uint32_t* scheduled_for) {
+  return rx_queue.get(now, scheduled_for);
+}
+bool StaticPoolPacketManager::getNextInboundTime(uint32_t* scheduled_for) const {
+  return rx_queue.getEarliest(scheduled_for);
 }
@@ -7,31 +7,102 @@ class PacketQueue {
   uint8_t* _pri_table;
   uint32_t* _schedule_table;
   int _size, _num;
+  uint32_t _aging;
 
 public:
   PacketQueue(int max_entries);
-  mesh::Packet* get(uint32_t now);
+  mesh::Packet* get(uint32_t now, uint32_t* scheduled_for=NULL, uint8_t* priority=NULL);
   void add(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for);
+  void setAging(uint32_t millis) { _aging = millis; }
   int count() const { return _num; }
   int countBefore(uint32_t now) const;
+  bool getEarliest(uint32_t* scheduled_for) const;
   mesh::Packet* itemAt(int i) const { return _table[i]; }
+  uint32_t timeAt(int i) const { return _schedule_table[i]; }
+  void replaceAt(int i, mesh::Packet* packet) { _table[i] = packet; }
   mesh::Packet* removeByIdx(int i);
 };
 
+/**
+ * \brief  A fixed-size stack of unused Packets. alloc() and free() are both O(1).
+*/
+class PacketPool {
+  mesh::Packet** _stack;
+  int _size, _num;
+
+public:
+  PacketPool(int pool_size);
+  mesh::Packet* alloc() { return _num > 0 ? _stack[--_num] : NULL; }
+  bool free(mesh::Packet* packet) {
+    if (_num >= _size) return false;   // not one of ours (pool is already full)
+    _stack[_num++] = packet;
+    return true;
+  }
+  int count() const { return _num; }
+};
+
+#ifndef PACKET_SLAB_SMALL_PAYLOAD
+  #define PACKET_SLAB_SMALL_PAYLOAD    40    // eg. ACKs (must be >= MAX_PACKED_ACKS*4, as queued ACKs can be packed into)
+#endif
+#ifndef PACKET_SLAB_MEDIUM_PAYLOAD
+  #define PACKET_SLAB_MEDIUM_PAYLOAD  112    // eg. most direct messages and returned paths
+#endif
+
+/**
+ * \brief  Fixed slots for Packets truncated to a smaller payload capacity, in small and medium size classes.
+ *     When the pool runs out, a queued (waiting to be sent) Packet can be moved into one of these, so its full-size
+ *     Packet can be re-used. The same RAM then holds 2-3x more in-flight packets. alloc() and free() are both O(1).
+ *     NOTE: a slab Packet's payload[] must not be written beyond its capacity, ie. only its queued contents are kept.
+*/
+class PacketSlab {
+  uint8_t* _mem[2];
+  uint8_t** _stack[2];
+  int _size[2], _num[2];
+  uint16_t _slot_size[2];
+
+  int classOf(const mesh::Packet* packet) const;
+
+public:
+  PacketSlab(int num_small, int num_medium);
+
+  /**
+   * \returns  a copy of 'packet' in the smallest free slot that fits it, or NULL if none (or is already a slab Packet)
+   */
+  mesh::Packet* shrink(const mesh::Packet* packet);
+
+  /**
+   * \returns  true if 'packet' is one of ours (and is now free again)
+   */
+  bool free(mesh::Packet* packet);
+
+  int getTotalSlots() const { return _size[0] + _size[1]; }
+};
+
 class StaticPoolPacketManager : public mesh::PacketManager {
-  PacketQueue unused, send_queue, rx_queue;
+  PacketPool unused;
+  PacketSlab slab;
+  PacketQueue send_queue, rx_queue;
+
+  bool compactOutbound();
 
 public:
-  StaticPoolPacketManager(int pool_size);
+  /**
+   * \param  slab_small, slab_medium   number of slots in each PacketSlab size class (zero for none)
+   */
+  StaticPoolPacketManager(int pool_size, int slab_small=0, int slab_medium=0);
 
   mesh::Packet* allocNew() override;
   void free(mesh::Packet* packet) override;
   void queueOutbound(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) override;
-  mesh::Packet* getNextOutbound(uint32_t now) override;
+  mesh::Packet* getNextOutbound(uint32_t now, uint8_t* priority=NULL, uint32_t* scheduled_for=NULL) override;
+  void setOutboundAging(uint32_t millis) override { send_queue.setAging(millis); }
   int getOutboundCount(uint32_t now) const override;
+  bool getNextOutboundTime(uint32_t* scheduled_for) const override;
   int getFreeCount() const override;
   mesh::Packet* getOutboundByIdx(int i) override;
   mesh::Packet* removeOutboundByIdx(int i) override;
   void queueInbound(mesh::Packet* packet, uint32_t scheduled_for) override;
-  mesh::Packet* getNextInbound(uint32_t now) override;
+  mesh::Packet* getNextInbound(uint32_t now, uint32_t* scheduled_for=NULL) override;
+  bool getNextInboundTime(uint32_t* scheduled_for) const override;
+  bool getOutboundTimeByIdx(int i, uint32_t* scheduled_for) const override;
 };
\ No newline at end of file
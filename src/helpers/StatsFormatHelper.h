@@ -1,6 +1,11 @@
 #pragma once
 
 #include "Mesh.h"
+#include <helpers/SimpleMeshTables.h>
+#include <helpers/MemoryStats.h>
+#include <LoopMonitor.h>
+
+#define STATS_REPLY_MAX_LEN   160
 
 class StatsFormatHelper {
 public:
@@ -40,15 +45,84 @@ public:
                                uint32_t n_sent_flood,
                                uint32_t n_sent_direct,
                                uint32_t n_recv_flood,
-                               uint32_t n_recv_direct) {
+                               uint32_t n_recv_direct,
+                               uint32_t n_rx_late) {
     sprintf(reply, 
-      "{\"recv\":%u,\"sent\":%u,\"flood_tx\":%u,\"direct_tx\":%u,\"flood_rx\":%u,\"direct_rx\":%u}",
+      "{\"recv\":%u,\"sent\":%u,\"flood_tx\":%u,\"direct_tx\":%u,\"flood_rx\":%u,\"direct_rx\":%u,\"rx_late\":%u}",
       driver.getPacketsRecv(),
       driver.getPacketsSent(),
       n_sent_flood,
       n_sent_direct,
       n_recv_flood,
-      n_recv_direct
+      n_recv_direct,
+      n_rx_late
+    );
+  }
+
+  /**
+   * \brief  dedup table stats. 'dups' only lists the payload types with non-zero counts, as "type:count".
+  */
+  static void formatDedupStats(char* reply, const DedupStats& stats, int used, int capacity) {
+    int len = snprintf(reply, STATS_REPLY_MAX_LEN,
+      "{\"used\":%d,\"capacity\":%d,\"evictions\":%u,\"dup_air_secs\":%u,\"dups\":[",
+      used, capacity, stats.n_evictions, stats.dup_air_time / 1000
     );
+    bool first = true;
+    for (int t = 0; t < 16; t++) {
+      if (stats.dups_by_type[t] == 0) continue;
+      int n = snprintf(&reply[len], STATS_REPLY_MAX_LEN - len, "%s\"%d:%u\"", first ? "" : ",", t, stats.dups_by_type[t]);
+      if (len + n > STATS_REPLY_MAX_LEN - 3) {   // no more room
+        reply[len] = 0;
+        break;
+      }
+      len += n;
+      first = false;
+    }
+    strcpy(&reply[len], "]}");
+  }
+
+  /**
+   * \brief  'tables' is the total bytes of the app's static tables (see MemTable). 'stack_free' is by MEM_STACK_*
+  */
+  static void formatMemoryStats(char* reply, const MemoryStats& mem, uint32_t tables) {
+    sprintf(reply,
+      "{\"free_heap\":%u,\"min_free_heap\":%u,\"max_alloc\":%u,\"tables\":%u,\"stack_free\":[%u,%u,%u]}",
+      mem.free_heap, mem.min_free_heap, mem.max_alloc, tables,
+      mem.stack_free[MEM_STACK_LOOP], mem.stack_free[MEM_STACK_MESH], mem.stack_free[MEM_STACK_WRITER]
+    );
+  }
+
+  /**
+   * \brief  average cycles per received packet, by PROF_STAGE_*, of given payload 'type' (0xFF = all types).
+   *     For all types, also lists the types seen.
+  */
+  static void formatProfileStats(char* reply, const mesh::RecvProfiler& prof, uint8_t type) {
+    uint32_t count = 0;
+    for (int t = 0; t < 16; t++) {
+      if (type == 0xFF || t == type) count += prof.getCount(t);
+    }
+    int len = sprintf(reply, "{\"units\":\"%s\",\"count\":%u,\"avg\":[", prof.isCycles() ? "cycles" : "micros", count);
+    for (int s = 0; s < PROF_STAGE_NUM; s++) {
+      len += sprintf(&reply[len], "%s%u", s ? "," : "", prof.getAvgCycles(type, s));
+    }
+    if (type == 0xFF) {
+      len += sprintf(&reply[len], "],\"types\":[");
+      bool first = true;
+      for (int t = 0; t < 16; t++) {
+        if (prof.getCount(t) == 0) continue;
+        len += sprintf(&reply[len], "%s%d", first ? "" : ",", t);
+        first = false;
+      }
+    }
+    strcpy(&reply[len], "]}");
+  }
+
+  static void formatLoopStats(char* reply, const mesh::LoopMonitor& mon) {
+    int len = sprintf(reply, "{\"iters\":%u,\"max_ms\":%u,\"max_in\":\"%s\",\"p99_ms\":%u,\"stalls\":{",
+      mon.getCount(), mon.getMaxMillis(), mesh::LoopMonitor::getSectionName(mon.getMaxSection()), mon.getPercentile(99));
+    for (int s = 0; s < LOOP_SECT_NUM; s++) {
+      len += sprintf(&reply[len], "%s\"%s\":%u", s ? "," : "", mesh::LoopMonitor::getSectionName(s), mon.getNumStalls(s));
+    }
+    strcpy(&reply[len], "}}");
   }
 };
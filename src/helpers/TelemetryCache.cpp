@@ -0,0 +1,36 @@
+#include "TelemetryCache.h"
+
+int TelemetryCache::get(uint8_t perms, uint8_t* dest, unsigned long now) const {
+  for (int i = 0; i < TELEMETRY_CACHE_SLOTS; i++) {
+    auto e = &_entries[i];
+    if (e->in_use && e->perms == perms && now - e->taken_at < TELEMETRY_CACHE_TTL_MILLIS) {
+      memcpy(dest, e->data, e->len);
+      return e->len;
+    }
+  }
+  return 0;   // not cached
+}
+
+void TelemetryCache::put(uint8_t perms, const uint8_t* src, int len, unsigned long now) {
+  if (len <= 0 || len > TELEMETRY_CACHE_MAX_LEN) return;
+
+  Entry* slot = NULL;
+  for (int i = 0; i < TELEMETRY_CACHE_SLOTS; i++) {
+    auto e = &_entries[i];
+    if (e->in_use && e->perms == perms) { slot = e; break; }   // replace existing
+    if (slot == NULL || (slot->in_use && (!e->in_use || (long)(e->taken_at - slot->taken_at) < 0))) {
+      slot = e;   // unused, or oldest so far
+    }
+  }
+  slot->perms = perms;
+  slot->len = len;
+  slot->taken_at = now;
+  slot->in_use = true;
+  memcpy(slot->data, src, len);
+}
+
+void TelemetryCache::invalidate() {
+  for (int i = 0; i < TELEMETRY_CACHE_SLOTS; i++) {
+    _entries[i].in_use = false;
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Mesh.h>
+
+#ifndef TELEMETRY_CACHE_SLOTS
+  #define TELEMETRY_CACHE_SLOTS       3       // distinct permission masks cached at once (eg. guest, admin, self)
+#endif
+#ifndef TELEMETRY_CACHE_TTL_MILLIS
+  #define TELEMETRY_CACHE_TTL_MILLIS  30000   // how long a snapshot is good for
+#endif
+
+#define TELEMETRY_CACHE_MAX_LEN   (MAX_PACKET_PAYLOAD - 4)   // (reply has 4 byte tag)
+
+/**
+ * \brief  Holds the most recent CayenneLPP telemetry snapshot for each requester permission mask, so repeated
+ *     GET_TELEMETRY requests (eg. from several collectors) within TELEMETRY_CACHE_TTL_MILLIS don't each re-read
+ *     (slow, I2C) sensors and re-encode the LPP.
+*/
+class TelemetryCache {
+  struct Entry {
+    unsigned long taken_at;
+    uint8_t perms;
+    uint8_t len;
+    bool in_use;
+    uint8_t data[TELEMETRY_CACHE_MAX_LEN];
+  };
+  Entry _entries[TELEMETRY_CACHE_SLOTS];
+
+public:
+  TelemetryCache() { invalidate(); }
+
+  /**
+   * \brief  copies a fresh snapshot for 'perms' to 'dest' (at least TELEMETRY_CACHE_MAX_LEN bytes)
+   * \returns  length of snapshot, or zero if none cached (or is too old)
+  */
+  int get(uint8_t perms, uint8_t* dest, unsigned long now) const;
+
+  /**
+   * \brief  stores a snapshot just taken, replacing the one for 'perms', else the oldest
+  */
+  void put(uint8_t perms, const uint8_t* src, int len, unsigned long now);
+
+  /** \brief  forget all snapshots, eg. when a sensor reading has changed significantly */
+  void invalidate();
+};
@@ -0,0 +1,82 @@
+#include "TimedMeshTables.h"
+
+#define PRUNE_ALL_AFTER_MILLIS   (30000UL*1000)   // before 16-bit timestamps could alias
+
+TimedMeshTables::TimedMeshTables(mesh::MillisecondClock& ms, uint16_t window_secs) : _ms(&ms), _index(&_keys[0]) {
+  _window_secs = window_secs;
+  memset(_keys, 0, sizeof(_keys));
+  memset(_stamps, 0, sizeof(_stamps));
+  _head = _num = 0;
+  _high_water = 0;
+  _last_prune = _ms->getMillis();
+  _direct_dups = _flood_dups = _early_evictions = 0;
+  _stats.reset();
+  _radio = NULL;
+}
+
+void TimedMeshTables::makeKey(uint8_t* key, const mesh::Packet* packet) {
+  if (packet->getPayloadType() == PAYLOAD_TYPE_ACK) {
+    memcpy(key, packet->payload, 4);   // the ack CRC
+    memset(&key[4], 0xAC, MAX_HASH_SIZE - 4);   // so can't match a packet hash (practically)
+  } else {
+    packet->calculateFingerprint(key);
+  }
+}
+
+void TimedMeshTables::evictOldest() {
+  _index.remove(_head);
+  memset(&_keys[_head*MAX_HASH_SIZE], 0, MAX_HASH_SIZE);
+  _head = (_head + 1) % TIMED_TABLE_MAX_ENTRIES;
+  _num--;
+}
+
+void TimedMeshTables::prune() {
+  if (_ms->getMillis() - _last_prune > PRUNE_ALL_AFTER_MILLIS) {   // been idle a long time, everything has expired
+    while (_num > 0) evictOldest();
+  }
+  _last_prune = _ms->getMillis();
+
+  uint16_t now = nowSecs();
+  while (_num > 0 && (uint16_t)(now - _stamps[_head]) >= _window_secs) {
+    evictOldest();
+  }
+}
+
+bool TimedMeshTables::hasSeen(const mesh::Packet* packet) {
+  prune();
+
+  uint8_t key[MAX_HASH_SIZE];
+  makeKey(key, packet);
+  if (_index.find(key) >= 0) {
+    if (packet->isRouteDirect()) {
+      _direct_dups++;   // keep some stats
+    } else {
+      _flood_dups++;
+    }
+    _stats.countDup(packet, _radio);
+    return true;
+  }
+
+  if (_num == TIMED_TABLE_MAX_ENTRIES) {   // table is full, oldest is still within window
+    evictOldest();
+    _early_evictions++;
+    _stats.n_evictions++;
+  }
+  int i = (_head + _num) % TIMED_TABLE_MAX_ENTRIES;
+  memcpy(&_keys[i*MAX_HASH_SIZE], key, MAX_HASH_SIZE);
+  _stamps[i] = nowSecs();
+  _index.insert(i);
+  _num++;
+  if (_num > _high_water) _high_water = _num;
+  return false;
+}
+
+void TimedMeshTables::clear(const mesh::Packet* packet) {
+  uint8_t key[MAX_HASH_SIZE];
+  makeKey(key, packet);
+  int i = _index.find(key);
+  if (i >= 0) {
+    _index.remove(i);
+    memset(&_keys[i*MAX_HASH_SIZE], 0, MAX_HASH_SIZE);   // slot stays in FIFO, until it ages out
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <helpers/SimpleMeshTables.h>
+
+#ifndef TIMED_TABLE_MAX_ENTRIES
+  #define TIMED_TABLE_MAX_ENTRIES   512
+#endif
+
+/**
+ * \brief  MeshTables impl which remembers each packet hash (or ACK) for a minimum time window, rather than
+ *     for a fixed number of packets. Entries are kept in arrival order (FIFO), each with a compact 16-bit timestamp
+ *     (seconds), and are only dropped once older than the window. So, the number of live entries grows and shrinks
+ *     with channel traffic, up to TIMED_TABLE_MAX_ENTRIES. If the table is full, the oldest entry is evicted
+ *     early (before its window expired), and this is counted.
+*/
+class TimedMeshTables : public mesh::MeshTables {
+  mesh::MillisecondClock* _ms;
+  uint16_t _window_secs;
+  uint8_t _keys[TIMED_TABLE_MAX_ENTRIES*MAX_HASH_SIZE];
+  uint16_t _stamps[TIMED_TABLE_MAX_ENTRIES];
+  int _head, _num;   // _head is oldest entry
+  int _high_water;
+  unsigned long _last_prune;
+  uint32_t _direct_dups, _flood_dups, _early_evictions;
+  DedupStats _stats;
+  mesh::Radio* _radio;
+  CyclicTableIndex<TIMED_TABLE_MAX_ENTRIES, MAX_HASH_SIZE> _index;
+
+  uint16_t nowSecs() const { return (uint16_t) (_ms->getMillis() / 1000); }
+  static void makeKey(uint8_t* key, const mesh::Packet* packet);
+  void prune();
+  void evictOldest();
+
+public:
+  /**
+   * \param  window_secs  minimum time to remember a packet for. (must be less than 30000 secs)
+  */
+  TimedMeshTables(mesh::MillisecondClock& ms, uint16_t window_secs);
+
+  void setRadio(mesh::Radio* radio) { _radio = radio; }   // (optional) to estimate airtime of duplicates
+
+  bool hasSeen(const mesh::Packet* packet) override;
+  void clear(const mesh::Packet* packet) override;
+
+  int getCount() const { return _num; }
+  int getCapacity() const { return TIMED_TABLE_MAX_ENTRIES; }
+  int getHighWater() const { return _high_water; }
+  uint32_t getNumEarlyEvictions() const { return _early_evictions; }   // entries dropped before window expired
+
+  uint32_t getNumDirectDups() const { return _direct_dups; }
+  uint32_t getNumFloodDups() const { return _flood_dups; }
+
+  const DedupStats& getDedupStats() const { return _stats; }   // n_evictions is same as getNumEarlyEvictions()
+
+  void resetStats() { _direct_dups = _flood_dups = _early_evictions = 0; _high_water = _num; _stats.reset(); }
+};
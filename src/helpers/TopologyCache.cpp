@@ -0,0 +1,95 @@
+#include "TopologyCache.h"
+
+TopoRoute* TopologyCache::find(uint8_t hash, uint32_t now) {
+  for (int i = 0; i < TOPO_ROUTE_SLOTS; i++) {
+    auto r = &_routes[i];
+    if (r->learned && r->hash == hash && now - r->learned < TOPO_ROUTE_MAX_AGE) return r;
+  }
+  return NULL;  // not known
+}
+
+void TopologyCache::learnRoute(uint8_t hash, const uint8_t* route, uint8_t len, uint32_t now) {
+  if (len > TOPO_MAX_ROUTE_LEN) return;
+
+  TopoRoute* r = find(hash, now);
+  if (r) {
+    if (len > r->len) return;   // already know a shorter one
+  } else {
+    r = &_routes[0];
+    for (int i = 0; i < TOPO_ROUTE_SLOTS; i++) {   // find unused/expired slot, or else the oldest
+      auto s = &_routes[i];
+      if (s->learned == 0 || now - s->learned >= TOPO_ROUTE_MAX_AGE) { r = s; break; }
+      if (s->learned < r->learned) r = s;
+    }
+  }
+  r->hash = hash;
+  memcpy(r->route, route, r->len = len);
+  r->learned = now ? now : 1;
+}
+
+void TopologyCache::learnFloodPath(const uint8_t* path, uint8_t path_len, uint8_t self_hash, uint32_t now) {
+  if (mesh::Packet::decodePathHashSize(path_len) != PATH_HASH_SIZE) return;   // routes are just PATH_HASH_SIZE hashes
+  path_len = mesh::Packet::decodePathBytes(path_len);
+  uint8_t rev[MAX_PATH_SIZE];   // reverse of path is route from here, so rev[m] is reached via rev[0..m-1]
+  for (int i = 0; i < path_len; i++) {
+    rev[i] = path[path_len - 1 - i];
+  }
+  for (int m = 0; m < path_len && m <= TOPO_MAX_ROUTE_LEN; m++) {
+    if (rev[m] == self_hash) break;   // looped back through here
+    learnRoute(rev[m], rev, m, now);
+  }
+}
+
+void TopologyCache::learnDirectPath(const uint8_t* path, uint8_t path_len, uint8_t self_hash, uint32_t now) {
+  if (mesh::Packet::decodePathHashSize(path_len) != PATH_HASH_SIZE) return;
+  path_len = mesh::Packet::decodePathBytes(path_len);
+  for (int m = 0; m < path_len && m <= TOPO_MAX_ROUTE_LEN; m++) {
+    if (path[m] == self_hash) break;
+    learnRoute(path[m], path, m, now);
+  }
+}
+
+void TopologyCache::forget(uint8_t hash) {
+  for (int i = 0; i < TOPO_ROUTE_SLOTS; i++) {
+    if (_routes[i].learned && _routes[i].hash == hash) _routes[i].learned = 0;
+  }
+}
+
+int TopologyCache::buildPath(const uint8_t* flood_path, uint8_t flood_len, uint8_t* dest, int* via_hash, uint32_t now) {
+  // default is just the reverse of flood_path (flood_path[0] is the hop nearest the node)
+  int best_len = flood_len;
+  int best_j = -1;
+  TopoRoute* best = NULL;
+  for (int j = 0; j < flood_len; j++) {
+    TopoRoute* r = find(flood_path[j], now);
+    if (r && r->len + 1 + j < best_len) {   // shortcut: known route to this hop, then back along the flood path
+      best_len = r->len + 1 + j;
+      best_j = j;
+      best = r;
+    }
+  }
+
+  int n = 0;
+  if (best) {
+    memcpy(dest, best->route, best->len); n += best->len;
+    for (int j = best_j; j >= 0; j--) {
+      dest[n++] = flood_path[j];
+    }
+    *via_hash = best->hash;
+  } else {
+    for (int j = flood_len - 1; j >= 0; j--) {
+      dest[n++] = flood_path[j];
+    }
+    *via_hash = -1;
+  }
+  return n;
+}
+
+int TopologyCache::getCount(uint32_t now) {
+  int n = 0;
+  for (int i = 0; i < TOPO_ROUTE_SLOTS; i++) {
+    auto r = &_routes[i];
+    if (r->learned && now - r->learned < TOPO_ROUTE_MAX_AGE) n++;
+  }
+  return n;
+}
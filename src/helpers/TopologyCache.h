@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Mesh.h>
+
+#ifndef TOPO_ROUTE_SLOTS
+  #define TOPO_ROUTE_SLOTS     32
+#endif
+#define TOPO_MAX_ROUTE_LEN      8            // longer routes to a repeater aren't worth remembering
+#define TOPO_ROUTE_MAX_AGE      (6*60*60)    // secs, after which a learned route is no longer trusted
+
+#if PATH_HASH_SIZE != 1
+  #error "TopologyCache needs impl for PATH_HASH_SIZE"
+#endif
+
+struct TopoRoute {
+  uint8_t hash;         // of repeater
+  uint8_t len;          // hops from here, to the repeater (not including it)
+  uint8_t route[TOPO_MAX_ROUTE_LEN];
+  uint32_t learned;     // by OUR clock, zero if slot unused
+};
+
+/**
+ * \brief  Remembers the shortest recently seen direct route from this node to each repeater (by path hash), as learned
+ *     from the paths of received flood packets, and from direct paths known to work. Can then build a direct path to a
+ *     node with no known out_path, by taking the path its advert flooded along, and cutting across to the repeater
+ *     nearest to it that we already know a shorter route to.
+*/
+class TopologyCache {
+  TopoRoute _routes[TOPO_ROUTE_SLOTS];
+
+  TopoRoute* find(uint8_t hash, uint32_t now);
+
+public:
+  TopologyCache() { memset(_routes, 0, sizeof(_routes)); }
+
+  /**
+   * \brief  learn route to 'hash', if is shorter than (or as short as) the one already known
+  */
+  void learnRoute(uint8_t hash, const uint8_t* route, uint8_t len, uint32_t now);
+
+  /**
+   * \brief  learn from the path of a flood packet, received here. (path[0] is the hop nearest the origin)
+   *     NOTE: path_len is encoded (see Packet::getEncodedPathLen()), and paths with wide hashes are ignored
+  */
+  void learnFloodPath(const uint8_t* path, uint8_t path_len, uint8_t self_hash, uint32_t now);
+
+  /**
+   * \brief  learn from a direct path, from here, which is known to work (same NOTE as learnFloodPath())
+  */
+  void learnDirectPath(const uint8_t* path, uint8_t path_len, uint8_t self_hash, uint32_t now);
+
+  void forget(uint8_t hash);
+
+  /**
+   * \brief  build a direct path to a node, from the path its flood packet arrived by
+   * \param  dest   (OUT) the path, must be MAX_PATH_SIZE
+   * \param  via_hash  (OUT) the repeater whose learned route was used (so it can be forgotten if path fails), or -1
+   * \returns  length of path built
+  */
+  int buildPath(const uint8_t* flood_path, uint8_t flood_len, uint8_t* dest, int* via_hash, uint32_t now);
+
+  int getCount(uint32_t now);
+};
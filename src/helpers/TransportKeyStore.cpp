@@ -18,25 +18,59 @@ uint16_t TransportKey::calcTransportCode(const mesh::Packet* packet) const {
 }
 
 bool TransportKey::isNull() const {
-  for (int i = 0; i < sizeof(key); i++) {
+  for (int i = 0; i < (int) sizeof(key); i++) {
     if (key[i]) return false;
   }
   return true;  // key is all zeroes
 }
 
+void TransportKeyStore::invalidateCache() {
+  memset(cache_used, 0, sizeof(cache_used));
+  memset(buckets, -1, sizeof(buckets));
+  _tick = 0;
+}
+
+void TransportKeyStore::unlinkEntry(int i) {
+  int8_t* p = &buckets[bucketFor(cache_ids[i])];
+  while (*p >= 0) {
+    if (*p == i) {
+      *p = cache_next[i];
+      break;
+    }
+    p = &cache_next[*p];
+  }
+  cache_used[i] = 0;
+}
+
+void TransportKeyStore::invalidateCache(uint16_t id) {
+  int i = buckets[bucketFor(id)];
+  while (i >= 0) {
+    int nxt = cache_next[i];
+    if (cache_ids[i] == id) unlinkEntry(i);
+    i = nxt;
+  }
+}
+
 void TransportKeyStore::putCache(uint16_t id, const TransportKey& key) {
-  if (num_cache < MAX_TKS_ENTRIES) {
-    cache_ids[num_cache] = id;
-    cache_keys[num_cache] = key;
-    num_cache++;
-  } else {
-    // TODO: evict oldest cache entry
+  int i = 0;
+  for (int j = 1; j < MAX_TKS_ENTRIES; j++) {   // find free entry, or else the least recently used
+    if (cache_used[i] == 0) break;
+    if (cache_used[j] < cache_used[i]) i = j;
   }
+  if (cache_used[i]) unlinkEntry(i);   // evict
+
+  cache_ids[i] = id;
+  cache_keys[i] = key;
+  cache_used[i] = ++_tick;
+  int b = bucketFor(id);
+  cache_next[i] = buckets[b];
+  buckets[b] = i;
 }
 
 void TransportKeyStore::getAutoKeyFor(uint16_t id, const char* name, TransportKey& dest) {
-  for (int i = 0; i < num_cache; i++) {  // first, check cache
+  for (int i = buckets[bucketFor(id)]; i >= 0; i = cache_next[i]) {  // first, check cache
     if (cache_ids[i] == id) {   // cache hit!
+      cache_used[i] = ++_tick;
       dest = cache_keys[i];
       return;
     }
@@ -49,10 +83,16 @@ void TransportKeyStore::getAutoKeyFor(uint16_t id, const char* name, TransportKe
   putCache(id, dest);
 }
 
+void TransportKeyStore::putAutoKey(uint16_t id, const TransportKey& key) {
+  invalidateCache(id);
+  putCache(id, key);
+}
+
 int TransportKeyStore::loadKeysFor(uint16_t id, TransportKey keys[], int max_num) {
   int n = 0;
-  for (int i = 0; i < num_cache && n < max_num; i++) {  // first, check cache
+  for (int i = buckets[bucketFor(id)]; i >= 0 && n < max_num; i = cache_next[i]) {  // first, check cache
     if (cache_ids[i] == id) {
+      cache_used[i] = ++_tick;
       keys[n++] = cache_keys[i];
     }
   }
@@ -68,7 +108,7 @@ int TransportKeyStore::loadKeysFor(uint16_t id, TransportKey keys[], int max_num
 }
 
 bool TransportKeyStore::saveKeysFor(uint16_t id, const TransportKey keys[], int num) {
-  invalidateCache();
+  invalidateCache(id);
 
   // TODO: update hardware keystore
 
@@ -76,7 +116,7 @@ bool TransportKeyStore::saveKeysFor(uint16_t id, const TransportKey keys[], int
 }
 
 bool TransportKeyStore::removeKeys(uint16_t id) {
-  invalidateCache();
+  invalidateCache(id);
 
   // TODO: remove from hardware keystore
 
@@ -11,19 +11,37 @@ struct TransportKey {
   bool isNull() const;
 };
 
-#define MAX_TKS_ENTRIES   16
+#ifndef MAX_TKS_ENTRIES
+  #define MAX_TKS_ENTRIES   32
+#endif
+#define TKS_HASH_BUCKETS    16   // must be power of 2
 
+#if MAX_TKS_ENTRIES > 127
+  #error "MAX_TKS_ENTRIES too big"
+#endif
+
+/**
+ * \brief  Cache of transport keys, by region id. Lookups are by (id) hash buckets, and when full the least recently
+ *     used entry is evicted. An id can have several keys.
+*/
 class TransportKeyStore {
   uint16_t     cache_ids[MAX_TKS_ENTRIES];
   TransportKey cache_keys[MAX_TKS_ENTRIES];
-  int num_cache;
+  uint32_t     cache_used[MAX_TKS_ENTRIES];   // for LRU, zero if entry is free
+  int8_t       cache_next[MAX_TKS_ENTRIES];   // next entry in same bucket, or -1
+  int8_t       buckets[TKS_HASH_BUCKETS];
+  uint32_t     _tick;
 
+  static int bucketFor(uint16_t id) { return id & (TKS_HASH_BUCKETS - 1); }
   void putCache(uint16_t id, const TransportKey& key);
-  void invalidateCache() { num_cache = 0; }
+  void unlinkEntry(int i);
+  void invalidateCache(uint16_t id);
+  void invalidateCache();
 
 public:
-  TransportKeyStore() { num_cache = 0; }
+  TransportKeyStore() { invalidateCache(); }
   void getAutoKeyFor(uint16_t id, const char* name, TransportKey& dest);
+  void putAutoKey(uint16_t id, const TransportKey& key);   // eg. as previously derived, kept with region map
   int loadKeysFor(uint16_t id, TransportKey keys[], int max_num);
   bool saveKeysFor(uint16_t id, const TransportKey keys[], int num);
   bool removeKeys(uint16_t id);
@@ -0,0 +1,79 @@
+#include "TxtCodec.h"
+#include <string.h>
+
+#define CODE_FIRST   0x80
+#define CODE_ESCAPE  0xFF
+
+// NOTE: order is part of the wire format, so only ever append (up to 127 entries)
+static const char* dict[] = {
+  " the ", "the ", " the", "ing ", " and ", "and ", " you", "you", "tion", " to ", " of ", " is ", " in ", " it ",
+  "that", " for", "here", "ing", "the", "and", "ent", "ion", "for", "not", "are", "was", "all", "have", "with",
+  "this", "what", "just", "will", "can", "but", "out", "get", "now", "how", "one", "ere", "ver", "ter", "ate",
+  "our", "ll ", "'s ", "'t ", "e ", "s ", "t ", "d ", "y ", "n ", "r ", "o ", "a ", "k ", "g ", "l ", "m ", ", ",
+  ". ", "? ", "! ", " a", " b", " c", " d", " f", " g", " h", " i", " m", " n", " o", " p", " s", " t", " w", " l",
+  " r", "th", "he", "in", "er", "an", "re", "on", "at", "en", "nd", "ed", "es", "or", "te", "ti", "is", "it", "ar",
+  "st", "to", "nt", "ng", "se", "ha", "ou", "le", "al", "me", "ea", "ve", "hi", "co", "de", "ro", "ri", "io", "ra",
+  "ne", "ic", "li", "ll", "ch", "ma", "ke", "lo"
+};
+#define DICT_SIZE   ((int) (sizeof(dict) / sizeof(dict[0])))
+
+int TxtCodec::compress(uint8_t* dest, int dest_max, const char* src, int src_len) {
+  int n = 0;
+  int i = 0;
+  while (i < src_len) {
+    int best = -1, best_len = 1;
+    for (int k = 0; k < DICT_SIZE; k++) {   // longest match
+      int len = strlen(dict[k]);
+      if (len > best_len && len <= src_len - i && memcmp(&src[i], dict[k], len) == 0) {
+        best = k;
+        best_len = len;
+      }
+    }
+
+    uint8_t c = src[i];
+    if (best >= 0) {
+      if (n >= dest_max) return 0;
+      dest[n++] = CODE_FIRST + best;
+    } else if (c >= 0x01 && c < CODE_FIRST) {
+      if (n >= dest_max) return 0;
+      dest[n++] = c;
+    } else {
+      if (c == 0 || n + 2 > dest_max) return 0;
+      dest[n++] = CODE_ESCAPE;
+      dest[n++] = c;
+    }
+    i += best_len;
+
+    if (n >= src_len) return 0;   // not a saving
+  }
+  return n;
+}
+
+int TxtCodec::decompress(char* dest, int dest_max, const uint8_t* src, int src_len) {
+  int n = 0;
+  for (int i = 0; i < src_len; i++) {
+    uint8_t c = src[i];
+    if (c == CODE_ESCAPE) {
+      if (++i >= src_len || n + 1 >= dest_max) return -1;
+      dest[n++] = src[i];
+    } else if (c >= CODE_FIRST) {
+      if (c - CODE_FIRST >= DICT_SIZE) return -1;   // unknown code (newer dictionary?)
+      const char* s = dict[c - CODE_FIRST];
+      int len = strlen(s);
+      if (n + len >= dest_max) return -1;
+      memcpy(&dest[n], s, len);
+      n += len;
+    } else {
+      if (c == 0 || n + 1 >= dest_max) return -1;
+      dest[n++] = c;
+    }
+  }
+  dest[n] = 0;
+  return n;
+}
+
+char* TxtCodec::unpack(char* txt, bool compressed, char* buf, int buf_sz) {
+  if (!compressed) return txt;
+  if (decompress(buf, buf_sz, (const uint8_t *) txt, strlen(txt)) < 0) return NULL;
+  return buf;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TXT_CODEC_MAX_TEXT   160    // longest text that will be unpacked
+
+#ifndef TXT_COMPRESSION
+  #define TXT_COMPRESSION    0      // send text compressed. All can receive it, but older firmware can't
+#endif
+
+/**
+ * \brief  Short string compressor for message text, with a static dictionary of common English fragments (in the
+ *     manner of Smaz). Printable ASCII is copied as is, dictionary fragments become one byte (0x80..0xFE), and any other
+ *     byte is escaped (0xFF, byte). Output never contains a zero byte, so can still be treated as a C string on the
+ *     receiving end (eg. for ACK hash calcs).
+*/
+class TxtCodec {
+public:
+  /**
+   * \returns  length of compressed text in 'dest', or zero if it wouldn't be any shorter (send it plain instead)
+  */
+  static int compress(uint8_t* dest, int dest_max, const char* src, int src_len);
+
+  /**
+   * \returns  length of text in 'dest' (which is null terminated), or -1 if invalid or too long
+  */
+  static int decompress(char* dest, int dest_max, const uint8_t* src, int src_len);
+
+  /**
+   * \brief  helper for receivers of TXT_MSG, GRP_TXT.
+   * \param  txt  the (null terminated) text from the payload
+   * \param  buf  where to decompress, if 'compressed', should be TXT_CODEC_MAX_TEXT+1
+   * \returns  'txt' if not compressed, else 'buf', or NULL if invalid
+  */
+  static char* unpack(char* txt, bool compressed, char* buf, int buf_sz);
+};
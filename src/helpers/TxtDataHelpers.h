@@ -7,6 +7,10 @@
 #define TXT_TYPE_CLI_DATA       1    // a CLI command
 #define TXT_TYPE_SIGNED_PLAIN   2    // plain text, signed by sender
 
+#define TXT_TYPE_COMPRESSED     0x20 // flag, OR'd with above: text is packed with TxtCodec
+
+#define TXT_ACK_TRAILER_SIZE    4    // an ACK for the recipient, after the text's null terminator (ignored by older firmware)
+
 class StrHelper {
 public:
   static void strncpy(char* dest, const char* src, size_t buf_sz);
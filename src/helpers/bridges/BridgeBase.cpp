@@ -16,16 +16,87 @@ const char *BridgeBase::getLogDateTime() {
 }
 
 uint16_t BridgeBase::fletcher16(const uint8_t *data, size_t len) {
-  uint8_t sum1 = 0, sum2 = 0;
+  uint32_t sum1 = 0, sum2 = 0;
 
-  for (size_t i = 0; i < len; i++) {
-    sum1 = (sum1 + data[i]) % 255;
-    sum2 = (sum2 + sum1) % 255;
+  while (len > 0) {
+    size_t n = len < 5802 ? len : 5802;   // most bytes before sum2 could overflow, so only need modulo per block
+    len -= n;
+    while (n--) {
+      sum1 += *data++;
+      sum2 += sum1;
+    }
+    sum1 %= 255;
+    sum2 %= 255;
   }
 
   return (sum2 << 8) | sum1;
 }
 
+void BridgeBase::xorCrypt(uint8_t *data, size_t len) {
+  size_t keyLen = strlen(_prefs->bridge_secret);
+  if (keyLen == 0) return;   // no secret, so sent in the clear
+  for (size_t i = 0; i < len; i++) {
+    data[i] ^= _prefs->bridge_secret[i % keyLen];
+  }
+}
+
+static const uint32_t crc32_nibble_table[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t BridgeBase::crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+    crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+void BridgeBase::addToBatch(const mesh::Packet *packet, size_t max_len) {
+  size_t len = packet->getRawLength();
+  if (max_len > sizeof(_batch)) max_len = sizeof(_batch);
+  if (_batch_len + 2 + len > max_len) flushBatch();   // won't fit, so send what we have first
+
+  if (_batch_len == 0) _batch_start = millis();
+  _stats.n_packets_out++;
+  _batch[_batch_len++] = (len >> 8) & 0xFF;
+  _batch[_batch_len++] = len & 0xFF;
+  _batch_len += packet->writeTo(&_batch[_batch_len]);
+}
+
+int BridgeBase::receiveBatch(const uint8_t *data, size_t len) {
+  int n = 0;
+  size_t i = 0;
+  while (i < len) {
+    if (i + 2 > len) return -1;
+    size_t pkt_len = (data[i] << 8) | data[i + 1];
+    i += 2;
+    if (pkt_len == 0 || pkt_len > MAX_TRANS_UNIT || i + pkt_len > len) {
+      _stats.n_bad_frames++;
+      return -1;
+    }
+
+    mesh::Packet *pkt = _mgr->allocNew();
+    if (pkt == NULL) {
+      BRIDGE_DEBUG_PRINTLN("RX failed to allocate packet\n");
+      return n;   // rest of batch is lost
+    }
+    if (pkt->readFrom(&data[i], pkt_len)) {
+      onPacketReceived(pkt);
+      n++;
+    } else {
+      BRIDGE_DEBUG_PRINTLN("RX failed to parse packet\n");
+      _stats.n_bad_frames++;
+      _mgr->free(pkt);
+    }
+    i += pkt_len;
+  }
+  return n;
+}
+
 bool BridgeBase::validateChecksum(const uint8_t *data, size_t len, uint16_t received_checksum) {
   uint16_t calculated_checksum = fletcher16(data, len);
   return received_checksum == calculated_checksum;
@@ -39,10 +110,66 @@ void BridgeBase::handleReceivedPacket(mesh::Packet *packet) {
     return;
   }
 
-  if (!_seen_packets.hasSeen(packet)) {
+  _stats.n_packets_in++;
+  recordArrival(packet, true);
+
+  if (!_tables->hasBridged(packet)) {
     // bridge_delay provides a buffer to prevent immediate processing conflicts in the mesh network.
-    _mgr->queueInbound(packet, millis() + _prefs->bridge_delay);
+    _mgr->queueInbound(packet, millis() + getEffectiveDelay());
   } else {
+    _stats.n_dups++;
     _mgr->free(packet);
   }
 }
+
+int BridgeBase::getBatchCount() const {
+  int n = 0;
+  for (size_t i = 0; i + 2 <= _batch_len; n++) {
+    i += 2 + ((_batch[i] << 8) | _batch[i + 1]);
+  }
+  return n;
+}
+
+uint16_t BridgeBase::getEffectiveDelay() const {
+  return _prefs->bridge_delay == BRIDGE_DELAY_AUTO ? _auto_delay : _prefs->bridge_delay;
+}
+
+void BridgeBase::recordArrival(const mesh::Packet *packet, bool from_bridge) {
+  uint8_t fp[MAX_HASH_SIZE];
+  packet->calculateFingerprint(fp);
+  uint32_t fingerprint;
+  memcpy(&fingerprint, fp, sizeof(fingerprint));
+  unsigned long now = millis();
+
+  for (int i = 0; i < BRIDGE_ARRIVAL_SLOTS; i++) {
+    auto a = &_arrivals[i];
+    if (a->at == 0 || a->fingerprint != fingerprint || now - a->at > BRIDGE_AUTO_DELAY_MAX) continue;
+
+    if (a->paired || a->from_bridge == from_bridge) return;   // a later copy, only the first from each side counts
+    a->paired = true;
+
+    // offset is how much later the over-the-air copy arrived (negative if it was first)
+    long offset = from_bridge ? (long)(a->at - now) : (long)(now - a->at);
+    if (offset > BRIDGE_AUTO_DELAY_MAX) offset = BRIDGE_AUTO_DELAY_MAX;
+    if (offset < -BRIDGE_AUTO_DELAY_MAX) offset = -BRIDGE_AUTO_DELAY_MAX;
+    if (_stats.n_pairs++ == 0) {
+      _avg_offset = offset;
+      _offset_dev = abs(offset) / 2;
+    } else {
+      long err = offset - _avg_offset;
+      _avg_offset += err / 8;
+      _offset_dev += ((long)abs(err) - _offset_dev) / 4;
+    }
+    long d = _avg_offset + 4 * (long)_offset_dev;
+    _auto_delay = d < BRIDGE_AUTO_DELAY_MIN ? BRIDGE_AUTO_DELAY_MIN : (d > BRIDGE_AUTO_DELAY_MAX ? BRIDGE_AUTO_DELAY_MAX : d);
+    BRIDGE_DEBUG_PRINTLN("arrival offset=%ld, avg=%d, dev=%d\n", offset, _avg_offset, _offset_dev);
+    return;
+  }
+
+  auto a = &_arrivals[_next_arrival];   // first copy seen, so wait for the other side's
+  _next_arrival = (_next_arrival + 1) % BRIDGE_ARRIVAL_SLOTS;
+  a->fingerprint = fingerprint;
+  a->at = now ? now : 1;   // zero is unused
+  a->from_bridge = from_bridge;
+  a->paired = false;
+}
@@ -6,6 +6,33 @@
 
 #include <RTClib.h>
 
+#ifndef BRIDGE_BATCHING
+  #define BRIDGE_BATCHING        0     // send packets in batched frames. Needs this firmware on the other end (either is received)
+#endif
+#ifndef BRIDGE_BATCH_MILLIS
+  #define BRIDGE_BATCH_MILLIS    5     // max time a packet waits in a batch for more to join it
+#endif
+#ifndef BRIDGE_BATCH_MAX_SIZE
+  #define BRIDGE_BATCH_MAX_SIZE  1024  // bytes of [length, packet] entries in one batch (transports may allow less)
+#endif
+#ifndef BRIDGE_ARRIVAL_SLOTS
+  #define BRIDGE_ARRIVAL_SLOTS   8     // recent arrivals remembered, to pair bridged and over-the-air copies of a packet
+#endif
+#define BRIDGE_AUTO_DELAY_MIN    20    // millis, range of the adaptive bridge_delay
+#define BRIDGE_AUTO_DELAY_MAX    10000
+
+/**
+ * @brief Bridge link counters, cumulative from boot
+ */
+struct BridgeStats {
+  uint32_t n_frames_in, n_frames_out;     // transport frames (a batched frame holds several packets)
+  uint32_t n_packets_in, n_packets_out;
+  uint32_t n_bad_frames;                  // failed magic/checksum/CRC, or malformed
+  uint32_t n_dups;                        // received from the bridge, but already across it (eg. looped back)
+  uint32_t n_pairs;                       // packets heard both over the bridge and the air, ie. arrival offset samples
+  uint32_t n_rx_dropped;                  // received frames dropped as the queue to loop() was full (ESP-NOW)
+};
+
 /**
  * @brief Base class implementing common bridge functionality
  *
@@ -14,7 +41,7 @@
  *
  * Features:
  * - Fletcher-16 checksum calculation for data integrity
- * - Packet duplicate detection using SimpleMeshTables
+ * - Packet duplicate detection, sharing the mesh's SimpleMeshTables
  * - Common timestamp formatting for debug logging
  * - Shared packet management and queuing logic
  */
@@ -29,6 +56,30 @@ public:
    */
   bool isRunning() const override;
 
+  /**
+   * @brief To be called for every packet received over the air (whatever bridge.source is), to measure how much
+   * later (or earlier) it arrives than the bridged copy of the same packet
+   *
+   * @param packet The packet received by the radio
+   */
+  void onRadioRecv(const mesh::Packet *packet) { recordArrival(packet, false); }
+
+  /** @return the link counters */
+  const BridgeStats &getStats() const { return _stats; }
+
+  /** @return packets waiting in the pending batch */
+  int getBatchCount() const;
+
+  /**
+   * @return the delay applied to received packets, in millis. If _prefs->bridge_delay is BRIDGE_DELAY_AUTO, this is
+   * tuned from the arrival offsets: mean + 4 x mean deviation (as for a TCP retransmit timeout)
+   */
+  uint16_t getEffectiveDelay() const;
+
+  /** @return smoothed arrival offset in millis. Positive if over-the-air copies arrive after the bridged ones */
+  int16_t getAvgOffset() const { return _avg_offset; }
+  uint16_t getOffsetDeviation() const { return _offset_dev; }
+
   /**
    * @brief Common magic number used by all bridge implementations for packet identification
    *
@@ -37,6 +88,14 @@ public:
    */
   static constexpr uint16_t BRIDGE_PACKET_MAGIC = 0xC03E;
 
+  /**
+   * @brief Magic number of a batched frame, holding several mesh packets with a single CRC-32
+   *
+   * The body of a batched frame is a sequence of entries: [2 bytes] packet length, then the packet itself.
+   */
+  static constexpr uint16_t BRIDGE_BATCH_MAGIC = 0xC03F;
+  static constexpr uint16_t BRIDGE_CRC32_SIZE = sizeof(uint32_t);
+
   /**
    * @brief Common field sizes used by bridge implementations
    *
@@ -62,8 +121,35 @@ protected:
   /** Node preferences for configuration settings */
   NodePrefs *_prefs;
 
-  /** Tracks seen packets to prevent loops in broadcast communications */
-  SimpleMeshTables _seen_packets;
+  /** The mesh's tables, to track packets already across the bridge (prevents loops in broadcast communications) */
+  SimpleMeshTables *_tables;
+
+  /** Entries of the batch being built (BRIDGE_BATCHING), and when its first packet was added */
+  uint8_t _batch[BRIDGE_BATCH_MAX_SIZE];
+  size_t _batch_len = 0;
+  unsigned long _batch_start = 0;
+
+  /** Link counters, updated by the implementations as frames are sent/received */
+  BridgeStats _stats = {};
+
+  /** Recent arrivals, by fingerprint, waiting for the copy from the other side (bridge or air) */
+  struct Arrival {
+    uint32_t fingerprint;
+    unsigned long at;
+    bool from_bridge;
+    bool paired;
+  };
+  Arrival _arrivals[BRIDGE_ARRIVAL_SLOTS] = {};
+  int _next_arrival = 0;
+  int16_t _avg_offset = 0;
+  uint16_t _offset_dev = 0;
+  uint16_t _auto_delay = 500;
+
+  /**
+   * @brief Notes the arrival of a packet, from the bridge or the air, and if the other copy has been seen recently,
+   * updates the arrival offset (and adaptive delay)
+   */
+  void recordArrival(const mesh::Packet *packet, bool from_bridge);
 
   /**
    * @brief Constructs a BridgeBase instance
@@ -71,9 +157,10 @@ protected:
    * @param prefs Node preferences for configuration settings
    * @param mgr PacketManager for allocating and queuing packets
    * @param rtc RTCClock for timestamping debug messages
+   * @param tables The mesh's own tables, shared for duplicate detection
    */
-  BridgeBase(NodePrefs *prefs, mesh::PacketManager *mgr, mesh::RTCClock *rtc)
-      : _prefs(prefs), _mgr(mgr), _rtc(rtc) {}
+  BridgeBase(NodePrefs *prefs, mesh::PacketManager *mgr, mesh::RTCClock *rtc, SimpleMeshTables *tables)
+      : _prefs(prefs), _mgr(mgr), _rtc(rtc), _tables(tables) {}
 
   /**
    * @brief Gets formatted date/time string for logging
@@ -106,11 +193,65 @@ protected:
    */
   bool validateChecksum(const uint8_t *data, size_t len, uint16_t received_checksum);
 
+  /**
+   * @brief Performs XOR encryption/decryption of data
+   * Used to isolate different mesh networks sharing the same transport (ESP-NOW, UDP)
+   *
+   * Uses _prefs->bridge_secret as the key in a simple XOR operation.
+   * The same operation is used for both encryption and decryption.
+   * While not cryptographically secure, it provides basic network isolation.
+   *
+   * @param data Pointer to data to encrypt/decrypt
+   * @param len Length of data in bytes
+   */
+  void xorCrypt(uint8_t *data, size_t len);
+
+  /**
+   * @brief Calculate CRC-32 (IEEE 802.3), used for batched frames
+   *
+   * Uses a 16 entry (nibble) table, as a compromise between speed and flash/RAM
+   *
+   * @param data Pointer to data to calculate CRC for
+   * @param len Length of data in bytes
+   * @return Calculated CRC-32
+   */
+  static uint32_t crc32(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Adds a packet to the pending batch, sending the batch first (with flushBatch()) if it won't fit
+   *
+   * @param packet The mesh packet to add
+   * @param max_len Max length of the batch's entries for this transport
+   */
+  void addToBatch(const mesh::Packet *packet, size_t max_len);
+
+  /**
+   * @brief Sends the pending batch as one frame, if it isn't empty
+   */
+  virtual void flushBatch() = 0;
+
+  /**
+   * @brief Sends the pending batch once its first packet has waited BRIDGE_BATCH_MILLIS. Call from loop()
+   */
+  void checkBatchTimeout() {
+    if (_batch_len > 0 && millis() - _batch_start >= BRIDGE_BATCH_MILLIS) flushBatch();
+  }
+
+  /**
+   * @brief Parses the entries of a received batched frame (already CRC checked), passing each packet to
+   * onPacketReceived()
+   *
+   * @param data The entries
+   * @param len Length of entries in bytes
+   * @return Number of packets received, or -1 if entries are malformed
+   */
+  int receiveBatch(const uint8_t *data, size_t len);
+
   /**
    * @brief Common packet handling for received packets
    *
    * Implements the standard pattern used by all bridges:
-   * - Check if packet was seen before using _seen_packets.hasSeen()
+   * - Check if packet was already across the bridge using _tables->hasBridged()
    * - Queue packet for mesh processing if not seen before
    * - Free packet if already seen to prevent duplicates
    *
@@ -10,9 +10,13 @@ ESPNowBridge *ESPNowBridge::_instance = nullptr;
 
 // Static callback wrappers
 void ESPNowBridge::recv_cb(const uint8_t *mac, const uint8_t *data, int32_t len) {
-  if (_instance) {
-    _instance->onDataRecv(mac, data, len);
-  }
+  // NOTE: runs in the Wi-Fi task, so just hand the frame over to loop()
+  if (_instance == nullptr || len <= 0 || len > (int32_t)MAX_ESPNOW_PACKET_SIZE) return;
+
+  RxFrame frame;
+  memcpy(frame.data, data, len);
+  frame.len = len;
+  _instance->_rx_frames.push(frame);   // if full, is counted (see loop())
 }
 
 void ESPNowBridge::send_cb(const uint8_t *mac, esp_now_send_status_t status) {
@@ -21,8 +25,8 @@ void ESPNowBridge::send_cb(const uint8_t *mac, esp_now_send_status_t status) {
   }
 }
 
-ESPNowBridge::ESPNowBridge(NodePrefs *prefs, mesh::PacketManager *mgr, mesh::RTCClock *rtc)
-    : BridgeBase(prefs, mgr, rtc), _rx_buffer_pos(0) {
+ESPNowBridge::ESPNowBridge(NodePrefs *prefs, mesh::PacketManager *mgr, mesh::RTCClock *rtc, SimpleMeshTables *tables)
+    : BridgeBase(prefs, mgr, rtc, tables) {
   _instance = this;
 }
 
@@ -90,17 +94,16 @@ void ESPNowBridge::end() {
 }
 
 void ESPNowBridge::loop() {
-  // Nothing to do here - ESP-NOW is callback based
-}
-
-void ESPNowBridge::xorCrypt(uint8_t *data, size_t len) {
-  size_t keyLen = strlen(_prefs->bridge_secret);
-  for (size_t i = 0; i < len; i++) {
-    data[i] ^= _prefs->bridge_secret[i % keyLen];
+  RxFrame frame;
+  while (_rx_frames.pop(frame)) {
+    onDataRecv(frame.data, frame.len);
   }
+  _stats.n_rx_dropped = _rx_frames.getNumDropped();
+
+  checkBatchTimeout();
 }
 
-void ESPNowBridge::onDataRecv(const uint8_t *mac, const uint8_t *data, int32_t len) {
+void ESPNowBridge::onDataRecv(const uint8_t *data, int32_t len) {
   // Ignore packets that are too small to contain header + checksum
   if (len < (BRIDGE_MAGIC_SIZE + BRIDGE_CHECKSUM_SIZE)) {
     BRIDGE_DEBUG_PRINTLN("RX packet too small, len=%d\n", len);
@@ -115,8 +118,13 @@ void ESPNowBridge::onDataRecv(const uint8_t *mac, const uint8_t *data, int32_t l
 
   // Check packet header magic
   uint16_t received_magic = (data[0] << 8) | data[1];
+  if (received_magic == BRIDGE_BATCH_MAGIC) {
+    onBatchRecv(data, len);
+    return;
+  }
   if (received_magic != BRIDGE_PACKET_MAGIC) {
     BRIDGE_DEBUG_PRINTLN("RX invalid magic 0x%04X\n", received_magic);
+    _stats.n_bad_frames++;
     return;
   }
 
@@ -135,20 +143,76 @@ void ESPNowBridge::onDataRecv(const uint8_t *mac, const uint8_t *data, int32_t l
   if (!validateChecksum(decrypted + BRIDGE_CHECKSUM_SIZE, payloadLen, received_checksum)) {
     // Failed to decrypt - likely from a different network
     BRIDGE_DEBUG_PRINTLN("RX checksum mismatch, rcv=0x%04X\n", received_checksum);
+    _stats.n_bad_frames++;
     return;
   }
 
   BRIDGE_DEBUG_PRINTLN("RX, payload_len=%d\n", payloadLen);
+  _stats.n_frames_in++;
 
   // Create mesh packet
-  mesh::Packet *pkt = _instance->_mgr->allocNew();
+  mesh::Packet *pkt = _mgr->allocNew();
   if (!pkt) return;
 
   if (pkt->readFrom(decrypted + BRIDGE_CHECKSUM_SIZE, payloadLen)) {
-    _instance->onPacketReceived(pkt);
+    onPacketReceived(pkt);
+  } else {
+    _mgr->free(pkt);
+  }
+}
+
+void ESPNowBridge::onBatchRecv(const uint8_t *data, int32_t len) {
+  if (len < (BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE)) {
+    BRIDGE_DEBUG_PRINTLN("RX batch too small, len=%d\n", len);
+    return;
+  }
+
+  uint8_t decrypted[MAX_ESPNOW_PACKET_SIZE];
+  const size_t encryptedDataLen = len - BRIDGE_MAGIC_SIZE;
+  memcpy(decrypted, data + BRIDGE_MAGIC_SIZE, encryptedDataLen);
+  xorCrypt(decrypted, encryptedDataLen);
+
+  uint32_t received_crc = ((uint32_t)decrypted[0] << 24) | ((uint32_t)decrypted[1] << 16) | (decrypted[2] << 8) | decrypted[3];
+  const uint8_t *entries = decrypted + BRIDGE_CRC32_SIZE;
+  const size_t entriesLen = encryptedDataLen - BRIDGE_CRC32_SIZE;
+  if (crc32(entries, entriesLen) != received_crc) {
+    // Failed to decrypt - likely from a different network
+    BRIDGE_DEBUG_PRINTLN("RX batch CRC mismatch, rcv=0x%08X\n", received_crc);
+    _stats.n_bad_frames++;
+    return;
+  }
+  _stats.n_frames_in++;
+
+  int n = receiveBatch(entries, entriesLen);
+  BRIDGE_DEBUG_PRINTLN("RX batch, len=%d packets=%d\n", entriesLen, n);
+}
+
+void ESPNowBridge::flushBatch() {
+  if (_batch_len == 0) return;
+
+  uint8_t buffer[MAX_ESPNOW_PACKET_SIZE];
+  buffer[0] = (BRIDGE_BATCH_MAGIC >> 8) & 0xFF;
+  buffer[1] = BRIDGE_BATCH_MAGIC & 0xFF;
+
+  uint32_t crc = crc32(_batch, _batch_len);
+  buffer[2] = (crc >> 24) & 0xFF;
+  buffer[3] = (crc >> 16) & 0xFF;
+  buffer[4] = (crc >> 8) & 0xFF;
+  buffer[5] = crc & 0xFF;
+  memcpy(buffer + BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE, _batch, _batch_len);
+
+  // Encrypt CRC and entries (not including magic header)
+  xorCrypt(buffer + BRIDGE_MAGIC_SIZE, BRIDGE_CRC32_SIZE + _batch_len);
+
+  uint8_t broadcastAddress[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+  esp_err_t result = esp_now_send(broadcastAddress, buffer, BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE + _batch_len);
+  if (result == ESP_OK) {
+    BRIDGE_DEBUG_PRINTLN("TX batch, len=%d\n", _batch_len);
+    _stats.n_frames_out++;
   } else {
-    _instance->_mgr->free(pkt);
+    BRIDGE_DEBUG_PRINTLN("TX batch FAILED!\n");
   }
+  _batch_len = 0;
 }
 
 void ESPNowBridge::onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
@@ -167,7 +231,12 @@ void ESPNowBridge::sendPacket(mesh::Packet *packet) {
     return;
   }
 
-  if (!_seen_packets.hasSeen(packet)) {
+  if (!_tables->hasBridged(packet)) {
+#if BRIDGE_BATCHING
+    addToBatch(packet, MAX_BATCH_SIZE);
+    return;
+#endif
+
     // Create a temporary buffer just for size calculation and reuse for actual writing
     uint8_t sizingBuffer[MAX_PAYLOAD_SIZE];
     uint16_t meshPacketLen = packet->writeTo(sizingBuffer);
@@ -206,6 +275,8 @@ void ESPNowBridge::sendPacket(mesh::Packet *packet) {
 
     if (result == ESP_OK) {
       BRIDGE_DEBUG_PRINTLN("TX, len=%d\n", meshPacketLen);
+      _stats.n_frames_out++;
+      _stats.n_packets_out++;
     } else {
       BRIDGE_DEBUG_PRINTLN("TX FAILED!\n");
     }
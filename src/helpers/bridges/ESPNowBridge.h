@@ -3,9 +3,14 @@
 #include "MeshCore.h"
 #include "esp_now.h"
 #include "helpers/bridges/BridgeBase.h"
+#include "helpers/SPSCQueue.h"
 
 #ifdef WITH_ESPNOW_BRIDGE
 
+#ifndef ESPNOW_RX_FRAMES
+  #define ESPNOW_RX_FRAMES   8     // received frames waiting for loop(), must be a power of 2
+#endif
+
 /**
  * @brief Bridge implementation using ESP-NOW protocol for packet transport
  *
@@ -18,6 +23,7 @@
  * - Network isolation using XOR encryption with shared secret
  * - Duplicate packet detection using SimpleMeshTables tracking
  * - Maximum packet size of 250 bytes (ESP-NOW limitation)
+ * - Optional batched frames (BRIDGE_BATCHING), several packets per ESP-NOW frame with one CRC-32
  *
  * Packet Structure:
  * [2 bytes] Magic Header - Used to identify ESPNowBridge packets
@@ -34,6 +40,10 @@
  * - Define WITH_ESPNOW_BRIDGE to enable this bridge
  * - Define _prefs->bridge_secret with a string to set the network encryption key
  *
+ * Threading:
+ * ESP-NOW calls recv_cb() in the Wi-Fi task, so it only copies the frame into a lock-free queue. Everything else
+ * (decrypting, duplicate detection via the mesh's tables, stats, packet allocation) is done by loop(), in the main task.
+ *
  * Network Isolation:
  * Multiple independent mesh networks can coexist by using different
  * _prefs->bridge_secret values. Packets encrypted with a different key will
@@ -63,34 +73,35 @@ private:
    */
   static const size_t MAX_PAYLOAD_SIZE = MAX_ESPNOW_PACKET_SIZE - (BRIDGE_MAGIC_SIZE + BRIDGE_CHECKSUM_SIZE);
 
-  /** Buffer for receiving ESP-NOW packets */
-  uint8_t _rx_buffer[MAX_ESPNOW_PACKET_SIZE];
+  /**
+   * Max length of the entries of a batched frame: magic header (2) + CRC-32 (4) + entries
+   */
+  static const size_t MAX_BATCH_SIZE = MAX_ESPNOW_PACKET_SIZE - (BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE);
+
+  /** A received frame, as copied by recv_cb() */
+  struct RxFrame {
+    uint8_t data[MAX_ESPNOW_PACKET_SIZE];
+    uint8_t len;
+  };
 
-  /** Current position in receive buffer */
-  size_t _rx_buffer_pos;
+  /** Frames from the Wi-Fi task (producer) to loop() (consumer) */
+  SPSCQueue<RxFrame, ESPNOW_RX_FRAMES> _rx_frames;
 
   /**
-   * Performs XOR encryption/decryption of data
-   * Used to isolate different mesh networks
+   * Handles a received frame, taken from the queue by loop()
    *
-   * Uses _prefs->bridge_secret as the key in a simple XOR operation.
-   * The same operation is used for both encryption and decryption.
-   * While not cryptographically secure, it provides basic network isolation.
-   *
-   * @param data Pointer to data to encrypt/decrypt
-   * @param len Length of data in bytes
+   * @param data Received data
+   * @param len Length of received data
    */
-  void xorCrypt(uint8_t *data, size_t len);
+  void onDataRecv(const uint8_t *data, int32_t len);
 
   /**
-   * ESP-NOW receive callback
-   * Called by ESP-NOW when a packet is received
+   * Handles a received batched frame (BRIDGE_BATCH_MAGIC)
    *
-   * @param mac Source MAC address
-   * @param data Received data
+   * @param data Received data, from the magic header
    * @param len Length of received data
    */
-  void onDataRecv(const uint8_t *mac, const uint8_t *data, int32_t len);
+  void onBatchRecv(const uint8_t *data, int32_t len);
 
   /**
    * ESP-NOW send callback
@@ -108,8 +119,9 @@ public:
    * @param prefs Node preferences for configuration settings
    * @param mgr PacketManager for allocating and queuing packets
    * @param rtc RTCClock for timestamping debug messages
+   * @param tables The mesh's own tables, shared for duplicate detection
    */
-  ESPNowBridge(NodePrefs *prefs, mesh::PacketManager *mgr, mesh::RTCClock *rtc);
+  ESPNowBridge(NodePrefs *prefs, mesh::PacketManager *mgr, mesh::RTCClock *rtc, SimpleMeshTables *tables);
 
   /**
    * Initializes the ESP-NOW bridge
@@ -133,7 +145,7 @@ public:
 
   /**
    * Main loop handler
-   * ESP-NOW is callback-based, so this is currently empty
+   * Handles the frames queued by the receive callback, and sends any batch that's waited long enough
    */
   void loop() override;
 
@@ -152,6 +164,9 @@ public:
    * @param packet The mesh packet to transmit
    */
   void sendPacket(mesh::Packet *packet) override;
+
+protected:
+  void flushBatch() override;
 };
 
 #endif
@@ -4,8 +4,8 @@
 
 #ifdef WITH_RS232_BRIDGE
 
-RS232Bridge::RS232Bridge(NodePrefs *prefs, Stream &serial, mesh::PacketManager *mgr, mesh::RTCClock *rtc)
-    : BridgeBase(prefs, mgr, rtc), _serial(&serial) {}
+RS232Bridge::RS232Bridge(NodePrefs *prefs, Stream &serial, mesh::PacketManager *mgr, mesh::RTCClock *rtc, SimpleMeshTables *tables)
+    : BridgeBase(prefs, mgr, rtc, tables), _serial(&serial) {}
 
 void RS232Bridge::begin() {
   BRIDGE_DEBUG_PRINTLN("Initializing at %d baud...\n", _prefs->bridge_baud);
@@ -48,59 +48,90 @@ void RS232Bridge::loop() {
     return;
   }
 
-  while (_serial->available()) {
-    uint8_t b = _serial->read();
+  checkBatchTimeout();
 
-    if (_rx_buffer_pos < 2) {
-      // Waiting for magic word
-      if ((_rx_buffer_pos == 0 && b == ((BRIDGE_PACKET_MAGIC >> 8) & 0xFF)) ||
-          (_rx_buffer_pos == 1 && b == (BRIDGE_PACKET_MAGIC & 0xFF))) {
-        _rx_buffer[_rx_buffer_pos++] = b;
+  int avail;
+  while ((avail = _serial->available()) > 0) {
+    // read in blocks, rather than a byte at a time
+    size_t space = sizeof(_rx_buffer) - _rx_buffer_pos;
+    int n = _serial->readBytes(&_rx_buffer[_rx_buffer_pos], (size_t)avail < space ? avail : space);
+    if (n <= 0) break;
+    _rx_buffer_pos += n;
+
+    parseRxBuffer();
+  }
+}
+
+size_t RS232Bridge::parseFrame(const uint8_t *frame, size_t avail) {
+  uint16_t magic = (frame[0] << 8) | frame[1];
+  uint16_t len = (frame[2] << 8) | frame[3];
+  const uint8_t *body = &frame[BRIDGE_MAGIC_SIZE + BRIDGE_LENGTH_SIZE];
+
+  if (magic == BRIDGE_PACKET_MAGIC) {
+    if (len > (MAX_TRANS_UNIT + 1)) {
+      BRIDGE_DEBUG_PRINTLN("RX invalid length %d, resetting\n", len);
+      return 1;   // not a real frame start
+    }
+    if (avail < len + SERIAL_OVERHEAD) return 0;   // need more
+
+    uint16_t received_checksum = (body[len] << 8) | body[len + 1];
+    if (!validateChecksum(body, len, received_checksum)) {
+      BRIDGE_DEBUG_PRINTLN("RX checksum mismatch, rcv=0x%04x\n", received_checksum);
+      _stats.n_bad_frames++;
+      return 1;
+    }
+    BRIDGE_DEBUG_PRINTLN("RX, len=%d crc=0x%04x\n", len, received_checksum);
+    _stats.n_frames_in++;
+    mesh::Packet *pkt = _mgr->allocNew();
+    if (pkt) {
+      if (pkt->readFrom(body, len)) {
+        onPacketReceived(pkt);
       } else {
-        // Invalid magic byte, reset and start over
-        _rx_buffer_pos = 0;
-        // Check if this byte could be the start of a new magic word
-        if (b == ((BRIDGE_PACKET_MAGIC >> 8) & 0xFF)) {
-          _rx_buffer[_rx_buffer_pos++] = b;
-        }
+        BRIDGE_DEBUG_PRINTLN("RX failed to parse packet\n");
+        _stats.n_bad_frames++;
+        _mgr->free(pkt);
       }
     } else {
-      // Reading length, payload, and checksum
-      _rx_buffer[_rx_buffer_pos++] = b;
-
-      if (_rx_buffer_pos >= 4) {
-        uint16_t len = (_rx_buffer[2] << 8) | _rx_buffer[3];
-
-        // Validate length field
-        if (len > (MAX_TRANS_UNIT + 1)) {
-          BRIDGE_DEBUG_PRINTLN("RX invalid length %d, resetting\n", len);
-          _rx_buffer_pos = 0; // Invalid length, reset
-          continue;
-        }
-
-        if (_rx_buffer_pos == len + SERIAL_OVERHEAD) { // Full packet received
-          uint16_t received_checksum = (_rx_buffer[4 + len] << 8) | _rx_buffer[5 + len];
-
-          if (validateChecksum(_rx_buffer + 4, len, received_checksum)) {
-            BRIDGE_DEBUG_PRINTLN("RX, len=%d crc=0x%04x\n", len, received_checksum);
-            mesh::Packet *pkt = _mgr->allocNew();
-            if (pkt) {
-              if (pkt->readFrom(_rx_buffer + 4, len)) {
-                onPacketReceived(pkt);
-              } else {
-                BRIDGE_DEBUG_PRINTLN("RX failed to parse packet\n");
-                _mgr->free(pkt);
-              }
-            } else {
-              BRIDGE_DEBUG_PRINTLN("RX failed to allocate packet\n");
-            }
-          } else {
-            BRIDGE_DEBUG_PRINTLN("RX checksum mismatch, rcv=0x%04x\n", received_checksum);
-          }
-          _rx_buffer_pos = 0; // Reset for next packet
-        }
-      }
+      BRIDGE_DEBUG_PRINTLN("RX failed to allocate packet\n");
     }
+    return len + SERIAL_OVERHEAD;
+  }
+
+  if (magic == BRIDGE_BATCH_MAGIC) {
+    if (len > BRIDGE_BATCH_MAX_SIZE) {
+      BRIDGE_DEBUG_PRINTLN("RX invalid batch length %d, resetting\n", len);
+      return 1;
+    }
+    if (avail < len + BATCH_OVERHEAD) return 0;   // need more
+
+    uint32_t received_crc = ((uint32_t)body[len] << 24) | ((uint32_t)body[len + 1] << 16) | (body[len + 2] << 8) | body[len + 3];
+    if (crc32(body, len) != received_crc) {
+      BRIDGE_DEBUG_PRINTLN("RX batch CRC mismatch, rcv=0x%08x\n", received_crc);
+      _stats.n_bad_frames++;
+      return 1;
+    }
+    if (receiveBatch(body, len) < 0) {   // (counted as bad frame)
+      BRIDGE_DEBUG_PRINTLN("RX malformed batch\n");
+      return 1;
+    }
+    BRIDGE_DEBUG_PRINTLN("RX batch, len=%d\n", len);
+    _stats.n_frames_in++;
+    return len + BATCH_OVERHEAD;
+  }
+
+  return 1;   // no magic here, keep looking
+}
+
+void RS232Bridge::parseRxBuffer() {
+  size_t start = 0;
+  while (_rx_buffer_pos - start >= BRIDGE_MAGIC_SIZE + BRIDGE_LENGTH_SIZE) {
+    size_t used = parseFrame(&_rx_buffer[start], _rx_buffer_pos - start);
+    if (used == 0) break;   // incomplete frame, wait for rest
+    start += used;
+  }
+  if (start > 0) {   // keep only the unparsed tail
+    memmove(_rx_buffer, &_rx_buffer[start], _rx_buffer_pos - start);
+    _rx_buffer_pos -= start;
   }
 }
 
@@ -116,7 +147,11 @@ void RS232Bridge::sendPacket(mesh::Packet *packet) {
     return;
   }
 
-  if (!_seen_packets.hasSeen(packet)) {
+  if (!_tables->hasBridged(packet)) {
+#if BRIDGE_BATCHING
+    addToBatch(packet, BRIDGE_BATCH_MAX_SIZE);
+    return;
+#endif
 
     uint8_t buffer[MAX_SERIAL_PACKET_SIZE];
     uint16_t len = packet->writeTo(buffer + 4);
@@ -141,11 +176,34 @@ void RS232Bridge::sendPacket(mesh::Packet *packet) {
 
     // Send complete packet
     _serial->write(buffer, len + SERIAL_OVERHEAD);
+    _stats.n_frames_out++;
+    _stats.n_packets_out++;
 
     BRIDGE_DEBUG_PRINTLN("TX, len=%d crc=0x%04x\n", len, checksum);
   }
 }
 
+void RS232Bridge::flushBatch() {
+  if (_batch_len == 0) return;
+
+  uint8_t hdr[BRIDGE_MAGIC_SIZE + BRIDGE_LENGTH_SIZE];
+  hdr[0] = (BRIDGE_BATCH_MAGIC >> 8) & 0xFF;
+  hdr[1] = BRIDGE_BATCH_MAGIC & 0xFF;
+  hdr[2] = (_batch_len >> 8) & 0xFF;
+  hdr[3] = _batch_len & 0xFF;
+
+  uint32_t crc = crc32(_batch, _batch_len);
+  uint8_t trailer[BRIDGE_CRC32_SIZE] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+
+  _serial->write(hdr, sizeof(hdr));
+  _serial->write(_batch, _batch_len);
+  _serial->write(trailer, sizeof(trailer));
+  _stats.n_frames_out++;
+
+  BRIDGE_DEBUG_PRINTLN("TX batch, len=%d crc=0x%08x\n", _batch_len, crc);
+  _batch_len = 0;
+}
+
 void RS232Bridge::onPacketReceived(mesh::Packet *packet) {
   handleReceivedPacket(packet);
 }
@@ -16,6 +16,7 @@
  * Features:
  * - Point-to-point communication over hardware UART
  * - Fletcher-16 checksum for data integrity verification
+ * - Optional batched frames (BRIDGE_BATCHING), several packets with one CRC-32, for high baud rates
  * - Magic header for packet synchronization and frame alignment
  * - Duplicate packet detection using SimpleMeshTables tracking
  * - Configurable RX/TX pins via build defines
@@ -27,6 +28,12 @@
  * [n bytes] Mesh Packet Payload - The actual mesh packet data
  * [2 bytes] Fletcher-16 Checksum - Calculated over the payload for integrity verification
  *
+ * Batched Packet Structure:
+ * [2 bytes] Magic Header (0xC03F)
+ * [2 bytes] Length of entries
+ * [n bytes] Entries - each is [2 bytes] mesh packet length, then the mesh packet
+ * [4 bytes] CRC-32 - Calculated over the entries
+ *
  * The Fletcher-16 checksum is calculated over the mesh packet payload and provides
  * error detection capabilities suitable for serial communication where electrical
  * noise, timing issues, or hardware problems could corrupt data. The checksum
@@ -53,8 +60,9 @@ public:
    * @param serial The hardware serial port to use
    * @param mgr PacketManager for allocating and queuing packets
    * @param rtc RTCClock for timestamping debug messages
+   * @param tables The mesh's own tables, shared for duplicate detection
    */
-  RS232Bridge(NodePrefs *prefs, Stream &serial, mesh::PacketManager *mgr, mesh::RTCClock *rtc);
+  RS232Bridge(NodePrefs *prefs, Stream &serial, mesh::PacketManager *mgr, mesh::RTCClock *rtc, SimpleMeshTables *tables);
 
   /**
    * Initializes the RS232 bridge
@@ -75,8 +83,8 @@ public:
   /**
    * @brief Main loop handler for processing incoming serial data
    *
-   * Implements a state machine for packet reception:
-   * 1. Searches for magic header bytes for packet synchronization
+   * Reads available serial data in blocks, then parses the buffered frames:
+   * 1. Searches for magic header bytes (single or batched) for packet synchronization
    * 2. Reads length field to determine expected packet size
    * 3. Validates packet length against maximum allowed size
    * 4. Receives complete packet payload and checksum
@@ -135,14 +143,40 @@ private:
    */
   static constexpr uint16_t MAX_SERIAL_PACKET_SIZE = (MAX_TRANS_UNIT + 1) + SERIAL_OVERHEAD;
 
+  /**
+   * @brief The overhead of a batched frame: MAGIC_WORD (2) + LENGTH (2) + CRC-32 (4) = 8 bytes
+   */
+  static constexpr uint16_t BATCH_OVERHEAD = BRIDGE_MAGIC_SIZE + BRIDGE_LENGTH_SIZE + BRIDGE_CRC32_SIZE;
+
+  /** Big enough for either kind of frame */
+  static constexpr uint16_t RX_BUFFER_SIZE = BRIDGE_BATCH_MAX_SIZE + BATCH_OVERHEAD > MAX_SERIAL_PACKET_SIZE ?
+      BRIDGE_BATCH_MAX_SIZE + BATCH_OVERHEAD : MAX_SERIAL_PACKET_SIZE;
+
   /** Hardware serial port interface */
   Stream *_serial;
 
   /** Buffer for building received packets */
-  uint8_t _rx_buffer[MAX_SERIAL_PACKET_SIZE];
+  uint8_t _rx_buffer[RX_BUFFER_SIZE];
 
   /** Current position in the receive buffer */
   uint16_t _rx_buffer_pos = 0;
+
+  /**
+   * @brief Parses the frames in the receive buffer, keeping any incomplete one for the next read
+   */
+  void parseRxBuffer();
+
+  /**
+   * @brief Parses one (single packet or batched) frame
+   *
+   * @param frame Start of frame, at its magic header
+   * @param avail Bytes available from frame
+   * @return Bytes used, 0 if the frame is incomplete, or 1 if not a valid frame (to resync from next byte)
+   */
+  size_t parseFrame(const uint8_t *frame, size_t avail);
+
+protected:
+  void flushBatch() override;
 };
 
 #endif
@@ -0,0 +1,167 @@
+#include "UDPBridge.h"
+
+#ifdef WITH_UDP_BRIDGE
+
+#if !defined(WITH_UDP_BRIDGE_SSID) || !defined(WITH_UDP_BRIDGE_PWD)
+#error "WITH_UDP_BRIDGE_SSID and WITH_UDP_BRIDGE_PWD must be defined"
+#endif
+
+UDPBridge::UDPBridge(NodePrefs *prefs, mesh::PacketManager *mgr, mesh::RTCClock *rtc, SimpleMeshTables *tables)
+    : BridgeBase(prefs, mgr, rtc, tables), _joined(false), _limiter(UDP_BRIDGE_RATE_PER_MIN, UDP_BRIDGE_RATE_BURST) {
+}
+
+void UDPBridge::begin() {
+  BRIDGE_DEBUG_PRINTLN("Initializing...\n");
+
+  // Administratively scoped multicast group (239.192.x.y), from the region name
+  const char *region = UDP_BRIDGE_REGION;
+  uint16_t h = region[0] ? fletcher16((const uint8_t *)region, strlen(region)) : 1;
+  _group = IPAddress(239, 192, h >> 8, h & 0xFF);
+
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+  WiFi.begin(WITH_UDP_BRIDGE_SSID, WITH_UDP_BRIDGE_PWD);
+
+  // Update bridge state (the group is joined once connected)
+  _joined = false;
+  _initialized = true;
+}
+
+void UDPBridge::end() {
+  BRIDGE_DEBUG_PRINTLN("Stopping...\n");
+
+  _udp.stop();
+  _joined = false;
+  _batch_len = 0;
+
+  // Turn off WiFi
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+
+  // Update bridge state
+  _initialized = false;
+}
+
+bool UDPBridge::joinGroup() {
+  _udp.stop();
+  if (!_udp.beginMulticast(_group, UDP_BRIDGE_PORT)) {
+    BRIDGE_DEBUG_PRINTLN("Failed to join multicast group %s\n", _group.toString().c_str());
+    return false;
+  }
+  BRIDGE_DEBUG_PRINTLN("Joined %s:%d\n", _group.toString().c_str(), UDP_BRIDGE_PORT);
+  return true;
+}
+
+void UDPBridge::loop() {
+  if (!_initialized) return;
+
+  if (WiFi.status() != WL_CONNECTED) {
+    _joined = false;   // will re-join after reconnect
+    _batch_len = 0;    // nowhere to send them
+    return;
+  }
+  if (!_joined) {
+    _joined = joinGroup();
+    if (!_joined) return;
+  }
+
+  int len;
+  while ((len = _udp.parsePacket()) > 0) {
+    if (len > (int)sizeof(_buffer)) {
+      BRIDGE_DEBUG_PRINTLN("RX datagram too large, len=%d\n", len);
+      _udp.flush();
+      continue;
+    }
+    int n = _udp.read(_buffer, len);
+    if (n > 0) onDataRecv(_buffer, n);
+  }
+
+  checkBatchTimeout();
+}
+
+void UDPBridge::onDataRecv(uint8_t *data, size_t len) {
+  // Ignore datagrams that are too small to contain header + CRC
+  if (len < (BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE)) {
+    BRIDGE_DEBUG_PRINTLN("RX datagram too small, len=%d\n", len);
+    return;
+  }
+
+  // Check header magic
+  uint16_t received_magic = (data[0] << 8) | data[1];
+  if (received_magic != BRIDGE_BATCH_MAGIC) {
+    BRIDGE_DEBUG_PRINTLN("RX invalid magic 0x%04X\n", received_magic);
+    _stats.n_bad_frames++;
+    return;
+  }
+
+  // Decrypt (CRC + entries), in place
+  xorCrypt(data + BRIDGE_MAGIC_SIZE, len - BRIDGE_MAGIC_SIZE);
+
+  uint32_t received_crc = ((uint32_t)data[2] << 24) | ((uint32_t)data[3] << 16) | (data[4] << 8) | data[5];
+  const uint8_t *entries = data + BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE;
+  const size_t entriesLen = len - (BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE);
+  if (crc32(entries, entriesLen) != received_crc) {
+    // Failed to decrypt - likely from a different network
+    BRIDGE_DEBUG_PRINTLN("RX CRC mismatch, rcv=0x%08X\n", received_crc);
+    _stats.n_bad_frames++;
+    return;
+  }
+  _stats.n_frames_in++;
+
+  int n = receiveBatch(entries, entriesLen);
+  BRIDGE_DEBUG_PRINTLN("RX, len=%d packets=%d\n", entriesLen, n);
+}
+
+void UDPBridge::flushBatch() {
+  if (_batch_len == 0) return;
+
+  _buffer[0] = (BRIDGE_BATCH_MAGIC >> 8) & 0xFF;
+  _buffer[1] = BRIDGE_BATCH_MAGIC & 0xFF;
+
+  uint32_t crc = crc32(_batch, _batch_len);
+  _buffer[2] = (crc >> 24) & 0xFF;
+  _buffer[3] = (crc >> 16) & 0xFF;
+  _buffer[4] = (crc >> 8) & 0xFF;
+  _buffer[5] = crc & 0xFF;
+  memcpy(_buffer + BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE, _batch, _batch_len);
+
+  // Encrypt CRC and entries (not including magic header)
+  xorCrypt(_buffer + BRIDGE_MAGIC_SIZE, BRIDGE_CRC32_SIZE + _batch_len);
+
+  const size_t totalLen = BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE + _batch_len;
+  _batch_len = 0;
+
+  if (_udp.beginMulticastPacket() && _udp.write(_buffer, totalLen) == totalLen && _udp.endPacket()) {
+    BRIDGE_DEBUG_PRINTLN("TX, len=%d\n", totalLen);
+    _stats.n_frames_out++;
+  } else {
+    BRIDGE_DEBUG_PRINTLN("TX FAILED!\n");
+  }
+}
+
+void UDPBridge::sendPacket(mesh::Packet *packet) {
+  // Guard against uninitialized state, or not connected yet
+  if (_initialized == false || !_joined) {
+    return;
+  }
+
+  // First validate the packet pointer
+  if (!packet) {
+    BRIDGE_DEBUG_PRINTLN("TX invalid packet pointer\n");
+    return;
+  }
+
+  if (!_tables->hasBridged(packet)) {
+    if (!_limiter.allow(packet, millis())) {
+      BRIDGE_DEBUG_PRINTLN("TX rate limited, src=%02X\n", SourceRateLimiter::getSourceKey(packet));
+      return;
+    }
+    addToBatch(packet, MAX_BATCH_SIZE);
+  }
+}
+
+void UDPBridge::onPacketReceived(mesh::Packet *packet) {
+  handleReceivedPacket(packet);
+}
+
+#endif
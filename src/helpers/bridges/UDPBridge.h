@@ -0,0 +1,143 @@
+#pragma once
+
+#include "MeshCore.h"
+#include "helpers/SourceRateLimiter.h"
+#include "helpers/bridges/BridgeBase.h"
+
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+#ifdef WITH_UDP_BRIDGE
+
+#ifndef UDP_BRIDGE_PORT
+  #define UDP_BRIDGE_PORT          41300
+#endif
+#ifndef UDP_BRIDGE_REGION
+  #define UDP_BRIDGE_REGION        ""     // name of region, picks the multicast group, so islands of other regions don't hear it
+#endif
+#ifndef UDP_BRIDGE_MAX_FRAME
+  #define UDP_BRIDGE_MAX_FRAME     1200   // bytes, keeps a batch within one (un-fragmented) datagram
+#endif
+#ifndef UDP_BRIDGE_RATE_PER_MIN
+  #define UDP_BRIDGE_RATE_PER_MIN  120    // packets per source sent over the bridge (zero for no limit)
+#endif
+#ifndef UDP_BRIDGE_RATE_BURST
+  #define UDP_BRIDGE_RATE_BURST    20
+#endif
+
+/**
+ * @brief Bridge implementation using UDP multicast over a Wi-Fi network for packet transport
+ *
+ * This bridge links mesh 'islands' which share an IP network (eg. a site LAN, or a VPN which
+ * forwards multicast), so cross-island traffic doesn't need a chain of LoRa radios.
+ *
+ * Features:
+ * - Multicast based communication (all bridges in the group receive all packets)
+ * - Region scoping: the multicast group is derived from UDP_BRIDGE_REGION, so only bridges
+ *   of the same region subscribe to each other's traffic
+ * - Network isolation using XOR encryption with shared secret (as ESPNowBridge)
+ * - Packets are always sent in batched frames, up to BRIDGE_BATCH_MILLIS apart
+ * - Rate limiting per packet source (SourceRateLimiter), so one node can't flood the other islands
+ * - Duplicate packet detection using SimpleMeshTables tracking
+ *
+ * Packet Structure (one UDP datagram):
+ * [2 bytes] Magic Header (0xC03F)
+ * [4 bytes] CRC-32 of the entries
+ * [n bytes] Entries - each is [2 bytes] mesh packet length, then the mesh packet
+ * The CRC and entries are encrypted, so frames of another network fail the CRC check.
+ *
+ * Configuration:
+ * - Define WITH_UDP_BRIDGE to enable this bridge
+ * - Define WITH_UDP_BRIDGE_SSID and WITH_UDP_BRIDGE_PWD with the Wi-Fi network credentials
+ * - Define UDP_BRIDGE_REGION (eg. '"north"') to scope the bridge to a region
+ * - Define _prefs->bridge_secret with a string to set the network encryption key
+ */
+class UDPBridge : public BridgeBase {
+private:
+  WiFiUDP _udp;
+  IPAddress _group;
+  bool _joined;
+  SourceRateLimiter _limiter;
+
+  /** Buffer for receiving/sending datagrams */
+  uint8_t _buffer[UDP_BRIDGE_MAX_FRAME];
+
+  /**
+   * Max length of the entries of a frame: magic header (2) + CRC-32 (4) + entries
+   */
+  static const size_t MAX_BATCH_SIZE = UDP_BRIDGE_MAX_FRAME - (BRIDGE_MAGIC_SIZE + BRIDGE_CRC32_SIZE);
+
+  /**
+   * Joins the multicast group, once Wi-Fi has connected
+   *
+   * @return true if joined
+   */
+  bool joinGroup();
+
+  /**
+   * Handles a received datagram
+   *
+   * @param data Received data, from the magic header
+   * @param len Length of received data
+   */
+  void onDataRecv(uint8_t *data, size_t len);
+
+public:
+  /**
+   * Constructs a UDPBridge instance
+   *
+   * @param prefs Node preferences for configuration settings
+   * @param mgr PacketManager for allocating and queuing packets
+   * @param rtc RTCClock for timestamping debug messages
+   * @param tables The mesh's own tables, shared for duplicate detection
+   */
+  UDPBridge(NodePrefs *prefs, mesh::PacketManager *mgr, mesh::RTCClock *rtc, SimpleMeshTables *tables);
+
+  /**
+   * Initializes the UDP bridge
+   *
+   * - Configures WiFi in station mode and starts connecting
+   * - Picks the multicast group for the region
+   * - The group is joined from loop(), when the connection is up
+   */
+  void begin() override;
+
+  /**
+   * Stops the UDP bridge
+   *
+   * - Leaves the multicast group
+   * - Turns off WiFi to release radio resources
+   */
+  void end() override;
+
+  /**
+   * Main loop handler
+   * Joins the group (after a Wi-Fi (re)connect), reads any waiting datagrams, and sends
+   * any batch that's waited long enough
+   */
+  void loop() override;
+
+  /**
+   * Called when a packet is received via UDP
+   * Queues the packet for mesh processing if not seen before
+   *
+   * @param packet The received mesh packet
+   */
+  void onPacketReceived(mesh::Packet *packet) override;
+
+  /**
+   * Called when a packet needs to be transmitted via UDP
+   * Adds the packet to the pending batch if not seen before, and within the rate limit
+   *
+   * @param packet The mesh packet to transmit
+   */
+  void sendPacket(mesh::Packet *packet) override;
+
+  /** @return number of packets not sent, due to the rate limit */
+  uint32_t getNumRateLimited() const { return _limiter.getNumDenied(); }
+
+protected:
+  void flushBatch() override;
+};
+
+#endif
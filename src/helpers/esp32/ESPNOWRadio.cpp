@@ -2,24 +2,40 @@
 #include <esp_now.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
+#include <atomic>
 
 static uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 static esp_now_peer_info_t peerInfo;
-static volatile bool is_send_complete = false;
+static std::atomic<uint8_t> tx_in_flight(0);   // sent, but not yet called back
 static esp_err_t last_send_result;
-static uint8_t rx_buf[256];
-static uint8_t last_rx_len = 0;
+
+struct RxFrame {
+  uint8_t len;
+  uint8_t data[ESP_NOW_MAX_DATA_LEN];
+};
+
+// single producer (Wi-Fi task callback), single consumer (recvRaw() in mesh loop)
+static RxFrame rx_queue[ESPNOW_RX_QUEUE_SIZE];
+static std::atomic<uint8_t> rx_head(0), rx_tail(0);   // free running, written only by producer/consumer respectively
+static volatile uint32_t rx_dropped = 0;
 
 // callback when data is sent
 static void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
-  is_send_complete = true;
+  if (tx_in_flight.load() > 0) tx_in_flight.fetch_sub(1);
   ESPNOW_DEBUG_PRINTLN("Send Status: %d", (int)status);
 }
 
 static void OnDataRecv(const uint8_t *mac, const uint8_t *data, int len) {
   ESPNOW_DEBUG_PRINTLN("Recv: len = %d", len);
-  memcpy(rx_buf, data, len);
-  last_rx_len = len;
+  uint8_t head = rx_head.load(std::memory_order_relaxed);
+  if ((uint8_t)(head - rx_tail.load(std::memory_order_acquire)) >= ESPNOW_RX_QUEUE_SIZE || len <= 0 || len > ESP_NOW_MAX_DATA_LEN) {
+    rx_dropped++;   // queue full (mesh loop not keeping up)
+    return;
+  }
+  auto f = &rx_queue[head % ESPNOW_RX_QUEUE_SIZE];
+  memcpy(f->data, data, len);
+  f->len = len;
+  rx_head.store(head + 1, std::memory_order_release);   // publish only once frame is complete
 }
 
 void ESPNOWRadio::init() {
@@ -44,7 +60,7 @@ void ESPNOWRadio::init() {
   peerInfo.channel = 0;
   peerInfo.encrypt = false;
 
-  is_send_complete = true;
+  tx_in_flight.store(0);
 
   // Add peer        
   if (esp_now_add_peer(&peerInfo) == ESP_OK) {
@@ -70,8 +86,8 @@ uint32_t ESPNOWRadio::intID() {
 }
 
 bool ESPNOWRadio::startSendRaw(const uint8_t* bytes, int len) {
-  // Send message via ESP-NOW
-  is_send_complete = false;
+  // Send message via ESP-NOW (is queued by the Wi-Fi task, so don't need to wait for previous ones)
+  tx_in_flight.fetch_add(1);
   esp_err_t result = esp_now_send(broadcastAddress, bytes, len);
   if (result == ESP_OK) {
     n_sent++;
@@ -79,35 +95,43 @@ bool ESPNOWRadio::startSendRaw(const uint8_t* bytes, int len) {
     return true;
   }
   last_send_result = result;
-  is_send_complete = true;
+  tx_in_flight.fetch_sub(1);
   ESPNOW_DEBUG_PRINTLN("Send failed: %d", result);
   return false;
 }
 
 bool ESPNOWRadio::isSendComplete() {
-  return is_send_complete;
+  return tx_in_flight.load() < ESPNOW_TX_MAX_IN_FLIGHT;   // room for the next one
 }
 void ESPNOWRadio::onSendFinished() {
-  is_send_complete = true;
 }
 
 bool ESPNOWRadio::isInRecvMode() const {
-  return is_send_complete;    // if NO send in progress, then we're in Rx mode
+  return true;    // ESP-NOW receives while sends are queued
 }
 
 float ESPNOWRadio::getLastRSSI() const { return 0; }
 float ESPNOWRadio::getLastSNR() const { return 0; }
 
+uint32_t ESPNOWRadio::getRxDropped() const { return rx_dropped; }
+
 int ESPNOWRadio::recvRaw(uint8_t* bytes, int sz) {
-  int len = last_rx_len;
-  if (last_rx_len > 0) {
-    memcpy(bytes, rx_buf, last_rx_len);
-    last_rx_len = 0;
-    n_recv++;
-  }
+  uint8_t tail = rx_tail.load(std::memory_order_relaxed);
+  if (tail == rx_head.load(std::memory_order_acquire)) return 0;   // empty
+
+  auto f = &rx_queue[tail % ESPNOW_RX_QUEUE_SIZE];
+  int len = f->len;
+  if (len > sz) len = sz;
+  memcpy(bytes, f->data, len);
+  rx_tail.store(tail + 1, std::memory_order_release);   // slot can now be reused
+  n_recv++;
   return len;
 }
 
 uint32_t ESPNOWRadio::getEstAirtimeFor(int len_bytes) {
-  return 4;  // Fast AF
+#if ESPNOW_PHY_KBPS > 0
+  return ESPNOW_AIRTIME_MILLIS + (len_bytes * 8) / ESPNOW_PHY_KBPS;   // kbps == bits per milli
+#else
+  return ESPNOW_AIRTIME_MILLIS;  // Fast AF
+#endif
 }
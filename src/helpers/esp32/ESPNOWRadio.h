@@ -2,6 +2,19 @@
 
 #include <Mesh.h>
 
+#ifndef ESPNOW_RX_QUEUE_SIZE
+  #define ESPNOW_RX_QUEUE_SIZE      8     // received frames buffered until recvRaw(), must be a power of 2
+#endif
+#ifndef ESPNOW_TX_MAX_IN_FLIGHT
+  #define ESPNOW_TX_MAX_IN_FLIGHT   4     // sends queued in the Wi-Fi stack before isSendComplete() waits for them
+#endif
+#ifndef ESPNOW_AIRTIME_MILLIS
+  #define ESPNOW_AIRTIME_MILLIS     4     // fixed per-frame estimate (or overhead, if ESPNOW_PHY_KBPS set)
+#endif
+#ifndef ESPNOW_PHY_KBPS
+  #define ESPNOW_PHY_KBPS           0     // eg. 250 for LR mode, to model airtime by length. Zero for fixed estimate
+#endif
+
 class ESPNOWRadio : public mesh::Radio {
 protected:
   uint32_t n_recv, n_sent;
@@ -20,6 +33,7 @@ public:
   uint32_t getPacketsRecv() const { return n_recv; }
   uint32_t getPacketsSent() const { return n_sent; }
   void resetStats() { n_recv = n_sent = 0; }
+  uint32_t getRxDropped() const;   // by a full receive queue
 
   virtual float getLastRSSI() const override;
   virtual float getLastSNR() const override;
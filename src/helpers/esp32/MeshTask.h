@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+
+#if defined(ESP32) && !defined(CONFIG_FREERTOS_UNICORE)
+
+#ifndef MESH_TASK_STACK
+  #define MESH_TASK_STACK   8192    // bytes
+#endif
+#ifndef MESH_TASK_PRIO
+  #define MESH_TASK_PRIO    3       // above the Arduino loop (1), so the app/UI can't delay the radio
+#endif
+
+/**
+ * \brief  Runs the mesh (Dispatcher, radio, routing) in its own task, pinned to one core, so that forwarding latency
+ *     doesn't depend on what the Arduino loop() (UI rendering, display flushes, sensors) is doing on the other core.
+ *     The mesh's loop function is called with the lock held, yielding a tick between calls. Code on other tasks which
+ *     needs to call into the mesh (or touch state it shares) takes the lock around that call (see MeshTask::Guard).
+ *  NOTE: events from the mesh to other tasks should go through a queue (eg. SPSCQueue), rather than taking their locks.
+*/
+class MeshTask {
+  void (*_fn)(void*);
+  void* _ctx;
+  TaskHandle_t _task;
+  SemaphoreHandle_t _lock;
+
+  static void taskMain(void* p) {
+    auto self = (MeshTask *) p;
+    for (;;) {
+      xSemaphoreTakeRecursive(self->_lock, portMAX_DELAY);
+      self->_fn(self->_ctx);
+      xSemaphoreGiveRecursive(self->_lock);
+      vTaskDelay(1);   // let tasks of lower priority on this core run (incl. idle/watchdog)
+    }
+  }
+
+public:
+  MeshTask() : _fn(NULL), _ctx(NULL), _task(NULL), _lock(NULL) { }
+
+  /**
+   * \param  fn  the mesh loop, called repeatedly on the mesh task (with 'ctx')
+   * \returns  false if task couldn't be started (caller should then just call 'fn' from its own loop)
+  */
+  bool begin(void (*fn)(void*), void* ctx, int core, const char* name = "mesh") {
+    if (_task) return true;  // already started
+    _fn = fn;
+    _ctx = ctx;
+    _lock = xSemaphoreCreateRecursiveMutex();   // (has priority inheritance)
+    if (_lock == NULL) return false;
+    if (xTaskCreatePinnedToCore(taskMain, name, MESH_TASK_STACK, this, MESH_TASK_PRIO, &_task, core) != pdPASS) {
+      _task = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  bool isRunning() const { return _task != NULL; }
+
+  void lock() { if (_lock) xSemaphoreTakeRecursive(_lock, portMAX_DELAY); }
+  void unlock() { if (_lock) xSemaphoreGiveRecursive(_lock); }
+
+  /** \brief  holds the lock for the current scope */
+  class Guard {
+    MeshTask* _t;
+  public:
+    Guard(MeshTask& t) : _t(&t) { _t->lock(); }
+    ~Guard() { _t->unlock(); }
+  };
+};
+
+#endif
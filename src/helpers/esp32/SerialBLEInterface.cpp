@@ -15,7 +15,7 @@ void SerialBLEInterface::begin(const char* device_name, uint32_t pin_code) {
   // Create the BLE Device
   BLEDevice::init(device_name);
   BLEDevice::setSecurityCallbacks(this);
-  BLEDevice::setMTU(MAX_FRAME_SIZE);
+  BLEDevice::setMTU(MAX_FRAME_SIZE + 3);   // (+ ATT header) so a whole frame fits one notification
 
   BLESecurity  sec;
   sec.setStaticPIN(pin_code);
@@ -84,6 +84,15 @@ void SerialBLEInterface::onConnect(BLEServer* pServer) {
 void SerialBLEInterface::onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t *param) {
   BLE_DEBUG_PRINTLN("onConnect(), conn_id=%d, mtu=%d", param->connect.conn_id, pServer->getPeerMTU(param->connect.conn_id));
   last_conn_id = param->connect.conn_id;
+  memcpy(peer_addr, param->connect.remote_bda, sizeof(peer_addr));
+
+  // longest link layer packets (DLE), and 2M PHY where the controller has it, so big frames take fewer, shorter packets
+  esp_ble_gap_set_pkt_data_len(peer_addr, 251);
+#ifdef CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+  esp_ble_gap_set_preferred_phy(peer_addr, 0, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#endif
+  _fast_conn = true;   // (app will typically sync straight away)
+  _last_traffic = millis();
 }
 
 void SerialBLEInterface::onMtuChanged(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
@@ -107,12 +116,8 @@ void SerialBLEInterface::onWrite(BLECharacteristic* pCharacteristic, esp_ble_gat
 
   if (len > MAX_FRAME_SIZE) {
     BLE_DEBUG_PRINTLN("ERROR: onWrite(), frame too big, len=%d", len);
-  } else if (recv_queue_len >= FRAME_QUEUE_SIZE) {
+  } else if (!recv_queue.push(rxValue, len)) {
     BLE_DEBUG_PRINTLN("ERROR: onWrite(), recv_queue is full!");
-  } else {
-    recv_queue[recv_queue_len].len = len;
-    memcpy(recv_queue[recv_queue_len].buf, rxValue, len);
-    recv_queue_len++;
   }
 }
 
@@ -155,52 +160,70 @@ size_t SerialBLEInterface::writeFrame(const uint8_t src[], size_t len) {
   }
 
   if (deviceConnected && len > 0) {
-    if (send_queue_len >= FRAME_QUEUE_SIZE) {
+    if (!send_queue.push(src, len)) {
       BLE_DEBUG_PRINTLN("writeFrame(), send_queue is full!");
       return 0;
     }
-
-    send_queue[send_queue_len].len = len;  // add to send queue
-    memcpy(send_queue[send_queue_len].buf, src, len);
-    send_queue_len++;
-
     return len;
   }
   return 0;
 }
 
-#define  BLE_WRITE_MIN_INTERVAL   60
+void SerialBLEInterface::setConnMode(bool fast) {
+  BLE_DEBUG_PRINTLN("setConnMode(%s)", fast ? "fast" : "relaxed");
+  if (fast) {
+    pServer->updateConnParams(peer_addr, BLE_CONN_FAST_INTERVAL / 2, BLE_CONN_FAST_INTERVAL, 0, BLE_CONN_SUP_TIMEOUT);
+  } else {
+    pServer->updateConnParams(peer_addr, BLE_CONN_RELAXED_INTERVAL, BLE_CONN_RELAXED_INTERVAL * 3 / 2, BLE_CONN_RELAXED_LATENCY, BLE_CONN_SUP_TIMEOUT);
+  }
+  _fast_conn = fast;
+}
+
+// short connection intervals while frames are flowing (eg. contacts/messages sync), relaxed ones when idle, to save power
+void SerialBLEInterface::checkConnMode() {
+  if (!deviceConnected) return;
+  if (!_fast_conn && send_queue.count() >= BLE_FAST_BACKLOG) {
+    setConnMode(true);
+  } else if (_fast_conn && send_queue.count() == 0 && millis() - _last_traffic >= BLE_RELAX_AFTER_MILLIS) {
+    setConnMode(false);
+  }
+}
 
 bool SerialBLEInterface::isWriteBusy() const {
-  return millis() < _last_write + BLE_WRITE_MIN_INTERVAL;   // still too soon to start another write?
+  return send_queue.count() >= _write_credits;   // would have to wait for a write credit?
 }
 
-size_t SerialBLEInterface::checkRecvFrame(uint8_t dest[]) {
-  if (send_queue_len > 0   // first, check send queue
-    && millis() >= _last_write + BLE_WRITE_MIN_INTERVAL    // space the writes apart
-  ) {
+void SerialBLEInterface::refillWriteCredits() {
+  uint8_t burst = _fast_conn ? BLE_WRITE_FAST_BURST : BLE_WRITE_BURST;
+  if (_write_credits < burst && millis() >= _last_write + (_fast_conn ? BLE_WRITE_FAST_INTERVAL : BLE_WRITE_MIN_INTERVAL)) {
+    _write_credits++;
     _last_write = millis();
-    pTxCharacteristic->setValue(send_queue[0].buf, send_queue[0].len);
-    pTxCharacteristic->notify();
+  }
+}
 
-    BLE_DEBUG_PRINTLN("writeBytes: sz=%d, hdr=%d", (uint32_t)send_queue[0].len, (uint32_t) send_queue[0].buf[0]);
+size_t SerialBLEInterface::checkRecvFrame(uint8_t dest[]) {
+  checkConnMode();
+  refillWriteCredits();
+
+  size_t len;
+  const uint8_t* frame;
+  if (_write_credits > 0 && (frame = send_queue.front(len)) != NULL) {   // first, check send queue
+    if (_write_credits >= BLE_WRITE_BURST) _last_write = millis();   // credit is returned one interval from now
+    _write_credits--;
+    _last_traffic = millis();
+    pTxCharacteristic->setValue((uint8_t *) frame, len);   // straight from queue
+    pTxCharacteristic->notify();
 
-    send_queue_len--;
-    for (int i = 0; i < send_queue_len; i++) {   // delete top item from queue
-      send_queue[i] = send_queue[i + 1];
-    }
+    BLE_DEBUG_PRINTLN("writeBytes: sz=%d, hdr=%d", (uint32_t) len, (uint32_t) frame[0]);
+    send_queue.pop();
   }
 
-  if (recv_queue_len > 0) {   // check recv queue
-    size_t len = recv_queue[0].len;   // take from top of queue
-    memcpy(dest, recv_queue[0].buf, len);
+  if ((frame = recv_queue.front(len)) != NULL) {   // check recv queue
+    memcpy(dest, frame, len);
+    _last_traffic = millis();
 
     BLE_DEBUG_PRINTLN("readBytes: sz=%d, hdr=%d", len, (uint32_t) dest[0]);
-
-    recv_queue_len--;
-    for (int i = 0; i < recv_queue_len; i++) {   // delete top item from queue
-      recv_queue[i] = recv_queue[i + 1];
-    }
+    recv_queue.pop();
     return len;
   }
 
@@ -209,6 +232,8 @@ size_t SerialBLEInterface::checkRecvFrame(uint8_t dest[]) {
   if (deviceConnected != oldDeviceConnected) {
     if (!deviceConnected) {    // disconnecting
       clearBuffers();
+      _fast_conn = false;
+      _write_credits = BLE_WRITE_BURST;
 
       BLE_DEBUG_PRINTLN("SerialBLEInterface -> disconnecting...");
 
@@ -1,11 +1,41 @@
 #pragma once
 
 #include "../BaseSerialInterface.h"
+#include "../FrameQueue.h"
 #include <BLEDevice.h>
 #include <BLEServer.h>
 #include <BLEUtils.h>
 #include <BLE2902.h>
 
+#ifndef BLE_SEND_QUEUE_BYTES
+  #define BLE_SEND_QUEUE_BYTES   (8*(MAX_FRAME_SIZE+1))   // at least 8 frames, many more if they're short
+#endif
+#ifndef BLE_RECV_QUEUE_BYTES
+  #define BLE_RECV_QUEUE_BYTES   (4*(MAX_FRAME_SIZE+1))
+#endif
+#ifndef BLE_WRITE_BURST
+  #define BLE_WRITE_BURST        3     // notifications which can go back-to-back, before being paced
+#endif
+#ifndef BLE_WRITE_MIN_INTERVAL
+  #define BLE_WRITE_MIN_INTERVAL   60  // millis, for each write credit to be returned
+#endif
+#ifndef BLE_WRITE_FAST_BURST
+  #define BLE_WRITE_FAST_BURST     6   // as above, while connection is in fast mode (eg. a sync running)
+#endif
+#ifndef BLE_WRITE_FAST_INTERVAL
+  #define BLE_WRITE_FAST_INTERVAL  15
+#endif
+#ifndef BLE_FAST_BACKLOG
+  #define BLE_FAST_BACKLOG         3     // frames queued to send, at which fast connection params are requested
+#endif
+#ifndef BLE_RELAX_AFTER_MILLIS
+  #define BLE_RELAX_AFTER_MILLIS   4000  // no frames either way for this long, and relaxed params are requested
+#endif
+#define BLE_CONN_FAST_INTERVAL     12    // 15 ms (units of 1.25 ms)
+#define BLE_CONN_RELAXED_INTERVAL  80    // 100 ms
+#define BLE_CONN_RELAXED_LATENCY   4     // connection events peripheral may skip, when it has nothing to send
+#define BLE_CONN_SUP_TIMEOUT       400   // 4 secs (units of 10 ms)
+
 class SerialBLEInterface : public BaseSerialInterface, BLESecurityCallbacks, BLEServerCallbacks, BLECharacteristicCallbacks {
   BLEServer *pServer;
   BLEService *pService;
@@ -14,22 +44,21 @@ class SerialBLEInterface : public BaseSerialInterface, BLESecurityCallbacks, BLE
   bool oldDeviceConnected;
   bool _isEnabled;
   uint16_t last_conn_id;
+  esp_bd_addr_t peer_addr;
+  bool _fast_conn;
+  unsigned long _last_traffic;
   uint32_t _pin_code;
   unsigned long _last_write;
   unsigned long adv_restart_time;
 
-  struct Frame {
-    uint8_t len;
-    uint8_t buf[MAX_FRAME_SIZE];
-  };
-
-  #define FRAME_QUEUE_SIZE  4
-  int recv_queue_len;
-  Frame recv_queue[FRAME_QUEUE_SIZE];
-  int send_queue_len;
-  Frame send_queue[FRAME_QUEUE_SIZE];
+  uint8_t _write_credits;   // notifications which can be sent right away
+  FrameQueue<BLE_RECV_QUEUE_BYTES> recv_queue;
+  FrameQueue<BLE_SEND_QUEUE_BYTES> send_queue;
 
-  void clearBuffers() { recv_queue_len = 0; send_queue_len = 0; }
+  void refillWriteCredits();
+  void checkConnMode();
+  void setConnMode(bool fast);
+  void clearBuffers() { recv_queue.clear(); send_queue.clear(); }
 
 protected:
   // BLESecurityCallbacks methods
@@ -58,7 +87,10 @@ public:
     _isEnabled = false;
     _last_write = 0;
     last_conn_id = 0;
-    send_queue_len = recv_queue_len = 0;
+    memset(peer_addr, 0, sizeof(peer_addr));
+    _fast_conn = false;
+    _last_traffic = 0;
+    _write_credits = BLE_WRITE_BURST;
   }
 
   void begin(const char* device_name, uint32_t pin_code);
@@ -1,6 +1,11 @@
 #include "SerialWifiInterface.h"
 #include <WiFi.h>
 
+#define RECV_STATE_IDLE        0
+#define RECV_STATE_HDR_FOUND   1
+#define RECV_STATE_LEN1_FOUND  2
+#define RECV_STATE_LEN2_FOUND  3
+
 void SerialWifiInterface::begin(int port) {
   // wifi setup is handled outside of this class, only starts the server
   server.begin(port);
@@ -25,15 +30,10 @@ size_t SerialWifiInterface::writeFrame(const uint8_t src[], size_t len) {
   }
 
   if (deviceConnected && len > 0) {
-    if (send_queue_len >= FRAME_QUEUE_SIZE) {
+    if (!send_queue.push(src, len)) {
       WIFI_DEBUG_PRINTLN("writeFrame(), send_queue is full!");
       return 0;
     }
-
-    send_queue[send_queue_len].len = len;  // add to send queue
-    memcpy(send_queue[send_queue_len].buf, src, len);
-    send_queue_len++;
-
     return len;
   }
   return 0;
@@ -43,56 +43,110 @@ bool SerialWifiInterface::isWriteBusy() const {
   return false;
 }
 
-size_t SerialWifiInterface::checkRecvFrame(uint8_t dest[]) {
-  // check if new client connected
+void SerialWifiInterface::acceptClient() {
   auto newClient = server.available();
-  if (newClient) {
+  if (!newClient) return;
 
-    // disconnect existing client
-    deviceConnected = false;
-    client.stop();
+  ClientSlot* slot = NULL;
+  for (int i = 0; i < WIFI_MAX_CLIENTS; i++) {
+    if (!clients[i].client.connected()) { slot = &clients[i]; break; }
+  }
+  if (slot == NULL) {   // all in use, so disconnect one of the existing clients
+    slot = &clients[next_replace];
+    next_replace = (next_replace + 1) % WIFI_MAX_CLIENTS;
+  }
+  slot->client.stop();
 
-    // switch active connection to new client
-    client = newClient;
-    
+  slot->client = newClient;
+  slot->client.setNoDelay(WIFI_TCP_NODELAY);
+  slot->connected = false;   // checkRecvFrame() will pick this up
+  slot->state = RECV_STATE_IDLE;
+}
+
+void SerialWifiInterface::flushSendQueue() {
+  int n = 0;
+  size_t len;
+  const uint8_t* frame;
+  while ((frame = send_queue.front(len)) != NULL && n + 3 + len <= WIFI_TX_BUF_SIZE) {
+    tx_buf[n++] = '>';    // use same header as serial interface so client can delimit frames
+    tx_buf[n++] = (len & 0xFF);  // LSB
+    tx_buf[n++] = (len >> 8);    // MSB
+    memcpy(&tx_buf[n], frame, len); n += len;
+    send_queue.pop();
+  }
+  if (n == 0) return;
+
+  _last_write = millis();
+  for (int i = 0; i < WIFI_MAX_CLIENTS; i++) {
+    auto s = &clients[i];
+    if (s->connected && s->client.write(tx_buf, n) != (size_t) n) {
+      WIFI_DEBUG_PRINTLN("write failed, dropping client %d", i);
+      s->client.stop();
+    }
   }
+}
 
-  if (client.connected()) {
-    if (!deviceConnected) {
-      WIFI_DEBUG_PRINTLN("Got connection");
-      deviceConnected = true;
+size_t SerialWifiInterface::readFrame(ClientSlot& slot, uint8_t dest[]) {
+  while (slot.client.available()) {
+    int c = slot.client.read();
+    if (c < 0) break;
+
+    switch (slot.state) {
+      case RECV_STATE_IDLE:
+        if (c == '<') {
+          slot.state = RECV_STATE_HDR_FOUND;
+        }
+        break;
+      case RECV_STATE_HDR_FOUND:
+        slot.frame_len = (uint8_t)c;   // LSB
+        slot.state = RECV_STATE_LEN1_FOUND;
+        break;
+      case RECV_STATE_LEN1_FOUND:
+        slot.frame_len |= ((uint16_t)c) << 8;   // MSB
+        slot.rx_len = 0;
+        slot.state = slot.frame_len > 0 ? RECV_STATE_LEN2_FOUND : RECV_STATE_IDLE;
+        break;
+      default:
+        if (slot.rx_len < MAX_FRAME_SIZE) {
+          slot.rx_buf[slot.rx_len] = (uint8_t)c;   // rest of frame will be discarded if > MAX
+        }
+        slot.rx_len++;
+        if (slot.rx_len >= slot.frame_len) {  // received a complete frame?
+          if (slot.frame_len > MAX_FRAME_SIZE) slot.frame_len = MAX_FRAME_SIZE;    // truncate
+          memcpy(dest, slot.rx_buf, slot.frame_len);
+          slot.state = RECV_STATE_IDLE;  // reset state, for next frame
+          return slot.frame_len;
+        }
     }
-  } else {
-    if (deviceConnected) {
-      deviceConnected = false;
-      WIFI_DEBUG_PRINTLN("Disconnected");
+  }
+  return 0;
+}
+
+size_t SerialWifiInterface::checkRecvFrame(uint8_t dest[]) {
+  // check if new client connected
+  acceptClient();
+
+  bool any = false;
+  for (int i = 0; i < WIFI_MAX_CLIENTS; i++) {
+    auto s = &clients[i];
+    bool c = s->client.connected();
+    if (c != s->connected) {
+      WIFI_DEBUG_PRINTLN(c ? "Got connection, slot %d" : "Disconnected, slot %d", i);
+      s->connected = c;
     }
+    any = any || c;
   }
+  if (!any && deviceConnected) clearBuffers();   // last client gone
+  deviceConnected = any;
 
   if (deviceConnected) {
-    if (send_queue_len > 0) {   // first, check send queue
-      
-      _last_write = millis();
-      int len = send_queue[0].len;
-
-      uint8_t pkt[3+len]; // use same header as serial interface so client can delimit frames
-      pkt[0] = '>';
-      pkt[1] = (len & 0xFF);  // LSB
-      pkt[2] = (len >> 8);    // MSB
-      memcpy(&pkt[3], send_queue[0].buf, send_queue[0].len);
-      client.write(pkt, 3 + len);
-      send_queue_len--;
-      for (int i = 0; i < send_queue_len; i++) {   // delete top item from queue
-        send_queue[i] = send_queue[i + 1];
-      }
-    } else {
-      int len = client.available();
-      if (len > 0) {
-        uint8_t buf[MAX_FRAME_SIZE + 4];
-        client.readBytes(buf, len);
-        memcpy(dest, buf+3, len-3); // remove header (don't even check ... problems are on the other dir)
-        return len-3;
-      }
+    flushSendQueue();   // first, send everything queued, in one write
+
+    for (int i = 0; i < WIFI_MAX_CLIENTS; i++) {
+      if (!clients[i].connected) continue;
+
+      size_t len = readFrame(clients[i], dest);
+      if (len > 0) return len;
     }
   }
 
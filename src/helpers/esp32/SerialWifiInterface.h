@@ -1,8 +1,22 @@
 #pragma once
 
 #include "../BaseSerialInterface.h"
+#include "../FrameQueue.h"
 #include <WiFi.h>
 
+#ifndef WIFI_MAX_CLIENTS
+  #define WIFI_MAX_CLIENTS      2     // eg. a phone and a desktop app, at the same time
+#endif
+#ifndef WIFI_SEND_QUEUE_BYTES
+  #define WIFI_SEND_QUEUE_BYTES   (8*(MAX_FRAME_SIZE+1))
+#endif
+#ifndef WIFI_TX_BUF_SIZE
+  #define WIFI_TX_BUF_SIZE      1024  // queued frames are coalesced into one socket write, up to this size
+#endif
+#ifndef WIFI_TCP_NODELAY
+  #define WIFI_TCP_NODELAY      1     // don't let Nagle hold back small frames
+#endif
+
 class SerialWifiInterface : public BaseSerialInterface {
   bool deviceConnected;
   bool _isEnabled;
@@ -10,29 +24,34 @@ class SerialWifiInterface : public BaseSerialInterface {
   unsigned long adv_restart_time;
 
   WiFiServer server;
-  WiFiClient client;
 
-  struct Frame {
-    uint8_t len;
-    uint8_t buf[MAX_FRAME_SIZE];
+  struct ClientSlot {
+    WiFiClient client;
+    bool connected;
+    uint8_t state;
+    uint16_t frame_len, rx_len;
+    uint8_t rx_buf[MAX_FRAME_SIZE];
   };
+  ClientSlot clients[WIFI_MAX_CLIENTS];
+  int next_replace;   // slot to drop, when a new client connects and all are in use
 
-  #define FRAME_QUEUE_SIZE  4
-  int recv_queue_len;
-  Frame recv_queue[FRAME_QUEUE_SIZE];
-  int send_queue_len;
-  Frame send_queue[FRAME_QUEUE_SIZE];
+  FrameQueue<WIFI_SEND_QUEUE_BYTES> send_queue;
+  uint8_t tx_buf[WIFI_TX_BUF_SIZE];
 
-  void clearBuffers() { recv_queue_len = 0; send_queue_len = 0; }
+  void clearBuffers() { send_queue.clear(); }
+  void acceptClient();
+  void flushSendQueue();
+  size_t readFrame(ClientSlot& slot, uint8_t dest[]);
 
 protected:
 
 public:
-  SerialWifiInterface() : server(WiFiServer()), client(WiFiClient()) {
+  SerialWifiInterface() : server(WiFiServer()) {
     deviceConnected = false;
     _isEnabled = false;
     _last_write = 0;
-    send_queue_len = recv_queue_len = 0;
+    next_replace = 0;
+    for (int i = 0; i < WIFI_MAX_CLIENTS; i++) clients[i].connected = false;
   }
 
   void begin(int port);
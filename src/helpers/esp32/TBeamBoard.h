@@ -156,6 +156,11 @@ public:
   esp_deep_sleep_start();   // CPU halts here and never returns!
 }
 
+  bool enterRxSleep(uint32_t secs) override {
+    enterDeepSleep(secs, -1);   // radio stays in Rx, and wakes us on DIO1
+    return true;
+  }
+
   uint16_t getBattMilliVolts(){
     return PMU->getBattVoltage();
   }
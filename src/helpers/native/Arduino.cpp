@@ -0,0 +1,73 @@
+#include "Arduino.h"
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+
+StdioSerial Serial;
+
+static uint64_t monotonicMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t start_micros = monotonicMicros();
+
+unsigned long millis() { return (unsigned long) ((monotonicMicros() - start_micros) / 1000); }
+unsigned long micros() { return (unsigned long) (monotonicMicros() - start_micros); }
+
+void delay(unsigned long ms) { usleep(ms * 1000); }
+
+static uint32_t rand_state = 1;
+
+void randomSeed(unsigned long seed) { rand_state = seed ? (uint32_t) seed : 1; }
+
+long random(long max) {
+  if (max <= 0) return 0;
+  rand_state ^= rand_state << 13;   // xorshift32
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state % max;
+}
+
+long random(long min, long max) {
+  return max > min ? min + random(max - min) : min;
+}
+
+char* ltoa(long value, char* dest, int base) {
+  char tmp[34];
+  unsigned long n = value < 0 && base == 10 ? -value : value;
+  int i = 0;
+  do {
+    int d = n % base;
+    tmp[i++] = d < 10 ? '0' + d : 'a' + d - 10;
+    n /= base;
+  } while (n > 0);
+  char* sp = dest;
+  if (value < 0 && base == 10) *sp++ = '-';
+  while (i > 0) *sp++ = tmp[--i];
+  *sp = 0;
+  return dest;
+}
+
+int StdioSerial::available() {
+  if (_peeked >= 0) return 1;
+  struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+  return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN) ? 1 : 0;
+}
+
+int StdioSerial::read() {
+  if (_peeked >= 0) {
+    int c = _peeked;
+    _peeked = -1;
+    return c;
+  }
+  if (!available()) return -1;
+  uint8_t c;
+  return ::read(STDIN_FILENO, &c, 1) == 1 ? c : -1;
+}
+
+int StdioSerial::peek() {
+  if (_peeked < 0) _peeked = read();
+  return _peeked;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Minimal stand-in for the Arduino core, so the mesh core (and helpers which only need millis(), random(), Serial)
+// can be built as a normal Linux/macOS process. See [native_base] in platformio.ini
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Stream.h"
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+char* ltoa(long value, char* dest, int base);
+
+/**
+ * \brief  Serial is stdout (and stdin, non-blocking)
+*/
+class StdioSerial : public Stream {
+  int _peeked;
+public:
+  StdioSerial() : _peeked(-1) { }
+  void begin(unsigned long baud) { }
+  size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buf, size_t len) override { return fwrite(buf, 1, len, stdout); }
+  void flush() override { fflush(stdout); }
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  using Print::write;
+  operator bool() const { return true; }
+};
+
+extern StdioSerial Serial;
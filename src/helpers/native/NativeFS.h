@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Stream.h>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * \brief  a file of NativeFS. Like the ESP32 fs::File, copies share the one open file, which is closed by close()
+ *     or when the last copy goes.
+*/
+class File : public Stream {
+  std::shared_ptr<FILE> _f;
+public:
+  File() { }
+  File(FILE* f) { if (f) _f.reset(f, fclose); }
+
+  operator bool() const { return (bool) _f; }
+  void close() { _f.reset(); }
+
+  size_t write(uint8_t c) override { return _f && fputc(c, _f.get()) != EOF ? 1 : 0; }
+  size_t write(const uint8_t* buf, size_t len) override { return _f ? fwrite(buf, 1, len, _f.get()) : 0; }
+  void flush() override { if (_f) fflush(_f.get()); }
+  using Print::write;
+
+  int read() override { return _f ? fgetc(_f.get()) : -1; }
+  size_t read(uint8_t* buf, size_t len) { return _f ? fread(buf, 1, len, _f.get()) : 0; }
+  int peek() override {
+    int c = read();
+    if (c >= 0) ungetc(c, _f.get());
+    return c;
+  }
+  int available() override { return _f ? (int) (size() - position()) : 0; }
+
+  bool seek(uint32_t pos) { return _f && fseek(_f.get(), pos, SEEK_SET) == 0; }
+  size_t position() const { return _f ? ftell(_f.get()) : 0; }
+  size_t size() const {
+    struct stat st;
+    return _f && fstat(fileno(_f.get()), &st) == 0 ? st.st_size : 0;
+  }
+};
+
+/**
+ * \brief  the host's filesystem, under a root directory, with the ESP32 fs::FS API (so FILESYSTEM code paths
+ *     for ESP32 work as is).
+*/
+class NativeFS {
+  char _root[128];
+
+  const char* fullPath(char* dest, const char* path) const {
+    snprintf(dest, 256, "%s%s%s", _root, path[0] == '/' ? "" : "/", path);
+    return dest;
+  }
+
+public:
+  NativeFS(const char* root_dir) {
+    strncpy(_root, root_dir, sizeof(_root) - 1);
+    _root[sizeof(_root) - 1] = 0;
+  }
+
+  bool begin() { return ::mkdir(_root, 0755) == 0 || access(_root, W_OK) == 0; }
+
+  File open(const char* path, const char* mode="r", bool create=false) {
+    char full[256], fmode[4];
+    snprintf(fmode, sizeof(fmode), "%cb%s", mode[0], mode[1] == '+' ? "+" : "");
+    return File(fopen(fullPath(full, path), fmode));
+  }
+  bool exists(const char* path) {
+    char full[256];
+    return access(fullPath(full, path), F_OK) == 0;
+  }
+  bool remove(const char* path) {
+    char full[256];
+    return ::unlink(fullPath(full, path)) == 0;
+  }
+  bool rename(const char* from, const char* to) {
+    char full_from[256], full_to[256];
+    return ::rename(fullPath(full_from, from), fullPath(full_to, to)) == 0;
+  }
+  bool mkdir(const char* path) {
+    char full[256];
+    return ::mkdir(fullPath(full, path), 0755) == 0;
+  }
+  bool rmdir(const char* path) {
+    char full[256];
+    return ::rmdir(fullPath(full, path)) == 0;
+  }
+};
@@ -0,0 +1,169 @@
+#include "ReplayRadio.h"
+#include <helpers/PacketCapture.h>
+
+#define PCAP_MAGIC            0xA1B2C3D4
+#define PCAP_MAGIC_NANOS      0xA1B23C4D
+#define LINKTYPE_LORATAP      270
+#define LORATAP_MIN_HDR_LEN   15
+#define PCAP_MAX_RECORD       4096    // anything bigger, assume the file is corrupt
+
+static uint32_t swap32(uint32_t v) {
+  return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+}
+
+ReplayRadio::ReplayRadio(SimClock& clock, uint8_t sf, float bw, uint8_t cr) : _clock(&clock), _sf(sf), _cr(cr), _bw(bw) {
+  _in = _tx_out = NULL;
+  _swapped = _nanos = false;
+  _base_millis = 0;
+  _start_time = _start_usecs = 0;
+  _has_next = false;
+  _tx_start = _tx_end = 0;
+  _sending = _long_preamble = false;
+  _freq = 0;
+  _last_snr = _last_rssi = 0;
+  _n_replayed = _n_dropped = _n_skipped = 0;
+}
+
+ReplayRadio::~ReplayRadio() {
+  if (_in) fclose(_in);
+  if (_tx_out) fclose(_tx_out);
+}
+
+uint32_t ReplayRadio::readU32(const uint8_t* src) const {
+  uint32_t v;
+  memcpy(&v, src, 4);
+  return _swapped ? swap32(v) : v;
+}
+
+bool ReplayRadio::open(const char* filename) {
+  _in = fopen(filename, "rb");
+  if (_in == NULL) return false;
+
+  uint8_t hdr[24];
+  if (fread(hdr, 1, sizeof(hdr), _in) != sizeof(hdr)) return false;
+
+  uint32_t magic;
+  memcpy(&magic, hdr, 4);
+  _swapped = magic == swap32(PCAP_MAGIC) || magic == swap32(PCAP_MAGIC_NANOS);
+  magic = readU32(hdr);
+  if (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NANOS) return false;
+  _nanos = magic == PCAP_MAGIC_NANOS;
+  if ((readU32(&hdr[20]) & 0xFFFF) != LINKTYPE_LORATAP) return false;
+
+  _base_millis = _clock->getMillis();
+  return readNext(true);
+}
+
+bool ReplayRadio::openTxCapture(const char* filename) {
+  _tx_out = fopen(filename, "wb");
+  if (_tx_out == NULL) return false;
+
+  uint8_t hdr[24];
+  fwrite(hdr, 1, PacketCapture::writePcapHeader(hdr), _tx_out);
+  return true;
+}
+
+bool ReplayRadio::readNext(bool first) {
+  uint8_t rec[16], data[PCAP_MAX_RECORD];
+  while (fread(rec, 1, sizeof(rec), _in) == sizeof(rec)) {
+    uint32_t secs = readU32(&rec[0]), usecs = readU32(&rec[4]), len = readU32(&rec[8]);
+    if (_nanos) usecs /= 1000;
+    if (len > PCAP_MAX_RECORD || fread(data, 1, len, _in) != len) break;
+
+    int hdr_len = len >= 4 ? (data[2] << 8) | data[3] : 0;   // LoRaTap header length (big endian)
+    int frame_len = (int) len - hdr_len;
+    if (data[0] != 0 || hdr_len < LORATAP_MIN_HDR_LEN || frame_len <= 0 || frame_len > MAX_TRANS_UNIT) {
+      _n_skipped++;
+      continue;
+    }
+    if (first) {
+      _start_time = secs;
+      _start_usecs = usecs;
+      _freq = ((data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7]) / 1000000.0f;
+      if (data[8] > 0) _bw = data[8] * 125.0f;
+      if (data[9] >= 5 && data[9] <= 12) _sf = data[9];
+      first = false;
+    }
+    int64_t rel = ((int64_t) secs - _start_time) * 1000 + ((int64_t) usecs - _start_usecs) / 1000;
+    _next.at = _base_millis + (rel > 0 ? (unsigned long) rel : 0);   // (clamp any that went backwards)
+    _next.rssi = (int16_t) data[10] - 139;
+    _next.snr = (int8_t) data[13];
+    _next.len = frame_len;
+    memcpy(_next.buf, &data[hdr_len], frame_len);
+    _has_next = true;
+    return true;
+  }
+  _has_next = false;
+  return false;
+}
+
+bool ReplayRadio::getNextEventTime(unsigned long* when) const {
+  bool found = false;
+  if (_sending) {
+    *when = _tx_end;
+    found = true;
+  }
+  if (_has_next && (!found || _next.at < *when)) {
+    *when = _next.at;
+    found = true;
+  }
+  return found;
+}
+
+int ReplayRadio::recvRaw(uint8_t* bytes, int sz) {
+  if (!_has_next || _clock->getMillis() < _next.at) return 0;
+
+  int len = 0;
+  uint32_t airtime = getEstAirtimeFor(_next.len);
+  unsigned long start = _next.at > airtime ? _next.at - airtime : 0;
+  if (_sending || (start < _tx_end && _next.at > _tx_start)) {   // was on air while transmitting
+    _n_dropped++;
+  } else if (_next.len <= sz) {
+    len = _next.len;
+    memcpy(bytes, _next.buf, len);
+    _last_snr = _next.snr / 4.0f;
+    _last_rssi = _next.rssi;
+    _n_replayed++;
+  }
+  readNext();
+  return len;
+}
+
+uint32_t ReplayRadio::getEstAirtimeFor(int len_bytes) {
+  return SimRadio::calcAirtime(len_bytes, _sf, _bw, _cr, _long_preamble ? SIM_LONG_PREAMBLE_LEN : SIM_PREAMBLE_LEN);
+}
+
+float ReplayRadio::packetScore(float snr, int packet_len) {
+  return SimRadio::calcPacketScore(snr, packet_len, _sf);
+}
+
+bool ReplayRadio::startSendRaw(const uint8_t* bytes, int len) {
+  if (_sending || len > MAX_TRANS_UNIT) return false;
+
+  _sending = true;
+  _tx_start = _clock->getMillis();
+  _tx_end = _tx_start + getEstAirtimeFor(len);
+
+  if (_tx_out) {
+    unsigned long elapsed = _tx_start - _base_millis + _start_usecs / 1000;
+    CapturedFrame f;
+    f.timestamp = _start_time + elapsed / 1000;
+    f.millis = elapsed % 1000;
+    f.snr = 0;
+    f.rssi = 0;
+    f.orig_len = len;
+    f.len = len < PACKET_CAPTURE_SNAPLEN ? len : PACKET_CAPTURE_SNAPLEN;
+    memcpy(f.data, bytes, f.len);
+
+    uint8_t buf[16 + LORATAP_MIN_HDR_LEN + PACKET_CAPTURE_SNAPLEN];
+    fwrite(buf, 1, PacketCapture::writePcapRecord(buf, f, _freq, _bw, _sf), _tx_out);
+  }
+  return true;
+}
+
+bool ReplayRadio::isReceiving() {
+  if (!_has_next) return false;
+
+  unsigned long now = _clock->getMillis();
+  return now < _next.at && now + getEstAirtimeFor(_next.len) >= _next.at;   // ie. preamble already started
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Mesh.h>
+#include <stdio.h>
+#include "SimRadio.h"
+
+/**
+ * \brief  a Radio which 'receives' the frames of a recorded pcap file (LoRaTap link-type, as written by
+ *     'capture dump' or 'capture stream'), each at its original time relative to the first, on a SimClock. So
+ *     real traffic can be replayed into a Mesh, as fast as the loop can advance the clock.
+ *     Frames which were on air while this radio was transmitting are dropped (half duplex). What is sent can be
+ *     written to another pcap file.
+*/
+class ReplayRadio : public mesh::Radio {
+  struct Frame {
+    unsigned long at;   // end of reception, millis on the clock
+    int8_t snr;   // x4
+    int16_t rssi;
+    uint8_t len;
+    uint8_t buf[MAX_TRANS_UNIT];
+  };
+  SimClock* _clock;
+  FILE* _in;
+  FILE* _tx_out;
+  bool _swapped, _nanos;
+  unsigned long _base_millis;
+  uint32_t _start_time, _start_usecs;
+  Frame _next;
+  bool _has_next;
+  unsigned long _tx_start, _tx_end;
+  bool _sending, _long_preamble;
+  uint8_t _sf, _cr;
+  float _freq, _bw;
+  float _last_snr, _last_rssi;
+  uint32_t _n_replayed, _n_dropped, _n_skipped;
+
+  uint32_t readU32(const uint8_t* src) const;
+  bool readNext(bool first=false);
+
+public:
+  ReplayRadio(SimClock& clock, uint8_t sf=11, float bw=250, uint8_t cr=5);
+  ~ReplayRadio();
+
+  /**
+   * \brief  opens the capture, and takes the SF and BW from its first frame
+   * \returns  false if not a readable LoRaTap pcap file
+  */
+  bool open(const char* filename);
+
+  /** \brief  also write each frame sent to a pcap file */
+  bool openTxCapture(const char* filename);
+
+  uint32_t getStartTime() const { return _start_time; }   // RTC time of first frame
+  uint8_t getSF() const { return _sf; }
+  float getBW() const { return _bw; }
+  bool isDone() const { return !_has_next; }   // all frames replayed
+  uint32_t getNumReplayed() const { return _n_replayed; }
+  uint32_t getNumDropped() const { return _n_dropped; }   // were transmitting
+  uint32_t getNumSkipped() const { return _n_skipped; }   // not LoRaTap, or too long
+
+  /**
+   * \brief  when the radio next has an event: send complete, or end of the next frame
+   * \returns  false if none pending
+  */
+  bool getNextEventTime(unsigned long* when) const;
+
+  int recvRaw(uint8_t* bytes, int sz) override;
+  uint32_t getEstAirtimeFor(int len_bytes) override;
+  float packetScore(float snr, int packet_len) override;
+  void setLongPreamble(bool enable) override { _long_preamble = enable; }
+  bool startSendRaw(const uint8_t* bytes, int len) override;
+  bool isSendComplete() override { return _clock->getMillis() >= _tx_end; }
+  void onSendFinished() override { _sending = false; _long_preamble = false; }
+  bool isInRecvMode() const override { return !_sending; }
+  bool isReceiving() override;
+  float getLastSNR() const override { return _last_snr; }
+  float getLastRSSI() const override { return _last_rssi; }
+};
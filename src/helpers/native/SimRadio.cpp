@@ -0,0 +1,153 @@
+#include "SimRadio.h"
+#include <math.h>
+
+SimAir::SimAir(SimClock& clock) : _clock(&clock), _num(0) {
+  _snr = new int8_t[SIM_MAX_RADIOS][SIM_MAX_RADIOS];   // (too big for the stack, when SIM_MAX_RADIOS is in the hundreds)
+  memset(_snr, (uint8_t) SIM_NO_LINK, SIM_MAX_RADIOS * SIM_MAX_RADIOS);
+}
+
+int SimAir::add(SimRadio* radio) {
+  if (_num >= SIM_MAX_RADIOS) return -1;
+  _radios[_num] = radio;
+  return _num++;
+}
+
+void SimAir::link(int a, int b, int8_t snr) {
+  _snr[a][b] = _snr[b][a] = snr;
+}
+
+void SimAir::link(int from, int to, int8_t snr_fwd, int8_t snr_back) {
+  _snr[from][to] = snr_fwd;
+  _snr[to][from] = snr_back;
+}
+
+void SimAir::linkAll(int8_t snr) {
+  for (int a = 0; a < SIM_MAX_RADIOS; a++) {
+    for (int b = 0; b < SIM_MAX_RADIOS; b++) {
+      _snr[a][b] = a == b ? SIM_NO_LINK : snr;
+    }
+  }
+}
+
+void SimAir::transmit(const SimRadio* sender, const uint8_t* bytes, int len, unsigned long end_millis) {
+  int from = sender->getIndex();
+  for (int i = 0; i < _num; i++) {
+    if (_snr[from][i] != SIM_NO_LINK) {
+      _radios[i]->onAirPacket(bytes, len, _snr[from][i], now(), end_millis);
+    }
+  }
+}
+
+SimRadio::SimRadio(SimAir& air, uint8_t sf, float bw, uint8_t cr) : _air(&air), _sf(sf), _cr(cr), _bw(bw) {
+  _rx_num = 0;
+  _tx_end = 0;
+  _sending = _long_preamble = false;
+  _last_snr = 0;
+  _n_collisions = _n_dropped = 0;
+  _idx = air.add(this);
+}
+
+void SimRadio::onAirPacket(const uint8_t* bytes, int len, int8_t snr, unsigned long start, unsigned long end) {
+  if (_sending || _rx_num >= SIM_RX_QUEUE_SIZE || len > MAX_TRANS_UNIT) {   // half duplex
+    _n_dropped++;
+    return;
+  }
+  bool collided = false;
+  for (int i = 0; i < _rx_num; i++) {
+    Reception& r = _rx[i];
+    if (r.end <= start) continue;   // no overlap
+
+    if (snr < r.snr + SIM_CAPTURE_DB) collided = true;   // this one is lost
+    if (r.snr < snr + SIM_CAPTURE_DB) r.collided = true;   // and/or the one in progress
+  }
+  Reception& r = _rx[_rx_num++];
+  r.start = start;
+  r.end = end;
+  r.snr = snr;
+  r.collided = collided;
+  r.len = len;
+  memcpy(r.buf, bytes, len);
+}
+
+int SimRadio::recvRaw(uint8_t* bytes, int sz) {
+  unsigned long now = _air->now();
+  for (int i = 0; i < _rx_num; i++) {
+    Reception& r = _rx[i];
+    if (r.end > now) continue;   // still on air
+
+    int len = 0;
+    if (r.collided) {
+      _n_collisions++;
+    } else if (r.len <= sz) {
+      memcpy(bytes, r.buf, r.len);
+      len = r.len;
+      _last_snr = r.snr;
+    }
+    _rx_num--;
+    memmove(&_rx[i], &_rx[i + 1], (_rx_num - i) * sizeof(_rx[0]));
+    if (len > 0) return len;
+    i--;
+  }
+  return 0;
+}
+
+uint32_t SimRadio::calcAirtime(int len_bytes, uint8_t sf, float bw, uint8_t cr, int preamble) {
+  // LoRa time-on-air (explicit header, CRC on), as per Semtech AN1200.13
+  float t_sym = (float)(1 << sf) / bw;   // millis
+  int de = t_sym > 16.0f ? 1 : 0;   // low data rate optimise
+  float n_payload = ceilf((8.0f*len_bytes - 4*sf + 28 + 16) / (4.0f*(sf - 2*de))) * cr;
+  if (n_payload < 0) n_payload = 0;
+  return (uint32_t) ((preamble + 4.25f + 8 + n_payload) * t_sym);
+}
+
+float SimRadio::calcPacketScore(float snr, int packet_len, uint8_t sf) {
+  float snr_min = -2.5f * (sf - 4);   // SF5 needs -2.5 dB, each SF up another -2.5 dB (as RadioLibWrapper)
+  if (snr < snr_min) return 0.0f;
+
+  float score = (snr - snr_min) * 0.1f * (1.0f - packet_len * (1.0f / 256.0f));
+  return score < 0.0f ? 0.0f : (score > 1.0f ? 1.0f : score);
+}
+
+uint32_t SimRadio::getEstAirtimeFor(int len_bytes) {
+  return calcAirtime(len_bytes, _sf, _bw, _cr, _long_preamble ? SIM_LONG_PREAMBLE_LEN : SIM_PREAMBLE_LEN);
+}
+
+float SimRadio::packetScore(float snr, int packet_len) {
+  return calcPacketScore(snr, packet_len, _sf);
+}
+
+bool SimRadio::startSendRaw(const uint8_t* bytes, int len) {
+  if (_sending) return false;
+
+  unsigned long now = _air->now();
+  for (int i = 0; i < _rx_num; i++) {
+    if (_rx[i].end > now) _rx[i].collided = true;   // left Rx, mid-packet
+  }
+  _tx_end = now + getEstAirtimeFor(len);
+  _sending = true;
+  _air->transmit(this, bytes, len, _tx_end);
+  return true;
+}
+
+bool SimRadio::isReceiving() {
+  unsigned long now = _air->now();
+  for (int i = 0; i < _rx_num; i++) {
+    if (_rx[i].start <= now && _rx[i].end > now) return true;
+  }
+  return false;
+}
+
+bool SimRadio::getNextEventTime(unsigned long* when) const {
+  bool found = false;
+  if (_sending) {
+    *when = _tx_end;
+    found = true;
+  }
+  for (int i = 0; i < _rx_num; i++) {
+    if (!found || (long)(_rx[i].end - *when) < 0) {
+      *when = _rx[i].end;
+      found = true;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <Mesh.h>
+
+#ifndef SIM_MAX_RADIOS
+  #define SIM_MAX_RADIOS    512
+#endif
+#ifndef SIM_RX_QUEUE_SIZE
+  #define SIM_RX_QUEUE_SIZE   8    // receptions in flight (or not yet polled) per radio
+#endif
+#define SIM_NO_LINK        -128    // (link SNR) out of range
+
+#define SIM_PREAMBLE_LEN       16    // symbols, as RADIO_PREAMBLE_LEN
+#define SIM_LONG_PREAMBLE_LEN  64    // as RADIO_LONG_PREAMBLE_LEN
+
+/**
+ * \brief  simulated time, advanced explicitly by the simulation loop (so runs are deterministic, and faster
+ *     than real time)
+*/
+class SimClock : public mesh::MillisecondClock {
+  unsigned long _now;
+public:
+  SimClock() : _now(0) { }
+  unsigned long getMillis() override { return _now; }
+  void advance(unsigned long millis) { _now += millis; }
+  void set(unsigned long millis) { _now = millis; }
+};
+
+class SimRTCClock : public mesh::RTCClock {
+  SimClock* _ms;
+  uint32_t _base_time;
+  unsigned long _base_millis;
+public:
+  SimRTCClock(SimClock& ms, uint32_t base_time=1715770351) : _ms(&ms), _base_time(base_time), _base_millis(ms.getMillis()) { }
+  uint32_t getCurrentTime() override { return _base_time + (_ms->getMillis() - _base_millis) / 1000; }
+  void setCurrentTime(uint32_t time) override { _base_time = time; _base_millis = _ms->getMillis(); }
+};
+
+/**
+ * \brief  deterministic RNG (xorshift64), one per node so that a run is repeatable for a given seed
+*/
+class SimRNG : public mesh::RNG {
+  uint64_t _state;
+public:
+  SimRNG(uint64_t seed) : _state(seed ? seed : 1) { }
+  void random(uint8_t* dest, size_t sz) override {
+    for (size_t i = 0; i < sz; i++) {
+      _state ^= _state << 13;
+      _state ^= _state >> 7;
+      _state ^= _state << 17;
+      dest[i] = (uint8_t) (_state >> 24);
+    }
+  }
+};
+
+class SimRadio;
+
+/**
+ * \brief  the shared medium between SimRadios: who can hear whom (and at what SNR). Packets overlapping at a
+ *     receiver collide, unless one is at least SIM_CAPTURE_DB stronger.
+*/
+class SimAir {
+  SimClock* _clock;
+  SimRadio* _radios[SIM_MAX_RADIOS];
+  int8_t (*_snr)[SIM_MAX_RADIOS];   // [from][to], in dB, or SIM_NO_LINK
+  int _num;
+
+public:
+  SimAir(SimClock& clock);
+
+  /** \returns  index of radio, for link(), or -1 if SIM_MAX_RADIOS reached */
+  int add(SimRadio* radio);
+  void link(int a, int b, int8_t snr);   // (both directions)
+  void link(int from, int to, int8_t snr_fwd, int8_t snr_back);
+  void linkAll(int8_t snr);
+  int getNumRadios() const { return _num; }
+  SimRadio* getRadio(int idx) const { return _radios[idx]; }
+  unsigned long now() const { return _clock->getMillis(); }
+
+  void transmit(const SimRadio* sender, const uint8_t* bytes, int len, unsigned long end_millis);
+};
+
+/**
+ * \brief  a LoRa radio on a SimAir, with air-time (and so, collisions) as per the given SF/BW/CR.
+*/
+class SimRadio : public mesh::Radio {
+  #define SIM_CAPTURE_DB   6
+
+  struct Reception {
+    unsigned long start, end;
+    int8_t snr;
+    bool collided;
+    uint8_t len;
+    uint8_t buf[MAX_TRANS_UNIT];
+  };
+  SimAir* _air;
+  int _idx;
+  Reception _rx[SIM_RX_QUEUE_SIZE];
+  int _rx_num;
+  unsigned long _tx_end;
+  bool _sending, _long_preamble;
+  uint8_t _sf, _cr;
+  float _bw;
+  float _last_snr;
+  uint32_t _n_collisions, _n_dropped;
+
+public:
+  SimRadio(SimAir& air, uint8_t sf=11, float bw=250, uint8_t cr=5);
+
+  int getIndex() const { return _idx; }
+
+  static uint32_t calcAirtime(int len_bytes, uint8_t sf, float bw, uint8_t cr, int preamble);   // millis
+  static float calcPacketScore(float snr, int packet_len, uint8_t sf);
+  uint32_t getNumCollisions() const { return _n_collisions; }
+  uint32_t getNumDropped() const { return _n_dropped; }   // rx queue full, or was transmitting
+
+  /**
+   * \brief  when the radio next has an event (ie. would raise its IRQ): send complete, or end of a packet being received
+   * \returns  false if none pending
+  */
+  bool getNextEventTime(unsigned long* when) const;
+
+  /** \brief  called by SimAir, at start of a packet from another radio */
+  void onAirPacket(const uint8_t* bytes, int len, int8_t snr, unsigned long start, unsigned long end);
+
+  int recvRaw(uint8_t* bytes, int sz) override;
+  uint32_t getEstAirtimeFor(int len_bytes) override;
+  float packetScore(float snr, int packet_len) override;
+  void setLongPreamble(bool enable) override { _long_preamble = enable; }
+  bool startSendRaw(const uint8_t* bytes, int len) override;
+  bool isSendComplete() override { return _air->now() >= _tx_end; }
+  void onSendFinished() override { _sending = false; _long_preamble = false; }
+  bool isInRecvMode() const override { return !_sending; }
+  bool isReceiving() override;
+  float getLastSNR() const override { return _last_snr; }
+  float getLastRSSI() const override { return _last_snr - 120; }   // (nominal noise floor of -120 dBm)
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+/**
+ * \brief  the subset of Arduino's Print used by the mesh core and helpers, for host-native builds.
+*/
+class Print {
+public:
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t len) {
+    size_t n = 0;
+    while (len-- > 0 && write(*buf++) == 1) n++;
+    return n;
+  }
+  virtual void flush() { }
+
+  size_t write(const char* str) { return write((const uint8_t *) str, strlen(str)); }
+  size_t print(const char* str) { return write(str); }
+  size_t print(char c) { return write((uint8_t) c); }
+  size_t print(int n) { return printf("%d", n); }
+  size_t print(unsigned int n) { return printf("%u", n); }
+  size_t print(long n) { return printf("%ld", n); }
+  size_t print(unsigned long n) { return printf("%lu", n); }
+  size_t print(double n, int digits=2) { return printf("%.*f", digits, n); }
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T v) { return print(v) + println(); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len <= 0) return 0;
+    return write((const uint8_t *) buf, len < (int) sizeof(buf) ? len : sizeof(buf) - 1);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  size_t readBytes(uint8_t* buf, size_t len) {
+    size_t n = 0;
+    int c;
+    while (n < len && (c = read()) >= 0) buf[n++] = (uint8_t) c;
+    return n;
+  }
+  size_t readBytes(char* buf, size_t len) { return readBytes((uint8_t *) buf, len); }
+};
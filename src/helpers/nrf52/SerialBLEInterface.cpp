@@ -11,6 +11,9 @@ void SerialBLEInterface::onDisconnect(uint16_t connection_handle, uint8_t reason
   BLE_DEBUG_PRINTLN("SerialBLEInterface: disconnected reason=%d", reason);
   if(instance){
     instance->_isDeviceConnected = false;
+    instance->_conn_handle = BLE_CONN_HANDLE_INVALID;
+    instance->_fast_conn = false;
+    instance->_write_credits = BLE_WRITE_BURST;
     instance->startAdv();
   }
 }
@@ -19,7 +22,17 @@ void SerialBLEInterface::onSecured(uint16_t connection_handle) {
   BLE_DEBUG_PRINTLN("SerialBLEInterface: onSecured");
   if(instance){
     instance->_isDeviceConnected = true;
+    instance->_conn_handle = connection_handle;
     // no need to stop advertising on connect, as the ble stack does this automatically
+
+    // bigger ATT MTU, longest link layer packets (DLE) and 2M PHY, so big frames take fewer, shorter packets
+    BLEConnection* conn = Bluefruit.Connection(connection_handle);
+    if (conn) {
+      conn->requestMtuExchange(MAX_FRAME_SIZE + 3);
+      conn->requestDataLengthUpdate();
+      conn->requestPHY(BLE_GAP_PHY_2MBPS);
+    }
+    instance->setConnMode(true);   // (app will typically sync straight away)
   }
 }
 
@@ -31,7 +44,7 @@ void SerialBLEInterface::begin(const char* device_name, uint32_t pin_code) {
   sprintf(charpin, "%d", pin_code);
 
   Bluefruit.configPrphBandwidth(BANDWIDTH_MAX);
-  Bluefruit.configPrphConn(250, BLE_GAP_EVENT_LENGTH_MIN, 16, 16);  // increase MTU
+  Bluefruit.configPrphConn(250, BLE_CONN_FAST_INTERVAL / 2, 16, 16);  // increase MTU, and event length (for DLE packets)
   Bluefruit.setTxPower(BLE_TX_POWER);
   Bluefruit.begin();
   Bluefruit.setName(device_name);
@@ -145,41 +158,68 @@ size_t SerialBLEInterface::writeFrame(const uint8_t src[], size_t len) {
   }
 
   if (_isDeviceConnected && len > 0) {
-    if (send_queue_len >= FRAME_QUEUE_SIZE) {
+    if (!send_queue.push(src, len)) {
       BLE_DEBUG_PRINTLN("writeFrame(), send_queue is full!");
       return 0;
     }
-
-    send_queue[send_queue_len].len = len;  // add to send queue
-    memcpy(send_queue[send_queue_len].buf, src, len);
-    send_queue_len++;
-
     return len;
   }
   return 0;
 }
 
-#define  BLE_WRITE_MIN_INTERVAL   60
+void SerialBLEInterface::setConnMode(bool fast) {
+  BLE_DEBUG_PRINTLN("setConnMode(%s)", fast ? "fast" : "relaxed");
+  BLEConnection* conn = Bluefruit.Connection(_conn_handle);
+  if (conn) {
+    if (fast) {
+      conn->requestConnectionParameter(BLE_CONN_FAST_INTERVAL, 0, BLE_CONN_SUP_TIMEOUT);
+    } else {
+      conn->requestConnectionParameter(BLE_CONN_RELAXED_INTERVAL, BLE_CONN_RELAXED_LATENCY, BLE_CONN_SUP_TIMEOUT);
+    }
+  }
+  _fast_conn = fast;
+  _last_traffic = millis();
+}
+
+// short connection intervals while frames are flowing (eg. contacts/messages sync), relaxed ones when idle, to save power
+void SerialBLEInterface::checkConnMode() {
+  if (!_isDeviceConnected) return;
+  if (!_fast_conn && send_queue.count() >= BLE_FAST_BACKLOG) {
+    setConnMode(true);
+  } else if (_fast_conn && send_queue.count() == 0 && millis() - _last_traffic >= BLE_RELAX_AFTER_MILLIS) {
+    setConnMode(false);
+  }
+}
 
 bool SerialBLEInterface::isWriteBusy() const {
-  return millis() < _last_write + BLE_WRITE_MIN_INTERVAL;   // still too soon to start another write?
+  return send_queue.count() >= _write_credits;   // would have to wait for a write credit?
 }
 
-size_t SerialBLEInterface::checkRecvFrame(uint8_t dest[]) {
-  if (send_queue_len > 0   // first, check send queue
-    && millis() >= _last_write + BLE_WRITE_MIN_INTERVAL    // space the writes apart
-  ) {
+void SerialBLEInterface::refillWriteCredits() {
+  uint8_t burst = _fast_conn ? BLE_WRITE_FAST_BURST : BLE_WRITE_BURST;
+  if (_write_credits < burst && millis() >= _last_write + (_fast_conn ? BLE_WRITE_FAST_INTERVAL : BLE_WRITE_MIN_INTERVAL)) {
+    _write_credits++;
     _last_write = millis();
-    bleuart.write(send_queue[0].buf, send_queue[0].len);
-    BLE_DEBUG_PRINTLN("writeBytes: sz=%d, hdr=%d", (uint32_t)send_queue[0].len, (uint32_t) send_queue[0].buf[0]);
+  }
+}
 
-    send_queue_len--;
-    for (int i = 0; i < send_queue_len; i++) {   // delete top item from queue
-      send_queue[i] = send_queue[i + 1];
-    }
+size_t SerialBLEInterface::checkRecvFrame(uint8_t dest[]) {
+  checkConnMode();
+  refillWriteCredits();
+
+  size_t len;
+  const uint8_t* frame;
+  if (_write_credits > 0 && (frame = send_queue.front(len)) != NULL) {   // first, check send queue
+    if (_write_credits >= BLE_WRITE_BURST) _last_write = millis();   // credit is returned one interval from now
+    _write_credits--;
+    _last_traffic = millis();
+    bleuart.write(frame, len);   // straight from queue
+    BLE_DEBUG_PRINTLN("writeBytes: sz=%d, hdr=%d", (uint32_t) len, (uint32_t) frame[0]);
+    send_queue.pop();
   } else {
     int len = bleuart.available();
     if (len > 0) {
+      _last_traffic = millis();
       bleuart.readBytes(dest, len);
       BLE_DEBUG_PRINTLN("readBytes: sz=%d, hdr=%d", len, (uint32_t) dest[0]);
       return len;
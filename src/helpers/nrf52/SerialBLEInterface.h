@@ -1,28 +1,55 @@
 #pragma once
 
 #include "../BaseSerialInterface.h"
+#include "../FrameQueue.h"
 #include <bluefruit.h>
 
 #ifndef BLE_TX_POWER
 #define BLE_TX_POWER 4
 #endif
 
+#ifndef BLE_SEND_QUEUE_BYTES
+  #define BLE_SEND_QUEUE_BYTES   (8*(MAX_FRAME_SIZE+1))   // at least 8 frames, many more if they're short
+#endif
+#ifndef BLE_WRITE_BURST
+  #define BLE_WRITE_BURST        3     // notifications which can go back-to-back, before being paced
+#endif
+#ifndef BLE_WRITE_MIN_INTERVAL
+  #define BLE_WRITE_MIN_INTERVAL   60  // millis, for each write credit to be returned
+#endif
+#ifndef BLE_WRITE_FAST_BURST
+  #define BLE_WRITE_FAST_BURST     6   // as above, while connection is in fast mode (eg. a sync running)
+#endif
+#ifndef BLE_WRITE_FAST_INTERVAL
+  #define BLE_WRITE_FAST_INTERVAL  15
+#endif
+#ifndef BLE_FAST_BACKLOG
+  #define BLE_FAST_BACKLOG         3     // frames queued to send, at which fast connection params are requested
+#endif
+#ifndef BLE_RELAX_AFTER_MILLIS
+  #define BLE_RELAX_AFTER_MILLIS   4000  // no frames either way for this long, and relaxed params are requested
+#endif
+#define BLE_CONN_FAST_INTERVAL     12    // 15 ms (units of 1.25 ms)
+#define BLE_CONN_RELAXED_INTERVAL  80    // 100 ms
+#define BLE_CONN_RELAXED_LATENCY   4     // connection events peripheral may skip, when it has nothing to send
+#define BLE_CONN_SUP_TIMEOUT       400   // 4 secs (units of 10 ms)
+
 class SerialBLEInterface : public BaseSerialInterface {
   BLEUart bleuart;
   bool _isEnabled;
   bool _isDeviceConnected;
   unsigned long _last_write;
+  uint16_t _conn_handle;
+  bool _fast_conn;
+  unsigned long _last_traffic;
 
-  struct Frame {
-    uint8_t len;
-    uint8_t buf[MAX_FRAME_SIZE];
-  };
-
-  #define FRAME_QUEUE_SIZE  4
-  int send_queue_len;
-  Frame send_queue[FRAME_QUEUE_SIZE];
+  uint8_t _write_credits;   // notifications which can be sent right away
+  FrameQueue<BLE_SEND_QUEUE_BYTES> send_queue;
 
-  void clearBuffers() { send_queue_len = 0; }
+  void refillWriteCredits();
+  void checkConnMode();
+  void setConnMode(bool fast);
+  void clearBuffers() { send_queue.clear(); }
   static void onConnect(uint16_t connection_handle);
   static void onDisconnect(uint16_t connection_handle, uint8_t reason);
   static void onSecured(uint16_t connection_handle);
@@ -32,7 +59,10 @@ public:
     _isEnabled = false;
     _isDeviceConnected = false;
     _last_write = 0;
-    send_queue_len = 0;
+    _conn_handle = BLE_CONN_HANDLE_INVALID;
+    _fast_conn = false;
+    _last_traffic = 0;
+    _write_credits = BLE_WRITE_BURST;
   }
 
   void startAdv();
@@ -12,11 +12,10 @@ public:
   float getCurrentRSSI() override {
     return ((CustomLLCC68 *)_radio)->getRSSI(false);
   }
-  float getLastRSSI() const override { return ((CustomLLCC68 *)_radio)->getRSSI(); }
-  float getLastSNR() const override { return ((CustomLLCC68 *)_radio)->getSNR(); }
-
-  float packetScore(float snr, int packet_len) override {
-    int sf = ((CustomLLCC68 *)_radio)->spreadingFactor;
-    return packetScoreInt(snr, sf, packet_len);
+  float getPacketRSSI() const override { return ((CustomLLCC68 *)_radio)->getRSSI(); }
+  float getPacketSNR() const override { return ((CustomLLCC68 *)_radio)->getSNR(); }
+  void readPacketStatus(float& snr, float& rssi) override { readSX126xPacketStatus((CustomLLCC68 *)_radio, snr, rssi); }
+  int16_t startReceiveDutyCycle() override {
+    return ((CustomLLCC68 *)_radio)->startReceiveDutyCycleAuto(RADIO_LONG_PREAMBLE_LEN, 8);   // wake for 8 symbols
   }
 };
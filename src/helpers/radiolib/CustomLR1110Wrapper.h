@@ -16,11 +16,12 @@ public:
   }
 
   void onSendFinished() override {
+    setLongPreamble(false);   // (so base doesn't then reset the preamble below)
+    _radio->setPreambleLength(16); // overcomes weird issues with small and big pkts (before base re-arms receive)
     RadioLibWrapper::onSendFinished();
-    _radio->setPreambleLength(16); // overcomes weird issues with small and big pkts
   }
 
-  float getLastRSSI() const override { return ((CustomLR1110 *)_radio)->getRSSI(); }
-  float getLastSNR() const override { return ((CustomLR1110 *)_radio)->getSNR(); }
+  float getPacketRSSI() const override { return ((CustomLR1110 *)_radio)->getRSSI(); }
+  float getPacketSNR() const override { return ((CustomLR1110 *)_radio)->getSNR(); }
   int16_t setRxBoostedGainMode(bool en) { return ((CustomLR1110 *)_radio)->setRxBoostedGainMode(en); };
 };
@@ -13,11 +13,10 @@ public:
   float getCurrentRSSI() override {
     return ((CustomSTM32WLx *)_radio)->getRSSI(false);
   }
-  float getLastRSSI() const override { return ((CustomSTM32WLx *)_radio)->getRSSI(); }
-  float getLastSNR() const override { return ((CustomSTM32WLx *)_radio)->getSNR(); }
-
-  float packetScore(float snr, int packet_len) override {
-    int sf = ((CustomSTM32WLx *)_radio)->spreadingFactor;
-    return packetScoreInt(snr, sf, packet_len);
+  float getPacketRSSI() const override { return ((CustomSTM32WLx *)_radio)->getRSSI(); }
+  float getPacketSNR() const override { return ((CustomSTM32WLx *)_radio)->getSNR(); }
+  void readPacketStatus(float& snr, float& rssi) override { readSX126xPacketStatus((CustomSTM32WLx *)_radio, snr, rssi); }
+  int16_t startReceiveDutyCycle() override {
+    return ((CustomSTM32WLx *)_radio)->startReceiveDutyCycleAuto(RADIO_LONG_PREAMBLE_LEN, 8);   // wake for 8 symbols
   }
 };
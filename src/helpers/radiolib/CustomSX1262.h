@@ -6,8 +6,51 @@
 #define SX126X_IRQ_PREAMBLE_DETECTED           0x04
 
 class CustomSX1262 : public SX1262 {
+  #if defined(ESP32) && defined(P_LORA_DIO_1)
+    uint8_t wake_data[RADIOLIB_SX126X_MAX_PACKET_LENGTH];
+    uint8_t wake_len;
+    float wake_snr, wake_rssi;
+
+    // after a deep sleep with the radio left in Rx (see MainBoard::enterRxSleep()), the frame which woke us is still
+    // in the radio, so must be read out before begin() resets it
+    void readWakeFrame() {
+      wake_len = 0;
+      if (esp_reset_reason() != ESP_RST_DEEPSLEEP) return;
+      pinMode(P_LORA_DIO_1, INPUT);
+      if (digitalRead(P_LORA_DIO_1) != HIGH) return;   // woken by timer
+
+      getMod()->init();
+      size_t len = getPacketLength();
+      if (len == 0 || len > sizeof(wake_data)) return;
+      wake_snr = getSNR();
+      wake_rssi = getRSSI();
+      if (readData(wake_data, len) == RADIOLIB_ERR_NONE) wake_len = len;
+    }
+  #endif
+
   public:
-    CustomSX1262(Module *mod) : SX1262(mod) { }
+    CustomSX1262(Module *mod) : SX1262(mod) {
+  #if defined(ESP32) && defined(P_LORA_DIO_1)
+      wake_len = 0;
+  #endif
+    }
+
+    /**
+     * \brief  the frame which woke the board from deep sleep (if any). Can only be taken once
+     * \returns  its length, or zero
+    */
+    int takeWakeFrame(uint8_t* dest, float& snr, float& rssi) {
+  #if defined(ESP32) && defined(P_LORA_DIO_1)
+      int len = wake_len;
+      memcpy(dest, wake_data, len);
+      snr = wake_snr;
+      rssi = wake_rssi;
+      wake_len = 0;
+      return len;
+  #else
+      return 0;
+  #endif
+    }
 
   #ifdef RP2040_PLATFORM
     bool std_init(SPIClassRP2040* spi = NULL)
@@ -41,6 +84,9 @@ class CustomSX1262 : public SX1262 {
     #else
       if (spi) spi->begin(P_LORA_SCLK, P_LORA_MISO, P_LORA_MOSI);
     #endif
+  #endif
+  #if defined(ESP32) && defined(P_LORA_DIO_1)
+      readWakeFrame();
   #endif
       int status = begin(LORA_FREQ, LORA_BW, LORA_SF, cr, RADIOLIB_SX126X_SYNC_WORD_PRIVATE, LORA_TX_POWER, 16, tcxo);
       // if radio init fails with -707/-706, try again with tcxo voltage set to 0.0f
@@ -12,13 +12,17 @@ public:
   float getCurrentRSSI() override {
     return ((CustomSX1262 *)_radio)->getRSSI(false);
   }
-  float getLastRSSI() const override { return ((CustomSX1262 *)_radio)->getRSSI(); }
-  float getLastSNR() const override { return ((CustomSX1262 *)_radio)->getSNR(); }
-
-  float packetScore(float snr, int packet_len) override {
-    int sf = ((CustomSX1262 *)_radio)->spreadingFactor;
-    return packetScoreInt(snr, sf, packet_len);
+  float getPacketRSSI() const override { return ((CustomSX1262 *)_radio)->getRSSI(); }
+  float getPacketSNR() const override { return ((CustomSX1262 *)_radio)->getSNR(); }
+  void readPacketStatus(float& snr, float& rssi) override { readSX126xPacketStatus((CustomSX1262 *)_radio, snr, rssi); }
+  int16_t startReceiveDutyCycle() override {
+    return ((CustomSX1262 *)_radio)->startReceiveDutyCycleAuto(RADIO_LONG_PREAMBLE_LEN, 8);   // wake for 8 symbols
+  }
+  int takeWakeFrame(RadioRxFrame& f) override {
+    f.len = ((CustomSX1262 *)_radio)->takeWakeFrame(f.data, f.snr, f.rssi);
+    return f.len;
   }
+
   virtual void powerOff() override {
     ((CustomSX1262 *)_radio)->sleep(false);
   }
@@ -12,11 +12,6 @@ public:
   float getCurrentRSSI() override {
     return ((CustomSX1276 *)_radio)->getRSSI(false);
   }
-  float getLastRSSI() const override { return ((CustomSX1276 *)_radio)->getRSSI(); }
-  float getLastSNR() const override { return ((CustomSX1276 *)_radio)->getSNR(); }
-
-  float packetScore(float snr, int packet_len) override {
-    int sf = ((CustomSX1276 *)_radio)->spreadingFactor;
-    return packetScoreInt(snr, sf, packet_len);
-  }
+  float getPacketRSSI() const override { return ((CustomSX1276 *)_radio)->getRSSI(); }
+  float getPacketSNR() const override { return ((CustomSX1276 *)_radio)->getSNR(); }
 };
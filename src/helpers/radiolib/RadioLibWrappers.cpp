@@ -8,8 +8,14 @@
 #define STATE_TX_DONE    4
 #define STATE_INT_READY 16
 
-#define NUM_NOISE_FLOOR_SAMPLES  64
-#define SAMPLING_THRESHOLD  14
+#ifndef NOISE_FLOOR_SAMPLE_MILLIS
+  #define NOISE_FLOOR_SAMPLE_MILLIS  100   // one RSSI read (SPI transaction) per this, at most
+#endif
+#define NOISE_FLOOR_MIN          -120
+#define NOISE_FLOOR_WINDOW_MILLIS  60000
+// streaming estimate of the 25th percentile of idle RSSI, so bursts of traffic/interference don't drag it up
+#define FLOOR_STEP_UP       1    // x16, ie. step * q
+#define FLOOR_STEP_DOWN     3    // x16, ie. step * (1 - q)
 
 static volatile uint8_t state = STATE_IDLE;
 
@@ -29,15 +35,23 @@ void RadioLibWrapper::begin() {
   state = STATE_IDLE;
 
   if (_board->getStartupReason() == BD_STARTUP_RX_PACKET) {  // received a LoRa packet (while in deep sleep)
-    setFlag(); // LoRa packet is already received
+    _rx_head = _rx_count = 0;
+    if (takeWakeFrame(_rx_queue[0]) > 0) {   // was read out before radio was reset
+      _rx_count = 1;
+      n_recv++;
+    } else {
+      setFlag(); // LoRa packet is already received
+    }
   }
 
   _noise_floor = 0;
   _threshold = 0;
 
-  // start average out some samples
-  _num_floor_samples = 0;
-  _floor_sample_sum = 0;
+  _floor_est = 0;
+  _next_floor_sample = _floor_window_end = millis();
+  _window_min = _window_max = _floor_min = _floor_max = 0;
+
+  resetAirtimeCache();
 }
 
 void RadioLibWrapper::idle() {
@@ -46,11 +60,7 @@ void RadioLibWrapper::idle() {
 }
 
 void RadioLibWrapper::triggerNoiseFloorCalibrate(int threshold) {
-  _threshold = threshold;
-  if (_num_floor_samples >= NUM_NOISE_FLOOR_SAMPLES) {  // ignore trigger if currently sampling
-    _num_floor_samples = 0;
-    _floor_sample_sum = 0;
-  }
+  _threshold = threshold;   // NOTE: floor itself is now tracked continuously, in loop()
 }
 
 void RadioLibWrapper::resetAGC() {
@@ -63,27 +73,40 @@ void RadioLibWrapper::resetAGC() {
 }
 
 void RadioLibWrapper::loop() {
-  if (state == STATE_RX && _num_floor_samples < NUM_NOISE_FLOOR_SAMPLES) {
-    if (!isReceivingPacket()) {
-      int rssi = getCurrentRSSI();
-      if (rssi < _noise_floor + SAMPLING_THRESHOLD) {  // only consider samples below current floor + sampling THRESHOLD
-        _num_floor_samples++;
-        _floor_sample_sum += rssi;
-      }
-    }
-  } else if (_num_floor_samples >= NUM_NOISE_FLOOR_SAMPLES && _floor_sample_sum != 0) {
-    _noise_floor = _floor_sample_sum / NUM_NOISE_FLOOR_SAMPLES;
-    if (_noise_floor < -120) {
-      _noise_floor = -120;    // clamp to lower bound of -120dBi
-    }
-    _floor_sample_sum = 0;
+  serviceRecv();
+
+  if (_rx_duty_cycle) return;   // radio is asleep most of the time, so RSSI samples are meaningless
+  if (state != STATE_RX || (long)(millis() - _next_floor_sample) < 0) return;   // decimate the samples
+  if (isReceivingPacket()) return;
+  _next_floor_sample = millis() + NOISE_FLOOR_SAMPLE_MILLIS;
 
-    MESH_DEBUG_PRINTLN("RadioLibWrapper: noise_floor = %d", (int)_noise_floor);
+  int rssi = getCurrentRSSI();
+  if (_floor_est == 0) {   // first sample
+    _floor_est = rssi * 16;
+    _window_min = _window_max = rssi;
+  } else if (rssi * 16 > _floor_est) {
+    _floor_est += FLOOR_STEP_UP;
+  } else {
+    _floor_est -= FLOOR_STEP_DOWN;
+  }
+
+  int floor = _floor_est / 16;
+  if (floor < NOISE_FLOOR_MIN) floor = NOISE_FLOOR_MIN;    // clamp to lower bound of -120dBi
+  _noise_floor = floor;
+
+  if (rssi < _window_min) _window_min = rssi;
+  if (rssi > _window_max) _window_max = rssi;
+  if ((long)(millis() - _floor_window_end) >= 0) {   // end of a minute
+    _floor_min = _window_min;
+    _floor_max = _window_max;
+    _window_min = _window_max = rssi;
+    _floor_window_end = millis() + NOISE_FLOOR_WINDOW_MILLIS;
+    MESH_DEBUG_PRINTLN("RadioLibWrapper: noise_floor = %d (min %d, max %d)", (int)_noise_floor, (int)_floor_min, (int)_floor_max);
   }
 }
 
 void RadioLibWrapper::startRecv() {
-  int err = _radio->startReceive();
+  int err = _rx_duty_cycle ? startReceiveDutyCycle() : _radio->startReceive();
   if (err == RADIOLIB_ERR_NONE) {
     state = STATE_RX;
   } else {
@@ -91,41 +114,116 @@ void RadioLibWrapper::startRecv() {
   }
 }
 
+bool RadioLibWrapper::setRxDutyCycle(bool enable) {
+  if (enable && startReceiveDutyCycle() == RADIOLIB_ERR_UNSUPPORTED) {
+    MESH_DEBUG_PRINTLN("RadioLibWrapper: Rx duty cycle not supported by radio");
+    idle();
+    return false;
+  }
+  _rx_duty_cycle = enable;
+  idle();   // re-arm in new mode on next loop()
+  return true;
+}
+
+void RadioLibWrapper::setLongPreamble(bool enable) {
+  if (enable == _long_preamble) return;
+
+  _radio->setPreambleLength(enable ? RADIO_LONG_PREAMBLE_LEN : RADIO_PREAMBLE_LEN);
+  _long_preamble = enable;
+}
+
+void RadioLibWrapper::setTxFrequency(float freq) {
+  if (freq == _config.freq) freq = 0;
+  if (freq == _tx_freq) return;
+  if (_config.freq == 0) {   // can't switch back
+    MESH_DEBUG_PRINTLN("RadioLibWrapper: setTxFrequency() needs setRadioConfig() with freq");
+    return;
+  }
+
+  _radio->setFrequency(freq != 0 ? freq : _config.freq);
+  _tx_freq = freq;
+}
+
+void RadioLibWrapper::setOutputPower(int8_t dbm) {
+  if (dbm == _tx_power) return;   // (saves an SPI transaction per packet)
+
+  _radio->setOutputPower(dbm);
+  _tx_power = dbm;
+}
+
 bool RadioLibWrapper::isInRecvMode() const {
   return (state & ~STATE_INT_READY) == STATE_RX;
 }
 
+void RadioLibWrapper::serviceRecv() {
+  // NOTE: the frame can't be read from within the ISR itself, as RadioLib needs SPI (and the radio is shared with
+  //    the main loop), so is read at the first poll after the interrupt.
+  if ((state & STATE_INT_READY) == 0 || (state & ~STATE_INT_READY) == STATE_TX_WAIT) return;   // nothing received
+
+  int len = _radio->getPacketLength();
+  if (len > 0) {
+    if (len > MAX_TRANS_UNIT) { len = MAX_TRANS_UNIT; }
+    if (_rx_count >= RADIO_RX_QUEUE_SIZE) {   // queue full, drop oldest
+      _rx_head = (_rx_head + 1) % RADIO_RX_QUEUE_SIZE;
+      _rx_count--;
+      n_rx_dropped++;
+    }
+    auto f = &_rx_queue[(_rx_head + _rx_count) % RADIO_RX_QUEUE_SIZE];
+    int err = _radio->readData(f->data, len);
+    if (err != RADIOLIB_ERR_NONE) {
+      MESH_DEBUG_PRINTLN("RadioLibWrapper: error: readData(%d)", err);
+    } else {
+      f->len = len;
+      readPacketStatus(f->snr, f->rssi);
+      _rx_count++;
+      n_recv++;
+    }
+  }
+  state = STATE_IDLE;
+  startRecv();   // re-arm straight away, so next frame can be received while this one waits in queue
+}
+
 int RadioLibWrapper::recvRaw(uint8_t* bytes, int sz) {
+  serviceRecv();
+
   int len = 0;
-  if (state & STATE_INT_READY) {
-    len = _radio->getPacketLength();
-    if (len > 0) {
-      if (len > sz) { len = sz; }
-      int err = _radio->readData(bytes, len);
-      if (err != RADIOLIB_ERR_NONE) {
-        MESH_DEBUG_PRINTLN("RadioLibWrapper: error: readData(%d)", err);
-        len = 0;
-      } else {
-      //  Serial.print("  readData() -> "); Serial.println(len);
-        n_recv++;
-      }
-    }
-    state = STATE_IDLE;   // need another startReceive()
+  if (_rx_count > 0) {
+    auto f = &_rx_queue[_rx_head];
+    len = f->len;
+    if (len > sz) { len = sz; }
+    memcpy(bytes, f->data, len);
+    _last_snr = f->snr;
+    _last_rssi = f->rssi;
+    _rx_head = (_rx_head + 1) % RADIO_RX_QUEUE_SIZE;
+    _rx_count--;
   }
 
   if (state != STATE_RX) {
-    int err = _radio->startReceive();
-    if (err == RADIOLIB_ERR_NONE) {
-      state = STATE_RX;
-    } else {
-      MESH_DEBUG_PRINTLN("RadioLibWrapper: error: startReceive(%d)", err);
-    }
+    startRecv();
   }
   return len;
 }
 
 uint32_t RadioLibWrapper::getEstAirtimeFor(int len_bytes) {
-  return _radio->getTimeOnAir(len_bytes) / 1000;
+  if (_long_preamble || len_bytes < 0 || len_bytes >= AIRTIME_CACHE_SIZE) {   // cache is for normal preamble
+    return _radio->getTimeOnAir(len_bytes) / 1000;
+  }
+  uint16_t t = _airtime_cache[len_bytes];
+  if (t == 0) {   // not calculated yet for current radio params
+    uint32_t millis = _radio->getTimeOnAir(len_bytes) / 1000;
+    if (millis == 0 || millis > 0xFFFF) return millis;   // can't be cached
+    _airtime_cache[len_bytes] = t = millis;
+  }
+  return t;
+}
+
+uint32_t RadioLibWrapper::getEstAirtimeFor(int len_bytes, bool long_preamble) {
+  uint32_t t = getEstAirtimeFor(len_bytes);
+  if (long_preamble == _long_preamble || _config.bw <= 0) return t;
+
+  // only the preamble symbols differ
+  uint32_t diff = (uint32_t) ((RADIO_LONG_PREAMBLE_LEN - RADIO_PREAMBLE_LEN) * (float)(1 << _config.sf) / _config.bw);
+  return long_preamble ? t + diff : (t > diff ? t - diff : 0);
 }
 
 bool RadioLibWrapper::startSendRaw(const uint8_t* bytes, int len) {
@@ -136,6 +234,8 @@ bool RadioLibWrapper::startSendRaw(const uint8_t* bytes, int len) {
     return true;
   }
   MESH_DEBUG_PRINTLN("RadioLibWrapper: error: startTransmit(%d)", err);
+  setLongPreamble(false);
+  setTxFrequency(0);   // back to where we receive
   idle();   // trigger another startRecv()
   return false;
 }
@@ -152,24 +252,58 @@ bool RadioLibWrapper::isSendComplete() {
 void RadioLibWrapper::onSendFinished() {
   _radio->finishTransmit();
   _board->onAfterTransmit();
+  setLongPreamble(false);
+  setTxFrequency(0);
   state = STATE_IDLE;
+  startRecv();   // straight back to receive, so we don't miss ACKs or repeats that come right after
+}
+
+bool RadioLibWrapper::scanForPreamble() {
+  // only from (idle) receive mode, and not while a received frame is waiting to be read
+  if (state != STATE_RX) return false;
+
+  int16_t result = _radio->scanChannel();   // blocks for the CAD (a couple of symbols), leaves radio in standby
+  state = STATE_IDLE;   // CAD-done also fires the DIO1 interrupt, so discard that
+  startRecv();   // back to receive straight away, so a packet just detected isn't missed
+
+  if (result == RADIOLIB_LORA_DETECTED || result == RADIOLIB_PREAMBLE_DETECTED) {
+    n_cad_busy++;
+    return true;
+  }
+  if (result != RADIOLIB_CHANNEL_FREE) {
+    MESH_DEBUG_PRINTLN("RadioLibWrapper: error: scanChannel(%d)", result);
+  }
+  return false;
 }
 
 bool RadioLibWrapper::isChannelActive() {
+#if RADIO_CAD_LBT
+  // NOTE: CAD detects LoRa preambles even below the noise floor, where the RSSI check below can't
+  if (scanForPreamble()) return true;
+#endif
   return _threshold == 0 
           ? false    // interference check is disabled
           : getCurrentRSSI() > _noise_floor + _threshold;
 }
 
-float RadioLibWrapper::getLastRSSI() const {
+float RadioLibWrapper::getPacketRSSI() const {
   return _radio->getRSSI();
 }
-float RadioLibWrapper::getLastSNR() const {
+float RadioLibWrapper::getPacketSNR() const {
   return _radio->getSNR();
 }
 
+float RadioLibWrapper::getLastRSSI() const {
+  return _last_rssi;
+}
+float RadioLibWrapper::getLastSNR() const {
+  return _last_snr;
+}
+
 // Approximate SNR threshold per SF for successful reception (based on Semtech datasheets)
-static float snr_threshold[] = {
+static const float snr_threshold[] = {
+    -2.5,  // SF5 needs at least -2.5 dB SNR
+    -5,    // SF6 needs at least -5 dB SNR
     -7.5,  // SF7 needs at least -7.5 dB SNR
     -10,   // SF8 needs at least -10 dB SNR
     -12.5, // SF9 needs at least -12.5 dB SNR
@@ -177,14 +311,25 @@ static float snr_threshold[] = {
     -17.5,// SF11 needs at least -17.5 dB SNR
     -20   // SF12 needs at least -20 dB SNR
 };
-  
-float RadioLibWrapper::packetScoreInt(float snr, int sf, int packet_len) {
-  if (sf < 7) return 0.0f;
-  
-  if (snr < snr_threshold[sf - 7]) return 0.0f;    // Below threshold, no chance of success
 
-  auto success_rate_based_on_snr = (snr - snr_threshold[sf - 7]) / 10.0;
-  auto collision_penalty = 1 - (packet_len / 256.0);   // Assuming max packet of 256 bytes
+void RadioLibWrapper::setRadioConfig(uint8_t sf, float bw, uint8_t cr, float freq) {
+  _config.sf = sf;
+  _config.bw = bw;
+  _config.cr = cr;
+  _config.freq = freq;
+  _tx_freq = 0;   // radio has just been set to 'freq'
+
+  int i = sf < 5 ? 0 : (sf > 12 ? 7 : sf - 5);
+  _score_snr_min = snr_threshold[i];
+  resetAirtimeCache();
+}
+
+float RadioLibWrapper::packetScore(float snr, int packet_len) {
+  if (snr < _score_snr_min) return 0.0f;    // Below threshold, no chance of success
+
+  float success_rate_based_on_snr = (snr - _score_snr_min) * 0.1f;
+  float collision_penalty = 1.0f - packet_len * (1.0f / 256.0f);   // Assuming max packet of 256 bytes
 
-  return max(0.0, min(1.0, success_rate_based_on_snr * collision_penalty));
+  float score = success_rate_based_on_snr * collision_penalty;
+  return score < 0.0f ? 0.0f : (score > 1.0f ? 1.0f : score);
 }
@@ -3,33 +3,128 @@
 #include <Mesh.h>
 #include <RadioLib.h>
 
+#ifndef AIRTIME_CACHE_SIZE
+  #define AIRTIME_CACHE_SIZE   256   // one entry per possible packet length
+#endif
+
+#ifndef RADIO_CAD_LBT
+  #define RADIO_CAD_LBT          1     // listen-before-talk with LoRa CAD (0 = only RSSI interference threshold)
+#endif
+
+#ifndef RADIO_PREAMBLE_LEN
+  #define RADIO_PREAMBLE_LEN       16    // symbols, as set by the Custom* radio std_init()
+#endif
+#ifndef RADIO_LONG_PREAMBLE_LEN
+  #define RADIO_LONG_PREAMBLE_LEN  64    // for sending to duty-cycled receivers (and what they sleep between checks for)
+#endif
+
+#ifndef RADIO_RX_QUEUE_SIZE
+  #define RADIO_RX_QUEUE_SIZE    4     // frames held between radio and recvRaw(), ~260 bytes each
+#endif
+
+struct RadioConfig {
+  uint8_t sf, cr;
+  float bw;   // kHz
+  float freq;   // MHz
+};
+
+struct RadioRxFrame {
+  float snr, rssi;    // as read with the frame (before the next one overwrites them in the radio)
+  uint8_t len;
+  uint8_t data[MAX_TRANS_UNIT];
+};
+
 class RadioLibWrapper : public mesh::Radio {
 protected:
   PhysicalLayer* _radio;
   mesh::MainBoard* _board;
   uint32_t n_recv, n_sent;
   int16_t _noise_floor, _threshold;
-  uint16_t _num_floor_samples;
-  int32_t _floor_sample_sum;
+  int32_t _floor_est;            // x16 fixed point, zero until first sample
+  unsigned long _next_floor_sample, _floor_window_end;
+  int16_t _window_min, _window_max;   // of samples in current minute
+  int16_t _floor_min, _floor_max;     // of samples in previous minute
+  uint16_t _airtime_cache[AIRTIME_CACHE_SIZE];   // millis, by packet length (0 = not calculated yet)
+  RadioRxFrame _rx_queue[RADIO_RX_QUEUE_SIZE];
+  uint8_t _rx_head, _rx_count;
+  uint32_t n_rx_dropped, n_cad_busy;
+  float _last_snr, _last_rssi;   // of frame last returned by recvRaw()
+  RadioConfig _config;
+  float _score_snr_min;   // min SNR for successful reception at current SF
+  bool _rx_duty_cycle, _long_preamble;
+  float _tx_freq;   // MHz, zero if on configured freq
+  int8_t _tx_power;   // dBm, as last set by setOutputPower(), or 127 if not yet
 
   void idle();
   void startRecv();
-  float packetScoreInt(float snr, int sf, int packet_len);
+  bool scanForPreamble();
   virtual bool isReceivingPacket() =0;
+  virtual float getPacketRSSI() const;    // of packet just received, direct from radio
+  virtual float getPacketSNR() const;
+  virtual void readPacketStatus(float& snr, float& rssi) { snr = getPacketSNR(); rssi = getPacketRSSI(); }
+  /**
+   * \brief  start a receive which sleeps between short checks for a preamble of RADIO_LONG_PREAMBLE_LEN
+   * \returns  RADIOLIB_ERR_UNSUPPORTED if the radio can't
+  */
+  virtual int16_t startReceiveDutyCycle() { return RADIOLIB_ERR_UNSUPPORTED; }
+  /**
+   * \brief  the frame which woke the board from deep sleep, if the radio was able to read it before being reset
+   * \returns  its length, or zero
+  */
+  virtual int takeWakeFrame(RadioRxFrame& f) { return 0; }
 
 public:
-  RadioLibWrapper(PhysicalLayer& radio, mesh::MainBoard& board) : _radio(&radio), _board(&board) { n_recv = n_sent = 0; }
+  RadioLibWrapper(PhysicalLayer& radio, mesh::MainBoard& board) : _radio(&radio), _board(&board) {
+    n_recv = n_sent = n_rx_dropped = n_cad_busy = 0;
+    _rx_head = _rx_count = 0;
+    _last_snr = _last_rssi = 0;
+    _rx_duty_cycle = _long_preamble = false;
+    _tx_power = 127;
+    setRadioConfig(10, 250.0f, 5, 0);   // until radio_set_params()
+  }
 
   void begin() override;
   virtual void powerOff() { _radio->sleep(); }
   int recvRaw(uint8_t* bytes, int sz) override;
+
+  /**
+   * \brief  if a frame has been received, read it from the radio into the RX queue and re-arm receive straight away.
+   *      Is called from loop() and recvRaw(), and can also be called from any long running task (eg. a display
+   *      refresh or flash write), so back-to-back frames aren't lost while the main loop is busy.
+  */
+  void serviceRecv();
   uint32_t getEstAirtimeFor(int len_bytes) override;
+  uint32_t getEstAirtimeFor(int len_bytes, bool long_preamble) override;
   bool startSendRaw(const uint8_t* bytes, int len) override;
   bool isSendComplete() override;
   void onSendFinished() override;
   bool isInRecvMode() const override;
   bool isChannelActive();
 
+  /**
+   * \brief  MUST be called after changing any of the modulation params (SF, BW, CR, preamble)
+  */
+  void resetAirtimeCache() { memset(_airtime_cache, 0, sizeof(_airtime_cache)); }
+
+  /**
+   * \brief  MUST be called after changing the modulation params (ie. from radio_set_params()). Updates the cached
+   *      config, used for packetScore(), and resets the airtime cache.
+  */
+  void setRadioConfig(uint8_t sf, float bw, uint8_t cr, float freq);
+  const RadioConfig& getRadioConfig() const { return _config; }
+
+  /**
+   * \brief  low power receive, where the radio sleeps most of the time, waking to check for a preamble. Senders
+   *      MUST use a preamble of RADIO_LONG_PREAMBLE_LEN for every packet to be caught (see ADV_CAP_LOW_POWER_RX)
+   * \returns  false if not supported by this radio
+  */
+  bool setRxDutyCycle(bool enable);
+  bool isRxDutyCycle() const { return _rx_duty_cycle; }
+  void setLongPreamble(bool enable) override;
+  void setTxFrequency(float freq) override;
+  void setOutputPower(int8_t dbm) override;
+  float getMinSNR() const override { return _score_snr_min; }
+
   bool isReceiving() override { 
     if (isReceivingPacket()) return true;
 
@@ -39,6 +134,8 @@ public:
   virtual float getCurrentRSSI() =0;
 
   int getNoiseFloor() const override { return _noise_floor; }
+  int getNoiseFloorMin() const { return _floor_min; }   // lowest RSSI sample in last minute
+  int getNoiseFloorMax() const { return _floor_max; }   // highest (idle channel) RSSI sample in last minute
   void triggerNoiseFloorCalibrate(int threshold) override;
   void resetAGC() override;
 
@@ -46,14 +143,27 @@ public:
 
   uint32_t getPacketsRecv() const { return n_recv; }
   uint32_t getPacketsSent() const { return n_sent; }
-  void resetStats() { n_recv = n_sent = 0; }
+  uint32_t getRxDropped() const { return n_rx_dropped; }
+  uint32_t getCADBusy() const { return n_cad_busy; }
+  void resetStats() { n_recv = n_sent = n_rx_dropped = n_cad_busy = 0; }
 
   virtual float getLastRSSI() const override;
   virtual float getLastSNR() const override;
 
-  float packetScore(float snr, int packet_len) override { return packetScoreInt(snr, 10, packet_len); }  // assume sf=10
+  float packetScore(float snr, int packet_len) override;
 };
 
+/**
+ * \brief  reads both RSSI and SNR of last packet from an SX126x family radio in a single GetPacketStatus command.
+ *      (RadioLib's getRSSI() and getSNR() each issue their own)
+*/
+inline void readSX126xPacketStatus(SX126x* radio, float& snr, float& rssi) {
+  uint8_t data[3] = { 0, 0, 0 };   // RssiPkt, SnrPkt, SignalRssiPkt
+  radio->getMod()->SPIreadStream(RADIOLIB_SX126X_CMD_GET_PACKET_STATUS, data, 3);
+  rssi = -0.5f * data[0];
+  snr = ((int8_t) data[1]) * 0.25f;
+}
+
 /**
  * \brief  an RNG impl using the noise from the LoRa radio as entropy.
  *         NOTE: this is VERY SLOW!  Use only for things like creating new LocalIdentity
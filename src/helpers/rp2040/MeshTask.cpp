@@ -0,0 +1,23 @@
+#include "MeshTask.h"
+
+#if defined(RP2040_PLATFORM) && defined(MESH_TASK_CORE)
+
+MeshTask* MeshTask::_instance = NULL;
+
+void MeshTask::runCore1() {
+  MeshTask* t = _instance;
+  if (t && t->_running) {
+    __mem_fence_acquire();
+    t->lock();
+    t->_fn(t->_ctx);
+    t->unlock();
+  }
+  delayMicroseconds(MESH_TASK_YIELD_MICROS);
+}
+
+// arduino-pico only starts core 1 if this is defined
+void loop1() {
+  MeshTask::runCore1();
+}
+
+#endif
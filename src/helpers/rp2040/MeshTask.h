@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+
+#if defined(RP2040_PLATFORM)
+
+#include <pico/mutex.h>
+
+#ifndef MESH_TASK_YIELD_MICROS
+  #define MESH_TASK_YIELD_MICROS   200    // between calls of the mesh loop, so core 0 can get the lock
+#endif
+
+/**
+ * \brief  Runs the mesh (Dispatcher, radio, routing) on core 1, so that forwarding latency doesn't depend on what the
+ *     Arduino loop() (USB serial, UI rendering, flash writes) is doing on core 0. Same interface as the ESP32 MeshTask:
+ *     the mesh's loop function is called with the lock held, and code on core 0 which needs to call into the mesh (or
+ *     touch state it shares) takes the lock around that call (see MeshTask::Guard).
+ *  NOTE: core 1 is started by the arduino-pico core, as loop1() is defined (see MeshTask.cpp), which also has it
+ *     paused while core 0 writes to flash. Only core 1 can be given to begin().
+*/
+class MeshTask {
+  void (*_fn)(void*);
+  void* _ctx;
+  volatile bool _running;
+  recursive_mutex_t _lock;
+
+  static MeshTask* _instance;
+
+public:
+  MeshTask() : _fn(NULL), _ctx(NULL), _running(false) { recursive_mutex_init(&_lock); }
+
+  /**
+   * \param  fn  the mesh loop, called repeatedly on core 1 (with 'ctx')
+   * \returns  false if 'core' isn't 1 (caller should then just call 'fn' from its own loop)
+  */
+  bool begin(void (*fn)(void*), void* ctx, int core, const char* name = "mesh") {
+    if (_running) return true;  // already started
+    if (core != 1) return false;   // core 0 is the Arduino loop()
+    _fn = fn;
+    _ctx = ctx;
+    _instance = this;
+    __mem_fence_release();
+    _running = true;
+    return true;
+  }
+
+  bool isRunning() const { return _running; }
+
+  void lock() { recursive_mutex_enter_blocking(&_lock); }
+  void unlock() { recursive_mutex_exit(&_lock); }
+
+  /** \brief  (core 1) one call of the mesh loop, once begin() has been called */
+  static void runCore1();
+
+  /** \brief  holds the lock for the current scope */
+  class Guard {
+    MeshTask* _t;
+  public:
+    Guard(MeshTask& t) : _t(&t) { _t->lock(); }
+    ~Guard() { _t->unlock(); }
+  };
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "EnvironmentSensorManager.h"
+#include <LoopMonitor.h>
 
 #if ENV_PIN_SDA && ENV_PIN_SCL
 #define TELEM_WIRE &Wire1  // Use Wire1 as the I2C bus for Environment Sensors
@@ -11,6 +12,12 @@
 #define TELEM_BME680_ADDRESS 0x76
 #endif
 #define TELEM_BME680_SEALEVELPRESSURE_HPA (1013.25)
+#ifndef TELEM_BME680_INTERVAL_SECS
+  #define TELEM_BME680_INTERVAL_SECS  60      // gas heater cycle is slow and power hungry, so not too often
+#endif
+#ifndef TELEM_BME680_CHANGE_THRESHOLD
+  #define TELEM_BME680_CHANGE_THRESHOLD  1.0f   // degrees C
+#endif
 #include <Adafruit_BME680.h>
 static Adafruit_BME680 BME680;
 #endif
@@ -96,10 +103,21 @@ static Adafruit_MLX90614 MLX90614;
 
 #if ENV_INCLUDE_VL53L0X
 #define TELEM_VL53L0X_ADDRESS 0x29      // VL53L0X time-of-flight distance sensor I2C address
+#ifndef TELEM_VL53L0X_INTERVAL_SECS
+  #define TELEM_VL53L0X_INTERVAL_SECS  10
+#endif
+#ifndef TELEM_VL53L0X_CHANGE_THRESHOLD
+  #define TELEM_VL53L0X_CHANGE_THRESHOLD  0.1f   // metres
+#endif
+#define VL53L0X_RANGE_MILLIS   50      // max time for a single range measurement (default timing budget is ~33ms)
 #include <Adafruit_VL53L0X.h>
 static Adafruit_VL53L0X VL53L0X;
 #endif
 
+#ifndef GPS_RX_BUFFER_SIZE
+  #define GPS_RX_BUFFER_SIZE  1024   // about 2 secs of a busy 9600 baud NMEA stream
+#endif
+
 #if ENV_INCLUDE_GPS && defined(RAK_BOARD) && !defined(RAK_WISMESH_TAG)
 #define RAK_WISBLOCK_GPS
 #endif
@@ -148,6 +166,22 @@ public:
 static RAK12500LocationProvider RAK12500_provider;
 #endif
 
+#if ENV_INCLUDE_GPS
+EnvironmentSensorManager::EnvironmentSensorManager(LocationProvider &location): _location(&location)
+#else
+EnvironmentSensorManager::EnvironmentSensorManager()
+#endif
+#if ENV_INCLUDE_BME680 && ENV_INCLUDE_VL53L0X
+  : BME680_schedule(TELEM_BME680_INTERVAL_SECS, TELEM_BME680_CHANGE_THRESHOLD),
+    VL53L0X_schedule(TELEM_VL53L0X_INTERVAL_SECS, TELEM_VL53L0X_CHANGE_THRESHOLD)
+#elif ENV_INCLUDE_BME680
+  : BME680_schedule(TELEM_BME680_INTERVAL_SECS, TELEM_BME680_CHANGE_THRESHOLD)
+#elif ENV_INCLUDE_VL53L0X
+  : VL53L0X_schedule(TELEM_VL53L0X_INTERVAL_SECS, TELEM_VL53L0X_CHANGE_THRESHOLD)
+#endif
+{
+}
+
 bool EnvironmentSensorManager::begin() {
   #if ENV_INCLUDE_GPS
   #ifdef RAK_WISBLOCK_GPS
@@ -345,15 +379,13 @@ bool EnvironmentSensorManager::querySensors(uint8_t requester_permissions, Cayen
     #endif
 
     #if ENV_INCLUDE_BME680
-    if (BME680_initialized) {
-      if (BME680.performReading()) {
-        telemetry.addTemperature(TELEM_CHANNEL_SELF, BME680.temperature);
-        telemetry.addRelativeHumidity(TELEM_CHANNEL_SELF, BME680.humidity);
-        telemetry.addBarometricPressure(TELEM_CHANNEL_SELF, BME680.pressure / 100);
-        telemetry.addAltitude(TELEM_CHANNEL_SELF, 44330.0 * (1.0 - pow((BME680.pressure / 100) / TELEM_BME680_SEALEVELPRESSURE_HPA, 0.1903)));
-        telemetry.addAnalogInput(next_available_channel, BME680.gas_resistance);
-        next_available_channel++;
-      }
+    if (BME680_initialized && BME680_schedule.hasReading()) {   // last reading from pollSchedules()
+      telemetry.addTemperature(TELEM_CHANNEL_SELF, BME680_temperature);
+      telemetry.addRelativeHumidity(TELEM_CHANNEL_SELF, BME680_humidity);
+      telemetry.addBarometricPressure(TELEM_CHANNEL_SELF, BME680_pressure / 100);
+      telemetry.addAltitude(TELEM_CHANNEL_SELF, 44330.0 * (1.0 - pow((BME680_pressure / 100) / TELEM_BME680_SEALEVELPRESSURE_HPA, 0.1903)));
+      telemetry.addAnalogInput(next_available_channel, BME680_gas);
+      next_available_channel++;
     }
     #endif
 
@@ -454,14 +486,8 @@ bool EnvironmentSensorManager::querySensors(uint8_t requester_permissions, Cayen
     #endif
 
     #if ENV_INCLUDE_VL53L0X
-    if (VL53L0X_initialized) {
-      VL53L0X_RangingMeasurementData_t measure;
-      VL53L0X.rangingTest(&measure, false); // pass in 'true' to get debug data
-      if (measure.RangeStatus != 4) { // phase failures
-        telemetry.addDistance(TELEM_CHANNEL_SELF, measure.RangeMilliMeter / 1000.0f); // convert mm to m
-      } else {
-        telemetry.addDistance(TELEM_CHANNEL_SELF, 0.0f); // no valid measurement
-      }
+    if (VL53L0X_initialized && VL53L0X_schedule.hasReading()) {
+      telemetry.addDistance(TELEM_CHANNEL_SELF, VL53L0X_distance);
     }
     #endif
 
@@ -484,6 +510,12 @@ int EnvironmentSensorManager::getNumSettings() const {
   #if ENV_INCLUDE_GPS
     if (gps_detected) settings++;  // only show GPS setting if GPS is detected
   #endif
+  #if ENV_INCLUDE_BME680
+    if (BME680_initialized) settings++;
+  #endif
+  #if ENV_INCLUDE_VL53L0X
+    if (VL53L0X_initialized) settings++;
+  #endif
   return settings;
 }
 
@@ -494,6 +526,16 @@ const char* EnvironmentSensorManager::getSettingName(int i) const {
       return "gps";
     }
   #endif
+  #if ENV_INCLUDE_BME680
+    if (BME680_initialized && i == settings++) {
+      return "bme680.secs";
+    }
+  #endif
+  #if ENV_INCLUDE_VL53L0X
+    if (VL53L0X_initialized && i == settings++) {
+      return "vl53l0x.secs";
+    }
+  #endif
   // convenient way to add params (needed for some tests)
 //  if (i == settings++) return "param.2";
   return NULL;
@@ -506,6 +548,18 @@ const char* EnvironmentSensorManager::getSettingValue(int i) const {
       return gps_active ? "1" : "0";
     }
   #endif
+  #if ENV_INCLUDE_BME680
+    if (BME680_initialized && i == settings++) {
+      sprintf(setting_buf, "%d", (int) BME680_schedule.getInterval());
+      return setting_buf;
+    }
+  #endif
+  #if ENV_INCLUDE_VL53L0X
+    if (VL53L0X_initialized && i == settings++) {
+      sprintf(setting_buf, "%d", (int) VL53L0X_schedule.getInterval());
+      return setting_buf;
+    }
+  #endif
   // convenient way to add params ...
 //  if (i == settings++) return "2";
   return NULL;
@@ -522,13 +576,37 @@ bool EnvironmentSensorManager::setSettingValue(const char* name, const char* val
     return true;
   }
   #endif
+  #if ENV_INCLUDE_BME680
+  if (BME680_initialized && strcmp(name, "bme680.secs") == 0) {
+    int secs = atoi(value);
+    if (secs < 3) return false;   // heater cycle needs time to settle
+    BME680_schedule.setInterval(secs);
+    return true;
+  }
+  #endif
+  #if ENV_INCLUDE_VL53L0X
+  if (VL53L0X_initialized && strcmp(name, "vl53l0x.secs") == 0) {
+    int secs = atoi(value);
+    if (secs < 1) return false;
+    VL53L0X_schedule.setInterval(secs);
+    return true;
+  }
+  #endif
   return false;  // not supported
 }
 
 #if ENV_INCLUDE_GPS
+static void setGPSRxBuffer() {
+#if defined(ESP32)
+  // UART driver fills this from the RX interrupt, so a slow loop() doesn't drop sentences (default is only 256)
+  Serial1.setRxBufferSize(GPS_RX_BUFFER_SIZE);
+#endif
+}
+
 void EnvironmentSensorManager::initBasicGPS() {
 
   Serial1.setPins(PIN_GPS_TX, PIN_GPS_RX);
+  setGPSRxBuffer();
 
   #ifdef GPS_BAUD_RATE
   Serial1.begin(GPS_BAUD_RATE);
@@ -573,6 +651,7 @@ void EnvironmentSensorManager::initBasicGPS() {
 void EnvironmentSensorManager::rakGPSInit(){
 
   Serial1.setPins(PIN_GPS_TX, PIN_GPS_RX);
+  setGPSRxBuffer();
 
   #ifdef GPS_BAUD_RATE
   Serial1.begin(GPS_BAUD_RATE);
@@ -682,10 +761,71 @@ void EnvironmentSensorManager::stop_gps() {
   #endif
 }
 
+#endif
+
+void EnvironmentSensorManager::pollSchedules() {
+  #if ENV_INCLUDE_BME680
+  if (BME680_initialized) {
+    if (BME680_schedule.isDue()) {
+      unsigned long end_at = BME680.beginReading();   // starts heater + conversion, doesn't wait
+      if (end_at == 0) {
+        BME680_schedule.collected(0, false);   // try again next interval
+      } else {
+        long wait = (long)(end_at - millis());
+        BME680_schedule.started(wait > 0 ? wait : 0);
+      }
+    } else if (BME680_schedule.isReady()) {
+      bool success = BME680.endReading();   // should be finished now, so won't block
+      if (success) {
+        BME680_temperature = BME680.temperature;
+        BME680_humidity = BME680.humidity;
+        BME680_pressure = BME680.pressure;
+        BME680_gas = BME680.gas_resistance;
+      }
+      BME680_schedule.collected(BME680_temperature, success);
+    }
+  }
+  #endif
+
+  #if ENV_INCLUDE_VL53L0X
+  if (VL53L0X_initialized) {
+    if (VL53L0X_schedule.isDue()) {
+      VL53L0X.startRange();   // single shot
+      VL53L0X_schedule.started(VL53L0X_RANGE_MILLIS);
+    } else if (VL53L0X_schedule.isReady()) {
+      if (VL53L0X.isRangeComplete()) {
+        uint16_t mm = VL53L0X.readRangeResult();
+        if (VL53L0X.readRangeStatus() != 4) {  // phase failures
+          VL53L0X_distance = mm / 1000.0f;  // convert mm to m
+        } else {
+          VL53L0X_distance = 0.0f;   // no valid measurement
+        }
+        VL53L0X_schedule.collected(VL53L0X_distance, true);
+      } else {
+        VL53L0X_schedule.collected(0, false);   // timed out
+      }
+    }
+  }
+  #endif
+}
+
+bool EnvironmentSensorManager::pollChanges() {
+  bool changed = false;
+  #if ENV_INCLUDE_BME680
+  if (BME680_schedule.takeChanged()) changed = true;
+  #endif
+  #if ENV_INCLUDE_VL53L0X
+  if (VL53L0X_schedule.takeChanged()) changed = true;
+  #endif
+  return changed;
+}
+
 void EnvironmentSensorManager::loop() {
-  static long next_gps_update = 0;
+  LOOP_SCOPE(LOOP_SECT_SENSORS);
+  pollSchedules();
 
   #if ENV_INCLUDE_GPS
+  static long next_gps_update = 0;
   _location->loop();
 
   if (millis() > next_gps_update) {
@@ -712,4 +852,3 @@ void EnvironmentSensorManager::loop() {
   }
   #endif
 }
-#endif
@@ -3,6 +3,7 @@
 #include <Mesh.h>
 #include <helpers/SensorManager.h>
 #include <helpers/sensors/LocationProvider.h>
+#include <helpers/sensors/SensorSchedule.h>
 
 class EnvironmentSensorManager : public SensorManager {
 protected:
@@ -23,6 +24,17 @@ protected:
   bool BME680_initialized = false;
   bool BMP085_initialized = false;
 
+  #if ENV_INCLUDE_BME680
+  SensorSchedule BME680_schedule;
+  float BME680_temperature, BME680_humidity, BME680_pressure, BME680_gas;   // last reading
+  #endif
+  #if ENV_INCLUDE_VL53L0X
+  SensorSchedule VL53L0X_schedule;
+  float VL53L0X_distance;   // last reading (m)
+  #endif
+  mutable char setting_buf[12];
+
+  void pollSchedules();
   bool gps_detected = false;
   bool gps_active = false;
 
@@ -40,16 +52,15 @@ protected:
 
 public:
   #if ENV_INCLUDE_GPS
-  EnvironmentSensorManager(LocationProvider &location): _location(&location){};
+  EnvironmentSensorManager(LocationProvider &location);
   LocationProvider* getLocationProvider() { return _location; }
   #else
-  EnvironmentSensorManager(){};
+  EnvironmentSensorManager();
   #endif
   bool begin() override;
   bool querySensors(uint8_t requester_permissions, CayenneLPP& telemetry) override;
-  #if ENV_INCLUDE_GPS
   void loop() override;
-  #endif
+  bool pollChanges() override;
   int getNumSettings() const override;
   const char* getSettingName(int i) const override;
   const char* getSettingValue(int i) const override;
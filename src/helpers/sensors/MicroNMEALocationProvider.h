@@ -33,6 +33,25 @@
     #endif
 #endif
 
+#ifndef GPS_NMEA_FILTER
+    #define GPS_NMEA_FILTER  1      // only pass RMC and GGA sentences to the parser
+#endif
+
+#ifndef GPS_DUTY_OFF_SECS
+    #define GPS_DUTY_OFF_SECS  0    // eg. 600, to power GPS off between fixes (zero = always on)
+#endif
+#ifndef GPS_DUTY_FIX_SECS
+    #define GPS_DUTY_FIX_SECS  10   // secs of good fix needed before powering off
+#endif
+#ifndef GPS_DUTY_MAX_ON_SECS
+    #define GPS_DUTY_MAX_ON_SECS  300   // give up on a good fix after this, and power off anyway
+#endif
+#ifndef GPS_DUTY_MAX_HDOP
+    #define GPS_DUTY_MAX_HDOP  30   // in tenths, ie. 3.0
+#endif
+
+#define NMEA_HEADER_LEN   6       // eg. "$GPRMC"
+
 class MicroNMEALocationProvider : public LocationProvider {
     char _nmeaBuffer[100];
     MicroNMEA nmea;
@@ -43,6 +62,81 @@ class MicroNMEALocationProvider : public LocationProvider {
     int _pin_en;
     long next_check = 0;
     long time_valid = 0;
+    long good_fix_secs = 0;
+    char _header[NMEA_HEADER_LEN];
+    int8_t _header_len = -1;     // -1 = skipping to next '$'
+    bool _passing = false;
+    bool _active = false;        // between begin() and stop()
+    bool _duty_off = false;      // powered off by duty cycle
+    long _duty_since = 0;        // millis()/1000 when last powered on/off by duty cycle
+
+    void powerOn() {
+        if (_peripher_power) _peripher_power->claim();
+        if (_pin_en != -1) {
+            digitalWrite(_pin_en, PIN_GPS_EN_ACTIVE);
+        }
+        if (_pin_reset != -1) {
+            digitalWrite(_pin_reset, !GPS_RESET_FORCE);
+        }
+    }
+
+    void powerOff() {
+        if (_pin_en != -1) {
+            digitalWrite(_pin_en, !PIN_GPS_EN_ACTIVE);
+        }
+        if (_peripher_power) _peripher_power->release();
+    }
+
+    static bool isWantedSentence(const char* hdr) {   // talker id (GP, GN, GL, ..) is ignored
+        return memcmp(&hdr[3], "RMC", 3) == 0 || memcmp(&hdr[3], "GGA", 3) == 0;
+    }
+
+    void processChar(char c) {
+    #if GPS_NMEA_FILTER
+        if (c == '$') {
+            _header[0] = c;
+            _header_len = 1;
+            _passing = false;
+            return;
+        }
+        if (_passing) {
+            nmea.process(c);
+            if (c == '\n') _passing = false;
+        } else if (_header_len > 0) {
+            _header[_header_len++] = c;
+            if (_header_len == NMEA_HEADER_LEN) {
+                _header_len = -1;
+                if (isWantedSentence(_header)) {   // catch the parser up, then stream the rest to it
+                    for (int i = 0; i < NMEA_HEADER_LEN; i++) nmea.process(_header[i]);
+                    _passing = true;
+                }
+            }
+        }
+    #else
+        nmea.process(c);
+    #endif
+    }
+
+    bool hasGoodFix() {
+        return nmea.isValid() && nmea.getHDOP() <= GPS_DUTY_MAX_HDOP;
+    }
+
+    void checkDutyCycle(long secs) {   // called once per second
+        if (!_active || GPS_DUTY_OFF_SECS == 0) return;
+
+        if (_duty_off) {
+            if (secs - _duty_since >= GPS_DUTY_OFF_SECS) {
+                _duty_off = false;
+                _duty_since = secs;
+                powerOn();
+            }
+        } else if ((good_fix_secs >= GPS_DUTY_FIX_SECS && !_time_sync_needed) || secs - _duty_since >= GPS_DUTY_MAX_ON_SECS) {
+            // good fix (and clock synced), or taking too long
+            _duty_off = true;
+            _duty_since = secs;
+            powerOff();
+        }
+    }
 
 public :
     MicroNMEALocationProvider(Stream& ser, mesh::RTCClock* clock = NULL, int pin_reset = GPS_RESET, int pin_en = GPS_EN,RefCountedDigitalPin* peripher_power=NULL) :
@@ -58,13 +152,11 @@ public :
     }
 
     void begin() override {
-        if (_peripher_power) _peripher_power->claim();
-        if (_pin_en != -1) {
-            digitalWrite(_pin_en, PIN_GPS_EN_ACTIVE);
-        }
-        if (_pin_reset != -1) {
-            digitalWrite(_pin_reset, !GPS_RESET_FORCE);
-        }
+        if (_active && !_duty_off) return;   // already on
+        _active = true;
+        _duty_off = false;
+        _duty_since = millis() / 1000;
+        powerOn();
     }
 
     void reset() override {
@@ -76,16 +168,17 @@ public :
     }
 
     void stop() override {
-        if (_pin_en != -1) {
-            digitalWrite(_pin_en, !PIN_GPS_EN_ACTIVE);
-        }
-        if (_peripher_power) _peripher_power->release();  
+        bool powered = _active && !_duty_off;
+        _active = _duty_off = false;
+        if (powered) powerOff();
     }
 
     bool isEnabled() override {
         // directly read the enable pin if present as gps can be
         // activated/deactivated outside of here ...
-        if (_pin_en != -1) {
+        if (_duty_off) {
+            return true;   // only off between fixes
+        } else if (_pin_en != -1) {
             return digitalRead(_pin_en) == PIN_GPS_EN_ACTIVE;
         } else {
             return true; // no enable so must be active
@@ -119,10 +212,11 @@ public :
             #ifdef GPS_NMEA_DEBUG
             Serial.print(c);
             #endif
-            nmea.process(c);
+            processChar(c);
         }
 
         if (!isValid()) time_valid = 0;
+        if (!hasGoodFix()) good_fix_secs = 0;
 
         if (millis() > next_check) {
             next_check = millis() + 1000;
@@ -135,6 +229,10 @@ public :
             if (isValid()) {
                 time_valid ++;
             }
+            if (hasGoodFix()) {
+                good_fix_secs ++;
+            }
+            checkDutyCycle(millis() / 1000);
         }
     }
 };
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include <math.h>
+
+/**
+ * \brief  Sampling timer for one sensor with a slow measure cycle (eg. a gas heater, or a ranging burst). Is split into a
+ *     'start' and a 'collect' phase, polled from SensorManager::loop(), so the mesh loop never waits on the sensor. The
+ *     last reading is cached by the caller, and telemetry queries just report that.
+*/
+class SensorSchedule {
+  unsigned long next_due, ready_at;
+  uint32_t interval_secs;
+  float threshold, last_reported;
+  bool measuring, valid, changed;
+
+public:
+  SensorSchedule(uint32_t secs, float change_threshold) : interval_secs(secs), threshold(change_threshold) {
+    next_due = ready_at = 0;
+    last_reported = 0;
+    measuring = valid = changed = false;
+  }
+
+  uint32_t getInterval() const { return interval_secs; }
+  void setInterval(uint32_t secs) { interval_secs = secs; next_due = millis(); }
+
+  bool isDue() const { return !measuring && (long)(millis() - next_due) >= 0; }
+  bool isReady() const { return measuring && (long)(millis() - ready_at) >= 0; }
+
+  /**
+   * \param  wait_millis  how long until the measurement can be collected
+  */
+  void started(unsigned long wait_millis) {
+    measuring = true;
+    ready_at = millis() + wait_millis;
+  }
+
+  /**
+   * \param  key_value  the main reading, checked against the change threshold since the last one flagged
+   * \param  success  false if the sensor failed to give a reading (cached one is kept)
+  */
+  void collected(float key_value, bool success) {
+    measuring = false;
+    next_due = millis() + interval_secs * 1000UL;
+    if (!success) return;
+
+    if (!valid || (threshold > 0 && fabsf(key_value - last_reported) >= threshold)) {
+      last_reported = key_value;
+      changed = true;
+    }
+    valid = true;
+  }
+
+  bool hasReading() const { return valid; }
+
+  /**
+   * \returns  true (once) if a reading has moved by at least the change threshold
+  */
+  bool takeChanged() {
+    bool c = changed;
+    changed = false;
+    return c;
+  }
+};
@@ -100,11 +100,13 @@ struct lfs_config _InternalFSConfig = {
     .erase = _internal_flash_erase,
     .sync = _internal_flash_sync,
 
-    .read_size = LFS_BLOCK_SIZE,
-    .prog_size = LFS_BLOCK_SIZE,
+    // NOTE: with prog_size the whole block, every commit (of a file or directory) used up a block, so needed an erase.
+    //   A smaller unit lets littlefs append commits within a block, for far fewer erases (and much less RAM)
+    .read_size = LFS_CACHE_SIZE,
+    .prog_size = LFS_CACHE_SIZE,
     .block_size = LFS_BLOCK_SIZE,
     .block_count = LFS_FLASH_TOTAL_SIZE / LFS_BLOCK_SIZE,
-    .lookahead = 128,
+    .lookahead = LFS_LOOKAHEAD_BLOCKS,
 
     .read_buffer = NULL,
     .prog_buffer = NULL,
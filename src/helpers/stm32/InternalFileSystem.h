@@ -31,6 +31,10 @@
   #define LFS_FLASH_TOTAL_SIZE (16 * 2048) /* defaults to 32k flash */
 #endif
 #define LFS_BLOCK_SIZE (2048)
+#ifndef LFS_CACHE_SIZE  /* read/prog unit, and size of each cache. Multiple of 8 (flash is programmed in double-words) */
+  #define LFS_CACHE_SIZE (256)
+#endif
+#define LFS_LOOKAHEAD_BLOCKS (((LFS_FLASH_TOTAL_SIZE / LFS_BLOCK_SIZE) + 31) / 32 * 32)  /* whole free map in one scan */
 #define LFS_FLASH_ADDR_BASE (FLASH_END_ADDR - LFS_FLASH_TOTAL_SIZE + 1)
     
  class InternalFileSystem : public Adafruit_LittleFS
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+
+#if defined(DISPLAY_ASYNC_FLUSH) && (defined(ESP32) || defined(NRF52_PLATFORM))
+
+#ifndef DISPLAY_FLUSH_STACK
+  #define DISPLAY_FLUSH_STACK   3072    // bytes
+#endif
+#ifndef DISPLAY_FLUSH_PRIO
+  #define DISPLAY_FLUSH_PRIO    1       // same as the Arduino loop, so the mesh isn't starved
+#endif
+
+/**
+ * \brief  Runs a display driver's buffer push on a background (FreeRTOS) task, so endFrame() returns once the frame has
+ *     been copied, rather than after it has been clocked out over I2C/SPI. The driver copies the frame into its own
+ *     shadow buffer (double buffering), then calls start(). While a push is in flight, isBusy() is true, and the
+ *     driver must not touch the shadow buffer, or the bus (call wait() first, eg. before sending panel commands).
+ *  NOTE: the display's bus must be either dedicated to it, or locked per transaction by the core (ESP32 Wire/SPI are).
+*/
+class AsyncFlush {
+  void (*_fn)(void*);
+  void* _ctx;
+  TaskHandle_t _task;
+  SemaphoreHandle_t _go;
+  volatile bool _busy;
+
+  static void taskMain(void* p) {
+    auto self = (AsyncFlush *) p;
+    for (;;) {
+      if (xSemaphoreTake(self->_go, portMAX_DELAY) == pdTRUE) {
+        self->_fn(self->_ctx);
+        self->_busy = false;
+      }
+    }
+  }
+
+public:
+  AsyncFlush() : _fn(NULL), _ctx(NULL), _task(NULL), _go(NULL), _busy(false) { }
+
+  /**
+   * \param  fn  the push, called on the flush task (with 'ctx')
+   * \returns  false if task couldn't be started (driver should then push synchronously)
+  */
+  bool begin(void (*fn)(void*), void* ctx, const char* name = "disp_flush") {
+    if (_task) return true;  // already started
+    _fn = fn;
+    _ctx = ctx;
+    _go = xSemaphoreCreateBinary();
+    if (_go == NULL) return false;
+  #ifdef ESP32
+    const uint32_t stack = DISPLAY_FLUSH_STACK;   // ESP-IDF takes bytes
+  #else
+    const uint32_t stack = DISPLAY_FLUSH_STACK / sizeof(StackType_t);   // words
+  #endif
+    if (xTaskCreate(taskMain, name, stack, this, DISPLAY_FLUSH_PRIO, &_task) != pdPASS) {
+      _task = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  bool isReady() const { return _task != NULL; }
+  bool isBusy() const { return _busy; }
+
+  void wait() {
+    while (_busy) vTaskDelay(1);
+  }
+
+  void start() {
+    _busy = true;
+    xSemaphoreGive(_go);
+  }
+};
+
+#endif
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef DIRTY_TILES_MAX
+  #define DIRTY_TILES_MAX   8     // max tiles across (and down) the screen
+#endif
+
+struct DirtyRect {
+  int x, y, w, h;
+};
+
+/**
+ * \brief  Finds the part of a frame which changed since the previous one, from a hash per tile of a grid over the screen,
+ *     so a driver can push just that rectangle instead of the whole frame. A tile's hash is either of its pixels (where
+ *     the driver can read its frame buffer), or of the sequence of draw calls which touched it (where it can't).
+*/
+class DirtyTiles {
+  uint32_t _curr[DIRTY_TILES_MAX][DIRTY_TILES_MAX], _prev[DIRTY_TILES_MAX][DIRTY_TILES_MAX];
+  int _w, _h, _nx, _ny, _tw, _th;
+  bool _all;
+
+public:
+  /**
+   * \param  w, h  size of screen, in the units of the rects given to addRect() (ie. device pixels)
+   * \param  nx, ny  tiles across/down (max DIRTY_TILES_MAX)
+  */
+  DirtyTiles(int w = 1, int h = 1, int nx = DIRTY_TILES_MAX, int ny = DIRTY_TILES_MAX) { setSize(w, h, nx, ny); }
+
+  void setSize(int w, int h, int nx = DIRTY_TILES_MAX, int ny = DIRTY_TILES_MAX) {
+    _nx = nx > DIRTY_TILES_MAX ? DIRTY_TILES_MAX : nx;
+    _ny = ny > DIRTY_TILES_MAX ? DIRTY_TILES_MAX : ny;
+    _w = w; _h = h;
+    _tw = (w + _nx - 1) / _nx;
+    _th = (h + _ny - 1) / _ny;
+    _all = true;
+  }
+
+  int tileWidth() const { return _tw; }
+  int tileHeight() const { return _th; }
+
+  /** \brief  next frame is to be pushed whole (eg. screen was cleared, or is in an unknown state) */
+  void invalidate() { _all = true; }
+
+  void startFrame() {
+    for (int ty = 0; ty < _ny; ty++) {
+      for (int tx = 0; tx < _nx; tx++) _curr[ty][tx] = 2166136261UL;
+    }
+  }
+
+  void setTile(int tx, int ty, uint32_t h) { _curr[ty][tx] = h; }
+
+  /**
+   * \brief  folds a draw call's hash into every tile the call's bounding box touches
+  */
+  void addRect(int x, int y, int w, int h, uint32_t op_hash) {
+    if (w <= 0 || h <= 0) return;
+    int x2 = x + w - 1, y2 = y + h - 1;
+    if (x2 < 0 || y2 < 0 || x >= _w || y >= _h) return;   // off screen
+    int tx1 = x < 0 ? 0 : x / _tw, ty1 = y < 0 ? 0 : y / _th;
+    int tx2 = x2 >= _w ? _nx - 1 : x2 / _tw, ty2 = y2 >= _h ? _ny - 1 : y2 / _th;
+    for (int ty = ty1; ty <= ty2; ty++) {
+      for (int tx = tx1; tx <= tx2; tx++) _curr[ty][tx] = (_curr[ty][tx] ^ op_hash) * 16777619UL;
+    }
+  }
+
+  /**
+   * \param  dest  (OUT) bounding box of the changed tiles, clipped to the screen
+   * \returns  false if no tile changed
+  */
+  bool endFrame(DirtyRect& dest) {
+    int tx1 = _nx, ty1 = _ny, tx2 = -1, ty2 = -1;
+    for (int ty = 0; ty < _ny; ty++) {
+      for (int tx = 0; tx < _nx; tx++) {
+        if (_all || _curr[ty][tx] != _prev[ty][tx]) {
+          if (tx < tx1) tx1 = tx;
+          if (tx > tx2) tx2 = tx;
+          if (ty < ty1) ty1 = ty;
+          if (ty > ty2) ty2 = ty;
+        }
+      }
+    }
+    memcpy(_prev, _curr, sizeof(_prev));
+    _all = false;
+    if (tx2 < 0) return false;   // none changed
+
+    dest.x = tx1 * _tw;
+    dest.y = ty1 * _th;
+    dest.w = ((tx2 + 1) * _tw > _w ? _w : (tx2 + 1) * _tw) - dest.x;
+    dest.h = ((ty2 + 1) * _th > _h ? _h : (ty2 + 1) * _th) - dest.y;
+    return true;
+  }
+
+  bool isWhole(const DirtyRect& r) const { return r.x == 0 && r.y == 0 && r.w == _w && r.h == _h; }
+
+  /** \brief  FNV-1a, to chain over the params of a draw call */
+  static uint32_t hash(const void* data, size_t len, uint32_t h = 2166136261UL) {
+    const uint8_t* p = (const uint8_t *) data;
+    while (len--) h = (h ^ *p++) * 16777619UL;
+    return h;
+  }
+  static uint32_t hash(int v, uint32_t h) { return hash(&v, sizeof(v), h); }
+
+  /** \brief  hash of a draw call, with 'pen' being a hash of the current font/colour */
+  static uint32_t opHash(int op, int x, int y, int w, int h, uint32_t pen) {
+    uint32_t r = hash(op, pen);
+    r = hash(x, r);
+    r = hash(y, r);
+    r = hash(w, r);
+    return hash(h, r);
+  }
+};
@@ -2,17 +2,39 @@
 
 #include <stdint.h>
 #include <string.h>
+#include "DirtyTiles.h"
+#include "TextWidthCache.h"
+
+#ifndef EINK_FULL_REFRESH_EVERY
+  #define EINK_FULL_REFRESH_EVERY   30    // e-paper: fast (partial) refreshes between full ones, which clear the ghosting
+#endif
 
 class DisplayDriver {
   int _w, _h;
 protected:
-  DisplayDriver(int w, int h) { _w = w; _h = h; }
+  DirtyRect _refreshed;    // region (in device pixels) pushed by last endFrame(), w/h zero if none
+  TextWidthCache _text_widths;   // for drivers' getTextWidth()
+  void (*_busy_hook)();    // see setBusyHook()
+
+  DisplayDriver(int w, int h) { _w = w; _h = h; _refreshed = { 0, 0, w, h }; _busy_hook = NULL; }
 public:
   enum Color { DARK=0, LIGHT, RED, GREEN, BLUE, YELLOW, ORANGE }; // on b/w screen, colors will be !=0 synonym of light
 
   int width() const { return _w; }
   int height() const { return _h; }
 
+  /**
+   * \brief  the part of the screen the last endFrame() pushed to the panel. Drivers which track dirty regions (DirtyTiles)
+   *     push just what changed, others push the whole screen every frame.
+  */
+  const DirtyRect& getLastRefresh() const { return _refreshed; }
+
+  /**
+   * \brief  for drivers whose endFrame() has to wait on the panel's BUSY pin (ie. an e-paper refresh), 'fn' is called
+   *     repeatedly while waiting, so the caller can keep the radio serviced. 'fn' must NOT draw to the display.
+  */
+  void setBusyHook(void (*fn)()) { _busy_hook = fn; }
+
   virtual bool isOn() = 0;
   virtual void turnOn() = 0;
   virtual void turnOff() = 0;
@@ -85,11 +107,22 @@ public:
     }
     
     int ellipsis_width = getTextWidth(ellipsis);
-    int str_len = strlen(temp_str);
-    
-    while (str_len > 0 && getTextWidth(temp_str) > max_width - ellipsis_width) {
-      temp_str[--str_len] = 0;
+
+    // binary search for the longest prefix which fits (width only grows as chars are added)
+    int lo = 0, hi = strlen(temp_str) - 1;   // whole string is known not to fit
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      char c = temp_str[mid];
+      temp_str[mid] = 0;
+      bool fits = getTextWidth(temp_str) <= max_width - ellipsis_width;
+      temp_str[mid] = c;
+      if (fits) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
     }
+    temp_str[lo] = 0;
     strcat(temp_str, ellipsis);
     
     setCursor(x, y);
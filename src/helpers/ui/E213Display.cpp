@@ -51,6 +51,7 @@ bool E213Display::begin() {
 
   _init = true;
   _isOn = true;
+  _tiles.setSize(width(), height());
 
   clear();
   display->fastmodeOn(); // Enable fast mode for quicker (partial) updates
@@ -93,10 +94,13 @@ void E213Display::turnOff() {
 
 void E213Display::clear() {
   display->clear();
+  _tiles.invalidate();
 
 }
 
 void E213Display::startFrame(Color bkg) {
+  _tiles.startFrame();
+  _tiles.addRect(0, 0, width(), height(), opHash('b', bkg, 0, 0, 0));
   // Fill screen with white first to ensure clean background
   display->fillRect(0, 0, width(), height(), WHITE);
 
@@ -108,6 +112,7 @@ void E213Display::startFrame(Color bkg) {
 
 void E213Display::setTextSize(int sz) {
   // The library handles text size internally
+    _text_sz = sz;
     display->setTextSize(sz);
 }
 
@@ -120,18 +125,27 @@ void E213Display::setCursor(int x, int y) {
 }
 
 void E213Display::print(const char *str) {
+    int16_t x1, y1;
+    uint16_t w, h;
+    int cx = display->getCursorX(), cy = display->getCursorY();
+    display->getTextBounds(str, cx, cy, &x1, &y1, &w, &h);
+    _tiles.addRect(x1, y1, w, h, DirtyTiles::hash(str, strlen(str), opHash('p', cx, cy, 0, 0)));
     display->print(str);
 }
 
 void E213Display::fillRect(int x, int y, int w, int h) {
+    _tiles.addRect(x, y, w, h, opHash('f', x, y, w, h));
     display->fillRect(x, y, w, h, BLACK);
 }
 
 void E213Display::drawRect(int x, int y, int w, int h) {
+    _tiles.addRect(x, y, w, h, opHash('r', x, y, w, h));
     display->drawRect(x, y, w, h, BLACK);
 }
 
 void E213Display::drawXbm(int x, int y, const uint8_t *bits, int w, int h) {
+  _tiles.addRect(x, y, w, h, DirtyTiles::hash(bits, ((w + 7) / 8) * h, opHash('x', x, y, w, h)));
+
   // Width in bytes for bitmap processing
   uint16_t widthInBytes = (w + 7) / 8;
 
@@ -160,5 +174,18 @@ uint16_t E213Display::getTextWidth(const char *str) {
 }
 
 void E213Display::endFrame() {
+  DirtyRect r;
+  if (!_tiles.endFrame(r)) {
+    _refreshed.w = _refreshed.h = 0;   // unchanged, so skip the (blocking) refresh altogether
+    return;
+  }
+  if (++_num_partials >= EINK_FULL_REFRESH_EVERY) {
+    display->fastmodeOff();   // full refresh, to clear the ghosting left by the fast ones
     display->update();
+    display->fastmodeOn();
+    _num_partials = 0;
+  } else {
+    display->update();   // (library refreshes the whole panel)
+  }
+  _refreshed = { 0, 0, width(), height() };
 }
@@ -11,6 +11,11 @@ class E213Display : public DisplayDriver {
   BaseDisplay* display=NULL;
   bool _init = false;
   bool _isOn = false;
+  int _text_sz = 1;
+  DirtyTiles _tiles;        // to skip frames which are unchanged, from the draw calls
+  int _num_partials = 0;    // fast refreshes since the last full one
+
+  uint32_t opHash(int op, int x, int y, int w, int h) { return DirtyTiles::opHash(op, x, y, w, h, _text_sz); }
 
 public:
   E213Display() : DisplayDriver(250, 122) {}
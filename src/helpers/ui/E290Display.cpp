@@ -13,6 +13,7 @@ bool E290Display::begin() {
 
   _init = true;
   _isOn = true;
+  _tiles.setSize(width(), height());
 
   clear();
   display.fastmodeOn(); // Enable fast mode for quicker (partial) updates
@@ -47,9 +48,12 @@ void E290Display::turnOff() {
 
 void E290Display::clear() {
   display.clear();
+  _tiles.invalidate();
 }
 
 void E290Display::startFrame(Color bkg) {
+  _tiles.startFrame();
+  _tiles.addRect(0, 0, width(), height(), opHash('b', bkg, 0, 0, 0));
   // Fill screen with white first to ensure clean background
   display.fillRect(0, 0, width(), height(), WHITE);
   if (bkg == LIGHT) {
@@ -60,6 +64,7 @@ void E290Display::startFrame(Color bkg) {
 
 void E290Display::setTextSize(int sz) {
   // The library handles text size internally
+  _text_sz = sz;
   display.setTextSize(sz);
 }
 
@@ -72,18 +77,27 @@ void E290Display::setCursor(int x, int y) {
 }
 
 void E290Display::print(const char *str) {
+  int16_t x1, y1;
+  uint16_t w, h;
+  int cx = display.getCursorX(), cy = display.getCursorY();
+  display.getTextBounds(str, cx, cy, &x1, &y1, &w, &h);
+  _tiles.addRect(x1, y1, w, h, DirtyTiles::hash(str, strlen(str), opHash('p', cx, cy, 0, 0)));
   display.print(str);
 }
 
 void E290Display::fillRect(int x, int y, int w, int h) {
+  _tiles.addRect(x, y, w, h, opHash('f', x, y, w, h));
   display.fillRect(x, y, w, h, BLACK);
 }
 
 void E290Display::drawRect(int x, int y, int w, int h) {
+  _tiles.addRect(x, y, w, h, opHash('r', x, y, w, h));
   display.drawRect(x, y, w, h, BLACK);
 }
 
 void E290Display::drawXbm(int x, int y, const uint8_t *bits, int w, int h) {
+  _tiles.addRect(x, y, w, h, DirtyTiles::hash(bits, ((w + 7) / 8) * h, opHash('x', x, y, w, h)));
+
   // Width in bytes for bitmap processing
   uint16_t widthInBytes = (w + 7) / 8;
 
@@ -112,5 +126,18 @@ uint16_t E290Display::getTextWidth(const char *str) {
 }
 
 void E290Display::endFrame() {
-  display.update();
+  DirtyRect r;
+  if (!_tiles.endFrame(r)) {
+    _refreshed.w = _refreshed.h = 0;   // unchanged, so skip the (blocking) refresh altogether
+    return;
+  }
+  if (++_num_partials >= EINK_FULL_REFRESH_EVERY) {
+    display.fastmodeOff();   // full refresh, to clear the ghosting left by the fast ones
+    display.update();
+    display.fastmodeOn();
+    _num_partials = 0;
+  } else {
+    display.update();   // (library refreshes the whole panel)
+  }
+  _refreshed = { 0, 0, width(), height() };
 }
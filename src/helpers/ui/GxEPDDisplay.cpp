@@ -22,12 +22,15 @@ bool GxEPDDisplay::begin() {
   SPI1.begin();
 #endif
   display.init(115200, true, 2, false);
+  display.epd2.setBusyCallback(onBusy, this);   // (instead of just spinning while the panel refreshes)
   display.setRotation(DISPLAY_ROTATION);
   setTextSize(1);  // Default to size 1
   display.setPartialWindow(0, 0, display.width(), display.height());
+  _tiles.setSize(display.width(), display.height());
 
   display.fillScreen(GxEPD_WHITE);
   display.display(true);
+  _num_partials = 0;
   #if DISP_BACKLIGHT
   digitalWrite(DISP_BACKLIGHT, LOW);
   pinMode(DISP_BACKLIGHT, OUTPUT);
@@ -58,17 +61,28 @@ void GxEPDDisplay::turnOff() {
 void GxEPDDisplay::clear() {
   display.fillScreen(GxEPD_WHITE);
   display.setTextColor(GxEPD_BLACK);
-  display_crc.reset();
+  _tiles.invalidate();
 }
 
 void GxEPDDisplay::startFrame(Color bkg) {
   display.fillScreen(GxEPD_WHITE);
   display.setTextColor(_curr_color = GxEPD_BLACK);
-  display_crc.reset();
+  updatePen();
+  _tiles.startFrame();
+}
+
+void GxEPDDisplay::updatePen() {
+  _pen = DirtyTiles::hash(_curr_color, DirtyTiles::hash(_text_sz, 0));
+}
+
+void GxEPDDisplay::onBusy(const void* self) {
+  auto d = (const GxEPDDisplay *) self;
+  if (d->_busy_hook) d->_busy_hook();
 }
 
 void GxEPDDisplay::setTextSize(int sz) {
-  display_crc.update<int>(sz);
+  _text_sz = sz;
+  updatePen();
   switch(sz) {
     case 1:  // Small
       display.setFont(&FreeSans9pt7b);
@@ -86,51 +100,44 @@ void GxEPDDisplay::setTextSize(int sz) {
 }
 
 void GxEPDDisplay::setColor(Color c) {
-  display_crc.update<Color> (c);
   // colours need to be inverted for epaper displays
   if (c == DARK) {
     display.setTextColor(_curr_color = GxEPD_WHITE);
   } else {
     display.setTextColor(_curr_color = GxEPD_BLACK);
   }
+  updatePen();
 }
 
 void GxEPDDisplay::setCursor(int x, int y) {
-  display_crc.update<int>(x);
-  display_crc.update<int>(y);
   display.setCursor((x+offset_x)*scale_x, (y+offset_y)*scale_y);
 }
 
 void GxEPDDisplay::print(const char* str) {
-  display_crc.update<char>(str, strlen(str));
+  int16_t x1, y1;
+  uint16_t w, h;
+  int cx = display.getCursorX(), cy = display.getCursorY();
+  display.getTextBounds(str, cx, cy, &x1, &y1, &w, &h);
+  _tiles.addRect(x1, y1, w, h, DirtyTiles::hash(str, strlen(str), opHash('p', cx, cy, 0, 0)));
   display.print(str);
 }
 
 void GxEPDDisplay::fillRect(int x, int y, int w, int h) {
-  display_crc.update<int>(x);
-  display_crc.update<int>(y);
-  display_crc.update<int>(w);
-  display_crc.update<int>(h);
+  _tiles.addRect(x*scale_x, y*scale_y, w*scale_x, h*scale_y, opHash('f', x, y, w, h));
   display.fillRect(x*scale_x, y*scale_y, w*scale_x, h*scale_y, _curr_color);
 }
 
 void GxEPDDisplay::drawRect(int x, int y, int w, int h) {
-  display_crc.update<int>(x);
-  display_crc.update<int>(y);
-  display_crc.update<int>(w);
-  display_crc.update<int>(h);
+  _tiles.addRect(x*scale_x, y*scale_y, w*scale_x, h*scale_y, opHash('r', x, y, w, h));
   display.drawRect(x*scale_x, y*scale_y, w*scale_x, h*scale_y, _curr_color);
 }
 
 void GxEPDDisplay::drawXbm(int x, int y, const uint8_t* bits, int w, int h) {
-  display_crc.update<int>(x);
-  display_crc.update<int>(y);
-  display_crc.update<int>(w);
-  display_crc.update<int>(h);
-  display_crc.update<uint8_t>(bits, w * h / 8);
   // Calculate the base position in display coordinates
   uint16_t startX = x * scale_x;
   uint16_t startY = y * scale_y;
+  _tiles.addRect(startX, startY, ceil(w * scale_x), ceil(h * scale_y),
+                 DirtyTiles::hash(bits, ((w + 7) / 8) * h, opHash('x', x, y, w, h)));
   
   // Width in bytes for bitmap processing
   uint16_t widthInBytes = (w + 7) / 8;
@@ -164,16 +171,32 @@ void GxEPDDisplay::drawXbm(int x, int y, const uint8_t* bits, int w, int h) {
 }
 
 uint16_t GxEPDDisplay::getTextWidth(const char* str) {
+  uint32_t key = TextWidthCache::keyOf(str, _text_sz);
+  uint16_t width;
+  if (_text_widths.find(key, width)) return width;
+
   int16_t x1, y1;
   uint16_t w, h;
   display.getTextBounds(str, 0, 0, &x1, &y1, &w, &h);
-  return ceil((w + 1) / scale_x);
+  width = ceil((w + 1) / scale_x);
+  _text_widths.put(key, width);
+  return width;
 }
 
 void GxEPDDisplay::endFrame() {
-  uint32_t crc = display_crc.finalize();
-  if (crc != last_display_crc_value) {
+  DirtyRect r;
+  if (!_tiles.endFrame(r)) {
+    _refreshed.w = _refreshed.h = 0;   // unchanged, so skip the refresh altogether
+    return;
+  }
+  if (++_num_partials >= EINK_FULL_REFRESH_EVERY) {
+    display.display(false);   // full refresh, to clear the ghosting left by the fast ones
+    _num_partials = 0;
+    r = { 0, 0, display.width(), display.height() };
+  } else if (_tiles.isWhole(r)) {
     display.display(true);
-    last_display_crc_value = crc;
+  } else {
+    display.displayWindow(r.x, r.y, r.w, r.h);   // partial update of just the changed tiles
   }
+  _refreshed = r;
 }
@@ -12,7 +12,6 @@
 #include <Fonts/FreeSans9pt7b.h>
 #include <Fonts/FreeSansBold12pt7b.h>
 #include <Fonts/FreeSans18pt7b.h>
-#include <CRC32.h>
 
 #include "DisplayDriver.h"
 
@@ -34,8 +33,14 @@ class GxEPDDisplay : public DisplayDriver {
   bool _init = false;
   bool _isOn = false;
   uint16_t _curr_color;
-  CRC32 display_crc;
-  int last_display_crc_value = 0;
+  int _text_sz = 1;
+  uint32_t _pen;            // hash of font/colour, for the draw calls
+  DirtyTiles _tiles;        // changed regions, from the draw calls (panel's buffer isn't ours to read)
+  int _num_partials;        // fast refreshes since the last full one
+
+  void updatePen();
+  uint32_t opHash(int op, int x, int y, int w, int h) { return DirtyTiles::opHash(op, x, y, w, h, _pen); }
+  static void onBusy(const void* self);
 
 public:
 #if defined(EINK_DISPLAY_MODEL)
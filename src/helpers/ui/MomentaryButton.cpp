@@ -2,6 +2,19 @@
 
 #define MULTI_CLICK_WINDOW_MS  280
 
+#if defined(ESP32)
+  #define BUTTON_ISR_ATTR   IRAM_ATTR
+#else
+  #define BUTTON_ISR_ATTR
+#endif
+
+MomentaryButton* MomentaryButton::_irq_buttons[BUTTON_MAX_IRQ];
+
+void BUTTON_ISR_ATTR MomentaryButton::isr0() { _irq_buttons[0]->onEdge(); }
+void BUTTON_ISR_ATTR MomentaryButton::isr1() { _irq_buttons[1]->onEdge(); }
+void BUTTON_ISR_ATTR MomentaryButton::isr2() { _irq_buttons[2]->onEdge(); }
+void BUTTON_ISR_ATTR MomentaryButton::isr3() { _irq_buttons[3]->onEdge(); }
+
 MomentaryButton::MomentaryButton(int8_t pin, int long_press_millis, bool reverse, bool pulldownup, bool multiclick) { 
   _pin = pin;
   _reverse = reverse;
@@ -15,6 +28,8 @@ MomentaryButton::MomentaryButton(int8_t pin, int long_press_millis, bool reverse
   _last_click_time = 0;
   _multi_click_window = multiclick ? MULTI_CLICK_WINDOW_MS : 0;
   _pending_click = false;
+  _use_irq = _edges_lost = false;
+  _edge_head = _edge_tail = 0;
 }
 
 MomentaryButton::MomentaryButton(int8_t pin, int long_press_millis, int analog_threshold) {
@@ -30,6 +45,8 @@ MomentaryButton::MomentaryButton(int8_t pin, int long_press_millis, int analog_t
   _last_click_time = 0;
   _multi_click_window = MULTI_CLICK_WINDOW_MS;
   _pending_click = false;
+  _use_irq = _edges_lost = false;
+  _edge_head = _edge_tail = 0;
 }
 
 void MomentaryButton::begin() {
@@ -38,6 +55,60 @@ void MomentaryButton::begin() {
   }
 }
 
+bool MomentaryButton::beginInterrupt() {
+  begin();
+  if (_pin < 0 || _threshold > 0) return false;
+
+  static void (* const isrs[])() = { isr0, isr1, isr2, isr3 };
+  for (int i = 0; i < BUTTON_MAX_IRQ && i < 4; i++) {
+    if (_irq_buttons[i] == NULL || _irq_buttons[i] == this) {
+      _irq_buttons[i] = this;
+      prev = digitalRead(_pin);   // edges are relative to this
+      _use_irq = true;
+      attachInterrupt(digitalPinToInterrupt(_pin), isrs[i], CHANGE);
+      return true;
+    }
+  }
+  return false;   // all in use
+}
+
+void BUTTON_ISR_ATTR MomentaryButton::onEdge() {
+  uint8_t t = _edge_tail;
+  if ((uint8_t)(t - _edge_head) >= BUTTON_EDGE_QUEUE_SIZE) {
+    _edges_lost = true;   // check() will re-sync from the pin
+    return;
+  }
+  _edges[t % BUTTON_EDGE_QUEUE_SIZE].at = millis();
+  _edges[t % BUTTON_EDGE_QUEUE_SIZE].level = digitalRead(_pin);
+  _edge_tail = t + 1;
+}
+
+// process queued edges, skipping bounces, and leaving the newest if it may still be bouncing
+void MomentaryButton::drainEdges() {
+  unsigned long now = millis();
+  uint8_t h = _edge_head;
+  uint8_t t = _edge_tail;
+  while (h != t) {
+    const Edge& e = _edges[h % BUTTON_EDGE_QUEUE_SIZE];
+    bool newest = (uint8_t)(h + 1) == t;
+    if (newest && now - e.at < BUTTON_DEBOUNCE_MILLIS) break;   // not settled yet
+    if (!newest && _edges[(h + 1) % BUTTON_EDGE_QUEUE_SIZE].at - e.at < BUTTON_DEBOUNCE_MILLIS) {
+      h++;   // a bounce, superseded by next edge
+      continue;
+    }
+    if (e.level != prev) onLevelChange(e.level, e.at);
+    h++;
+  }
+  _edge_head = h;
+
+  if (_edges_lost) {   // queue overflowed, so just take the current level
+    _edge_head = _edge_tail;
+    _edges_lost = false;
+    int btn = digitalRead(_pin);
+    if (btn != prev) onLevelChange(btn, now);
+  }
+}
+
 bool  MomentaryButton::isPressed() const {
   int btn = _threshold > 0 ? (analogRead(_pin) < _threshold) : digitalRead(_pin);
   return isPressed(btn);
@@ -62,36 +133,65 @@ bool MomentaryButton::isPressed(int level) const {
   }
 }
 
+void MomentaryButton::onLevelChange(int level, unsigned long at) {
+  if (isPressed(level)) {
+    down_at = at;
+  } else {
+    // button UP
+    if (_long_millis > 0) {
+      if (down_at > 0 && (unsigned long)(at - down_at) < _long_millis) {  // only a CLICK if still within the long_press millis
+          _click_count++;
+          _last_click_time = at;
+          _pending_click = true;
+      }
+    } else {
+        _click_count++;
+        _last_click_time = at;
+        _pending_click = true;
+    }
+    down_at = 0;
+  }
+  prev = level;
+}
+
+uint32_t MomentaryButton::getMillisToNextWakeup(uint32_t max_millis) const {
+  if (_pin < 0) return max_millis;
+  if (!_use_irq || cancel || _edges_lost) return 0;   // needs polling
+
+  unsigned long now = millis();
+  uint32_t wait = max_millis;
+  if (_edge_head != _edge_tail) {   // wait for newest edge to settle
+    uint32_t age = now - _edges[(uint8_t)(_edge_tail - 1) % BUTTON_EDGE_QUEUE_SIZE].at;
+    return age < BUTTON_DEBOUNCE_MILLIS ? BUTTON_DEBOUNCE_MILLIS - age : 0;
+  }
+  if (down_at > 0) {
+    if (_long_millis <= 0) return 0;   // (caller may want repeat clicks)
+    uint32_t held = now - down_at;
+    if (held >= (uint32_t)_long_millis) return 0;
+    if ((uint32_t)_long_millis - held < wait) wait = _long_millis - held;
+  }
+  if (_pending_click) {
+    uint32_t since = now - _last_click_time;
+    if (since >= (uint32_t)_multi_click_window) return 0;
+    if ((uint32_t)_multi_click_window - since < wait) wait = _multi_click_window - since;
+  }
+  return wait;
+}
+
 int MomentaryButton::check(bool repeat_click) {
   if (_pin < 0) return BUTTON_EVENT_NONE;
 
   int event = BUTTON_EVENT_NONE;
-  int btn = _threshold > 0 ? (analogRead(_pin) < _threshold) : digitalRead(_pin);
-  if (btn != prev) {
-    if (isPressed(btn)) {
-      down_at = millis();
-    } else {
-      // button UP
-      if (_long_millis > 0) {
-        if (down_at > 0 && (unsigned long)(millis() - down_at) < _long_millis) {  // only a CLICK if still within the long_press millis
-            _click_count++;
-            _last_click_time = millis();
-            _pending_click = true;
-        }
-      } else {
-          _click_count++;
-          _last_click_time = millis();
-          _pending_click = true;
-      }
-      if (event == BUTTON_EVENT_CLICK && cancel) {
-        event = BUTTON_EVENT_NONE;
-        _click_count = 0;
-        _last_click_time = 0;
-        _pending_click = false;
-      }
-      down_at = 0;
+  int btn;
+  if (_use_irq) {
+    if (_edge_head == _edge_tail && !_edges_lost && down_at == 0 && !_pending_click && !cancel) {
+      return BUTTON_EVENT_NONE;   // untouched, so nothing to do
     }
-    prev = btn;
+    drainEdges();
+    btn = prev;   // (settled level)
+  } else {
+    btn = _threshold > 0 ? (analogRead(_pin) < _threshold) : digitalRead(_pin);
+    if (btn != prev) onLevelChange(btn, millis());
   }
   if (!isPressed(btn) && cancel) {   // always clear the pending 'cancel' once button is back in UP state
     cancel = 0;
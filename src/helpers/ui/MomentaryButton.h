@@ -8,7 +8,20 @@
 #define BUTTON_EVENT_DOUBLE_CLICK 3
 #define BUTTON_EVENT_TRIPLE_CLICK 4
 
+#ifndef BUTTON_MAX_IRQ
+  #define BUTTON_MAX_IRQ          4     // buttons which can use beginInterrupt()
+#endif
+#define BUTTON_EDGE_QUEUE_SIZE    8     // must be a power of 2
+#ifndef BUTTON_DEBOUNCE_MILLIS
+  #define BUTTON_DEBOUNCE_MILLIS  20    // edges closer together than this are contact bounce
+#endif
+
 class MomentaryButton {
+  struct Edge {
+    unsigned long at;   // millis()
+    uint8_t level;
+  };
+
   int8_t _pin;
   int8_t prev, cancel;
   bool _reverse, _pull;
@@ -19,14 +32,42 @@ class MomentaryButton {
   unsigned long _last_click_time;
   int _multi_click_window;
   bool _pending_click;
+  bool _use_irq;
+  volatile bool _edges_lost;
+  volatile uint8_t _edge_head, _edge_tail;   // free running, tail written only by the ISR
+  Edge _edges[BUTTON_EDGE_QUEUE_SIZE];
+
+  static MomentaryButton* _irq_buttons[BUTTON_MAX_IRQ];
+  static void isr0();
+  static void isr1();
+  static void isr2();
+  static void isr3();
 
   bool isPressed(int level) const;
+  void onEdge();
+  void onLevelChange(int level, unsigned long at);
+  void drainEdges();
 
 public:
   MomentaryButton(int8_t pin, int long_press_mills=0, bool reverse=false, bool pulldownup=false, bool multiclick=true);
   MomentaryButton(int8_t pin, int long_press_mills, int analog_threshold);
   void begin();
+
+  /**
+   * \brief  as begin(), but edges are caught (and timestamped) by a pin-change interrupt, so check() has nothing to do
+   *      until the button is touched, and the loop can sleep in between (see getMillisToNextWakeup()). Digital pins only.
+   * \returns  false if not possible, (button is then just polled, as per begin())
+  */
+  bool beginInterrupt();
+
   int check(bool repeat_click=false);  // returns one of BUTTON_EVENT_*
+
+  /**
+   * \returns  millis until check() next needs calling (eg. for a long press, or the multi-click window), or zero if
+   *      button is polled, or is in some state that needs watching.
+  */
+  uint32_t getMillisToNextWakeup(uint32_t max_millis) const;
+
   void cancelClick();  // suppress next BUTTON_EVENT_CLICK (if already in DOWN state)
   uint8_t getPin() { return _pin; }
   bool isPressed() const;
@@ -618,10 +618,19 @@ uint16_t OLEDDisplay::drawStringInternal(int16_t xMove, int16_t yMove, const cha
 
 
 uint16_t OLEDDisplay::drawString(int16_t xMove, int16_t yMove, const String &strUser) {
+  return drawString(xMove, yMove, strUser.c_str());
+}
+
+uint16_t OLEDDisplay::drawString(int16_t xMove, int16_t yMove, const char* strUser) {
   uint16_t lineHeight = pgm_read_byte(fontData + HEIGHT_POS);
 
+  if (strchr(strUser, '\n') == NULL) {   // single line (the usual case), so no copy needed for strtok()
+    uint16_t length = strlen(strUser);
+    return drawStringInternal(xMove, yMove, strUser, length, getStringWidth(strUser, length, true), true);
+  }
+
   // char* text must be freed!
-  char* text = strdup(strUser.c_str());
+  char* text = strdup(strUser);
   if (!text) {
     DEBUG_OLEDDISPLAY("[OLEDDISPLAY][drawString] Can't allocate char array.\n");
     return 0;
@@ -247,6 +247,7 @@ class OLEDDisplay : public Stream {
 
     // Draws a string at the given location, returns how many chars have been written
     uint16_t drawString(int16_t x, int16_t y, const String &text);
+    uint16_t drawString(int16_t x, int16_t y, const char* text);
 
     // Draws a formatted string (like printf) at the given location
     void drawStringf(int16_t x, int16_t y, char* buffer, String format, ... );
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef UI_MIN_FRAME_MILLIS
+  #define UI_MIN_FRAME_MILLIS   100    // frame rate cap (10 fps)
+#endif
+
+struct RenderStats {
+  uint32_t n_frames;
+  uint32_t n_requests;
+  uint32_t n_coalesced;     // requests made while a redraw was already pending
+  uint32_t total_millis;    // time spent rendering (startFrame() to endFrame())
+  uint16_t max_millis;
+};
+
+/**
+ * \brief  Decides when a UITask redraws: when asked to by request() (events, input), or when a timed redraw comes due
+ *     (eg. a screen with a clock). Redraws are never closer together than the min interval, so a burst of events (eg.
+ *     incoming messages) costs one redraw, not one per event. Also times the renders, for the stats.
+ *  NOTE: callers only check isDue() while the display is on, so requests made while it's off are just left pending.
+*/
+class RenderScheduler {
+  unsigned long _last_frame, _frame_start, _due;
+  uint16_t _min_interval;
+  bool _pending, _timed;
+  RenderStats _stats;
+
+public:
+  RenderScheduler(uint16_t min_interval = UI_MIN_FRAME_MILLIS) {
+    _min_interval = min_interval;
+    _last_frame = _frame_start = _due = 0;
+    _pending = true;   // first frame
+    _timed = false;
+    memset(&_stats, 0, sizeof(_stats));
+  }
+
+  void setMinInterval(uint16_t millis) { _min_interval = millis; }
+
+  /** \brief  redraw as soon as the frame rate cap allows */
+  void request() {
+    _stats.n_requests++;
+    if (_pending) {
+      _stats.n_coalesced++;
+    } else {
+      _pending = true;
+    }
+  }
+
+  /** \brief  redraw at (or after) the given time, replacing any previous timed redraw */
+  void scheduleAt(unsigned long when) {
+    _due = when;
+    _timed = true;
+  }
+
+  bool isDue(unsigned long now) const {
+    if (_stats.n_frames > 0 && now - _last_frame < _min_interval) return false;
+    return _pending || (_timed && (long)(now - _due) >= 0);
+  }
+
+  void beginFrame(unsigned long now) {
+    _frame_start = now;
+    _pending = _timed = false;   // render may request/schedule the next one
+  }
+
+  void endFrame(unsigned long now) {
+    uint32_t took = now - _frame_start;
+    _last_frame = _frame_start;
+    _stats.n_frames++;
+    _stats.total_millis += took;
+    if (took > _stats.max_millis) _stats.max_millis = took > 0xFFFF ? 0xFFFF : took;
+  }
+
+  const RenderStats& getStats() const { return _stats; }
+};
@@ -37,13 +37,13 @@ void SH1106Display::startFrame(Color bkg)
   display.clearDisplay(); // TODO: apply 'bkg'
   _color = SH110X_WHITE;
   display.setTextColor(_color);
-  display.setTextSize(1);
+  display.setTextSize(_text_sz = 1);
   display.cp437(true); // Use full 256 char 'Code Page 437' font
 }
 
 void SH1106Display::setTextSize(int sz)
 {
-  display.setTextSize(sz);
+  display.setTextSize(_text_sz = sz);
 }
 
 void SH1106Display::setColor(Color c)
@@ -79,9 +79,14 @@ void SH1106Display::drawXbm(int x, int y, const uint8_t *bits, int w, int h)
 
 uint16_t SH1106Display::getTextWidth(const char *str)
 {
+  uint32_t key = TextWidthCache::keyOf(str, _text_sz);
+  uint16_t width;
+  if (_text_widths.find(key, width)) return width;
+
   int16_t x1, y1;
   uint16_t w, h;
   display.getTextBounds(str, 0, 0, &x1, &y1, &w, &h);
+  _text_widths.put(key, w);
   return w;
 }
 
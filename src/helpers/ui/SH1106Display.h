@@ -19,11 +19,12 @@ class SH1106Display : public DisplayDriver
   Adafruit_SH1106G display;
   bool _isOn;
   uint8_t _color;
+  uint8_t _text_sz;
 
   bool i2c_probe(TwoWire &wire, uint8_t addr);
 
 public:
-  SH1106Display() : DisplayDriver(128, 64), display(128, 64, &Wire, PIN_OLED_RESET) { _isOn = false; }
+  SH1106Display() : DisplayDriver(128, 64), display(128, 64, &Wire, PIN_OLED_RESET) { _isOn = false; _text_sz = 1; }
   bool begin();
 
   bool isOn() override { return _isOn; }
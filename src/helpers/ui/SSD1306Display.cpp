@@ -10,34 +10,43 @@ bool SSD1306Display::begin() {
   #ifdef DISPLAY_ROTATION
   display.setRotation(DISPLAY_ROTATION);
   #endif
-  return display.begin(SSD1306_SWITCHCAPVCC, DISPLAY_ADDRESS, true, false) && i2c_probe(Wire, DISPLAY_ADDRESS);
+  _tiles.invalidate();
+  if (!display.begin(SSD1306_SWITCHCAPVCC, DISPLAY_ADDRESS, true, false) || !i2c_probe(Wire, DISPLAY_ADDRESS)) return false;
+#ifdef DISPLAY_ASYNC_FLUSH
+  _flusher.begin(flushTask, this);   // if task can't be started, frames are just pushed synchronously
+#endif
+  return true;
 }
 
 void SSD1306Display::turnOn() {
+  waitIdle();
   display.ssd1306_command(SSD1306_DISPLAYON);
   _isOn = true;
 }
 
 void SSD1306Display::turnOff() {
+  waitIdle();
   display.ssd1306_command(SSD1306_DISPLAYOFF);
   _isOn = false;
 }
 
 void SSD1306Display::clear() {
+  waitIdle();
   display.clearDisplay();
   display.display();
+  _tiles.invalidate();
 }
 
 void SSD1306Display::startFrame(Color bkg) {
   display.clearDisplay();  // TODO: apply 'bkg'
   _color = SSD1306_WHITE;
   display.setTextColor(_color);
-  display.setTextSize(1);
+  display.setTextSize(_text_sz = 1);
   display.cp437(true);         // Use full 256 char 'Code Page 437' font
 }
 
 void SSD1306Display::setTextSize(int sz) {
-  display.setTextSize(sz);
+  display.setTextSize(_text_sz = sz);
 }
 
 void SSD1306Display::setColor(Color c) {
@@ -66,12 +75,79 @@ void SSD1306Display::drawXbm(int x, int y, const uint8_t* bits, int w, int h) {
 }
 
 uint16_t SSD1306Display::getTextWidth(const char* str) {
+  uint32_t key = TextWidthCache::keyOf(str, _text_sz);
+  uint16_t width;
+  if (_text_widths.find(key, width)) return width;
+
   int16_t x1, y1;
   uint16_t w, h;
   display.getTextBounds(str, 0, 0, &x1, &y1, &w, &h);
+  _text_widths.put(key, w);
   return w;
 }
 
+// sends just the given (page aligned) window of the frame buffer, instead of all 1KB of it
+void SSD1306Display::pushWindow(const uint8_t* buf, const DirtyRect& r) {
+  int page1 = r.y / 8, page2 = (r.y + r.h - 1) / 8;
+
+  display.ssd1306_command(SSD1306_COLUMNADDR);
+  display.ssd1306_command(r.x);
+  display.ssd1306_command(r.x + r.w - 1);
+  display.ssd1306_command(SSD1306_PAGEADDR);
+  display.ssd1306_command(page1);
+  display.ssd1306_command(page2);
+
+  for (int page = page1; page <= page2; page++) {
+    const uint8_t* src = &buf[page * 128 + r.x];
+    int n = r.w;
+    while (n > 0) {
+      int len = n > 16 ? 16 : n;   // keep within smallest Wire buffers
+      Wire.beginTransmission(DISPLAY_ADDRESS);
+      Wire.write((uint8_t) 0x40);   // Co = 0, D/C = 1 (data)
+      Wire.write(src, len);
+      Wire.endTransmission();
+      src += len;
+      n -= len;
+    }
+  }
+}
+
+#ifdef DISPLAY_ASYNC_FLUSH
+void SSD1306Display::flushTask(void* p) {
+  auto self = (SSD1306Display *) p;
+  self->pushWindow(self->_shadow, self->_pending);
+}
+#endif
+
 void SSD1306Display::endFrame() {
-  display.display();
+  waitIdle();   // only blocks if frames come faster than they can be pushed (UI frames are much further apart)
+
+  // frame buffer is page major (each byte is 8 rows of one column), so each tile is a run of 16 bytes
+  const uint8_t* buf = display.getBuffer();
+  _tiles.startFrame();
+  for (int page = 0; page < 8; page++) {
+    for (int tx = 0; tx < 8; tx++) {
+      _tiles.setTile(tx, page, DirtyTiles::hash(&buf[page * 128 + tx * 16], 16));
+    }
+  }
+
+  DirtyRect r;
+  if (!_tiles.endFrame(r)) {
+    _refreshed.w = _refreshed.h = 0;   // unchanged
+    return;
+  }
+  _refreshed = r;
+#ifdef DISPLAY_ASYNC_FLUSH
+  if (_flusher.isReady()) {
+    memcpy(_shadow, buf, sizeof(_shadow));
+    _pending = r;
+    _flusher.start();
+    return;
+  }
+#endif
+  if (_tiles.isWhole(r)) {
+    display.display();
+  } else {
+    pushWindow(buf, r);
+  }
 }
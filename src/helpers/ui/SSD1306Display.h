@@ -5,6 +5,8 @@
 #include <Adafruit_GFX.h>
 #define SSD1306_NO_SPLASH
 #include <Adafruit_SSD1306.h>
+#include "DirtyTiles.h"
+#include "AsyncFlush.h"
 
 #ifndef PIN_OLED_RESET
   #define PIN_OLED_RESET        21 // Reset pin # (or -1 if sharing Arduino reset pin)
@@ -18,10 +20,25 @@ class SSD1306Display : public DisplayDriver {
   Adafruit_SSD1306 display;
   bool _isOn;
   uint8_t _color;
+  uint8_t _text_sz;
+  DirtyTiles _tiles;    // 16 columns x 1 page (8 rows) per tile, hashed from the frame buffer
+#ifdef DISPLAY_ASYNC_FLUSH
+  AsyncFlush _flusher;
+  uint8_t _shadow[128 * 64 / 8];   // frame being pushed by _flusher
+  DirtyRect _pending;
+
+  static void flushTask(void* p);
+#endif
 
   bool i2c_probe(TwoWire& wire, uint8_t addr);
+  void pushWindow(const uint8_t* buf, const DirtyRect& r);
+  void waitIdle() {
+  #ifdef DISPLAY_ASYNC_FLUSH
+    _flusher.wait();
+  #endif
+  }
 public:
-  SSD1306Display() : DisplayDriver(128, 64), display(128, 64, &Wire, PIN_OLED_RESET) { _isOn = false; }
+  SSD1306Display() : DisplayDriver(128, 64), display(128, 64, &Wire, PIN_OLED_RESET), _tiles(128, 64, 8, 8) { _isOn = false; _text_sz = 1; }
   bool begin();
 
   bool isOn() override { return _isOn; }
@@ -29,6 +29,10 @@ bool ST7789Display::begin() {
     display.landscapeScreen();
     display.displayOn();
     setCursor(0,0);
+  #ifdef DISPLAY_ASYNC_FLUSH
+    if (_shadow == NULL) _shadow = (uint8_t *) malloc(display.getBufferSize());
+    if (_shadow) _flusher.begin(flushTask, this);   // otherwise, frames are just pushed synchronously
+  #endif
 
     _isOn = true;
   }
@@ -37,6 +41,7 @@ bool ST7789Display::begin() {
 
 void ST7789Display::turnOn() {
   if (!_isOn) {
+    waitIdle();
     // Restore power to the display but keep backlight off
     digitalWrite(PIN_TFT_VDD_CTL, LOW);
     digitalWrite(PIN_TFT_RST, HIGH);
@@ -57,6 +62,7 @@ void ST7789Display::turnOn() {
 }
 
 void ST7789Display::turnOff() {
+  waitIdle();
   digitalWrite(PIN_TFT_VDD_CTL, HIGH);
 #ifdef PIN_TFT_LEDA_CTL_ACTIVE
   digitalWrite(PIN_TFT_LEDA_CTL, !PIN_TFT_LEDA_CTL_ACTIVE);
@@ -76,9 +82,11 @@ void ST7789Display::startFrame(Color bkg) {
   _color = ST77XX_WHITE;
   display.setRGB(_color);
   display.setFont(ArialMT_Plain_16);
+  _text_sz = 1;
 }
 
 void ST7789Display::setTextSize(int sz) {
+  _text_sz = sz;
   switch(sz) {
     case 1 :
       display.setFont(ArialMT_Plain_16);
@@ -183,10 +191,31 @@ void ST7789Display::drawXbm(int x, int y, const uint8_t* bits, int w, int h) {
 }
 
 uint16_t ST7789Display::getTextWidth(const char* str) {
-  return display.getStringWidth(str) / SCALE_X;
+  uint32_t key = TextWidthCache::keyOf(str, _text_sz);
+  uint16_t width;
+  if (_text_widths.find(key, width)) return width;
+
+  width = display.getStringWidth(str, strlen(str)) / SCALE_X;
+  _text_widths.put(key, width);
+  return width;
 }
 
+#ifdef DISPLAY_ASYNC_FLUSH
+void ST7789Display::flushTask(void* p) {
+  auto self = (ST7789Display *) p;
+  self->display.display(self->_shadow);
+}
+#endif
+
 void ST7789Display::endFrame() {
+  waitIdle();   // only blocks if frames come faster than they can be pushed
+#ifdef DISPLAY_ASYNC_FLUSH
+  if (_flusher.isReady()) {
+    memcpy(_shadow, display.buffer, display.getBufferSize());
+    _flusher.start();
+    return;
+  }
+#endif
   display.display();
 }
 
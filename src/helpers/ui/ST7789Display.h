@@ -5,14 +5,27 @@
 #include <SPI.h>
 #include <Adafruit_GFX.h>
 #include "ST7789Spi.h"
+#include "AsyncFlush.h"
 
 class ST7789Display : public DisplayDriver {
   ST7789Spi display;
   bool _isOn;
   uint16_t _color;
   int _x=0, _y=0;
+  int _text_sz=1;
+#ifdef DISPLAY_ASYNC_FLUSH
+  AsyncFlush _flusher;
+  uint8_t* _shadow = NULL;   // frame being pushed by _flusher
+
+  static void flushTask(void* p);
+#endif
 
   bool i2c_probe(TwoWire& wire, uint8_t addr);
+  void waitIdle() {
+  #ifdef DISPLAY_ASYNC_FLUSH
+    _flusher.wait();
+  #endif
+  }
 public:
 #ifdef HELTEC_VISION_MASTER_T190
   ST7789Display() : DisplayDriver(128, 64), display(&SPI, PIN_TFT_RST, PIN_TFT_DC, PIN_TFT_CS, GEOMETRY_RAWMODE, 320, 170,PIN_TFT_SDA,-1,PIN_TFT_SCL) {_isOn = false;}
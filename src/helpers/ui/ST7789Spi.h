@@ -150,7 +150,14 @@ class ST7789Spi : public OLEDDisplay {
       return true;
     }
 
+    uint16_t getBufferSize() const { return displayBufferSize; }
+
     void display(void) {
+      display(buffer);
+    }
+
+    // pushes 'frame' (a copy of buffer, for pushing from another task while the next frame is drawn)
+    void display(const uint8_t* frame) {
     #ifdef OLEDDISPLAY_DOUBLE_BUFFER
 
        uint16_t minBoundY = UINT16_MAX;
@@ -162,24 +169,24 @@ class ST7789Spi : public OLEDDisplay {
        uint16_t x, y;
         
        // Calculate the Y bounding box of changes
-       // and copy buffer[pos] to buffer_back[pos];
+       // and copy frame[pos] to buffer_back[pos];
        for (y = 0; y < _buffheight; y++) {
          for (x = 0; x < displayWidth; x++) {
           //Serial.printf("x  %d y %d\r\n",x,y);
           uint16_t pos = x + y * displayWidth;
-          if (buffer[pos] != buffer_back[pos]) {
+          if (frame[pos] != buffer_back[pos]) {
             minBoundY = min(minBoundY, y);
             maxBoundY = max(maxBoundY, y);
             minBoundX = min(minBoundX, x);
             maxBoundX = max(maxBoundX, x);
           }
-          buffer_back[pos] = buffer[pos];
+          buffer_back[pos] = frame[pos];
         }
         yield();
        }
 
        // If the minBoundY wasn't updated
-       // we can savely assume that buffer_back[pos] == buffer[pos]
+       // we can savely assume that buffer_back[pos] == frame[pos]
        // holdes true for all values of pos
        if (minBoundY == UINT16_MAX) return;
 
@@ -197,7 +204,7 @@ class ST7789Spi : public OLEDDisplay {
               uint16_t *pixbuf = (uint16_t *)rtos_malloc(2 * pixbufcount);
               for (x = minBoundX; x <= maxBoundX; x++)
               {
-                pixbuf[x-minBoundX] = ((buffer[x + y * displayWidth]>>temp)&0x01)==1?_RGB:0;
+                pixbuf[x-minBoundX] = ((frame[x + y * displayWidth]>>temp)&0x01)==1?_RGB:0;
               }
 #ifdef ESP_PLATFORM
               _spi->transferBytes((uint8_t *)pixbuf, NULL, 2 * pixbufcount);
@@ -225,7 +232,7 @@ class ST7789Spi : public OLEDDisplay {
               uint16_t *pixbuf = (uint16_t *)rtos_malloc(2 * pixbufcount);
               for (x = 0; x < displayWidth; x++)
               {
-                pixbuf[x] = ((buffer[x + y * displayWidth]>>temp)&0x01)==1?_RGB:0;
+                pixbuf[x] = ((frame[x + y * displayWidth]>>temp)&0x01)==1?_RGB:0;
               }
 #ifdef ESP_PLATFORM
               _spi->transferBytes((uint8_t *)pixbuf, NULL, 2 * pixbufcount);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef TEXT_WIDTH_CACHE_SIZE
+  #define TEXT_WIDTH_CACHE_SIZE   16
+#endif
+
+/**
+ * \brief  Widths of recently measured strings, keyed by a hash of the string and font. The UI re-measures the same labels,
+ *     names etc. every frame (for centring, right-aligning and ellipsizing), which for proportional fonts is a walk of the
+ *     font's glyph table per char. Entries are replaced round-robin.
+*/
+class TextWidthCache {
+  struct Entry {
+    uint32_t key;
+    uint16_t width;
+  };
+  Entry _entries[TEXT_WIDTH_CACHE_SIZE];
+  int _num, _next;
+
+public:
+  TextWidthCache() { clear(); }
+
+  void clear() { _num = _next = 0; }
+
+  /** \param  font  whatever identifies the driver's current font/size */
+  static uint32_t keyOf(const char* str, int font) {
+    uint32_t h = 2166136261UL ^ (uint32_t) font;
+    while (*str) h = (h ^ (uint8_t) *str++) * 16777619UL;
+    return h;
+  }
+
+  bool find(uint32_t key, uint16_t& width) const {
+    for (int i = 0; i < _num; i++) {
+      if (_entries[i].key == key) {
+        width = _entries[i].width;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void put(uint32_t key, uint16_t width) {
+    _entries[_next].key = key;
+    _entries[_next].width = width;
+    if (_num < TEXT_WIDTH_CACHE_SIZE) _num++;
+    _next = (_next + 1) % TEXT_WIDTH_CACHE_SIZE;
+  }
+};
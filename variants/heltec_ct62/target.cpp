@@ -25,10 +25,11 @@ void radio_set_params(float freq, float bw, uint8_t sf, uint8_t cr) {
   radio.setSpreadingFactor(sf);
   radio.setBandwidth(bw);
   radio.setCodingRate(cr);
+  radio_driver.setRadioConfig(sf, bw, cr, freq);
 }
 
 void radio_set_tx_power(uint8_t dbm) {
-  radio.setOutputPower(dbm);
+  radio_driver.setOutputPower(dbm);
 }
 
 mesh::LocalIdentity radio_new_identity() {
@@ -14,6 +14,10 @@ public:
 
   void begin();
   void enterDeepSleep(uint32_t secs, int pin_wake_btn = -1);
+  bool enterRxSleep(uint32_t secs) override {
+    enterDeepSleep(secs);   // radio stays in Rx, and wakes us on DIO1
+    return true;
+  }
   void powerOff() override;
   uint16_t getBattMilliVolts() override;
   const char* getManufacturerName() const override ;
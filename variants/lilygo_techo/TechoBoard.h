@@ -52,4 +52,12 @@ public:
   void reboot() override {
     NVIC_SystemReset();
   }
+
+  void idle(uint32_t max_millis) override {
+    // System ON sleep: RAM and RTC are kept, as FreeRTOS' tickless idle sleeps the CPU between ticks.
+    uint32_t start = millis();
+    while (digitalRead(P_LORA_DIO_1) == LOW && millis() - start < max_millis) {   // until radio IRQ
+      delay(1);
+    }
+  }
 };
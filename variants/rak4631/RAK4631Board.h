@@ -58,5 +58,14 @@ public:
     NVIC_SystemReset();
   }
 
+  void idle(uint32_t max_millis) override {
+    // System ON sleep: RAM and RTC are kept, as FreeRTOS' tickless idle sleeps the CPU between ticks. (System OFF
+    // would lose the clock, as nothing counts the time spent in it)
+    uint32_t start = millis();
+    while (digitalRead(P_LORA_DIO_1) == LOW && millis() - start < max_millis) {   // until radio IRQ
+      delay(1);
+    }
+  }
+
   bool startOTAUpdate(const char* id, char reply[]) override;
 };
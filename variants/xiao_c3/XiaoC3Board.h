@@ -71,6 +71,11 @@ public:
     esp_deep_sleep_start();  // CPU halts here and never returns!
   }
 
+  bool enterRxSleep(uint32_t secs) override {
+    enterDeepSleep(secs);   // radio stays in Rx, and wakes us on DIO1
+    return true;
+  }
+
 #if defined(LORA_TX_BOOST_PIN) || defined(P_LORA_TX_LED)
   void onBeforeTransmit() override {
   #if defined(P_LORA_TX_LED)